@@ -1066,6 +1066,9 @@ m4_include([m4/pandora_vc_build.m4])
 m4_include([m4/pandora_version.m4])
 m4_include([m4/pandora_warnings.m4])
 m4_include([m4/protocol_binary.m4])
+m4_include([m4/cxx20.m4])
+m4_include([m4/libz.m4])
 m4_include([m4/setsockopt.m4])
 m4_include([m4/socket_send_flags.m4])
+m4_include([m4/telemetry.m4])
 m4_include([m4/visibility.m4])
@@ -41,5 +41,6 @@ enum memcached_options {
   OPT_STAT_ARGS,
   OPT_SERVER_VERSION,
   OPT_QUIET,
+  OPT_SLOWLOG,
   OPT_FILE= 'f'
 };
@@ -17,6 +17,7 @@
 #include <cstring>
 #include <ctime>
 #include <iostream>
+#include <vector>
 #include <fcntl.h>
 #include <getopt.h>
 #include <unistd.h>
@@ -32,10 +33,12 @@
 
 #define PROGRAM_NAME "memstat"
 #define PROGRAM_DESCRIPTION "Output the state of a memcached cluster."
+#define SLOWLOG_ENTRIES 1024
 
 /* Prototypes */
 static void options_parse(int argc, char *argv[]);
 static void run_analyzer(memcached_st *memc, memcached_stat_st *memc_stat);
+static void print_slowlog(memcached_st *memc);
 static void print_analysis_report(memcached_st *memc,
                                   memcached_analysis_st *report);
 
@@ -43,6 +46,8 @@ static bool opt_binary= false;
 static bool opt_verbose= false;
 static bool opt_server_version= false;
 static bool opt_analyze= false;
+static bool opt_slowlog= false;
+static uint64_t slowlog_threshold= 0;
 static char *opt_servers= NULL;
 static char *stat_args= NULL;
 static char *analyze_mode= NULL;
@@ -59,6 +64,7 @@ static struct option long_options[]=
   {(OPTIONSTRING)"server-version", no_argument, NULL, OPT_SERVER_VERSION},
   {(OPTIONSTRING)"servers", required_argument, NULL, OPT_SERVERS},
   {(OPTIONSTRING)"analyze", optional_argument, NULL, OPT_ANALYZE},
+  {(OPTIONSTRING)"slowlog", optional_argument, NULL, OPT_SLOWLOG},
   {0, 0, 0, 0},
 };
 
@@ -130,6 +136,12 @@ int main(int argc, char *argv[])
     exit(EXIT_FAILURE);
   }
 
+  if (opt_slowlog and memcached_failed(memcached_slowlog_create(memc, slowlog_threshold, SLOWLOG_ENTRIES)))
+  {
+    std::cerr << "Unable to create the slow request log: " << memcached_last_error_message(memc) << std::endl;
+    exit(EXIT_FAILURE);
+  }
+
   if (opt_server_version)
   {
     if (memcached_failed(memcached_version(memc)))
@@ -160,6 +172,11 @@ int main(int argc, char *argv[])
     rc= memcached_stat_execute(memc, stat_args, stat_printer, NULL);
   }
 
+  if (opt_slowlog)
+  {
+    print_slowlog(memc);
+  }
+
   memcached_free(memc);
 
   return rc == MEMCACHED_SUCCESS ? EXIT_SUCCESS: EXIT_FAILURE;
@@ -329,6 +346,39 @@ static void print_analysis_report(memcached_st *memc,
   printf("\n");
 }
 
+static void print_slowlog(memcached_st *memc)
+{
+  std::vector<memcached_slowlog_entry_st> entries(SLOWLOG_ENTRIES);
+  size_t count= memcached_slowlog_read(memc, &entries[0], entries.size());
+
+  printf("Slow requests: %lu\n", (unsigned long)count);
+  for (size_t x= 0; x < count; x++)
+  {
+    const memcached_slowlog_entry_st& entry= entries[x];
+
+    printf("\t%s", memcached_telemetry_op_string(entry.op));
+    if (entry.hostname[0])
+    {
+      printf(" %s:%u", entry.hostname, (uint32_t)entry.port);
+    }
+    printf(" %llu us %s (key %lu bytes, value %lu bytes)\n",
+           (unsigned long long)entry.total_usec,
+           memcached_strerror(memc, entry.rc),
+           (unsigned long)entry.key_length,
+           (unsigned long)entry.value_length);
+
+    for (uint32_t phase= 0; phase < MEMCACHED_SLOWLOG_PHASE_MAX; phase++)
+    {
+      if (entry.phase_usec[phase])
+      {
+        printf("\t\t%s: %llu us\n",
+               memcached_slowlog_phase_string(memcached_slowlog_phase_t(phase)),
+               (unsigned long long)entry.phase_usec[phase]);
+      }
+    }
+  }
+}
+
 static void options_parse(int argc, char *argv[])
 {
   memcached_programs_help_st help_options[]=
@@ -389,6 +439,11 @@ static void options_parse(int argc, char *argv[])
       analyze_mode= (optarg) ? strdup(optarg) : NULL;
       break;
 
+    case OPT_SLOWLOG:
+      opt_slowlog= true;
+      slowlog_threshold= (optarg) ? strtoull(optarg, NULL, 10) : 0;
+      break;
+
     case OPT_QUIET:
       close_stdio();
       break;
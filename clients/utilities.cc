@@ -104,6 +104,7 @@ static const char *lookup_help(memcached_options option)
   case OPT_FILE: return "Path to file in which to save result";
   case OPT_STAT_ARGS: return "Argument for statistics";
   case OPT_SERVER_VERSION: return "Memcached daemon software version";
+  case OPT_SLOWLOG: return "Print the requests that took at least the given number of microseconds (default 0).";
   default:
                       break;
   };
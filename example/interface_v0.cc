@@ -296,6 +296,7 @@ static protocol_binary_response_status concat_command_handler(const void *cookie
   else if (cas != 0 && cas != item->cas)
   {
     rval= PROTOCOL_BINARY_RESPONSE_KEY_EEXISTS;
+    release_item(item);
   }
   else if ((nitem= create_item(key, keylen, NULL, item->size + vallen,
                                item->flags, item->exp)) == NULL)
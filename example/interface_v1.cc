@@ -10,12 +10,14 @@
  */
 #include "config.h"
 
+#include <algorithm>
 #include <cassert>
 #include <cerrno>
 #include <cstdio>
 #include <cstdlib>
 #include <cstring>
 #include <fcntl.h>
+#include <pthread.h>
 #include <sys/types.h>
 #include <unistd.h>
 
@@ -27,6 +29,9 @@
 
 static datadifferential::util::log_info_st *log_file= NULL;
 
+/* The number of items looked up or stored with one trip into the storage */
+#define BATCH_SIZE 64
+
 static protocol_binary_response_status add_handler(const void *cookie,
                                                    const void *key,
                                                    uint16_t keylen,
@@ -56,6 +61,7 @@ static protocol_binary_response_status add_handler(const void *cookie,
   else
   {
     rval= PROTOCOL_BINARY_RESPONSE_KEY_EEXISTS;
+    release_item(item);
   }
 
   return rval;
@@ -82,6 +88,7 @@ static protocol_binary_response_status append_handler(const void *cookie,
   else if (cas != 0 && cas != item->cas)
   {
     rval= PROTOCOL_BINARY_RESPONSE_KEY_EEXISTS;
+    release_item(item);
   }
   else if ((nitem= create_item(key, keylen, NULL, item->size + vallen,
                                item->flags, item->exp)) == NULL)
@@ -175,11 +182,18 @@ static protocol_binary_response_status delete_handler(const void *, // cookie
 }
 
 
-static protocol_binary_response_status flush_handler(const void * /* cookie */, uint32_t /* when */)
+static protocol_binary_response_status flush_handler(const void * /* cookie */, uint32_t when)
 {
+  flush(when);
   return PROTOCOL_BINARY_RESPONSE_SUCCESS;
 }
 
+static void release_item_reference(const void *, // cookie
+                                   void *context)
+{
+  release_item((struct item*)context);
+}
+
 static protocol_binary_response_status get_handler(const void *cookie,
                                                    const void *key,
                                                    uint16_t keylen,
@@ -191,12 +205,60 @@ static protocol_binary_response_status get_handler(const void *cookie,
     return PROTOCOL_BINARY_RESPONSE_KEY_ENOENT;
   }
 
-  protocol_binary_response_status rc;
-  rc= response_handler(cookie, key, (uint16_t)keylen,
+  /* The item is released once its data is sent */
+  memcached_protocol_client_reference_body(cookie, release_item_reference, item);
+  return response_handler(cookie, key, (uint16_t)keylen,
                           item->data, (uint32_t)item->size, item->flags,
                           item->cas);
-  release_item(item);
-  return rc;
+}
+
+static protocol_binary_response_status get_batch_handler(const void *cookie,
+                                                         const memcached_binary_protocol_batch_get_st *keys,
+                                                         uint32_t nkeys,
+                                                         memcached_binary_protocol_batch_get_response_handler response_handler) {
+  const void *key[BATCH_SIZE];
+  size_t nkey[BATCH_SIZE];
+  struct item *items[BATCH_SIZE];
+
+  /* Look up all of the keys with a single trip into the storage */
+  for (uint32_t offset= 0; offset < nkeys; offset+= BATCH_SIZE)
+  {
+    size_t count= std::min(nkeys - offset, uint32_t(BATCH_SIZE));
+    for (size_t x= 0; x < count; ++x)
+    {
+      key[x]= keys[offset + x].key;
+      nkey[x]= keys[offset + x].keylen;
+    }
+    get_items(key, nkey, count, items);
+
+    for (size_t x= 0; x < count; ++x)
+    {
+      if (items[x] == NULL)
+      {
+        continue;
+      }
+
+      memcached_protocol_client_reference_body(cookie, release_item_reference, items[x]);
+      protocol_binary_response_status rval= response_handler(cookie, uint32_t(offset + x),
+                                                             items[x]->data,
+                                                             (uint32_t)items[x]->size,
+                                                             items[x]->flags,
+                                                             items[x]->cas);
+      if (rval != PROTOCOL_BINARY_RESPONSE_SUCCESS)
+      {
+        for (++x; x < count; ++x)
+        {
+          if (items[x] != NULL)
+          {
+            release_item(items[x]);
+          }
+        }
+        return rval;
+      }
+    }
+  }
+
+  return PROTOCOL_BINARY_RESPONSE_SUCCESS;
 }
 
 static protocol_binary_response_status increment_handler(const void *cookie,
@@ -352,11 +414,15 @@ static protocol_binary_response_status set_handler(const void *cookie,
   if (cas != 0)
   {
     struct item* item= get_item(key, keylen);
-    if (item != NULL && cas != item->cas)
+    if (item != NULL)
     {
-      /* Invalid CAS value */
+      if (cas != item->cas)
+      {
+        /* Invalid CAS value */
+        release_item(item);
+        return PROTOCOL_BINARY_RESPONSE_KEY_EEXISTS;
+      }
       release_item(item);
-      return PROTOCOL_BINARY_RESPONSE_KEY_EEXISTS;
     }
   }
 
@@ -376,6 +442,61 @@ static protocol_binary_response_status set_handler(const void *cookie,
   return rval;
 }
 
+/* Store a run of new items with a single trip into the storage */
+static void store_created(memcached_binary_protocol_batch_set_st *items,
+                          struct item **created, const uint32_t *index,
+                          size_t count)
+{
+  put_items(created, count);
+  for (size_t x= 0; x < count; ++x)
+  {
+    items[index[x]].status= PROTOCOL_BINARY_RESPONSE_SUCCESS;
+    items[index[x]].result_cas= created[x]->cas;
+    release_item(created[x]);
+  }
+}
+
+static protocol_binary_response_status set_batch_handler(const void *cookie,
+                                                         memcached_binary_protocol_batch_set_st *items,
+                                                         uint32_t nitems) {
+  struct item *created[BATCH_SIZE]= { };
+  uint32_t index[BATCH_SIZE];
+  size_t count= 0;
+
+  for (uint32_t x= 0; x < nitems; ++x)
+  {
+    memcached_binary_protocol_batch_set_st *it= &items[x];
+
+    if (it->cas != 0)
+    {
+      /* Compare and swap needs a lookup of its own */
+      it->status= set_handler(cookie, it->key, it->keylen, it->val, it->vallen,
+                              it->flags, it->exptime, it->cas, &it->result_cas);
+      continue;
+    }
+
+    struct item* item= create_item(it->key, it->keylen, it->val, it->vallen,
+                                   it->flags, (time_t)it->exptime);
+    if (item == NULL)
+    {
+      it->status= PROTOCOL_BINARY_RESPONSE_ENOMEM;
+      continue;
+    }
+
+    created[count]= item;
+    index[count]= x;
+    if (++count == BATCH_SIZE)
+    {
+      store_created(items, created, index, count);
+      count= 0;
+    }
+  }
+
+  store_created(items, created, index, count);
+
+  return PROTOCOL_BINARY_RESPONSE_SUCCESS;
+}
+
 static protocol_binary_response_status stat_handler(const void *cookie,
                                                     const void *, // key
                                                     uint16_t, // keylen,
@@ -385,6 +506,157 @@ static protocol_binary_response_status stat_handler(const void *cookie,
   return response_handler(cookie, NULL, 0, NULL, 0);
 }
 
+/*
+ * The cluster configuration handed out by "config get cluster", the way
+ * ElastiCache publishes its nodes for auto discovery. Every version gets
+ * its own entry, so clients may still be sending an older version while
+ * a new one is published.
+ */
+struct config_entry {
+  uint32_t refcount;
+  uint32_t flags;
+  uint32_t version;
+  size_t size;
+  char *data;
+};
+
+static const char cluster_config_name[]= "cluster";
+static pthread_mutex_t cluster_config_lock= PTHREAD_MUTEX_INITIALIZER;
+static struct config_entry *cluster_config= NULL;
+
+static void release_config_entry(const void *, // cookie
+                                 void *context)
+{
+  struct config_entry *entry= (struct config_entry*)context;
+  if (__sync_sub_and_fetch(&entry->refcount, 1) == 0)
+  {
+    free(entry);
+  }
+}
+
+static bool is_cluster_config(const void *key, uint16_t keylen)
+{
+  return keylen == sizeof(cluster_config_name) - 1 and
+         memcmp(key, cluster_config_name, keylen) == 0;
+}
+
+/* Room for "<version>\n" in front of the nodes, "\n" after them, and a NUL */
+#define CLUSTER_CONFIG_FRAMING sizeof("4294967295\n\n")
+
+/**
+ * Replace the cluster configuration
+ * @param numbered if true, data holds only the nodes, and the configuration
+ *        is framed with its version while the lock decides that version
+ * @return the version of the new configuration, or 0 if we ran out of memory
+ */
+static uint32_t publish_cluster_config(const void *data, size_t size,
+                                       uint32_t flags, uint32_t version,
+                                       bool numbered)
+{
+  struct config_entry *entry= (struct config_entry*)malloc(sizeof(*entry) + size +
+                                                           (numbered ? CLUSTER_CONFIG_FRAMING : 0));
+  if (entry == NULL)
+  {
+    return 0;
+  }
+
+  entry->refcount= 1;
+  entry->flags= flags;
+  entry->size= size;
+  entry->data= (char*)(entry + 1);
+  if (numbered == false)
+  {
+    memcpy(entry->data, data, size);
+  }
+
+  pthread_mutex_lock(&cluster_config_lock);
+  struct config_entry *old= cluster_config;
+  if (version == 0 or numbered)
+  {
+    version= (old == NULL) ? 1 : old->version + 1;
+  }
+
+  if (numbered)
+  {
+    size_t length= size_t(snprintf(entry->data, CLUSTER_CONFIG_FRAMING, "%u\n", version));
+    memcpy(entry->data + length, data, size);
+    entry->data[length + size]= '\n';
+    entry->size= length + size + 1;
+  }
+  entry->version= version;
+  cluster_config= entry;
+  pthread_mutex_unlock(&cluster_config_lock);
+
+  if (old != NULL)
+  {
+    release_config_entry(NULL, old);
+  }
+
+  return version;
+}
+
+uint32_t publish_cluster_nodes(const char *nodes, size_t length)
+{
+  return publish_cluster_config(nodes, length, 0, 0, true);
+}
+
+static protocol_binary_response_status config_get_handler(const void *cookie,
+                                                          const void *key,
+                                                          uint16_t keylen,
+                                                          memcached_binary_protocol_get_response_handler response_handler)
+{
+  if (is_cluster_config(key, keylen) == false)
+  {
+    return PROTOCOL_BINARY_RESPONSE_KEY_ENOENT;
+  }
+
+  pthread_mutex_lock(&cluster_config_lock);
+  struct config_entry *entry= cluster_config;
+  if (entry != NULL)
+  {
+    __sync_add_and_fetch(&entry->refcount, 1);
+  }
+  pthread_mutex_unlock(&cluster_config_lock);
+
+  if (entry == NULL)
+  {
+    return PROTOCOL_BINARY_RESPONSE_KEY_ENOENT;
+  }
+
+  /* The entry is released once it is sent */
+  memcached_protocol_client_reference_body(cookie, release_config_entry, entry);
+  return response_handler(cookie, key, keylen,
+                          entry->data, (uint32_t)entry->size, entry->flags,
+                          entry->version);
+}
+
+static protocol_binary_response_status config_set_handler(const void *, // cookie
+                                                          const void *key,
+                                                          uint16_t keylen,
+                                                          const void *data,
+                                                          uint32_t datalen,
+                                                          uint32_t flags)
+{
+  if (is_cluster_config(key, keylen) == false)
+  {
+    return PROTOCOL_BINARY_RESPONSE_EINVAL;
+  }
+
+  /* The configuration starts with its version number */
+  char buffer[16];
+  size_t length= std::min(sizeof(buffer) - 1, size_t(datalen));
+  memcpy(buffer, data, length);
+  buffer[length]= '\0';
+  uint32_t version= uint32_t(strtoul(buffer, NULL, 10));
+
+  if (publish_cluster_config(data, datalen, flags, version, false) == 0)
+  {
+    return PROTOCOL_BINARY_RESPONSE_ENOMEM;
+  }
+
+  return PROTOCOL_BINARY_RESPONSE_SUCCESS;
+}
+
 static protocol_binary_response_status version_handler(const void *cookie,
                                                        memcached_binary_protocol_version_response_handler response_handler)
 {
@@ -399,7 +671,7 @@ void initialize_interface_v1_handler(datadifferential::util::log_info_st& arg)
   log_file= &arg;
   memset(&interface_v1_impl, 0, sizeof(memcached_binary_protocol_callback_st));
 
-  interface_v1_impl.interface_version= MEMCACHED_PROTOCOL_HANDLER_V1;
+  interface_v1_impl.interface_version= MEMCACHED_PROTOCOL_HANDLER_V2;
   interface_v1_impl.interface.v1.add= add_handler;
   interface_v1_impl.interface.v1.append= append_handler;
   interface_v1_impl.interface.v1.decrement= decrement_handler;
@@ -414,4 +686,8 @@ void initialize_interface_v1_handler(datadifferential::util::log_info_st& arg)
   interface_v1_impl.interface.v1.set= set_handler;
   interface_v1_impl.interface.v1.stat= stat_handler;
   interface_v1_impl.interface.v1.version= version_handler;
+  interface_v1_impl.interface.v2.get_batch= get_batch_handler;
+  interface_v1_impl.interface.v2.set_batch= set_batch_handler;
+  interface_v1_impl.interface.v2.config_get= config_get_handler;
+  interface_v1_impl.interface.v2.config_set= config_set_handler;
 }
@@ -3,12 +3,15 @@
  * What is a library without an example to show you how to use the library?
  * This example use both interfaces to implement a small memcached server.
  * Please note that this is an exemple on how to use the library, not
- * an implementation of a scalable memcached server. If you look closely
- * at the example it isn't even multithreaded ;-)
+ * an implementation of a scalable memcached server. By default it runs
+ * all of the clients from a single libevent loop; with --threads it uses
+ * the server runtime in the library instead.
  *
  * With that in mind, let me give you some pointers into the source:
- *   storage.c/h       - Implements the item store for this server and not really
- *                       interesting for this example.
+ *   storage.c/h       - Implements the item store for this server: a hash table
+ *                       with a lock per segment and a slab allocator that
+ *                       evicts items once --memory-limit is reached. Not
+ *                       really interesting for this example.
  *   interface_v0.cc   - Shows an implementation of the memcached server by using
  *                       the "raw" access to the packets as they arrive
  *   interface_v1.cc   - Shows an implementation of the memcached server by using
@@ -16,6 +19,12 @@
  *   memcached_light.cc- This file sets up all of the sockets and run the main
  *                       message loop.
  *
+ * With --protocol it also answers "config get cluster" like ElastiCache does,
+ * so the auto discovery in libmemcached can be tried out locally. The nodes
+ * are read from the --cluster-config file (as "host|ip|port" separated by
+ * spaces or newlines), which is read again on SIGHUP to publish the next
+ * version. Clients may publish a configuration with "config set cluster".
+ *
  *
  * config.h is included so that I can use the ntohll/htonll on platforms that
  * doesn't have that (this is a private function inside libmemcached, so you
@@ -26,6 +35,7 @@
 #include <config.h>
 
 #include <libmemcachedprotocol-0.0/handler.h>
+#include <libmemcachedprotocol-0.0/server.h>
 #include <libmemcached/socket.hpp>
 #include <example/byteorder.h>
 #include "example/storage.h"
@@ -40,6 +50,7 @@ using namespace datadifferential;
 #include <event.h>
 
 #include <cassert>
+#include <cctype>
 #include <cerrno>
 #include <cstdio>
 #include <cstdlib>
@@ -47,6 +58,8 @@ using namespace datadifferential;
 #include <fcntl.h>
 #include <getopt.h>
 #include <iostream>
+#include <pthread.h>
+#include <signal.h>
 #include <sys/types.h>
 #include <unistd.h>
 
@@ -67,6 +80,7 @@ static int maxconns= 1024;
 
 static struct connection *socket_userdata_map;
 static struct event_base *event_base= NULL;
+static memcached_protocol_server_st *threaded_server= NULL;
 
 struct options_st {
   std::string pid_file;
@@ -74,10 +88,15 @@ struct options_st {
   std::string log_file;
   bool is_verbose;
   bool opt_daemon;
+  uint32_t threads;
+  size_t memory_limit;
+  std::string cluster_config;
 
   options_st() :
     service("9999"),
-    is_verbose(false)
+    is_verbose(false),
+    threads(0),
+    memory_limit(64)
   {
   }
 };
@@ -172,6 +191,20 @@ static void accept_handler(memcached_socket_t fd, short, void *arg)
   }
 #endif
 
+  /* The protocol handler reads until the socket runs dry */
+#ifdef WIN32
+  u_long arg= 1;
+  if (ioctlsocket(sock, FIONBIO, &arg) == SOCKET_ERROR)
+#else
+  int flags= fcntl(sock, F_GETFL, 0);
+  if (flags == -1 || fcntl(sock, F_SETFL, flags | O_NONBLOCK) == -1)
+#endif
+  {
+    perror("Failed to set nonblocking io");
+    closesocket(sock);
+    return;
+  }
+
   struct memcached_protocol_client_st* c= memcached_protocol_create_client((memcached_protocol_st*)server->userdata, sock);
   if (c == NULL)
   {
@@ -194,6 +227,137 @@ static void accept_handler(memcached_socket_t fd, short, void *arg)
   }
 }
 
+/**
+ * Publish the nodes listed in the --cluster-config file as the next version
+ * of the cluster configuration
+ * @param log_file where to report errors
+ * @return true if the file was published
+ */
+static bool load_cluster_config(util::log_info_st& log_file)
+{
+  FILE *fp= fopen(global_options.cluster_config.c_str(), "r");
+  if (fp == NULL)
+  {
+    std::string buffer("Failed to open ");
+    buffer+= global_options.cluster_config;
+    buffer+= ": ";
+    buffer+= strerror(errno);
+    log_file.write(util::VERBOSE_ERROR, buffer.c_str());
+    return false;
+  }
+
+  /* One line with all of the nodes, no matter how they are split up in the file */
+  std::string nodes;
+  int c;
+  while ((c= fgetc(fp)) != EOF)
+  {
+    if (isspace(c))
+    {
+      if (nodes.empty() == false and nodes[nodes.size() - 1] != ' ')
+      {
+        nodes.push_back(' ');
+      }
+    }
+    else
+    {
+      nodes.push_back(char(c));
+    }
+  }
+  fclose(fp);
+
+  if (nodes.empty() == false and nodes[nodes.size() - 1] == ' ')
+  {
+    nodes.erase(nodes.size() - 1);
+  }
+
+  uint32_t version= publish_cluster_nodes(nodes.data(), nodes.size());
+  if (version == 0)
+  {
+    log_file.write(util::VERBOSE_ERROR, "Failed to publish the cluster configuration");
+    return false;
+  }
+
+  char buffer[64];
+  snprintf(buffer, sizeof(buffer), "Published version %u of the cluster configuration", version);
+  log_file.write(util::VERBOSE_NOTICE, buffer);
+
+  return true;
+}
+
+/**
+ * Wait for SIGHUP, and publish the --cluster-config file again every time
+ * it arrives. The signal is blocked in all of the other threads.
+ */
+static void *cluster_config_thread(void *arg)
+{
+  util::log_info_st *log_file= (util::log_info_st*)arg;
+
+  sigset_t set;
+  sigemptyset(&set);
+  sigaddset(&set, SIGHUP);
+
+  while (true)
+  {
+    int sig;
+    if (sigwait(&set, &sig) == 0 and sig == SIGHUP)
+    {
+      (void)load_cluster_config(*log_file);
+    }
+  }
+
+  return NULL;
+}
+
+/**
+ * Stop the worker threads so that main() can clean up
+ */
+static void shutdown_handler(int)
+{
+  memcached_protocol_server_shutdown(threaded_server);
+}
+
+/**
+ * Serve all of the clients from the server runtime in the library
+ * @param log_file where to report errors
+ * @param protocol_handle the instance to copy into each worker thread
+ * @return true if the server ran until it was stopped
+ */
+static bool serve_threaded(util::log_info_st& log_file, memcached_protocol_st *protocol_handle)
+{
+  threaded_server= memcached_protocol_server_create(protocol_handle, global_options.threads);
+  if (threaded_server == NULL)
+  {
+    std::string buffer("memcached_protocol_server_create(): ");
+    buffer+= strerror(errno);
+    log_file.write(util::VERBOSE_ERROR, buffer.c_str());
+    return false;
+  }
+  memcached_protocol_server_set_verbose(threaded_server, global_options.is_verbose);
+
+  for (int xx= 0; xx < num_server_sockets; ++xx)
+  {
+    if (memcached_protocol_server_add_listener(threaded_server, server_sockets[xx]) == false)
+    {
+      log_file.write(util::VERBOSE_ERROR, "Failed to add listener");
+      closesocket(server_sockets[xx]);
+    }
+  }
+
+  signal(SIGINT, shutdown_handler);
+  signal(SIGTERM, shutdown_handler);
+
+  bool ret= memcached_protocol_server_run(threaded_server);
+  if (ret == false)
+  {
+    log_file.write(util::VERBOSE_ERROR, "Failed to start the worker threads");
+  }
+
+  memcached_protocol_server_destroy(threaded_server);
+  threaded_server= NULL;
+
+  return ret;
+}
+
 static bool server_socket(util::log_info_st& log_file, const std::string& service)
 {
   struct addrinfo *ai;
@@ -443,7 +607,10 @@ int main(int argc, char **argv)
       OPT_PORT,
       OPT_MAX_CONNECTIONS,
       OPT_LOGFILE,
-      OPT_PIDFILE
+      OPT_PIDFILE,
+      OPT_THREADS,
+      OPT_MEMORY_LIMIT,
+      OPT_CLUSTER_CONFIG
     };
 
     static struct option long_options[]=
@@ -457,6 +624,9 @@ int main(int argc, char **argv)
       { "max-connections", required_argument, NULL, OPT_MAX_CONNECTIONS },
       { "pid-file", required_argument, NULL, OPT_PIDFILE },
       { "log-file", required_argument, NULL, OPT_LOGFILE },
+      { "threads", required_argument, NULL, OPT_THREADS },
+      { "memory-limit", required_argument, NULL, OPT_MEMORY_LIMIT },
+      { "cluster-config", required_argument, NULL, OPT_CLUSTER_CONFIG },
       {0, 0, 0, 0}
     };
 
@@ -502,6 +672,18 @@ int main(int argc, char **argv)
         maxconns= atoi(optarg);
         break;
 
+      case OPT_THREADS:
+        global_options.threads= uint32_t(strtoul(optarg, NULL, 10));
+        break;
+
+      case OPT_MEMORY_LIMIT:
+        global_options.memory_limit= size_t(strtoul(optarg, NULL, 10));
+        break;
+
+      case OPT_CLUSTER_CONFIG:
+        global_options.cluster_config= optarg;
+        break;
+
       case OPT_HELP:  /* FALLTHROUGH */
         opt_help= true;
         break;
@@ -530,7 +712,7 @@ int main(int argc, char **argv)
     util::daemonize(false, true);
   }
 
-  if (initialize_storage() == false)
+  if (initialize_storage(global_options.memory_limit * 1024 * 1024) == false)
   {
     /* Error message already printed */
     return EXIT_FAILURE;
@@ -555,6 +737,27 @@ int main(int argc, char **argv)
   initialize_interface_v1_handler(log_file);
 
 
+  if (global_options.cluster_config.empty() == false)
+  {
+    if (load_cluster_config(log_file) == false)
+    {
+      return EXIT_FAILURE;
+    }
+
+    /* Block SIGHUP before any other threads are started, so they inherit it */
+    sigset_t set;
+    sigemptyset(&set);
+    sigaddset(&set, SIGHUP);
+    pthread_t thread;
+    if (pthread_sigmask(SIG_BLOCK, &set, NULL) != 0 or
+        pthread_create(&thread, NULL, cluster_config_thread, &log_file) != 0)
+    {
+      log_file.write(util::VERBOSE_ERROR, "Failed to start the thread reloading the cluster configuration");
+      return EXIT_FAILURE;
+    }
+    pthread_detach(thread);
+  }
+
   if (server_socket(log_file, global_options.service) == false)
   {
     return EXIT_FAILURE;
@@ -592,6 +795,26 @@ int main(int argc, char **argv)
   memcached_binary_protocol_set_callbacks(protocol_handle, interface);
   memcached_binary_protocol_set_pedantic(protocol_handle, true);
 
+  if (global_options.threads > 0)
+  {
+    if (global_options.opt_daemon)
+    {
+      if (util::daemon_is_ready(true) == false)
+      {
+        log_file.write(util::VERBOSE_ERROR, "Failed for util::daemon_is_ready()");
+        return EXIT_FAILURE;
+      }
+    }
+
+    if (serve_threaded(log_file, protocol_handle) == false)
+    {
+      return EXIT_FAILURE;
+    }
+    log_file.write(util::VERBOSE_NOTICE, "exiting");
+
+    return EXIT_SUCCESS;
+  }
+
   event_base= event_init();
   if (event_base == NULL)
   {
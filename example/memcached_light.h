@@ -42,3 +42,12 @@
 
 void initialize_interface_v0_handler(datadifferential::util::log_info_st&);
 void initialize_interface_v1_handler(datadifferential::util::log_info_st&);
+
+/**
+ * Publish a new version of the cluster configuration that the v1 interface
+ * hands out for "config get cluster"
+ * @param nodes the nodes in the cluster as "host|ip|port host|ip|port"
+ * @param length the length of nodes
+ * @return the version of the new configuration, or 0 on failure
+ */
+uint32_t publish_cluster_nodes(const char *nodes, size_t length);
@@ -0,0 +1,199 @@
+/* -*- Mode: C; tab-width: 2; c-basic-offset: 2; indent-tabs-mode: nil -*- */
+/**
+ * Measure how fast the protocol handler gets through the commands in the
+ * ASCII protocol. A prerecorded pipeline of commands is fed to a client
+ * over and over again through the IO functions of the instance, without
+ * any sockets involved, and the callbacks do as little work as possible.
+ * What is left is the time spent on finding the commands, splitting them
+ * up and building the responses.
+ *
+ *   parse_benchmark [rounds]
+ */
+
+#include <config.h>
+
+#include <libmemcachedprotocol-0.0/handler.h>
+
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <string>
+
+static std::string pipeline;
+static size_t commands= 0;
+static bool pipeline_sent= false;
+
+/* Hand out the whole pipeline, and then pretend that the socket runs dry */
+static ssize_t pipeline_recv(const void *, // cookie
+                             memcached_socket_t, // fd
+                             void *buf,
+                             size_t nbuf)
+{
+  if (pipeline_sent or nbuf < pipeline.size())
+  {
+    errno= EWOULDBLOCK;
+    return -1;
+  }
+
+  memcpy(buf, pipeline.data(), pipeline.size());
+  pipeline_sent= true;
+
+  return ssize_t(pipeline.size());
+}
+
+static ssize_t discard_send(const void *, // cookie
+                            memcached_socket_t, // fd
+                            const void *, // buf
+                            size_t nbuf)
+{
+  return ssize_t(nbuf);
+}
+
+static const char value[]= "0123456789abcdef";
+
+static protocol_binary_response_status get_handler(const void *cookie,
+                                                   const void *key,
+                                                   uint16_t keylen,
+                                                   memcached_binary_protocol_get_response_handler response_handler)
+{
+  return response_handler(cookie, key, keylen, value, uint32_t(sizeof(value) - 1), 0, 1);
+}
+
+static protocol_binary_response_status set_handler(const void *, // cookie
+                                                   const void *, // key
+                                                   uint16_t, // keylen
+                                                   const void *, // data
+                                                   uint32_t, // datalen
+                                                   uint32_t, // flags
+                                                   uint32_t, // exptime
+                                                   uint64_t, // cas
+                                                   uint64_t *result_cas)
+{
+  *result_cas= 1;
+  return PROTOCOL_BINARY_RESPONSE_SUCCESS;
+}
+
+static protocol_binary_response_status delete_handler(const void *, // cookie
+                                                      const void *, // key
+                                                      uint16_t, // keylen
+                                                      uint64_t) // cas
+{
+  return PROTOCOL_BINARY_RESPONSE_KEY_ENOENT;
+}
+
+static protocol_binary_response_status increment_handler(const void *, // cookie
+                                                         const void *, // key
+                                                         uint16_t, // keylen
+                                                         uint64_t delta,
+                                                         uint64_t, // initial
+                                                         uint32_t, // expiration
+                                                         uint64_t *result,
+                                                         uint64_t *result_cas)
+{
+  *result= delta;
+  *result_cas= 1;
+  return PROTOCOL_BINARY_RESPONSE_SUCCESS;
+}
+
+static void add_command(const std::string& command)
+{
+  pipeline+= command;
+  ++commands;
+}
+
+/* A mix of the commands a cache typically sees, mostly reads */
+static void record_pipeline(void)
+{
+  char buffer[256];
+
+  for (int x= 0; x < 1000; ++x)
+  {
+    snprintf(buffer, sizeof(buffer), "get user:%d:profile\r\n", x);
+    add_command(buffer);
+    snprintf(buffer, sizeof(buffer), "gets session:%d\r\n", x);
+    add_command(buffer);
+    snprintf(buffer, sizeof(buffer), "get page:%d:a page:%d:b page:%d:c\r\n", x, x, x);
+    add_command(buffer);
+
+    switch (x % 4)
+    {
+    case 0:
+      snprintf(buffer, sizeof(buffer), "set user:%d:profile 0 3600 %u\r\n%s\r\n",
+               x, unsigned(sizeof(value) - 1), value);
+      break;
+    case 1:
+      snprintf(buffer, sizeof(buffer), "set session:%d 32 0 %u noreply\r\n%s\r\n",
+               x, unsigned(sizeof(value) - 1), value);
+      break;
+    case 2:
+      snprintf(buffer, sizeof(buffer), "incr counter:%d 1\r\n", x);
+      break;
+    default:
+      snprintf(buffer, sizeof(buffer), "delete page:%d:a noreply\r\n", x);
+      break;
+    }
+    add_command(buffer);
+  }
+}
+
+int main(int argc, char *argv[])
+{
+  long rounds= 1000;
+  if (argc > 1)
+  {
+    rounds= strtol(argv[1], NULL, 10);
+  }
+
+  memcached_binary_protocol_callback_st callbacks;
+  memset(&callbacks, 0, sizeof(callbacks));
+  callbacks.interface_version= MEMCACHED_PROTOCOL_HANDLER_V1;
+  callbacks.interface.v1.get= get_handler;
+  callbacks.interface.v1.set= set_handler;
+  callbacks.interface.v1.delete_object= delete_handler;
+  callbacks.interface.v1.increment= increment_handler;
+
+  memcached_protocol_st *protocol_handle= memcached_protocol_create_instance();
+  if (protocol_handle == NULL)
+  {
+    fprintf(stderr, "Failed to create an instance of the protocol handler\n");
+    return EXIT_FAILURE;
+  }
+  memcached_binary_protocol_set_callbacks(protocol_handle, &callbacks);
+  memached_protocol_set_io_functions(protocol_handle, pipeline_recv, discard_send);
+
+  memcached_protocol_client_st *client= memcached_protocol_create_client(protocol_handle, 0);
+  if (client == NULL)
+  {
+    fprintf(stderr, "Failed to create a client\n");
+    return EXIT_FAILURE;
+  }
+
+  record_pipeline();
+
+  struct timespec start;
+  struct timespec stop;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  for (long x= 0; x < rounds; ++x)
+  {
+    pipeline_sent= false;
+    if (memcached_protocol_client_work(client) == MEMCACHED_PROTOCOL_ERROR_EVENT)
+    {
+      fprintf(stderr, "The client failed to process the pipeline\n");
+      return EXIT_FAILURE;
+    }
+  }
+  clock_gettime(CLOCK_MONOTONIC, &stop);
+
+  double elapsed= double(stop.tv_sec - start.tv_sec) + double(stop.tv_nsec - start.tv_nsec) / 1e9;
+  double total= double(commands) * double(rounds);
+  printf("%.0f commands in %.3f seconds: %.0f commands/sec (%.1f MB/sec)\n",
+         total, elapsed, total / elapsed,
+         double(pipeline.size()) * double(rounds) / elapsed / (1024 * 1024));
+
+  memcached_protocol_client_destroy(client);
+  memcached_protocol_destroy_instance(protocol_handle);
+
+  return EXIT_SUCCESS;
+}
@@ -1,168 +1,802 @@
 /* -*- Mode: C; tab-width: 2; c-basic-offset: 2; indent-tabs-mode: nil -*- */
+/**
+ * The item store of memcached_light.
+ *
+ * Items live in chunks carved out of pages of memory. Each page belongs
+ * to a size class, and an item goes into the smallest chunk that holds
+ * its header, key and value. Pages are handed out until the memory limit
+ * is reached, after which a class makes room by evicting one of its own
+ * items. A clock hand sweeps over the chunks of the class: an item that
+ * has been read since the hand last passed gets a second chance, the
+ * others (and any that have expired) are evicted. Items that are still
+ * referenced by a pending response are left alone.
+ *
+ * The items are found through a hash table split up in segments, each
+ * with its own lock. A segment is an open addressing table with linear
+ * probing. When it fills up it gets a new table, and the entries of the
+ * old one are moved over a few slots at a time by the operations that
+ * follow, so no single operation pays for the whole resize.
+ *
+ * Expired and flushed items are not looked for; they are removed when
+ * they are found by a lookup or by the clock hand.
+ *
+ * Lock order: a size class lock may be held while trying to take a
+ * segment lock, never the other way around. An item is therefore never
+ * freed while a segment lock is held.
+ */
 #include "config.h"
 #include <stdlib.h>
 #include <inttypes.h>
 #include <time.h>
 #include <stdbool.h>
 #include <string.h>
+#include <pthread.h>
 #include "storage.h"
 
-struct list_entry {
+/* Memory is handed to the size classes in pages of this size, which is
+ * also the largest item we can store */
+#define STORAGE_PAGE_SIZE (1024 * 1024)
+#define CHUNK_GROWTH_FACTOR 1.25
+#define MAX_SIZE_CLASSES 64
+
+/* The number of segments in the hash table (must be a power of two) */
+#define SEGMENT_BITS 5
+#define NUM_SEGMENTS (1 << SEGMENT_BITS)
+#define INITIAL_SEGMENT_SIZE 64
+/* The number of slots of an old table moved over per operation */
+#define MIGRATE_SLOTS 8
+
+/* Relative expiration times are limited to 30 days, like in memcached */
+#define MAX_RELATIVE_EXPIRATION (60 * 60 * 24 * 30)
+
+struct chunk {
+  /* Must be first, the item is handed out as the chunk */
   struct item item;
-  struct list_entry *next;
-  struct list_entry *prev;
+  /* The next chunk on the free list of the size class */
+  struct chunk *next_free;
+  /* When the item was stored */
+  time_t time;
+  uint32_t hash;
+  uint8_t size_class;
+  /* Handed out by the allocator (protected by the size class lock) */
+  bool in_use;
+  /* In the hash table (protected by the segment lock) */
+  bool linked;
+  /* Read since the clock hand passed (protected by the segment lock) */
+  bool accessed;
+};
+
+struct size_class {
+  pthread_mutex_t lock;
+  size_t chunk_size;
+  size_t chunks_per_page;
+  struct chunk *free_list;
+  char **pages;
+  size_t num_pages;
+  size_t max_pages;
+  /* The next chunk the clock hand looks at */
+  size_t hand;
 };
 
-static struct list_entry *root;
+struct slot {
+  uint32_t hash;
+  struct chunk *chunk;
+};
+
+struct segment {
+  pthread_mutex_t lock;
+  struct slot *slots;
+  size_t size;
+  /* Slots in the current table that are not empty (tombstones included) */
+  size_t used;
+  /* Items in the segment, in either table */
+  size_t count;
+  /* The table we are moving away from, if any */
+  struct slot *old_slots;
+  size_t old_size;
+  size_t migrated;
+} __attribute__((aligned(64)));
+
+/* Marks a slot that was emptied, so the probing carries on past it */
+static struct chunk tombstone;
+
+static struct size_class size_classes[MAX_SIZE_CLASSES];
+static int num_size_classes;
+static struct segment segments[NUM_SEGMENTS];
+
+static pthread_mutex_t memory_lock= PTHREAD_MUTEX_INITIALIZER;
+static size_t memory_limit;
+static size_t memory_used;
+
 static uint64_t cas;
+/* Items stored with a CAS value up to this one are flushed */
+static uint64_t flushed_cas;
+/* Items stored before this time are flushed once it has passed */
+static time_t oldest_live;
+
+static void free_chunk(struct chunk* chunk);
+
+static inline size_t align_size(size_t size)
+{
+  return (size + 7) & ~(size_t)7;
+}
 
-bool initialize_storage(void)
+bool initialize_storage(size_t limit)
 {
+  memory_limit= limit;
+
+  size_t size= align_size(sizeof(struct chunk) + 32);
+  while (num_size_classes < MAX_SIZE_CLASSES - 1 &&
+         size < STORAGE_PAGE_SIZE / CHUNK_GROWTH_FACTOR)
+  {
+    size_classes[num_size_classes++].chunk_size= size;
+    size= align_size((size_t)((double)size * CHUNK_GROWTH_FACTOR));
+  }
+  size_classes[num_size_classes++].chunk_size= STORAGE_PAGE_SIZE;
+
+  for (int x= 0; x < num_size_classes; ++x)
+  {
+    struct size_class *cls= &size_classes[x];
+    pthread_mutex_init(&cls->lock, NULL);
+    cls->chunks_per_page= STORAGE_PAGE_SIZE / cls->chunk_size;
+  }
+
+  for (int x= 0; x < NUM_SEGMENTS; ++x)
+  {
+    struct segment *seg= &segments[x];
+    pthread_mutex_init(&seg->lock, NULL);
+    seg->size= INITIAL_SEGMENT_SIZE;
+    seg->slots= (struct slot*)calloc(seg->size, sizeof(struct slot));
+    if (seg->slots == NULL)
+    {
+      return false;
+    }
+  }
+
   return true;
 }
 
 void shutdown_storage(void)
 {
-  /* Do nothing */
+  for (int x= 0; x < NUM_SEGMENTS; ++x)
+  {
+    free(segments[x].slots);
+    free(segments[x].old_slots);
+  }
+
+  for (int x= 0; x < num_size_classes; ++x)
+  {
+    for (size_t y= 0; y < size_classes[x].num_pages; ++y)
+    {
+      free(size_classes[x].pages[y]);
+    }
+    free(size_classes[x].pages);
+  }
 }
 
-void put_item(struct item* item)
+/*
+** **********************************************************************
+** The slab allocator
+** **********************************************************************
+*/
+
+static int size_class_for(size_t size)
 {
-  struct list_entry* entry= (struct list_entry*)item;
+  int low= 0;
+  int high= num_size_classes - 1;
 
-  update_cas(item);
+  if (size > size_classes[high].chunk_size)
+  {
+    return -1;
+  }
 
-  if (root == NULL)
+  while (low < high)
   {
-    entry->next= entry->prev= entry;
+    int mid= (low + high) / 2;
+    if (size_classes[mid].chunk_size < size)
+    {
+      low= mid + 1;
+    }
+    else
+    {
+      high= mid;
+    }
   }
-  else
+
+  return low;
+}
+
+static inline struct chunk* chunk_at(struct size_class *cls, size_t index)
+{
+  char *page= cls->pages[index / cls->chunks_per_page];
+  return (struct chunk*)(page + (index % cls->chunks_per_page) * cls->chunk_size);
+}
+
+/**
+ * Add a page of chunks to a size class. Every class may get its first
+ * page even if we're at the memory limit, so that items of all sizes can
+ * be stored.
+ */
+static bool grow_size_class(struct size_class *cls)
+{
+  pthread_mutex_lock(&memory_lock);
+  bool reserved= cls->num_pages == 0 || memory_used + STORAGE_PAGE_SIZE <= memory_limit;
+  if (reserved)
+  {
+    memory_used+= STORAGE_PAGE_SIZE;
+  }
+  pthread_mutex_unlock(&memory_lock);
+
+  if (reserved == false)
+  {
+    return false;
+  }
+
+  if (cls->num_pages == cls->max_pages)
+  {
+    size_t max_pages= cls->max_pages == 0 ? 16 : cls->max_pages * 2;
+    char **pages= (char**)realloc(cls->pages, max_pages * sizeof(char*));
+    if (pages == NULL)
+    {
+      reserved= false;
+    }
+    else
+    {
+      cls->pages= pages;
+      cls->max_pages= max_pages;
+    }
+  }
+
+  char *page= reserved ? (char*)malloc(STORAGE_PAGE_SIZE) : NULL;
+  if (page == NULL)
   {
-    entry->prev= root->prev;
-    entry->next= root;
-    entry->prev->next= entry;
-    entry->next->prev= entry;
+    pthread_mutex_lock(&memory_lock);
+    memory_used-= STORAGE_PAGE_SIZE;
+    pthread_mutex_unlock(&memory_lock);
+    return false;
   }
 
-  root= entry;
+  cls->pages[cls->num_pages++]= page;
+  for (size_t x= cls->chunks_per_page; x > 0; --x)
+  {
+    struct chunk *chunk= (struct chunk*)(page + (x - 1) * cls->chunk_size);
+    chunk->in_use= false;
+    chunk->next_free= cls->free_list;
+    cls->free_list= chunk;
+  }
+
+  return true;
 }
 
-struct item* get_item(const void* key, size_t nkey)
+/*
+** **********************************************************************
+** The hash table
+** **********************************************************************
+*/
+
+static uint32_t hash_key(const void* key, size_t nkey)
 {
-  struct list_entry *walker= root;
+  /* FNV-1a, with the upper half folded in */
+  const unsigned char *ptr= (const unsigned char*)key;
+  uint64_t hash= 14695981039346656037ULL;
 
-  if (root == NULL)
+  for (size_t x= 0; x < nkey; ++x)
   {
-    return NULL;
+    hash^= ptr[x];
+    hash*= 1099511628211ULL;
+  }
+
+  return (uint32_t)(hash ^ (hash >> 32));
+}
+
+static inline struct segment* segment_for(uint32_t hash)
+{
+  return &segments[hash >> (32 - SEGMENT_BITS)];
+}
+
+static bool is_live(const struct chunk* chunk, time_t now)
+{
+  if (chunk->item.exp != 0 && chunk->item.exp <= now)
+  {
+    return false;
   }
 
-  do
+  if (chunk->item.cas <= __atomic_load_n(&flushed_cas, __ATOMIC_RELAXED))
   {
-    if (((struct item*)walker)->nkey == nkey &&
-        memcmp(((struct item*)walker)->key, key, nkey) == 0)
+    return false;
+  }
+
+  time_t oldest= __atomic_load_n(&oldest_live, __ATOMIC_RELAXED);
+  return oldest == 0 || oldest > now || chunk->time >= oldest;
+}
+
+static struct slot* probe(struct slot* slots, size_t size, uint32_t hash,
+                          const void* key, size_t nkey)
+{
+  size_t mask= size - 1;
+
+  for (size_t x= hash & mask, n= 0; n < size; x= (x + 1) & mask, ++n)
+  {
+    struct chunk *chunk= slots[x].chunk;
+    if (chunk == NULL)
+    {
+      break;
+    }
+
+    if (chunk != &tombstone && slots[x].hash == hash &&
+        chunk->item.nkey == nkey && memcmp(chunk->item.key, key, nkey) == 0)
     {
-      return (struct item*)walker;
+      return &slots[x];
     }
-    walker= walker->next;
-  } while (walker != root);
+  }
 
   return NULL;
 }
 
-struct item* create_item(const void* key, size_t nkey, const void* data,
-                         size_t size, uint32_t flags, time_t exp)
+static struct slot* find_slot(struct segment* seg, uint32_t hash,
+                              const void* key, size_t nkey)
+{
+  struct slot *slot= probe(seg->slots, seg->size, hash, key, nkey);
+  if (slot == NULL && seg->old_slots != NULL)
+  {
+    slot= probe(seg->old_slots, seg->old_size, hash, key, nkey);
+  }
+
+  return slot;
+}
+
+/* Put a chunk in the first free slot of the current table */
+static void insert_slot(struct segment* seg, uint32_t hash, struct chunk* chunk)
 {
-  struct item* ret= (struct item*)calloc(1, sizeof(struct list_entry));
+  size_t mask= seg->size - 1;
+  size_t x= hash & mask;
+
+  while (seg->slots[x].chunk != NULL && seg->slots[x].chunk != &tombstone)
+  {
+    x= (x + 1) & mask;
+  }
+
+  if (seg->slots[x].chunk == NULL)
+  {
+    ++seg->used;
+  }
+  seg->slots[x].hash= hash;
+  seg->slots[x].chunk= chunk;
+}
 
-  if (ret != NULL)
+static void migrate(struct segment* seg, size_t nslots)
+{
+  while (seg->old_slots != NULL && nslots-- > 0)
   {
-    ret->key= malloc(nkey);
-    if (size > 0)
+    struct slot *slot= &seg->old_slots[seg->migrated];
+    if (slot->chunk != NULL && slot->chunk != &tombstone)
     {
-      ret->data= malloc(size);
+      insert_slot(seg, slot->hash, slot->chunk);
+      slot->chunk= &tombstone;
     }
 
-    if (ret->key == NULL || (size > 0 && ret->data == NULL))
+    if (++seg->migrated == seg->old_size)
     {
-      free(ret->key);
-      free(ret->data);
-      free(ret);
-      return NULL;
+      free(seg->old_slots);
+      seg->old_slots= NULL;
     }
+  }
+}
+
+/* Start moving to a new table if the current one is getting full */
+static void grow_segment(struct segment* seg)
+{
+  if ((seg->used + 1) * 4 <= seg->size * 3)
+  {
+    return;
+  }
+
+  /* Finish the previous resize before we start on the next one */
+  migrate(seg, seg->old_size);
+
+  /* The table may just be full of tombstones */
+  size_t size= seg->size;
+  if (seg->count * 2 >= seg->size)
+  {
+    size*= 2;
+  }
+
+  struct slot *slots= (struct slot*)calloc(size, sizeof(struct slot));
+  if (slots == NULL)
+  {
+    /* Keep on using the old table, it still has room */
+    return;
+  }
+
+  seg->old_slots= seg->slots;
+  seg->old_size= seg->size;
+  seg->migrated= 0;
+  /* get_items() peeks at these for prefetching without the lock */
+  __atomic_store_n(&seg->slots, slots, __ATOMIC_RELAXED);
+  __atomic_store_n(&seg->size, size, __ATOMIC_RELAXED);
+  seg->used= 0;
+}
 
-    memcpy(ret->key, key, nkey);
-    if (data != NULL)
+static void unlink_slot(struct segment* seg, struct slot* slot)
+{
+  slot->chunk->linked= false;
+  slot->chunk= &tombstone;
+  --seg->count;
+}
+
+/**
+ * Find a live item, and remove it if it turns out to be expired
+ * @param expired where to return an item that was removed, which
+ *                should be released once the segment lock is released
+ */
+static struct chunk* lookup(struct segment* seg, uint32_t hash,
+                            const void* key, size_t nkey,
+                            struct chunk** expired)
+{
+  migrate(seg, MIGRATE_SLOTS);
+
+  struct slot *slot= find_slot(seg, hash, key, nkey);
+  if (slot == NULL)
+  {
+    return NULL;
+  }
+
+  struct chunk *chunk= slot->chunk;
+  if (is_live(chunk, time(NULL)) == false)
+  {
+    unlink_slot(seg, slot);
+    *expired= chunk;
+    return NULL;
+  }
+
+  return chunk;
+}
+
+/* Link in an item, and return the item it replaced (if any) */
+static struct chunk* link_chunk(struct segment* seg, struct chunk* chunk)
+{
+  struct chunk *old= NULL;
+
+  migrate(seg, MIGRATE_SLOTS);
+
+  /* Someone may have stored the key since the caller looked for it */
+  struct slot *slot= find_slot(seg, chunk->hash, chunk->item.key, chunk->item.nkey);
+  if (slot != NULL)
+  {
+    old= slot->chunk;
+    unlink_slot(seg, slot);
+  }
+
+  grow_segment(seg);
+
+  update_cas(&chunk->item);
+  chunk->time= time(NULL);
+  chunk->linked= true;
+  chunk->accessed= true;
+  __sync_add_and_fetch(&chunk->item.refcount, 1);
+
+  insert_slot(seg, chunk->hash, chunk);
+  ++seg->count;
+
+  return old;
+}
+
+/*
+** **********************************************************************
+** Eviction
+** **********************************************************************
+*/
+
+/**
+ * Sweep the clock hand over the chunks of a size class until we find an
+ * item to evict. The caller holds the size class lock.
+ * @return the evicted chunk, ready for reuse
+ */
+static struct chunk* evict_chunk(struct size_class *cls)
+{
+  size_t total= cls->num_pages * cls->chunks_per_page;
+  time_t now= time(NULL);
+
+  /* Two rounds clear all of the second chances */
+  for (size_t n= 0; n <= total * 2; ++n)
+  {
+    struct chunk *chunk= chunk_at(cls, cls->hand);
+    cls->hand= (cls->hand + 1) % total;
+
+    if (chunk->in_use == false)
+    {
+      continue;
+    }
+
+    /* Don't wait on the segment, there are plenty of other candidates */
+    struct segment *seg= segment_for(chunk->hash);
+    if (pthread_mutex_trylock(&seg->lock) != 0)
+    {
+      continue;
+    }
+
+    bool evict= false;
+    /* Skip items that are being created, or still being sent somewhere */
+    if (chunk->linked &&
+        __atomic_load_n(&chunk->item.refcount, __ATOMIC_ACQUIRE) == 1)
     {
-      memcpy(ret->data, data, size);
+      if (chunk->accessed && is_live(chunk, now))
+      {
+        chunk->accessed= false;
+      }
+      else
+      {
+        unlink_slot(seg, find_slot(seg, chunk->hash, chunk->item.key, chunk->item.nkey));
+        chunk->item.refcount= 0;
+        evict= true;
+      }
     }
+    pthread_mutex_unlock(&seg->lock);
 
-    ret->nkey= nkey;
-    ret->size= size;
-    ret->flags= flags;
-    ret->exp= exp;
+    if (evict)
+    {
+      return chunk;
+    }
   }
 
-  return ret;
+  return NULL;
 }
 
-bool delete_item(const void* key, size_t nkey)
+static struct chunk* alloc_chunk(size_t size, uint32_t hash)
+{
+  int id= size_class_for(size);
+  if (id == -1)
+  {
+    return NULL;
+  }
+
+  struct size_class *cls= &size_classes[id];
+  pthread_mutex_lock(&cls->lock);
+  if (cls->free_list == NULL && grow_size_class(cls) == false)
+  {
+    struct chunk *chunk= evict_chunk(cls);
+    if (chunk != NULL)
+    {
+      chunk->next_free= cls->free_list;
+      cls->free_list= chunk;
+    }
+  }
+
+  struct chunk *chunk= cls->free_list;
+  if (chunk != NULL)
+  {
+    cls->free_list= chunk->next_free;
+    chunk->in_use= true;
+    chunk->linked= false;
+    chunk->accessed= false;
+    chunk->hash= hash;
+    chunk->size_class= (uint8_t)id;
+    chunk->item.refcount= 1;
+  }
+  pthread_mutex_unlock(&cls->lock);
+
+  return chunk;
+}
+
+static void free_chunk(struct chunk* chunk)
+{
+  struct size_class *cls= &size_classes[chunk->size_class];
+
+  pthread_mutex_lock(&cls->lock);
+  chunk->in_use= false;
+  chunk->next_free= cls->free_list;
+  cls->free_list= chunk;
+  pthread_mutex_unlock(&cls->lock);
+}
+
+/*
+** **********************************************************************
+** The item interface
+** **********************************************************************
+*/
+
+void put_item(struct item* item)
+{
+  struct chunk *chunk= (struct chunk*)item;
+  struct segment *seg= segment_for(chunk->hash);
+
+  pthread_mutex_lock(&seg->lock);
+  struct chunk *old= link_chunk(seg, chunk);
+  pthread_mutex_unlock(&seg->lock);
+
+  if (old != NULL)
+  {
+    release_item(&old->item);
+  }
+}
+
+void put_items(struct item* const* items, size_t count)
 {
-  struct item* item= get_item(key, nkey);
-  bool ret= false;
+  /* The replaced items are unlinked, so chain them up on their free list link */
+  struct chunk* replaced= NULL;
 
-  if (item)
+  for (size_t x= 0; x < count; ++x)
   {
-    /* remove from linked list */
-    struct list_entry *entry= (struct list_entry*)item;
+    struct chunk *chunk= (struct chunk*)items[x];
+    struct segment *seg= segment_for(chunk->hash);
 
-    if (entry->next == entry)
+    pthread_mutex_lock(&seg->lock);
+    struct chunk *old= link_chunk(seg, chunk);
+    pthread_mutex_unlock(&seg->lock);
+
+    if (old != NULL)
     {
-      /* Only one object in the list */
-      root= NULL;
+      old->next_free= replaced;
+      replaced= old;
     }
-    else
+  }
+
+  while (replaced != NULL)
+  {
+    struct chunk *tmp= replaced;
+    replaced= replaced->next_free;
+    release_item(&tmp->item);
+  }
+}
+
+struct item* get_item(const void* key, size_t nkey)
+{
+  uint32_t hash= hash_key(key, nkey);
+  struct segment *seg= segment_for(hash);
+  struct chunk *expired= NULL;
+
+  pthread_mutex_lock(&seg->lock);
+  struct chunk *chunk= lookup(seg, hash, key, nkey, &expired);
+  if (chunk != NULL)
+  {
+    chunk->accessed= true;
+    __sync_add_and_fetch(&chunk->item.refcount, 1);
+  }
+  pthread_mutex_unlock(&seg->lock);
+
+  if (expired != NULL)
+  {
+    release_item(&expired->item);
+  }
+
+  return chunk == NULL ? NULL : &chunk->item;
+}
+
+void get_items(const void* const* keys, const size_t* nkeys, size_t count,
+               struct item** items)
+{
+  uint32_t hashes[64];
+
+  for (size_t offset= 0; offset < count; offset+= 64)
+  {
+    size_t batch= count - offset < 64 ? count - offset : 64;
+
+    /*
+     * Hash all of the keys and start fetching their slots, so the
+     * lookups below don't have to wait for memory one by one
+     */
+    for (size_t x= 0; x < batch; ++x)
+    {
+      hashes[x]= hash_key(keys[offset + x], nkeys[offset + x]);
+      struct segment *seg= segment_for(hashes[x]);
+      struct slot *slots= __atomic_load_n(&seg->slots, __ATOMIC_RELAXED);
+      size_t size= __atomic_load_n(&seg->size, __ATOMIC_RELAXED);
+      __builtin_prefetch(&slots[hashes[x] & (size - 1)]);
+    }
+
+    for (size_t x= 0; x < batch; ++x)
     {
-      /* ensure that we don't loose track of the root, and this will
-       * change the start position for the next search ;-) */
-      root= entry->next;
-      entry->prev->next= entry->next;
-      entry->next->prev= entry->prev;
+      struct segment *seg= segment_for(hashes[x]);
+      struct chunk *expired= NULL;
+
+      pthread_mutex_lock(&seg->lock);
+      struct chunk *chunk= lookup(seg, hashes[x], keys[offset + x], nkeys[offset + x], &expired);
+      if (chunk != NULL)
+      {
+        chunk->accessed= true;
+        __sync_add_and_fetch(&chunk->item.refcount, 1);
+      }
+      pthread_mutex_unlock(&seg->lock);
+
+      if (expired != NULL)
+      {
+        release_item(&expired->item);
+      }
+      items[offset + x]= chunk == NULL ? NULL : &chunk->item;
     }
+  }
+}
 
-    free(item->key);
-    free(item->data);
-    free(item);
-    ret= true;
+struct item* create_item(const void* key, size_t nkey, const void* data,
+                         size_t size, uint32_t flags, time_t exp)
+{
+  struct chunk *chunk= alloc_chunk(sizeof(struct chunk) + size + nkey,
+                                   hash_key(key, nkey));
+  if (chunk == NULL)
+  {
+    return NULL;
+  }
+
+  /* The value goes first, so that it is aligned */
+  struct item *ret= &chunk->item;
+  ret->data= chunk + 1;
+  ret->key= (char*)ret->data + size;
+  memcpy(ret->key, key, nkey);
+  if (data != NULL)
+  {
+    memcpy(ret->data, data, size);
   }
 
+  if (exp != 0 && exp <= MAX_RELATIVE_EXPIRATION)
+  {
+    exp+= time(NULL);
+  }
+
+  ret->cas= 0;
+  ret->nkey= nkey;
+  ret->size= size;
+  ret->flags= flags;
+  ret->exp= exp;
+
   return ret;
 }
 
-void flush(uint32_t /* when */)
+bool delete_item(const void* key, size_t nkey)
 {
-  /* remove the complete linked list */
-  if (root == NULL)
+  uint32_t hash= hash_key(key, nkey);
+  struct segment *seg= segment_for(hash);
+  struct chunk *expired= NULL;
+
+  pthread_mutex_lock(&seg->lock);
+  struct chunk *chunk= lookup(seg, hash, key, nkey, &expired);
+  if (chunk != NULL)
   {
-    return;
+    unlink_slot(seg, find_slot(seg, hash, key, nkey));
+  }
+  pthread_mutex_unlock(&seg->lock);
+
+  if (expired != NULL)
+  {
+    release_item(&expired->item);
   }
 
-  root->prev->next= NULL;
-  while (root != NULL)
+  if (chunk == NULL)
   {
-    struct item* tmp= (struct item*)root;
-    root= root->next;
+    return false;
+  }
+
+  /* Anyone still holding on to the item frees it */
+  release_item(&chunk->item);
 
-    free(tmp->key);
-    free(tmp->data);
-    free(tmp);
+  return true;
+}
+
+void flush(uint32_t when)
+{
+  if (when == 0)
+  {
+    __atomic_store_n(&flushed_cas, __atomic_load_n(&cas, __ATOMIC_RELAXED), __ATOMIC_RELAXED);
+  }
+  else
+  {
+    time_t oldest= (time_t)when;
+    if (when <= MAX_RELATIVE_EXPIRATION)
+    {
+      oldest+= time(NULL);
+    }
+    __atomic_store_n(&oldest_live, oldest, __ATOMIC_RELAXED);
   }
 }
 
 void update_cas(struct item* item)
 {
-  item->cas= ++cas;
+  item->cas= __sync_add_and_fetch(&cas, 1);
 }
 
-void release_item(struct item* /* item */)
+void release_item(struct item* item)
 {
+  if (__sync_sub_and_fetch(&item->refcount, 1) == 0)
+  {
+    free_chunk((struct chunk*)item);
+  }
 }
@@ -9,14 +9,23 @@ struct item {
   size_t size;
   uint32_t flags;
   time_t exp;
+  /* One for the storage while it is linked, one per get_item() */
+  uint32_t refcount;
 };
 
-bool initialize_storage(void);
+/**
+ * @param memory_limit the number of bytes the items may take up, after
+ *                     which the least recently used ones are evicted
+ */
+bool initialize_storage(size_t memory_limit);
 void shutdown_storage(void);
 
 void update_cas(struct item* item);
 void put_item(struct item* item);
+void put_items(struct item* const* items, size_t count);
 struct item* get_item(const void* key, size_t nkey);
+void get_items(const void* const* keys, const size_t* nkeys, size_t count,
+               struct item** items);
 struct item* create_item(const void* key, size_t nkey, const void *data,
                          size_t size, uint32_t flags, time_t exp);
 bool delete_item(const void* key, size_t nkey);
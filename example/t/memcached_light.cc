@@ -135,6 +135,33 @@ static test_return_t max_connections_file_TEST(void *)
   return TEST_SUCCESS;
 }
 
+static test_return_t threads_TEST(void *)
+{
+  const char *args[]= { "--help", "--threads=4", 0 };
+
+  test_compare(EXIT_SUCCESS, exec_cmdline(executable, args, true));
+
+  return TEST_SUCCESS;
+}
+
+static test_return_t memory_limit_TEST(void *)
+{
+  const char *args[]= { "--help", "--memory-limit=16", 0 };
+
+  test_compare(EXIT_SUCCESS, exec_cmdline(executable, args, true));
+
+  return TEST_SUCCESS;
+}
+
+static test_return_t cluster_config_TEST(void *)
+{
+  const char *args[]= { "--help", "--cluster-config=/dev/null", 0 };
+
+  test_compare(EXIT_SUCCESS, exec_cmdline(executable, args, true));
+
+  return TEST_SUCCESS;
+}
+
 typedef test_return_t (*libmemcached_test_callback_fn)(memcached_st *);
 
 static test_return_t _runner_default(libmemcached_test_callback_fn func, void *object)
@@ -176,6 +203,9 @@ test_st cmdline_option_TESTS[] ={
   {"--pid-file", true, pid_file_TEST },
   {"--log-file", true, log_file_TEST },
   {"--max-connections", true, max_connections_file_TEST },
+  {"--threads", true, threads_TEST },
+  {"--memory-limit", true, memory_limit_TEST },
+  {"--cluster-config", true, cluster_config_TEST },
   {0, 0, 0}
 };
 
@@ -99,9 +99,75 @@ HASHKIT_API
   hashkit_string_st *hashkit_decrypt(hashkit_st *,
                                      const char* source, size_t source_length);
 
+/*
+  The calls below never allocate, the caller hands in the buffer to write
+  to. hashkit_encrypt_update() consumes whole blocks and returns how many
+  bytes it used, hashkit_encrypt_final() pads whatever is left (always less
+  than a block) and writes the last block. Together they write exactly
+  hashkit_encrypt_length() bytes.
+*/
+HASHKIT_API
+  size_t hashkit_encrypt_length(const hashkit_st *, size_t source_length);
+
+HASHKIT_API
+  size_t hashkit_encrypt_update(const hashkit_st *,
+                                const char* source, size_t source_length, char* destination);
+
+HASHKIT_API
+  size_t hashkit_encrypt_final(const hashkit_st *,
+                               const char* source, size_t source_length, char* destination);
+
+/*
+  destination must have room for source_length bytes, and may be source
+  itself.
+*/
+HASHKIT_API
+  bool hashkit_decrypt_buffer(const hashkit_st *,
+                              const char* source, size_t source_length,
+                              char* destination, size_t *destination_length);
+
+/*
+  Authenticated encryption, AES-256-GCM with a random nonce per value. The
+  output is the cipher text followed by a trailer holding the format
+  version, the nonce and the tag, hashkit_gcm_length() bytes in all. aad
+  is authenticated but not encrypted. Values are split across up to
+  threads threads, 0 or 1 keeps everything on the calling thread.
+  destination may be source when decrypting, on failure it is zeroed.
+*/
+HASHKIT_API
+  size_t hashkit_gcm_length(const hashkit_st *, size_t source_length);
+
+HASHKIT_API
+  hashkit_return_t hashkit_gcm_encrypt(const hashkit_st *,
+                                       const char* aad, size_t aad_length,
+                                       const char* source, size_t source_length,
+                                       char* destination, uint32_t threads);
+
+HASHKIT_API
+  hashkit_return_t hashkit_gcm_decrypt(const hashkit_st *,
+                                       const char* aad, size_t aad_length,
+                                       const char* source, size_t source_length,
+                                       char* destination, size_t *destination_length,
+                                       uint32_t threads);
+
 HASHKIT_API
   bool hashkit_key(hashkit_st *, const char *key, const size_t key_length);
 
+/*
+  Which AES implementation the key runs on, "table", "aesni" or "vaes", or
+  NULL if no key has been set.
+*/
+HASHKIT_API
+  const char *hashkit_encrypt_engine(const hashkit_st *);
+
+/*
+  Run the key on another engine than the fastest one the CPU has, which is
+  how the tests check the engines against each other. Returns
+  HASHKIT_FAILURE for an engine the CPU lacks.
+*/
+HASHKIT_API
+  hashkit_return_t hashkit_encrypt_set_engine(hashkit_st *, const char *engine);
+
 #ifdef __cplusplus
 } // extern "C"
 #endif
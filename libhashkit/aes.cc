@@ -41,6 +41,15 @@
 
 #include <cstring>
 
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+# include <cpuid.h>
+# include <immintrin.h>
+# define HAVE_AES_NI 1
+# if defined(bit_VAES) && defined(bit_AVX2)
+#  define HAVE_VAES 1
+# endif
+#endif
+
 #define AES_KEY_LENGTH 256               /* 128, 192, 256 */
 #define AES_BLOCK_SIZE 16
 
@@ -50,6 +59,17 @@ enum encrypt_t
   AES_DECRYPT
 };
 
+/*
+  Which implementation the key was set up for, the hardware ones are only
+  picked if the CPU we are running on has the instructions.
+*/
+enum aes_engine_t
+{
+  AES_ENGINE_TABLE,
+  AES_ENGINE_AES_NI,
+  AES_ENGINE_VAES
+};
+
 struct _key_t {
   int nr;
   uint32_t rk[4*(AES_MAXNR +1)];
@@ -58,8 +78,384 @@ struct _key_t {
 struct aes_key_t {
   _key_t encode_key;
   _key_t decode_key;
+  aes_engine_t engine;
+  /* The same schedules laid out as bytes, which is what AESENC/AESDEC load */
+  uint8_t encode_schedule[AES_BLOCK_SIZE*(AES_MAXNR +1)];
+  uint8_t decode_schedule[AES_BLOCK_SIZE*(AES_MAXNR +1)];
 };
 
+static void aes_schedule_bytes(uint8_t *destination, const _key_t& key)
+{
+  for (int x= 0; x < 4*(key.nr +1); x++)
+  {
+    destination[4*x]= uint8_t(key.rk[x] >> 24);
+    destination[4*x +1]= uint8_t(key.rk[x] >> 16);
+    destination[4*x +2]= uint8_t(key.rk[x] >> 8);
+    destination[4*x +3]= uint8_t(key.rk[x]);
+  }
+}
+
+#if defined(HAVE_AES_NI)
+static aes_engine_t aes_engine(void)
+{
+  unsigned int eax, ebx, ecx, edx;
+  if (__get_cpuid(1, &eax, &ebx, &ecx, &edx) == 0)
+  {
+    return AES_ENGINE_TABLE;
+  }
+
+  if ((ecx & bit_AES) == 0 or (edx & bit_SSE2) == 0)
+  {
+    return AES_ENGINE_TABLE;
+  }
+
+#if defined(HAVE_VAES)
+  // AVX state has to be enabled by the OS before we can touch a ymm register
+  if ((ecx & bit_OSXSAVE) and (ecx & bit_AVX))
+  {
+    uint32_t xcr0_low, xcr0_high;
+    __asm__ ("xgetbv" : "=a" (xcr0_low), "=d" (xcr0_high) : "c" (0));
+    (void)xcr0_high;
+
+    unsigned int leaf7_ebx, leaf7_ecx;
+    if ((xcr0_low & 0x6) == 0x6 and __get_cpuid_max(0, NULL) >= 7)
+    {
+      __cpuid_count(7, 0, eax, leaf7_ebx, leaf7_ecx, edx);
+      if ((leaf7_ebx & bit_AVX2) and (leaf7_ecx & bit_VAES))
+      {
+        return AES_ENGINE_VAES;
+      }
+    }
+  }
+#endif
+
+  return AES_ENGINE_AES_NI;
+}
+#endif
+
+static const char *aes_engine_names[]= { "table", "aesni", "vaes" };
+
+static aes_engine_t aes_best_engine(void)
+{
+#if defined(HAVE_AES_NI)
+  return aes_engine();
+#else
+  return AES_ENGINE_TABLE;
+#endif
+}
+
+#if defined(HAVE_AES_NI)
+/*
+  Eight independent blocks are kept in flight so that the latency of each
+  AESENC is hidden behind the other seven.
+*/
+__attribute__((target("aes,sse2")))
+static void aes_ni_encrypt(const aes_key_t *_aes_key,
+                           const uint8_t *source, uint8_t *destination, size_t num_blocks)
+{
+  const int nr= _aes_key->encode_key.nr;
+  __m128i rk[AES_MAXNR +1];
+  for (int x= 0; x <= nr; x++)
+  {
+    rk[x]= _mm_loadu_si128((const __m128i*)(_aes_key->encode_schedule +AES_BLOCK_SIZE*x));
+  }
+
+  for (; num_blocks >= 8; num_blocks-= 8)
+  {
+    __m128i b0= _mm_xor_si128(_mm_loadu_si128((const __m128i*)source), rk[0]);
+    __m128i b1= _mm_xor_si128(_mm_loadu_si128((const __m128i*)source +1), rk[0]);
+    __m128i b2= _mm_xor_si128(_mm_loadu_si128((const __m128i*)source +2), rk[0]);
+    __m128i b3= _mm_xor_si128(_mm_loadu_si128((const __m128i*)source +3), rk[0]);
+    __m128i b4= _mm_xor_si128(_mm_loadu_si128((const __m128i*)source +4), rk[0]);
+    __m128i b5= _mm_xor_si128(_mm_loadu_si128((const __m128i*)source +5), rk[0]);
+    __m128i b6= _mm_xor_si128(_mm_loadu_si128((const __m128i*)source +6), rk[0]);
+    __m128i b7= _mm_xor_si128(_mm_loadu_si128((const __m128i*)source +7), rk[0]);
+
+    for (int x= 1; x < nr; x++)
+    {
+      b0= _mm_aesenc_si128(b0, rk[x]);
+      b1= _mm_aesenc_si128(b1, rk[x]);
+      b2= _mm_aesenc_si128(b2, rk[x]);
+      b3= _mm_aesenc_si128(b3, rk[x]);
+      b4= _mm_aesenc_si128(b4, rk[x]);
+      b5= _mm_aesenc_si128(b5, rk[x]);
+      b6= _mm_aesenc_si128(b6, rk[x]);
+      b7= _mm_aesenc_si128(b7, rk[x]);
+    }
+
+    _mm_storeu_si128((__m128i*)destination, _mm_aesenclast_si128(b0, rk[nr]));
+    _mm_storeu_si128((__m128i*)destination +1, _mm_aesenclast_si128(b1, rk[nr]));
+    _mm_storeu_si128((__m128i*)destination +2, _mm_aesenclast_si128(b2, rk[nr]));
+    _mm_storeu_si128((__m128i*)destination +3, _mm_aesenclast_si128(b3, rk[nr]));
+    _mm_storeu_si128((__m128i*)destination +4, _mm_aesenclast_si128(b4, rk[nr]));
+    _mm_storeu_si128((__m128i*)destination +5, _mm_aesenclast_si128(b5, rk[nr]));
+    _mm_storeu_si128((__m128i*)destination +6, _mm_aesenclast_si128(b6, rk[nr]));
+    _mm_storeu_si128((__m128i*)destination +7, _mm_aesenclast_si128(b7, rk[nr]));
+    source+= 8*AES_BLOCK_SIZE;
+    destination+= 8*AES_BLOCK_SIZE;
+  }
+
+  for (; num_blocks; num_blocks--)
+  {
+    __m128i b0= _mm_xor_si128(_mm_loadu_si128((const __m128i*)source), rk[0]);
+    for (int x= 1; x < nr; x++)
+    {
+      b0= _mm_aesenc_si128(b0, rk[x]);
+    }
+    _mm_storeu_si128((__m128i*)destination, _mm_aesenclast_si128(b0, rk[nr]));
+    source+= AES_BLOCK_SIZE;
+    destination+= AES_BLOCK_SIZE;
+  }
+}
+
+__attribute__((target("aes,sse2")))
+static void aes_ni_decrypt(const aes_key_t *_aes_key,
+                           const uint8_t *source, uint8_t *destination, size_t num_blocks)
+{
+  const int nr= _aes_key->decode_key.nr;
+  __m128i rk[AES_MAXNR +1];
+  for (int x= 0; x <= nr; x++)
+  {
+    rk[x]= _mm_loadu_si128((const __m128i*)(_aes_key->decode_schedule +AES_BLOCK_SIZE*x));
+  }
+
+  for (; num_blocks >= 8; num_blocks-= 8)
+  {
+    __m128i b0= _mm_xor_si128(_mm_loadu_si128((const __m128i*)source), rk[0]);
+    __m128i b1= _mm_xor_si128(_mm_loadu_si128((const __m128i*)source +1), rk[0]);
+    __m128i b2= _mm_xor_si128(_mm_loadu_si128((const __m128i*)source +2), rk[0]);
+    __m128i b3= _mm_xor_si128(_mm_loadu_si128((const __m128i*)source +3), rk[0]);
+    __m128i b4= _mm_xor_si128(_mm_loadu_si128((const __m128i*)source +4), rk[0]);
+    __m128i b5= _mm_xor_si128(_mm_loadu_si128((const __m128i*)source +5), rk[0]);
+    __m128i b6= _mm_xor_si128(_mm_loadu_si128((const __m128i*)source +6), rk[0]);
+    __m128i b7= _mm_xor_si128(_mm_loadu_si128((const __m128i*)source +7), rk[0]);
+
+    for (int x= 1; x < nr; x++)
+    {
+      b0= _mm_aesdec_si128(b0, rk[x]);
+      b1= _mm_aesdec_si128(b1, rk[x]);
+      b2= _mm_aesdec_si128(b2, rk[x]);
+      b3= _mm_aesdec_si128(b3, rk[x]);
+      b4= _mm_aesdec_si128(b4, rk[x]);
+      b5= _mm_aesdec_si128(b5, rk[x]);
+      b6= _mm_aesdec_si128(b6, rk[x]);
+      b7= _mm_aesdec_si128(b7, rk[x]);
+    }
+
+    _mm_storeu_si128((__m128i*)destination, _mm_aesdeclast_si128(b0, rk[nr]));
+    _mm_storeu_si128((__m128i*)destination +1, _mm_aesdeclast_si128(b1, rk[nr]));
+    _mm_storeu_si128((__m128i*)destination +2, _mm_aesdeclast_si128(b2, rk[nr]));
+    _mm_storeu_si128((__m128i*)destination +3, _mm_aesdeclast_si128(b3, rk[nr]));
+    _mm_storeu_si128((__m128i*)destination +4, _mm_aesdeclast_si128(b4, rk[nr]));
+    _mm_storeu_si128((__m128i*)destination +5, _mm_aesdeclast_si128(b5, rk[nr]));
+    _mm_storeu_si128((__m128i*)destination +6, _mm_aesdeclast_si128(b6, rk[nr]));
+    _mm_storeu_si128((__m128i*)destination +7, _mm_aesdeclast_si128(b7, rk[nr]));
+    source+= 8*AES_BLOCK_SIZE;
+    destination+= 8*AES_BLOCK_SIZE;
+  }
+
+  for (; num_blocks; num_blocks--)
+  {
+    __m128i b0= _mm_xor_si128(_mm_loadu_si128((const __m128i*)source), rk[0]);
+    for (int x= 1; x < nr; x++)
+    {
+      b0= _mm_aesdec_si128(b0, rk[x]);
+    }
+    _mm_storeu_si128((__m128i*)destination, _mm_aesdeclast_si128(b0, rk[nr]));
+    source+= AES_BLOCK_SIZE;
+    destination+= AES_BLOCK_SIZE;
+  }
+}
+#endif
+
+#if defined(HAVE_VAES)
+/*
+  VAES runs the same rounds on two blocks per ymm register, sixteen blocks
+  per pass. Whatever is left over goes through the 128 bit code.
+*/
+__attribute__((target("aes,vaes,avx2")))
+static size_t aes_vaes_encrypt(const aes_key_t *_aes_key,
+                               const uint8_t *source, uint8_t *destination, size_t num_blocks)
+{
+  const int nr= _aes_key->encode_key.nr;
+  __m256i rk[AES_MAXNR +1];
+  for (int x= 0; x <= nr; x++)
+  {
+    rk[x]= _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*)(_aes_key->encode_schedule +AES_BLOCK_SIZE*x)));
+  }
+
+  size_t done= 0;
+  for (; num_blocks -done >= 16; done+= 16)
+  {
+    const __m256i *in= (const __m256i*)(source +AES_BLOCK_SIZE*done);
+    __m256i *out= (__m256i*)(destination +AES_BLOCK_SIZE*done);
+
+    __m256i b0= _mm256_xor_si256(_mm256_loadu_si256(in), rk[0]);
+    __m256i b1= _mm256_xor_si256(_mm256_loadu_si256(in +1), rk[0]);
+    __m256i b2= _mm256_xor_si256(_mm256_loadu_si256(in +2), rk[0]);
+    __m256i b3= _mm256_xor_si256(_mm256_loadu_si256(in +3), rk[0]);
+    __m256i b4= _mm256_xor_si256(_mm256_loadu_si256(in +4), rk[0]);
+    __m256i b5= _mm256_xor_si256(_mm256_loadu_si256(in +5), rk[0]);
+    __m256i b6= _mm256_xor_si256(_mm256_loadu_si256(in +6), rk[0]);
+    __m256i b7= _mm256_xor_si256(_mm256_loadu_si256(in +7), rk[0]);
+
+    for (int x= 1; x < nr; x++)
+    {
+      b0= _mm256_aesenc_epi128(b0, rk[x]);
+      b1= _mm256_aesenc_epi128(b1, rk[x]);
+      b2= _mm256_aesenc_epi128(b2, rk[x]);
+      b3= _mm256_aesenc_epi128(b3, rk[x]);
+      b4= _mm256_aesenc_epi128(b4, rk[x]);
+      b5= _mm256_aesenc_epi128(b5, rk[x]);
+      b6= _mm256_aesenc_epi128(b6, rk[x]);
+      b7= _mm256_aesenc_epi128(b7, rk[x]);
+    }
+
+    _mm256_storeu_si256(out, _mm256_aesenclast_epi128(b0, rk[nr]));
+    _mm256_storeu_si256(out +1, _mm256_aesenclast_epi128(b1, rk[nr]));
+    _mm256_storeu_si256(out +2, _mm256_aesenclast_epi128(b2, rk[nr]));
+    _mm256_storeu_si256(out +3, _mm256_aesenclast_epi128(b3, rk[nr]));
+    _mm256_storeu_si256(out +4, _mm256_aesenclast_epi128(b4, rk[nr]));
+    _mm256_storeu_si256(out +5, _mm256_aesenclast_epi128(b5, rk[nr]));
+    _mm256_storeu_si256(out +6, _mm256_aesenclast_epi128(b6, rk[nr]));
+    _mm256_storeu_si256(out +7, _mm256_aesenclast_epi128(b7, rk[nr]));
+  }
+  _mm256_zeroupper();
+
+  return done;
+}
+
+__attribute__((target("aes,vaes,avx2")))
+static size_t aes_vaes_decrypt(const aes_key_t *_aes_key,
+                               const uint8_t *source, uint8_t *destination, size_t num_blocks)
+{
+  const int nr= _aes_key->decode_key.nr;
+  __m256i rk[AES_MAXNR +1];
+  for (int x= 0; x <= nr; x++)
+  {
+    rk[x]= _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*)(_aes_key->decode_schedule +AES_BLOCK_SIZE*x)));
+  }
+
+  size_t done= 0;
+  for (; num_blocks -done >= 16; done+= 16)
+  {
+    const __m256i *in= (const __m256i*)(source +AES_BLOCK_SIZE*done);
+    __m256i *out= (__m256i*)(destination +AES_BLOCK_SIZE*done);
+
+    __m256i b0= _mm256_xor_si256(_mm256_loadu_si256(in), rk[0]);
+    __m256i b1= _mm256_xor_si256(_mm256_loadu_si256(in +1), rk[0]);
+    __m256i b2= _mm256_xor_si256(_mm256_loadu_si256(in +2), rk[0]);
+    __m256i b3= _mm256_xor_si256(_mm256_loadu_si256(in +3), rk[0]);
+    __m256i b4= _mm256_xor_si256(_mm256_loadu_si256(in +4), rk[0]);
+    __m256i b5= _mm256_xor_si256(_mm256_loadu_si256(in +5), rk[0]);
+    __m256i b6= _mm256_xor_si256(_mm256_loadu_si256(in +6), rk[0]);
+    __m256i b7= _mm256_xor_si256(_mm256_loadu_si256(in +7), rk[0]);
+
+    for (int x= 1; x < nr; x++)
+    {
+      b0= _mm256_aesdec_epi128(b0, rk[x]);
+      b1= _mm256_aesdec_epi128(b1, rk[x]);
+      b2= _mm256_aesdec_epi128(b2, rk[x]);
+      b3= _mm256_aesdec_epi128(b3, rk[x]);
+      b4= _mm256_aesdec_epi128(b4, rk[x]);
+      b5= _mm256_aesdec_epi128(b5, rk[x]);
+      b6= _mm256_aesdec_epi128(b6, rk[x]);
+      b7= _mm256_aesdec_epi128(b7, rk[x]);
+    }
+
+    _mm256_storeu_si256(out, _mm256_aesdeclast_epi128(b0, rk[nr]));
+    _mm256_storeu_si256(out +1, _mm256_aesdeclast_epi128(b1, rk[nr]));
+    _mm256_storeu_si256(out +2, _mm256_aesdeclast_epi128(b2, rk[nr]));
+    _mm256_storeu_si256(out +3, _mm256_aesdeclast_epi128(b3, rk[nr]));
+    _mm256_storeu_si256(out +4, _mm256_aesdeclast_epi128(b4, rk[nr]));
+    _mm256_storeu_si256(out +5, _mm256_aesdeclast_epi128(b5, rk[nr]));
+    _mm256_storeu_si256(out +6, _mm256_aesdeclast_epi128(b6, rk[nr]));
+    _mm256_storeu_si256(out +7, _mm256_aesdeclast_epi128(b7, rk[nr]));
+  }
+  _mm256_zeroupper();
+
+  return done;
+}
+#endif
+
+/*
+  ECB over whole blocks. Every block is read before it is written, so
+  source and destination may be the same buffer.
+*/
+static void aes_encrypt_blocks(const aes_key_t *_aes_key,
+                               const uint8_t *source, uint8_t *destination, size_t num_blocks)
+{
+  switch (_aes_key->engine)
+  {
+#if defined(HAVE_VAES)
+  case AES_ENGINE_VAES:
+    if (num_blocks >= 16)
+    {
+      size_t done= aes_vaes_encrypt(_aes_key, source, destination, num_blocks);
+      aes_ni_encrypt(_aes_key, source +AES_BLOCK_SIZE*done, destination +AES_BLOCK_SIZE*done, num_blocks -done);
+      return;
+    }
+    // Too short to fill the wide registers
+    aes_ni_encrypt(_aes_key, source, destination, num_blocks);
+    return;
+#endif
+
+#if defined(HAVE_AES_NI)
+  case AES_ENGINE_AES_NI:
+    aes_ni_encrypt(_aes_key, source, destination, num_blocks);
+    return;
+#endif
+
+  case AES_ENGINE_TABLE:
+  default:
+    break;
+  }
+
+  for (size_t x= num_blocks; x > 0; x--)
+  {
+    rijndaelEncrypt(_aes_key->encode_key.rk, _aes_key->encode_key.nr, source, destination);
+    source+= AES_BLOCK_SIZE;
+    destination+= AES_BLOCK_SIZE;
+  }
+}
+
+static void aes_decrypt_blocks(const aes_key_t *_aes_key,
+                               const uint8_t *source, uint8_t *destination, size_t num_blocks)
+{
+  switch (_aes_key->engine)
+  {
+#if defined(HAVE_VAES)
+  case AES_ENGINE_VAES:
+    if (num_blocks >= 16)
+    {
+      size_t done= aes_vaes_decrypt(_aes_key, source, destination, num_blocks);
+      aes_ni_decrypt(_aes_key, source +AES_BLOCK_SIZE*done, destination +AES_BLOCK_SIZE*done, num_blocks -done);
+      return;
+    }
+    // Too short to fill the wide registers
+    aes_ni_decrypt(_aes_key, source, destination, num_blocks);
+    return;
+#endif
+
+#if defined(HAVE_AES_NI)
+  case AES_ENGINE_AES_NI:
+    aes_ni_decrypt(_aes_key, source, destination, num_blocks);
+    return;
+#endif
+
+  case AES_ENGINE_TABLE:
+  default:
+    break;
+  }
+
+  for (size_t x= num_blocks; x > 0; x--)
+  {
+    rijndaelDecrypt(_aes_key->decode_key.rk, _aes_key->decode_key.nr, source, destination);
+    source+= AES_BLOCK_SIZE;
+    destination+= AES_BLOCK_SIZE;
+  }
+}
+
 aes_key_t* aes_create_key(const char *key, const size_t key_length)
 {
   aes_key_t* _aes_key= (aes_key_t*)calloc(1, sizeof(aes_key_t));
@@ -84,11 +480,40 @@ aes_key_t* aes_create_key(const char *key, const size_t key_length)
 
     _aes_key->decode_key.nr= rijndaelKeySetupDec(_aes_key->decode_key.rk, rkey, AES_KEY_LENGTH);
     _aes_key->encode_key.nr= rijndaelKeySetupEnc(_aes_key->encode_key.rk, rkey, AES_KEY_LENGTH);
+
+    /*
+      rijndaelKeySetupDec() already produces the equivalent inverse cipher
+      schedule that AESDEC expects, it only needs to be laid out as bytes.
+    */
+    aes_schedule_bytes(_aes_key->encode_schedule, _aes_key->encode_key);
+    aes_schedule_bytes(_aes_key->decode_schedule, _aes_key->decode_key);
+
+    _aes_key->engine= aes_best_engine();
   }
 
   return _aes_key;
 }
 
+const char *aes_engine_name(const aes_key_t *_aes_key)
+{
+  return aes_engine_names[_aes_key->engine];
+}
+
+bool aes_set_engine(aes_key_t *_aes_key, const char *name)
+{
+  aes_engine_t best= aes_best_engine();
+  for (int x= AES_ENGINE_TABLE; x <= int(best); x++)
+  {
+    if (strcmp(name, aes_engine_names[x]) == 0)
+    {
+      _aes_key->engine= aes_engine_t(x);
+      return true;
+    }
+  }
+
+  return false;
+}
+
 aes_key_t* aes_clone_key(aes_key_t *_aes_key)
 {
   if (_aes_key == NULL)
@@ -105,80 +530,178 @@ aes_key_t* aes_clone_key(aes_key_t *_aes_key)
   return _aes_clone_key;
 }
 
-hashkit_string_st* aes_encrypt(aes_key_t *_aes_key,
-                               const char* source, size_t source_length)
+void aes_encrypt_block(const aes_key_t *_aes_key, const uint8_t source[16], uint8_t destination[16])
 {
-  if (_aes_key == NULL)
+  aes_encrypt_blocks(_aes_key, source, destination, 1);
+}
+
+/*
+  Counter blocks are built a batch at a time so that they go through the
+  same wide ECB code as everything else.
+*/
+#define AES_CTR_BATCH 32
+
+void aes_ctr(const aes_key_t *_aes_key, const uint8_t nonce[12], uint32_t counter,
+             const uint8_t *source, uint8_t *destination, size_t length)
+{
+  uint8_t counters[AES_CTR_BATCH*AES_BLOCK_SIZE];
+  uint8_t keystream[AES_CTR_BATCH*AES_BLOCK_SIZE];
+
+  while (length)
   {
-    return NULL;
+    size_t num_blocks= (length +AES_BLOCK_SIZE -1)/AES_BLOCK_SIZE;
+    if (num_blocks > AES_CTR_BATCH)
+    {
+      num_blocks= AES_CTR_BATCH;
+    }
+
+    for (size_t x= 0; x < num_blocks; x++, counter++)
+    {
+      uint8_t *block= counters +AES_BLOCK_SIZE*x;
+      memcpy(block, nonce, 12);
+      block[12]= uint8_t(counter >> 24);
+      block[13]= uint8_t(counter >> 16);
+      block[14]= uint8_t(counter >> 8);
+      block[15]= uint8_t(counter);
+    }
+    aes_encrypt_blocks(_aes_key, counters, keystream, num_blocks);
+
+    size_t batch_length= AES_BLOCK_SIZE*num_blocks;
+    if (batch_length > length)
+    {
+      batch_length= length;
+    }
+
+    size_t x= 0;
+    for (; x +sizeof(uint64_t) <= batch_length; x+= sizeof(uint64_t))
+    {
+      uint64_t word, key_word;
+      memcpy(&word, source +x, sizeof(word));
+      memcpy(&key_word, keystream +x, sizeof(key_word));
+      word^= key_word;
+      memcpy(destination +x, &word, sizeof(word));
+    }
+    for (; x < batch_length; x++)
+    {
+      destination[x]= source[x] ^ keystream[x];
+    }
+
+    source+= batch_length;
+    destination+= batch_length;
+    length-= batch_length;
   }
+}
 
-  size_t num_blocks= source_length/AES_BLOCK_SIZE;
+size_t aes_encrypt_length(size_t source_length)
+{
+  return AES_BLOCK_SIZE*(source_length/AES_BLOCK_SIZE +1);
+}
 
-  hashkit_string_st* destination= hashkit_string_create(source_length);
-  if (destination)
+size_t aes_encrypt_update(const aes_key_t *_aes_key,
+                          const char* source, size_t source_length, char* destination)
+{
+  if (_aes_key == NULL)
   {
-    char *dest= hashkit_string_c_str_mutable(destination);
+    return 0;
+  }
 
-    for (size_t x= num_blocks; x > 0; x--)   /* Encode complete blocks */
-    { 
-      rijndaelEncrypt(_aes_key->encode_key.rk, _aes_key->encode_key.nr, (const uint8_t*) source,
-                      (uint8_t*) dest);
-      source+= AES_BLOCK_SIZE;
-      dest+= AES_BLOCK_SIZE;
-    }
+  size_t num_blocks= source_length/AES_BLOCK_SIZE;
+  aes_encrypt_blocks(_aes_key, (const uint8_t*) source, (uint8_t*) destination, num_blocks);
+
+  return AES_BLOCK_SIZE*num_blocks;
+}
 
-    uint8_t block[AES_BLOCK_SIZE];
-    char pad_len= AES_BLOCK_SIZE - (source_length - AES_BLOCK_SIZE*num_blocks);
-    memcpy(block, source, 16 -pad_len);
-    memset(block + AES_BLOCK_SIZE -pad_len, pad_len, pad_len);
-    rijndaelEncrypt(_aes_key->encode_key.rk, _aes_key->encode_key.nr, block, (uint8_t*) dest);
-    hashkit_string_set_length(destination, AES_BLOCK_SIZE*(num_blocks + 1));
+size_t aes_encrypt_final(const aes_key_t *_aes_key,
+                         const char* source, size_t source_length, char* destination)
+{
+  if (_aes_key == NULL or source_length >= AES_BLOCK_SIZE)
+  {
+    return 0;
   }
 
-  return destination;
+  uint8_t block[AES_BLOCK_SIZE];
+  char pad_len= char(AES_BLOCK_SIZE -source_length);
+  memcpy(block, source, source_length);
+  memset(block + source_length, pad_len, pad_len);
+  aes_encrypt_blocks(_aes_key, block, (uint8_t*) destination, 1);
+
+  return AES_BLOCK_SIZE;
 }
 
-hashkit_string_st* aes_decrypt(aes_key_t *_aes_key,
-                               const char* source, size_t source_length)
+bool aes_decrypt_buffer(const aes_key_t *_aes_key,
+                        const char* source, size_t source_length,
+                        char* destination, size_t& destination_length)
 {
   if (_aes_key == NULL)
   {
-    return NULL;
+    return false;
   }
 
   size_t num_blocks= source_length/AES_BLOCK_SIZE;
   if ((source_length != num_blocks*AES_BLOCK_SIZE) or num_blocks ==0 )
+  {
+    return false;
+  }
+
+  // The last block is decrypted on the side, it has the padding in it
+  uint8_t block[AES_BLOCK_SIZE];
+  aes_decrypt_blocks(_aes_key, (const uint8_t*) source +AES_BLOCK_SIZE*(num_blocks -1), block, 1);
+
+  /* Use last char in the block as size */
+  unsigned int pad_len= (unsigned int) (unsigned char) block[AES_BLOCK_SIZE-1];
+  if (pad_len > AES_BLOCK_SIZE)
+  {
+    return false;
+  }
+
+  /* We could also check whole padding but we do not really need this */
+
+  aes_decrypt_blocks(_aes_key, (const uint8_t*) source, (uint8_t*) destination, num_blocks -1);
+  memcpy(destination +AES_BLOCK_SIZE*(num_blocks -1), block, AES_BLOCK_SIZE - pad_len);
+  destination_length= AES_BLOCK_SIZE*num_blocks - pad_len;
+
+  return true;
+}
+
+hashkit_string_st* aes_encrypt(aes_key_t *_aes_key,
+                               const char* source, size_t source_length)
+{
+  if (_aes_key == NULL)
   {
     return NULL;
   }
 
-  hashkit_string_st* destination= hashkit_string_create(source_length);
+  hashkit_string_st* destination= hashkit_string_create(aes_encrypt_length(source_length));
   if (destination)
   {
     char *dest= hashkit_string_c_str_mutable(destination);
 
-    for (size_t x = num_blocks-1; x > 0; x--)
-    {
-      rijndaelDecrypt(_aes_key->decode_key.rk, _aes_key->decode_key.nr, (const uint8_t*) source, (uint8_t*) dest);
-      source+= AES_BLOCK_SIZE;
-      dest+= AES_BLOCK_SIZE;
-    }
+    size_t length= aes_encrypt_update(_aes_key, source, source_length, dest);
+    length+= aes_encrypt_final(_aes_key, source +length, source_length -length, dest +length);
+    hashkit_string_set_length(destination, length);
+  }
+
+  return destination;
+}
 
-    uint8_t block[AES_BLOCK_SIZE];
-    rijndaelDecrypt(_aes_key->decode_key.rk, _aes_key->decode_key.nr, (const uint8_t*) source, block);
-    /* Use last char in the block as size */
-    unsigned int pad_len= (unsigned int) (unsigned char) block[AES_BLOCK_SIZE-1];
-    if (pad_len > AES_BLOCK_SIZE)
+hashkit_string_st* aes_decrypt(aes_key_t *_aes_key,
+                               const char* source, size_t source_length)
+{
+  if (_aes_key == NULL)
+  {
+    return NULL;
+  }
+
+  hashkit_string_st* destination= hashkit_string_create(source_length);
+  if (destination)
+  {
+    size_t length;
+    if (aes_decrypt_buffer(_aes_key, source, source_length, hashkit_string_c_str_mutable(destination), length) == false)
     {
       hashkit_string_free(destination);
       return NULL;
     }
-
-    /* We could also check whole padding but we do not really need this */
-
-    memcpy(dest, block, AES_BLOCK_SIZE - pad_len);
-    hashkit_string_set_length(destination, AES_BLOCK_SIZE*num_blocks - pad_len);
+    hashkit_string_set_length(destination, length);
   }
 
   return destination;
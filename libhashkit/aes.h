@@ -44,6 +44,53 @@ hashkit_string_st* aes_encrypt(aes_key_t* _aes_key,
 hashkit_string_st* aes_decrypt(aes_key_t* _aes_key,
                                const char* source, size_t source_length);
 
+/* Length of the ciphertext for a value of source_length bytes */
+size_t aes_encrypt_length(size_t source_length);
+
+/* Encrypt the whole blocks of source, returns how many bytes were consumed */
+size_t aes_encrypt_update(const aes_key_t* _aes_key,
+                          const char* source, size_t source_length, char* destination);
+
+/* Pad and encrypt the last, partial, block */
+size_t aes_encrypt_final(const aes_key_t* _aes_key,
+                         const char* source, size_t source_length, char* destination);
+
+bool aes_decrypt_buffer(const aes_key_t* _aes_key,
+                        const char* source, size_t source_length,
+                        char* destination, size_t& destination_length);
+
+/* A single raw block, no padding */
+void aes_encrypt_block(const aes_key_t* _aes_key, const uint8_t source[16], uint8_t destination[16]);
+
+/*
+  XOR length bytes with the key stream of nonce || counter, counter being
+  incremented as a 32 bit big endian number for every block.
+*/
+void aes_ctr(const aes_key_t* _aes_key, const uint8_t nonce[12], uint32_t counter,
+             const uint8_t* source, uint8_t* destination, size_t length);
+
+/* Version byte, nonce and tag that follow a GCM encrypted value */
+#define AES_GCM_TRAILER_SIZE (1 +12 +16)
+
+size_t aes_gcm_length(size_t source_length);
+
+bool aes_gcm_encrypt(const aes_key_t* _aes_key,
+                     const char* aad, size_t aad_length,
+                     const char* source, size_t source_length,
+                     char* destination, uint32_t threads);
+
+bool aes_gcm_decrypt(const aes_key_t* _aes_key,
+                     const char* aad, size_t aad_length,
+                     const char* source, size_t source_length,
+                     char* destination, size_t& destination_length,
+                     uint32_t threads);
+
 aes_key_t* aes_create_key(const char *key, const size_t key_length);
 
 aes_key_t* aes_clone_key(aes_key_t* _aes_key);
+
+/* "table", "aesni" or "vaes" */
+const char *aes_engine_name(const aes_key_t* _aes_key);
+
+/* Switch the key to the named engine, false if the CPU lacks it */
+bool aes_set_engine(aes_key_t* _aes_key, const char *name);
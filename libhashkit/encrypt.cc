@@ -49,6 +49,104 @@ hashkit_string_st *hashkit_decrypt(hashkit_st *kit,
   return aes_decrypt(static_cast<aes_key_t*>(kit->_key), source, source_length);
 }
 
+size_t hashkit_encrypt_length(const hashkit_st *, size_t source_length)
+{
+  return aes_encrypt_length(source_length);
+}
+
+size_t hashkit_encrypt_update(const hashkit_st *kit,
+                              const char* source, size_t source_length, char* destination)
+{
+  return aes_encrypt_update(static_cast<const aes_key_t*>(kit->_key), source, source_length, destination);
+}
+
+size_t hashkit_encrypt_final(const hashkit_st *kit,
+                             const char* source, size_t source_length, char* destination)
+{
+  return aes_encrypt_final(static_cast<const aes_key_t*>(kit->_key), source, source_length, destination);
+}
+
+bool hashkit_decrypt_buffer(const hashkit_st *kit,
+                            const char* source, size_t source_length,
+                            char* destination, size_t *destination_length)
+{
+  if (destination_length == NULL)
+  {
+    return false;
+  }
+
+  return aes_decrypt_buffer(static_cast<const aes_key_t*>(kit->_key), source, source_length, destination, *destination_length);
+}
+
+size_t hashkit_gcm_length(const hashkit_st *, size_t source_length)
+{
+  return aes_gcm_length(source_length);
+}
+
+hashkit_return_t hashkit_gcm_encrypt(const hashkit_st *kit,
+                                     const char* aad, size_t aad_length,
+                                     const char* source, size_t source_length,
+                                     char* destination, uint32_t threads)
+{
+  if (kit->_key == NULL or destination == NULL)
+  {
+    return HASHKIT_INVALID_ARGUMENT;
+  }
+
+  if (aes_gcm_encrypt(static_cast<const aes_key_t*>(kit->_key), aad, aad_length,
+                      source, source_length, destination, threads) == false)
+  {
+    return HASHKIT_FAILURE;
+  }
+
+  return HASHKIT_SUCCESS;
+}
+
+hashkit_return_t hashkit_gcm_decrypt(const hashkit_st *kit,
+                                     const char* aad, size_t aad_length,
+                                     const char* source, size_t source_length,
+                                     char* destination, size_t *destination_length,
+                                     uint32_t threads)
+{
+  if (kit->_key == NULL or destination == NULL or destination_length == NULL)
+  {
+    return HASHKIT_INVALID_ARGUMENT;
+  }
+
+  if (aes_gcm_decrypt(static_cast<const aes_key_t*>(kit->_key), aad, aad_length,
+                      source, source_length, destination, *destination_length, threads) == false)
+  {
+    return HASHKIT_FAILURE;
+  }
+
+  return HASHKIT_SUCCESS;
+}
+
+const char *hashkit_encrypt_engine(const hashkit_st *kit)
+{
+  if (kit->_key == NULL)
+  {
+    return NULL;
+  }
+
+  return aes_engine_name(static_cast<const aes_key_t*>(kit->_key));
+}
+
+hashkit_return_t hashkit_encrypt_set_engine(hashkit_st *kit, const char *engine)
+{
+  if (kit->_key == NULL or engine == NULL)
+  {
+    return HASHKIT_INVALID_ARGUMENT;
+  }
+
+  if (aes_set_engine(static_cast<aes_key_t*>(kit->_key), engine) == false)
+  {
+    return HASHKIT_FAILURE;
+  }
+
+  return HASHKIT_SUCCESS;
+}
+
 bool hashkit_key(hashkit_st *kit, const char *key, const size_t key_length)
 {
   if (kit->_key)
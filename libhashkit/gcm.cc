@@ -0,0 +1,593 @@
+/*  vim:expandtab:shiftwidth=2:tabstop=2:smarttab:
+ * 
+ *  Libhashkit library
+ *
+ *  Copyright (C) 2011-2012 Data Differential, http://datadifferential.com/
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are
+ *  met:
+ *
+ *      * Redistributions of source code must retain the above copyright
+ *  notice, this list of conditions and the following disclaimer.
+ *
+ *      * Redistributions in binary form must reproduce the above
+ *  copyright notice, this list of conditions and the following disclaimer
+ *  in the documentation and/or other materials provided with the
+ *  distribution.
+ *
+ *      * The names of its contributors may not be used to endorse or
+ *  promote products derived from this software without specific prior
+ *  written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *  A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *  OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *  SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *  LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *  DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *  THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *  OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+/*
+  AES-256-GCM value envelope.
+
+  The cipher text is the same length as the value and is followed by a
+  trailer: one version byte, the 96 bit nonce and the 128 bit tag. Keeping
+  the trailer at the end means a value can be decrypted in place.
+
+  Large values can be split across threads, every thread runs the counter
+  mode over its own range of blocks and hashes it, and the partial GHASH
+  values are then stitched together with powers of H.
+*/
+
+#include <libhashkit/common.h>
+
+#include <cstring>
+#include <fcntl.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#if defined(__linux__)
+# include <sys/syscall.h>
+#endif
+
+#if defined(__GNUC__) && defined(__x86_64__)
+# include <cpuid.h>
+# include <immintrin.h>
+# define HAVE_CLMUL 1
+#endif
+
+#define GCM_BLOCK_SIZE 16
+#define GCM_NONCE_SIZE 12
+#define GCM_TAG_SIZE 16
+#define GCM_VERSION 1
+#define GCM_MAX_THREADS 16
+
+/* How much a thread counts and hashes in one go, small enough to stay in L1 */
+#define GCM_PIECE_SIZE (16 * 1024)
+
+/* A field element, hi holds the first eight bytes of the block big endian */
+struct gcm_block_t
+{
+  uint64_t hi;
+  uint64_t lo;
+};
+
+struct gcm_hash_t
+{
+  bool clmul;
+  gcm_block_t h[4]; // H, H^2, H^3, H^4
+};
+
+static inline gcm_block_t gcm_load(const uint8_t *source)
+{
+  gcm_block_t block= { 0, 0 };
+  for (int x= 0; x < 8; x++)
+  {
+    block.hi= (block.hi << 8) | source[x];
+    block.lo= (block.lo << 8) | source[x +8];
+  }
+
+  return block;
+}
+
+static inline void gcm_store(uint8_t *destination, gcm_block_t block)
+{
+  for (int x= 7; x >= 0; x--)
+  {
+    destination[x]= uint8_t(block.hi);
+    destination[x +8]= uint8_t(block.lo);
+    block.hi>>= 8;
+    block.lo>>= 8;
+  }
+}
+
+/* Algorithm 1 of NIST SP 800-38D, one bit at a time */
+static gcm_block_t gcm_multiply_portable(gcm_block_t x, gcm_block_t y)
+{
+  gcm_block_t z= { 0, 0 };
+  for (int bit= 0; bit < 128; bit++)
+  {
+    uint64_t set= (bit < 64) ? (x.hi >> (63 -bit)) & 1 : (x.lo >> (127 -bit)) & 1;
+    if (set)
+    {
+      z.hi^= y.hi;
+      z.lo^= y.lo;
+    }
+
+    bool carry= y.lo & 1;
+    y.lo= (y.lo >> 1) | (y.hi << 63);
+    y.hi>>= 1;
+    if (carry)
+    {
+      y.hi^= 0xe100000000000000ULL;
+    }
+  }
+
+  return z;
+}
+
+#if defined(HAVE_CLMUL)
+static bool gcm_has_clmul(void)
+{
+  unsigned int eax, ebx, ecx, edx;
+  if (__get_cpuid(1, &eax, &ebx, &ecx, &edx) == 0)
+  {
+    return false;
+  }
+
+  return (ecx & bit_PCLMUL) and (ecx & bit_SSSE3);
+}
+
+/*
+  Carry-less multiply of two byte reflected elements followed by the
+  reduction modulo x^128 + x^7 + x^2 + x + 1, as laid out in Intel's
+  "Carry-Less Multiplication and Its Usage for Computing the GCM Mode".
+*/
+__attribute__((target("pclmul,sse2")))
+static inline __m128i gcm_clmul(__m128i a, __m128i b)
+{
+  __m128i tmp3= _mm_clmulepi64_si128(a, b, 0x00);
+  __m128i tmp4= _mm_clmulepi64_si128(a, b, 0x10);
+  __m128i tmp5= _mm_clmulepi64_si128(a, b, 0x01);
+  __m128i tmp6= _mm_clmulepi64_si128(a, b, 0x11);
+
+  tmp4= _mm_xor_si128(tmp4, tmp5);
+  tmp5= _mm_slli_si128(tmp4, 8);
+  tmp4= _mm_srli_si128(tmp4, 8);
+  tmp3= _mm_xor_si128(tmp3, tmp5);
+  tmp6= _mm_xor_si128(tmp6, tmp4);
+
+  // Shift the 256 bit product left by one
+  __m128i tmp7= _mm_srli_epi32(tmp3, 31);
+  __m128i tmp8= _mm_srli_epi32(tmp6, 31);
+  tmp3= _mm_slli_epi32(tmp3, 1);
+  tmp6= _mm_slli_epi32(tmp6, 1);
+  __m128i tmp9= _mm_srli_si128(tmp7, 12);
+  tmp8= _mm_slli_si128(tmp8, 4);
+  tmp7= _mm_slli_si128(tmp7, 4);
+  tmp3= _mm_or_si128(tmp3, tmp7);
+  tmp6= _mm_or_si128(tmp6, tmp8);
+  tmp6= _mm_or_si128(tmp6, tmp9);
+
+  // First phase of the reduction
+  tmp7= _mm_slli_epi32(tmp3, 31);
+  tmp8= _mm_slli_epi32(tmp3, 30);
+  tmp9= _mm_slli_epi32(tmp3, 25);
+  tmp7= _mm_xor_si128(tmp7, tmp8);
+  tmp7= _mm_xor_si128(tmp7, tmp9);
+  tmp8= _mm_srli_si128(tmp7, 4);
+  tmp7= _mm_slli_si128(tmp7, 12);
+  tmp3= _mm_xor_si128(tmp3, tmp7);
+
+  // Second phase
+  __m128i tmp2= _mm_srli_epi32(tmp3, 1);
+  tmp4= _mm_srli_epi32(tmp3, 2);
+  tmp5= _mm_srli_epi32(tmp3, 7);
+  tmp2= _mm_xor_si128(tmp2, tmp4);
+  tmp2= _mm_xor_si128(tmp2, tmp5);
+  tmp2= _mm_xor_si128(tmp2, tmp8);
+  tmp3= _mm_xor_si128(tmp3, tmp2);
+
+  return _mm_xor_si128(tmp6, tmp3);
+}
+
+__attribute__((target("pclmul,sse2")))
+static inline __m128i gcm_to_m128(gcm_block_t block)
+{
+  return _mm_set_epi64x((long long)block.hi, (long long)block.lo);
+}
+
+__attribute__((target("pclmul,sse2")))
+static inline gcm_block_t gcm_from_m128(__m128i value)
+{
+  gcm_block_t block;
+  block.hi= uint64_t(_mm_cvtsi128_si64(_mm_unpackhi_epi64(value, value)));
+  block.lo= uint64_t(_mm_cvtsi128_si64(value));
+
+  return block;
+}
+
+/* Four blocks are folded in per round, each against its own power of H */
+__attribute__((target("pclmul,ssse3,sse2")))
+static gcm_block_t gcm_ghash_clmul(const gcm_hash_t& hash, gcm_block_t state,
+                                   const uint8_t *source, size_t num_blocks)
+{
+  const __m128i reflect= _mm_set_epi8(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+  const __m128i h1= gcm_to_m128(hash.h[0]);
+  const __m128i h2= gcm_to_m128(hash.h[1]);
+  const __m128i h3= gcm_to_m128(hash.h[2]);
+  const __m128i h4= gcm_to_m128(hash.h[3]);
+
+  __m128i y= gcm_to_m128(state);
+  for (; num_blocks >= 4; num_blocks-= 4, source+= 4*GCM_BLOCK_SIZE)
+  {
+    __m128i b0= _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)source), reflect);
+    __m128i b1= _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)source +1), reflect);
+    __m128i b2= _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)source +2), reflect);
+    __m128i b3= _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)source +3), reflect);
+
+    y= _mm_xor_si128(gcm_clmul(_mm_xor_si128(y, b0), h4), gcm_clmul(b1, h3));
+    y= _mm_xor_si128(y, _mm_xor_si128(gcm_clmul(b2, h2), gcm_clmul(b3, h1)));
+  }
+
+  for (; num_blocks; num_blocks--, source+= GCM_BLOCK_SIZE)
+  {
+    __m128i b0= _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)source), reflect);
+    y= gcm_clmul(_mm_xor_si128(y, b0), h1);
+  }
+
+  return gcm_from_m128(y);
+}
+
+__attribute__((target("pclmul,sse2")))
+static gcm_block_t gcm_multiply_clmul(gcm_block_t x, gcm_block_t y)
+{
+  return gcm_from_m128(gcm_clmul(gcm_to_m128(x), gcm_to_m128(y)));
+}
+#endif
+
+static gcm_block_t gcm_multiply(const gcm_hash_t& hash, gcm_block_t x, gcm_block_t y)
+{
+#if defined(HAVE_CLMUL)
+  if (hash.clmul)
+  {
+    return gcm_multiply_clmul(x, y);
+  }
+#else
+  (void)hash;
+#endif
+
+  return gcm_multiply_portable(x, y);
+}
+
+/* Horner's rule over the data, a partial last block is zero padded */
+static gcm_block_t gcm_ghash(const gcm_hash_t& hash, gcm_block_t state,
+                             const uint8_t *source, size_t length)
+{
+  size_t num_blocks= length/GCM_BLOCK_SIZE;
+
+#if defined(HAVE_CLMUL)
+  if (hash.clmul)
+  {
+    state= gcm_ghash_clmul(hash, state, source, num_blocks);
+  }
+  else
+#endif
+  {
+    for (size_t x= 0; x < num_blocks; x++)
+    {
+      gcm_block_t block= gcm_load(source +GCM_BLOCK_SIZE*x);
+      state.hi^= block.hi;
+      state.lo^= block.lo;
+      state= gcm_multiply_portable(state, hash.h[0]);
+    }
+  }
+
+  if (length % GCM_BLOCK_SIZE)
+  {
+    uint8_t last[GCM_BLOCK_SIZE];
+    memset(last, 0, sizeof(last));
+    memcpy(last, source +GCM_BLOCK_SIZE*num_blocks, length % GCM_BLOCK_SIZE);
+
+    gcm_block_t block= gcm_load(last);
+    state.hi^= block.hi;
+    state.lo^= block.lo;
+    state= gcm_multiply(hash, state, hash.h[0]);
+  }
+
+  return state;
+}
+
+/* H^exponent, by squaring */
+static gcm_block_t gcm_power(const gcm_hash_t& hash, uint64_t exponent)
+{
+  gcm_block_t result= { 0x8000000000000000ULL, 0 }; // 1
+  gcm_block_t base= hash.h[0];
+  while (exponent)
+  {
+    if (exponent & 1)
+    {
+      result= gcm_multiply(hash, result, base);
+    }
+    base= gcm_multiply(hash, base, base);
+    exponent>>= 1;
+  }
+
+  return result;
+}
+
+static void gcm_hash_init(gcm_hash_t& hash, const aes_key_t *_aes_key)
+{
+  uint8_t zero[GCM_BLOCK_SIZE];
+  uint8_t h[GCM_BLOCK_SIZE];
+  memset(zero, 0, sizeof(zero));
+  aes_encrypt_block(_aes_key, zero, h);
+
+#if defined(HAVE_CLMUL)
+  // cpuid traps under most hypervisors, only ask once
+  static const bool has_clmul= gcm_has_clmul();
+  hash.clmul= has_clmul;
+#else
+  hash.clmul= false;
+#endif
+
+  hash.h[0]= gcm_load(h);
+  for (int x= 1; x < 4; x++)
+  {
+    hash.h[x]= gcm_multiply(hash, hash.h[x -1], hash.h[0]);
+  }
+}
+
+static bool gcm_random(uint8_t *buffer, size_t length)
+{
+#if defined(SYS_getrandom)
+  if (syscall(SYS_getrandom, buffer, length, 0) == ssize_t(length))
+  {
+    return true;
+  }
+#endif
+
+  int fd= open("/dev/urandom", O_RDONLY);
+  if (fd == -1)
+  {
+    return false;
+  }
+
+  size_t total= 0;
+  while (total < length)
+  {
+    ssize_t nread= read(fd, buffer +total, length -total);
+    if (nread <= 0)
+    {
+      break;
+    }
+    total+= size_t(nread);
+  }
+  close(fd);
+
+  return total == length;
+}
+
+struct gcm_job_t
+{
+  const aes_key_t *key;
+  const gcm_hash_t *hash;
+  const uint8_t *nonce;
+  uint32_t counter;
+  const uint8_t *source;
+  uint8_t *destination;
+  size_t length;
+  bool encrypt;
+  gcm_block_t ghash;
+};
+
+/*
+  Cipher text is hashed piece by piece right next to where it is produced
+  (or just before it is overwritten, when decrypting in place).
+*/
+static void *gcm_job_run(void *context)
+{
+  gcm_job_t *job= static_cast<gcm_job_t *>(context);
+
+  gcm_block_t state= { 0, 0 };
+  uint32_t counter= job->counter;
+  const uint8_t *source= job->source;
+  uint8_t *destination= job->destination;
+  for (size_t remaining= job->length; remaining; )
+  {
+    size_t piece= (remaining < GCM_PIECE_SIZE) ? remaining : GCM_PIECE_SIZE;
+    if (job->encrypt == false)
+    {
+      state= gcm_ghash(*job->hash, state, source, piece);
+    }
+
+    aes_ctr(job->key, job->nonce, counter, source, destination, piece);
+
+    if (job->encrypt)
+    {
+      state= gcm_ghash(*job->hash, state, destination, piece);
+    }
+
+    counter+= uint32_t(piece/GCM_BLOCK_SIZE);
+    source+= piece;
+    destination+= piece;
+    remaining-= piece;
+  }
+  job->ghash= state;
+
+  return NULL;
+}
+
+static void gcm_crypt(const aes_key_t *_aes_key, const uint8_t nonce[GCM_NONCE_SIZE],
+                      const uint8_t *aad, size_t aad_length,
+                      const uint8_t *source, uint8_t *destination, size_t length,
+                      uint32_t threads, bool encrypt,
+                      uint8_t tag[GCM_TAG_SIZE])
+{
+  gcm_hash_t hash;
+  gcm_hash_init(hash, _aes_key);
+
+  if (threads == 0)
+  {
+    threads= 1;
+  }
+  if (threads > GCM_MAX_THREADS)
+  {
+    threads= GCM_MAX_THREADS;
+  }
+
+  // Every thread gets whole blocks, only the last one may end short
+  size_t chunk= (length/threads +GCM_BLOCK_SIZE -1) & ~size_t(GCM_BLOCK_SIZE -1);
+  if (chunk < GCM_PIECE_SIZE)
+  {
+    chunk= GCM_PIECE_SIZE;
+  }
+
+  gcm_job_t jobs[GCM_MAX_THREADS];
+  pthread_t workers[GCM_MAX_THREADS];
+  bool started[GCM_MAX_THREADS];
+  uint32_t number_of_jobs= 0;
+  for (size_t offset= 0; offset < length or number_of_jobs == 0; offset+= chunk)
+  {
+    gcm_job_t& job= jobs[number_of_jobs];
+    job.key= _aes_key;
+    job.hash= &hash;
+    job.nonce= nonce;
+    job.counter= uint32_t(2 +offset/GCM_BLOCK_SIZE); // 1 is kept for the tag
+    job.source= source +offset;
+    job.destination= destination +offset;
+    job.length= (length -offset < chunk or number_of_jobs == threads -1) ? length -offset : chunk;
+    job.encrypt= encrypt;
+    started[number_of_jobs]= false;
+    number_of_jobs++;
+
+    if (offset +job.length >= length)
+    {
+      break;
+    }
+  }
+
+  // The calling thread takes the first chunk itself
+  for (uint32_t x= 1; x < number_of_jobs; x++)
+  {
+    started[x]= pthread_create(&workers[x], NULL, gcm_job_run, &jobs[x]) == 0;
+  }
+
+  for (uint32_t x= 0; x < number_of_jobs; x++)
+  {
+    if (started[x])
+    {
+      pthread_join(workers[x], NULL);
+    }
+    else
+    {
+      gcm_job_run(&jobs[x]);
+    }
+  }
+
+  gcm_block_t state= gcm_ghash(hash, gcm_block_t(), aad, aad_length);
+  for (uint32_t x= 0; x < number_of_jobs; x++)
+  {
+    uint64_t num_blocks= (jobs[x].length +GCM_BLOCK_SIZE -1)/GCM_BLOCK_SIZE;
+    state= gcm_multiply(hash, state, gcm_power(hash, num_blocks));
+    state.hi^= jobs[x].ghash.hi;
+    state.lo^= jobs[x].ghash.lo;
+  }
+
+  state.hi^= uint64_t(aad_length) * 8;
+  state.lo^= uint64_t(length) * 8;
+  state= gcm_multiply(hash, state, hash.h[0]);
+
+  uint8_t j0[GCM_BLOCK_SIZE];
+  memcpy(j0, nonce, GCM_NONCE_SIZE);
+  j0[12]= j0[13]= j0[14]= 0;
+  j0[15]= 1;
+
+  uint8_t mask[GCM_BLOCK_SIZE];
+  aes_encrypt_block(_aes_key, j0, mask);
+  gcm_store(tag, state);
+  for (int x= 0; x < GCM_TAG_SIZE; x++)
+  {
+    tag[x]^= mask[x];
+  }
+}
+
+size_t aes_gcm_length(size_t source_length)
+{
+  return source_length +AES_GCM_TRAILER_SIZE;
+}
+
+bool aes_gcm_encrypt(const aes_key_t *_aes_key,
+                     const char *aad, size_t aad_length,
+                     const char *source, size_t source_length,
+                     char *destination, uint32_t threads)
+{
+  if (_aes_key == NULL)
+  {
+    return false;
+  }
+
+  uint8_t *trailer= (uint8_t*)destination +source_length;
+  trailer[0]= GCM_VERSION;
+  uint8_t *nonce= trailer +1;
+  if (gcm_random(nonce, GCM_NONCE_SIZE) == false)
+  {
+    return false;
+  }
+
+  gcm_crypt(_aes_key, nonce, (const uint8_t*)aad, aad_length,
+            (const uint8_t*)source, (uint8_t*)destination, source_length,
+            threads, true, nonce +GCM_NONCE_SIZE);
+
+  return true;
+}
+
+bool aes_gcm_decrypt(const aes_key_t *_aes_key,
+                     const char *aad, size_t aad_length,
+                     const char *source, size_t source_length,
+                     char *destination, size_t& destination_length,
+                     uint32_t threads)
+{
+  if (_aes_key == NULL or source_length < AES_GCM_TRAILER_SIZE)
+  {
+    return false;
+  }
+
+  // Copied out first, destination may well be source
+  uint8_t trailer[AES_GCM_TRAILER_SIZE];
+  size_t length= source_length -AES_GCM_TRAILER_SIZE;
+  memcpy(trailer, source +length, AES_GCM_TRAILER_SIZE);
+  if (trailer[0] != GCM_VERSION)
+  {
+    return false;
+  }
+
+  uint8_t tag[GCM_TAG_SIZE];
+  gcm_crypt(_aes_key, trailer +1, (const uint8_t*)aad, aad_length,
+            (const uint8_t*)source, (uint8_t*)destination, length,
+            threads, false, tag);
+
+  uint8_t difference= 0;
+  for (int x= 0; x < GCM_TAG_SIZE; x++)
+  {
+    difference|= uint8_t(tag[x] ^ trailer[1 +GCM_NONCE_SIZE +x]);
+  }
+
+  if (difference)
+  {
+    // Never hand back plain text that failed authentication
+    memset(destination, 0, length);
+    return false;
+  }
+  destination_length= length;
+
+  return true;
+}
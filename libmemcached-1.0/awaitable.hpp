@@ -0,0 +1,381 @@
+/*  vim:expandtab:shiftwidth=2:tabstop=2:smarttab:
+ * 
+ *  Libmemcached library
+ *
+ *  Copyright (C) 2011-2012 Data Differential, http://datadifferential.com/
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are
+ *  met:
+ *
+ *      * Redistributions of source code must retain the above copyright
+ *  notice, this list of conditions and the following disclaimer.
+ *
+ *      * Redistributions in binary form must reproduce the above
+ *  copyright notice, this list of conditions and the following disclaimer
+ *  in the documentation and/or other materials provided with the
+ *  distribution.
+ *
+ *      * The names of its contributors may not be used to endorse or
+ *  promote products derived from this software without specific prior
+ *  written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *  A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *  OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *  SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *  LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *  DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *  THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *  OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+/**
+ * @file awaitable.hpp
+ * @brief C++20 coroutines over pipelined gets
+ *
+ * Each BatchMemcache collects the requests of every coroutine that is
+ * suspended on it, and run() sends all of them as a single pipelined
+ * mget before handing the results back. A thread can therefore keep many
+ * requests in flight without blocking on a round trip per request.
+ *
+ * This is not an asynchronous client. run() blocks until each batch has
+ * been answered and does not return to an event loop in between, and
+ * there is no executor: coroutines are resumed inline from run(). A
+ * BatchMemcache, and every coroutine waiting on it, belongs to the one
+ * thread that calls run(), and must not be resumed or co_await'ed on from
+ * any other thread.
+ */
+
+#pragma once
+
+#include <libmemcached-1.0/memcached.hpp>
+
+#if defined(__cplusplus) && __cplusplus >= 202002L && defined(__has_include)
+# if __has_include(<coroutine>) && __has_include(<span>)
+#  define LIBMEMCACHED_HAVE_AWAITABLE 1
+# endif
+#endif
+
+#if defined(LIBMEMCACHED_HAVE_AWAITABLE)
+
+#include <coroutine>
+#include <exception>
+#include <new>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace memcache
+{
+
+/**
+ * Coroutine return type for fire-and-forget tasks that co_await on an
+ * BatchMemcache. The coroutine starts eagerly and frees itself when it
+ * finishes.
+ */
+struct Detached
+{
+  struct promise_type
+  {
+    Detached get_return_object()
+    {
+      return Detached();
+    }
+
+    std::suspend_never initial_suspend() noexcept
+    {
+      return std::suspend_never();
+    }
+
+    std::suspend_never final_suspend() noexcept
+    {
+      return std::suspend_never();
+    }
+
+    void return_void()
+    { }
+
+    void unhandled_exception()
+    {
+      std::terminate();
+    }
+  };
+};
+
+class BatchMemcache
+{
+private:
+  struct Completion
+  {
+    std::coroutine_handle<> handle;
+    size_t outstanding;
+  };
+
+  struct Request
+  {
+    std::string_view key;
+    Value *slot;
+    Completion *completion;
+  };
+
+public:
+  class GetAwaiter
+  {
+  public:
+    GetAwaiter(BatchMemcache& memc, std::string_view key) :
+      _memc(memc),
+      _key(key),
+      _completion()
+    { }
+
+    bool await_ready() const
+    {
+      return false;
+    }
+
+    void await_suspend(std::coroutine_handle<> handle)
+    {
+      _completion.handle= handle;
+      _completion.outstanding= 1;
+      _memc.enqueue(_key, &_value, &_completion);
+    }
+
+    Value await_resume()
+    {
+      return std::move(_value);
+    }
+
+  private:
+    BatchMemcache& _memc;
+    std::string_view _key;
+    Value _value;
+    Completion _completion;
+  };
+
+  class MgetAwaiter
+  {
+  public:
+    MgetAwaiter(BatchMemcache& memc, std::span<const std::string_view> keys) :
+      _memc(memc),
+      _keys(keys),
+      _values(keys.size()),
+      _completion()
+    { }
+
+    bool await_ready() const
+    {
+      return _keys.empty();
+    }
+
+    void await_suspend(std::coroutine_handle<> handle)
+    {
+      _completion.handle= handle;
+      _completion.outstanding= _keys.size();
+      for (size_t x= 0; x < _keys.size(); ++x)
+      {
+        _memc.enqueue(_keys[x], &_values[x], &_completion);
+      }
+    }
+
+    /**
+     * Values are returned in the same order as the keys, misses are
+     * returned as a Value that evaluates to false.
+     */
+    std::vector<Value> await_resume()
+    {
+      return std::move(_values);
+    }
+
+  private:
+    BatchMemcache& _memc;
+    std::span<const std::string_view> _keys;
+    std::vector<Value> _values;
+    Completion _completion;
+  };
+
+  /**
+   * @throws std::invalid_argument if no memcached_st could be created from
+   * the configuration
+   */
+  explicit BatchMemcache(const std::string& config) :
+    memc(memcached(config.c_str(), config.size()))
+  {
+    if (memc == NULL)
+    {
+      throw std::invalid_argument("Could not create a memcached_st from the configuration");
+    }
+    memcached_result_create(memc, &_result);
+  }
+
+  /**
+   * @throws std::bad_alloc if the clone could not be made
+   */
+  explicit BatchMemcache(memcached_st *clone) :
+    memc(memcached_clone(NULL, clone))
+  {
+    if (memc == NULL)
+    {
+      throw std::bad_alloc();
+    }
+    memcached_result_create(memc, &_result);
+  }
+
+  BatchMemcache(const BatchMemcache&)= delete;
+  BatchMemcache& operator=(const BatchMemcache&)= delete;
+
+  ~BatchMemcache()
+  {
+    memcached_result_free(&_result);
+    memcached_free(memc);
+  }
+
+  memcached_st *getImpl()
+  {
+    return memc;
+  }
+
+  /**
+   * co_await the value of a single key. The key must stay valid until the
+   * coroutine is resumed.
+   */
+  GetAwaiter get(std::string_view key)
+  {
+    return GetAwaiter(*this, key);
+  }
+
+  /**
+   * co_await the values of several keys. The keys must stay valid until
+   * the coroutine is resumed.
+   */
+  MgetAwaiter mget(std::span<const std::string_view> keys)
+  {
+    return MgetAwaiter(*this, keys);
+  }
+
+  /**
+   * Number of keys waiting to be sent by run().
+   */
+  size_t pending() const
+  {
+    return _requests.size();
+  }
+
+  /**
+   * Send every outstanding request, read back the responses and resume the
+   * coroutines waiting on them. Coroutines that issue new requests after
+   * being resumed are served by the same call, so run() only returns
+   * once nothing is left waiting.
+   *
+   * @return the last error seen, or MEMCACHED_SUCCESS
+   */
+  memcached_return_t run()
+  {
+    memcached_return_t rc= MEMCACHED_SUCCESS;
+
+    std::vector<Request> batch;
+    std::vector<std::coroutine_handle<> > ready;
+    while (not _requests.empty())
+    {
+      batch.clear();
+      batch.swap(_requests);
+
+      memcached_return_t batch_rc= dispatch(batch);
+      if (memcached_failed(batch_rc))
+      {
+        rc= batch_rc;
+      }
+
+      ready.clear();
+      for (std::vector<Request>::iterator it= batch.begin(); it != batch.end(); ++it)
+      {
+        if (--it->completion->outstanding == 0)
+        {
+          ready.push_back(it->completion->handle);
+        }
+      }
+
+      for (std::vector<std::coroutine_handle<> >::iterator it= ready.begin(); it != ready.end(); ++it)
+      {
+        it->resume();
+      }
+    }
+
+    return rc;
+  }
+
+private:
+  void enqueue(std::string_view key, Value *slot, Completion *completion)
+  {
+    Request request= { key, slot, completion };
+    _requests.push_back(request);
+  }
+
+  memcached_return_t dispatch(std::vector<Request>& batch)
+  {
+    _keys.clear();
+    _index.clear();
+    for (size_t x= 0; x < batch.size(); ++x)
+    {
+      _keys.push_back(batch[x].key);
+      _index.insert(std::make_pair(batch[x].key, x));
+    }
+
+    memcached_return_t rc= memcached_mget(memc, _keys.keys(), _keys.key_length(), _keys.size());
+    if (memcached_failed(rc))
+    {
+      for (std::vector<Request>::iterator it= batch.begin(); it != batch.end(); ++it)
+      {
+        it->slot->_rc= rc;
+      }
+
+      return rc;
+    }
+
+    memcached_result_st *result;
+    while ((result= memcached_fetch_result(memc, &_result, &rc)))
+    {
+      std::string_view key(memcached_result_key_value(result), memcached_result_key_length(result));
+      std::pair<Index::iterator, Index::iterator> range= _index.equal_range(key);
+      if (range.first == range.second)
+      {
+        continue;
+      }
+
+      Value *first= batch[range.first->second].slot;
+      first->adopt(memc, result);
+      for (Index::iterator it= ++range.first; it != range.second; ++it)
+      {
+        batch[it->second].slot->assign(memc, *first);
+      }
+    }
+
+    if (rc == MEMCACHED_END or rc == MEMCACHED_NOTFOUND)
+    {
+      return MEMCACHED_SUCCESS;
+    }
+
+    return rc;
+  }
+
+  typedef std::unordered_multimap<std::string_view, size_t> Index;
+
+  memcached_st *memc;
+  memcached_result_st _result;
+  std::vector<Request> _requests;
+  KeyBatch _keys;
+  Index _index;
+};
+
+}
+
+#endif // LIBMEMCACHED_HAVE_AWAITABLE
@@ -47,6 +47,7 @@ typedef memcached_return_t (*memcached_stat_fn)(memcached_server_instance_st ser
                                                 const char *key, size_t key_length,
                                                 const char *value, size_t value_length,
                                                 void *context);
+typedef void (*memcached_trace_fn)(const memcached_st *ptr, const memcached_trace_event_st *event, void *context);
 
 #ifdef __cplusplus
 }
@@ -0,0 +1,75 @@
+/*  vim:expandtab:shiftwidth=2:tabstop=2:smarttab:
+ * 
+ *  Libmemcached library
+ *
+ *  Copyright (C) 2012-2012 Data Differential, http://datadifferential.com/
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are
+ *  met:
+ *
+ *      * Redistributions of source code must retain the above copyright
+ *  notice, this list of conditions and the following disclaimer.
+ *
+ *      * Redistributions in binary form must reproduce the above
+ *  copyright notice, this list of conditions and the following disclaimer
+ *  in the documentation and/or other materials provided with the
+ *  distribution.
+ *
+ *      * The names of its contributors may not be used to endorse or
+ *  promote products derived from this software without specific prior
+ *  written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *  A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *  OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *  SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *  LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *  DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *  THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *  OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+#pragma once
+
+#include <libmemcached-1.0/struct/compression.h>
+
+/*
+  Item flag bit reserved for compressed values, see
+  MEMCACHED_BEHAVIOR_COMPRESSION. While compression is on the library sets
+  and clears it, so it is not available to the application. Append and
+  prepend return MEMCACHED_NOT_SUPPORTED while compression is on.
+*/
+#define MEMCACHED_FLAG_COMPRESSED (1U << 30)
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+  Prime both codecs with data that values are likely to share, such as
+  the field names of a JSON document. It matters most for small values.
+  Every client that reads the values needs the same dictionary; values
+  compressed with a different one fail to decompress. Only the last 64K
+  of the dictionary is used. Pass NULL to remove it.
+*/
+LIBMEMCACHED_API
+memcached_return_t memcached_set_compression_dictionary(memcached_st *ptr,
+                                                        const char *dictionary,
+                                                        size_t length);
+
+LIBMEMCACHED_API
+memcached_return_t memcached_compression_stat(const memcached_st *ptr,
+                                              memcached_compression_stat_st *stat);
+
+LIBMEMCACHED_API
+void memcached_compression_stat_reset(memcached_st *ptr);
+
+#ifdef __cplusplus
+}
+#endif
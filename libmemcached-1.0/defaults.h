@@ -63,5 +63,10 @@
 #define MEMCACHED_SERVER_FAILURE_RETRY_TIMEOUT 2
 #define MEMCACHED_SERVER_FAILURE_DEAD_TIMEOUT 0
 #define MEMCACHED_POLLING_TIMEOUT_SECS 60 /* Default time between polling for configuration changes */
+#define MEMCACHED_DEFAULT_COMPRESSION_THRESHOLD 256
+#define MEMCACHED_DEFAULT_ENCRYPTION_THREAD_THRESHOLD (1024*1024) /* Bytes of value per thread when encrypting with AES-GCM */
+#define MEMCACHED_DEFAULT_HEDGED_READ_DELAY 2000 /* Microseconds before a read is raced against a replica, until there is latency to go by */
+#define MEMCACHED_DEFAULT_UDP_READ_TIMEOUT 100 /* Milliseconds a get over UDP waits on its datagrams before it is sent again over TCP */
+#define MEMCACHED_DEFAULT_UDP_RECV_SIZE (1024*1024) /* Receive buffer asked for by UDP sockets, the system may cap it */
 
 
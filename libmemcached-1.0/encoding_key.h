@@ -37,6 +37,13 @@
 
 #pragma once
 
+/*
+  Item flag bit reserved for values stored as AES-256-GCM envelopes, see
+  MEMCACHED_BEHAVIOR_ENCRYPTION. It is set and cleared by the library, so
+  it is not available to applications that use an encoding key.
+*/
+#define MEMCACHED_FLAG_AES_GCM (1U << 31)
+
 #ifdef __cplusplus
 extern "C" {
 #endif
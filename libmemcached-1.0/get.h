@@ -90,6 +90,39 @@ memcached_return_t memcached_mget_by_key(memcached_st *ptr,
                                          const size_t *key_length,
                                          const size_t number_of_keys);
 
+LIBMEMCACHED_API
+char *memcached_gat(memcached_st *ptr,
+                    const char *key, size_t key_length,
+                    time_t expiration,
+                    size_t *value_length,
+                    uint32_t *flags,
+                    memcached_return_t *error);
+
+LIBMEMCACHED_API
+char *memcached_gat_by_key(memcached_st *ptr,
+                           const char *group_key, size_t group_key_length,
+                           const char *key, size_t key_length,
+                           time_t expiration,
+                           size_t *value_length,
+                           uint32_t *flags,
+                           memcached_return_t *error);
+
+LIBMEMCACHED_API
+memcached_return_t memcached_mgat(memcached_st *ptr,
+                                  const char * const *keys,
+                                  const size_t *key_length,
+                                  size_t number_of_keys,
+                                  time_t expiration);
+
+LIBMEMCACHED_API
+memcached_return_t memcached_mgat_by_key(memcached_st *ptr,
+                                         const char *group_key,
+                                         size_t group_key_length,
+                                         const char * const *keys,
+                                         const size_t *key_length,
+                                         size_t number_of_keys,
+                                         time_t expiration);
+
 LIBMEMCACHED_API
 char *memcached_fetch(memcached_st *ptr,
                       char *key,
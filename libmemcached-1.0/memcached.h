@@ -68,6 +68,10 @@
 #include <libmemcached-1.0/types/hash.h>
 #include <libmemcached-1.0/types/return.h>
 #include <libmemcached-1.0/types/server_distribution.h>
+#include <libmemcached-1.0/types/compression.h>
+#include <libmemcached-1.0/types/encryption.h>
+#include <libmemcached-1.0/types/slowlog.h>
+#include <libmemcached-1.0/types/telemetry.h>
 
 #include <libmemcached-1.0/return.h>
 
@@ -97,6 +101,7 @@
 #include <libmemcached-1.0/auto.h>
 #include <libmemcached-1.0/behavior.h>
 #include <libmemcached-1.0/callback.h>
+#include <libmemcached-1.0/compression.h>
 #include <libmemcached-1.0/delete.h>
 #include <libmemcached-1.0/dump.h>
 #include <libmemcached-1.0/encoding_key.h>
@@ -106,15 +111,20 @@
 #include <libmemcached-1.0/flush_buffers.h>
 #include <libmemcached-1.0/get.h>
 #include <libmemcached-1.0/hash.h>
+#include <libmemcached-1.0/near_cache.h>
 #include <libmemcached-1.0/options.h>
 #include <libmemcached-1.0/parse.h>
 #include <libmemcached-1.0/quit.h>
+#include <libmemcached-1.0/replication.h>
 #include <libmemcached-1.0/result.h>
 #include <libmemcached-1.0/server.h>
 #include <libmemcached-1.0/server_list.h>
+#include <libmemcached-1.0/slowlog.h>
 #include <libmemcached-1.0/storage.h>
 #include <libmemcached-1.0/strerror.h>
+#include <libmemcached-1.0/telemetry.h>
 #include <libmemcached-1.0/touch.h>
+#include <libmemcached-1.0/trace.h>
 #include <libmemcached-1.0/verbosity.h>
 #include <libmemcached-1.0/version.h>
 #include <libmemcached-1.0/sasl.h>
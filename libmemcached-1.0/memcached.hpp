@@ -62,9 +62,243 @@
 #include <vector>
 #include <map>
 
+#if defined(__cplusplus) && __cplusplus >= 201703L
+# define LIBMEMCACHED_HAVE_STRING_VIEW 1
+# include <cstddef>
+# include <memory>
+# include <string_view>
+# if __cplusplus >= 202002L && defined(__has_include)
+#  if __has_include(<span>)
+#   define LIBMEMCACHED_HAVE_SPAN 1
+#   include <span>
+#  endif
+# endif
+#endif
+
 namespace memcache
 {
 
+#if defined(LIBMEMCACHED_HAVE_STRING_VIEW)
+class Memcache;
+class BatchMemcache;
+
+/**
+ * A value returned by the server. The buffer libmemcached read the value
+ * into is adopted, together with the allocator that has to release it,
+ * instead of being copied out. A Value must not outlive the memcached_st
+ * it came from when custom memory allocators are in use.
+ */
+class Value
+{
+  struct Deleter
+  {
+    Deleter() :
+      memc(NULL),
+      free_fn(NULL),
+      context(NULL)
+    { }
+
+    explicit Deleter(const memcached_st *arg) :
+      memc(arg),
+      free_fn(NULL),
+      context(memcached_get_memory_allocators_context(arg))
+    {
+      memcached_get_memory_allocators(arg, NULL, &free_fn, NULL, NULL);
+    }
+
+    void operator()(char *ptr) const
+    {
+      if (free_fn)
+      {
+        free_fn(memc, ptr, context);
+      }
+      else
+      {
+        ::free(ptr);
+      }
+    }
+
+    const memcached_st *memc;
+    memcached_free_fn free_fn;
+    void *context;
+  };
+
+public:
+  Value() :
+    _rc(MEMCACHED_NOTFOUND),
+    _length(0),
+    _flags(0),
+    _cas(0)
+  { }
+
+  explicit operator bool() const
+  {
+    return memcached_success(_rc);
+  }
+
+  memcached_return_t error() const
+  {
+    return _rc;
+  }
+
+  std::string_view key() const
+  {
+    return _key;
+  }
+
+  /**
+   * The value, which is always followed by a NUL byte that is not
+   * counted in size(). An empty value or a miss returns "".
+   */
+  const char *data() const
+  {
+    return _data ? _data.get() : "";
+  }
+
+  size_t size() const
+  {
+    return _length;
+  }
+
+  std::string_view view() const
+  {
+    return std::string_view(_data.get(), _length);
+  }
+
+#if defined(LIBMEMCACHED_HAVE_SPAN)
+  std::span<const std::byte> bytes() const
+  {
+    return std::span<const std::byte>(reinterpret_cast<const std::byte *>(_data.get()), _length);
+  }
+#endif
+
+  uint32_t flags() const
+  {
+    return _flags;
+  }
+
+  uint64_t cas() const
+  {
+    return _cas;
+  }
+
+private:
+  friend class Memcache;
+  friend class BatchMemcache;
+
+  void reset(memcached_return_t rc)
+  {
+    _rc= rc;
+    _key.clear();
+    _data.reset();
+    _length= 0;
+    _flags= 0;
+    _cas= 0;
+  }
+
+  void adopt(const memcached_st *memc, char *value, size_t length,
+             uint32_t flags, uint64_t cas)
+  {
+    _rc= MEMCACHED_SUCCESS;
+    _data= std::unique_ptr<char, Deleter>(value, Deleter(memc));
+    _length= length;
+    _flags= flags;
+    _cas= cas;
+  }
+
+  void adopt(const memcached_st *memc, memcached_result_st *result)
+  {
+    _key.assign(memcached_result_key_value(result), memcached_result_key_length(result));
+    size_t length= memcached_result_length(result);
+    adopt(memc, memcached_result_take_value(result), length,
+          memcached_result_flags(result), memcached_result_cas(result));
+  }
+
+  void assign(const memcached_st *memc, const Value& other)
+  {
+    reset(other._rc);
+    _key= other._key;
+    _flags= other._flags;
+    _cas= other._cas;
+    if (other._data)
+    {
+      memcached_malloc_fn malloc_fn= NULL;
+      memcached_get_memory_allocators(memc, &malloc_fn, NULL, NULL, NULL);
+      char *value= static_cast<char *>(malloc_fn(memc, other._length +1, memcached_get_memory_allocators_context(memc)));
+      if (value == NULL)
+      {
+        _rc= MEMCACHED_MEMORY_ALLOCATION_FAILURE;
+        return;
+      }
+      memcpy(value, other._data.get(), other._length +1);
+      _data= std::unique_ptr<char, Deleter>(value, Deleter(memc));
+      _length= other._length;
+    }
+  }
+
+  memcached_return_t _rc;
+  std::string _key;
+  std::unique_ptr<char, Deleter> _data;
+  size_t _length;
+  uint32_t _flags;
+  uint64_t _cas;
+};
+
+/**
+ * Keys for mget() that can be filled once and then reused, so that the
+ * arrays handed to memcached_mget() are not rebuilt on every call. The
+ * batch only references the keys, they must outlive it.
+ */
+class KeyBatch
+{
+public:
+  KeyBatch()
+  { }
+
+  void reserve(size_t count)
+  {
+    _keys.reserve(count);
+    _key_length.reserve(count);
+  }
+
+  void push_back(std::string_view key)
+  {
+    _keys.push_back(key.data());
+    _key_length.push_back(key.size());
+  }
+
+  void clear()
+  {
+    _keys.clear();
+    _key_length.clear();
+  }
+
+  size_t size() const
+  {
+    return _keys.size();
+  }
+
+  bool empty() const
+  {
+    return _keys.empty();
+  }
+
+  const char * const *keys() const
+  {
+    return &_keys[0];
+  }
+
+  const size_t *key_length() const
+  {
+    return &_key_length[0];
+  }
+
+private:
+  std::vector<const char *> _keys;
+  std::vector<size_t> _key_length;
+};
+#endif
+
 /**
  * This is the core memcached library (if later, other objects
  * are needed, they will be created from this class).
@@ -274,6 +508,32 @@ public:
     return fetch(key, ret_val, flags, cas_value);
   }
 
+#if defined(LIBMEMCACHED_HAVE_STRING_VIEW)
+  /**
+   * Fetches an individual value from the server without copying it.
+   * mget() must always be called before using this method.
+   *
+   * @param[out] value receives the key, value, flags and cas
+   * @return a memcached return structure
+   */
+  memcached_return_t fetch(Value &value)
+  {
+    memcached_return_t rc;
+
+    memcached_result_st *result;
+    if ((result= memcached_fetch_result(memc, &memc->result, &rc)))
+    {
+      value.adopt(memc, result);
+    }
+    else
+    {
+      value.reset(rc == MEMCACHED_END ? MEMCACHED_NOTFOUND : rc);
+    }
+
+    return rc;
+  }
+#endif
+
   /**
    * Fetches an individual value from the server.
    *
@@ -301,6 +561,51 @@ public:
     return false;
   }
 
+#if defined(LIBMEMCACHED_HAVE_STRING_VIEW)
+  /**
+   * Fetches an individual value from the server without copying it.
+   *
+   * @param[in] key key of object whose value to get
+   * @return the value, which evaluates to false if it was not found
+   */
+  Value get(std::string_view key)
+  {
+    return getByKey(std::string_view(), key);
+  }
+
+  /**
+   * Fetches an individual value, without copying it, from the server
+   * selected by master_key.
+   *
+   * @param[in] master_key key that specifies server object is stored on
+   * @param[in] key key of object whose value to get
+   * @return the value, which evaluates to false if it was not found
+   */
+  Value getByKey(std::string_view master_key, std::string_view key)
+  {
+    Value ret_val;
+    uint32_t flags= 0;
+    size_t value_length= 0;
+    memcached_return_t rc;
+
+    char *value= memcached_get_by_key(memc,
+                                      master_key.data(), master_key.size(),
+                                      key.data(), key.size(),
+                                      &value_length, &flags, &rc);
+    if (value)
+    {
+      ret_val.adopt(memc, value, value_length, flags, 0);
+    }
+    else
+    {
+      ret_val.reset(rc);
+    }
+    ret_val._key.assign(key.data(), key.size());
+
+    return ret_val;
+  }
+#endif
+
   /**
    * Fetches an individual from a server which is specified by
    * the master_key parameter that is used for determining which
@@ -376,6 +681,25 @@ public:
     return false;
   }
 
+#if defined(LIBMEMCACHED_HAVE_STRING_VIEW)
+  /**
+   * Selects multiple keys at once from a batch that can be reused between
+   * calls. This method always works asynchronously.
+   *
+   * @param[in] keys batch of keys to select
+   * @return true if the request was sent
+   */
+  bool mget(const KeyBatch& keys)
+  {
+    if (keys.empty())
+    {
+      return false;
+    }
+
+    return memcached_success(memcached_mget(memc, keys.keys(), keys.key_length(), keys.size()));
+  }
+#endif
+
   /**
    * Writes an object to the server. If the object already exists, it will
    * overwrite the existing object. This method always returns true
@@ -399,6 +723,41 @@ public:
     return memcached_success(rc);
   }
 
+#if defined(LIBMEMCACHED_HAVE_STRING_VIEW)
+  /**
+   * Writes an object to the server without copying the key or value.
+   *
+   * @param[in] key key of object to write to server
+   * @param[in] value value of object to write to server
+   * @param[in] expiration time to keep the object stored in the server for
+   * @param[in] flags flags to store with the object
+   * @return true on succcess; false otherwise
+   */
+  bool set(std::string_view key,
+           std::string_view value,
+           time_t expiration,
+           uint32_t flags)
+  {
+    return memcached_success(memcached_set(memc,
+                                           key.data(), key.size(),
+                                           value.data(), value.size(),
+                                           expiration, flags));
+  }
+
+#if defined(LIBMEMCACHED_HAVE_SPAN)
+  bool set(std::string_view key,
+           std::span<const std::byte> value,
+           time_t expiration,
+           uint32_t flags)
+  {
+    return memcached_success(memcached_set(memc,
+                                           key.data(), key.size(),
+                                           reinterpret_cast<const char *>(value.data()), value.size(),
+                                           expiration, flags));
+  }
+#endif
+#endif
+
   /**
    * Writes an object to a server specified by the master_key parameter.
    * If the object already exists, it will overwrite the existing object.
@@ -0,0 +1,72 @@
+/*  vim:expandtab:shiftwidth=2:tabstop=2:smarttab:
+ * 
+ *  Libmemcached library
+ *
+ *  Copyright (C) 2011-2012 Data Differential, http://datadifferential.com/
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are
+ *  met:
+ *
+ *      * Redistributions of source code must retain the above copyright
+ *  notice, this list of conditions and the following disclaimer.
+ *
+ *      * Redistributions in binary form must reproduce the above
+ *  copyright notice, this list of conditions and the following disclaimer
+ *  in the documentation and/or other materials provided with the
+ *  distribution.
+ *
+ *      * The names of its contributors may not be used to endorse or
+ *  promote products derived from this software without specific prior
+ *  written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *  A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *  OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *  SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *  LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *  DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *  THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *  OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+#pragma once
+
+#include <libmemcached-1.0/struct/near_cache.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+  Attach an in-process cache of values read by memcached_get() and
+  memcached_get_by_key(). Values are kept for at most ttl seconds, and no
+  longer than the expiration they were last stored with through this
+  memcached_st. If stale_ttl is not zero a value that is up to stale_ttl
+  seconds past its TTL is still returned to other callers while the first
+  one to see it refreshes it from the server.
+
+  Clones of ptr, including the memcached_st in a memcached_pool_st, share
+  the cache.
+*/
+LIBMEMCACHED_API
+memcached_return_t memcached_near_cache_create(memcached_st *ptr,
+                                               size_t byte_budget,
+                                               time_t ttl,
+                                               time_t stale_ttl);
+
+LIBMEMCACHED_API
+void memcached_near_cache_free(memcached_st *ptr);
+
+LIBMEMCACHED_API
+memcached_return_t memcached_near_cache_stat(const memcached_st *ptr,
+                                             memcached_near_cache_stat_st *stat);
+
+#ifdef __cplusplus
+}
+#endif
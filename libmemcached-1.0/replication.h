@@ -0,0 +1,68 @@
+/*  vim:expandtab:shiftwidth=2:tabstop=2:smarttab:
+ * 
+ *  Libmemcached library
+ *
+ *  Copyright (C) 2012-2012 Data Differential, http://datadifferential.com/
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are
+ *  met:
+ *
+ *      * Redistributions of source code must retain the above copyright
+ *  notice, this list of conditions and the following disclaimer.
+ *
+ *      * Redistributions in binary form must reproduce the above
+ *  copyright notice, this list of conditions and the following disclaimer
+ *  in the documentation and/or other materials provided with the
+ *  distribution.
+ *
+ *      * The names of its contributors may not be used to endorse or
+ *  promote products derived from this software without specific prior
+ *  written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *  A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *  OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *  SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *  LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *  DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *  THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *  OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+
+#pragma once
+
+#include <libmemcached-1.0/struct/replication.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+  What the replicas answered to the last set that MEMCACHED_BEHAVIOR_NUMBER_OF_REPLICAS
+  copied. Up to number_of_results answers are written to results, in
+  replica order, and the number of replicas that stored their copy is
+  returned. Sets that do not wait for a reply, or that are buffered, send
+  the copies quietly and report MEMCACHED_BUFFERED for each of them.
+*/
+LIBMEMCACHED_API
+uint32_t memcached_replica_acks(const memcached_st *ptr,
+                                memcached_return_t *results,
+                                uint32_t number_of_results);
+
+LIBMEMCACHED_API
+memcached_return_t memcached_replication_stat(const memcached_st *ptr,
+                                              memcached_replication_stat_st *stat);
+
+LIBMEMCACHED_API
+void memcached_replication_stat_reset(memcached_st *ptr);
+
+#ifdef __cplusplus
+}
+#endif
@@ -66,12 +66,28 @@ const char *memcached_result_value(const memcached_result_st *self);
 LIBMEMCACHED_API
 size_t memcached_result_length(const memcached_result_st *self);
 
+/*
+  Hand the value buffer over to the caller, who must release it with free()
+  (or the free function given to memcached_set_memory_allocators()).
+  The result is left empty and may be reused.
+*/
+LIBMEMCACHED_API
+char *memcached_result_take_value(memcached_result_st *self);
+
 LIBMEMCACHED_API
 uint32_t memcached_result_flags(const memcached_result_st *self);
 
 LIBMEMCACHED_API
 uint64_t memcached_result_cas(const memcached_result_st *self);
 
+/*
+  Position in the keys given to memcached_mget() that this result answers,
+  or SIZE_MAX if it is not known. Only tracked with MEMCACHED_BEHAVIOR_MGET_DEDUPE,
+  and only for the result the last fetch filled in.
+*/
+LIBMEMCACHED_API
+size_t memcached_result_key_index(const memcached_result_st *self);
+
 LIBMEMCACHED_API
 memcached_return_t memcached_result_set_value(memcached_result_st *ptr, const char *value, size_t length);
 
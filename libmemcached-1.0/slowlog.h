@@ -0,0 +1,78 @@
+/*  vim:expandtab:shiftwidth=2:tabstop=2:smarttab:
+ * 
+ *  Libmemcached library
+ *
+ *  Copyright (C) 2011-2012 Data Differential, http://datadifferential.com/
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are
+ *  met:
+ *
+ *      * Redistributions of source code must retain the above copyright
+ *  notice, this list of conditions and the following disclaimer.
+ *
+ *      * Redistributions in binary form must reproduce the above
+ *  copyright notice, this list of conditions and the following disclaimer
+ *  in the documentation and/or other materials provided with the
+ *  distribution.
+ *
+ *      * The names of its contributors may not be used to endorse or
+ *  promote products derived from this software without specific prior
+ *  written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *  A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *  OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *  SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *  LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *  DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *  THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *  OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+#pragma once
+
+#include <libmemcached-1.0/struct/slowlog.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+  Time every get, mget, store, delete, increment/decrement, configuration
+  fetch and stat request (once per server) made through ptr, and keep the
+  last capacity operations that took threshold_usec or more in a ring
+  buffer. capacity is
+  rounded up to a power of two. Clones of ptr, including the memcached_st
+  in a memcached_pool_st, log to the same buffer.
+*/
+LIBMEMCACHED_API
+memcached_return_t memcached_slowlog_create(memcached_st *ptr,
+                                            uint64_t threshold_usec,
+                                            uint32_t capacity);
+
+LIBMEMCACHED_API
+void memcached_slowlog_free(memcached_st *ptr);
+
+/*
+  Copy up to count of the most recent entries into entries, oldest first,
+  and return how many were copied. Readers never block the threads that
+  are logging; an entry that is overwritten while it is being copied is
+  left out.
+*/
+LIBMEMCACHED_API
+size_t memcached_slowlog_read(const memcached_st *ptr,
+                              memcached_slowlog_entry_st *entries,
+                              size_t count);
+
+LIBMEMCACHED_API
+const char *memcached_slowlog_phase_string(memcached_slowlog_phase_t phase);
+
+#ifdef __cplusplus
+}
+#endif
@@ -86,6 +86,11 @@ struct memcached_st {
     bool tcp_keepalive:1;
     bool is_aes:1;
     bool use_config_protocol:1;
+    bool coalesce_gets:1;
+    bool coalesce_get_failure:1;
+    bool mget_dedupe:1;
+    bool server_telemetry:1;
+    bool meta_protocol:1;
     enum memcached_client_mode client_mode;
   } flags;
 
@@ -126,6 +131,19 @@ struct memcached_st {
   } ketama;
 
   struct memcached_virtual_bucket_t *virtual_bucket;
+  struct memcached_near_cache_st *near_cache;
+  struct memcached_slowlog_st *slowlog;
+  struct memcached_mget_index_st *mget_index;
+  struct memcached_compression_st *compression;
+  struct memcached_replication_st *replication;
+  struct memcached_udp_st *udp;
+
+  struct {
+    memcached_encryption_t mode;
+    uint32_t thread_threshold; // Bytes of value per thread, 0 never uses threads
+    char *buffer; // Cipher text of the last value stored, reused between calls
+    size_t buffer_size;
+  } encryption;
 
   struct memcached_allocator_t allocators;
 
@@ -134,6 +152,13 @@ struct memcached_st {
   memcached_trigger_key_fn get_key_failure;
   memcached_trigger_delete_key_fn delete_trigger;
   memcached_callback_st *callbacks;
+  struct {
+    memcached_trace_fn function;
+    void *context;
+    uint32_t sample_rate;
+    uint32_t countdown; // Operations left until the next one is sampled
+    uint32_t server_key; // Where the last key was routed
+  } trace;
   struct memcached_sasl_st sasl;
   struct memcached_error_t *error_messages;
   struct memcached_array_st *_namespace;
@@ -115,4 +115,6 @@ struct memcached_server_st {
   char write_buffer[MEMCACHED_MAX_BUFFER];
   char hostname[MEMCACHED_NI_MAXHOST];
   char ipaddress[IP_ADDRESS_LENGTH];
+  struct memcached_telemetry_counter_st *telemetry; // Allocated on first use, see MEMCACHED_BEHAVIOR_SERVER_TELEMETRY
+  uint32_t cancelled_responses; // Replies still on the way for requests that were given up on
 };
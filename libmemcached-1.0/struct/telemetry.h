@@ -0,0 +1,71 @@
+/*  vim:expandtab:shiftwidth=2:tabstop=2:smarttab:
+ * 
+ *  Libmemcached library
+ *
+ *  Copyright (C) 2011-2012 Data Differential, http://datadifferential.com/
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are
+ *  met:
+ *
+ *      * Redistributions of source code must retain the above copyright
+ *  notice, this list of conditions and the following disclaimer.
+ *
+ *      * Redistributions in binary form must reproduce the above
+ *  copyright notice, this list of conditions and the following disclaimer
+ *  in the documentation and/or other materials provided with the
+ *  distribution.
+ *
+ *      * The names of its contributors may not be used to endorse or
+ *  promote products derived from this software without specific prior
+ *  written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *  A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *  OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *  SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *  LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *  DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *  THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *  OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+
+#pragma once
+
+/*
+  Latencies are counted in microseconds. Values below 8 have a bucket of
+  their own, every power of two above that is split into 4 buckets, so a
+  bucket is never wider than a quarter of its lower bound. The last bucket
+  holds everything from about 12 days up.
+*/
+#define MEMCACHED_HISTOGRAM_BUCKETS 160
+
+struct memcached_histogram_st {
+  uint64_t count;
+  uint64_t total_usec;
+  uint64_t max_usec;
+  uint64_t buckets[MEMCACHED_HISTOGRAM_BUCKETS];
+};
+
+struct memcached_server_telemetry_st {
+  char hostname[MEMCACHED_NI_MAXHOST];
+  in_port_t port;
+  uint64_t bytes_read;
+  uint64_t bytes_written;
+  uint64_t connects;
+  uint64_t reconnects; // Connects after the first one
+  uint64_t ejections; // Times the server was taken out by MEMCACHED_BEHAVIOR_AUTO_EJECT_HOSTS
+  uint64_t poll_wakeups; // poll() calls that found the socket ready
+  struct memcached_histogram_st latency[MEMCACHED_TELEMETRY_OP_MAX];
+};
+
+struct memcached_telemetry_st {
+  uint32_t number_of_servers;
+  struct memcached_server_telemetry_st *servers;
+};
@@ -0,0 +1,86 @@
+/*  vim:expandtab:shiftwidth=2:tabstop=2:smarttab:
+ * 
+ *  Libmemcached library
+ *
+ *  Copyright (C) 2011-2012 Data Differential, http://datadifferential.com/
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are
+ *  met:
+ *
+ *      * Redistributions of source code must retain the above copyright
+ *  notice, this list of conditions and the following disclaimer.
+ *
+ *      * Redistributions in binary form must reproduce the above
+ *  copyright notice, this list of conditions and the following disclaimer
+ *  in the documentation and/or other materials provided with the
+ *  distribution.
+ *
+ *      * The names of its contributors may not be used to endorse or
+ *  promote products derived from this software without specific prior
+ *  written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *  A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *  OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *  SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *  LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *  DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *  THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *  OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+
+#pragma once
+
+#include <libmemcached-1.0/struct/telemetry.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+  Copy the latency histograms and counters that the servers of ptr have
+  gathered while MEMCACHED_BEHAVIOR_SERVER_TELEMETRY was on. The counters
+  are only written by the thread using ptr, so take the snapshot from that
+  thread, or while ptr is checked out of its pool. Release the result with
+  memcached_telemetry_free().
+*/
+LIBMEMCACHED_API
+memcached_telemetry_st *memcached_telemetry_snapshot(const memcached_st *ptr,
+                                                     memcached_return_t *error);
+
+/*
+  Add the counters of source to destination, matching servers on hostname
+  and port. Servers that destination does not have yet are appended, so the
+  snapshots of every memcached_st in a pool can be rolled up into one.
+*/
+LIBMEMCACHED_API
+memcached_return_t memcached_telemetry_merge(memcached_telemetry_st *destination,
+                                             const memcached_telemetry_st *source);
+
+LIBMEMCACHED_API
+void memcached_telemetry_free(memcached_telemetry_st *telemetry);
+
+LIBMEMCACHED_API
+void memcached_telemetry_reset(memcached_st *ptr);
+
+/*
+  Latency in microseconds that percentile (0 to 100) percent of the samples
+  stayed at or below, rounded up to the edge of its bucket.
+*/
+LIBMEMCACHED_API
+uint64_t memcached_histogram_percentile(const memcached_histogram_st *histogram,
+                                        double percentile);
+
+LIBMEMCACHED_API
+const char *memcached_telemetry_op_string(memcached_telemetry_op_t op);
+
+#ifdef __cplusplus
+}
+#endif
@@ -42,6 +42,14 @@
 struct memcached_st;
 struct memcached_stat_st;
 struct memcached_analysis_st;
+struct memcached_near_cache_stat_st;
+struct memcached_compression_stat_st;
+struct memcached_replication_stat_st;
+struct memcached_telemetry_st;
+struct memcached_server_telemetry_st;
+struct memcached_histogram_st;
+struct memcached_trace_event_st;
+struct memcached_slowlog_entry_st;
 struct memcached_result_st;
 struct memcached_array_st;
 struct memcached_error_t;
@@ -63,6 +71,14 @@ struct memcached_continuum_item_st;
 typedef struct memcached_st memcached_st;
 typedef struct memcached_stat_st memcached_stat_st;
 typedef struct memcached_analysis_st memcached_analysis_st;
+typedef struct memcached_near_cache_stat_st memcached_near_cache_stat_st;
+typedef struct memcached_compression_stat_st memcached_compression_stat_st;
+typedef struct memcached_replication_stat_st memcached_replication_stat_st;
+typedef struct memcached_telemetry_st memcached_telemetry_st;
+typedef struct memcached_server_telemetry_st memcached_server_telemetry_st;
+typedef struct memcached_histogram_st memcached_histogram_st;
+typedef struct memcached_trace_event_st memcached_trace_event_st;
+typedef struct memcached_slowlog_entry_st memcached_slowlog_entry_st;
 typedef struct memcached_result_st memcached_result_st;
 typedef struct memcached_array_st memcached_array_st;
 typedef struct memcached_error_t memcached_error_t;
@@ -89,6 +89,17 @@ enum memcached_behavior_t {
   MEMCACHED_BEHAVIOR_DEAD_TIMEOUT,
   MEMCACHED_BEHAVIOR_CLIENT_MODE,
   MEMCACHED_BEHAVIOR_DYNAMIC_POLLING_THRESHOLD_SECS,
+  MEMCACHED_BEHAVIOR_COALESCE_GETS,
+  MEMCACHED_BEHAVIOR_MGET_DEDUPE,
+  MEMCACHED_BEHAVIOR_SERVER_TELEMETRY,
+  MEMCACHED_BEHAVIOR_ENCRYPTION,
+  MEMCACHED_BEHAVIOR_ENCRYPTION_THREAD_THRESHOLD,
+  MEMCACHED_BEHAVIOR_COMPRESSION,
+  MEMCACHED_BEHAVIOR_COMPRESSION_THRESHOLD,
+  MEMCACHED_BEHAVIOR_HEDGED_READ_PERCENTILE,
+  MEMCACHED_BEHAVIOR_HEDGED_READ_DELAY,
+  MEMCACHED_BEHAVIOR_UDP_READ_TIMEOUT,
+  MEMCACHED_BEHAVIOR_META_PROTOCOL,
   MEMCACHED_BEHAVIOR_MAX
 
 };
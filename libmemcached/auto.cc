@@ -96,6 +96,55 @@ static memcached_return_t text_incr_decr(memcached_server_write_instance_st inst
   return memcached_vdo(instance, vector, 7, true);
 }
 
+/*
+  ma creates the item from initial only when given an N flag, an
+  expiration of MEMCACHED_EXPIRATION_NOT_ADD leaves it off.
+*/
+static memcached_return_t meta_incr_decr(memcached_server_write_instance_st instance,
+                                         const bool is_incr,
+                                         const char *key, size_t key_length,
+                                         const uint64_t offset,
+                                         const uint64_t initial,
+                                         const uint32_t expiration,
+                                         const bool reply)
+{
+  char buffer[MEMCACHED_DEFAULT_COMMAND_SIZE];
+
+  int send_length;
+  if (expiration == MEMCACHED_EXPIRATION_NOT_ADD)
+  {
+    send_length= snprintf(buffer, sizeof(buffer), " D%" PRIu64 "%s", offset, is_incr ? "" : " MD");
+  }
+  else
+  {
+    send_length= snprintf(buffer, sizeof(buffer), " D%" PRIu64 "%s N%" PRIu32 " J%" PRIu64,
+                          offset, is_incr ? "" : " MD", expiration, initial);
+  }
+
+  if (size_t(send_length) >= sizeof(buffer) or send_length < 0)
+  {
+    return memcached_set_error(*instance, MEMCACHED_MEMORY_ALLOCATION_FAILURE, MEMCACHED_AT, 
+                               memcached_literal_param("snprintf(MEMCACHED_DEFAULT_COMMAND_SIZE)"));
+  }
+
+  memcached_meta_key_st meta_key;
+  memcached_meta_key(*instance->root, key, key_length, meta_key);
+
+  libmemcached_io_vector_st vector[]=
+  {
+    { NULL, 0 },
+    { memcached_literal_param("ma ") },
+    meta_key.vector[0],
+    meta_key.vector[1],
+    { " b", meta_key.base64 ? memcached_literal_param_size(" b") : 0 },
+    { buffer, send_length },
+    { reply ? " v" : MEMCACHED_META_QUIET, reply ? memcached_literal_param_size(" v") : memcached_literal_param_size(MEMCACHED_META_QUIET) },
+    { memcached_literal_param("\r\n") }
+  };
+
+  return memcached_vdo(instance, vector, 8, true);
+}
+
 static memcached_return_t binary_incr_decr(memcached_server_write_instance_st instance,
                                            protocol_binary_command cmd,
                                            const char *key, const size_t key_length,
@@ -177,8 +226,12 @@ static memcached_return_t increment_decrement_by_key(const protocol_binary_comma
     return memcached_last_error(memc);
   }
 
+  uint64_t traced= memcached_trace_start(memc);
+
+  bool timed= memcached_slowlog_start(memc);
   uint32_t server_key= memcached_generate_hash_with_redistribution(memc, group_key, group_key_length);
   memcached_server_write_instance_st instance= memcached_server_instance_fetch(memc, server_key);
+  uint64_t started= memcached_telemetry_start(memc);
 
   bool reply= memcached_is_replying(instance->root);
 
@@ -189,6 +242,14 @@ static memcached_return_t increment_decrement_by_key(const protocol_binary_comma
                          uint64_t(offset), 0, MEMCACHED_EXPIRATION_NOT_ADD,
                          reply);
   }
+  else if (memcached_is_meta(memc))
+  {
+    rc= meta_incr_decr(instance,
+                       command == PROTOCOL_BINARY_CMD_INCREMENT ? true : false,
+                       key, key_length,
+                       offset, 0, MEMCACHED_EXPIRATION_NOT_ADD,
+                       reply);
+  }
   else
   {
     rc= text_incr_decr(instance,
@@ -198,6 +259,14 @@ static memcached_return_t increment_decrement_by_key(const protocol_binary_comma
   }
 
   auto_response(instance, reply, rc, value);
+  memcached_telemetry_record(instance, MEMCACHED_TELEMETRY_OP_INCR, started, rc);
+  memcached_slowlog_end(memc, timed, MEMCACHED_TELEMETRY_OP_INCR, key_length, 1, 0, rc);
+  memcached_trace_end(memc, traced, MEMCACHED_TELEMETRY_OP_INCR, key, key_length, 1, 0, rc);
+
+  if (memc->near_cache)
+  {
+    memcached_near_cache_invalidate(memc, group_key, group_key_length, key, key_length, 0);
+  }
 
   return rc;
 }
@@ -236,8 +305,12 @@ static memcached_return_t increment_decrement_with_initial_by_key(const protocol
     return memcached_last_error(memc);
   }
 
+  uint64_t traced= memcached_trace_start(memc);
+
+  bool timed= memcached_slowlog_start(memc);
   uint32_t server_key= memcached_generate_hash_with_redistribution(memc, group_key, group_key_length);
   memcached_server_write_instance_st instance= memcached_server_instance_fetch(memc, server_key);
+  uint64_t started= memcached_telemetry_start(memc);
 
   bool reply= memcached_is_replying(instance->root);
 
@@ -249,6 +322,14 @@ static memcached_return_t increment_decrement_with_initial_by_key(const protocol
                          reply);
         
   }
+  else if (memcached_is_meta(memc))
+  {
+    rc= meta_incr_decr(instance,
+                       command == PROTOCOL_BINARY_CMD_INCREMENT ? true : false,
+                       key, key_length,
+                       offset, initial, uint32_t(expiration),
+                       reply);
+  }
   else
   {
     rc=  memcached_set_error(*memc, MEMCACHED_INVALID_ARGUMENTS, MEMCACHED_AT,
@@ -256,6 +337,14 @@ static memcached_return_t increment_decrement_with_initial_by_key(const protocol
   }
 
   auto_response(instance, reply, rc, value);
+  memcached_telemetry_record(instance, MEMCACHED_TELEMETRY_OP_INCR, started, rc);
+  memcached_slowlog_end(memc, timed, MEMCACHED_TELEMETRY_OP_INCR, key_length, 1, 0, rc);
+  memcached_trace_end(memc, traced, MEMCACHED_TELEMETRY_OP_INCR, key, key_length, 1, 0, rc);
+
+  if (memc->near_cache)
+  {
+    memcached_near_cache_invalidate(memc, group_key, group_key_length, key, key_length, 0);
+  }
 
   return rc;
 }
@@ -105,6 +105,62 @@ memcached_return_t memcached_behavior_set(memcached_st *ptr,
     break;
   }
 
+  case MEMCACHED_BEHAVIOR_COALESCE_GETS:
+    if (data > 2)
+    {
+      return memcached_set_error(*ptr, MEMCACHED_INVALID_ARGUMENTS, MEMCACHED_AT,
+                                 memcached_literal_param("MEMCACHED_BEHAVIOR_COALESCE_GETS must be 0, 1 or 2."));
+    }
+    ptr->flags.coalesce_gets= bool(data);
+    ptr->flags.coalesce_get_failure= (data == 2);
+    break;
+
+  case MEMCACHED_BEHAVIOR_MGET_DEDUPE:
+    ptr->flags.mget_dedupe= bool(data);
+    break;
+
+  case MEMCACHED_BEHAVIOR_SERVER_TELEMETRY:
+    if (LIBMEMCACHED_WITH_TELEMETRY == 0 and data)
+    {
+      return memcached_set_error(*ptr, MEMCACHED_NOT_SUPPORTED, MEMCACHED_AT,
+                                 memcached_literal_param("libmemcached was built with --disable-telemetry"));
+    }
+    ptr->flags.server_telemetry= bool(data);
+    break;
+
+  case MEMCACHED_BEHAVIOR_ENCRYPTION:
+    if (data >= MEMCACHED_ENCRYPTION_MAX)
+    {
+      return memcached_set_error(*ptr, MEMCACHED_INVALID_ARGUMENTS, MEMCACHED_AT,
+                                 memcached_literal_param("Invalid memcached_encryption_t"));
+    }
+    ptr->encryption.mode= memcached_encryption_t(data);
+    break;
+
+  case MEMCACHED_BEHAVIOR_ENCRYPTION_THREAD_THRESHOLD:
+    if (data > UINT32_MAX)
+    {
+      return memcached_set_error(*ptr, MEMCACHED_INVALID_ARGUMENTS, MEMCACHED_AT,
+                                 memcached_literal_param("MEMCACHED_BEHAVIOR_ENCRYPTION_THREAD_THRESHOLD is limited to 4GB."));
+    }
+    ptr->encryption.thread_threshold= uint32_t(data);
+    break;
+
+  case MEMCACHED_BEHAVIOR_COMPRESSION:
+    return memcached_compression_set(*ptr, memcached_compression_t(data));
+
+  case MEMCACHED_BEHAVIOR_COMPRESSION_THRESHOLD:
+    return memcached_compression_set_threshold(*ptr, data);
+
+  case MEMCACHED_BEHAVIOR_HEDGED_READ_PERCENTILE:
+    return memcached_replication_set_hedge_percentile(*ptr, data);
+
+  case MEMCACHED_BEHAVIOR_HEDGED_READ_DELAY:
+    return memcached_replication_set_hedge_delay(*ptr, data);
+
+  case MEMCACHED_BEHAVIOR_UDP_READ_TIMEOUT:
+    return memcached_udp_set_timeout(*ptr, data);
+
   case MEMCACHED_BEHAVIOR_NUMBER_OF_REPLICAS:
     ptr->number_of_replicas= (uint32_t)data;
     break;
@@ -148,6 +204,22 @@ memcached_return_t memcached_behavior_set(memcached_st *ptr,
       ptr->flags.verify_key= false;
     }
     ptr->flags.binary_protocol= bool(data);
+    ptr->flags.meta_protocol= false;
+    break;
+
+  case MEMCACHED_BEHAVIOR_META_PROTOCOL:
+    if (memcached_is_udp(ptr) and bool(data))
+    {
+      return memcached_set_error(*ptr, MEMCACHED_INVALID_ARGUMENTS, MEMCACHED_AT,
+                                 memcached_literal_param("MEMCACHED_BEHAVIOR_META_PROTOCOL cannot be enabled while MEMCACHED_BEHAVIOR_USE_UDP is set."));
+    }
+    send_quit(ptr); // The meta commands share the text protocol, but not the binary one
+    if (data)
+    {
+      ptr->flags.verify_key= false;
+    }
+    ptr->flags.meta_protocol= bool(data);
+    ptr->flags.binary_protocol= false;
     break;
 
   case MEMCACHED_BEHAVIOR_SUPPORT_CAS:
@@ -180,6 +252,12 @@ memcached_return_t memcached_behavior_set(memcached_st *ptr,
                                  memcached_literal_param("MEMCACHED_BEHAVIOR_USE_UDP cannot be enabled while MEMCACHED_BEHAVIOR_CLIENT_MODE is set to DYNAMIC_MODE."));
     }
 
+    if (memcached_is_meta(ptr) and bool(data))
+    {
+      return memcached_set_error(*ptr, MEMCACHED_INVALID_ARGUMENTS, MEMCACHED_AT,
+                                 memcached_literal_param("MEMCACHED_BEHAVIOR_USE_UDP cannot be enabled while MEMCACHED_BEHAVIOR_META_PROTOCOL is set."));
+    }
+
     ptr->flags.use_udp= bool(data);
     if (bool(data))
     {
@@ -190,6 +268,13 @@ memcached_return_t memcached_behavior_set(memcached_st *ptr,
     {
       ptr->flags.reply= true;
     }
+
+    // The addresses were looked up for the other kind of socket, and the write buffers laid out for it
+    for (uint32_t x= 0; x < memcached_server_count(ptr); x++)
+    {
+      memcached_server_instance_fetch(ptr, x)->address_info_next= NULL;
+    }
+    send_quit(ptr);
     break;
 
   case MEMCACHED_BEHAVIOR_TCP_NODELAY:
@@ -242,6 +327,12 @@ memcached_return_t memcached_behavior_set(memcached_st *ptr,
       return memcached_set_error(*ptr, MEMCACHED_INVALID_ARGUMENTS, MEMCACHED_AT,
                                         memcached_literal_param("MEMCACHED_BEHAVIOR_VERIFY_KEY if the binary protocol has been enabled."));
     }
+
+    if (ptr->flags.meta_protocol)
+    {
+      return memcached_set_error(*ptr, MEMCACHED_INVALID_ARGUMENTS, MEMCACHED_AT,
+                                        memcached_literal_param("MEMCACHED_BEHAVIOR_VERIFY_KEY if the meta protocol has been enabled."));
+    }
     ptr->flags.verify_key= bool(data);
     break;
 
@@ -355,6 +446,40 @@ uint64_t memcached_behavior_get(memcached_st *ptr,
   case MEMCACHED_BEHAVIOR_DYNAMIC_POLLING_THRESHOLD_SECS:
     return ptr->polling.threshold_secs;
 
+  case MEMCACHED_BEHAVIOR_COALESCE_GETS:
+    if (ptr->flags.coalesce_gets)
+    {
+      return ptr->flags.coalesce_get_failure ? 2 : 1;
+    }
+    return 0;
+
+  case MEMCACHED_BEHAVIOR_MGET_DEDUPE:
+    return ptr->flags.mget_dedupe;
+
+  case MEMCACHED_BEHAVIOR_SERVER_TELEMETRY:
+    return ptr->flags.server_telemetry;
+
+  case MEMCACHED_BEHAVIOR_ENCRYPTION:
+    return uint64_t(ptr->encryption.mode);
+
+  case MEMCACHED_BEHAVIOR_ENCRYPTION_THREAD_THRESHOLD:
+    return ptr->encryption.thread_threshold;
+
+  case MEMCACHED_BEHAVIOR_COMPRESSION:
+    return uint64_t(memcached_compression_get(*ptr));
+
+  case MEMCACHED_BEHAVIOR_COMPRESSION_THRESHOLD:
+    return memcached_compression_get_threshold(*ptr);
+
+  case MEMCACHED_BEHAVIOR_HEDGED_READ_PERCENTILE:
+    return memcached_replication_get_hedge_percentile(*ptr);
+
+  case MEMCACHED_BEHAVIOR_HEDGED_READ_DELAY:
+    return memcached_replication_get_hedge_delay(*ptr);
+
+  case MEMCACHED_BEHAVIOR_UDP_READ_TIMEOUT:
+    return memcached_udp_get_timeout(*ptr);
+
   case MEMCACHED_BEHAVIOR_NUMBER_OF_REPLICAS:
     return ptr->number_of_replicas;
 
@@ -370,6 +495,9 @@ uint64_t memcached_behavior_get(memcached_st *ptr,
   case MEMCACHED_BEHAVIOR_BINARY_PROTOCOL:
     return ptr->flags.binary_protocol;
 
+  case MEMCACHED_BEHAVIOR_META_PROTOCOL:
+    return ptr->flags.meta_protocol;
+
   case MEMCACHED_BEHAVIOR_SUPPORT_CAS:
     return ptr->flags.support_cas;
 
@@ -646,6 +774,17 @@ const char *libmemcached_string_behavior(const memcached_behavior_t flag)
   case MEMCACHED_BEHAVIOR_LOAD_FROM_FILE: return "MEMCACHED_BEHAVIOR_LOAD_FROM_FILE";
   case MEMCACHED_BEHAVIOR_CLIENT_MODE: return "MEMCACHED_BEHAVIOR_CLIENT_MODE";
   case MEMCACHED_BEHAVIOR_DYNAMIC_POLLING_THRESHOLD_SECS: return "MEMCACHED_BEHAVIOR_DYNAMIC_POLLING_THRESHOLD_SECS";
+  case MEMCACHED_BEHAVIOR_COALESCE_GETS: return "MEMCACHED_BEHAVIOR_COALESCE_GETS";
+  case MEMCACHED_BEHAVIOR_MGET_DEDUPE: return "MEMCACHED_BEHAVIOR_MGET_DEDUPE";
+  case MEMCACHED_BEHAVIOR_SERVER_TELEMETRY: return "MEMCACHED_BEHAVIOR_SERVER_TELEMETRY";
+  case MEMCACHED_BEHAVIOR_ENCRYPTION: return "MEMCACHED_BEHAVIOR_ENCRYPTION";
+  case MEMCACHED_BEHAVIOR_ENCRYPTION_THREAD_THRESHOLD: return "MEMCACHED_BEHAVIOR_ENCRYPTION_THREAD_THRESHOLD";
+  case MEMCACHED_BEHAVIOR_COMPRESSION: return "MEMCACHED_BEHAVIOR_COMPRESSION";
+  case MEMCACHED_BEHAVIOR_COMPRESSION_THRESHOLD: return "MEMCACHED_BEHAVIOR_COMPRESSION_THRESHOLD";
+  case MEMCACHED_BEHAVIOR_HEDGED_READ_PERCENTILE: return "MEMCACHED_BEHAVIOR_HEDGED_READ_PERCENTILE";
+  case MEMCACHED_BEHAVIOR_HEDGED_READ_DELAY: return "MEMCACHED_BEHAVIOR_HEDGED_READ_DELAY";
+  case MEMCACHED_BEHAVIOR_UDP_READ_TIMEOUT: return "MEMCACHED_BEHAVIOR_UDP_READ_TIMEOUT";
+  case MEMCACHED_BEHAVIOR_META_PROTOCOL: return "MEMCACHED_BEHAVIOR_META_PROTOCOL";
   default:
   case MEMCACHED_BEHAVIOR_MAX: return "INVALID memcached_behavior_t";
   }
@@ -0,0 +1,326 @@
+/*  vim:expandtab:shiftwidth=2:tabstop=2:smarttab:
+ * 
+ *  Libmemcached library
+ *
+ *  Copyright (C) 2011-2012 Data Differential, http://datadifferential.com/
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are
+ *  met:
+ *
+ *      * Redistributions of source code must retain the above copyright
+ *  notice, this list of conditions and the following disclaimer.
+ *
+ *      * Redistributions in binary form must reproduce the above
+ *  copyright notice, this list of conditions and the following disclaimer
+ *  in the documentation and/or other materials provided with the
+ *  distribution.
+ *
+ *      * The names of its contributors may not be used to endorse or
+ *  promote products derived from this software without specific prior
+ *  written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *  A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *  OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *  SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *  LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *  DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *  THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *  OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+/*
+  Coalescing of concurrent gets for the same key, across every
+  memcached_st in the process. The first caller to ask for a key becomes
+  the leader and goes to the server, callers that ask for the same key on
+  the same server before the leader has its answer wait for it and get a
+  copy of it instead.
+*/
+
+#include <libmemcached/common.h>
+
+#include <pthread.h>
+#include <sys/time.h>
+
+#define COALESCE_BUCKETS 1024
+
+// Room for the protocol, the encryption mode and key check value and the codec
+#define COALESCE_CONFIG_SIZE 64
+
+struct memcached_coalesced_get_st {
+  memcached_coalesced_get_st *next;
+  uint32_t hash;
+  uint32_t waiters;
+  bool landed;
+  pthread_cond_t cond;
+  char *value;
+  size_t value_length;
+  uint32_t flags;
+  memcached_return_t rc;
+  size_t key_length;
+  char key[1];
+};
+
+static pthread_mutex_t coalesce_lock= PTHREAD_MUTEX_INITIALIZER;
+static memcached_coalesced_get_st *coalesce_buckets[COALESCE_BUCKETS];
+
+static void coalesce_unlink(memcached_coalesced_get_st *get)
+{
+  memcached_coalesced_get_st **bucket= &coalesce_buckets[get->hash % COALESCE_BUCKETS];
+  while (*bucket and *bucket != get)
+  {
+    bucket= &(*bucket)->next;
+  }
+
+  if (*bucket)
+  {
+    *bucket= get->next;
+  }
+}
+
+/*
+  Everything that changes what a get hands back for the same bytes on the
+  server. The encoding key is identified by what it makes of a block of
+  zeros, so handles that set the same key separately still share gets.
+*/
+static int coalesce_config(const memcached_st *ptr, char *buffer, size_t buffer_length)
+{
+  char protocol= 't';
+  if (memcached_is_binary(ptr))
+  {
+    protocol= 'b';
+  }
+  else if (ptr->flags.meta_protocol)
+  {
+    protocol= 'm';
+  }
+
+  char check_value[2 * 16 +1]= "-";
+  if (memcached_is_encrypted(ptr))
+  {
+    static const char zeros[16]= { 0 };
+    unsigned char block[16];
+    hashkit_encrypt_update(&ptr->hashkit, zeros, sizeof(zeros), reinterpret_cast<char *>(block));
+    for (size_t x= 0; x < sizeof(block); x++)
+    {
+      snprintf(check_value +2 * x, 3, "%02x", block[x]);
+    }
+  }
+
+  return snprintf(buffer, buffer_length, "%c:%d:%s:%d:%u",
+                  protocol,
+                  int(ptr->encryption.mode), check_value,
+                  int(memcached_compression_get(*ptr)),
+                  ptr->compression ? ptr->compression->dictionary_id : 0);
+}
+
+memcached_coalesced_get_st *memcached_coalesce_join(memcached_st *ptr,
+                                                    const char *group_key, size_t group_key_length,
+                                                    const char *key, size_t key_length,
+                                                    bool& leader)
+{
+  if (memcached_server_count(ptr) == 0 or key == NULL or key_length == 0 or key_length >= MEMCACHED_MAX_KEY)
+  {
+    return NULL;
+  }
+
+  // Gets are only the same if they go to the same server for the same namespace and key, and decode alike
+  uint32_t server_key;
+  if (group_key and group_key_length)
+  {
+    server_key= memcached_generate_hash_with_redistribution(ptr, group_key, group_key_length);
+  }
+  else
+  {
+    server_key= memcached_generate_hash_with_redistribution(ptr, key, key_length);
+  }
+  memcached_server_instance_st instance= memcached_server_instance_by_position(ptr, server_key);
+
+  char config[COALESCE_CONFIG_SIZE];
+  int config_length= coalesce_config(ptr, config, sizeof(config));
+  if (config_length < 0 or size_t(config_length) >= sizeof(config))
+  {
+    return NULL;
+  }
+
+  char buffer[MEMCACHED_NI_MAXHOST +MEMCACHED_MAXIMUM_INTEGER_DISPLAY_LENGTH +COALESCE_CONFIG_SIZE +MEMCACHED_MAX_KEY +4];
+  const char *name_space= ptr->_namespace ? memcached_array_string(ptr->_namespace) : "";
+  int length= snprintf(buffer, sizeof(buffer), "%s:%u:%s:%.*s%.*s",
+                       memcached_server_name(instance), uint32_t(memcached_server_port(instance)),
+                       config,
+                       int(memcached_array_size(ptr->_namespace)), name_space,
+                       int(key_length), key);
+  if (length < 0 or size_t(length) >= sizeof(buffer))
+  {
+    return NULL;
+  }
+
+  uint32_t hash= libhashkit_one_at_a_time(buffer, size_t(length));
+
+  pthread_mutex_lock(&coalesce_lock);
+  memcached_coalesced_get_st *get;
+  for (get= coalesce_buckets[hash % COALESCE_BUCKETS]; get; get= get->next)
+  {
+    if (get->hash == hash and get->key_length == size_t(length) and memcmp(get->key, buffer, size_t(length)) == 0)
+    {
+      get->waiters++;
+      leader= false;
+      pthread_mutex_unlock(&coalesce_lock);
+
+      return get;
+    }
+  }
+
+  if ((get= static_cast<memcached_coalesced_get_st *>(malloc(sizeof(memcached_coalesced_get_st) +size_t(length)))) == NULL or
+      pthread_cond_init(&get->cond, NULL))
+  {
+    free(get);
+    pthread_mutex_unlock(&coalesce_lock);
+
+    return NULL;
+  }
+
+  get->hash= hash;
+  get->waiters= 1;
+  get->landed= false;
+  get->value= NULL;
+  get->value_length= 0;
+  get->flags= 0;
+  get->rc= MEMCACHED_NOTFOUND;
+  get->key_length= size_t(length);
+  memcpy(get->key, buffer, size_t(length));
+  get->next= coalesce_buckets[hash % COALESCE_BUCKETS];
+  coalesce_buckets[hash % COALESCE_BUCKETS]= get;
+  leader= true;
+  pthread_mutex_unlock(&coalesce_lock);
+
+  return get;
+}
+
+void memcached_coalesce_land(memcached_coalesced_get_st *get,
+                             const char *value, size_t value_length,
+                             uint32_t flags,
+                             memcached_return_t rc)
+{
+  char *copy= NULL;
+  if (value and (copy= static_cast<char *>(malloc(value_length +1))))
+  {
+    memcpy(copy, value, value_length);
+    copy[value_length]= 0;
+  }
+  else if (value)
+  {
+    rc= MEMCACHED_MEMORY_ALLOCATION_FAILURE;
+  }
+
+  pthread_mutex_lock(&coalesce_lock);
+  // Callers arriving from now on start a get of their own
+  coalesce_unlink(get);
+  get->value= copy;
+  get->value_length= copy ? value_length : 0;
+  get->flags= flags;
+  get->rc= rc;
+  get->landed= true;
+  pthread_cond_broadcast(&get->cond);
+  pthread_mutex_unlock(&coalesce_lock);
+}
+
+/*
+  Hand back what the leader got. If it has not landed by the time our own
+  get would have given up on the server, landed is false and the caller
+  is left to go to the server itself.
+*/
+char *memcached_coalesce_wait(memcached_st *ptr,
+                              memcached_coalesced_get_st *get,
+                              size_t *value_length,
+                              uint32_t *flags,
+                              memcached_return_t *error,
+                              bool& landed)
+{
+  // Wait no longer than our own get would have for a reply, a negative poll timeout waits forever
+  int32_t timeout= ptr->poll_timeout;
+  if (timeout >= 0 and ptr->rcv_timeout / 1000 > timeout)
+  {
+    timeout= ptr->rcv_timeout / 1000;
+  }
+
+  struct timespec deadline;
+  if (timeout >= 0)
+  {
+    struct timeval now;
+    gettimeofday(&now, NULL);
+    uint64_t nsec= uint64_t(now.tv_usec) * 1000 +uint64_t(timeout % 1000) * 1000000;
+    deadline.tv_sec= now.tv_sec +timeout / 1000 +time_t(nsec / 1000000000);
+    deadline.tv_nsec= long(nsec % 1000000000);
+  }
+
+  pthread_mutex_lock(&coalesce_lock);
+  while (get->landed == false)
+  {
+    if (timeout < 0)
+    {
+      pthread_cond_wait(&get->cond, &coalesce_lock);
+    }
+    else if (pthread_cond_timedwait(&get->cond, &coalesce_lock, &deadline) == ETIMEDOUT)
+    {
+      break;
+    }
+  }
+  landed= get->landed;
+  pthread_mutex_unlock(&coalesce_lock);
+
+  if (landed == false)
+  {
+    *value_length= 0;
+    *flags= 0;
+    return NULL;
+  }
+
+  // Nothing changes a get once it has landed
+  memcached_error_free(*ptr);
+  *error= get->rc;
+  *value_length= 0;
+  *flags= get->flags;
+
+  if (get->value == NULL)
+  {
+    if (memcached_fatal(get->rc))
+    {
+      memcached_set_error(*ptr, get->rc, MEMCACHED_AT, memcached_literal_param("Coalesced get failed"));
+    }
+
+    return NULL;
+  }
+
+  char *value= static_cast<char *>(libmemcached_malloc(ptr, get->value_length +1));
+  if (value == NULL)
+  {
+    *error= memcached_set_error(*ptr, MEMCACHED_MEMORY_ALLOCATION_FAILURE, MEMCACHED_AT);
+    return NULL;
+  }
+
+  memcpy(value, get->value, get->value_length +1);
+  *value_length= get->value_length;
+
+  return value;
+}
+
+void memcached_coalesce_leave(memcached_coalesced_get_st *get)
+{
+  pthread_mutex_lock(&coalesce_lock);
+  bool last= --get->waiters == 0;
+  pthread_mutex_unlock(&coalesce_lock);
+
+  if (last)
+  {
+    pthread_cond_destroy(&get->cond);
+    free(get->value);
+    free(get);
+  }
+}
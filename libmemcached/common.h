@@ -146,6 +146,15 @@ memcached_return_t memcached_server_execute(memcached_st *ptr,
 
 #ifdef __cplusplus
 #include <libmemcached/backtrace.hpp>
+#include <libmemcached/near_cache.hpp>
+#include <libmemcached/coalesce.hpp>
+#include <libmemcached/mget_index.hpp>
+#include <libmemcached/telemetry.hpp>
+#include <libmemcached/trace.hpp>
+#include <libmemcached/slowlog.hpp>
+#include <libmemcached/compression.hpp>
+#include <libmemcached/replication.hpp>
+#include <libmemcached/meta.hpp>
 #include <libmemcached/assert.hpp>
 #include <libmemcached/server.hpp>
 #include <libmemcached/key.hpp>
@@ -0,0 +1,627 @@
+/*  vim:expandtab:shiftwidth=2:tabstop=2:smarttab:
+ * 
+ *  Libmemcached library
+ *
+ *  Copyright (C) 2011-2012 Data Differential, http://datadifferential.com/
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are
+ *  met:
+ *
+ *      * Redistributions of source code must retain the above copyright
+ *  notice, this list of conditions and the following disclaimer.
+ *
+ *      * Redistributions in binary form must reproduce the above
+ *  copyright notice, this list of conditions and the following disclaimer
+ *  in the documentation and/or other materials provided with the
+ *  distribution.
+ *
+ *      * The names of its contributors may not be used to endorse or
+ *  promote products derived from this software without specific prior
+ *  written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *  A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *  OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *  SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *  LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *  DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *  THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *  OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+/*
+  Transparent value compression. A compressed value starts with a small
+  header:
+
+    codec (1 byte, the high bit is set if a dictionary was used)
+    length of the original value (4 bytes, little endian)
+    id of the dictionary (4 bytes, little endian, only with a dictionary)
+
+  The value is compressed before it is encrypted, and decompressed after
+  it has been decrypted.
+*/
+
+#include <libmemcached/common.h>
+#include <libmemcached/lz4.hpp>
+
+#include <cstring>
+#include <ctime>
+
+#if defined(LIBMEMCACHED_WITH_LIBZ) && LIBMEMCACHED_WITH_LIBZ
+#include <zlib.h>
+#endif
+
+#define COMPRESSION_CODEC_FAST 1
+#define COMPRESSION_CODEC_ZLIB 2
+#define COMPRESSION_CODEC_DICTIONARY 0x80
+#define COMPRESSION_HEADER_LENGTH 5
+#define COMPRESSION_DICTIONARY_ID_LENGTH 4
+#define COMPRESSION_MAX_DICTIONARY (64 * 1024) // Matches cannot reach back any further
+
+static uint64_t compression_now(void)
+{
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return uint64_t(now.tv_sec) * 1000000000ULL + uint64_t(now.tv_nsec);
+}
+
+static inline void compression_write32(uint8_t *ptr, uint32_t value)
+{
+  ptr[0]= uint8_t(value);
+  ptr[1]= uint8_t(value >> 8);
+  ptr[2]= uint8_t(value >> 16);
+  ptr[3]= uint8_t(value >> 24);
+}
+
+static inline uint32_t compression_read32(const uint8_t *ptr)
+{
+  return uint32_t(ptr[0]) | (uint32_t(ptr[1]) << 8) | (uint32_t(ptr[2]) << 16) | (uint32_t(ptr[3]) << 24);
+}
+
+static memcached_compression_st *compression_state(memcached_st& self)
+{
+  if (self.compression == NULL)
+  {
+    memcached_compression_st *state= libmemcached_xcalloc(&self, 1, memcached_compression_st);
+    if (state == NULL)
+    {
+      return NULL;
+    }
+    state->codec= MEMCACHED_COMPRESSION_NONE;
+    state->threshold= MEMCACHED_DEFAULT_COMPRESSION_THRESHOLD;
+    self.compression= state;
+  }
+
+  return self.compression;
+}
+
+static bool compression_reserve(memcached_st& self, memcached_compression_st& state, size_t length)
+{
+  if (length > state.buffer_size)
+  {
+    char *buffer= libmemcached_xrealloc(&self, state.buffer, length, char);
+    if (buffer == NULL)
+    {
+      return false;
+    }
+    state.buffer= buffer;
+    state.buffer_size= length;
+  }
+
+  return true;
+}
+
+#if defined(LIBMEMCACHED_WITH_LIBZ) && LIBMEMCACHED_WITH_LIBZ
+static voidpf compression_zalloc(voidpf opaque, uInt items, uInt size)
+{
+  return libmemcached_calloc(static_cast<memcached_st *>(opaque), items, size);
+}
+
+static void compression_zfree(voidpf opaque, voidpf address)
+{
+  libmemcached_free(static_cast<memcached_st *>(opaque), address);
+}
+
+static z_stream *compression_zstream(memcached_st& self)
+{
+  z_stream *stream= libmemcached_xcalloc(&self, 1, z_stream);
+  if (stream)
+  {
+    stream->zalloc= compression_zalloc;
+    stream->zfree= compression_zfree;
+    stream->opaque= &self;
+  }
+
+  return stream;
+}
+#endif
+
+static size_t compression_deflate(memcached_st& self, memcached_compression_st& state,
+                                  const char *value, size_t value_length,
+                                  char *destination, size_t capacity)
+{
+#if defined(LIBMEMCACHED_WITH_LIBZ) && LIBMEMCACHED_WITH_LIBZ
+  z_stream *stream= static_cast<z_stream *>(state.deflate);
+  if (stream == NULL)
+  {
+    if ((stream= compression_zstream(self)) == NULL)
+    {
+      return 0;
+    }
+
+    // Raw deflate, the header carries everything a zlib or gzip wrapper would
+    if (deflateInit2(stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED, -MAX_WBITS, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+    {
+      libmemcached_free(&self, stream);
+      return 0;
+    }
+    state.deflate= stream;
+  }
+  else if (deflateReset(stream) != Z_OK)
+  {
+    return 0;
+  }
+
+  if (state.dictionary and deflateSetDictionary(stream, (const Bytef *)state.dictionary, uInt(state.dictionary_length)) != Z_OK)
+  {
+    return 0;
+  }
+
+  stream->next_in= (Bytef *)value;
+  stream->avail_in= uInt(value_length);
+  stream->next_out= (Bytef *)destination;
+  stream->avail_out= uInt(capacity);
+
+  if (deflate(stream, Z_FINISH) != Z_STREAM_END)
+  {
+    return 0;
+  }
+
+  return capacity - stream->avail_out;
+#else
+  (void)self;
+  (void)state;
+  (void)value;
+  (void)value_length;
+  (void)destination;
+  (void)capacity;
+  return 0;
+#endif
+}
+
+static bool compression_inflate(memcached_st& self, memcached_compression_st& state,
+                                const char *source, size_t length,
+                                char *destination, size_t destination_length,
+                                bool dictionary)
+{
+#if defined(LIBMEMCACHED_WITH_LIBZ) && LIBMEMCACHED_WITH_LIBZ
+  z_stream *stream= static_cast<z_stream *>(state.inflate);
+  if (stream == NULL)
+  {
+    if ((stream= compression_zstream(self)) == NULL)
+    {
+      return false;
+    }
+
+    if (inflateInit2(stream, -MAX_WBITS) != Z_OK)
+    {
+      libmemcached_free(&self, stream);
+      return false;
+    }
+    state.inflate= stream;
+  }
+  else if (inflateReset(stream) != Z_OK)
+  {
+    return false;
+  }
+
+  if (dictionary and inflateSetDictionary(stream, (const Bytef *)state.dictionary, uInt(state.dictionary_length)) != Z_OK)
+  {
+    return false;
+  }
+
+  stream->next_in= (Bytef *)source;
+  stream->avail_in= uInt(length);
+  stream->next_out= (Bytef *)destination;
+  stream->avail_out= uInt(destination_length);
+
+  return inflate(stream, Z_FINISH) == Z_STREAM_END and stream->avail_in == 0 and stream->avail_out == 0;
+#else
+  (void)self;
+  (void)state;
+  (void)source;
+  (void)length;
+  (void)destination;
+  (void)destination_length;
+  (void)dictionary;
+  return false;
+#endif
+}
+
+memcached_return_t memcached_compression_set(memcached_st& self, memcached_compression_t codec)
+{
+  if (codec >= MEMCACHED_COMPRESSION_MAX)
+  {
+    return memcached_set_error(self, MEMCACHED_INVALID_ARGUMENTS, MEMCACHED_AT,
+                               memcached_literal_param("Invalid memcached_compression_t"));
+  }
+
+  if (codec == MEMCACHED_COMPRESSION_ZLIB and LIBMEMCACHED_WITH_LIBZ == 0)
+  {
+    return memcached_set_error(self, MEMCACHED_NOT_SUPPORTED, MEMCACHED_AT,
+                               memcached_literal_param("libmemcached was built without zlib"));
+  }
+
+  if (codec == MEMCACHED_COMPRESSION_NONE and self.compression == NULL)
+  {
+    return MEMCACHED_SUCCESS;
+  }
+
+  memcached_compression_st *state= compression_state(self);
+  if (state == NULL)
+  {
+    return memcached_set_error(self, MEMCACHED_MEMORY_ALLOCATION_FAILURE, MEMCACHED_AT);
+  }
+
+  if (codec == MEMCACHED_COMPRESSION_FAST and state->lz4 == NULL)
+  {
+    if ((state->lz4= libmemcached_xmalloc(&self, memcached_lz4_st)) == NULL)
+    {
+      return memcached_set_error(self, MEMCACHED_MEMORY_ALLOCATION_FAILURE, MEMCACHED_AT);
+    }
+    memcached_lz4_init(*state->lz4, state->dictionary, state->dictionary_length);
+  }
+  state->codec= codec;
+
+  return MEMCACHED_SUCCESS;
+}
+
+memcached_return_t memcached_compression_set_threshold(memcached_st& self, uint64_t threshold)
+{
+  if (threshold > UINT32_MAX)
+  {
+    return memcached_set_error(self, MEMCACHED_INVALID_ARGUMENTS, MEMCACHED_AT,
+                               memcached_literal_param("MEMCACHED_BEHAVIOR_COMPRESSION_THRESHOLD is limited to 4GB."));
+  }
+
+  memcached_compression_st *state= compression_state(self);
+  if (state == NULL)
+  {
+    return memcached_set_error(self, MEMCACHED_MEMORY_ALLOCATION_FAILURE, MEMCACHED_AT);
+  }
+  state->threshold= uint32_t(threshold);
+
+  return MEMCACHED_SUCCESS;
+}
+
+memcached_compression_t memcached_compression_get(const memcached_st& self)
+{
+  return self.compression ? self.compression->codec : MEMCACHED_COMPRESSION_NONE;
+}
+
+uint32_t memcached_compression_get_threshold(const memcached_st& self)
+{
+  return self.compression ? self.compression->threshold : MEMCACHED_DEFAULT_COMPRESSION_THRESHOLD;
+}
+
+memcached_return_t memcached_set_compression_dictionary(memcached_st *ptr,
+                                                        const char *dictionary,
+                                                        size_t length)
+{
+  if (ptr == NULL)
+  {
+    return MEMCACHED_INVALID_ARGUMENTS;
+  }
+
+  char *copy= NULL;
+  if (dictionary and length)
+  {
+    if (length > COMPRESSION_MAX_DICTIONARY)
+    {
+      dictionary+= length - COMPRESSION_MAX_DICTIONARY;
+      length= COMPRESSION_MAX_DICTIONARY;
+    }
+
+    if ((copy= libmemcached_xvalloc(ptr, length, char)) == NULL)
+    {
+      return memcached_set_error(*ptr, MEMCACHED_MEMORY_ALLOCATION_FAILURE, MEMCACHED_AT);
+    }
+    memcpy(copy, dictionary, length);
+  }
+  else if (ptr->compression == NULL)
+  {
+    return MEMCACHED_SUCCESS;
+  }
+  else
+  {
+    length= 0;
+  }
+
+  memcached_compression_st *state= compression_state(*ptr);
+  if (state == NULL)
+  {
+    libmemcached_free(ptr, copy);
+    return memcached_set_error(*ptr, MEMCACHED_MEMORY_ALLOCATION_FAILURE, MEMCACHED_AT);
+  }
+
+  libmemcached_free(ptr, state->dictionary);
+  state->dictionary= copy;
+  state->dictionary_length= length;
+  state->dictionary_id= copy ? libhashkit_fnv1a_32(copy, length) : 0;
+
+  if (state->lz4)
+  {
+    memcached_lz4_init(*state->lz4, state->dictionary, state->dictionary_length);
+  }
+
+  return MEMCACHED_SUCCESS;
+}
+
+memcached_return_t memcached_compression_stat(const memcached_st *ptr,
+                                              memcached_compression_stat_st *stat)
+{
+  if (ptr == NULL or stat == NULL)
+  {
+    return MEMCACHED_INVALID_ARGUMENTS;
+  }
+
+  if (ptr->compression)
+  {
+    *stat= ptr->compression->stat;
+  }
+  else
+  {
+    memset(stat, 0, sizeof(memcached_compression_stat_st));
+  }
+
+  return MEMCACHED_SUCCESS;
+}
+
+void memcached_compression_stat_reset(memcached_st *ptr)
+{
+  if (ptr and ptr->compression)
+  {
+    memset(&ptr->compression->stat, 0, sizeof(memcached_compression_stat_st));
+  }
+}
+
+memcached_return_t memcached_compression_clone(memcached_st *destination, const memcached_st *source)
+{
+  if (source->compression == NULL)
+  {
+    return MEMCACHED_SUCCESS;
+  }
+
+  memcached_return_t rc;
+  if (memcached_failed(rc= memcached_compression_set_threshold(*destination, source->compression->threshold)))
+  {
+    return rc;
+  }
+
+  if (memcached_failed(rc= memcached_set_compression_dictionary(destination,
+                                                                source->compression->dictionary,
+                                                                source->compression->dictionary_length)))
+  {
+    return rc;
+  }
+
+  return memcached_compression_set(*destination, source->compression->codec);
+}
+
+void memcached_compression_free(memcached_st *ptr)
+{
+  memcached_compression_st *state= ptr->compression;
+  if (state == NULL)
+  {
+    return;
+  }
+
+#if defined(LIBMEMCACHED_WITH_LIBZ) && LIBMEMCACHED_WITH_LIBZ
+  if (state->deflate)
+  {
+    deflateEnd(static_cast<z_stream *>(state->deflate));
+    libmemcached_free(ptr, state->deflate);
+  }
+
+  if (state->inflate)
+  {
+    inflateEnd(static_cast<z_stream *>(state->inflate));
+    libmemcached_free(ptr, state->inflate);
+  }
+#endif
+
+  libmemcached_free(ptr, state->lz4);
+  libmemcached_free(ptr, state->dictionary);
+  libmemcached_free(ptr, state->buffer);
+  libmemcached_free(ptr, state);
+  ptr->compression= NULL;
+}
+
+memcached_return_t memcached_compress_value(memcached_st& self,
+                                            const char *&value, size_t &value_length,
+                                            uint32_t &flags)
+{
+  memcached_compression_st& state= *self.compression;
+  if (flags & MEMCACHED_FLAG_COMPRESSED)
+  {
+    return memcached_set_error(self, MEMCACHED_INVALID_ARGUMENTS, MEMCACHED_AT,
+                               memcached_literal_param("MEMCACHED_FLAG_COMPRESSED is reserved while compression is enabled"));
+  }
+
+  const size_t header_length= COMPRESSION_HEADER_LENGTH + (state.dictionary ? COMPRESSION_DICTIONARY_ID_LENGTH : 0);
+  if (value_length < state.threshold or value_length <= header_length or value_length > UINT32_MAX)
+  {
+    return MEMCACHED_SUCCESS;
+  }
+
+  if (compression_reserve(self, state, value_length) == false)
+  {
+    return memcached_set_error(self, MEMCACHED_MEMORY_ALLOCATION_FAILURE, MEMCACHED_AT);
+  }
+
+  // Anything that is not smaller than the value is not worth sending
+  const size_t capacity= value_length - header_length - 1;
+  uint8_t codec;
+  size_t compressed;
+  uint64_t started= compression_now();
+  if (state.codec == MEMCACHED_COMPRESSION_FAST)
+  {
+    codec= COMPRESSION_CODEC_FAST;
+    compressed= memcached_lz4_compress(*state.lz4, value, value_length, state.buffer + header_length, capacity);
+  }
+  else
+  {
+    codec= COMPRESSION_CODEC_ZLIB;
+    compressed= compression_deflate(self, state, value, value_length, state.buffer + header_length, capacity);
+  }
+  state.stat.compress_nsec+= compression_now() - started;
+
+  if (compressed == 0)
+  {
+    state.stat.skipped++;
+    return MEMCACHED_SUCCESS;
+  }
+
+  uint8_t *header= (uint8_t *)state.buffer;
+  header[0]= codec;
+  compression_write32(header + 1, uint32_t(value_length));
+  if (state.dictionary)
+  {
+    header[0]|= COMPRESSION_CODEC_DICTIONARY;
+    compression_write32(header + COMPRESSION_HEADER_LENGTH, state.dictionary_id);
+  }
+
+  state.stat.compressed++;
+  state.stat.bytes_in+= value_length;
+  state.stat.bytes_out+= header_length + compressed;
+
+  value= state.buffer;
+  value_length= header_length + compressed;
+  flags|= MEMCACHED_FLAG_COMPRESSED;
+
+  return MEMCACHED_SUCCESS;
+}
+
+/*
+  The most a payload of compressed_length bytes can decode to. An LZ4
+  sequence spends at least one byte on every 255 it produces, deflate at
+  least one byte on every 1032, so a larger original length in the header
+  is a lie and nothing is allocated for it.
+*/
+static inline size_t compression_max_length(const uint8_t codec, const size_t compressed_length)
+{
+  return (compressed_length + 1) * (codec == COMPRESSION_CODEC_FAST ? 255 : 1032);
+}
+
+static memcached_return_t compression_failed(memcached_st& root, memcached_result_st& result,
+                                             const char *message, size_t message_length)
+{
+  root.compression->stat.failures++;
+  memcached_result_reset(&result);
+
+  return memcached_set_error(root, MEMCACHED_FAILURE, MEMCACHED_AT, message, message_length);
+}
+
+memcached_return_t memcached_decompress_result(memcached_server_write_instance_st instance,
+                                               memcached_result_st& result)
+{
+  memcached_st& root= *instance->root;
+  memcached_compression_st& state= *root.compression;
+  result.item_flags&= ~MEMCACHED_FLAG_COMPRESSED;
+
+  const uint8_t *header= (const uint8_t *)memcached_result_value(&result);
+  const size_t length= memcached_result_length(&result);
+  if (length < COMPRESSION_HEADER_LENGTH)
+  {
+    return compression_failed(root, result, memcached_literal_param("Compressed value is truncated"));
+  }
+
+  const uint8_t codec= header[0] & ~COMPRESSION_CODEC_DICTIONARY;
+  const bool dictionary= header[0] & COMPRESSION_CODEC_DICTIONARY;
+  const size_t original_length= compression_read32(header + 1);
+  const size_t header_length= COMPRESSION_HEADER_LENGTH + (dictionary ? COMPRESSION_DICTIONARY_ID_LENGTH : 0);
+  if (length < header_length)
+  {
+    return compression_failed(root, result, memcached_literal_param("Compressed value is truncated"));
+  }
+
+  if (dictionary and (state.dictionary == NULL or compression_read32(header + COMPRESSION_HEADER_LENGTH) != state.dictionary_id))
+  {
+    return compression_failed(root, result, memcached_literal_param("Value was compressed with another dictionary"));
+  }
+
+  if (codec != COMPRESSION_CODEC_FAST and codec != COMPRESSION_CODEC_ZLIB)
+  {
+    return compression_failed(root, result, memcached_literal_param("Value was compressed with an unknown codec"));
+  }
+
+  if (original_length > compression_max_length(codec, length - header_length))
+  {
+    return compression_failed(root, result, memcached_literal_param("Compressed value claims an impossible length"));
+  }
+
+  uint64_t started= compression_now();
+
+  // The received payload moves to the scratch buffer, so the original is decoded straight into the result
+  if (result.value.root == &root)
+  {
+    char *received= result.value.string;
+    size_t received_size= result.value.current_size;
+    result.value.string= result.value.end= state.buffer;
+    result.value.current_size= state.buffer_size;
+    state.buffer= received;
+    state.buffer_size= received_size;
+  }
+  else
+  {
+    if (compression_reserve(root, state, length) == false)
+    {
+      memcached_result_reset(&result);
+      return memcached_set_error(root, MEMCACHED_MEMORY_ALLOCATION_FAILURE, MEMCACHED_AT);
+    }
+    memcpy(state.buffer, header, length);
+    memcached_string_reset(&result.value);
+  }
+
+  if (memcached_failed(memcached_string_check(&result.value, original_length + 1)))
+  {
+    memcached_result_reset(&result);
+    return memcached_last_error(&root);
+  }
+
+  const char *source= state.buffer + header_length;
+  char *value= memcached_string_value_mutable(&result.value);
+  bool decompressed;
+  if (codec == COMPRESSION_CODEC_FAST)
+  {
+    decompressed= memcached_lz4_decompress(source, length - header_length, value, original_length,
+                                           dictionary ? state.dictionary : NULL,
+                                           dictionary ? state.dictionary_length : 0);
+  }
+  else
+  {
+    decompressed= compression_inflate(root, state, source, length - header_length,
+                                      value, original_length, dictionary);
+  }
+  state.stat.decompress_nsec+= compression_now() - started;
+
+  if (decompressed == false)
+  {
+    return compression_failed(root, result, memcached_literal_param("Value could not be decompressed"));
+  }
+
+  value[original_length]= 0;
+  memcached_string_set_length(&result.value, original_length);
+
+  state.stat.decompressed++;
+  state.stat.decompressed_bytes_in+= length;
+  state.stat.decompressed_bytes_out+= original_length;
+
+  return MEMCACHED_SUCCESS;
+}
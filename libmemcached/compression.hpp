@@ -0,0 +1,81 @@
+/*  vim:expandtab:shiftwidth=2:tabstop=2:smarttab:
+ * 
+ *  Libmemcached library
+ *
+ *  Copyright (C) 2011-2012 Data Differential, http://datadifferential.com/
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are
+ *  met:
+ *
+ *      * Redistributions of source code must retain the above copyright
+ *  notice, this list of conditions and the following disclaimer.
+ *
+ *      * Redistributions in binary form must reproduce the above
+ *  copyright notice, this list of conditions and the following disclaimer
+ *  in the documentation and/or other materials provided with the
+ *  distribution.
+ *
+ *      * The names of its contributors may not be used to endorse or
+ *  promote products derived from this software without specific prior
+ *  written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *  A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *  OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *  SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *  LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *  DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *  THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *  OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+#pragma once
+
+struct memcached_compression_st
+{
+  memcached_compression_t codec;
+  uint32_t threshold;
+  char *dictionary;
+  size_t dictionary_length;
+  uint32_t dictionary_id;
+  char *buffer; // Compressed values on the way out, the received payload on the way in
+  size_t buffer_size;
+  struct memcached_lz4_st *lz4;
+  void *deflate; // z_stream, kept so that its allocations are reused
+  void *inflate;
+  memcached_compression_stat_st stat;
+};
+
+memcached_return_t memcached_compression_set(memcached_st& self, memcached_compression_t codec);
+
+memcached_return_t memcached_compression_set_threshold(memcached_st& self, uint64_t threshold);
+
+memcached_compression_t memcached_compression_get(const memcached_st& self);
+
+uint32_t memcached_compression_get_threshold(const memcached_st& self);
+
+memcached_return_t memcached_compression_clone(memcached_st *destination, const memcached_st *source);
+
+void memcached_compression_free(memcached_st *ptr);
+
+/*
+  Points value at the compressed form and sets MEMCACHED_FLAG_COMPRESSED,
+  or leaves all three alone when the value is below the threshold or does
+  not get any smaller.
+*/
+memcached_return_t memcached_compress_value(memcached_st& self,
+                                            const char *&value, size_t &value_length,
+                                            uint32_t &flags);
+
+/*
+  Replaces a value that was stored with MEMCACHED_FLAG_COMPRESSED by the
+  original. The result is reset if that fails.
+*/
+memcached_return_t memcached_decompress_result(memcached_server_write_instance_st instance,
+                                               memcached_result_st& result);
@@ -146,7 +146,7 @@ static memcached_return_t connect_poll(memcached_server_st *server)
   return memcached_set_errno(*server, get_socket_errno(), MEMCACHED_AT);
 }
 
-static memcached_return_t set_hostinfo(memcached_server_st *server)
+static memcached_return_t _set_hostinfo(memcached_server_st *server)
 {
   assert(server->type != MEMCACHED_CONNECTION_UNIX_SOCKET);
   if (server->address_info)
@@ -221,6 +221,15 @@ static memcached_return_t set_hostinfo(memcached_server_st *server)
   return MEMCACHED_SUCCESS;
 }
 
+static memcached_return_t set_hostinfo(memcached_server_st *server)
+{
+  memcached_slowlog_phase_t phase= memcached_slowlog_enter(server->root, MEMCACHED_SLOWLOG_PHASE_DNS);
+  memcached_return_t rc= _set_hostinfo(server);
+  memcached_slowlog_leave(server->root, phase);
+
+  return rc;
+}
+
 static inline void set_socket_nonblocking(memcached_server_st *server)
 {
 #ifdef WIN32
@@ -264,6 +273,10 @@ static void set_socket_options(memcached_server_st *server)
 
   if (memcached_is_udp(server->root))
   {
+    // The answer to a get arrives as a burst of datagrams, those that do not fit are dropped
+    int recv_size= server->root->recv_size > 0 ? server->root->recv_size : MEMCACHED_DEFAULT_UDP_RECV_SIZE;
+    (void)setsockopt(server->fd, SOL_SOCKET, SO_RCVBUF, &recv_size, (socklen_t)sizeof(int));
+
     return;
   }
 
@@ -594,6 +607,7 @@ static memcached_return_t backoff_handling(memcached_server_write_instance_st se
     if (_is_auto_eject_host(server->root))
     {
       set_last_disconnected_host(server);
+      memcached_telemetry_ejection(server);
 
       // Retry dead servers if requested
       if (_gettime_success and server->root->dead_timeout > 0)
@@ -642,13 +656,8 @@ static memcached_return_t backoff_handling(memcached_server_write_instance_st se
   return MEMCACHED_SUCCESS;
 }
 
-static memcached_return_t _memcached_connect(memcached_server_write_instance_st server, const bool set_last_disconnected)
+static memcached_return_t server_connect(memcached_server_write_instance_st server, const bool set_last_disconnected)
 {
-  if (server->fd != INVALID_SOCKET)
-  {
-    return MEMCACHED_SUCCESS;
-  }
-
   LIBMEMCACHED_MEMCACHED_CONNECT_START();
 
   bool in_timeout= false;
@@ -680,7 +689,9 @@ static memcached_return_t _memcached_connect(memcached_server_write_instance_st
     {
       if (server->fd != INVALID_SOCKET and server->root->sasl.callbacks)
       {
+        LIBMEMCACHED_MEMCACHED_SASL_AUTHENTICATE_START(server->hostname, int(server->port));
         rc= memcached_sasl_authenticate_connection(server);
+        LIBMEMCACHED_MEMCACHED_SASL_AUTHENTICATE_END(server->hostname, int(server->port), int(rc));
         if (memcached_failed(rc) and server->fd != INVALID_SOCKET)
         {
           WATCHPOINT_ASSERT(server->fd != INVALID_SOCKET);
@@ -699,6 +710,7 @@ static memcached_return_t _memcached_connect(memcached_server_write_instance_st
   if (memcached_success(rc))
   {
     memcached_mark_server_as_clean(server);
+    memcached_telemetry_connect(server);
     return rc;
   }
   else if (set_last_disconnected)
@@ -728,6 +740,20 @@ static memcached_return_t _memcached_connect(memcached_server_write_instance_st
   return rc;
 }
 
+static memcached_return_t _memcached_connect(memcached_server_write_instance_st server, const bool set_last_disconnected)
+{
+  if (server->fd != INVALID_SOCKET)
+  {
+    return MEMCACHED_SUCCESS;
+  }
+
+  memcached_slowlog_phase_t phase= memcached_slowlog_enter(server->root, MEMCACHED_SLOWLOG_PHASE_CONNECT);
+  memcached_return_t rc= server_connect(server, set_last_disconnected);
+  memcached_slowlog_leave(server->root, phase);
+
+  return rc;
+}
+
 memcached_return_t memcached_connect_try(memcached_server_write_instance_st server)
 {
   return _memcached_connect(server, false);
@@ -65,6 +65,31 @@ static inline memcached_return_t ascii_delete(memcached_server_write_instance_st
   return memcached_vdo(instance, vector, 6, is_buffering ? false : true);
 }
 
+static inline memcached_return_t meta_delete(memcached_server_write_instance_st instance,
+                                             uint32_t ,
+                                             const char *key,
+                                             const size_t key_length,
+                                             const bool reply,
+                                             const bool is_buffering)
+{
+  memcached_meta_key_st meta_key;
+  memcached_meta_key(*instance->root, key, key_length, meta_key);
+
+  libmemcached_io_vector_st vector[]=
+  {
+    { NULL, 0 },
+    { memcached_literal_param("md ") },
+    meta_key.vector[0],
+    meta_key.vector[1],
+    { " b", meta_key.base64 ? memcached_literal_param_size(" b") : 0 },
+    { MEMCACHED_META_QUIET, reply ? 0 : memcached_literal_param_size(MEMCACHED_META_QUIET) },
+    { memcached_literal_param("\r\n") }
+  };
+
+  /* Send command header, only flush if we are NOT buffering */
+  return memcached_vdo(instance, vector, 7, is_buffering ? false : true);
+}
+
 static inline memcached_return_t binary_delete(memcached_server_write_instance_st instance,
                                                uint32_t server_key,
                                                const char *key,
@@ -156,8 +181,12 @@ memcached_return_t memcached_delete_by_key(memcached_st *memc,
                                memcached_literal_param("Memcached server version does not allow expiration of deleted items"));
   }
 
+  uint64_t traced= memcached_trace_start(memc);
+
+  bool timed= memcached_slowlog_start(memc);
   uint32_t server_key= memcached_generate_hash_with_redistribution(memc, group_key, group_key_length);
   memcached_server_write_instance_st instance= memcached_server_instance_fetch(memc, server_key);
+  uint64_t started= memcached_telemetry_start(memc);
   
   bool is_buffering= memcached_is_buffering(instance->root);
   bool is_replying= memcached_is_replying(instance->root);
@@ -182,6 +211,10 @@ memcached_return_t memcached_delete_by_key(memcached_st *memc,
   {
     rc= binary_delete(instance, server_key, key, key_length, is_replying, is_buffering);
   }
+  else if (memcached_is_meta(memc))
+  {
+    rc= meta_delete(instance, server_key, key, key_length, is_replying, is_buffering);
+  }
   else
   {
     rc= ascii_delete(instance, server_key, key, key_length, is_replying, is_buffering);
@@ -201,7 +234,8 @@ memcached_return_t memcached_delete_by_key(memcached_st *memc,
     {
       char buffer[MEMCACHED_DEFAULT_COMMAND_SIZE];
       rc= memcached_response(instance, buffer, MEMCACHED_DEFAULT_COMMAND_SIZE, NULL);
-      if (rc == MEMCACHED_DELETED)
+      // md answers HD, as every meta command that worked does
+      if (rc == MEMCACHED_DELETED or (rc == MEMCACHED_SUCCESS and memcached_is_meta(memc)))
       {
         rc= MEMCACHED_SUCCESS;
         if (memc->delete_trigger)
@@ -212,6 +246,15 @@ memcached_return_t memcached_delete_by_key(memcached_st *memc,
     }
   }
 
+  memcached_telemetry_record(instance, MEMCACHED_TELEMETRY_OP_DELETE, started, rc);
+  memcached_slowlog_end(memc, timed, MEMCACHED_TELEMETRY_OP_DELETE, key_length, 1, 0, rc);
+  memcached_trace_end(memc, traced, MEMCACHED_TELEMETRY_OP_DELETE, key, key_length, 1, 0, rc);
+
+  if (memc->near_cache)
+  {
+    memcached_near_cache_invalidate(memc, group_key, group_key_length, key, key_length, 0);
+  }
+
   LIBMEMCACHED_MEMCACHED_DELETE_END();
   return rc;
 }
@@ -11,10 +11,11 @@
 
 #include <libmemcached/common.h>
 
-memcached_return_t memcached_vdo(memcached_server_write_instance_st instance,
-                                 libmemcached_io_vector_st vector[],
-                                 const size_t count,
-                                 const bool with_flush)
+static memcached_return_t _vdo(memcached_server_write_instance_st instance,
+                               libmemcached_io_vector_st vector[],
+                               const size_t count,
+                               const size_t encrypted,
+                               const bool with_flush)
 {
   memcached_return_t rc;
 
@@ -40,14 +41,45 @@ memcached_return_t memcached_vdo(memcached_server_write_instance_st instance,
                                  memcached_literal_param("UDP messages was attempted, but vector was not setup for it"));
     }
 
+    if (count > UDP_DATAGRAM_MAX_VECTOR)
+    {
+      return memcached_set_error(*instance->root, MEMCACHED_NOT_SUPPORTED, MEMCACHED_AT,
+                                 memcached_literal_param("UDP message has too many parts"));
+    }
+
+    // The caller sends the same vector to every replica, and again on a retry, so it is left alone
+    struct iovec datagram[UDP_DATAGRAM_MAX_VECTOR];
+    for (size_t x= 1; x < count; x++)
+    {
+      datagram[x].iov_base= const_cast<void *>(vector[x].buffer);
+      datagram[x].iov_len= vector[x].length;
+    }
+
     struct msghdr msg;
     memset(&msg, 0, sizeof(msg));
 
     increment_udp_message_id(instance);
-    vector[0].buffer= instance->write_buffer;
-    vector[0].length= UDP_DATAGRAM_HEADER_LENGTH;
+    datagram[0].iov_base= instance->write_buffer;
+    datagram[0].iov_len= UDP_DATAGRAM_HEADER_LENGTH;
+
+    // The rest of the write buffer is free, the value is encrypted into it
+    if (encrypted < count)
+    {
+      const char *value= static_cast<const char *>(vector[encrypted].buffer);
+      size_t value_length= vector[encrypted].length;
+      if (hashkit_encrypt_length(&instance->root->hashkit, value_length) > MEMCACHED_MAX_BUFFER -UDP_DATAGRAM_HEADER_LENGTH)
+      {
+        return memcached_set_error(*instance, MEMCACHED_WRITE_FAILURE, MEMCACHED_AT);
+      }
+
+      char *write_ptr= instance->write_buffer +UDP_DATAGRAM_HEADER_LENGTH;
+      size_t length= hashkit_encrypt_update(&instance->root->hashkit, value, value_length, write_ptr);
+      length+= hashkit_encrypt_final(&instance->root->hashkit, value +length, value_length -length, write_ptr +length);
+      datagram[encrypted].iov_base= write_ptr;
+      datagram[encrypted].iov_len= length;
+    }
 
-    msg.msg_iov= (struct iovec*)vector;
+    msg.msg_iov= datagram;
     msg.msg_iovlen= count;
 
     uint32_t retry= 5;
@@ -72,7 +104,7 @@ memcached_return_t memcached_vdo(memcached_server_write_instance_st instance,
     return MEMCACHED_SUCCESS;
   }
 
-  bool sent_success= memcached_io_writev(instance, vector, count, with_flush);
+  bool sent_success= memcached_io_writev(instance, vector, count, encrypted, with_flush);
   if (sent_success == false)
   {
     if (memcached_last_error(instance->root) == MEMCACHED_SUCCESS)
@@ -91,3 +123,24 @@ memcached_return_t memcached_vdo(memcached_server_write_instance_st instance,
 
   return rc;
 }
+
+memcached_return_t memcached_vdo(memcached_server_write_instance_st instance,
+                                 libmemcached_io_vector_st vector[],
+                                 const size_t count,
+                                 const bool with_flush)
+{
+  return memcached_vdo(instance, vector, count, count, with_flush);
+}
+
+memcached_return_t memcached_vdo(memcached_server_write_instance_st instance,
+                                 libmemcached_io_vector_st vector[],
+                                 const size_t count,
+                                 const size_t encrypted,
+                                 const bool with_flush)
+{
+  memcached_slowlog_phase_t phase= memcached_slowlog_enter(instance->root, MEMCACHED_SLOWLOG_PHASE_WRITE);
+  memcached_return_t rc= _vdo(instance, vector, count, encrypted, with_flush);
+  memcached_slowlog_leave(instance->root, phase);
+
+  return rc;
+}
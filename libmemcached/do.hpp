@@ -41,3 +41,10 @@ memcached_return_t memcached_vdo(memcached_server_write_instance_st ptr,
                                  libmemcached_io_vector_st vector[],
                                  const size_t count,
                                  const bool with_flush);
+
+/* vector[encrypted] holds the plain value, it is encrypted as it is sent */
+memcached_return_t memcached_vdo(memcached_server_write_instance_st ptr,
+                                 libmemcached_io_vector_st vector[],
+                                 const size_t count,
+                                 const size_t encrypted,
+                                 const bool with_flush);
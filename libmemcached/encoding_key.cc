@@ -38,6 +38,8 @@
 #include <libmemcached/common.h>
 #include <libmemcached/assert.hpp>
 
+#include <unistd.h>
+
 static void _set_encoding_key(memcached_st& self, const char *key, size_t key_length)
 {
   hashkit_key(&self.hashkit, key, key_length);
@@ -53,3 +55,107 @@ memcached_return_t memcached_set_encoding_key(memcached_st* self, const char *ke
   _set_encoding_key(*self, key, key_length);
   return MEMCACHED_SUCCESS;
 }
+
+static uint32_t _encryption_threads(const memcached_st& self, size_t length)
+{
+  if (self.encryption.thread_threshold == 0 or length < 2 * size_t(self.encryption.thread_threshold))
+  {
+    return 1;
+  }
+
+  static const long cores= sysconf(_SC_NPROCESSORS_ONLN);
+  size_t threads= length / self.encryption.thread_threshold;
+  if (cores < 1)
+  {
+    return 1;
+  }
+
+  if (threads > size_t(cores))
+  {
+    threads= size_t(cores);
+  }
+
+  return uint32_t(threads);
+}
+
+memcached_return_t memcached_encrypt_value(memcached_st& self,
+                                           const char *key, size_t key_length,
+                                           const char *&value, size_t &value_length,
+                                           uint32_t &flags)
+{
+  if (flags & MEMCACHED_FLAG_AES_GCM)
+  {
+    return memcached_set_error(self, MEMCACHED_INVALID_ARGUMENTS, MEMCACHED_AT,
+                               memcached_literal_param("MEMCACHED_FLAG_AES_GCM is reserved while encryption is enabled"));
+  }
+
+  size_t length= hashkit_gcm_length(&self.hashkit, value_length);
+  if (length > self.encryption.buffer_size)
+  {
+    char *buffer= libmemcached_xrealloc(&self, self.encryption.buffer, length, char);
+    if (buffer == NULL)
+    {
+      return memcached_set_error(self, MEMCACHED_MEMORY_ALLOCATION_FAILURE, MEMCACHED_AT);
+    }
+    self.encryption.buffer= buffer;
+    self.encryption.buffer_size= length;
+  }
+
+  // The key is bound to the envelope, so a value cannot be replayed under another key
+  if (hashkit_gcm_encrypt(&self.hashkit, key, key_length, value, value_length,
+                          self.encryption.buffer, _encryption_threads(self, value_length)) != HASHKIT_SUCCESS)
+  {
+    return memcached_set_error(self, MEMCACHED_FAILURE, MEMCACHED_AT,
+                               memcached_literal_param("hashkit_gcm_encrypt() failed"));
+  }
+
+  value= self.encryption.buffer;
+  value_length= length;
+  flags|= MEMCACHED_FLAG_AES_GCM;
+
+  return MEMCACHED_SUCCESS;
+}
+
+memcached_return_t memcached_decrypt_result(memcached_server_write_instance_st instance, memcached_result_st& result)
+{
+  memcached_st& root= *instance->root;
+  char *value= memcached_string_value_mutable(&result.value);
+  size_t length= memcached_result_length(&result);
+
+  // Plain text is never longer than the cipher text, so it is decrypted in place
+  size_t decrypted_length;
+  bool decrypted;
+  if (result.item_flags & MEMCACHED_FLAG_AES_GCM)
+  {
+    result.item_flags&= ~MEMCACHED_FLAG_AES_GCM;
+    decrypted= hashkit_gcm_decrypt(&root.hashkit, result.item_key, result.key_length,
+                                   value, length, value, &decrypted_length,
+                                   _encryption_threads(root, length)) == HASHKIT_SUCCESS;
+  }
+  else if (root.encryption.mode == MEMCACHED_ENCRYPTION_AES_GCM_ONLY)
+  {
+    memcached_result_reset(&result);
+    return memcached_set_error(root, MEMCACHED_FAILURE, MEMCACHED_AT,
+                               memcached_literal_param("Value was not stored with MEMCACHED_ENCRYPTION_AES_GCM"));
+  }
+  else if (length == 0)
+  {
+    return MEMCACHED_SUCCESS;
+  }
+  else
+  {
+    decrypted= hashkit_decrypt_buffer(&root.hashkit, value, length, value, &decrypted_length);
+  }
+
+  if (decrypted == false)
+  {
+    memcached_result_reset(&result);
+    return memcached_set_error(root, MEMCACHED_FAILURE, MEMCACHED_AT,
+                               memcached_literal_param("hashkit_decrypt() failed"));
+  }
+
+  value[decrypted_length]= 0;
+  memcached_string_set_length(&result.value, decrypted_length);
+
+  return MEMCACHED_SUCCESS;
+}
@@ -46,3 +46,15 @@ extern "C" {
 #ifdef __cplusplus
 }
 #endif
+
+/*
+  Replaces value with its AES-GCM envelope, which lives in the memcached_st
+  until the next call, and marks flags with MEMCACHED_FLAG_AES_GCM.
+*/
+memcached_return_t memcached_encrypt_value(memcached_st&,
+                                           const char *key, size_t key_length,
+                                           const char *&value, size_t &value_length,
+                                           uint32_t &flags);
+
+// Decrypts a fetched value in place, in whichever format it was stored
+memcached_return_t memcached_decrypt_result(memcached_server_write_instance_st, memcached_result_st&);
@@ -74,6 +74,37 @@ static memcached_return_t ascii_exist(memcached_st *memc, memcached_server_write
   return rc;
 }
 
+/* An mg asking for nothing back answers HD or EN, and leaves the item alone */
+static memcached_return_t meta_exist(memcached_st *memc, memcached_server_write_instance_st instance, const char *key, size_t key_length)
+{
+  if (memcached_failed(memcached_meta_key_test(*memc, key, key_length)))
+  {
+    return memcached_set_error(*memc, MEMCACHED_BAD_KEY_PROVIDED, MEMCACHED_AT, memcached_literal_param("Key provided was too long to be base64 encoded."));
+  }
+
+  memcached_meta_key_st meta_key;
+  memcached_meta_key(*memc, key, key_length, meta_key);
+
+  libmemcached_io_vector_st vector[]=
+  {
+    { NULL, 0 },
+    { memcached_literal_param("mg ") },
+    meta_key.vector[0],
+    meta_key.vector[1],
+    { " b", meta_key.base64 ? memcached_literal_param_size(" b") : 0 },
+    { memcached_literal_param("\r\n") }
+  };
+
+  memcached_return_t rc;
+  if (memcached_fatal(rc= memcached_vdo(instance, vector, 6, true)))
+  {
+    return rc;
+  }
+
+  char buffer[MEMCACHED_DEFAULT_COMMAND_SIZE];
+  return memcached_response(instance, buffer, MEMCACHED_DEFAULT_COMMAND_SIZE, NULL);
+}
+
 static memcached_return_t binary_exist(memcached_st *memc, memcached_server_write_instance_st instance, const char *key, size_t key_length)
 {
   protocol_binary_request_set request= {};
@@ -148,6 +179,10 @@ memcached_return_t memcached_exist_by_key(memcached_st *memc,
   {
     rc= binary_exist(memc, instance, key, key_length);
   }
+  else if (memcached_is_meta(memc))
+  {
+    rc= meta_exist(memc, instance, key, key_length);
+  }
   else
   {
     rc= ascii_exist(memc, instance, key, key_length);
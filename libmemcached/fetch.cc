@@ -49,32 +49,6 @@ char *memcached_fetch(memcached_st *ptr, char *key, size_t *key_length,
     error= &unused;
   }
 
-  if (memcached_is_udp(ptr))
-  {
-    if (value_length)
-    {
-      *value_length= 0;
-    }
-
-    if (key_length)
-    {
-      *key_length= 0;
-    }
-
-    if (flags)
-    {
-      *flags= 0;
-    }
-
-    if (key)
-    {
-      *key= 0;
-    }
-
-    *error= MEMCACHED_NOT_SUPPORTED;
-    return NULL;
-  }
-
   result_buffer= memcached_fetch_result(ptr, result_buffer, error);
   if (result_buffer == NULL or memcached_failed(*error))
   {
@@ -166,12 +140,6 @@ memcached_result_st *memcached_fetch_result(memcached_st *ptr,
     return NULL;
   }
 
-  if (memcached_is_udp(ptr))
-  {
-    *error= MEMCACHED_NOT_SUPPORTED;
-    return NULL;
-  }
-
   if (result == NULL)
   {
     // If we have already initialized (ie it is in use) our internal, we
@@ -190,7 +158,38 @@ memcached_result_st *memcached_fetch_result(memcached_st *ptr,
     }
   }
 
+  if (ptr->mget_index and memcached_mget_index_replay(ptr, result))
+  {
+    *error= MEMCACHED_SUCCESS;
+    result->count++;
+    return result;
+  }
+
   *error= MEMCACHED_MAXIMUM_RETURN; // We use this to see if we ever go into the loop
+  if (memcached_is_udp(ptr))
+  {
+    // Nothing is left waiting on the servers, so the loop below is never entered
+    *error= memcached_udp_fetch(*ptr, *result);
+    if (*error == MEMCACHED_SUCCESS)
+    {
+      if (ptr->mget_index)
+      {
+        memcached_mget_index_record(ptr, result);
+      }
+      result->count++;
+      return result;
+    }
+    else if (*error != MEMCACHED_END)
+    {
+      if (memcached_is_allocated(result))
+      {
+        memcached_result_free(result);
+      }
+
+      return NULL;
+    }
+  }
+
   memcached_server_st *server;
   while ((server= memcached_io_get_readable_server(ptr)))
   {
@@ -203,6 +202,20 @@ memcached_result_st *memcached_fetch_result(memcached_st *ptr,
     }
     else if (*error == MEMCACHED_SUCCESS)
     {
+      if (memcached_failed(*error= memcached_response_decode(server, *result)))
+      {
+        if (memcached_is_allocated(result))
+        {
+          memcached_result_free(result);
+        }
+
+        return NULL;
+      }
+
+      if (ptr->mget_index)
+      {
+        memcached_mget_index_record(ptr, result);
+      }
       result->count++;
       return result;
     }
@@ -238,6 +251,7 @@ memcached_result_st *memcached_fetch_result(memcached_st *ptr,
   }
 
   /* We have completed reading data */
+  memcached_mget_index_reset(ptr);
   if (memcached_is_allocated(result))
   {
     memcached_result_free(result);
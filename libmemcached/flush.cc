@@ -189,5 +189,10 @@ memcached_return_t memcached_flush(memcached_st *ptr, time_t expiration)
   }
   LIBMEMCACHED_MEMCACHED_FLUSH_END();
 
+  if (ptr->near_cache)
+  {
+    memcached_near_cache_flush(ptr);
+  }
+
   return rc;
 }
@@ -72,7 +72,13 @@ static memcached_return_t memcached_mget_by_key_real(memcached_st *ptr,
                                                      const char * const *keys,
                                                      const size_t *key_length,
                                                      size_t number_of_keys,
-                                                     bool mget_mode);
+                                                     bool mget_mode,
+                                                     const time_t *expiration);
+
+static bool send_replica_getk(memcached_st *ptr,
+                              memcached_server_write_instance_st instance,
+                              const char *key, size_t key_length,
+                              const time_t *expiration);
 
 static memcached_return_t _binary_config_with_config_cmd(memcached_server_st *server,
                                                                 memcached_st *ptr);
@@ -80,20 +86,151 @@ static memcached_return_t _binary_config_with_config_cmd(memcached_server_st *se
 memcached_return_t _binary_config_with_get_cmd(memcached_server_st *server, 
                                                              memcached_st *ptr);
 
-char *memcached_get_by_key(memcached_st *ptr,
-                           const char *group_key,
-                           size_t group_key_length,
-                           const char *key, size_t key_length,
-                           size_t *value_length,
-                           uint32_t *flags,
-                           memcached_return_t *error)
+/*
+  Read-through for a key that was not found, through the
+  MEMCACHED_CALLBACK_GET_FAILURE callback. The value the callback
+  produces is stored before it is returned.
+*/
+static char *_get_key_failure(memcached_st *ptr,
+                              const char *key, size_t key_length,
+                              size_t *value_length,
+                              uint32_t *flags,
+                              memcached_return_t *error)
 {
-  memcached_return_t unused;
-  if (error == NULL)
+  memcached_result_st key_failure_result;
+  memcached_result_st* result_ptr= memcached_result_create(ptr, &key_failure_result);
+  memcached_return_t rc= ptr->get_key_failure(ptr, key, key_length, result_ptr);
+
+  /* On all failure drop to returning NULL */
+  if (rc == MEMCACHED_SUCCESS or rc == MEMCACHED_BUFFERED)
   {
-    error= &unused;
+    if (rc == MEMCACHED_BUFFERED)
+    {
+      uint64_t latch; /* We use latch to track the state of the original socket */
+      latch= memcached_behavior_get(ptr, MEMCACHED_BEHAVIOR_BUFFER_REQUESTS);
+      if (latch == 0)
+      {
+        memcached_behavior_set(ptr, MEMCACHED_BEHAVIOR_BUFFER_REQUESTS, 1);
+      }
+
+      rc= memcached_set(ptr, key, key_length,
+                        (memcached_result_value(result_ptr)),
+                        (memcached_result_length(result_ptr)),
+                        0,
+                        (memcached_result_flags(result_ptr)));
+
+      if (rc == MEMCACHED_BUFFERED and latch == 0)
+      {
+        memcached_behavior_set(ptr, MEMCACHED_BEHAVIOR_BUFFER_REQUESTS, 0);
+      }
+    }
+    else
+    {
+      rc= memcached_set(ptr, key, key_length,
+                        (memcached_result_value(result_ptr)),
+                        (memcached_result_length(result_ptr)),
+                        0,
+                        (memcached_result_flags(result_ptr)));
+    }
+
+    if (rc == MEMCACHED_SUCCESS or rc == MEMCACHED_BUFFERED)
+    {
+      *error= rc;
+      *value_length= memcached_result_length(result_ptr);
+      *flags= memcached_result_flags(result_ptr);
+      char *result_value=  memcached_string_take_value(&result_ptr->value);
+      memcached_result_free(result_ptr);
+
+      return result_value;
+    }
+  }
+
+  memcached_result_free(result_ptr);
+
+  return NULL;
+}
+
+/*
+  A get that MEMCACHED_BEHAVIOR_HEDGED_READ_PERCENTILE hedges waits on the
+  server it went to for about as long as that server takes to answer most
+  gets, and then asks the next replica as well. Returns the replica, or
+  NULL if the get was not raced.
+*/
+static memcached_server_write_instance_st hedge_replica_get(memcached_st *ptr,
+                                                            const char *group_key, size_t group_key_length,
+                                                            const char *key, size_t key_length,
+                                                            memcached_server_write_instance_st& primary)
+{
+  const uint32_t server_count= memcached_server_count(ptr);
+  uint32_t primary_key= 0;
+  primary= NULL;
+  for (uint32_t x= 0; x < server_count; x++)
+  {
+    memcached_server_write_instance_st instance= memcached_server_instance_fetch(ptr, x);
+    if (memcached_server_response_count(instance))
+    {
+      if (primary)
+      {
+        return NULL;
+      }
+      primary= instance;
+      primary_key= x;
+    }
+  }
+
+  uint64_t delay;
+  if (primary == NULL or memcached_replication_hedge_delay(primary, delay) == false)
+  {
+    return NULL;
+  }
+
+  if (memcached_io_poll_read(primary, delay))
+  {
+    return NULL;
+  }
+
+  // The replicas of a key are the servers that follow the one it hashes to
+  uint32_t master_server_key= group_key_length
+    ? memcached_generate_hash_with_redistribution_skip_polling(ptr, group_key, group_key_length)
+    : memcached_generate_hash_with_redistribution_skip_polling(ptr, key, key_length);
+  uint32_t replicas= ptr->number_of_replicas < server_count ? ptr->number_of_replicas : server_count - 1;
+  uint32_t offset= (primary_key + server_count - master_server_key) % server_count;
+  if (replicas == 0 or offset > replicas)
+  {
+    return NULL;
   }
 
+  memcached_server_write_instance_st replica=
+    memcached_server_instance_fetch(ptr, (master_server_key + (offset + 1) % (replicas + 1)) % server_count);
+
+  if (memcached_server_response_count(replica))
+  {
+    return NULL;
+  }
+
+  if (memcached_failed(memcached_connect(replica)) or
+      send_replica_getk(ptr, replica, key, key_length, NULL) == false)
+  {
+    memcached_io_reset(replica);
+    return NULL;
+  }
+
+  memcached_telemetry_begin(replica, MEMCACHED_TELEMETRY_OP_GET);
+  memcached_server_response_increment(replica);
+  ptr->replication->stat.hedged++;
+
+  return replica;
+}
+
+static char *_get_by_key(memcached_st *ptr,
+                         const char *group_key,
+                         size_t group_key_length,
+                         const char *key, size_t key_length,
+                         size_t *value_length,
+                         uint32_t *flags,
+                         memcached_return_t *error,
+                         bool read_through)
+{
   uint64_t query_id= 0;
   if (ptr)
   {
@@ -103,7 +240,7 @@ char *memcached_get_by_key(memcached_st *ptr,
   /* Request the key */
   *error= memcached_mget_by_key_real(ptr, group_key, group_key_length,
                                      (const char * const *)&key, &key_length, 
-                                     1, false);
+                                     1, false, NULL);
   if (ptr)
   {
     assert_msg(ptr->query_id == query_id +1, "Programmer error, the query_id was not incremented.");
@@ -127,10 +264,35 @@ char *memcached_get_by_key(memcached_st *ptr,
     return NULL;
   }
 
+  memcached_server_write_instance_st primary= NULL;
+  memcached_server_write_instance_st replica= NULL;
+  if (ptr->replication and ptr->number_of_replicas and memcached_is_binary(ptr))
+  {
+    replica= hedge_replica_get(ptr, group_key, group_key_length, key, key_length, primary);
+  }
+
   char *value= memcached_fetch(ptr, NULL, NULL,
                                value_length, flags, error);
   assert_msg(ptr->query_id == query_id +1, "Programmer error, the query_id was not incremented.");
 
+  // The first value back is used, the other reply is thrown away when it arrives
+  if (replica)
+  {
+    if (memcached_server_response_count(primary))
+    {
+      memcached_replication_cancel(primary);
+      if (value)
+      {
+        ptr->replication->stat.hedge_wins++;
+      }
+    }
+
+    if (memcached_server_response_count(replica))
+    {
+      memcached_replication_cancel(replica);
+    }
+  }
+
   /* This is for historical reasons */
   if (*error == MEMCACHED_END)
   {
@@ -139,57 +301,12 @@ char *memcached_get_by_key(memcached_st *ptr,
 
   if (value == NULL)
   {
-    if (ptr->get_key_failure and *error == MEMCACHED_NOTFOUND)
+    if (read_through and ptr->get_key_failure and *error == MEMCACHED_NOTFOUND)
     {
-      memcached_result_st key_failure_result;
-      memcached_result_st* result_ptr= memcached_result_create(ptr, &key_failure_result);
-      memcached_return_t rc= ptr->get_key_failure(ptr, key, key_length, result_ptr);
-
-      /* On all failure drop to returning NULL */
-      if (rc == MEMCACHED_SUCCESS or rc == MEMCACHED_BUFFERED)
+      if ((value= _get_key_failure(ptr, key, key_length, value_length, flags, error)))
       {
-        if (rc == MEMCACHED_BUFFERED)
-        {
-          uint64_t latch; /* We use latch to track the state of the original socket */
-          latch= memcached_behavior_get(ptr, MEMCACHED_BEHAVIOR_BUFFER_REQUESTS);
-          if (latch == 0)
-          {
-            memcached_behavior_set(ptr, MEMCACHED_BEHAVIOR_BUFFER_REQUESTS, 1);
-          }
-
-          rc= memcached_set(ptr, key, key_length,
-                            (memcached_result_value(result_ptr)),
-                            (memcached_result_length(result_ptr)),
-                            0,
-                            (memcached_result_flags(result_ptr)));
-
-          if (rc == MEMCACHED_BUFFERED and latch == 0)
-          {
-            memcached_behavior_set(ptr, MEMCACHED_BEHAVIOR_BUFFER_REQUESTS, 0);
-          }
-        }
-        else
-        {
-          rc= memcached_set(ptr, key, key_length,
-                            (memcached_result_value(result_ptr)),
-                            (memcached_result_length(result_ptr)),
-                            0,
-                            (memcached_result_flags(result_ptr)));
-        }
-
-        if (rc == MEMCACHED_SUCCESS or rc == MEMCACHED_BUFFERED)
-        {
-          *error= rc;
-          *value_length= memcached_result_length(result_ptr);
-          *flags= memcached_result_flags(result_ptr);
-          char *result_value=  memcached_string_take_value(&result_ptr->value);
-          memcached_result_free(result_ptr);
-
-          return result_value;
-        }
+        return value;
       }
-
-      memcached_result_free(result_ptr);
     }
     assert_msg(ptr->query_id == query_id +1, "Programmer error, the query_id was not incremented.");
 
@@ -199,6 +316,131 @@ char *memcached_get_by_key(memcached_st *ptr,
   return value;
 }
 
+/*
+  Concurrent gets of the same key share a single request to the server.
+  Unless MEMCACHED_BEHAVIOR_COALESCE_GETS is 2 each caller still runs its
+  own read-through if the key is not found. A caller that gives up waiting
+  on the leader, which may still be in a slow read-through, makes the get
+  on its own.
+*/
+static char *_coalesced_get_by_key(memcached_st *ptr,
+                                   const char *group_key,
+                                   size_t group_key_length,
+                                   const char *key, size_t key_length,
+                                   size_t *value_length,
+                                   uint32_t *flags,
+                                   memcached_return_t *error)
+{
+  bool shared_read_through= ptr->flags.coalesce_get_failure;
+
+  bool leader;
+  memcached_coalesced_get_st *get= memcached_coalesce_join(ptr, group_key, group_key_length, key, key_length, leader);
+  if (get == NULL)
+  {
+    return _get_by_key(ptr, group_key, group_key_length, key, key_length,
+                       value_length, flags, error, true);
+  }
+
+  char *value;
+  bool landed= true;
+  if (leader)
+  {
+    value= _get_by_key(ptr, group_key, group_key_length, key, key_length,
+                       value_length, flags, error, shared_read_through);
+    memcached_coalesce_land(get, value, *value_length, *flags, *error);
+  }
+  else
+  {
+    value= memcached_coalesce_wait(ptr, get, value_length, flags, error, landed);
+  }
+  memcached_coalesce_leave(get);
+
+  if (landed == false)
+  {
+    return _get_by_key(ptr, group_key, group_key_length, key, key_length,
+                       value_length, flags, error, true);
+  }
+
+  if (value == NULL and shared_read_through == false and
+      ptr->get_key_failure and *error == MEMCACHED_NOTFOUND)
+  {
+    value= _get_key_failure(ptr, key, key_length, value_length, flags, error);
+  }
+
+  return value;
+}
+
+char *memcached_get_by_key(memcached_st *ptr,
+                           const char *group_key,
+                           size_t group_key_length,
+                           const char *key, size_t key_length,
+                           size_t *value_length,
+                           uint32_t *flags,
+                           memcached_return_t *error)
+{
+  memcached_return_t unused;
+  if (error == NULL)
+  {
+    error= &unused;
+  }
+
+  if (ptr == NULL)
+  {
+    return _get_by_key(ptr, group_key, group_key_length, key, key_length,
+                       value_length, flags, error, true);
+  }
+
+  size_t unused_length;
+  if (value_length == NULL)
+  {
+    value_length= &unused_length;
+  }
+
+  uint32_t unused_flags;
+  if (flags == NULL)
+  {
+    flags= &unused_flags;
+  }
+
+  uint64_t traced= memcached_trace_start(ptr);
+
+  bool timed= memcached_slowlog_start(ptr);
+  uint64_t started= 0;
+  uint64_t generation= 0;
+  char *value;
+  if (ptr->near_cache and
+      (value= memcached_near_cache_get(ptr, group_key, group_key_length, key, key_length,
+                                       value_length, flags, started, generation)))
+  {
+    memcached_error_free(*ptr);
+    *error= MEMCACHED_SUCCESS;
+    memcached_slowlog_end(ptr, timed, MEMCACHED_TELEMETRY_OP_GET, key_length, 1, *value_length, *error);
+    memcached_trace_end(ptr, traced, MEMCACHED_TELEMETRY_OP_GET, key, key_length, 1, *value_length, *error);
+    return value;
+  }
+
+  if (ptr->flags.coalesce_gets)
+  {
+    value= _coalesced_get_by_key(ptr, group_key, group_key_length, key, key_length,
+                                 value_length, flags, error);
+  }
+  else
+  {
+    value= _get_by_key(ptr, group_key, group_key_length, key, key_length,
+                       value_length, flags, error, true);
+  }
+
+  if (ptr->near_cache)
+  {
+    memcached_near_cache_fill(ptr, group_key, group_key_length, key, key_length,
+                              value, *value_length, *flags, *error, started, generation);
+  }
+  memcached_slowlog_end(ptr, timed, MEMCACHED_TELEMETRY_OP_GET, key_length, 1, value ? *value_length : 0, *error);
+  memcached_trace_end(ptr, traced, MEMCACHED_TELEMETRY_OP_GET, key, key_length, 1, value ? *value_length : 0, *error);
+
+  return value;
+}
+
 memcached_return_t memcached_mget(memcached_st *ptr,
                                   const char * const *keys,
                                   const size_t *key_length,
@@ -213,7 +455,131 @@ static memcached_return_t binary_mget_by_key(memcached_st *ptr,
                                              const char * const *keys,
                                              const size_t *key_length,
                                              size_t number_of_keys,
-                                             bool mget_mode);
+                                             bool mget_mode,
+                                             const time_t *expiration);
+
+/*
+  Every key is an mg asking for its key, value and flags back. The q flag
+  keeps misses quiet, so the mn sent after the keys is the one reply each
+  server owes, just as END is for get. A T flag touches each key it finds.
+*/
+static memcached_return_t meta_mget_by_key(memcached_st *ptr,
+                                           uint32_t master_server_key,
+                                           bool is_group_key_set,
+                                           const char * const *keys,
+                                           const size_t *key_length,
+                                           size_t number_of_keys,
+                                           bool mget_mode,
+                                           const time_t *expiration)
+{
+  bool failures_occured_in_sending= false;
+  memcached_return_t rc= MEMCACHED_SUCCESS;
+
+  char expiration_buffer[MEMCACHED_MAXIMUM_INTEGER_DISPLAY_LENGTH +3];
+  int expiration_buffer_length= 0;
+  if (expiration)
+  {
+    expiration_buffer_length= snprintf(expiration_buffer, sizeof(expiration_buffer), " T%llu", (unsigned long long)*expiration);
+  }
+
+  size_t hosts_connected= 0;
+  for (uint32_t x= 0; x < number_of_keys; x++)
+  {
+    uint32_t server_key;
+    if (is_group_key_set)
+    {
+      server_key= master_server_key;
+    }
+    else if (mget_mode)
+    {
+      server_key= memcached_generate_hash_with_redistribution_skip_polling(ptr, keys[x], key_length[x]);
+    }
+    else
+    {
+      server_key= memcached_generate_hash_with_redistribution(ptr, keys[x], key_length[x]);
+    }
+
+    memcached_server_write_instance_st instance= memcached_server_instance_fetch(ptr, server_key);
+
+    if (memcached_server_response_count(instance) == 0)
+    {
+      if (memcached_failed(rc= memcached_connect(instance)))
+      {
+        memcached_set_error(*instance, rc, MEMCACHED_AT);
+        continue;
+      }
+      hosts_connected++;
+
+      memcached_telemetry_begin(instance, mget_mode ? MEMCACHED_TELEMETRY_OP_MGET : MEMCACHED_TELEMETRY_OP_GET);
+      memcached_server_response_increment(instance);
+    }
+
+    memcached_meta_key_st meta_key;
+    memcached_meta_key(*ptr, keys[x], key_length[x], meta_key);
+
+    libmemcached_io_vector_st vector[]=
+    {
+      { memcached_literal_param("mg ") },
+      meta_key.vector[0],
+      meta_key.vector[1],
+      { " b", meta_key.base64 ? memcached_literal_param_size(" b") : 0 },
+      { expiration_buffer, size_t(expiration_buffer_length) },
+      { ptr->flags.support_cas ? " k v f c q\r\n" : " k v f q\r\n",
+        ptr->flags.support_cas ? memcached_literal_param_size(" k v f c q\r\n") : memcached_literal_param_size(" k v f q\r\n") }
+    };
+
+    if (memcached_io_writev(instance, vector, 6, false) == false)
+    {
+      memcached_server_response_reset(instance);
+      failures_occured_in_sending= true;
+      continue;
+    }
+  }
+
+  if (hosts_connected == 0)
+  {
+    LIBMEMCACHED_MEMCACHED_MGET_END();
+
+    if (memcached_failed(rc))
+    {
+      return rc;
+    }
+
+    return memcached_set_error(*ptr, MEMCACHED_NO_SERVERS, MEMCACHED_AT);
+  }
+
+  bool success_happened= false;
+  for (uint32_t x= 0; x < memcached_server_count(ptr); x++)
+  {
+    memcached_server_write_instance_st instance= memcached_server_instance_fetch(ptr, x);
+
+    if (memcached_server_response_count(instance))
+    {
+      if ((memcached_io_write(instance, memcached_literal_param("mn\r\n"), true)) == -1)
+      {
+        failures_occured_in_sending= true;
+      }
+      else
+      {
+        success_happened= true;
+      }
+    }
+  }
+
+  LIBMEMCACHED_MEMCACHED_MGET_END();
+
+  if (failures_occured_in_sending and success_happened)
+  {
+    return MEMCACHED_SOME_ERRORS;
+  }
+
+  if (success_happened)
+  {
+    return MEMCACHED_SUCCESS;
+  }
+
+  return MEMCACHED_FAILURE; // Complete failure occurred
+}
 
 static memcached_return_t memcached_mget_by_key_real(memcached_st *ptr,
                                                      const char *group_key,
@@ -221,7 +587,8 @@ static memcached_return_t memcached_mget_by_key_real(memcached_st *ptr,
                                                      const char * const *keys,
                                                      const size_t *key_length,
                                                      size_t number_of_keys,
-                                                     bool mget_mode)
+                                                     bool mget_mode,
+                                                     const time_t *expiration)
 {
   bool failures_occured_in_sending= false;
   const char *get_command= "get ";
@@ -234,11 +601,20 @@ static memcached_return_t memcached_mget_by_key_real(memcached_st *ptr,
     return rc;
   }
 
-  if (memcached_is_udp(ptr))
+  if (memcached_is_udp(ptr) and memcached_is_binary(ptr))
   {
-    return memcached_set_error(*ptr, MEMCACHED_NOT_SUPPORTED, MEMCACHED_AT);
+    return memcached_set_error(*ptr, MEMCACHED_NOT_SUPPORTED, MEMCACHED_AT,
+                               memcached_literal_param("Gets over UDP use the ASCII protocol"));
+  }
+
+  if (memcached_is_udp(ptr) and expiration)
+  {
+    return memcached_set_error(*ptr, MEMCACHED_NOT_SUPPORTED, MEMCACHED_AT,
+                               memcached_literal_param("Get and touch is not supported over UDP"));
   }
 
+  memcached_mget_index_reset(ptr);
+
   LIBMEMCACHED_MEMCACHED_MGET_START();
 
   if (number_of_keys == 0)
@@ -251,6 +627,24 @@ static memcached_return_t memcached_mget_by_key_real(memcached_st *ptr,
     return memcached_last_error(ptr);
   }
 
+  // Only send each key once, the responses are replayed by memcached_fetch_result()
+  if (mget_mode and ptr->flags.mget_dedupe and number_of_keys > 1)
+  {
+    if (memcached_failed(rc= memcached_mget_index_build(ptr, keys, key_length, number_of_keys,
+                                                        keys, key_length, number_of_keys)))
+    {
+      return memcached_set_error(*ptr, rc, MEMCACHED_AT);
+    }
+  }
+
+  if (memcached_is_udp(ptr))
+  {
+    rc= memcached_udp_mget(*ptr, group_key, group_key_length, keys, key_length, number_of_keys);
+    LIBMEMCACHED_MEMCACHED_MGET_END();
+
+    return rc;
+  }
+
   bool is_group_key_set= false;
   if (group_key and group_key_length)
   {
@@ -299,7 +693,13 @@ static memcached_return_t memcached_mget_by_key_real(memcached_st *ptr,
   if (memcached_is_binary(ptr))
   {
     return binary_mget_by_key(ptr, master_server_key, is_group_key_set, keys,
-                              key_length, number_of_keys, mget_mode);
+                              key_length, number_of_keys, mget_mode, expiration);
+  }
+
+  if (memcached_is_meta(ptr))
+  {
+    return meta_mget_by_key(ptr, master_server_key, is_group_key_set, keys,
+                            key_length, number_of_keys, mget_mode, expiration);
   }
 
   if (ptr->flags.support_cas)
@@ -308,6 +708,21 @@ static memcached_return_t memcached_mget_by_key_real(memcached_st *ptr,
     get_command_length= 5;
   }
 
+  // gat and gats take the expiration ahead of the keys
+  char gat_command[MEMCACHED_MAXIMUM_INTEGER_DISPLAY_LENGTH +8];
+  if (expiration)
+  {
+    int gat_command_length= snprintf(gat_command, sizeof(gat_command), "%s %llu ",
+                                      ptr->flags.support_cas ? "gats" : "gat", (unsigned long long)*expiration);
+    if (size_t(gat_command_length) >= sizeof(gat_command) or gat_command_length < 0)
+    {
+      return memcached_set_error(*ptr, MEMCACHED_MEMORY_ALLOCATION_FAILURE, MEMCACHED_AT, 
+                                 memcached_literal_param("snprintf(MEMCACHED_MAXIMUM_INTEGER_DISPLAY_LENGTH)"));
+    }
+    get_command= gat_command;
+    get_command_length= uint8_t(gat_command_length);
+  }
+
   /*
     If a server fails we warn about errors and start all over with sending keys
     to the server.
@@ -366,6 +781,7 @@ static memcached_return_t memcached_mget_by_key_real(memcached_st *ptr,
         continue;
       }
       WATCHPOINT_ASSERT(instance->cursor_active == 0);
+      memcached_telemetry_begin(instance, mget_mode ? MEMCACHED_TELEMETRY_OP_MGET : MEMCACHED_TELEMETRY_OP_GET);
       memcached_server_response_increment(instance);
       WATCHPOINT_ASSERT(instance->cursor_active == 1);
     }
@@ -478,6 +894,7 @@ memcached_return_t _send_config_request(memcached_server_st *server, memcached_s
       return rc;
     }
     WATCHPOINT_ASSERT(instance->cursor_active == 0);
+    memcached_telemetry_begin(instance, MEMCACHED_TELEMETRY_OP_CONFIG_GET);
     memcached_server_response_increment(instance);
     WATCHPOINT_ASSERT(instance->cursor_active == 1);
   }
@@ -627,11 +1044,11 @@ char *_retrieve_config_with_get_cmd(memcached_server_st *server, memcached_st *p
  * the config protocol is supported by the memcached server and sets
  * the flag to indicate whether config protocol is supported.
  */
-char *memcached_config_get(memcached_server_st *server,
-                           memcached_st *ptr,
-                           size_t *value_length,
-                           uint32_t *flags,
-                           memcached_return_t *error)
+static char *_config_get(memcached_server_st *server,
+                         memcached_st *ptr,
+                         size_t *value_length,
+                         uint32_t *flags,
+                         memcached_return_t *error)
 {
 
   if(server == NULL)
@@ -682,6 +1099,26 @@ char *memcached_config_get(memcached_server_st *server,
   }
 }
 
+char *memcached_config_get(memcached_server_st *server,
+                           memcached_st *ptr,
+                           size_t *value_length,
+                           uint32_t *flags,
+                           memcached_return_t *error)
+{
+  uint64_t traced= memcached_trace_start(ptr);
+  bool timed= memcached_slowlog_start(ptr);
+  if ((traced or timed) and server >= ptr->servers and server < ptr->servers + memcached_server_count(ptr))
+  {
+    memcached_trace_route(ptr, uint32_t(server - ptr->servers));
+  }
+
+  char *value= _config_get(server, ptr, value_length, flags, error);
+  memcached_slowlog_end(ptr, timed, MEMCACHED_TELEMETRY_OP_CONFIG_GET, 0, 1, value ? *value_length : 0, *error);
+  memcached_trace_end(ptr, traced, MEMCACHED_TELEMETRY_OP_CONFIG_GET, NULL, 0, 1, value ? *value_length : 0, *error);
+
+  return value;
+}
+
 memcached_return_t memcached_mget_by_key(memcached_st *ptr,
                                          const char *group_key,
                                          size_t group_key_length,
@@ -689,8 +1126,146 @@ memcached_return_t memcached_mget_by_key(memcached_st *ptr,
                                          const size_t *key_length,
                                          size_t number_of_keys)
 {
-  return memcached_mget_by_key_real(ptr, group_key, group_key_length, keys,
-                                    key_length, number_of_keys, true);
+  uint64_t traced= memcached_trace_start(ptr);
+  bool timed= memcached_slowlog_start(ptr);
+  memcached_return_t rc= memcached_mget_by_key_real(ptr, group_key, group_key_length, keys,
+                                                    key_length, number_of_keys, true, NULL);
+  if (keys and key_length and number_of_keys)
+  {
+    memcached_slowlog_end(ptr, timed, MEMCACHED_TELEMETRY_OP_MGET, key_length[0], number_of_keys, 0, rc);
+    memcached_trace_end(ptr, traced, MEMCACHED_TELEMETRY_OP_MGET, keys[0], key_length[0], number_of_keys, 0, rc);
+  }
+  else
+  {
+    memcached_slowlog_end(ptr, timed, MEMCACHED_TELEMETRY_OP_MGET, 0, number_of_keys, 0, rc);
+    memcached_trace_end(ptr, traced, MEMCACHED_TELEMETRY_OP_MGET, NULL, 0, number_of_keys, 0, rc);
+  }
+
+  return rc;
+}
+
+char *memcached_gat(memcached_st *ptr,
+                    const char *key, size_t key_length,
+                    time_t expiration,
+                    size_t *value_length,
+                    uint32_t *flags,
+                    memcached_return_t *error)
+{
+  return memcached_gat_by_key(ptr, NULL, 0, key, key_length, expiration,
+                              value_length, flags, error);
+}
+
+/*
+  A get that sets the expiration of the item it finds in the same round
+  trip, where a get followed by a touch takes two. There is no read-through
+  on a miss, as whatever the callback produced would be stored without the
+  expiration that was asked for.
+*/
+char *memcached_gat_by_key(memcached_st *ptr,
+                           const char *group_key,
+                           size_t group_key_length,
+                           const char *key, size_t key_length,
+                           time_t expiration,
+                           size_t *value_length,
+                           uint32_t *flags,
+                           memcached_return_t *error)
+{
+  memcached_return_t unused;
+  if (error == NULL)
+  {
+    error= &unused;
+  }
+
+  size_t unused_length;
+  if (value_length == NULL)
+  {
+    value_length= &unused_length;
+  }
+  *value_length= 0;
+
+  if (ptr == NULL)
+  {
+    *error= MEMCACHED_INVALID_ARGUMENTS;
+    return NULL;
+  }
+
+  uint64_t traced= memcached_trace_start(ptr);
+  bool timed= memcached_slowlog_start(ptr);
+
+  char *value= NULL;
+  *error= memcached_mget_by_key_real(ptr, group_key, group_key_length,
+                                     (const char * const *)&key, &key_length,
+                                     1, false, &expiration);
+
+  // Like a touch, this may have shortened the life of the item or ended it
+  if (ptr->near_cache)
+  {
+    memcached_near_cache_invalidate(ptr, group_key, group_key_length, key, key_length, expiration);
+  }
+
+  if (memcached_success(*error))
+  {
+    value= memcached_fetch(ptr, NULL, NULL, value_length, flags, error);
+
+    if (*error == MEMCACHED_END)
+    {
+      *error= MEMCACHED_NOTFOUND;
+    }
+  }
+  else if (memcached_has_current_error(*ptr))
+  {
+    *error= memcached_last_error(ptr);
+  }
+
+  memcached_slowlog_end(ptr, timed, MEMCACHED_TELEMETRY_OP_GET, key_length, 1, *value_length, *error);
+  memcached_trace_end(ptr, traced, MEMCACHED_TELEMETRY_OP_GET, key, key_length, 1, *value_length, *error);
+
+  return value;
+}
+
+memcached_return_t memcached_mgat(memcached_st *ptr,
+                                  const char * const *keys,
+                                  const size_t *key_length,
+                                  size_t number_of_keys,
+                                  time_t expiration)
+{
+  return memcached_mgat_by_key(ptr, NULL, 0, keys, key_length, number_of_keys, expiration);
+}
+
+memcached_return_t memcached_mgat_by_key(memcached_st *ptr,
+                                         const char *group_key,
+                                         size_t group_key_length,
+                                         const char * const *keys,
+                                         const size_t *key_length,
+                                         size_t number_of_keys,
+                                         time_t expiration)
+{
+  uint64_t traced= memcached_trace_start(ptr);
+  bool timed= memcached_slowlog_start(ptr);
+  memcached_return_t rc= memcached_mget_by_key_real(ptr, group_key, group_key_length, keys,
+                                                    key_length, number_of_keys, true, &expiration);
+
+  // Like a touch, this may have shortened the life of the items or ended it
+  if (ptr and ptr->near_cache and keys and key_length)
+  {
+    for (size_t x= 0; x < number_of_keys; x++)
+    {
+      memcached_near_cache_invalidate(ptr, group_key, group_key_length, keys[x], key_length[x], expiration);
+    }
+  }
+
+  if (keys and key_length and number_of_keys)
+  {
+    memcached_slowlog_end(ptr, timed, MEMCACHED_TELEMETRY_OP_MGET, key_length[0], number_of_keys, 0, rc);
+    memcached_trace_end(ptr, traced, MEMCACHED_TELEMETRY_OP_MGET, keys[0], key_length[0], number_of_keys, 0, rc);
+  }
+  else
+  {
+    memcached_slowlog_end(ptr, timed, MEMCACHED_TELEMETRY_OP_MGET, 0, number_of_keys, 0, rc);
+    memcached_trace_end(ptr, traced, MEMCACHED_TELEMETRY_OP_MGET, NULL, 0, number_of_keys, 0, rc);
+  }
+
+  return rc;
 }
 
 memcached_return_t memcached_mget_execute(memcached_st *ptr,
@@ -727,7 +1302,7 @@ memcached_return_t memcached_mget_execute_by_key(memcached_st *ptr,
     return memcached_set_error(*ptr, MEMCACHED_NOT_SUPPORTED, MEMCACHED_AT);
   }
 
-  if (memcached_is_binary(ptr) == false)
+  if (memcached_is_binary(ptr) == false and memcached_is_meta(ptr) == false)
   {
     return memcached_set_error(*ptr, MEMCACHED_NOT_SUPPORTED, MEMCACHED_AT,
                                memcached_literal_param("ASCII protocol is not supported for memcached_mget_execute_by_key()"));
@@ -784,6 +1359,7 @@ static memcached_return_t _binary_config_with_config_cmd(memcached_server_st *se
     return rc;
   }
 
+  memcached_telemetry_begin(instance, MEMCACHED_TELEMETRY_OP_CONFIG_GET);
   memcached_server_response_reset(instance);
   memcached_server_response_increment(instance);
 
@@ -811,7 +1387,8 @@ static memcached_return_t simple_binary_mget(memcached_st *ptr,
                                              bool is_group_key_set,
                                              const char * const *keys,
                                              const size_t *key_length,
-                                             size_t number_of_keys, bool mget_mode)
+                                             size_t number_of_keys, bool mget_mode,
+                                             const time_t *expiration)
 {
   memcached_return_t rc= MEMCACHED_NOTFOUND;
 
@@ -855,9 +1432,15 @@ static memcached_return_t simple_binary_mget(memcached_st *ptr,
       }
     }
 
-    protocol_binary_request_getk request= { }; //= {.bytes= {0}};
+    protocol_binary_request_gat request= { }; //= {.bytes= {0}};
     request.message.header.request.magic= PROTOCOL_BINARY_REQ;
-    if (mget_mode)
+    if (expiration)
+    {
+      request.message.header.request.opcode= mget_mode ? PROTOCOL_BINARY_CMD_GATKQ : PROTOCOL_BINARY_CMD_GATK;
+      request.message.header.request.extlen= 4;
+      request.message.body.expiration= htonl((uint32_t)*expiration);
+    }
+    else if (mget_mode)
     {
       request.message.header.request.opcode= PROTOCOL_BINARY_CMD_GETKQ;
     }
@@ -881,11 +1464,11 @@ static memcached_return_t simple_binary_mget(memcached_st *ptr,
 
     request.message.header.request.keylen= htons((uint16_t)(key_length[x] + memcached_array_size(ptr->_namespace)));
     request.message.header.request.datatype= PROTOCOL_BINARY_RAW_BYTES;
-    request.message.header.request.bodylen= htonl((uint32_t)( key_length[x] + memcached_array_size(ptr->_namespace)));
+    request.message.header.request.bodylen= htonl((uint32_t)( key_length[x] + memcached_array_size(ptr->_namespace) +request.message.header.request.extlen));
 
     libmemcached_io_vector_st vector[]=
     {
-      { request.bytes, sizeof(request.bytes) },
+      { request.bytes, sizeof(request.message.header) +request.message.header.request.extlen },
       { memcached_array_string(ptr->_namespace), memcached_array_size(ptr->_namespace) },
       { keys[x], key_length[x] }
     };
@@ -898,6 +1481,7 @@ static memcached_return_t simple_binary_mget(memcached_st *ptr,
     }
 
     /* We just want one pending response per server */
+    memcached_telemetry_begin(instance, mget_mode ? MEMCACHED_TELEMETRY_OP_MGET : MEMCACHED_TELEMETRY_OP_GET);
     memcached_server_response_reset(instance);
     memcached_server_response_increment(instance);
     if ((x > 0 and x == ptr->io_key_prefetch) and memcached_flush_buffers(ptr) != MEMCACHED_SUCCESS)
@@ -994,6 +1578,7 @@ memcached_return_t _binary_config_with_get_cmd(memcached_server_st *server,
   }
 
   /* We just want one pending response per server */
+  memcached_telemetry_begin(instance, MEMCACHED_TELEMETRY_OP_CONFIG_GET);
   memcached_server_response_reset(instance);
   memcached_server_response_increment(instance);
 
@@ -1016,12 +1601,52 @@ memcached_return_t _binary_config_with_get_cmd(memcached_server_st *server,
   return rc;
 }
 
+/*
+  We need to disable buffering to actually know that the request was
+  successfully sent to the server (so that we should expect a result
+  back). It would be nice to do this in buffered mode, but then it
+  would be complex to handle all error situations if we got to send
+  some of the messages, and then we failed on writing out some others
+  and we used the callback interface from memcached_mget_execute so
+  that we might have processed some of the responses etc. For now,
+  just make sure we work _correctly_
+*/
+static bool send_replica_getk(memcached_st *ptr,
+                              memcached_server_write_instance_st instance,
+                              const char *key, size_t key_length,
+                              const time_t *expiration)
+{
+  protocol_binary_request_gat request= {};
+  request.message.header.request.magic= PROTOCOL_BINARY_REQ;
+  request.message.header.request.opcode= PROTOCOL_BINARY_CMD_GETK;
+  if (expiration)
+  {
+    request.message.header.request.opcode= PROTOCOL_BINARY_CMD_GATK;
+    request.message.header.request.extlen= 4;
+    request.message.body.expiration= htonl((uint32_t)*expiration);
+  }
+  request.message.header.request.keylen= htons((uint16_t)(key_length + memcached_array_size(ptr->_namespace)));
+  request.message.header.request.datatype= PROTOCOL_BINARY_RAW_BYTES;
+  request.message.header.request.bodylen= htonl((uint32_t)(key_length + memcached_array_size(ptr->_namespace) +request.message.header.request.extlen));
+
+  libmemcached_io_vector_st vector[]=
+  {
+    { request.bytes, sizeof(request.message.header) +request.message.header.request.extlen },
+    { memcached_array_string(ptr->_namespace), memcached_array_size(ptr->_namespace) },
+    { key, key_length }
+  };
+
+  return memcached_io_writev(instance, vector, 3, true);
+}
+
 static memcached_return_t replication_binary_mget(memcached_st *ptr,
                                                   uint32_t* hash,
                                                   bool* dead_servers,
                                                   const char *const *keys,
                                                   const size_t *key_length,
-                                                  size_t number_of_keys)
+                                                  size_t number_of_keys,
+                                                  bool mget_mode,
+                                                  const time_t *expiration)
 {
   memcached_return_t rc= MEMCACHED_NOTFOUND;
   uint32_t start= 0;
@@ -1075,31 +1700,7 @@ static memcached_return_t replication_binary_mget(memcached_st *ptr,
         }
       }
 
-      protocol_binary_request_getk request= {};
-      request.message.header.request.magic= PROTOCOL_BINARY_REQ;
-      request.message.header.request.opcode= PROTOCOL_BINARY_CMD_GETK;
-      request.message.header.request.keylen= htons((uint16_t)(key_length[x] + memcached_array_size(ptr->_namespace)));
-      request.message.header.request.datatype= PROTOCOL_BINARY_RAW_BYTES;
-      request.message.header.request.bodylen= htonl((uint32_t)(key_length[x] + memcached_array_size(ptr->_namespace)));
-
-      /*
-       * We need to disable buffering to actually know that the request was
-       * successfully sent to the server (so that we should expect a result
-       * back). It would be nice to do this in buffered mode, but then it
-       * would be complex to handle all error situations if we got to send
-       * some of the messages, and then we failed on writing out some others
-       * and we used the callback interface from memcached_mget_execute so
-       * that we might have processed some of the responses etc. For now,
-       * just make sure we work _correctly_
-     */
-      libmemcached_io_vector_st vector[]=
-      {
-        { request.bytes, sizeof(request.bytes) },
-        { memcached_array_string(ptr->_namespace), memcached_array_size(ptr->_namespace) },
-        { keys[x], key_length[x] }
-      };
-
-      if (memcached_io_writev(instance, vector, 3, true) == false)
+      if (send_replica_getk(ptr, instance, keys[x], key_length[x], expiration) == false)
       {
         memcached_io_reset(instance);
         dead_servers[server]= true;
@@ -1107,6 +1708,7 @@ static memcached_return_t replication_binary_mget(memcached_st *ptr,
         continue;
       }
 
+      memcached_telemetry_begin(instance, mget_mode ? MEMCACHED_TELEMETRY_OP_MGET : MEMCACHED_TELEMETRY_OP_GET);
       memcached_server_response_increment(instance);
       hash[x]= memcached_server_count(ptr);
     }
@@ -1126,12 +1728,13 @@ static memcached_return_t binary_mget_by_key(memcached_st *ptr,
                                              const char * const *keys,
                                              const size_t *key_length,
                                              size_t number_of_keys,
-                                             bool mget_mode)
+                                             bool mget_mode,
+                                             const time_t *expiration)
 {
   if (ptr->number_of_replicas == 0)
   {
     return simple_binary_mget(ptr, master_server_key, is_group_key_set,
-                              keys, key_length, number_of_keys, mget_mode);
+                              keys, key_length, number_of_keys, mget_mode, expiration);
   }
 
   uint32_t* hash= libmemcached_xvalloc(ptr, number_of_keys, uint32_t);
@@ -1160,7 +1763,7 @@ static memcached_return_t binary_mget_by_key(memcached_st *ptr,
   }
 
   memcached_return_t rc= replication_binary_mget(ptr, hash, dead_servers, keys,
-                                                 key_length, number_of_keys);
+                                                 key_length, number_of_keys, mget_mode, expiration);
 
   WATCHPOINT_IFERROR(rc);
   libmemcached_free(ptr, hash);
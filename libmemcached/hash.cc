@@ -323,11 +323,15 @@ static inline void _update_server_list(memcached_st *ptr)
 {
   // atomically update the last_attempted field
   ptr->polling.last_attempted = time(NULL);
+  LIBMEMCACHED_MEMCACHED_CONFIG_POLL_START(ptr->polling.current_config_version);
+  memcached_slowlog_phase_t phase= memcached_slowlog_enter(ptr, MEMCACHED_SLOWLOG_PHASE_CONFIG_POLL);
   
   // Call config_get, detect_change, apply_change
   char *config = _config_get(ptr);
   if (config == NULL)
   {
+    memcached_slowlog_leave(ptr, phase);
+    LIBMEMCACHED_MEMCACHED_CONFIG_POLL_END(ptr->polling.current_config_version, 0);
     return;
   }
 
@@ -363,6 +367,8 @@ static inline void _update_server_list(memcached_st *ptr)
   {
     ptr->polling.last_successful = time(NULL);
   }
+  memcached_slowlog_leave(ptr, phase);
+  LIBMEMCACHED_MEMCACHED_CONFIG_POLL_END(ptr->polling.current_config_version, int(isUpdateSuccessful));
 
   free(config);
 
@@ -415,7 +421,11 @@ inline uint32_t _memcached_generate_hash_with_redistribution(memcached_st *ptr,
 
   _regen_for_auto_eject(ptr);
 
-  return dispatch_host(ptr, hash);
+  uint32_t server_key= dispatch_host(ptr, hash);
+  LIBMEMCACHED_MEMCACHED_KEY_ROUTE(const_cast<char *>(key), key_length, server_key);
+  memcached_trace_route(ptr, server_key);
+
+  return server_key;
 }
 
 uint32_t memcached_generate_hash_with_redistribution(memcached_st *ptr, const char *key, size_t key_length)
@@ -342,6 +342,7 @@ static memcached_return_t update_continuum(memcached_st *ptr)
   WATCHPOINT_ASSERT(memcached_server_count(ptr) * MEMCACHED_POINTS_PER_SERVER <= MEMCACHED_CONTINUUM_SIZE);
   ptr->ketama.continuum_points_counter= pointer_counter;
   qsort(ptr->ketama.continuum, ptr->ketama.continuum_points_counter, sizeof(memcached_continuum_item_st), continuum_item_cmp);
+  LIBMEMCACHED_MEMCACHED_UPDATE_CONTINUUM(live_servers, pointer_counter);
 
   if (DEBUG)
   {
@@ -556,6 +557,21 @@ memcached_return_t update_with_new_server_list(memcached_st *ptr, memcached_serv
 
   memcached_server_st *old_server_list = memcached_server_list(ptr);
 
+  // Servers that stay in the cluster keep their telemetry
+  for (uint32_t x= 0; x < new_server_count; x++)
+  {
+    for (uint32_t y= 0; y < memcached_server_count(ptr); y++)
+    {
+      if (old_server_list[y].telemetry and old_server_list[y].port == new_server_list_for_client[x].port
+          and strcmp(old_server_list[y].hostname, new_server_list_for_client[x].hostname) == 0)
+      {
+        new_server_list_for_client[x].telemetry= old_server_list[y].telemetry;
+        old_server_list[y].telemetry= NULL;
+        break;
+      }
+    }
+  }
+
   memcached_server_list_set(ptr, new_server_list_for_client);
   ptr->number_of_hosts = new_server_count;
 
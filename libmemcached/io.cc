@@ -113,6 +113,8 @@ static bool repack_input_buffer(memcached_server_write_instance_st ptr)
       }
       else // We read data, append to our read buffer
       {
+        memcached_telemetry_bytes_read(ptr, nr);
+        LIBMEMCACHED_MEMCACHED_IO_READ(ptr->hostname, int(ptr->port), nr);
         ptr->read_data_length+= size_t(nr);
         ptr->read_buffer_length+= size_t(nr);
 
@@ -156,16 +158,25 @@ static bool process_input_buffer(memcached_server_write_instance_st ptr)
 
     memcached_set_processing_input(root, false);
 
-    if (error == MEMCACHED_SUCCESS)
+    // A value that can't be decoded is not handed to the callbacks
+    if (error == MEMCACHED_SUCCESS and memcached_success(memcached_response_decode(ptr, root->result)))
     {
-      for (unsigned int x= 0; x < cb.number_of_callback; x++)
+      if (root->mget_index)
       {
-        error= (*cb.callback[x])(ptr->root, &root->result, cb.context);
-        if (error != MEMCACHED_SUCCESS)
+        memcached_mget_index_record(root, &root->result);
+      }
+
+      do
+      {
+        for (unsigned int x= 0; x < cb.number_of_callback; x++)
         {
-          break;
+          error= (*cb.callback[x])(ptr->root, &root->result, cb.context);
+          if (error != MEMCACHED_SUCCESS)
+          {
+            break;
+          }
         }
-      }
+      } while (root->mget_index and memcached_mget_index_replay(root, &root->result));
 
       /* @todo what should I do with the error message??? */
     }
@@ -176,8 +187,8 @@ static bool process_input_buffer(memcached_server_write_instance_st ptr)
   return false;
 }
 
-static memcached_return_t io_wait(memcached_server_write_instance_st ptr,
-                                  const memc_read_or_write read_or_write)
+static memcached_return_t _io_wait(memcached_server_write_instance_st ptr,
+                                   const memc_read_or_write read_or_write)
 {
   /*
    ** We are going to block on write, but at least on Solaris we might block
@@ -225,6 +236,7 @@ static memcached_return_t io_wait(memcached_server_write_instance_st ptr,
     if (active_fd >= 1)
     {
       assert_msg(active_fd == 1 , "poll() returned an unexpected value");
+      memcached_telemetry_poll_wakeup(ptr);
       return MEMCACHED_SUCCESS;
     }
     else if (active_fd == 0)
@@ -276,6 +288,18 @@ static memcached_return_t io_wait(memcached_server_write_instance_st ptr,
   return memcached_set_errno(*ptr, local_errno, MEMCACHED_AT);
 }
 
+static memcached_return_t io_wait(memcached_server_write_instance_st ptr,
+                                  const memc_read_or_write read_or_write)
+{
+  LIBMEMCACHED_MEMCACHED_IO_WAIT_START(ptr->hostname, int(ptr->port), int(read_or_write));
+  memcached_slowlog_phase_t phase= memcached_slowlog_enter(ptr->root, MEMCACHED_SLOWLOG_PHASE_WAIT);
+  memcached_return_t rc= _io_wait(ptr, read_or_write);
+  memcached_slowlog_leave(ptr->root, phase);
+  LIBMEMCACHED_MEMCACHED_IO_WAIT_END(ptr->hostname, int(ptr->port), int(rc));
+
+  return rc;
+}
+
 static bool io_flush(memcached_server_write_instance_st ptr,
                      const bool with_flush,
                      memcached_return_t& error)
@@ -298,6 +322,8 @@ static bool io_flush(memcached_server_write_instance_st ptr,
 
   error= MEMCACHED_SUCCESS;
 
+  LIBMEMCACHED_MEMCACHED_IO_FLUSH(ptr->hostname, int(ptr->port), write_length);
+
   WATCHPOINT_ASSERT(ptr->fd != INVALID_SOCKET);
 
   /* Looking for memory overflows */
@@ -367,6 +393,7 @@ static bool io_flush(memcached_server_write_instance_st ptr,
     }
 
     ptr->io_bytes_sent+= uint32_t(sent_length);
+    memcached_telemetry_bytes_written(ptr, sent_length);
 
     local_write_ptr+= sent_length;
     write_length-= uint32_t(sent_length);
@@ -383,6 +410,36 @@ memcached_return_t memcached_io_wait_for_write(memcached_server_write_instance_s
   return io_wait(ptr, MEM_WRITE);
 }
 
+bool memcached_io_poll_read(memcached_server_write_instance_st ptr, uint64_t usec)
+{
+  if (ptr->read_buffer_length > 0)
+  {
+    return true;
+  }
+
+  struct pollfd fds;
+  fds.fd= ptr->fd;
+  fds.events= POLLIN;
+  fds.revents= 0;
+
+#ifdef TARGET_OS_LINUX
+  struct timespec timeout;
+  timeout.tv_sec= time_t(usec / 1000000);
+  timeout.tv_nsec= long(usec % 1000000) * 1000;
+  int active_fd= ppoll(&fds, 1, &timeout, NULL);
+#else
+  int active_fd= poll(&fds, 1, int((usec + 999) / 1000));
+#endif
+
+  if (active_fd > 0)
+  {
+    memcached_telemetry_poll_wakeup(ptr);
+  }
+
+  // An error is left for the read that follows to report
+  return active_fd != 0;
+}
+
 memcached_return_t memcached_io_read(memcached_server_write_instance_st ptr,
                                      void *buffer, size_t length, ssize_t& nread)
 {
@@ -469,6 +526,8 @@ memcached_return_t memcached_io_read(memcached_server_write_instance_st ptr,
         }
       } while (data_read <= 0);
 
+      memcached_telemetry_bytes_read(ptr, data_read);
+      LIBMEMCACHED_MEMCACHED_IO_READ(ptr->hostname, int(ptr->port), data_read);
       ptr->io_bytes_sent = 0;
       ptr->read_data_length= (size_t) data_read;
       ptr->read_buffer_length= (size_t) data_read;
@@ -612,6 +671,62 @@ static bool _io_write(memcached_server_write_instance_st ptr,
   return true;
 }
 
+/*
+  Same as _io_write(), but the value is run through the encoding key on its
+  way into the write buffer. Whole blocks are encrypted in place in the
+  buffer, the padded tail block is always written last.
+*/
+static bool _io_write_encrypted(memcached_server_write_instance_st ptr,
+                                const char *value, size_t length,
+                                size_t& written)
+{
+  assert(ptr->fd != INVALID_SOCKET);
+  assert(memcached_is_udp(ptr->root) == false);
+
+  const hashkit_st *kit= &ptr->root->hashkit;
+  const size_t block_size= hashkit_encrypt_length(kit, 0);
+
+  written= 0;
+  while (true)
+  {
+    size_t available= MEMCACHED_MAX_BUFFER -ptr->write_buffer_offset;
+    if (available >= block_size)
+    {
+      char *write_ptr= ptr->write_buffer + ptr->write_buffer_offset;
+      size_t encrypted;
+      if (length < block_size)
+      {
+        if ((encrypted= hashkit_encrypt_final(kit, value, length, write_ptr)) == 0)
+        {
+          return false;
+        }
+        ptr->write_buffer_offset+= encrypted;
+        written+= encrypted;
+
+        return true;
+      }
+
+      encrypted= hashkit_encrypt_update(kit, value, (length < available) ? length : available, write_ptr);
+      ptr->write_buffer_offset+= encrypted;
+      written+= encrypted;
+      value+= encrypted;
+      length-= encrypted;
+
+      if (length < block_size and MEMCACHED_MAX_BUFFER -ptr->write_buffer_offset >= block_size)
+      {
+        continue;
+      }
+    }
+
+    WATCHPOINT_ASSERT(ptr->fd != INVALID_SOCKET);
+    memcached_return_t rc;
+    if (io_flush(ptr, false, rc) == false)
+    {
+      return false;
+    }
+  }
+}
+
 bool memcached_io_write(memcached_server_write_instance_st ptr)
 {
   size_t written;
@@ -634,15 +749,34 @@ ssize_t memcached_io_write(memcached_server_write_instance_st ptr,
 bool memcached_io_writev(memcached_server_write_instance_st ptr,
                             libmemcached_io_vector_st vector[],
                             const size_t number_of, const bool with_flush)
+{
+  return memcached_io_writev(ptr, vector, number_of, number_of, with_flush);
+}
+
+bool memcached_io_writev(memcached_server_write_instance_st ptr,
+                         libmemcached_io_vector_st vector[],
+                         const size_t number_of, const size_t encrypted,
+                         const bool with_flush)
 {
   ssize_t complete_total= 0;
   ssize_t total= 0;
 
   for (size_t x= 0; x < number_of; x++, vector++)
   {
-    complete_total+= vector->length;
-    if (vector->length)
+    if (x == encrypted)
     {
+      size_t written;
+      if (_io_write_encrypted(ptr, static_cast<const char *>(vector->buffer), vector->length, written) == false)
+      {
+        return false;
+      }
+      complete_total+= written;
+      total+= written;
+    }
+    else if (vector->length)
+    {
+      complete_total+= vector->length;
+
       size_t written;
       if ((_io_write(ptr, vector->buffer, vector->length, false, written)) == false)
       {
@@ -756,6 +890,7 @@ memcached_server_write_instance_st memcached_io_get_readable_server(memcached_st
 
           if (instance->fd == fds[x].fd)
           {
+            memcached_telemetry_poll_wakeup(instance);
             return instance;
           }
         }
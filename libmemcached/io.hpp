@@ -47,8 +47,20 @@ bool memcached_io_writev(memcached_server_write_instance_st ptr,
                          libmemcached_io_vector_st vector[],
                          const size_t number_of, const bool with_flush);
 
+/* vector[encrypted] is encrypted straight into the write buffer */
+bool memcached_io_writev(memcached_server_write_instance_st ptr,
+                         libmemcached_io_vector_st vector[],
+                         const size_t number_of, const size_t encrypted,
+                         const bool with_flush);
+
 memcached_return_t memcached_io_wait_for_write(memcached_server_write_instance_st ptr);
 
+/*
+  Wait up to usec microseconds for ptr to have something to read. Returns
+  false if it timed out, a failed poll() counts as readable.
+*/
+bool memcached_io_poll_read(memcached_server_write_instance_st ptr, uint64_t usec);
+
 void memcached_io_reset(memcached_server_write_instance_st ptr);
 
 memcached_return_t memcached_io_read(memcached_server_write_instance_st ptr,
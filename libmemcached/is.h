@@ -54,9 +54,12 @@
 #define memcached_is_unknown_client_mode(__object) ((__object)->flags.client_mode == UNDEFINED)
 #define memcached_is_allocated(__object) ((__object)->options.is_allocated)
 #define memcached_is_encrypted(__object) ((__object)->hashkit._key)
+#define memcached_is_compressed(__object) ((__object)->compression and (__object)->compression->codec != MEMCACHED_COMPRESSION_NONE)
+#define memcached_is_encrypted_gcm(__object) (memcached_is_encrypted(__object) and (__object)->encryption.mode != MEMCACHED_ENCRYPTION_AES_ECB)
 #define memcached_is_udp(__object) ((__object)->flags.use_udp)
 #define memcached_is_verify_key(__object) ((__object)->flags.verify_key)
 #define memcached_is_binary(__object) ((__object)->flags.binary_protocol)
+#define memcached_is_meta(__object) ((__object)->flags.meta_protocol)
 #define memcached_is_initialized(__object) ((__object)->options.is_initialized)
 #define memcached_is_purging(__object) ((__object)->state.is_purging)
 #define memcached_is_processing_input(__object) ((__object)->state.is_processing_input)
@@ -60,6 +60,12 @@ memcached_return_t memcached_key_test(memcached_st &memc,
       {
         return memcached_set_error(memc, rc, MEMCACHED_AT, memcached_literal_param("Key provided was too long."));
       }
+
+      // The meta commands send a key base64 encoded when it can't go out as it is
+      if (memcached_is_meta(&memc) and memcached_failed(memcached_meta_key_test(memc, keys[x], key_length[x])))
+      {
+        return memcached_set_error(memc, MEMCACHED_BAD_KEY_PROVIDED, MEMCACHED_AT, memcached_literal_param("Key provided was too long to be base64 encoded."));
+      }
     }
 
     return MEMCACHED_SUCCESS;
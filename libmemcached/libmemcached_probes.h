@@ -130,4 +130,25 @@
 #define	LIBMEMCACHED_MEMCACHED_SET_START()
 #define	LIBMEMCACHED_MEMCACHED_SET_START_ENABLED() (0)
 
+#define	LIBMEMCACHED_MEMCACHED_KEY_ROUTE(arg0, arg1, arg2)
+#define	LIBMEMCACHED_MEMCACHED_KEY_ROUTE_ENABLED() (0)
+#define	LIBMEMCACHED_MEMCACHED_IO_READ(arg0, arg1, arg2)
+#define	LIBMEMCACHED_MEMCACHED_IO_READ_ENABLED() (0)
+#define	LIBMEMCACHED_MEMCACHED_IO_FLUSH(arg0, arg1, arg2)
+#define	LIBMEMCACHED_MEMCACHED_IO_FLUSH_ENABLED() (0)
+#define	LIBMEMCACHED_MEMCACHED_IO_WAIT_END(arg0, arg1, arg2)
+#define	LIBMEMCACHED_MEMCACHED_IO_WAIT_END_ENABLED() (0)
+#define	LIBMEMCACHED_MEMCACHED_IO_WAIT_START(arg0, arg1, arg2)
+#define	LIBMEMCACHED_MEMCACHED_IO_WAIT_START_ENABLED() (0)
+#define	LIBMEMCACHED_MEMCACHED_UPDATE_CONTINUUM(arg0, arg1)
+#define	LIBMEMCACHED_MEMCACHED_UPDATE_CONTINUUM_ENABLED() (0)
+#define	LIBMEMCACHED_MEMCACHED_CONFIG_POLL_END(arg0, arg1)
+#define	LIBMEMCACHED_MEMCACHED_CONFIG_POLL_END_ENABLED() (0)
+#define	LIBMEMCACHED_MEMCACHED_CONFIG_POLL_START(arg0)
+#define	LIBMEMCACHED_MEMCACHED_CONFIG_POLL_START_ENABLED() (0)
+#define	LIBMEMCACHED_MEMCACHED_SASL_AUTHENTICATE_END(arg0, arg1, arg2)
+#define	LIBMEMCACHED_MEMCACHED_SASL_AUTHENTICATE_END_ENABLED() (0)
+#define	LIBMEMCACHED_MEMCACHED_SASL_AUTHENTICATE_START(arg0, arg1)
+#define	LIBMEMCACHED_MEMCACHED_SASL_AUTHENTICATE_START_ENABLED() (0)
+
 #endif
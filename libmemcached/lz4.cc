@@ -0,0 +1,400 @@
+/*  vim:expandtab:shiftwidth=2:tabstop=2:smarttab:
+ * 
+ *  Libmemcached library
+ *
+ *  Copyright (C) 2011-2012 Data Differential, http://datadifferential.com/
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are
+ *  met:
+ *
+ *      * Redistributions of source code must retain the above copyright
+ *  notice, this list of conditions and the following disclaimer.
+ *
+ *      * Redistributions in binary form must reproduce the above
+ *  copyright notice, this list of conditions and the following disclaimer
+ *  in the documentation and/or other materials provided with the
+ *  distribution.
+ *
+ *      * The names of its contributors may not be used to endorse or
+ *  promote products derived from this software without specific prior
+ *  written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *  A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *  OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *  SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *  LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *  DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *  THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *  OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+/*
+  Compressor and decoder for the LZ4 block format, so that values can be
+  compressed without an external library. The compressor is the greedy
+  single probe one of the reference implementation; the dictionary is
+  treated as if it came right before the value.
+*/
+
+#include <libmemcached/common.h>
+#include <libmemcached/lz4.hpp>
+
+#include <cstring>
+
+#define LZ4_MIN_MATCH 4
+#define LZ4_LAST_LITERALS 5 // The last bytes of a block are always literals
+#define LZ4_MF_LIMIT 12 // And the last match starts at least this far from the end
+#define LZ4_SKIP_TRIGGER 6 // Probe less often the longer no match has been found
+
+static inline uint32_t lz4_read32(const uint8_t *p)
+{
+  uint32_t value;
+  memcpy(&value, p, sizeof(value));
+  return value;
+}
+
+static inline uint64_t lz4_read64(const uint8_t *p)
+{
+  uint64_t value;
+  memcpy(&value, p, sizeof(value));
+  return value;
+}
+
+// Number of bytes that match, compared a word at a time
+static inline const uint8_t *lz4_count(const uint8_t *ip, const uint8_t *limit,
+                                       const uint8_t *match, const uint8_t *match_limit)
+{
+  while (ip + 8 <= limit and match + 8 <= match_limit)
+  {
+    uint64_t difference= lz4_read64(ip) ^ lz4_read64(match);
+    if (difference)
+    {
+#if defined(__GNUC__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+      return ip + (__builtin_ctzll(difference) >> 3);
+#else
+      break;
+#endif
+    }
+    ip+= 8;
+    match+= 8;
+  }
+
+  while (ip < limit and match < match_limit and *ip == *match)
+  {
+    ip++;
+    match++;
+  }
+
+  return ip;
+}
+
+static inline uint32_t lz4_hash(uint32_t sequence)
+{
+  return (sequence * 2654435761U) >> (32 - MEMCACHED_LZ4_HASH_LOG);
+}
+
+static inline uint8_t *lz4_write_length(uint8_t *op, size_t length)
+{
+  while (length >= 255)
+  {
+    *op++= 255;
+    length-= 255;
+  }
+  *op++= uint8_t(length);
+
+  return op;
+}
+
+void memcached_lz4_init(memcached_lz4_st& state, const char *dictionary, size_t dictionary_length)
+{
+  memset(state.table, 0, sizeof(state.table));
+  memset(state.dictionary_table, 0, sizeof(state.dictionary_table));
+  state.epoch= 1;
+  state.dictionary= dictionary;
+  state.dictionary_length= dictionary ? dictionary_length : 0;
+
+  const uint8_t *ptr= (const uint8_t *)dictionary;
+  for (size_t x= 0; x + LZ4_MIN_MATCH <= state.dictionary_length; x++)
+  {
+    state.dictionary_table[lz4_hash(lz4_read32(ptr + x))]= uint32_t(x + 1);
+  }
+}
+
+size_t memcached_lz4_compress(memcached_lz4_st& state,
+                              const char *source, size_t length,
+                              char *destination, size_t capacity)
+{
+  if (length > (1U << 30))
+  {
+    return 0;
+  }
+
+  if (state.epoch > UINT32_MAX - uint32_t(length) - 1)
+  {
+    memset(state.table, 0, sizeof(state.table));
+    state.epoch= 1;
+  }
+  const uint32_t base= state.epoch;
+  state.epoch+= uint32_t(length) + 1;
+
+  const uint8_t *src= (const uint8_t *)source;
+  const uint8_t *ip= src;
+  const uint8_t *anchor= src;
+  const uint8_t *iend= src + length;
+  const uint8_t *dictionary= (const uint8_t *)state.dictionary;
+  const uint8_t *dictionary_end= dictionary + state.dictionary_length;
+  uint8_t *op= (uint8_t *)destination;
+  uint8_t *oend= op + capacity;
+
+  if (length > LZ4_MF_LIMIT)
+  {
+    const uint8_t *mflimit= iend - LZ4_MF_LIMIT;
+    const uint8_t *matchlimit= iend - LZ4_LAST_LITERALS;
+    uint32_t searches= 1U << LZ4_SKIP_TRIGGER;
+
+    while (ip < mflimit)
+    {
+      const uint32_t sequence= lz4_read32(ip);
+      const uint32_t hash= lz4_hash(sequence);
+      const uint32_t position= uint32_t(ip - src);
+      const uint32_t candidate= state.table[hash];
+      state.table[hash]= base + position;
+
+      const uint8_t *match= NULL;
+      const uint8_t *match_start; // Lower bound for extending the match backwards
+      const uint8_t *match_end; // Upper bound for extending it forwards
+      size_t offset= 0;
+      if (candidate >= base and position - (candidate - base) <= MEMCACHED_LZ4_MAX_DISTANCE
+          and lz4_read32(src + (candidate - base)) == sequence)
+      {
+        match= src + (candidate - base);
+        match_start= src;
+        match_end= iend;
+        offset= position - (candidate - base);
+      }
+      else if (state.dictionary_length and state.dictionary_table[hash])
+      {
+        const size_t dictionary_position= state.dictionary_table[hash] - 1;
+        offset= position + state.dictionary_length - dictionary_position;
+        if (offset <= MEMCACHED_LZ4_MAX_DISTANCE and lz4_read32(dictionary + dictionary_position) == sequence)
+        {
+          match= dictionary + dictionary_position;
+          match_start= dictionary;
+          match_end= dictionary_end;
+        }
+      }
+
+      if (match == NULL)
+      {
+        ip+= searches++ >> LZ4_SKIP_TRIGGER;
+        continue;
+      }
+      searches= 1U << LZ4_SKIP_TRIGGER;
+
+      while (ip > anchor and match > match_start and ip[-1] == match[-1])
+      {
+        ip--;
+        match--;
+      }
+
+      const uint8_t *end= lz4_count(ip + LZ4_MIN_MATCH, matchlimit, match + LZ4_MIN_MATCH, match_end);
+
+      const size_t literal_length= size_t(ip - anchor);
+      const size_t match_length= size_t(end - ip) - LZ4_MIN_MATCH;
+      if (size_t(oend - op) < 1 + literal_length / 255 + 1 + literal_length + 2 + match_length / 255 + 1)
+      {
+        return 0;
+      }
+
+      uint8_t *token= op++;
+      if (literal_length >= 15)
+      {
+        *token= 15 << 4;
+        op= lz4_write_length(op, literal_length - 15);
+      }
+      else
+      {
+        *token= uint8_t(literal_length << 4);
+      }
+      memcpy(op, anchor, literal_length);
+      op+= literal_length;
+
+      *op++= uint8_t(offset);
+      *op++= uint8_t(offset >> 8);
+
+      if (match_length >= 15)
+      {
+        *token|= 15;
+        op= lz4_write_length(op, match_length - 15);
+      }
+      else
+      {
+        *token|= uint8_t(match_length);
+      }
+
+      ip= anchor= end;
+
+      // Catch the next match starting right before this one ended
+      if (ip < mflimit)
+      {
+        state.table[lz4_hash(lz4_read32(ip - 2))]= base + uint32_t(ip - 2 - src);
+      }
+    }
+  }
+
+  const size_t literal_length= size_t(iend - anchor);
+  if (size_t(oend - op) < 1 + (literal_length + 240) / 255 + literal_length)
+  {
+    return 0;
+  }
+
+  if (literal_length >= 15)
+  {
+    *op++= 15 << 4;
+    op= lz4_write_length(op, literal_length - 15);
+  }
+  else
+  {
+    *op++= uint8_t(literal_length << 4);
+  }
+  memcpy(op, anchor, literal_length);
+  op+= literal_length;
+
+  return size_t(op - (uint8_t *)destination);
+}
+
+static inline bool lz4_read_length(const uint8_t *&ip, const uint8_t *iend, size_t &length)
+{
+  uint8_t byte;
+  do
+  {
+    if (ip >= iend)
+    {
+      return false;
+    }
+    byte= *ip++;
+    length+= byte;
+  } while (byte == 255);
+
+  return true;
+}
+
+bool memcached_lz4_decompress(const char *source, size_t length,
+                              char *destination, size_t destination_length,
+                              const char *dictionary, size_t dictionary_length)
+{
+  const uint8_t *ip= (const uint8_t *)source;
+  const uint8_t *iend= ip + length;
+  uint8_t *dst= (uint8_t *)destination;
+  uint8_t *op= dst;
+  uint8_t *oend= dst + destination_length;
+
+  while (ip < iend)
+  {
+    const uint8_t token= *ip++;
+
+    size_t literal_length= token >> 4;
+    if (literal_length == 15 and lz4_read_length(ip, iend, literal_length) == false)
+    {
+      return false;
+    }
+
+    if (literal_length > size_t(iend - ip) or literal_length > size_t(oend - op))
+    {
+      return false;
+    }
+
+    // Short runs are copied as a whole word when there is room to spare on both sides
+    if (literal_length <= 16 and iend - ip >= 16 and oend - op >= 16)
+    {
+      memcpy(op, ip, 16);
+    }
+    else
+    {
+      memcpy(op, ip, literal_length);
+    }
+    op+= literal_length;
+    ip+= literal_length;
+
+    if (ip == iend) // The last sequence has no match
+    {
+      break;
+    }
+
+    if (iend - ip < 2)
+    {
+      return false;
+    }
+    size_t offset= size_t(ip[0]) | (size_t(ip[1]) << 8);
+    ip+= 2;
+
+    size_t match_length= token & 15;
+    if (match_length == 15 and lz4_read_length(ip, iend, match_length) == false)
+    {
+      return false;
+    }
+    match_length+= LZ4_MIN_MATCH;
+
+    if (offset == 0 or match_length > size_t(oend - op))
+    {
+      return false;
+    }
+
+    // A match may start in the tail of the dictionary and run on into the output
+    size_t produced= size_t(op - dst);
+    if (offset > produced)
+    {
+      size_t back= offset - produced;
+      if (back > dictionary_length)
+      {
+        return false;
+      }
+
+      size_t copy= back < match_length ? back : match_length;
+      memcpy(op, dictionary + dictionary_length - back, copy);
+      op+= copy;
+      match_length-= copy;
+    }
+
+    if (match_length == 0)
+    {
+      continue;
+    }
+
+    const uint8_t *match= op - offset;
+    if (offset >= 16 and size_t(oend - op) >= match_length + 16)
+    {
+      // May copy up to 15 bytes too many, which the following sequences overwrite
+      uint8_t *end= op + match_length;
+      do
+      {
+        memcpy(op, match, 16);
+        op+= 16;
+        match+= 16;
+      } while (op < end);
+      op= end;
+      continue;
+    }
+
+    // Overlapping matches repeat the last offset bytes, copy them a period at a time
+    do
+    {
+      size_t copy= size_t(op - match);
+      if (copy > match_length)
+      {
+        copy= match_length;
+      }
+      memcpy(op, match, copy);
+      op+= copy;
+      match_length-= copy;
+    } while (match_length);
+  }
+
+  return op == oend;
+}
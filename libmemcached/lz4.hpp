@@ -0,0 +1,76 @@
+/*  vim:expandtab:shiftwidth=2:tabstop=2:smarttab:
+ * 
+ *  Libmemcached library
+ *
+ *  Copyright (C) 2011-2012 Data Differential, http://datadifferential.com/
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are
+ *  met:
+ *
+ *      * Redistributions of source code must retain the above copyright
+ *  notice, this list of conditions and the following disclaimer.
+ *
+ *      * Redistributions in binary form must reproduce the above
+ *  copyright notice, this list of conditions and the following disclaimer
+ *  in the documentation and/or other materials provided with the
+ *  distribution.
+ *
+ *      * The names of its contributors may not be used to endorse or
+ *  promote products derived from this software without specific prior
+ *  written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *  A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *  OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *  SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *  LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *  DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *  THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *  OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+#pragma once
+
+#define MEMCACHED_LZ4_HASH_LOG 12
+#define MEMCACHED_LZ4_TABLE_SIZE (1U << MEMCACHED_LZ4_HASH_LOG)
+#define MEMCACHED_LZ4_MAX_DISTANCE 65535
+
+/*
+  Match finder state for the LZ4 block format. Positions are stored
+  relative to an epoch that moves past each value, so the table never has
+  to be cleared between values.
+*/
+struct memcached_lz4_st
+{
+  uint32_t epoch;
+  uint32_t table[MEMCACHED_LZ4_TABLE_SIZE];
+
+  // Position + 1 of the last occurrence of each hash in the dictionary, 0 if none
+  uint32_t dictionary_table[MEMCACHED_LZ4_TABLE_SIZE];
+  const char *dictionary;
+  size_t dictionary_length;
+};
+
+void memcached_lz4_init(memcached_lz4_st& state, const char *dictionary, size_t dictionary_length);
+
+/*
+  Returns the length of the compressed block, or 0 if it would not fit in
+  capacity.
+*/
+size_t memcached_lz4_compress(memcached_lz4_st& state,
+                              const char *source, size_t length,
+                              char *destination, size_t capacity);
+
+/*
+  Returns false unless the block decodes to exactly destination_length
+  bytes. Never reads or writes out of bounds, whatever the input.
+*/
+bool memcached_lz4_decompress(const char *source, size_t length,
+                              char *destination, size_t destination_length,
+                              const char *dictionary, size_t dictionary_length);
@@ -61,6 +61,7 @@ static inline bool _memcached_init(memcached_st *self)
   self->flags.client_mode = UNDEFINED;
   self->flags.auto_eject_hosts= false;
   self->flags.binary_protocol= false;
+  self->flags.meta_protocol= false;
   self->flags.buffer_requests= false;
   self->flags.hash_with_namespace= false;
   self->flags.no_block= false;
@@ -72,8 +73,23 @@ static inline bool _memcached_init(memcached_st *self)
   self->flags.use_udp= false;
   self->flags.verify_key= false;
   self->flags.tcp_keepalive= false;
+  self->flags.coalesce_gets= false;
+  self->flags.coalesce_get_failure= false;
+  self->flags.mget_dedupe= false;
+  self->flags.server_telemetry= false;
 
   self->virtual_bucket= NULL;
+  self->near_cache= NULL;
+  self->slowlog= NULL;
+  self->mget_index= NULL;
+  self->compression= NULL;
+  self->replication= NULL;
+  self->udp= NULL;
+
+  self->encryption.mode= MEMCACHED_ENCRYPTION_AES_ECB;
+  self->encryption.thread_threshold= MEMCACHED_DEFAULT_ENCRYPTION_THREAD_THRESHOLD;
+  self->encryption.buffer= NULL;
+  self->encryption.buffer_size= 0;
 
   self->distribution= MEMCACHED_DISTRIBUTION_MODULA;
 
@@ -123,6 +139,11 @@ static inline bool _memcached_init(memcached_st *self)
   self->on_cleanup= NULL;
   self->get_key_failure= NULL;
   self->delete_trigger= NULL;
+  self->trace.function= NULL;
+  self->trace.context= NULL;
+  self->trace.sample_rate= 0;
+  self->trace.countdown= 0;
+  self->trace.server_key= UINT32_MAX;
   self->callbacks= NULL;
   self->sasl.callbacks= NULL;
   self->sasl.is_allocated= false;
@@ -156,6 +177,12 @@ static void __memcached_free(memcached_st *ptr, bool release_st)
   memcached_result_free(&ptr->result);
 
   memcached_virtual_bucket_free(ptr);
+  memcached_near_cache_free(ptr);
+  memcached_slowlog_free(ptr);
+  memcached_mget_index_free(ptr);
+  memcached_compression_free(ptr);
+  memcached_replication_free(ptr);
+  memcached_udp_free(ptr);
 
   memcached_server_free(ptr->last_disconnected_server);
 
@@ -165,6 +192,7 @@ static void __memcached_free(memcached_st *ptr, bool release_st)
   }
 
   libmemcached_free(ptr, ptr->ketama.continuum);
+  libmemcached_free(ptr, ptr->encryption.buffer);
 
   memcached_array_free(ptr->_namespace);
   ptr->_namespace= NULL;
@@ -378,12 +406,28 @@ memcached_st *memcached_clone(memcached_st *clone, const memcached_st *source)
 
   new_clone->get_key_failure= source->get_key_failure;
   new_clone->delete_trigger= source->delete_trigger;
+  new_clone->trace.function= source->trace.function;
+  new_clone->trace.context= source->trace.context;
+  new_clone->trace.sample_rate= source->trace.sample_rate;
+  new_clone->trace.countdown= source->trace.sample_rate;
   new_clone->server_failure_limit= source->server_failure_limit;
   new_clone->io_msg_watermark= source->io_msg_watermark;
   new_clone->io_bytes_watermark= source->io_bytes_watermark;
   new_clone->io_key_prefetch= source->io_key_prefetch;
   new_clone->number_of_replicas= source->number_of_replicas;
   new_clone->tcp_keepidle= source->tcp_keepidle;
+  new_clone->encryption.mode= source->encryption.mode;
+  new_clone->encryption.thread_threshold= source->encryption.thread_threshold;
+  memcached_near_cache_clone(new_clone, source);
+  memcached_slowlog_clone(new_clone, source);
+
+  if (memcached_failed(memcached_compression_clone(new_clone, source)) or
+      memcached_failed(memcached_replication_clone(new_clone, source)) or
+      memcached_failed(memcached_udp_clone(new_clone, source)))
+  {
+    memcached_free(new_clone);
+    return NULL;
+  }
 
   if (memcached_server_count(source))
   {
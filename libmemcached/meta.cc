@@ -0,0 +1,197 @@
+/*  vim:expandtab:shiftwidth=2:tabstop=2:smarttab:
+ * 
+ *  Libmemcached library
+ *
+ *  Copyright (C) 2011-2012 Data Differential, http://datadifferential.com/
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are
+ *  met:
+ *
+ *      * Redistributions of source code must retain the above copyright
+ *  notice, this list of conditions and the following disclaimer.
+ *
+ *      * Redistributions in binary form must reproduce the above
+ *  copyright notice, this list of conditions and the following disclaimer
+ *  in the documentation and/or other materials provided with the
+ *  distribution.
+ *
+ *      * The names of its contributors may not be used to endorse or
+ *  promote products derived from this software without specific prior
+ *  written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *  A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *  OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *  SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *  LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *  DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *  THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *  OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+/*
+  Keys of the meta commands. A key with a byte the text protocol would
+  take for a separator is sent base64 encoded, namespace and all.
+*/
+
+#include <libmemcached/common.h>
+#include <libmemcached/meta.hpp>
+
+#define META_MAX_ENCODED_KEY (MEMCACHED_MAX_KEY -1)
+
+static const char meta_base64_alphabet[]= "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+static inline size_t meta_encoded_length(size_t length)
+{
+  return (length +2) / 3 * 4;
+}
+
+static inline bool meta_is_printable(const char *key, size_t key_length)
+{
+  for (size_t x= 0; x < key_length; x++)
+  {
+    if (isgraph(uint8_t(key[x])) == 0)
+    {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+static inline bool meta_needs_encoding(const memcached_st& self, const char *key, size_t key_length)
+{
+  return meta_is_printable(key, key_length) == false
+    or meta_is_printable(memcached_array_string(self._namespace), memcached_array_size(self._namespace)) == false;
+}
+
+static inline int meta_base64_value(char c)
+{
+  if (c >= 'A' and c <= 'Z')
+  {
+    return c - 'A';
+  }
+
+  if (c >= 'a' and c <= 'z')
+  {
+    return c - 'a' +26;
+  }
+
+  if (c >= '0' and c <= '9')
+  {
+    return c - '0' +52;
+  }
+
+  if (c == '+')
+  {
+    return 62;
+  }
+
+  if (c == '/')
+  {
+    return 63;
+  }
+
+  return -1;
+}
+
+memcached_return_t memcached_meta_key_test(const memcached_st& self, const char *key, size_t key_length)
+{
+  if (meta_needs_encoding(self, key, key_length) and
+      meta_encoded_length(memcached_array_size(self._namespace) +key_length) > META_MAX_ENCODED_KEY)
+  {
+    return MEMCACHED_BAD_KEY_PROVIDED;
+  }
+
+  return MEMCACHED_SUCCESS;
+}
+
+void memcached_meta_key(const memcached_st& self, const char *key, size_t key_length, memcached_meta_key_st& meta_key)
+{
+  const char *name_space= memcached_array_string(self._namespace);
+  const size_t name_space_length= memcached_array_size(self._namespace);
+
+  meta_key.base64= meta_needs_encoding(self, key, key_length);
+  if (meta_key.base64 == false)
+  {
+    meta_key.vector[0].buffer= name_space;
+    meta_key.vector[0].length= name_space_length;
+    meta_key.vector[1].buffer= key;
+    meta_key.vector[1].length= key_length;
+    return;
+  }
+
+  const size_t length= name_space_length +key_length;
+  assert(meta_encoded_length(length) < sizeof(meta_key.buffer));
+
+  char *ptr= meta_key.buffer;
+  for (size_t x= 0; x < length; x+= 3)
+  {
+    uint32_t group= 0;
+    size_t y;
+    for (y= 0; y < 3 and x +y < length; y++)
+    {
+      const char byte= x +y < name_space_length ? name_space[x +y] : key[x +y -name_space_length];
+      group|= uint32_t(uint8_t(byte)) << (16 -8 *y);
+    }
+
+    *ptr++= meta_base64_alphabet[(group >> 18) & 63];
+    *ptr++= meta_base64_alphabet[(group >> 12) & 63];
+    *ptr++= y > 1 ? meta_base64_alphabet[(group >> 6) & 63] : '=';
+    *ptr++= y > 2 ? meta_base64_alphabet[group & 63] : '=';
+  }
+
+  meta_key.vector[0].buffer= meta_key.buffer;
+  meta_key.vector[0].length= size_t(ptr -meta_key.buffer);
+  meta_key.vector[1].buffer= NULL;
+  meta_key.vector[1].length= 0;
+}
+
+bool memcached_meta_key_decode(char *key, size_t& key_length)
+{
+  if (key_length == 0 or key_length % 4)
+  {
+    return false;
+  }
+
+  size_t length= 0;
+  for (size_t x= 0; x < key_length; x+= 4)
+  {
+    uint32_t group= 0;
+    size_t padding= 0;
+    for (size_t y= 0; y < 4; y++)
+    {
+      int value= meta_base64_value(key[x +y]);
+      if (key[x +y] == '=' and x +4 == key_length and y >= 2)
+      {
+        padding++;
+        value= 0;
+      }
+      else if (value < 0 or padding)
+      {
+        return false;
+      }
+      group= (group << 6) | uint32_t(value);
+    }
+
+    key[length++]= char(group >> 16);
+    if (padding < 2)
+    {
+      key[length++]= char(group >> 8);
+    }
+
+    if (padding < 1)
+    {
+      key[length++]= char(group);
+    }
+  }
+  key_length= length;
+
+  return true;
+}
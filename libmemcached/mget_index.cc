@@ -0,0 +1,349 @@
+/*  vim:expandtab:shiftwidth=2:tabstop=2:smarttab:
+ * 
+ *  Libmemcached library
+ *
+ *  Copyright (C) 2011-2012 Data Differential, http://datadifferential.com/
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are
+ *  met:
+ *
+ *      * Redistributions of source code must retain the above copyright
+ *  notice, this list of conditions and the following disclaimer.
+ *
+ *      * Redistributions in binary form must reproduce the above
+ *  copyright notice, this list of conditions and the following disclaimer
+ *  in the documentation and/or other materials provided with the
+ *  distribution.
+ *
+ *      * The names of its contributors may not be used to endorse or
+ *  promote products derived from this software without specific prior
+ *  written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *  A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *  OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *  SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *  LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *  DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *  THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *  OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+/*
+  With MEMCACHED_BEHAVIOR_MGET_DEDUPE a key that is passed to mget more than
+  once is only requested once. The index remembers every position a key was
+  passed at, so that the response can be handed back once for each of them
+  and memcached_result_key_index() can tell which position a result is for.
+  Only the result that was filled last has a position, which keeps it out
+  of memcached_result_st.
+*/
+
+#include <libmemcached/common.h>
+
+#define MGET_INDEX_END UINT32_MAX
+
+struct memcached_mget_index_key_st {
+  uint32_t first;
+  uint32_t hash;
+};
+
+struct memcached_mget_index_st {
+  bool is_active;
+
+  // Next position passed the same key, or MGET_INDEX_END
+  uint32_t *next;
+  size_t next_size;
+
+  // The keys that are sent, copied so they outlive the call to mget
+  const char **keys;
+  size_t keys_size;
+  size_t *key_length;
+  size_t key_length_size;
+  memcached_mget_index_key_st *entries;
+  size_t entries_size;
+  size_t number_of_keys;
+  char *key_buffer;
+  size_t key_buffer_size;
+
+  // Open addressing over keys, each slot holds the key's offset plus one
+  uint32_t *table;
+  size_t table_size;
+
+  // A response that still has to be handed out for later positions
+  uint32_t replay;
+  uint32_t replay_key;
+  char *value;
+  size_t value_length;
+  size_t value_size;
+  uint32_t flags;
+  uint64_t cas;
+  time_t expiration;
+
+  // The result that was filled last, and the position it answers
+  const memcached_result_st *result;
+  size_t position;
+};
+
+template <class T>
+static bool index_reserve(memcached_st *ptr, T *&array, size_t& size, size_t wanted)
+{
+  if (size >= wanted)
+  {
+    return true;
+  }
+
+  T *new_array= libmemcached_xrealloc(ptr, array, wanted, T);
+  if (new_array == NULL)
+  {
+    return false;
+  }
+  array= new_array;
+  size= wanted;
+
+  return true;
+}
+
+static uint32_t *index_slot(memcached_mget_index_st *index, const char *key, size_t key_length, uint32_t hash)
+{
+  size_t mask= index->table_size -1;
+  for (size_t slot= hash & mask; ; slot= (slot +1) & mask)
+  {
+    uint32_t offset= index->table[slot];
+    if (offset == 0)
+    {
+      return &index->table[slot];
+    }
+    offset--;
+
+    if (index->entries[offset].hash == hash and index->key_length[offset] == key_length and
+        memcmp(index->keys[offset], key, key_length) == 0)
+    {
+      return &index->table[slot];
+    }
+  }
+}
+
+memcached_return_t memcached_mget_index_build(memcached_st *ptr,
+                                              const char * const *keys,
+                                              const size_t *key_length,
+                                              size_t number_of_keys,
+                                              const char * const *&unique_keys,
+                                              const size_t *&unique_key_length,
+                                              size_t& number_of_unique_keys)
+{
+  if (number_of_keys >= MGET_INDEX_END)
+  {
+    return MEMCACHED_INVALID_ARGUMENTS;
+  }
+
+  memcached_mget_index_st *index= ptr->mget_index;
+  if (index == NULL)
+  {
+    if ((index= libmemcached_xcalloc(ptr, 1, memcached_mget_index_st)) == NULL)
+    {
+      return MEMCACHED_MEMORY_ALLOCATION_FAILURE;
+    }
+    ptr->mget_index= index;
+  }
+  memcached_mget_index_reset(ptr);
+
+  size_t table_size= 16;
+  while (table_size < number_of_keys *2)
+  {
+    table_size*= 2;
+  }
+
+  size_t total_key_length= 0;
+  for (size_t x= 0; x < number_of_keys; x++)
+  {
+    total_key_length+= key_length[x];
+  }
+
+  if (index_reserve(ptr, index->next, index->next_size, number_of_keys) == false or
+      index_reserve(ptr, index->keys, index->keys_size, number_of_keys) == false or
+      index_reserve(ptr, index->key_length, index->key_length_size, number_of_keys) == false or
+      index_reserve(ptr, index->entries, index->entries_size, number_of_keys) == false or
+      index_reserve(ptr, index->key_buffer, index->key_buffer_size, total_key_length) == false)
+  {
+    return MEMCACHED_MEMORY_ALLOCATION_FAILURE;
+  }
+
+  if (index->table_size < table_size)
+  {
+    libmemcached_free(ptr, index->table);
+    index->table_size= 0;
+    if ((index->table= libmemcached_xcalloc(ptr, table_size, uint32_t)) == NULL)
+    {
+      return MEMCACHED_MEMORY_ALLOCATION_FAILURE;
+    }
+    index->table_size= table_size;
+  }
+  else
+  {
+    memset(index->table, 0, sizeof(uint32_t) * index->table_size);
+  }
+
+  // Walk the keys backwards so each position can point at the next one
+  // with the same key
+  char *key_buffer= index->key_buffer;
+  for (size_t x= number_of_keys; x--; )
+  {
+    uint32_t hash= libhashkit_fnv1a_32(keys[x], key_length[x]);
+    uint32_t *slot= index_slot(index, keys[x], key_length[x], hash);
+    if (*slot)
+    {
+      size_t offset= *slot -1;
+      index->next[x]= index->entries[offset].first;
+      index->entries[offset].first= uint32_t(x);
+      continue;
+    }
+
+    size_t offset= index->number_of_keys++;
+    memcpy(key_buffer, keys[x], key_length[x]);
+    index->keys[offset]= key_buffer;
+    index->key_length[offset]= key_length[x];
+    index->entries[offset].hash= hash;
+    index->entries[offset].first= uint32_t(x);
+    index->next[x]= MGET_INDEX_END;
+    key_buffer+= key_length[x];
+    *slot= uint32_t(offset +1);
+  }
+
+  index->is_active= true;
+  unique_keys= index->keys;
+  unique_key_length= index->key_length;
+  number_of_unique_keys= index->number_of_keys;
+
+  return MEMCACHED_SUCCESS;
+}
+
+void memcached_mget_index_record(memcached_st *ptr, memcached_result_st *result)
+{
+  memcached_mget_index_st *index= ptr->mget_index;
+  if (index == NULL or index->is_active == false)
+  {
+    return;
+  }
+
+  const char *key= result->item_key;
+  size_t key_length= result->key_length;
+  uint32_t *slot= index_slot(index, key, key_length, libhashkit_fnv1a_32(key, key_length));
+  if (*slot == 0)
+  {
+    return;
+  }
+
+  uint32_t offset= *slot -1;
+  uint32_t position= index->entries[offset].first;
+  index->result= result;
+  index->position= position;
+  if (index->next[position] == MGET_INDEX_END)
+  {
+    return;
+  }
+
+  size_t value_length= memcached_result_length(result);
+  if (index_reserve(ptr, index->value, index->value_size, value_length) == false)
+  {
+    memcached_set_error(*ptr, MEMCACHED_MEMORY_ALLOCATION_FAILURE, MEMCACHED_AT);
+    return;
+  }
+
+  if (value_length)
+  {
+    memcpy(index->value, memcached_result_value(result), value_length);
+  }
+  index->value_length= value_length;
+  index->flags= result->item_flags;
+  index->cas= result->item_cas;
+  index->expiration= result->item_expiration;
+  index->replay= index->next[position];
+  index->replay_key= offset;
+}
+
+bool memcached_mget_index_replay(memcached_st *ptr, memcached_result_st *result)
+{
+  memcached_mget_index_st *index= ptr->mget_index;
+  if (index == NULL or index->replay == MGET_INDEX_END)
+  {
+    return false;
+  }
+
+  memcached_result_reset(result);
+  if (memcached_failed(memcached_string_append(&result->value, index->value, index->value_length)))
+  {
+    index->replay= MGET_INDEX_END;
+    return false;
+  }
+
+  size_t key_length= index->key_length[index->replay_key];
+  memcpy(result->item_key, index->keys[index->replay_key], key_length);
+  result->item_key[key_length]= 0;
+  result->key_length= key_length;
+  result->item_flags= index->flags;
+  result->item_cas= index->cas;
+  result->item_expiration= index->expiration;
+  index->result= result;
+  index->position= index->replay;
+
+  index->replay= index->next[index->replay];
+
+  return true;
+}
+
+size_t memcached_mget_index_position(const memcached_result_st *result)
+{
+  const memcached_mget_index_st *index= result->root ? result->root->mget_index : NULL;
+  if (index == NULL or index->result != result)
+  {
+    return SIZE_MAX;
+  }
+
+  return index->position;
+}
+
+void memcached_mget_index_forget(const memcached_result_st *result)
+{
+  memcached_mget_index_st *index= result->root ? result->root->mget_index : NULL;
+  if (index and index->result == result)
+  {
+    index->result= NULL;
+  }
+}
+
+void memcached_mget_index_reset(memcached_st *ptr)
+{
+  memcached_mget_index_st *index= ptr->mget_index;
+  if (index)
+  {
+    index->is_active= false;
+    index->number_of_keys= 0;
+    index->replay= MGET_INDEX_END;
+    index->result= NULL;
+  }
+}
+
+void memcached_mget_index_free(memcached_st *ptr)
+{
+  memcached_mget_index_st *index= ptr->mget_index;
+  if (index == NULL)
+  {
+    return;
+  }
+
+  libmemcached_free(ptr, index->next);
+  libmemcached_free(ptr, index->keys);
+  libmemcached_free(ptr, index->key_length);
+  libmemcached_free(ptr, index->entries);
+  libmemcached_free(ptr, index->key_buffer);
+  libmemcached_free(ptr, index->table);
+  libmemcached_free(ptr, index->value);
+  libmemcached_free(ptr, index);
+  ptr->mget_index= NULL;
+}
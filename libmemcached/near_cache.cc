@@ -0,0 +1,829 @@
+/*  vim:expandtab:shiftwidth=2:tabstop=2:smarttab:
+ * 
+ *  Libmemcached library
+ *
+ *  Copyright (C) 2011-2012 Data Differential, http://datadifferential.com/
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are
+ *  met:
+ *
+ *      * Redistributions of source code must retain the above copyright
+ *  notice, this list of conditions and the following disclaimer.
+ *
+ *      * Redistributions in binary form must reproduce the above
+ *  copyright notice, this list of conditions and the following disclaimer
+ *  in the documentation and/or other materials provided with the
+ *  distribution.
+ *
+ *      * The names of its contributors may not be used to endorse or
+ *  promote products derived from this software without specific prior
+ *  written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *  A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *  OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *  SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *  LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *  DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *  THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *  OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+/*
+  Near cache, an in-process cache in front of memcached_get().
+
+  Admission follows W-TinyLFU: new entries go into a small LRU window, and
+  whatever falls out of the window only makes it into the main space
+  (a segmented LRU of probation and protected entries) if a count-min
+  sketch says it has been asked for more often than the entry it would
+  push out. A scan of keys that are read once therefore only churns the
+  window.
+
+  Invalidations bump a generation counter and record it, with the new
+  expiration of the item, in a small table indexed by key hash. A get that
+  was already in flight when its key was invalidated notices the newer
+  generation when it comes back to fill, and leaves the cache alone instead
+  of putting back a value that may predate the write.
+*/
+
+#include <libmemcached/common.h>
+
+#include <pthread.h>
+#include <sys/time.h>
+
+#define NEAR_CACHE_SKETCH_DEPTH 4
+#define NEAR_CACHE_SKETCH_MAX 15
+#define NEAR_CACHE_MIN_BUCKETS 64
+#define NEAR_CACHE_MIN_INVALIDATIONS 64
+#define NEAR_CACHE_RELATIVE_EXPIRATION (60*60*24*30)
+
+enum near_cache_queue_t {
+  NEAR_CACHE_WINDOW,
+  NEAR_CACHE_PROBATION,
+  NEAR_CACHE_PROTECTED,
+  NEAR_CACHE_QUEUES
+};
+
+struct near_cache_entry_st {
+  near_cache_entry_st *next_in_bucket;
+  near_cache_entry_st *prev;
+  near_cache_entry_st *next;
+  uint64_t hash;
+  char *value;
+  size_t value_length;
+  size_t size;
+  time_t expires;
+  uint32_t flags;
+  uint32_t key_length;
+  near_cache_queue_t queue;
+  bool revalidating;
+  char key[1];
+};
+
+struct near_cache_invalidation_st {
+  uint64_t hash;
+  uint64_t generation;
+  time_t deadline; // When the item expires on the server, 0 if unknown
+};
+
+struct near_cache_list_st {
+  near_cache_entry_st *head;
+  near_cache_entry_st *tail;
+  size_t bytes;
+};
+
+struct memcached_near_cache_st {
+  pthread_mutex_t lock;
+  uint32_t refcount;
+  size_t window_budget;
+  size_t main_budget;
+  size_t protected_budget;
+  time_t ttl;
+  time_t stale_ttl;
+  near_cache_entry_st **buckets;
+  uint64_t bucket_mask;
+  near_cache_list_st queues[NEAR_CACHE_QUEUES];
+  struct {
+    uint8_t *counters;
+    uint64_t mask;
+    uint64_t additions;
+    uint64_t sample_size;
+  } sketch;
+  near_cache_invalidation_st *invalidations;
+  uint64_t invalidation_mask;
+  uint64_t generation;
+  uint64_t flushed; // Generation of the last flush
+  memcached_near_cache_stat_st stats;
+};
+
+static const uint64_t sketch_seeds[NEAR_CACHE_SKETCH_DEPTH]= {
+  0x9E3779B97F4A7C15ULL, 0xC2B2AE3D27D4EB4FULL, 0x165667B19E3779F9ULL, 0xD6E8FEB86659FD93ULL
+};
+
+static inline uint64_t near_cache_usec(void)
+{
+  struct timeval now;
+  if (gettimeofday(&now, NULL) == 0)
+  {
+    return uint64_t(now.tv_sec) * 1000000 + uint64_t(now.tv_usec);
+  }
+
+  return 0;
+}
+
+static inline uint64_t near_cache_hash(const char *key, size_t key_length)
+{
+  // FNV-1a
+  uint64_t hash= 0xcbf29ce484222325ULL;
+  for (size_t x= 0; x < key_length; x++)
+  {
+    hash^= uint8_t(key[x]);
+    hash*= 0x100000001b3ULL;
+  }
+
+  return hash;
+}
+
+/*
+  The namespace is part of the key, so memcached_st with different
+  namespaces can share a cache. So is the master key, when it is not the
+  key itself, since the same key under another master key can live on
+  another server. Its length goes first to keep the two apart.
+*/
+#define NEAR_CACHE_KEY_SIZE (1 +MEMCACHED_MAX_KEY +MEMCACHED_MAX_KEY)
+
+static bool near_cache_key(const memcached_st *ptr,
+                           const char *group_key, size_t group_key_length,
+                           const char *key, size_t key_length,
+                           char *buffer, size_t& buffer_length)
+{
+  size_t namespace_length= memcached_array_size(ptr->_namespace);
+  if (key == NULL or key_length == 0 or namespace_length + key_length > MEMCACHED_MAX_KEY -1)
+  {
+    return false;
+  }
+
+  if (group_key == NULL or (group_key_length == key_length and memcmp(group_key, key, key_length) == 0))
+  {
+    group_key_length= 0;
+  }
+  else if (group_key_length > MEMCACHED_MAX_KEY -1)
+  {
+    return false;
+  }
+
+  buffer[0]= char(group_key_length);
+  if (group_key_length)
+  {
+    memcpy(buffer +1, group_key, group_key_length);
+  }
+  buffer_length= 1 +group_key_length;
+
+  if (namespace_length)
+  {
+    memcpy(buffer +buffer_length, memcached_array_string(ptr->_namespace), namespace_length);
+  }
+  memcpy(buffer +buffer_length +namespace_length, key, key_length);
+  buffer_length+= namespace_length +key_length;
+
+  return true;
+}
+
+static inline size_t sketch_index(const memcached_near_cache_st *cache, uint64_t hash, uint32_t row)
+{
+  return size_t(row * (cache->sketch.mask +1) + (((hash * sketch_seeds[row]) >> 32) & cache->sketch.mask));
+}
+
+static uint32_t sketch_frequency(const memcached_near_cache_st *cache, uint64_t hash)
+{
+  uint32_t frequency= NEAR_CACHE_SKETCH_MAX;
+  for (uint32_t row= 0; row < NEAR_CACHE_SKETCH_DEPTH; row++)
+  {
+    uint32_t count= cache->sketch.counters[sketch_index(cache, hash, row)];
+    if (count < frequency)
+    {
+      frequency= count;
+    }
+  }
+
+  return frequency;
+}
+
+static void sketch_increment(memcached_near_cache_st *cache, uint64_t hash)
+{
+  for (uint32_t row= 0; row < NEAR_CACHE_SKETCH_DEPTH; row++)
+  {
+    uint8_t& counter= cache->sketch.counters[sketch_index(cache, hash, row)];
+    if (counter < NEAR_CACHE_SKETCH_MAX)
+    {
+      counter++;
+    }
+  }
+
+  // Age the sketch so that keys that were popular once do not stay so
+  if (++cache->sketch.additions >= cache->sketch.sample_size)
+  {
+    size_t count= size_t(cache->sketch.mask +1) * NEAR_CACHE_SKETCH_DEPTH;
+    for (size_t x= 0; x < count; x++)
+    {
+      cache->sketch.counters[x]>>= 1;
+    }
+    cache->sketch.additions/= 2;
+  }
+}
+
+static void list_unlink(memcached_near_cache_st *cache, near_cache_entry_st *entry)
+{
+  near_cache_list_st& list= cache->queues[entry->queue];
+
+  if (entry->prev)
+  {
+    entry->prev->next= entry->next;
+  }
+  else
+  {
+    list.head= entry->next;
+  }
+
+  if (entry->next)
+  {
+    entry->next->prev= entry->prev;
+  }
+  else
+  {
+    list.tail= entry->prev;
+  }
+
+  entry->prev= entry->next= NULL;
+  list.bytes-= entry->size;
+}
+
+static void list_push(memcached_near_cache_st *cache, near_cache_entry_st *entry, near_cache_queue_t queue)
+{
+  near_cache_list_st& list= cache->queues[queue];
+
+  entry->queue= queue;
+  entry->prev= NULL;
+  entry->next= list.head;
+  if (list.head)
+  {
+    list.head->prev= entry;
+  }
+  else
+  {
+    list.tail= entry;
+  }
+  list.head= entry;
+  list.bytes+= entry->size;
+}
+
+static near_cache_entry_st *near_cache_find(memcached_near_cache_st *cache, uint64_t hash,
+                                            const char *key, size_t key_length)
+{
+  for (near_cache_entry_st *entry= cache->buckets[hash & cache->bucket_mask];
+       entry;
+       entry= entry->next_in_bucket)
+  {
+    if (entry->hash == hash and entry->key_length == key_length and memcmp(entry->key, key, key_length) == 0)
+    {
+      return entry;
+    }
+  }
+
+  return NULL;
+}
+
+static void near_cache_grow(memcached_near_cache_st *cache)
+{
+  uint64_t bucket_count= (cache->bucket_mask +1) * 2;
+  near_cache_entry_st **buckets= static_cast<near_cache_entry_st **>(calloc(size_t(bucket_count), sizeof(near_cache_entry_st *)));
+  if (buckets == NULL)
+  {
+    return; // Chains just get longer
+  }
+
+  for (uint64_t x= 0; x <= cache->bucket_mask; x++)
+  {
+    near_cache_entry_st *entry= cache->buckets[x];
+    while (entry)
+    {
+      near_cache_entry_st *next= entry->next_in_bucket;
+      near_cache_entry_st **bucket= &buckets[entry->hash & (bucket_count -1)];
+      entry->next_in_bucket= *bucket;
+      *bucket= entry;
+      entry= next;
+    }
+  }
+
+  free(cache->buckets);
+  cache->buckets= buckets;
+  cache->bucket_mask= bucket_count -1;
+}
+
+static void near_cache_remove(memcached_near_cache_st *cache, near_cache_entry_st *entry)
+{
+  near_cache_entry_st **bucket= &cache->buckets[entry->hash & cache->bucket_mask];
+  while (*bucket != entry)
+  {
+    bucket= &(*bucket)->next_in_bucket;
+  }
+  *bucket= entry->next_in_bucket;
+
+  list_unlink(cache, entry);
+  cache->stats.items--;
+
+  free(entry->value);
+  free(entry);
+}
+
+static void near_cache_resize(memcached_near_cache_st *cache, near_cache_entry_st *entry, size_t size)
+{
+  cache->queues[entry->queue].bytes-= entry->size;
+  entry->size= size;
+  cache->queues[entry->queue].bytes+= entry->size;
+}
+
+static inline size_t main_bytes(const memcached_near_cache_st *cache)
+{
+  return cache->queues[NEAR_CACHE_PROBATION].bytes +cache->queues[NEAR_CACHE_PROTECTED].bytes;
+}
+
+/*
+  Move whatever no longer fits in the window into the main space, where it
+  has to beat the least recently used probation entry on frequency. Then
+  make room for entries of the main space that were refilled with bigger
+  values.
+*/
+static void near_cache_evict(memcached_near_cache_st *cache)
+{
+  while (cache->queues[NEAR_CACHE_WINDOW].bytes > cache->window_budget)
+  {
+    near_cache_entry_st *candidate= cache->queues[NEAR_CACHE_WINDOW].tail;
+    list_unlink(cache, candidate);
+    list_push(cache, candidate, NEAR_CACHE_PROBATION);
+
+    bool admitted= true;
+    while (main_bytes(cache) > cache->main_budget)
+    {
+      near_cache_entry_st *victim= cache->queues[NEAR_CACHE_PROBATION].tail;
+      if (victim == candidate)
+      {
+        victim= cache->queues[NEAR_CACHE_PROTECTED].tail;
+      }
+
+      if (victim and sketch_frequency(cache, candidate->hash) > sketch_frequency(cache, victim->hash))
+      {
+        near_cache_remove(cache, victim);
+        cache->stats.evictions++;
+      }
+      else
+      {
+        near_cache_remove(cache, candidate);
+        cache->stats.rejections++;
+        admitted= false;
+        break;
+      }
+    }
+
+    if (admitted)
+    {
+      cache->stats.admissions++;
+    }
+  }
+
+  while (main_bytes(cache) > cache->main_budget)
+  {
+    near_cache_entry_st *victim= cache->queues[NEAR_CACHE_PROBATION].tail;
+    if (victim == NULL)
+    {
+      victim= cache->queues[NEAR_CACHE_PROTECTED].tail;
+    }
+    near_cache_remove(cache, victim);
+    cache->stats.evictions++;
+  }
+}
+
+static void near_cache_promote(memcached_near_cache_st *cache, near_cache_entry_st *entry)
+{
+  list_unlink(cache, entry);
+  if (entry->queue == NEAR_CACHE_WINDOW)
+  {
+    list_push(cache, entry, NEAR_CACHE_WINDOW);
+    return;
+  }
+
+  list_push(cache, entry, NEAR_CACHE_PROTECTED);
+  while (cache->queues[NEAR_CACHE_PROTECTED].bytes > cache->protected_budget)
+  {
+    near_cache_entry_st *demoted= cache->queues[NEAR_CACHE_PROTECTED].tail;
+    list_unlink(cache, demoted);
+    list_push(cache, demoted, NEAR_CACHE_PROBATION);
+  }
+}
+
+static near_cache_entry_st *near_cache_insert(memcached_near_cache_st *cache, uint64_t hash,
+                                              const char *key, size_t key_length)
+{
+  near_cache_entry_st *entry= static_cast<near_cache_entry_st *>(malloc(sizeof(near_cache_entry_st) +key_length));
+  if (entry == NULL)
+  {
+    return NULL;
+  }
+
+  entry->hash= hash;
+  entry->value= NULL;
+  entry->value_length= 0;
+  entry->size= sizeof(near_cache_entry_st) +key_length;
+  entry->expires= 0;
+  entry->flags= 0;
+  entry->key_length= uint32_t(key_length);
+  entry->revalidating= false;
+  memcpy(entry->key, key, key_length);
+
+  if (cache->stats.items > cache->bucket_mask)
+  {
+    near_cache_grow(cache);
+  }
+  near_cache_entry_st **bucket= &cache->buckets[hash & cache->bucket_mask];
+  entry->next_in_bucket= *bucket;
+  *bucket= entry;
+
+  list_push(cache, entry, NEAR_CACHE_WINDOW);
+  cache->stats.items++;
+
+  return entry;
+}
+
+static void near_cache_release(memcached_near_cache_st *cache)
+{
+  pthread_mutex_lock(&cache->lock);
+  bool last= --cache->refcount == 0;
+  pthread_mutex_unlock(&cache->lock);
+
+  if (last == false)
+  {
+    return;
+  }
+
+  for (uint64_t x= 0; x <= cache->bucket_mask; x++)
+  {
+    near_cache_entry_st *entry= cache->buckets[x];
+    while (entry)
+    {
+      near_cache_entry_st *next= entry->next_in_bucket;
+      free(entry->value);
+      free(entry);
+      entry= next;
+    }
+  }
+
+  pthread_mutex_destroy(&cache->lock);
+  free(cache->sketch.counters);
+  free(cache->invalidations);
+  free(cache->buckets);
+  free(cache);
+}
+
+memcached_return_t memcached_near_cache_create(memcached_st *ptr,
+                                               size_t byte_budget,
+                                               time_t ttl,
+                                               time_t stale_ttl)
+{
+  if (ptr == NULL)
+  {
+    return MEMCACHED_INVALID_ARGUMENTS;
+  }
+
+  if (byte_budget == 0 or ttl <= 0 or stale_ttl < 0)
+  {
+    return memcached_set_error(*ptr, MEMCACHED_INVALID_ARGUMENTS, MEMCACHED_AT,
+                               memcached_literal_param("The near cache needs a byte budget and a TTL"));
+  }
+
+  // The cache can outlive ptr through its clones, so it does not use ptr's allocators
+  memcached_near_cache_st *cache= static_cast<memcached_near_cache_st *>(calloc(1, sizeof(memcached_near_cache_st)));
+  if (cache == NULL)
+  {
+    return memcached_set_error(*ptr, MEMCACHED_MEMORY_ALLOCATION_FAILURE, MEMCACHED_AT);
+  }
+
+  // Size the sketch for one counter per 64 bytes of budget
+  uint64_t width= 256;
+  while (width < (1 << 20) and width * 64 < byte_budget)
+  {
+    width*= 2;
+  }
+
+  // and one invalidation slot per 512 bytes
+  uint64_t invalidations= width / 8 > NEAR_CACHE_MIN_INVALIDATIONS ? width / 8 : NEAR_CACHE_MIN_INVALIDATIONS;
+
+  cache->buckets= static_cast<near_cache_entry_st **>(calloc(NEAR_CACHE_MIN_BUCKETS, sizeof(near_cache_entry_st *)));
+  cache->sketch.counters= static_cast<uint8_t *>(calloc(size_t(width) * NEAR_CACHE_SKETCH_DEPTH, sizeof(uint8_t)));
+  cache->invalidations= static_cast<near_cache_invalidation_st *>(calloc(size_t(invalidations), sizeof(near_cache_invalidation_st)));
+  if (cache->buckets == NULL or cache->sketch.counters == NULL or cache->invalidations == NULL or
+      pthread_mutex_init(&cache->lock, NULL))
+  {
+    free(cache->buckets);
+    free(cache->sketch.counters);
+    free(cache->invalidations);
+    free(cache);
+    return memcached_set_error(*ptr, MEMCACHED_MEMORY_ALLOCATION_FAILURE, MEMCACHED_AT);
+  }
+
+  cache->refcount= 1;
+  cache->bucket_mask= NEAR_CACHE_MIN_BUCKETS -1;
+  cache->sketch.mask= width -1;
+  cache->sketch.sample_size= width * 10;
+  cache->invalidation_mask= invalidations -1;
+  cache->window_budget= byte_budget / 100 ? byte_budget / 100 : 1;
+  cache->main_budget= byte_budget -cache->window_budget;
+  cache->protected_budget= cache->main_budget / 5 * 4;
+  cache->ttl= ttl;
+  cache->stale_ttl= stale_ttl;
+  cache->stats.byte_budget= byte_budget;
+
+  memcached_near_cache_free(ptr);
+  ptr->near_cache= cache;
+
+  return MEMCACHED_SUCCESS;
+}
+
+void memcached_near_cache_free(memcached_st *ptr)
+{
+  if (ptr and ptr->near_cache)
+  {
+    near_cache_release(ptr->near_cache);
+    ptr->near_cache= NULL;
+  }
+}
+
+memcached_return_t memcached_near_cache_stat(const memcached_st *ptr,
+                                             memcached_near_cache_stat_st *stat)
+{
+  if (ptr == NULL or stat == NULL)
+  {
+    return MEMCACHED_INVALID_ARGUMENTS;
+  }
+
+  memcached_near_cache_st *cache= ptr->near_cache;
+  if (cache == NULL)
+  {
+    return MEMCACHED_NOT_SUPPORTED;
+  }
+
+  pthread_mutex_lock(&cache->lock);
+  *stat= cache->stats;
+  stat->bytes= 0;
+  for (uint32_t x= 0; x < NEAR_CACHE_QUEUES; x++)
+  {
+    stat->bytes+= cache->queues[x].bytes;
+  }
+  pthread_mutex_unlock(&cache->lock);
+
+  return MEMCACHED_SUCCESS;
+}
+
+void memcached_near_cache_clone(memcached_st *destination, const memcached_st *source)
+{
+  memcached_near_cache_st *cache= source->near_cache;
+  if (cache)
+  {
+    pthread_mutex_lock(&cache->lock);
+    cache->refcount++;
+    pthread_mutex_unlock(&cache->lock);
+  }
+  destination->near_cache= cache;
+}
+
+char *memcached_near_cache_get(memcached_st *ptr,
+                               const char *group_key, size_t group_key_length,
+                               const char *key, size_t key_length,
+                               size_t *value_length,
+                               uint32_t *flags,
+                               uint64_t& started,
+                               uint64_t& generation)
+{
+  memcached_near_cache_st *cache= ptr->near_cache;
+  started= near_cache_usec();
+
+  char buffer[NEAR_CACHE_KEY_SIZE];
+  size_t buffer_length;
+  if (near_cache_key(ptr, group_key, group_key_length, key, key_length, buffer, buffer_length) == false)
+  {
+    return NULL;
+  }
+  uint64_t hash= near_cache_hash(buffer, buffer_length);
+  time_t now= time(NULL);
+
+  char *value= NULL;
+  pthread_mutex_lock(&cache->lock);
+  generation= cache->generation;
+  sketch_increment(cache, hash);
+
+  near_cache_entry_st *entry= near_cache_find(cache, hash, buffer, buffer_length);
+  if (entry)
+  {
+    bool fresh= now < entry->expires;
+    bool stale= fresh == false and now < entry->expires +cache->stale_ttl;
+
+    if (fresh or (stale and entry->revalidating))
+    {
+      // The caller frees the value with ptr's allocators
+      if ((value= static_cast<char *>(libmemcached_malloc(ptr, entry->value_length +1))))
+      {
+        memcpy(value, entry->value, entry->value_length +1);
+        *value_length= entry->value_length;
+        *flags= entry->flags;
+        near_cache_promote(cache, entry);
+        if (fresh)
+        {
+          cache->stats.hits++;
+        }
+        else
+        {
+          cache->stats.stale_hits++;
+        }
+        cache->stats.hit_time_usec+= near_cache_usec() -started;
+      }
+    }
+    else if (stale)
+    {
+      // This caller refreshes the value, everyone else gets the stale one
+      entry->revalidating= true;
+    }
+    else
+    {
+      near_cache_remove(cache, entry);
+      cache->stats.expirations++;
+    }
+  }
+
+  if (value == NULL)
+  {
+    cache->stats.misses++;
+  }
+  pthread_mutex_unlock(&cache->lock);
+
+  return value;
+}
+
+void memcached_near_cache_fill(memcached_st *ptr,
+                               const char *group_key, size_t group_key_length,
+                               const char *key, size_t key_length,
+                               const char *value, size_t value_length,
+                               uint32_t flags,
+                               memcached_return_t rc,
+                               uint64_t started,
+                               uint64_t generation)
+{
+  memcached_near_cache_st *cache= ptr->near_cache;
+
+  char buffer[NEAR_CACHE_KEY_SIZE];
+  size_t buffer_length;
+  if (near_cache_key(ptr, group_key, group_key_length, key, key_length, buffer, buffer_length) == false)
+  {
+    return;
+  }
+  uint64_t hash= near_cache_hash(buffer, buffer_length);
+  time_t now= time(NULL);
+
+  pthread_mutex_lock(&cache->lock);
+  cache->stats.miss_time_usec+= near_cache_usec() -started;
+
+  near_cache_entry_st *entry= near_cache_find(cache, hash, buffer, buffer_length);
+  if (value == NULL)
+  {
+    if (entry and rc == MEMCACHED_NOTFOUND)
+    {
+      near_cache_remove(cache, entry);
+    }
+    else if (entry)
+    {
+      entry->revalidating= false;
+    }
+    pthread_mutex_unlock(&cache->lock);
+    return;
+  }
+
+  // The key was written or flushed while this get was in flight
+  const near_cache_invalidation_st& invalidation= cache->invalidations[hash & cache->invalidation_mask];
+  if (invalidation.generation > generation or cache->flushed > generation)
+  {
+    if (entry)
+    {
+      entry->revalidating= false;
+    }
+    pthread_mutex_unlock(&cache->lock);
+    return;
+  }
+
+  time_t expires= now +cache->ttl;
+  if (invalidation.hash == hash and invalidation.deadline and invalidation.deadline < expires)
+  {
+    expires= invalidation.deadline;
+  }
+
+  size_t size= sizeof(near_cache_entry_st) +buffer_length +value_length;
+  char *copy= NULL;
+  if (expires <= now or size > cache->stats.byte_budget or
+      (copy= static_cast<char *>(malloc(value_length +1))) == NULL)
+  {
+    if (entry)
+    {
+      near_cache_remove(cache, entry);
+    }
+    cache->stats.rejections++;
+    pthread_mutex_unlock(&cache->lock);
+    return;
+  }
+  memcpy(copy, value, value_length);
+  copy[value_length]= 0;
+
+  if (entry == NULL and (entry= near_cache_insert(cache, hash, buffer, buffer_length)) == NULL)
+  {
+    free(copy);
+    pthread_mutex_unlock(&cache->lock);
+    return;
+  }
+
+  free(entry->value);
+  entry->value= copy;
+  entry->value_length= value_length;
+  entry->flags= flags;
+  entry->expires= expires;
+  entry->revalidating= false;
+  near_cache_resize(cache, entry, size);
+  near_cache_evict(cache);
+
+  pthread_mutex_unlock(&cache->lock);
+}
+
+void memcached_near_cache_invalidate(memcached_st *ptr,
+                                     const char *group_key, size_t group_key_length,
+                                     const char *key, size_t key_length,
+                                     time_t expiration)
+{
+  memcached_near_cache_st *cache= ptr->near_cache;
+
+  char buffer[NEAR_CACHE_KEY_SIZE];
+  size_t buffer_length;
+  if (near_cache_key(ptr, group_key, group_key_length, key, key_length, buffer, buffer_length) == false)
+  {
+    return;
+  }
+  uint64_t hash= near_cache_hash(buffer, buffer_length);
+  time_t now= time(NULL);
+
+  pthread_mutex_lock(&cache->lock);
+  near_cache_entry_st *entry= near_cache_find(cache, hash, buffer, buffer_length);
+  if (entry)
+  {
+    cache->stats.invalidations++;
+    near_cache_remove(cache, entry);
+  }
+
+  // Keep the deadline of the item around to cap the TTL of the next fill
+  near_cache_invalidation_st& invalidation= cache->invalidations[hash & cache->invalidation_mask];
+  invalidation.hash= hash;
+  invalidation.generation= ++cache->generation;
+  if (expiration == 0)
+  {
+    invalidation.deadline= 0;
+  }
+  else if (expiration < 0)
+  {
+    invalidation.deadline= now;
+  }
+  else if (expiration > NEAR_CACHE_RELATIVE_EXPIRATION)
+  {
+    invalidation.deadline= expiration;
+  }
+  else
+  {
+    invalidation.deadline= now +expiration;
+  }
+  pthread_mutex_unlock(&cache->lock);
+}
+
+void memcached_near_cache_flush(memcached_st *ptr)
+{
+  memcached_near_cache_st *cache= ptr->near_cache;
+
+  pthread_mutex_lock(&cache->lock);
+  for (uint32_t x= 0; x < NEAR_CACHE_QUEUES; x++)
+  {
+    while (cache->queues[x].head)
+    {
+      cache->stats.invalidations++;
+      near_cache_remove(cache, cache->queues[x].head);
+    }
+  }
+  cache->flushed= ++cache->generation;
+  pthread_mutex_unlock(&cache->lock);
+}
@@ -145,7 +145,7 @@ bool memcached_purge(memcached_server_write_instance_st ptr)
       if (ptr->root->callbacks != NULL)
       {
         memcached_callback_st cb = *ptr->root->callbacks;
-        if (memcached_success(rc))
+        if (memcached_success(rc) and memcached_success(memcached_response_decode(ptr, *result_ptr)))
         {
           for (uint32_t y= 0; y < cb.number_of_callback; y++)
           {
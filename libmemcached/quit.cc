@@ -115,12 +115,19 @@ void memcached_quit_server(memcached_server_st *ptr, bool io_death)
 
   ptr->state= MEMCACHED_SERVER_STATE_NEW;
   ptr->cursor_active= 0;
+  ptr->cancelled_responses= 0;
   ptr->io_bytes_sent= 0;
-  ptr->write_buffer_offset= size_t(ptr->root and memcached_is_udp(ptr->root) ? UDP_DATAGRAM_HEADER_LENGTH : 0);
+  ptr->write_buffer_offset= 0;
+  if (ptr->root and memcached_is_udp(ptr->root))
+  {
+    ptr->write_buffer_offset= UDP_DATAGRAM_HEADER_LENGTH;
+    memcached_io_init_udp_header(ptr, 0);
+  }
   ptr->read_buffer_length= 0;
   ptr->read_ptr= ptr->read_buffer;
   ptr->options.is_shutting_down= false;
   memcached_server_response_reset(ptr);
+  memcached_telemetry_abandon(ptr);
 
   // We reset the version so that if we end up talking to a different server
   // we don't have stale server version information.
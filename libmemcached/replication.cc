@@ -0,0 +1,276 @@
+/*  vim:expandtab:shiftwidth=2:tabstop=2:smarttab:
+ * 
+ *  Libmemcached library
+ *
+ *  Copyright (C) 2011-2012 Data Differential, http://datadifferential.com/
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are
+ *  met:
+ *
+ *      * Redistributions of source code must retain the above copyright
+ *  notice, this list of conditions and the following disclaimer.
+ *
+ *      * Redistributions in binary form must reproduce the above
+ *  copyright notice, this list of conditions and the following disclaimer
+ *  in the documentation and/or other materials provided with the
+ *  distribution.
+ *
+ *      * The names of its contributors may not be used to endorse or
+ *  promote products derived from this software without specific prior
+ *  written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *  A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *  OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *  SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *  LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *  DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *  THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *  OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+
+/*
+  Bookkeeping for MEMCACHED_BEHAVIOR_NUMBER_OF_REPLICAS: the answers that
+  the replicas gave to the last set, and how long a get waits on one
+  server before it is raced against the next replica.
+*/
+
+#include <libmemcached/common.h>
+
+#include <cstring>
+
+#define HEDGE_MIN_SAMPLES 100 // Gets a server has answered before its own latency is used
+
+static memcached_replication_st *replication_state(memcached_st& self)
+{
+  if (self.replication == NULL)
+  {
+    memcached_replication_st *state= libmemcached_xcalloc(&self, 1, memcached_replication_st);
+    if (state == NULL)
+    {
+      return NULL;
+    }
+    state->hedge_delay= MEMCACHED_DEFAULT_HEDGED_READ_DELAY;
+    self.replication= state;
+  }
+
+  return self.replication;
+}
+
+memcached_return_t memcached_replication_set_hedge_percentile(memcached_st& self, uint64_t percentile)
+{
+  if (percentile > 100)
+  {
+    return memcached_set_error(self, MEMCACHED_INVALID_ARGUMENTS, MEMCACHED_AT,
+                               memcached_literal_param("MEMCACHED_BEHAVIOR_HEDGED_READ_PERCENTILE is between 0 and 100"));
+  }
+
+  if (percentile == 0 and self.replication == NULL)
+  {
+    return MEMCACHED_SUCCESS;
+  }
+
+  memcached_replication_st *state= replication_state(self);
+  if (state == NULL)
+  {
+    return memcached_set_error(self, MEMCACHED_MEMORY_ALLOCATION_FAILURE, MEMCACHED_AT);
+  }
+  state->hedge_percentile= uint32_t(percentile);
+
+  return MEMCACHED_SUCCESS;
+}
+
+memcached_return_t memcached_replication_set_hedge_delay(memcached_st& self, uint64_t delay)
+{
+  if (delay > UINT32_MAX)
+  {
+    return memcached_set_error(self, MEMCACHED_INVALID_ARGUMENTS, MEMCACHED_AT,
+                               memcached_literal_param("MEMCACHED_BEHAVIOR_HEDGED_READ_DELAY is limited to 4294 seconds."));
+  }
+
+  memcached_replication_st *state= replication_state(self);
+  if (state == NULL)
+  {
+    return memcached_set_error(self, MEMCACHED_MEMORY_ALLOCATION_FAILURE, MEMCACHED_AT);
+  }
+  state->hedge_delay= uint32_t(delay);
+
+  return MEMCACHED_SUCCESS;
+}
+
+uint32_t memcached_replication_get_hedge_percentile(const memcached_st& self)
+{
+  return self.replication ? self.replication->hedge_percentile : 0;
+}
+
+uint32_t memcached_replication_get_hedge_delay(const memcached_st& self)
+{
+  return self.replication ? self.replication->hedge_delay : MEMCACHED_DEFAULT_HEDGED_READ_DELAY;
+}
+
+memcached_return_t memcached_replication_clone(memcached_st *destination, const memcached_st *source)
+{
+  if (source->replication == NULL)
+  {
+    return MEMCACHED_SUCCESS;
+  }
+
+  memcached_return_t rc;
+  if (memcached_failed(rc= memcached_replication_set_hedge_delay(*destination, source->replication->hedge_delay)))
+  {
+    return rc;
+  }
+
+  return memcached_replication_set_hedge_percentile(*destination, source->replication->hedge_percentile);
+}
+
+void memcached_replication_free(memcached_st *ptr)
+{
+  if (ptr->replication)
+  {
+    libmemcached_free(ptr, ptr->replication->acks);
+    libmemcached_free(ptr, ptr->replication);
+    ptr->replication= NULL;
+  }
+}
+
+memcached_return_t *memcached_replication_acks(memcached_st& self, uint32_t number_of_replicas)
+{
+  memcached_replication_st *state= replication_state(self);
+  if (state == NULL)
+  {
+    return NULL;
+  }
+
+  if (number_of_replicas > state->acks_size)
+  {
+    memcached_return_t *acks= libmemcached_xrealloc(&self, state->acks, number_of_replicas, memcached_return_t);
+    if (acks == NULL)
+    {
+      state->number_of_acks= 0;
+      return NULL;
+    }
+    state->acks= acks;
+    state->acks_size= number_of_replicas;
+  }
+
+  for (uint32_t x= 0; x < number_of_replicas; x++)
+  {
+    state->acks[x]= MEMCACHED_BUFFERED;
+  }
+  state->number_of_acks= number_of_replicas;
+
+  return state->acks;
+}
+
+void memcached_replication_record(memcached_st& self)
+{
+  memcached_replication_st& state= *self.replication;
+
+  state.stat.writes++;
+  for (uint32_t x= 0; x < state.number_of_acks; x++)
+  {
+    if (state.acks[x] == MEMCACHED_SUCCESS)
+    {
+      state.stat.replica_acks++;
+    }
+    else
+    {
+      state.stat.replica_failures++;
+    }
+  }
+}
+
+bool memcached_replication_hedge_delay(const memcached_server_st *server, uint64_t& delay)
+{
+  const memcached_replication_st *state= server->root->replication;
+  if (state == NULL or state->hedge_percentile == 0)
+  {
+    return false;
+  }
+
+  delay= state->hedge_delay;
+  if (server->telemetry)
+  {
+    const memcached_histogram_st& latency= server->telemetry->stats.latency[MEMCACHED_TELEMETRY_OP_GET];
+    if (latency.count >= HEDGE_MIN_SAMPLES)
+    {
+      delay= memcached_histogram_percentile(&latency, double(state->hedge_percentile));
+    }
+  }
+
+  return true;
+}
+
+void memcached_replication_cancel(memcached_server_write_instance_st server)
+{
+  memcached_server_response_decrement(server);
+  server->cancelled_responses++;
+
+  /*
+    The reply took at least this long. Counting that, rather than dropping
+    the sample, keeps the percentile of a slow server from drifting down.
+  */
+  memcached_telemetry_response(server, MEMCACHED_SUCCESS);
+}
+
+uint32_t memcached_replica_acks(const memcached_st *ptr,
+                                memcached_return_t *results,
+                                uint32_t number_of_results)
+{
+  if (ptr == NULL or ptr->replication == NULL)
+  {
+    return 0;
+  }
+
+  uint32_t acknowledged= 0;
+  for (uint32_t x= 0; x < ptr->replication->number_of_acks; x++)
+  {
+    if (results and x < number_of_results)
+    {
+      results[x]= ptr->replication->acks[x];
+    }
+
+    if (ptr->replication->acks[x] == MEMCACHED_SUCCESS)
+    {
+      acknowledged++;
+    }
+  }
+
+  return acknowledged;
+}
+
+memcached_return_t memcached_replication_stat(const memcached_st *ptr,
+                                              memcached_replication_stat_st *stat)
+{
+  if (ptr == NULL or stat == NULL)
+  {
+    return MEMCACHED_INVALID_ARGUMENTS;
+  }
+
+  if (ptr->replication)
+  {
+    *stat= ptr->replication->stat;
+  }
+  else
+  {
+    memset(stat, 0, sizeof(memcached_replication_stat_st));
+  }
+
+  return MEMCACHED_SUCCESS;
+}
+
+void memcached_replication_stat_reset(memcached_st *ptr)
+{
+  if (ptr and ptr->replication)
+  {
+    memset(&ptr->replication->stat, 0, sizeof(memcached_replication_stat_st));
+  }
+}
@@ -0,0 +1,83 @@
+/*  vim:expandtab:shiftwidth=2:tabstop=2:smarttab:
+ * 
+ *  Libmemcached library
+ *
+ *  Copyright (C) 2011-2012 Data Differential, http://datadifferential.com/
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are
+ *  met:
+ *
+ *      * Redistributions of source code must retain the above copyright
+ *  notice, this list of conditions and the following disclaimer.
+ *
+ *      * Redistributions in binary form must reproduce the above
+ *  copyright notice, this list of conditions and the following disclaimer
+ *  in the documentation and/or other materials provided with the
+ *  distribution.
+ *
+ *      * The names of its contributors may not be used to endorse or
+ *  promote products derived from this software without specific prior
+ *  written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *  A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *  OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *  SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *  LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *  DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *  THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *  OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+
+#pragma once
+
+struct memcached_replication_st
+{
+  uint32_t hedge_percentile; // 0 never hedges a read
+  uint32_t hedge_delay; // Microseconds, while the server has too few samples
+  uint32_t number_of_acks; // Answers kept for the last replicated set
+  uint32_t acks_size;
+  memcached_return_t *acks;
+  memcached_replication_stat_st stat;
+};
+
+memcached_return_t memcached_replication_set_hedge_percentile(memcached_st& self, uint64_t percentile);
+
+memcached_return_t memcached_replication_set_hedge_delay(memcached_st& self, uint64_t delay);
+
+uint32_t memcached_replication_get_hedge_percentile(const memcached_st& self);
+
+uint32_t memcached_replication_get_hedge_delay(const memcached_st& self);
+
+memcached_return_t memcached_replication_clone(memcached_st *destination, const memcached_st *source);
+
+void memcached_replication_free(memcached_st *ptr);
+
+/*
+  Room for the answers of number_of_replicas copies, all MEMCACHED_BUFFERED
+  to begin with. Returns NULL if it could not be allocated, the set goes
+  ahead without keeping them.
+*/
+memcached_return_t *memcached_replication_acks(memcached_st& self, uint32_t number_of_replicas);
+
+/* Count the answers to a set that waited for every replica */
+void memcached_replication_record(memcached_st& self);
+
+/*
+  Sets delay to the microseconds a get waits on server before it is raced
+  against the next replica. Returns false if gets are not hedged.
+*/
+bool memcached_replication_hedge_delay(const memcached_server_st *server, uint64_t& delay);
+
+/*
+  Give up on the reply that server still owes. It is read and thrown away
+  before the next response from server, see memcached_response().
+*/
+void memcached_replication_cancel(memcached_server_write_instance_st server);
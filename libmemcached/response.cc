@@ -67,9 +67,6 @@ static memcached_return_t textual_fetch(memcached_server_write_instance_st insta
   string_ptr+= header_prefix_length;
 
 
-  // Just used for cases of AES decrypt currently
-  memcached_return_t rc= MEMCACHED_SUCCESS;
-
   /* We load the key */
   {
     char *key= result->item_key;
@@ -183,34 +180,7 @@ static memcached_return_t textual_fetch(memcached_server_write_instance_st insta
     memcached_string_set_length(&result->value, value_length);
   }
 
-  if (memcached_is_encrypted(instance->root) and memcached_result_length(result))
-  {
-    hashkit_string_st *destination;
-
-    if ((destination= hashkit_decrypt(&instance->root->hashkit,
-                                      memcached_result_value(result), memcached_result_length(result))) == NULL)
-    {
-      rc= memcached_set_error(*instance->root, MEMCACHED_FAILURE, 
-                              MEMCACHED_AT, memcached_literal_param("hashkit_decrypt() failed"));
-    }
-    else
-    {
-      memcached_result_reset_value(result);
-      if (memcached_failed(memcached_result_set_value(result, hashkit_string_c_str(destination), hashkit_string_length(destination))))
-      {
-        rc= memcached_set_error(*instance->root, MEMCACHED_FAILURE, 
-                                MEMCACHED_AT, memcached_literal_param("hashkit_decrypt() failed"));
-      }
-    }
-
-    if (memcached_failed(rc))
-    {
-      memcached_result_reset(result);
-    }
-    hashkit_string_free(destination);
-  }
-
-  return rc;
+  return MEMCACHED_SUCCESS;
 
 read_error:
   memcached_io_reset(instance);
@@ -241,19 +211,10 @@ static memcached_return_t textual_value_fetch(memcached_server_write_instance_st
   return textual_fetch(ptr, buffer, result, 6); /* header_prefix_length= 6; "VALUE " */
 }
 
-static memcached_return_t textual_read_one_response(memcached_server_write_instance_st instance,
-                                                    char *buffer, const size_t buffer_length,
-                                                    memcached_result_st *result)
+static memcached_return_t textual_parse_one_response(memcached_server_write_instance_st instance,
+                                                     char *buffer, const size_t total_read,
+                                                     memcached_result_st *result)
 {
-  size_t total_read;
-  memcached_return_t rc= memcached_io_readline(instance, buffer, buffer_length, total_read);
-
-  if (memcached_failed(rc))
-  {
-    return rc;
-  }
-  assert(total_read);
-
   switch(buffer[0])
   {
   case 'V':
@@ -509,6 +470,259 @@ static memcached_return_t textual_read_one_response(memcached_server_write_insta
                              buffer, total_read);
 }
 
+static memcached_return_t textual_read_one_response(memcached_server_write_instance_st instance,
+                                                    char *buffer, const size_t buffer_length,
+                                                    memcached_result_st *result)
+{
+  size_t total_read;
+  memcached_return_t rc= memcached_io_readline(instance, buffer, buffer_length, total_read);
+
+  if (memcached_failed(rc))
+  {
+    return rc;
+  }
+  assert(total_read);
+
+  return textual_parse_one_response(instance, buffer, total_read, result);
+}
+
+static memcached_return_t meta_value_fetch(memcached_server_write_instance_st instance,
+                                           char *value_ptr, const size_t value_length)
+{
+  ssize_t read_length= 0;
+  memcached_return_t rc= memcached_io_read(instance, value_ptr, value_length +2, read_length);
+  if (memcached_failed(rc) and rc == MEMCACHED_IN_PROGRESS)
+  {
+    memcached_quit_server(instance, true);
+    return memcached_set_error(*instance, MEMCACHED_IN_PROGRESS, MEMCACHED_AT);
+  }
+  else if (memcached_failed(rc))
+  {
+    return rc;
+  }
+
+  if (read_length != ssize_t(value_length +2))
+  {
+    memcached_io_reset(instance);
+    return MEMCACHED_PARTIAL_READ;
+  }
+
+  return MEMCACHED_SUCCESS;
+}
+
+/*
+  A meta reply is a two letter code followed by the returned flags. Lines
+  that are not (ERROR, CLIENT_ERROR, or the replies to the commands that
+  are still sent as text) go to the text protocol parser.
+*/
+static memcached_return_t meta_read_one_response(memcached_server_write_instance_st instance,
+                                                 char *buffer, const size_t buffer_length,
+                                                 memcached_result_st *result)
+{
+  size_t total_read;
+  memcached_return_t rc= memcached_io_readline(instance, buffer, buffer_length, total_read);
+
+  if (memcached_failed(rc))
+  {
+    return rc;
+  }
+  assert(total_read);
+
+  if (total_read < 4 or (buffer[2] != ' ' and buffer[2] != '\r'))
+  {
+    return textual_parse_one_response(instance, buffer, total_read, result);
+  }
+
+  const char *end_ptr= buffer +total_read;
+  char *string_ptr= buffer +2;
+
+  size_t value_length= 0;
+  if (buffer[0] == 'V' and buffer[1] == 'A')
+  {
+    value_length= size_t(strtoull(string_ptr, &string_ptr, 10));
+  }
+
+  char *key= NULL;
+  size_t key_length= 0;
+  bool base64= false;
+  bool opaque= false;
+  uint32_t flags= 0;
+  uint64_t cas= 0;
+  while (string_ptr < end_ptr and *string_ptr == ' ')
+  {
+    char *token= ++string_ptr;
+    while (string_ptr < end_ptr and *string_ptr != ' ' and *string_ptr != '\r')
+    {
+      string_ptr++;
+    }
+
+    switch (*token)
+    {
+    case 'k':
+      key= token +1;
+      key_length= size_t(string_ptr -key);
+      break;
+
+    case 'b':
+      base64= true;
+      break;
+
+    case 'f':
+      flags= uint32_t(strtoul(token +1, NULL, 10));
+      break;
+
+    case 'c':
+      cas= strtoull(token +1, NULL, 10);
+      break;
+
+    case 'O':
+      opaque= true;
+      break;
+
+    default:
+      break;
+    }
+  }
+
+  // Only a quiet request that failed answers, and nothing waits on it
+  if (opaque)
+  {
+    if (value_length)
+    {
+      char *junk= static_cast<char *>(libmemcached_malloc(instance->root, value_length +2));
+      if (junk == NULL)
+      {
+        return memcached_set_error(*instance, MEMCACHED_MEMORY_ALLOCATION_FAILURE, MEMCACHED_AT);
+      }
+      rc= meta_value_fetch(instance, junk, value_length);
+      libmemcached_free(instance->root, junk);
+      if (memcached_failed(rc))
+      {
+        return rc;
+      }
+    }
+
+    return meta_read_one_response(instance, buffer, buffer_length, result);
+  }
+
+  switch (buffer[0])
+  {
+  case 'V':
+    if (buffer[1] == 'A' and key)
+    {
+      memcached_result_reset(result);
+
+      if (base64 and memcached_meta_key_decode(key, key_length) == false)
+      {
+        return memcached_set_error(*instance, MEMCACHED_UNKNOWN_READ_FAILURE, MEMCACHED_AT,
+                                   memcached_literal_param("Returned key was not valid base64"));
+      }
+
+      size_t prefix_length= memcached_array_size(instance->root->_namespace);
+      if (key_length < prefix_length or key_length -prefix_length >= MEMCACHED_MAX_KEY)
+      {
+        return memcached_set_error(*instance, MEMCACHED_UNKNOWN_READ_FAILURE, MEMCACHED_AT,
+                                   memcached_literal_param("Returned key did not fit"));
+      }
+      result->key_length= key_length -prefix_length;
+      memcpy(result->item_key, key +prefix_length, result->key_length);
+      result->item_key[result->key_length]= 0;
+      result->item_flags= flags;
+      result->item_cas= cas;
+
+      /* We add two bytes so that we can walk the \r\n */
+      if (memcached_failed(memcached_string_check(&result->value, value_length +2)))
+      {
+        return memcached_set_error(*instance, MEMCACHED_MEMORY_ALLOCATION_FAILURE, MEMCACHED_AT);
+      }
+
+      char *value_ptr= memcached_string_value_mutable(&result->value);
+      if (memcached_failed(rc= meta_value_fetch(instance, value_ptr, value_length)))
+      {
+        return rc;
+      }
+      value_ptr[value_length]= 0;
+      value_ptr[value_length +1]= 0;
+      memcached_string_set_length(&result->value, value_length);
+
+      /* We add back in one because we will need to search for MN */
+      memcached_server_response_increment(instance);
+      return MEMCACHED_SUCCESS;
+    }
+    else if (buffer[1] == 'A')
+    {
+      // The value of ma is the number it left behind
+      char number[MEMCACHED_MAXIMUM_INTEGER_DISPLAY_LENGTH +2];
+      if (value_length == 0 or value_length > MEMCACHED_MAXIMUM_INTEGER_DISPLAY_LENGTH)
+      {
+        memcached_io_reset(instance);
+        return memcached_set_error(*instance, MEMCACHED_UNKNOWN_READ_FAILURE, MEMCACHED_AT,
+                                   memcached_literal_param("Numeric response was out of range"));
+      }
+
+      if (memcached_failed(rc= meta_value_fetch(instance, number, value_length)))
+      {
+        return rc;
+      }
+      number[value_length]= 0;
+
+      errno= 0;
+      unsigned long long int auto_return_value= strtoull(number, (char **)NULL, 10);
+      if (errno)
+      {
+        result->numeric_value= UINT64_MAX;
+        return memcached_set_error(*instance, MEMCACHED_UNKNOWN_READ_FAILURE, MEMCACHED_AT,
+                                   memcached_literal_param("Numeric response was out of range"));
+      }
+      result->numeric_value= uint64_t(auto_return_value);
+
+      return MEMCACHED_SUCCESS;
+    }
+    break;
+
+  case 'H':
+    if (buffer[1] == 'D')
+    {
+      return MEMCACHED_SUCCESS;
+    }
+    break;
+
+  case 'E':
+    if (buffer[1] == 'N')
+    {
+      return MEMCACHED_NOTFOUND;
+    }
+    else if (buffer[1] == 'X')
+    {
+      return MEMCACHED_DATA_EXISTS;
+    }
+    break;
+
+  case 'N':
+    if (buffer[1] == 'F')
+    {
+      return MEMCACHED_NOTFOUND;
+    }
+    else if (buffer[1] == 'S')
+    {
+      return MEMCACHED_NOTSTORED;
+    }
+    break;
+
+  case 'M':
+    if (buffer[1] == 'N')
+    {
+      return MEMCACHED_END;
+    }
+    break;
+
+  default:
+    break;
+  }
+
+  return textual_parse_one_response(instance, buffer, total_read, result);
+}
+
 static memcached_return_t binary_read_one_response(memcached_server_write_instance_st instance,
                                                    char *buffer, const size_t buffer_length,
                                                    memcached_result_st *result)
@@ -543,6 +757,7 @@ static memcached_return_t binary_read_one_response(memcached_server_write_instan
     {
     case PROTOCOL_BINARY_CMD_CONFIG_GETKQ:
     case PROTOCOL_BINARY_CMD_GETKQ:
+    case PROTOCOL_BINARY_CMD_GATKQ:
       /*
        * We didn't increment the response counter for the GETKQ packet
        * (only the final NOOP), so we need to increment the counter again.
@@ -552,6 +767,7 @@ static memcached_return_t binary_read_one_response(memcached_server_write_instan
     case PROTOCOL_BINARY_CMD_CONFIG_GETK:
     case PROTOCOL_BINARY_CMD_CONFIG_GET:
     case PROTOCOL_BINARY_CMD_GETK:
+    case PROTOCOL_BINARY_CMD_GATK:
       {
         uint16_t keylen= header.response.keylen;
         memcached_result_reset(result);
@@ -867,15 +1083,23 @@ static memcached_return_t _read_one_response(memcached_server_write_instance_st
     result = &root->result;
   }
 
+  memcached_slowlog_phase_t phase= memcached_slowlog_enter(instance->root, MEMCACHED_SLOWLOG_PHASE_READ);
   memcached_return_t rc;
   if (memcached_is_binary(instance->root))
   {
     rc= binary_read_one_response(instance, buffer, buffer_length, result);
   }
+  else if (memcached_is_meta(instance->root))
+  {
+    rc= meta_read_one_response(instance, buffer, buffer_length, result);
+  }
   else
   {
     rc= textual_read_one_response(instance, buffer, buffer_length, result);
   }
+  memcached_slowlog_leave(instance->root, phase);
+
+  memcached_telemetry_response(instance, rc);
 
   if (memcached_fatal(rc))
   {
@@ -885,6 +1109,41 @@ static memcached_return_t _read_one_response(memcached_server_write_instance_st
   return rc;
 }
 
+/*
+  Replies to requests that memcached_replication_cancel() gave up on come
+  before anything else the server sends. Only binary gets are cancelled.
+*/
+static memcached_return_t _purge_cancelled(memcached_server_write_instance_st instance,
+                                           char *buffer, const size_t buffer_length)
+{
+  if (instance->cancelled_responses == 0)
+  {
+    return MEMCACHED_SUCCESS;
+  }
+
+  memcached_result_st junked_result;
+  memcached_result_st *junked_result_ptr= memcached_result_create(instance->root, &junked_result);
+
+  assert(junked_result_ptr);
+
+  memcached_return_t rc= MEMCACHED_SUCCESS;
+  while (instance->cancelled_responses)
+  {
+    instance->cancelled_responses--;
+    rc= binary_read_one_response(instance, buffer, buffer_length, junked_result_ptr);
+
+    if (memcached_fatal(rc))
+    {
+      memcached_io_reset(instance);
+      break;
+    }
+    rc= MEMCACHED_SUCCESS;
+  }
+  memcached_result_free(junked_result_ptr);
+
+  return rc;
+}
+
 memcached_return_t memcached_read_one_response(memcached_server_write_instance_st instance,
                                                memcached_result_st *result)
 {
@@ -896,6 +1155,12 @@ memcached_return_t memcached_read_one_response(memcached_server_write_instance_s
   }
 
 
+  memcached_return_t rc= _purge_cancelled(instance, buffer, sizeof(buffer));
+  if (memcached_failed(rc))
+  {
+    return rc;
+  }
+
   return _read_one_response(instance, buffer, sizeof(buffer), result);
 }
 
@@ -922,6 +1187,12 @@ memcached_return_t memcached_response(memcached_server_write_instance_st instanc
     (void)memcached_io_write(instance);
   }
 
+  memcached_return_t purge_rc= _purge_cancelled(instance, buffer, buffer_length);
+  if (memcached_failed(purge_rc))
+  {
+    return purge_rc;
+  }
+
   /*
    * The previous implementation purged all pending requests and just
    * returned the last one. Purge all pending messages to ensure backwards
@@ -950,3 +1221,21 @@ memcached_return_t memcached_response(memcached_server_write_instance_st instanc
 
   return _read_one_response(instance, buffer, buffer_length, result);
 }
+
+memcached_return_t memcached_response_decode(memcached_server_write_instance_st instance,
+                                             memcached_result_st& result)
+{
+  memcached_return_t rc;
+  if (memcached_is_encrypted(instance->root) and memcached_failed(rc= memcached_decrypt_result(instance, result)))
+  {
+    return rc;
+  }
+
+  // Encryption was applied last when storing, so it is undone first
+  if (memcached_is_compressed(instance->root) and (result.item_flags & MEMCACHED_FLAG_COMPRESSED))
+  {
+    return memcached_decompress_result(instance, result);
+  }
+
+  return MEMCACHED_SUCCESS;
+}
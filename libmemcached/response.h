@@ -47,3 +47,12 @@ memcached_return_t memcached_response(memcached_server_write_instance_st ptr,
 memcached_return_t memcached_response(memcached_server_write_instance_st ptr,
                                       char *buffer, size_t buffer_length,
                                       memcached_result_st *result);
+
+/*
+  Undoes what the memcached_st did to a value before storing it. Every
+  path that hands a fetched value to the caller goes through here. The
+  value has been read in full, so one that fails to decode leaves the
+  connection usable.
+*/
+memcached_return_t memcached_response_decode(memcached_server_write_instance_st ptr,
+                                             memcached_result_st& result);
@@ -55,6 +55,8 @@ static inline void _result_init(memcached_result_st *self,
   self->numeric_value= UINT64_MAX;
   self->count= 0;
   self->item_key[0]= 0;
+  // A result can be created where a freed one was
+  memcached_mget_index_forget(self);
 }
 
 memcached_result_st *memcached_result_create(const memcached_st *memc,
@@ -99,6 +101,7 @@ void memcached_result_reset(memcached_result_st *ptr)
   ptr->item_cas= 0;
   ptr->item_expiration= 0;
   ptr->numeric_value= UINT64_MAX;
+  memcached_mget_index_forget(ptr);
 }
 
 void memcached_result_free(memcached_result_st *ptr)
@@ -162,6 +165,12 @@ size_t memcached_result_length(const memcached_result_st *self)
   return memcached_string_length(sptr);
 }
 
+char *memcached_result_take_value(memcached_result_st *self)
+{
+  memcached_string_st *sptr= &self->value;
+  return memcached_string_take_value(sptr);
+}
+
 uint32_t memcached_result_flags(const memcached_result_st *self)
 {
   return self->item_flags;
@@ -172,6 +181,11 @@ uint64_t memcached_result_cas(const memcached_result_st *self)
   return self->item_cas;
 }
 
+size_t memcached_result_key_index(const memcached_result_st *self)
+{
+  return memcached_mget_index_position(self);
+}
+
 void memcached_result_set_flags(memcached_result_st *self, uint32_t flags)
 {
   self->item_flags= flags;
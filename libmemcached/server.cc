@@ -60,6 +60,7 @@ static inline void _server_init(memcached_server_st *self, memcached_st *root,
   self->options.is_dead= false;
   self->number_of_hosts= 0;
   self->cursor_active= 0;
+  self->cancelled_responses= 0;
   self->port= port;
   self->fd= INVALID_SOCKET;
   self->io_bytes_sent= 0;
@@ -74,6 +75,7 @@ static inline void _server_init(memcached_server_st *self, memcached_st *root,
   self->minor_version= UINT8_MAX;
   self->type= type;
   self->error_messages= NULL;
+  self->telemetry= NULL;
   self->read_ptr= self->read_buffer;
   self->read_buffer_length= 0;
   self->read_data_length= 0;
@@ -212,6 +214,7 @@ void __server_free(memcached_server_st *self)
   }
 
   memcached_error_free(*self);
+  memcached_telemetry_counter_free(self);
 
   if (memcached_is_allocated(self))
   {
@@ -0,0 +1,291 @@
+/*  vim:expandtab:shiftwidth=2:tabstop=2:smarttab:
+ * 
+ *  Libmemcached library
+ *
+ *  Copyright (C) 2011-2012 Data Differential, http://datadifferential.com/
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are
+ *  met:
+ *
+ *      * Redistributions of source code must retain the above copyright
+ *  notice, this list of conditions and the following disclaimer.
+ *
+ *      * Redistributions in binary form must reproduce the above
+ *  copyright notice, this list of conditions and the following disclaimer
+ *  in the documentation and/or other materials provided with the
+ *  distribution.
+ *
+ *      * The names of its contributors may not be used to endorse or
+ *  promote products derived from this software without specific prior
+ *  written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *  A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *  OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *  SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *  LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *  DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *  THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *  OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+
+/*
+  Slow operation log. Slow operations are rare, so logging one may cost a
+  clock read per phase, but it must never make another thread wait: each
+  writer claims a slot with an atomic increment and readers check the
+  slot's sequence number before and after copying it.
+*/
+
+#include <libmemcached/common.h>
+
+#include <cstdlib>
+#include <ctime>
+
+#define SLOWLOG_MAX_CAPACITY (1U << 20)
+
+struct slowlog_slot_st
+{
+  volatile uint64_t sequence; // Ticket + 1 once the entry is complete, 0 while it is written
+  memcached_slowlog_entry_st entry;
+};
+
+struct memcached_slowlog_ring_st
+{
+  uint64_t threshold_usec;
+  uint64_t mask;
+  volatile uint64_t head;
+  volatile uint32_t refcount;
+  slowlog_slot_st *slots;
+};
+
+static void slowlog_ring_release(memcached_slowlog_ring_st *ring)
+{
+  if (__sync_sub_and_fetch(&ring->refcount, 1) == 0)
+  {
+    std::free(ring->slots);
+    std::free(ring);
+  }
+}
+
+static memcached_slowlog_st *slowlog_attach(memcached_slowlog_ring_st *ring)
+{
+  memcached_slowlog_st *slowlog= static_cast<memcached_slowlog_st *>(std::calloc(1, sizeof(memcached_slowlog_st)));
+  if (slowlog)
+  {
+    __sync_add_and_fetch(&ring->refcount, 1);
+    slowlog->ring= ring;
+  }
+
+  return slowlog;
+}
+
+memcached_return_t memcached_slowlog_create(memcached_st *ptr,
+                                            uint64_t threshold_usec,
+                                            uint32_t capacity)
+{
+  if (ptr == NULL)
+  {
+    return MEMCACHED_INVALID_ARGUMENTS;
+  }
+
+  if (capacity == 0 or capacity > SLOWLOG_MAX_CAPACITY)
+  {
+    return memcached_set_error(*ptr, MEMCACHED_INVALID_ARGUMENTS, MEMCACHED_AT,
+                               memcached_literal_param("capacity must be between 1 and 1048576"));
+  }
+
+  uint64_t slots= 1;
+  while (slots < capacity)
+  {
+    slots<<= 1;
+  }
+
+  memcached_slowlog_ring_st *ring= static_cast<memcached_slowlog_ring_st *>(std::calloc(1, sizeof(memcached_slowlog_ring_st)));
+  if (ring == NULL)
+  {
+    return memcached_set_error(*ptr, MEMCACHED_MEMORY_ALLOCATION_FAILURE, MEMCACHED_AT);
+  }
+
+  ring->slots= static_cast<slowlog_slot_st *>(std::calloc(size_t(slots), sizeof(slowlog_slot_st)));
+  if (ring->slots == NULL)
+  {
+    std::free(ring);
+    return memcached_set_error(*ptr, MEMCACHED_MEMORY_ALLOCATION_FAILURE, MEMCACHED_AT);
+  }
+  ring->threshold_usec= threshold_usec;
+  ring->mask= slots -1;
+
+  memcached_slowlog_st *slowlog= slowlog_attach(ring);
+  if (slowlog == NULL)
+  {
+    std::free(ring->slots);
+    std::free(ring);
+    return memcached_set_error(*ptr, MEMCACHED_MEMORY_ALLOCATION_FAILURE, MEMCACHED_AT);
+  }
+
+  memcached_slowlog_free(ptr);
+  ptr->slowlog= slowlog;
+
+  return MEMCACHED_SUCCESS;
+}
+
+void memcached_slowlog_free(memcached_st *ptr)
+{
+  if (ptr and ptr->slowlog)
+  {
+    slowlog_ring_release(ptr->slowlog->ring);
+    std::free(ptr->slowlog);
+    ptr->slowlog= NULL;
+  }
+}
+
+void memcached_slowlog_clone(memcached_st *destination, const memcached_st *source)
+{
+  if (source->slowlog)
+  {
+    destination->slowlog= slowlog_attach(source->slowlog->ring);
+  }
+}
+
+size_t memcached_slowlog_read(const memcached_st *ptr,
+                              memcached_slowlog_entry_st *entries,
+                              size_t count)
+{
+  if (ptr == NULL or ptr->slowlog == NULL or entries == NULL)
+  {
+    return 0;
+  }
+
+  memcached_slowlog_ring_st *ring= ptr->slowlog->ring;
+  uint64_t head= __sync_add_and_fetch(&ring->head, 0);
+  uint64_t first= head > ring->mask ? head - ring->mask -1 : 0;
+  if (head - first > count)
+  {
+    first= head - count;
+  }
+
+  size_t copied= 0;
+  for (uint64_t ticket= first; ticket < head; ticket++)
+  {
+    slowlog_slot_st *slot= ring->slots + (ticket & ring->mask);
+    if (slot->sequence != ticket +1)
+    {
+      continue;
+    }
+    __sync_synchronize();
+
+    entries[copied]= slot->entry;
+
+    __sync_synchronize();
+    if (slot->sequence == ticket +1)
+    {
+      copied++;
+    }
+  }
+
+  return copied;
+}
+
+const char *memcached_slowlog_phase_string(memcached_slowlog_phase_t phase)
+{
+  switch (phase)
+  {
+  case MEMCACHED_SLOWLOG_PHASE_CLIENT: return "client";
+  case MEMCACHED_SLOWLOG_PHASE_DNS: return "dns";
+  case MEMCACHED_SLOWLOG_PHASE_CONNECT: return "connect";
+  case MEMCACHED_SLOWLOG_PHASE_WRITE: return "write";
+  case MEMCACHED_SLOWLOG_PHASE_WAIT: return "wait";
+  case MEMCACHED_SLOWLOG_PHASE_READ: return "read";
+  case MEMCACHED_SLOWLOG_PHASE_CONFIG_POLL: return "config poll";
+  case MEMCACHED_SLOWLOG_PHASE_MAX:
+  default:
+    break;
+  }
+
+  return "unknown";
+}
+
+void memcached_slowlog_begin(memcached_slowlog_st *slowlog)
+{
+  slowlog->started= slowlog->phase_started= memcached_telemetry_now();
+  slowlog->phase= MEMCACHED_SLOWLOG_PHASE_CLIENT;
+  for (uint32_t x= 0; x < MEMCACHED_SLOWLOG_PHASE_MAX; x++)
+  {
+    slowlog->phase_usec[x]= 0;
+  }
+}
+
+memcached_slowlog_phase_t memcached_slowlog_switch(memcached_slowlog_st *slowlog,
+                                                   memcached_slowlog_phase_t phase)
+{
+  uint64_t now= memcached_telemetry_now();
+  memcached_slowlog_phase_t previous= slowlog->phase;
+
+  if (now > slowlog->phase_started)
+  {
+    slowlog->phase_usec[previous]+= now - slowlog->phase_started;
+  }
+  slowlog->phase_started= now;
+  slowlog->phase= phase;
+
+  return previous;
+}
+
+void memcached_slowlog_finish(memcached_st *ptr,
+                              memcached_telemetry_op_t op,
+                              size_t key_length,
+                              size_t number_of_keys,
+                              size_t value_length,
+                              memcached_return_t rc)
+{
+  memcached_slowlog_st *slowlog= ptr->slowlog;
+  memcached_slowlog_switch(slowlog, MEMCACHED_SLOWLOG_PHASE_CLIENT);
+
+  uint64_t total= slowlog->phase_started - slowlog->started;
+  slowlog->started= 0;
+
+  memcached_slowlog_ring_st *ring= slowlog->ring;
+  if (total < ring->threshold_usec)
+  {
+    return;
+  }
+
+  uint64_t ticket= __sync_fetch_and_add(&ring->head, 1);
+  slowlog_slot_st *slot= ring->slots + (ticket & ring->mask);
+  slot->sequence= 0;
+  __sync_synchronize();
+
+  memcached_slowlog_entry_st& entry= slot->entry;
+  entry.sequence= ticket;
+  entry.logged_at= time(NULL);
+  entry.op= op;
+  entry.rc= rc;
+  entry.hostname[0]= 0;
+  entry.port= 0;
+  entry.key_length= key_length;
+  entry.number_of_keys= number_of_keys;
+  entry.value_length= value_length;
+  entry.total_usec= total;
+  for (uint32_t x= 0; x < MEMCACHED_SLOWLOG_PHASE_MAX; x++)
+  {
+    entry.phase_usec[x]= slowlog->phase_usec[x];
+  }
+
+  uint32_t server_key= ptr->trace.server_key;
+  if (number_of_keys == 1 and server_key < memcached_server_count(ptr))
+  {
+    memcached_server_instance_st server= memcached_server_instance_by_position(ptr, server_key);
+    memcpy(entry.hostname, server->hostname, sizeof(entry.hostname));
+    entry.port= server->port;
+  }
+
+  __sync_synchronize();
+  slot->sequence= ticket +1;
+}
@@ -0,0 +1,128 @@
+/*  vim:expandtab:shiftwidth=2:tabstop=2:smarttab:
+ * 
+ *  Libmemcached library
+ *
+ *  Copyright (C) 2011-2012 Data Differential, http://datadifferential.com/
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are
+ *  met:
+ *
+ *      * Redistributions of source code must retain the above copyright
+ *  notice, this list of conditions and the following disclaimer.
+ *
+ *      * Redistributions in binary form must reproduce the above
+ *  copyright notice, this list of conditions and the following disclaimer
+ *  in the documentation and/or other materials provided with the
+ *  distribution.
+ *
+ *      * The names of its contributors may not be used to endorse or
+ *  promote products derived from this software without specific prior
+ *  written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *  A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *  OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *  SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *  LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *  DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *  THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *  OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+#pragma once
+
+struct memcached_slowlog_ring_st;
+
+/*
+  Each memcached_st times its own operations, only the ring that slow
+  operations end up in is shared with its clones.
+*/
+struct memcached_slowlog_st
+{
+  memcached_slowlog_ring_st *ring;
+  uint64_t started; // Set while an operation is being timed
+  uint64_t phase_started;
+  memcached_slowlog_phase_t phase;
+  uint64_t phase_usec[MEMCACHED_SLOWLOG_PHASE_MAX];
+};
+
+void memcached_slowlog_clone(memcached_st *destination, const memcached_st *source);
+
+void memcached_slowlog_begin(memcached_slowlog_st *slowlog);
+
+void memcached_slowlog_finish(memcached_st *ptr,
+                              memcached_telemetry_op_t op,
+                              size_t key_length,
+                              size_t number_of_keys,
+                              size_t value_length,
+                              memcached_return_t rc);
+
+memcached_slowlog_phase_t memcached_slowlog_switch(memcached_slowlog_st *slowlog,
+                                                   memcached_slowlog_phase_t phase);
+
+/*
+  Returns true if the operation is timed. Operations started while another
+  one is being timed, such as the configuration fetch of a poll, count
+  towards the outer operation.
+*/
+static inline bool memcached_slowlog_start(memcached_st *ptr)
+{
+  if (ptr and ptr->slowlog and ptr->slowlog->started == 0)
+  {
+    ptr->trace.server_key= UINT32_MAX;
+    memcached_slowlog_begin(ptr->slowlog);
+    return true;
+  }
+
+  return false;
+}
+
+static inline void memcached_slowlog_end(memcached_st *ptr,
+                                         bool timed,
+                                         memcached_telemetry_op_t op,
+                                         size_t key_length,
+                                         size_t number_of_keys,
+                                         size_t value_length,
+                                         memcached_return_t rc)
+{
+  if (timed)
+  {
+    memcached_slowlog_finish(ptr, op, key_length, number_of_keys, value_length, rc);
+  }
+}
+
+/*
+  Charge the time from now on to phase, and return the phase to hand to
+  memcached_slowlog_leave() once it is over. A configuration poll keeps
+  the time of everything it does.
+*/
+static inline memcached_slowlog_phase_t memcached_slowlog_enter(memcached_st *ptr,
+                                                                memcached_slowlog_phase_t phase)
+{
+  if (ptr and ptr->slowlog and ptr->slowlog->started)
+  {
+    if (ptr->slowlog->phase == MEMCACHED_SLOWLOG_PHASE_CONFIG_POLL)
+    {
+      return MEMCACHED_SLOWLOG_PHASE_CONFIG_POLL;
+    }
+
+    return memcached_slowlog_switch(ptr->slowlog, phase);
+  }
+
+  return phase;
+}
+
+static inline void memcached_slowlog_leave(memcached_st *ptr,
+                                           memcached_slowlog_phase_t previous)
+{
+  if (ptr and ptr->slowlog and ptr->slowlog->started)
+  {
+    memcached_slowlog_switch(ptr->slowlog, previous);
+  }
+}
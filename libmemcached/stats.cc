@@ -551,6 +551,10 @@ memcached_stat_st *memcached_stat(memcached_st *self, char *args, memcached_retu
     stat_instance->root= self;
 
     memcached_server_write_instance_st instance= memcached_server_instance_fetch(self, x);
+    uint64_t traced= memcached_trace_start(self);
+    bool timed= memcached_slowlog_start(self);
+    uint64_t started= memcached_telemetry_start(self);
+    memcached_trace_route(self, x);
 
     memcached_return_t temp_return;
     if (memcached_is_binary(self))
@@ -562,6 +566,10 @@ memcached_stat_st *memcached_stat(memcached_st *self, char *args, memcached_retu
       temp_return= ascii_stats_fetch(stat_instance, args, args_length, instance, NULL);
     }
 
+    memcached_telemetry_record(instance, MEMCACHED_TELEMETRY_OP_STAT, started, temp_return);
+    memcached_slowlog_end(self, timed, MEMCACHED_TELEMETRY_OP_STAT, args_length, 1, 0, temp_return);
+    memcached_trace_end(self, traced, MEMCACHED_TELEMETRY_OP_STAT, args, args_length, 1, 0, temp_return);
+
     // Special case where "args" is invalid
     if (temp_return == MEMCACHED_INVALID_ARGUMENTS)
     {
@@ -679,6 +687,11 @@ static memcached_return_t call_stat_fn(memcached_st *ptr,
   memcached_return_t rc;
   local_context *check= (struct local_context *)context;
 
+  uint64_t traced= memcached_trace_start(ptr);
+  bool timed= memcached_slowlog_start(ptr);
+  uint64_t started= memcached_telemetry_start(ptr);
+  memcached_trace_route(ptr, uint32_t(instance - memcached_server_list(ptr)));
+
   if (memcached_is_binary(ptr))
   {
     rc= binary_stats_fetch(NULL, check->args, check->args_length, instance, check);
@@ -688,6 +701,10 @@ static memcached_return_t call_stat_fn(memcached_st *ptr,
     rc= ascii_stats_fetch(NULL, check->args, check->args_length, instance, check);
   }
 
+  memcached_telemetry_record(instance, MEMCACHED_TELEMETRY_OP_STAT, started, rc);
+  memcached_slowlog_end(ptr, timed, MEMCACHED_TELEMETRY_OP_STAT, check->args_length, 1, 0, rc);
+  memcached_trace_end(ptr, traced, MEMCACHED_TELEMETRY_OP_STAT, check->args, check->args_length, 1, 0, rc);
+
   return rc;
 }
 
@@ -92,6 +92,16 @@ static inline uint8_t can_by_encrypted(const memcached_storage_action_t verb)
   return false;
 }
 
+/*
+  The server keeps the flags of the item an append or prepend extends, and
+  any value may have been stored compressed, so neither can be used while
+  compression is enabled.
+*/
+static inline bool can_be_compressed(const memcached_storage_action_t verb)
+{
+  return verb != APPEND_OP and verb != PREPEND_OP;
+}
+
 static inline uint8_t get_com_code(const memcached_storage_action_t verb, const bool reply)
 {
   if (reply == false)
@@ -155,6 +165,10 @@ static memcached_return_t memcached_send_binary(memcached_st *ptr,
   protocol_binary_request_set request= {};
   size_t send_length= sizeof(request.bytes);
 
+  // An AES-ECB value is encrypted as it is written, and is never any shorter
+  const bool encrypted= memcached_is_encrypted(ptr) and not memcached_is_encrypted_gcm(ptr);
+  const size_t send_value_length= encrypted ? hashkit_encrypt_length(&ptr->hashkit, value_length) : value_length;
+
   request.message.header.request.magic= PROTOCOL_BINARY_REQ;
   request.message.header.request.opcode= get_com_code(verb, reply);
   request.message.header.request.keylen= htons((uint16_t)(key_length + memcached_array_size(ptr->_namespace)));
@@ -170,7 +184,7 @@ static memcached_return_t memcached_send_binary(memcached_st *ptr,
     request.message.body.expiration= htonl((uint32_t)expiration);
   }
 
-  request.message.header.request.bodylen= htonl((uint32_t) (key_length + memcached_array_size(ptr->_namespace) + value_length +
+  request.message.header.request.bodylen= htonl((uint32_t) (key_length + memcached_array_size(ptr->_namespace) + send_value_length +
                                                             request.message.header.request.extlen));
 
   if (cas)
@@ -189,7 +203,7 @@ static memcached_return_t memcached_send_binary(memcached_st *ptr,
 
   /* write the header */
   memcached_return_t rc;
-  if ((rc= memcached_vdo(server, vector, 5, flush)) != MEMCACHED_SUCCESS)
+  if ((rc= memcached_vdo(server, vector, 5, encrypted ? 4 : 5, flush)) != MEMCACHED_SUCCESS)
   {
     memcached_io_reset(server);
 
@@ -205,28 +219,80 @@ static memcached_return_t memcached_send_binary(memcached_st *ptr,
 
   if (verb == SET_OP and ptr->number_of_replicas > 0)
   {
-    request.message.header.request.opcode= PROTOCOL_BINARY_CMD_SETQ;
+    /*
+      A set that waits for its reply also waits for the replicas. Every copy
+      is sent before any answer is read, so the servers store them at the
+      same time.
+    */
+    memcached_return_t *acks= memcached_replication_acks(*ptr, ptr->number_of_replicas);
+    const bool acknowledged= flush and reply and acks;
+    if (acknowledged == false)
+    {
+      request.message.header.request.opcode= PROTOCOL_BINARY_CMD_SETQ;
+    }
     WATCHPOINT_STRING("replicating");
 
+    uint32_t replica_key= server_key;
     for (uint32_t x= 0; x < ptr->number_of_replicas; x++)
     {
-      ++server_key;
-      if (server_key == memcached_server_count(ptr))
+      ++replica_key;
+      if (replica_key == memcached_server_count(ptr))
       {
-        server_key= 0;
+        replica_key= 0;
       }
 
-      memcached_server_write_instance_st instance= memcached_server_instance_fetch(ptr, server_key);
+      memcached_server_write_instance_st instance= memcached_server_instance_fetch(ptr, replica_key);
 
-      if (memcached_vdo(instance, vector, 5, false) != MEMCACHED_SUCCESS)
+      if (memcached_vdo(instance, vector, 5, encrypted ? 4 : 5, acknowledged) != MEMCACHED_SUCCESS)
       {
         memcached_io_reset(instance);
+        if (acks)
+        {
+          acks[x]= MEMCACHED_WRITE_FAILURE;
+        }
+      }
+      else if (acknowledged)
+      {
+        acks[x]= MEMCACHED_IN_PROGRESS;
       }
       else
       {
         memcached_server_response_decrement(instance);
       }
     }
+
+    if (acknowledged)
+    {
+      rc= memcached_response(server, NULL, 0, NULL);
+
+      replica_key= server_key;
+      for (uint32_t x= 0; x < ptr->number_of_replicas; x++)
+      {
+        ++replica_key;
+        if (replica_key == memcached_server_count(ptr))
+        {
+          replica_key= 0;
+        }
+
+        if (acks[x] == MEMCACHED_IN_PROGRESS)
+        {
+          memcached_server_write_instance_st instance= memcached_server_instance_fetch(ptr, replica_key);
+
+          // Reading an earlier answer may have found the connection dead
+          if (memcached_server_response_count(instance) == 0)
+          {
+            acks[x]= MEMCACHED_CONNECTION_FAILURE;
+          }
+          else
+          {
+            acks[x]= memcached_response(instance, NULL, 0, NULL);
+          }
+        }
+      }
+      memcached_replication_record(*ptr);
+
+      return rc;
+    }
   }
 
   if (flush == false)
@@ -272,8 +338,11 @@ static memcached_return_t memcached_send_ascii(memcached_st *ptr,
                                memcached_literal_param("snprintf(MEMCACHED_MAXIMUM_INTEGER_DISPLAY_LENGTH)"));
   }
 
+  const bool encrypted= memcached_is_encrypted(ptr) and not memcached_is_encrypted_gcm(ptr);
+  const size_t send_value_length= encrypted ? hashkit_encrypt_length(&ptr->hashkit, value_length) : value_length;
+
   char value_buffer[MEMCACHED_MAXIMUM_INTEGER_DISPLAY_LENGTH +1];
-  int value_buffer_length= snprintf(value_buffer, sizeof(value_buffer), " %llu", (unsigned long long)value_length);
+  int value_buffer_length= snprintf(value_buffer, sizeof(value_buffer), " %llu", (unsigned long long)send_value_length);
   if (size_t(value_buffer_length) >= sizeof(value_buffer) or value_buffer_length < 0)
   {
     return memcached_set_error(*instance, MEMCACHED_MEMORY_ALLOCATION_FAILURE, MEMCACHED_AT, 
@@ -309,7 +378,7 @@ static memcached_return_t memcached_send_ascii(memcached_st *ptr,
   };
 
   /* Send command header */
-  memcached_return_t rc=  memcached_vdo(instance, vector, 12, flush);
+  memcached_return_t rc=  memcached_vdo(instance, vector, 12, encrypted ? 10 : 12, flush);
 
   // If we should not reply, return with MEMCACHED_SUCCESS, unless error
   if (reply == false)
@@ -349,6 +418,132 @@ static memcached_return_t memcached_send_ascii(memcached_st *ptr,
   return rc;
 }
 
+/* ms sets by default, the other verbs are a mode flag */
+static inline const char *storage_op_meta_mode(memcached_storage_action_t verb)
+{
+  switch (verb)
+  {
+  case REPLACE_OP:
+    return " MR";
+
+  case ADD_OP:
+    return " ME";
+
+  case PREPEND_OP:
+    return " MP";
+
+  case APPEND_OP:
+    return " MA";
+
+  case CAS_OP:
+  case SET_OP:
+    break;
+  }
+
+  return "";
+}
+
+static memcached_return_t memcached_send_meta(memcached_st *ptr,
+                                              memcached_server_write_instance_st instance,
+                                              const char *key,
+                                              const size_t key_length,
+                                              const char *value,
+                                              const size_t value_length,
+                                              const time_t expiration,
+                                              const uint32_t flags,
+                                              const uint64_t cas,
+                                              const bool flush,
+                                              const bool reply,
+                                              const memcached_storage_action_t verb)
+{
+  const bool encrypted= memcached_is_encrypted(ptr) and not memcached_is_encrypted_gcm(ptr);
+  const size_t send_value_length= encrypted ? hashkit_encrypt_length(&ptr->hashkit, value_length) : value_length;
+
+  // Appends and prepends leave the flags and expiration of the item alone
+  char header_buffer[MEMCACHED_DEFAULT_COMMAND_SIZE];
+  int header_buffer_length;
+  if (verb == APPEND_OP or verb == PREPEND_OP)
+  {
+    header_buffer_length= snprintf(header_buffer, sizeof(header_buffer), " %llu", (unsigned long long)send_value_length);
+  }
+  else
+  {
+    header_buffer_length= snprintf(header_buffer, sizeof(header_buffer), " %llu F%u T%llu",
+                                   (unsigned long long)send_value_length, flags, (unsigned long long)expiration);
+  }
+
+  if (size_t(header_buffer_length) >= sizeof(header_buffer) or header_buffer_length < 0)
+  {
+    return memcached_set_error(*instance, MEMCACHED_MEMORY_ALLOCATION_FAILURE, MEMCACHED_AT, 
+                               memcached_literal_param("snprintf(MEMCACHED_DEFAULT_COMMAND_SIZE)"));
+  }
+
+  char cas_buffer[MEMCACHED_MAXIMUM_INTEGER_DISPLAY_LENGTH +3];
+  int cas_buffer_length= 0;
+  if (cas)
+  {
+    cas_buffer_length= snprintf(cas_buffer, sizeof(cas_buffer), " C%llu", (unsigned long long)cas);
+    if (size_t(cas_buffer_length) >= sizeof(cas_buffer) or cas_buffer_length < 0)
+    {
+      return memcached_set_error(*instance, MEMCACHED_MEMORY_ALLOCATION_FAILURE, MEMCACHED_AT, 
+                                 memcached_literal_param("snprintf(MEMCACHED_MAXIMUM_INTEGER_DISPLAY_LENGTH)"));
+    }
+  }
+
+  memcached_meta_key_st meta_key;
+  memcached_meta_key(*ptr, key, key_length, meta_key);
+
+  libmemcached_io_vector_st vector[]=
+  {
+    { NULL, 0 },
+    { memcached_literal_param("ms ") },
+    meta_key.vector[0],
+    meta_key.vector[1],
+    { header_buffer, size_t(header_buffer_length) },
+    { cas_buffer, size_t(cas_buffer_length) },
+    { storage_op_meta_mode(verb), strlen(storage_op_meta_mode(verb)) },
+    { " b", meta_key.base64 ? memcached_literal_param_size(" b") : 0 },
+    { MEMCACHED_META_QUIET, reply ? 0 : memcached_literal_param_size(MEMCACHED_META_QUIET) },
+    { memcached_literal_param("\r\n") },
+    { value, value_length },
+    { memcached_literal_param("\r\n") }
+  };
+
+  /* Send command header */
+  memcached_return_t rc=  memcached_vdo(instance, vector, 12, encrypted ? 10 : 12, flush);
+
+  // If we should not reply, return with MEMCACHED_SUCCESS, unless error
+  if (reply == false)
+  {
+    return memcached_success(rc) ? MEMCACHED_SUCCESS : rc; 
+  }
+
+  if (flush == false)
+  {
+    return memcached_success(rc) ? MEMCACHED_BUFFERED : rc; 
+  }
+
+  if (rc == MEMCACHED_SUCCESS)
+  {
+    char buffer[MEMCACHED_DEFAULT_COMMAND_SIZE];
+    rc= memcached_response(instance, buffer, sizeof(buffer), NULL);
+
+    if (rc == MEMCACHED_SUCCESS)
+    {
+      return MEMCACHED_SUCCESS;
+    }
+  }
+
+  if (rc == MEMCACHED_WRITE_FAILURE)
+  {
+    memcached_io_reset(instance);
+  }
+
+  assert(memcached_failed(rc));
+
+  return rc;
+}
+
 static inline memcached_return_t memcached_send(memcached_st *ptr,
                                                 const char *group_key, size_t group_key_length,
                                                 const char *key, size_t key_length,
@@ -369,8 +564,44 @@ static inline memcached_return_t memcached_send(memcached_st *ptr,
     return memcached_last_error(ptr);
   }
 
+  if (memcached_is_encrypted(ptr) and can_by_encrypted(verb) == false)
+  {
+    return memcached_set_error(*ptr, MEMCACHED_NOT_SUPPORTED, MEMCACHED_AT, 
+                               memcached_literal_param("Operation not allowed while encyrption is enabled"));
+  }
+
+  if (memcached_is_compressed(ptr) and can_be_compressed(verb) == false)
+  {
+    return memcached_set_error(*ptr, MEMCACHED_NOT_SUPPORTED, MEMCACHED_AT,
+                               memcached_literal_param("Operation not allowed while compression is enabled"));
+  }
+
+  // Compression and the AES-GCM envelope happen up front, the flags say which format was stored
+  const char *send_value= value;
+  size_t send_value_length= value_length;
+  uint32_t send_flags= flags;
+  if (memcached_is_compressed(ptr))
+  {
+    if (memcached_failed(rc= memcached_compress_value(*ptr, send_value, send_value_length, send_flags)))
+    {
+      return rc;
+    }
+  }
+
+  if (memcached_is_encrypted_gcm(ptr))
+  {
+    if (memcached_failed(rc= memcached_encrypt_value(*ptr, key, key_length, send_value, send_value_length, send_flags)))
+    {
+      return rc;
+    }
+  }
+
+  uint64_t traced= memcached_trace_start(ptr);
+
+  bool timed= memcached_slowlog_start(ptr);
   uint32_t server_key= memcached_generate_hash_with_redistribution(ptr, group_key, group_key_length);
   memcached_server_write_instance_st instance= memcached_server_instance_fetch(ptr, server_key);
+  uint64_t started= memcached_telemetry_start(ptr);
 
   WATCHPOINT_SET(instance->io_wait_count.read= 0);
   WATCHPOINT_SET(instance->io_wait_count.write= 0);
@@ -384,40 +615,39 @@ static inline memcached_return_t memcached_send(memcached_st *ptr,
 
   bool reply= memcached_is_replying(ptr);
 
-  hashkit_string_st* destination= NULL;
-
-  if (memcached_is_encrypted(ptr))
-  {
-    if (can_by_encrypted(verb) == false)
-    {
-      return memcached_set_error(*ptr, MEMCACHED_NOT_SUPPORTED, MEMCACHED_AT, 
-                                 memcached_literal_param("Operation not allowed while encyrption is enabled"));
-    }
-
-    if ((destination= hashkit_encrypt(&ptr->hashkit, value, value_length)) == NULL)
-    {
-      return rc;
-    }
-    value= hashkit_string_c_str(destination);
-    value_length= hashkit_string_length(destination);
-  }
-
   if (memcached_is_binary(ptr))
   {
     rc= memcached_send_binary(ptr, instance, server_key,
                               key, key_length,
-                              value, value_length, expiration,
-                              flags, cas, flush, reply, verb);
+                              send_value, send_value_length, expiration,
+                              send_flags, cas, flush, reply, verb);
+  }
+  else if (memcached_is_meta(ptr))
+  {
+    rc= memcached_send_meta(ptr, instance,
+                            key, key_length,
+                            send_value, send_value_length, expiration,
+                            send_flags, cas, flush, reply, verb);
   }
   else
   {
     rc= memcached_send_ascii(ptr, instance,
                              key, key_length,
-                             value, value_length, expiration,
-                             flags, cas, flush, reply, verb);
+                             send_value, send_value_length, expiration,
+                             send_flags, cas, flush, reply, verb);
   }
 
-  hashkit_string_free(destination);
+  memcached_telemetry_record(instance, MEMCACHED_TELEMETRY_OP_SET, started, rc);
+  memcached_slowlog_end(ptr, timed, MEMCACHED_TELEMETRY_OP_SET, key_length, 1, value_length, rc);
+  memcached_trace_end(ptr, traced, MEMCACHED_TELEMETRY_OP_SET, key, key_length, 1, value_length, rc);
+
+  if (ptr->near_cache)
+  {
+    // Appends and prepends leave the expiration of the item alone
+    bool keeps_expiration= verb == APPEND_OP or verb == PREPEND_OP;
+    memcached_near_cache_invalidate(ptr, group_key, group_key_length, key, key_length,
+                                    keeps_expiration ? 0 : expiration);
+  }
 
   return rc;
 }
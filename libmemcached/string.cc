@@ -256,8 +256,15 @@ const char *memcached_string_value(const memcached_string_st& self)
 char *memcached_string_take_value(memcached_string_st *self)
 {
   assert_msg(self, "Invalid memcached_string_st");
-  // If we fail at adding the null, we copy and move on
-  if (memcached_success(memcached_string_append_null(self)))
+  // Empty values have always been returned as NULL
+  if (memcached_string_length(self) == 0)
+  {
+    return NULL;
+  }
+
+  // If we fail at adding the null, we copy and move on, otherwise the
+  // caller adopts our buffer and we start over with a fresh one.
+  if (memcached_failed(memcached_string_append_null(self)))
   {
     return memcached_string_c_copy(self);
   }
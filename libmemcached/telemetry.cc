@@ -0,0 +1,380 @@
+/*  vim:expandtab:shiftwidth=2:tabstop=2:smarttab:
+ * 
+ *  Libmemcached library
+ *
+ *  Copyright (C) 2011-2012 Data Differential, http://datadifferential.com/
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are
+ *  met:
+ *
+ *      * Redistributions of source code must retain the above copyright
+ *  notice, this list of conditions and the following disclaimer.
+ *
+ *      * Redistributions in binary form must reproduce the above
+ *  copyright notice, this list of conditions and the following disclaimer
+ *  in the documentation and/or other materials provided with the
+ *  distribution.
+ *
+ *      * The names of its contributors may not be used to endorse or
+ *  promote products derived from this software without specific prior
+ *  written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *  A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *  OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *  SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *  LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *  DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *  THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *  OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+
+/*
+  Per server latency histograms and counters, turned on with
+  MEMCACHED_BEHAVIOR_SERVER_TELEMETRY. Each memcached_st only ever updates
+  its own servers, so none of this needs a lock; a pool rolls its handles up
+  with memcached_telemetry_merge().
+*/
+
+#include <libmemcached/common.h>
+
+#include <cmath>
+
+uint64_t memcached_telemetry_now(void)
+{
+  uint64_t now= 0;
+#if defined(HAVE_CLOCK_GETTIME) && HAVE_CLOCK_GETTIME
+  struct timespec ts;
+  if (clock_gettime(CLOCK_MONOTONIC, &ts) == 0)
+  {
+    now= uint64_t(ts.tv_sec) * 1000000 + uint64_t(ts.tv_nsec) / 1000;
+  }
+#else
+  struct timeval tv;
+  if (gettimeofday(&tv, NULL) == 0)
+  {
+    now= uint64_t(tv.tv_sec) * 1000000 + uint64_t(tv.tv_usec);
+  }
+#endif
+
+  // 0 means that nothing is being timed
+  return now ? now : 1;
+}
+
+memcached_telemetry_counter_st *memcached_telemetry_counter(memcached_server_write_instance_st server)
+{
+  if (server->telemetry == NULL)
+  {
+    server->telemetry= libmemcached_xcalloc(server->root, 1, memcached_telemetry_counter_st);
+  }
+
+  return server->telemetry;
+}
+
+void memcached_telemetry_counter_free(memcached_server_write_instance_st server)
+{
+  libmemcached_free(server->root, server->telemetry);
+  server->telemetry= NULL;
+}
+
+static inline uint32_t histogram_bucket(uint64_t usec)
+{
+  if (usec < 8)
+  {
+    return uint32_t(usec);
+  }
+
+  uint32_t exponent= 63 - __builtin_clzll(usec);
+  uint32_t bucket= 8 + (exponent - 3) * 4 + uint32_t((usec >> (exponent - 2)) & 3);
+
+  return bucket < MEMCACHED_HISTOGRAM_BUCKETS ? bucket : MEMCACHED_HISTOGRAM_BUCKETS - 1;
+}
+
+static inline uint64_t histogram_bucket_limit(uint32_t bucket)
+{
+  if (bucket < 8)
+  {
+    return bucket;
+  }
+
+  // Everything that did not fit below
+  if (bucket == MEMCACHED_HISTOGRAM_BUCKETS - 1)
+  {
+    return UINT64_MAX;
+  }
+
+  uint32_t exponent= (bucket - 8) / 4 + 3;
+  uint64_t width= uint64_t(1) << (exponent - 2);
+
+  return (4 + (bucket - 8) % 4) * width + width - 1;
+}
+
+void memcached_telemetry_latency(memcached_server_write_instance_st server,
+                                 memcached_telemetry_op_t op, uint64_t started)
+{
+  memcached_telemetry_counter_st *counter= memcached_telemetry_counter(server);
+  if (counter == NULL)
+  {
+    return;
+  }
+
+  uint64_t now= memcached_telemetry_now();
+  uint64_t usec= now > started ? now - started : 0;
+
+  memcached_histogram_st& histogram= counter->stats.latency[op];
+  histogram.count++;
+  histogram.total_usec+= usec;
+  if (usec > histogram.max_usec)
+  {
+    histogram.max_usec= usec;
+  }
+  histogram.buckets[histogram_bucket(usec)]++;
+}
+
+static void histogram_add(memcached_histogram_st& destination, const memcached_histogram_st& source)
+{
+  destination.count+= source.count;
+  destination.total_usec+= source.total_usec;
+  if (source.max_usec > destination.max_usec)
+  {
+    destination.max_usec= source.max_usec;
+  }
+
+  for (uint32_t x= 0; x < MEMCACHED_HISTOGRAM_BUCKETS; x++)
+  {
+    destination.buckets[x]+= source.buckets[x];
+  }
+}
+
+static void server_telemetry_add(memcached_server_telemetry_st& destination, const memcached_server_telemetry_st& source)
+{
+  destination.bytes_read+= source.bytes_read;
+  destination.bytes_written+= source.bytes_written;
+  destination.connects+= source.connects;
+  destination.reconnects+= source.reconnects;
+  destination.ejections+= source.ejections;
+  destination.poll_wakeups+= source.poll_wakeups;
+
+  for (uint32_t x= 0; x < MEMCACHED_TELEMETRY_OP_MAX; x++)
+  {
+    histogram_add(destination.latency[x], source.latency[x]);
+  }
+}
+
+static memcached_server_telemetry_st *server_telemetry_find(memcached_telemetry_st& telemetry,
+                                                            const char *hostname, in_port_t port)
+{
+  for (uint32_t x= 0; x < telemetry.number_of_servers; x++)
+  {
+    if (telemetry.servers[x].port == port and strcmp(telemetry.servers[x].hostname, hostname) == 0)
+    {
+      return &telemetry.servers[x];
+    }
+  }
+
+  return NULL;
+}
+
+static void snapshot_server(memcached_telemetry_st& telemetry, memcached_server_instance_st server)
+{
+  memcached_server_telemetry_st *destination= server_telemetry_find(telemetry, server->hostname, server->port);
+  if (destination == NULL)
+  {
+    destination= &telemetry.servers[telemetry.number_of_servers++];
+    memcpy(destination->hostname, server->hostname, sizeof(destination->hostname));
+    destination->port= server->port;
+  }
+
+  if (server->telemetry)
+  {
+    server_telemetry_add(*destination, server->telemetry->stats);
+  }
+}
+
+memcached_telemetry_st *memcached_telemetry_snapshot(const memcached_st *ptr,
+                                                     memcached_return_t *error)
+{
+  memcached_return_t unused;
+  if (error == NULL)
+  {
+    error= &unused;
+  }
+
+  if (ptr == NULL)
+  {
+    *error= MEMCACHED_INVALID_ARGUMENTS;
+    return NULL;
+  }
+
+  memcached_telemetry_st *telemetry= static_cast<memcached_telemetry_st *>(std::calloc(1, sizeof(memcached_telemetry_st)));
+  if (telemetry == NULL)
+  {
+    *error= MEMCACHED_MEMORY_ALLOCATION_FAILURE;
+    return NULL;
+  }
+
+  // The configuration endpoint is polled outside of the server list
+  uint32_t number_of_servers= memcached_server_count(ptr) + (ptr->configserver ? 1 : 0);
+  if (number_of_servers)
+  {
+    telemetry->servers= static_cast<memcached_server_telemetry_st *>(std::calloc(number_of_servers, sizeof(memcached_server_telemetry_st)));
+    if (telemetry->servers == NULL)
+    {
+      std::free(telemetry);
+      *error= MEMCACHED_MEMORY_ALLOCATION_FAILURE;
+      return NULL;
+    }
+  }
+
+  for (uint32_t x= 0; x < memcached_server_count(ptr); x++)
+  {
+    snapshot_server(*telemetry, memcached_server_instance_by_position(ptr, x));
+  }
+
+  if (ptr->configserver)
+  {
+    snapshot_server(*telemetry, ptr->configserver);
+  }
+
+  *error= MEMCACHED_SUCCESS;
+
+  return telemetry;
+}
+
+memcached_return_t memcached_telemetry_merge(memcached_telemetry_st *destination,
+                                             const memcached_telemetry_st *source)
+{
+  if (destination == NULL or source == NULL)
+  {
+    return MEMCACHED_INVALID_ARGUMENTS;
+  }
+
+  uint32_t missing= 0;
+  for (uint32_t x= 0; x < source->number_of_servers; x++)
+  {
+    if (server_telemetry_find(*destination, source->servers[x].hostname, source->servers[x].port) == NULL)
+    {
+      missing++;
+    }
+  }
+
+  if (missing)
+  {
+    memcached_server_telemetry_st *servers= static_cast<memcached_server_telemetry_st *>(std::realloc(destination->servers, (destination->number_of_servers + missing) * sizeof(memcached_server_telemetry_st)));
+    if (servers == NULL)
+    {
+      return MEMCACHED_MEMORY_ALLOCATION_FAILURE;
+    }
+    destination->servers= servers;
+  }
+
+  for (uint32_t x= 0; x < source->number_of_servers; x++)
+  {
+    const memcached_server_telemetry_st& server= source->servers[x];
+    memcached_server_telemetry_st *match= server_telemetry_find(*destination, server.hostname, server.port);
+    if (match)
+    {
+      server_telemetry_add(*match, server);
+    }
+    else
+    {
+      destination->servers[destination->number_of_servers++]= server;
+    }
+  }
+
+  return MEMCACHED_SUCCESS;
+}
+
+void memcached_telemetry_free(memcached_telemetry_st *telemetry)
+{
+  if (telemetry)
+  {
+    std::free(telemetry->servers);
+    std::free(telemetry);
+  }
+}
+
+void memcached_telemetry_reset(memcached_st *ptr)
+{
+  if (ptr == NULL)
+  {
+    return;
+  }
+
+  for (uint32_t x= 0; x < memcached_server_count(ptr); x++)
+  {
+    memcached_server_write_instance_st server= memcached_server_instance_fetch(ptr, x);
+    if (server->telemetry)
+    {
+      memset(&server->telemetry->stats, 0, sizeof(server->telemetry->stats));
+    }
+  }
+
+  if (ptr->configserver and ptr->configserver->telemetry)
+  {
+    memset(&ptr->configserver->telemetry->stats, 0, sizeof(ptr->configserver->telemetry->stats));
+  }
+}
+
+uint64_t memcached_histogram_percentile(const memcached_histogram_st *histogram,
+                                        double percentile)
+{
+  if (histogram == NULL or histogram->count == 0)
+  {
+    return 0;
+  }
+
+  if (percentile <= 0)
+  {
+    percentile= 0;
+  }
+  else if (percentile > 100)
+  {
+    percentile= 100;
+  }
+
+  uint64_t wanted= uint64_t(std::ceil(double(histogram->count) * percentile / 100));
+  if (wanted == 0)
+  {
+    wanted= 1;
+  }
+
+  uint64_t seen= 0;
+  for (uint32_t x= 0; x < MEMCACHED_HISTOGRAM_BUCKETS; x++)
+  {
+    seen+= histogram->buckets[x];
+    if (seen >= wanted)
+    {
+      uint64_t limit= histogram_bucket_limit(x);
+      return limit < histogram->max_usec ? limit : histogram->max_usec;
+    }
+  }
+
+  return histogram->max_usec;
+}
+
+const char *memcached_telemetry_op_string(memcached_telemetry_op_t op)
+{
+  switch (op)
+  {
+  case MEMCACHED_TELEMETRY_OP_GET: return "get";
+  case MEMCACHED_TELEMETRY_OP_MGET: return "mget";
+  case MEMCACHED_TELEMETRY_OP_SET: return "set";
+  case MEMCACHED_TELEMETRY_OP_DELETE: return "delete";
+  case MEMCACHED_TELEMETRY_OP_INCR: return "incr";
+  case MEMCACHED_TELEMETRY_OP_CONFIG_GET: return "config get";
+  case MEMCACHED_TELEMETRY_OP_STAT: return "stat";
+  case MEMCACHED_TELEMETRY_OP_MAX:
+  default:
+    break;
+  }
+
+  return "INVALID memcached_telemetry_op_t";
+}
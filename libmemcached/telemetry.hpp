@@ -0,0 +1,225 @@
+/*  vim:expandtab:shiftwidth=2:tabstop=2:smarttab:
+ * 
+ *  Libmemcached library
+ *
+ *  Copyright (C) 2011-2012 Data Differential, http://datadifferential.com/
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are
+ *  met:
+ *
+ *      * Redistributions of source code must retain the above copyright
+ *  notice, this list of conditions and the following disclaimer.
+ *
+ *      * Redistributions in binary form must reproduce the above
+ *  copyright notice, this list of conditions and the following disclaimer
+ *  in the documentation and/or other materials provided with the
+ *  distribution.
+ *
+ *      * The names of its contributors may not be used to endorse or
+ *  promote products derived from this software without specific prior
+ *  written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *  A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *  OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *  SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *  LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *  DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *  THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *  OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+
+#pragma once
+
+struct memcached_telemetry_counter_st
+{
+  memcached_server_telemetry_st stats;
+  memcached_telemetry_op_t pending_op;
+  uint64_t pending_started; // Set while a get to the server waits for its responses
+};
+
+uint64_t memcached_telemetry_now(void);
+
+memcached_telemetry_counter_st *memcached_telemetry_counter(memcached_server_write_instance_st server);
+
+void memcached_telemetry_counter_free(memcached_server_write_instance_st server);
+
+void memcached_telemetry_latency(memcached_server_write_instance_st server,
+                                 memcached_telemetry_op_t op, uint64_t started);
+
+#if LIBMEMCACHED_WITH_TELEMETRY
+
+static inline bool memcached_telemetry_enabled(const memcached_server_st *server)
+{
+  return server->root and server->root->flags.server_telemetry;
+}
+
+/*
+  Returns the time an operation starts at, or 0 when ptr does not gather
+  telemetry.
+*/
+static inline uint64_t memcached_telemetry_start(const memcached_st *ptr)
+{
+  return ptr->flags.server_telemetry ? memcached_telemetry_now() : 0;
+}
+
+static inline void memcached_telemetry_record(memcached_server_write_instance_st server,
+                                              memcached_telemetry_op_t op,
+                                              uint64_t started,
+                                              memcached_return_t rc)
+{
+  // Buffered requests have not been to the server yet
+  if (started and rc != MEMCACHED_BUFFERED)
+  {
+    memcached_telemetry_latency(server, op, started);
+  }
+}
+
+/*
+  Gets are timed from the first key written to a server until its answer
+  has been read, see memcached_telemetry_response().
+*/
+static inline void memcached_telemetry_begin(memcached_server_write_instance_st server,
+                                             memcached_telemetry_op_t op)
+{
+  if (server->cursor_active == 0 and memcached_telemetry_enabled(server))
+  {
+    memcached_telemetry_counter_st *counter= memcached_telemetry_counter(server);
+    if (counter)
+    {
+      counter->pending_op= op;
+      counter->pending_started= memcached_telemetry_now();
+    }
+  }
+}
+
+/*
+  A single get is answered by its first response, the END that follows a
+  value is only read by the next request. An mget has been answered once
+  the server owes nothing more.
+*/
+static inline void memcached_telemetry_response(memcached_server_write_instance_st server,
+                                                memcached_return_t rc)
+{
+  if (server->telemetry and server->telemetry->pending_started)
+  {
+    if (server->telemetry->pending_op != MEMCACHED_TELEMETRY_OP_MGET or
+        server->cursor_active == 0 or memcached_fatal(rc))
+    {
+      uint64_t started= server->telemetry->pending_started;
+      server->telemetry->pending_started= 0;
+      memcached_telemetry_latency(server, server->telemetry->pending_op, started);
+    }
+  }
+}
+
+static inline void memcached_telemetry_abandon(memcached_server_write_instance_st server)
+{
+  if (server->telemetry)
+  {
+    server->telemetry->pending_started= 0;
+  }
+}
+
+static inline void memcached_telemetry_bytes_read(memcached_server_write_instance_st server, ssize_t length)
+{
+  if (length > 0 and memcached_telemetry_enabled(server))
+  {
+    memcached_telemetry_counter_st *counter= memcached_telemetry_counter(server);
+    if (counter)
+    {
+      counter->stats.bytes_read+= uint64_t(length);
+    }
+  }
+}
+
+static inline void memcached_telemetry_bytes_written(memcached_server_write_instance_st server, ssize_t length)
+{
+  if (length > 0 and memcached_telemetry_enabled(server))
+  {
+    memcached_telemetry_counter_st *counter= memcached_telemetry_counter(server);
+    if (counter)
+    {
+      counter->stats.bytes_written+= uint64_t(length);
+    }
+  }
+}
+
+static inline void memcached_telemetry_poll_wakeup(memcached_server_write_instance_st server)
+{
+  if (memcached_telemetry_enabled(server))
+  {
+    memcached_telemetry_counter_st *counter= memcached_telemetry_counter(server);
+    if (counter)
+    {
+      counter->stats.poll_wakeups++;
+    }
+  }
+}
+
+static inline void memcached_telemetry_connect(memcached_server_write_instance_st server)
+{
+  if (memcached_telemetry_enabled(server))
+  {
+    memcached_telemetry_counter_st *counter= memcached_telemetry_counter(server);
+    if (counter and counter->stats.connects++)
+    {
+      counter->stats.reconnects++;
+    }
+  }
+}
+
+static inline void memcached_telemetry_ejection(memcached_server_write_instance_st server)
+{
+  if (memcached_telemetry_enabled(server))
+  {
+    memcached_telemetry_counter_st *counter= memcached_telemetry_counter(server);
+    if (counter)
+    {
+      counter->stats.ejections++;
+    }
+  }
+}
+
+#else
+
+static inline uint64_t memcached_telemetry_start(const memcached_st *)
+{
+  return 0;
+}
+
+static inline void memcached_telemetry_record(memcached_server_write_instance_st, memcached_telemetry_op_t, uint64_t, memcached_return_t)
+{ }
+
+static inline void memcached_telemetry_begin(memcached_server_write_instance_st, memcached_telemetry_op_t)
+{ }
+
+static inline void memcached_telemetry_response(memcached_server_write_instance_st, memcached_return_t)
+{ }
+
+static inline void memcached_telemetry_abandon(memcached_server_write_instance_st)
+{ }
+
+static inline void memcached_telemetry_bytes_read(memcached_server_write_instance_st, ssize_t)
+{ }
+
+static inline void memcached_telemetry_bytes_written(memcached_server_write_instance_st, ssize_t)
+{ }
+
+static inline void memcached_telemetry_poll_wakeup(memcached_server_write_instance_st)
+{ }
+
+static inline void memcached_telemetry_connect(memcached_server_write_instance_st)
+{ }
+
+static inline void memcached_telemetry_ejection(memcached_server_write_instance_st)
+{ }
+
+#endif // LIBMEMCACHED_WITH_TELEMETRY
@@ -70,6 +70,42 @@ static memcached_return_t ascii_touch(memcached_server_write_instance_st instanc
   return rc;
 }
 
+static memcached_return_t meta_touch(memcached_server_write_instance_st instance,
+                                     const char *key, size_t key_length,
+                                     time_t expiration)
+{
+  char expiration_buffer[MEMCACHED_MAXIMUM_INTEGER_DISPLAY_LENGTH +3];
+  int expiration_buffer_length= snprintf(expiration_buffer, sizeof(expiration_buffer), " T%llu", (unsigned long long)expiration);
+  if (size_t(expiration_buffer_length) >= sizeof(expiration_buffer) or expiration_buffer_length < 0)
+  {
+    return memcached_set_error(*instance, MEMCACHED_MEMORY_ALLOCATION_FAILURE, MEMCACHED_AT, 
+                               memcached_literal_param("snprintf(MEMCACHED_MAXIMUM_INTEGER_DISPLAY_LENGTH)"));
+  }
+
+  memcached_meta_key_st meta_key;
+  memcached_meta_key(*instance->root, key, key_length, meta_key);
+
+  libmemcached_io_vector_st vector[]=
+  {
+    { NULL, 0 },
+    { memcached_literal_param("mg ") },
+    meta_key.vector[0],
+    meta_key.vector[1],
+    { " b", meta_key.base64 ? memcached_literal_param_size(" b") : 0 },
+    { expiration_buffer, size_t(expiration_buffer_length) },
+    { memcached_literal_param("\r\n") }
+  };
+
+  memcached_return_t rc;
+  if (memcached_failed(rc= memcached_vdo(instance, vector, 7, true)))
+  {
+    memcached_io_reset(instance);
+    return memcached_set_error(*instance, MEMCACHED_WRITE_FAILURE, MEMCACHED_AT);
+  }
+
+  return rc;
+}
+
 static memcached_return_t binary_touch(memcached_server_write_instance_st instance,
                                        const char *key, size_t key_length,
                                        time_t expiration)
@@ -126,6 +162,11 @@ memcached_return_t memcached_touch_by_key(memcached_st *ptr,
     return rc;
   }
 
+  if (memcached_is_meta(ptr) and memcached_failed(rc= memcached_meta_key_test(*ptr, key, key_length)))
+  {
+    return memcached_set_error(*ptr, rc, MEMCACHED_AT, memcached_literal_param("Key provided was too long to be base64 encoded."));
+  }
+
   uint32_t server_key= memcached_generate_hash_with_redistribution(ptr, group_key, group_key_length);
   memcached_server_write_instance_st instance= memcached_server_instance_fetch(ptr, server_key);
 
@@ -133,6 +174,10 @@ memcached_return_t memcached_touch_by_key(memcached_st *ptr,
   {
     rc= binary_touch(instance, key, key_length, expiration);
   }
+  else if (memcached_is_meta(ptr))
+  {
+    rc= meta_touch(instance, key, key_length, expiration);
+  }
   else
   {
     rc= ascii_touch(instance, key, key_length, expiration);
@@ -146,6 +191,11 @@ memcached_return_t memcached_touch_by_key(memcached_st *ptr,
   char buffer[MEMCACHED_DEFAULT_COMMAND_SIZE];
   rc= memcached_response(instance, buffer, sizeof(buffer), NULL);
 
+  if (ptr->near_cache)
+  {
+    memcached_near_cache_invalidate(ptr, group_key, group_key_length, key, key_length, expiration);
+  }
+
   if (rc == MEMCACHED_SUCCESS or rc == MEMCACHED_NOTFOUND)
   {
     return rc;
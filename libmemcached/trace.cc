@@ -0,0 +1,123 @@
+/*  vim:expandtab:shiftwidth=2:tabstop=2:smarttab:
+ * 
+ *  Libmemcached library
+ *
+ *  Copyright (C) 2011-2012 Data Differential, http://datadifferential.com/
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are
+ *  met:
+ *
+ *      * Redistributions of source code must retain the above copyright
+ *  notice, this list of conditions and the following disclaimer.
+ *
+ *      * Redistributions in binary form must reproduce the above
+ *  copyright notice, this list of conditions and the following disclaimer
+ *  in the documentation and/or other materials provided with the
+ *  distribution.
+ *
+ *      * The names of its contributors may not be used to endorse or
+ *  promote products derived from this software without specific prior
+ *  written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *  A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *  OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *  SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *  LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *  DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *  THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *  OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+
+/*
+  Sampled operation tracing, see memcached_set_trace_fn().
+*/
+
+#include <libmemcached/common.h>
+
+memcached_return_t memcached_set_trace_fn(memcached_st *ptr,
+                                          memcached_trace_fn function,
+                                          void *context,
+                                          uint32_t sample_rate)
+{
+  if (ptr == NULL)
+  {
+    return MEMCACHED_INVALID_ARGUMENTS;
+  }
+
+  if (function and sample_rate == 0)
+  {
+    return memcached_set_error(*ptr, MEMCACHED_INVALID_ARGUMENTS, MEMCACHED_AT,
+                               memcached_literal_param("sample_rate must be at least 1"));
+  }
+
+  ptr->trace.function= function;
+  ptr->trace.context= function ? context : NULL;
+  ptr->trace.sample_rate= function ? sample_rate : 0;
+  ptr->trace.countdown= ptr->trace.sample_rate;
+
+  return MEMCACHED_SUCCESS;
+}
+
+memcached_trace_fn memcached_get_trace_fn(const memcached_st *ptr, void **context)
+{
+  if (ptr == NULL)
+  {
+    return NULL;
+  }
+
+  if (context)
+  {
+    *context= ptr->trace.context;
+  }
+
+  return ptr->trace.function;
+}
+
+void memcached_trace_finish(memcached_st *ptr,
+                            uint64_t started,
+                            memcached_telemetry_op_t op,
+                            const char *key, size_t key_length,
+                            size_t number_of_keys,
+                            size_t value_length,
+                            memcached_return_t rc)
+{
+  memcached_trace_fn function= ptr->trace.function;
+  if (function == NULL)
+  {
+    return;
+  }
+
+  memcached_trace_event_st event;
+  event.op= op;
+  event.rc= rc;
+  event.key= key;
+  event.key_length= key_length;
+  event.number_of_keys= number_of_keys;
+  event.value_length= value_length;
+  event.server_key= number_of_keys > 1 ? UINT32_MAX : ptr->trace.server_key;
+  event.hostname= NULL;
+  event.port= 0;
+  event.start_usec= started;
+  event.end_usec= memcached_telemetry_now();
+
+  if (event.server_key < memcached_server_count(ptr))
+  {
+    memcached_server_instance_st server= memcached_server_instance_by_position(ptr, event.server_key);
+    event.hostname= server->hostname;
+    event.port= server->port;
+  }
+  else
+  {
+    event.server_key= UINT32_MAX;
+  }
+
+  function(ptr, &event, ptr->trace.context);
+}
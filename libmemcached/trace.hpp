@@ -0,0 +1,86 @@
+/*  vim:expandtab:shiftwidth=2:tabstop=2:smarttab:
+ * 
+ *  Libmemcached library
+ *
+ *  Copyright (C) 2011-2012 Data Differential, http://datadifferential.com/
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are
+ *  met:
+ *
+ *      * Redistributions of source code must retain the above copyright
+ *  notice, this list of conditions and the following disclaimer.
+ *
+ *      * Redistributions in binary form must reproduce the above
+ *  copyright notice, this list of conditions and the following disclaimer
+ *  in the documentation and/or other materials provided with the
+ *  distribution.
+ *
+ *      * The names of its contributors may not be used to endorse or
+ *  promote products derived from this software without specific prior
+ *  written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *  A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *  OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *  SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *  LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *  DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *  THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *  OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+#pragma once
+
+void memcached_trace_finish(memcached_st *ptr,
+                            uint64_t started,
+                            memcached_telemetry_op_t op,
+                            const char *key, size_t key_length,
+                            size_t number_of_keys,
+                            size_t value_length,
+                            memcached_return_t rc);
+
+/*
+  Returns the time a sampled operation starts at, or 0 when the operation
+  is not traced.
+*/
+static inline uint64_t memcached_trace_start(memcached_st *ptr)
+{
+  if (ptr == NULL or ptr->trace.function == NULL)
+  {
+    return 0;
+  }
+
+  if (--ptr->trace.countdown)
+  {
+    return 0;
+  }
+  ptr->trace.countdown= ptr->trace.sample_rate;
+  ptr->trace.server_key= UINT32_MAX;
+
+  return memcached_telemetry_now();
+}
+
+static inline void memcached_trace_route(memcached_st *ptr, uint32_t server_key)
+{
+  ptr->trace.server_key= server_key;
+}
+
+static inline void memcached_trace_end(memcached_st *ptr,
+                                       uint64_t started,
+                                       memcached_telemetry_op_t op,
+                                       const char *key, size_t key_length,
+                                       size_t number_of_keys,
+                                       size_t value_length,
+                                       memcached_return_t rc)
+{
+  if (started)
+  {
+    memcached_trace_finish(ptr, started, op, key, key_length, number_of_keys, value_length, rc);
+  }
+}
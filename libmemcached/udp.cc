@@ -37,6 +37,38 @@
 
 #include <libmemcached/common.h>
 
+#include <cerrno>
+#include <cstring>
+
+#define UDP_DATAGRAM_BATCH 32 // Datagrams sent or received with a single system call
+#define UDP_MAX_REQUESTS_PER_SERVER 1024 // Message numbers that a request id has room for
+
+struct memcached_udp_request_st
+{
+  uint32_t server_key;
+  uint16_t request_id;
+  uint16_t number_of_datagrams; // 0 until the first datagram of the answer arrives
+  uint16_t received;
+  bool is_done;
+  bool is_failed; // Sent again over TCP
+  size_t command; // Where the request is in payload, until it has been sent
+  size_t command_length;
+  size_t slots; // The first of the number_of_datagrams slots of the answer
+  size_t first_key;
+  size_t number_of_keys;
+};
+
+struct memcached_udp_item_st
+{
+  uint32_t server_key;
+  uint32_t flags;
+  uint64_t cas;
+  size_t key; // Offsets into response
+  size_t key_length;
+  size_t value;
+  size_t value_length;
+};
+
 /*
  * The udp request id consists of two seperate sections
  *   1) The thread id
@@ -75,3 +107,820 @@ bool memcached_io_init_udp_header(memcached_server_write_instance_st ptr, const
 
   return MEMCACHED_SUCCESS;
 }
+
+template <class T>
+static bool udp_reserve(memcached_st& self, T *&array, size_t& size, size_t wanted)
+{
+  if (size >= wanted)
+  {
+    return true;
+  }
+
+  size_t new_size= size ? size : 16;
+  while (new_size < wanted)
+  {
+    new_size*= 2;
+  }
+
+  T *new_array= libmemcached_xrealloc(&self, array, new_size, T);
+  if (new_array == NULL)
+  {
+    return false;
+  }
+  array= new_array;
+  size= new_size;
+
+  return true;
+}
+
+static memcached_udp_st *udp_state(memcached_st& self)
+{
+  if (self.udp == NULL)
+  {
+    memcached_udp_st *state= libmemcached_xcalloc(&self, 1, memcached_udp_st);
+    if (state == NULL)
+    {
+      return NULL;
+    }
+    state->timeout= MEMCACHED_DEFAULT_UDP_READ_TIMEOUT;
+    self.udp= state;
+  }
+
+  return self.udp;
+}
+
+memcached_return_t memcached_udp_set_timeout(memcached_st& self, uint64_t timeout)
+{
+  if (timeout > INT32_MAX)
+  {
+    return memcached_set_error(self, MEMCACHED_INVALID_ARGUMENTS, MEMCACHED_AT,
+                               memcached_literal_param("MEMCACHED_BEHAVIOR_UDP_READ_TIMEOUT is limited to INT32_MAX milliseconds."));
+  }
+
+  memcached_udp_st *state= udp_state(self);
+  if (state == NULL)
+  {
+    return memcached_set_error(self, MEMCACHED_MEMORY_ALLOCATION_FAILURE, MEMCACHED_AT);
+  }
+  state->timeout= uint32_t(timeout);
+
+  return MEMCACHED_SUCCESS;
+}
+
+uint32_t memcached_udp_get_timeout(const memcached_st& self)
+{
+  return self.udp ? self.udp->timeout : MEMCACHED_DEFAULT_UDP_READ_TIMEOUT;
+}
+
+memcached_return_t memcached_udp_clone(memcached_st *destination, const memcached_st *source)
+{
+  if (source->udp == NULL)
+  {
+    return MEMCACHED_SUCCESS;
+  }
+
+  return memcached_udp_set_timeout(*destination, source->udp->timeout);
+}
+
+void memcached_udp_free(memcached_st *ptr)
+{
+  memcached_udp_st *state= ptr->udp;
+  if (state == NULL)
+  {
+    return;
+  }
+
+  if (state->tcp)
+  {
+    memcached_free(state->tcp);
+  }
+  libmemcached_free(ptr, state->requests);
+  libmemcached_free(ptr, state->keys);
+  libmemcached_free(ptr, state->servers);
+  libmemcached_free(ptr, state->slots);
+  libmemcached_free(ptr, state->datagrams);
+  libmemcached_free(ptr, state->payload);
+  libmemcached_free(ptr, state->response);
+  libmemcached_free(ptr, state->items);
+  libmemcached_free(ptr, state->receive);
+  libmemcached_free(ptr, state->fds);
+  libmemcached_free(ptr, state->fd_servers);
+  libmemcached_free(ptr, state);
+  ptr->udp= NULL;
+}
+
+/*
+  Send the requests of one server, first up to last, which all sit next
+  to each other in requests.
+*/
+static void udp_send(memcached_st& self, memcached_udp_st& state, size_t first, size_t last)
+{
+  memcached_server_write_instance_st instance= memcached_server_instance_fetch(&self, state.requests[first].server_key);
+
+  while (first < last and state.requests[first].is_failed == false)
+  {
+#if defined(TARGET_OS_LINUX) && defined(MSG_WAITFORONE)
+    struct mmsghdr messages[UDP_DATAGRAM_BATCH];
+    struct iovec vectors[UDP_DATAGRAM_BATCH];
+    unsigned int count= 0;
+    for (; count < UDP_DATAGRAM_BATCH and first +count < last and state.requests[first +count].is_failed == false; count++)
+    {
+      vectors[count].iov_base= state.payload +state.requests[first +count].command;
+      vectors[count].iov_len= state.requests[first +count].command_length;
+      memset(&messages[count], 0, sizeof(messages[count]));
+      messages[count].msg_hdr.msg_iov= &vectors[count];
+      messages[count].msg_hdr.msg_iovlen= 1;
+    }
+    int sent= sendmmsg(instance->fd, messages, count, 0);
+#else
+    int sent= 1;
+    if (::send(instance->fd, state.payload +state.requests[first].command, state.requests[first].command_length, 0) < 0)
+    {
+      sent= -1;
+    }
+#endif
+
+    if (sent < 0 and errno == EINTR)
+    {
+      continue;
+    }
+
+    if (sent <= 0)
+    {
+      memcached_set_errno(*instance, errno, MEMCACHED_AT);
+      for (; first < last; first++)
+      {
+        state.requests[first].is_failed= true;
+      }
+      return;
+    }
+    first+= size_t(sent);
+  }
+}
+
+// Numbers that do not fit in 64 bits make the line malformed, rather than
+// wrapping into a length the bounds checks would take at face value.
+static bool udp_number(const char *&ptr, const char *end, uint64_t& number)
+{
+  const char *start= ptr;
+  for (number= 0; ptr < end and isdigit(*ptr); ptr++)
+  {
+    uint64_t digit= uint64_t(*ptr - '0');
+    if (number > (UINT64_MAX - digit) / 10)
+    {
+      return false;
+    }
+    number= number * 10 + digit;
+  }
+
+  return ptr != start;
+}
+
+/*
+  Put the answer to request back together and index the values in it.
+  Anything other than VALUE lines followed by END sends the request again
+  over TCP.
+*/
+static bool udp_parse(memcached_st& self, memcached_udp_st& state, const memcached_udp_request_st& request)
+{
+  size_t start= state.response_length;
+  size_t number_of_items= state.number_of_items;
+
+  size_t length= 0;
+  for (size_t x= 0; x < request.number_of_datagrams; x++)
+  {
+    length+= state.datagrams[(state.slots[request.slots +x] -1) * 2 +1];
+  }
+
+  if (udp_reserve(self, state.response, state.response_size, start +length) == false)
+  {
+    return false;
+  }
+
+  for (size_t x= 0; x < request.number_of_datagrams; x++)
+  {
+    size_t datagram= state.slots[request.slots +x] -1;
+    memcpy(state.response +state.response_length, state.payload +state.datagrams[datagram * 2], state.datagrams[datagram * 2 +1]);
+    state.response_length+= state.datagrams[datagram * 2 +1];
+  }
+
+  size_t namespace_length= memcached_array_size(self._namespace);
+  const char *ptr= state.response +start;
+  const char *end= state.response +state.response_length;
+  while (ptr < end)
+  {
+    const char *eol= static_cast<const char *>(memchr(ptr, '\n', size_t(end -ptr)));
+    if (eol == NULL or eol == ptr or eol[-1] != '\r')
+    {
+      break;
+    }
+    const char *line_end= eol -1;
+
+    if (line_end -ptr == 3 and memcmp(ptr, "END", 3) == 0)
+    {
+      if (eol +1 == end)
+      {
+        return true;
+      }
+      break;
+    }
+
+    if (line_end -ptr < 6 or memcmp(ptr, "VALUE ", 6) != 0)
+    {
+      break;
+    }
+    ptr+= 6;
+
+    const char *key= ptr;
+    while (ptr < line_end and *ptr != ' ')
+    {
+      ptr++;
+    }
+    size_t key_length= size_t(ptr -key);
+    if (key_length <= namespace_length or key_length -namespace_length >= MEMCACHED_MAX_KEY)
+    {
+      break;
+    }
+
+    uint64_t flags, value_length, cas= 0;
+    if (ptr == line_end or *ptr++ != ' ' or udp_number(ptr, line_end, flags) == false or flags > UINT32_MAX
+        or ptr == line_end or *ptr++ != ' ' or udp_number(ptr, line_end, value_length) == false)
+    {
+      break;
+    }
+
+    if (ptr < line_end and (*ptr++ != ' ' or udp_number(ptr, line_end, cas) == false))
+    {
+      break;
+    }
+
+    size_t remaining= size_t(end -(eol +1));
+    if (ptr != line_end or remaining < 2 or value_length > remaining -2)
+    {
+      break;
+    }
+
+    const char *value= eol +1;
+    if (value[value_length] != '\r' or value[value_length +1] != '\n')
+    {
+      break;
+    }
+
+    if (udp_reserve(self, state.items, state.items_size, state.number_of_items +1) == false)
+    {
+      break;
+    }
+
+    memcached_udp_item_st& item= state.items[state.number_of_items++];
+    item.server_key= request.server_key;
+    item.flags= uint32_t(flags);
+    item.cas= cas;
+    item.key= size_t(key -state.response) +namespace_length;
+    item.key_length= key_length -namespace_length;
+    item.value= size_t(value -state.response);
+    item.value_length= size_t(value_length);
+
+    ptr= value +value_length +2;
+  }
+
+  state.response_length= start;
+  state.number_of_items= number_of_items;
+
+  return false;
+}
+
+static void udp_datagram(memcached_st& self, memcached_udp_st& state, uint32_t server_key,
+                         const char *datagram, size_t length)
+{
+  if (length < UDP_DATAGRAM_HEADER_LENGTH)
+  {
+    return;
+  }
+
+  struct udp_datagram_header_st header;
+  memcpy(&header, datagram, sizeof(header));
+  uint16_t request_id= get_udp_datagram_request_id(&header);
+  uint16_t sequence_number= get_udp_datagram_seq_num(&header);
+  uint16_t number_of_datagrams= get_udp_datagram_num_datagrams(&header);
+
+  memcached_udp_request_st *request= NULL;
+  for (size_t x= 0; x < state.number_of_requests; x++)
+  {
+    if (state.requests[x].server_key == server_key and state.requests[x].request_id == request_id
+        and state.requests[x].is_done == false and state.requests[x].is_failed == false)
+    {
+      request= &state.requests[x];
+      break;
+    }
+  }
+
+  // A late answer to an earlier get
+  if (request == NULL)
+  {
+    return;
+  }
+
+  if (number_of_datagrams == 0 or sequence_number >= number_of_datagrams
+      or (request->number_of_datagrams and request->number_of_datagrams != number_of_datagrams))
+  {
+    request->is_failed= true;
+    return;
+  }
+
+  if (request->number_of_datagrams == 0)
+  {
+    if (udp_reserve(self, state.slots, state.slots_size, state.number_of_slots +number_of_datagrams) == false)
+    {
+      request->is_failed= true;
+      return;
+    }
+    memset(state.slots +state.number_of_slots, 0, sizeof(uint32_t) * number_of_datagrams);
+    request->slots= state.number_of_slots;
+    request->number_of_datagrams= number_of_datagrams;
+    state.number_of_slots+= number_of_datagrams;
+  }
+
+  // Sent twice
+  if (state.slots[request->slots +sequence_number])
+  {
+    return;
+  }
+
+  length-= UDP_DATAGRAM_HEADER_LENGTH;
+  if (udp_reserve(self, state.payload, state.payload_size, state.payload_length +length) == false
+      or udp_reserve(self, state.datagrams, state.datagrams_size, (state.number_of_datagrams +1) * 2) == false)
+  {
+    request->is_failed= true;
+    return;
+  }
+
+  memcpy(state.payload +state.payload_length, datagram +UDP_DATAGRAM_HEADER_LENGTH, length);
+  state.datagrams[state.number_of_datagrams * 2]= state.payload_length;
+  state.datagrams[state.number_of_datagrams * 2 +1]= length;
+  state.payload_length+= length;
+  state.slots[request->slots +sequence_number]= uint32_t(++state.number_of_datagrams);
+
+  if (++request->received == request->number_of_datagrams)
+  {
+    request->is_done= true;
+    request->is_failed= udp_parse(self, state, *request) == false;
+  }
+}
+
+/*
+  Read what has arrived from one server. A datagram that did not fit is
+  passed on with a length of 0.
+*/
+static int udp_receive(int fd, char *buffer, size_t *lengths)
+{
+#if defined(TARGET_OS_LINUX) && defined(MSG_WAITFORONE)
+  struct mmsghdr messages[UDP_DATAGRAM_BATCH];
+  struct iovec vectors[UDP_DATAGRAM_BATCH];
+  for (size_t x= 0; x < UDP_DATAGRAM_BATCH; x++)
+  {
+    vectors[x].iov_base= buffer +x * MAX_UDP_DATAGRAM_LENGTH;
+    vectors[x].iov_len= MAX_UDP_DATAGRAM_LENGTH;
+    memset(&messages[x], 0, sizeof(messages[x]));
+    messages[x].msg_hdr.msg_iov= &vectors[x];
+    messages[x].msg_hdr.msg_iovlen= 1;
+  }
+
+  int received= recvmmsg(fd, messages, UDP_DATAGRAM_BATCH, MSG_DONTWAIT, NULL);
+  for (int x= 0; x < received; x++)
+  {
+    lengths[x]= (messages[x].msg_hdr.msg_flags & MSG_TRUNC) ? 0 : messages[x].msg_len;
+  }
+
+  return received;
+#else
+  int received= 0;
+  while (received < UDP_DATAGRAM_BATCH)
+  {
+    ssize_t length= ::recv(fd, buffer +received * MAX_UDP_DATAGRAM_LENGTH, MAX_UDP_DATAGRAM_LENGTH, MSG_DONTWAIT | MSG_TRUNC);
+    if (length < 0)
+    {
+      return received ? received : -1;
+    }
+    lengths[received++]= size_t(length) > MAX_UDP_DATAGRAM_LENGTH ? 0 : size_t(length);
+  }
+
+  return received;
+#endif
+}
+
+static void udp_read(memcached_st& self, memcached_udp_st& state, uint32_t server_key)
+{
+  memcached_server_write_instance_st instance= memcached_server_instance_fetch(&self, server_key);
+
+  size_t lengths[UDP_DATAGRAM_BATCH];
+  int received= udp_receive(instance->fd, state.receive, lengths);
+  if (received < 0)
+  {
+    if (errno == EAGAIN or errno == EWOULDBLOCK or errno == EINTR)
+    {
+      return;
+    }
+
+    // Most likely an ICMP port unreachable, nothing more is coming from this server
+    memcached_set_errno(*instance, errno, MEMCACHED_AT);
+    for (size_t x= 0; x < state.number_of_requests; x++)
+    {
+      if (state.requests[x].server_key == server_key and state.requests[x].is_done == false)
+      {
+        state.requests[x].is_failed= true;
+      }
+    }
+    return;
+  }
+
+  for (int x= 0; x < received; x++)
+  {
+    udp_datagram(self, state, server_key, state.receive +x * MAX_UDP_DATAGRAM_LENGTH, lengths[x]);
+  }
+}
+
+static void udp_wait(memcached_st& self, memcached_udp_st& state)
+{
+  uint32_t number_of_servers= memcached_server_count(&self);
+  if (state.receive == NULL)
+  {
+    state.receive= libmemcached_xvalloc(&self, UDP_DATAGRAM_BATCH * MAX_UDP_DATAGRAM_LENGTH, char);
+  }
+
+  if (state.receive == NULL)
+  {
+    memcached_set_error(self, MEMCACHED_MEMORY_ALLOCATION_FAILURE, MEMCACHED_AT);
+    return;
+  }
+
+  if (state.fds_size < number_of_servers)
+  {
+    struct pollfd *fds= libmemcached_xrealloc(&self, state.fds, number_of_servers, struct pollfd);
+    if (fds)
+    {
+      state.fds= fds;
+    }
+
+    uint32_t *fd_servers= libmemcached_xrealloc(&self, state.fd_servers, number_of_servers, uint32_t);
+    if (fd_servers)
+    {
+      state.fd_servers= fd_servers;
+    }
+
+    if (fds == NULL or fd_servers == NULL)
+    {
+      memcached_set_error(self, MEMCACHED_MEMORY_ALLOCATION_FAILURE, MEMCACHED_AT);
+      return;
+    }
+    state.fds_size= number_of_servers;
+  }
+
+  uint64_t deadline= memcached_telemetry_now() +uint64_t(state.timeout) * 1000;
+  while (true)
+  {
+    nfds_t number_of_fds= 0;
+    for (size_t x= 0; x < state.number_of_requests; x++)
+    {
+      const memcached_udp_request_st& request= state.requests[x];
+      if (request.is_done or request.is_failed)
+      {
+        continue;
+      }
+
+      if (number_of_fds == 0 or state.fd_servers[number_of_fds -1] != request.server_key)
+      {
+        state.fds[number_of_fds].fd= memcached_server_instance_fetch(&self, request.server_key)->fd;
+        state.fds[number_of_fds].events= POLLIN;
+        state.fds[number_of_fds].revents= 0;
+        state.fd_servers[number_of_fds++]= request.server_key;
+      }
+    }
+
+    uint64_t now= memcached_telemetry_now();
+    if (number_of_fds == 0 or now >= deadline)
+    {
+      return;
+    }
+
+    int active_fd= poll(state.fds, number_of_fds, int((deadline -now +999) / 1000));
+    if (active_fd < 0 and errno == EINTR)
+    {
+      continue;
+    }
+
+    if (active_fd <= 0)
+    {
+      return;
+    }
+
+    for (nfds_t x= 0; x < number_of_fds; x++)
+    {
+      if (state.fds[x].revents)
+      {
+        udp_read(self, state, state.fd_servers[x]);
+      }
+    }
+  }
+}
+
+/*
+  Ask for the keys of the requests that failed over TCP, the values are
+  handed out by memcached_udp_fetch() after those that came over UDP.
+*/
+static memcached_return_t udp_fallback(memcached_st& self, memcached_udp_st& state,
+                                       const char *group_key, size_t group_key_length,
+                                       const char * const *keys, const size_t *key_length,
+                                       size_t number_of_keys)
+{
+  if (state.tcp and memcached_server_count(state.tcp) != memcached_server_count(&self))
+  {
+    memcached_free(state.tcp);
+    state.tcp= NULL;
+  }
+
+  if (state.tcp == NULL)
+  {
+    memcached_st *tcp= memcached_clone(NULL, &self);
+    if (tcp == NULL)
+    {
+      return memcached_set_error(self, MEMCACHED_MEMORY_ALLOCATION_FAILURE, MEMCACHED_AT);
+    }
+
+    (void)memcached_behavior_set(tcp, MEMCACHED_BEHAVIOR_USE_UDP, false);
+    (void)memcached_behavior_set(tcp, MEMCACHED_BEHAVIOR_MGET_DEDUPE, false);
+    state.tcp= tcp;
+  }
+
+  const char **lost_keys= libmemcached_xvalloc(&self, number_of_keys, const char *);
+  size_t *lost_key_length= libmemcached_xvalloc(&self, number_of_keys, size_t);
+  if (lost_keys == NULL or lost_key_length == NULL)
+  {
+    libmemcached_free(&self, lost_keys);
+    libmemcached_free(&self, lost_key_length);
+    return memcached_set_error(self, MEMCACHED_MEMORY_ALLOCATION_FAILURE, MEMCACHED_AT);
+  }
+
+  size_t number_of_lost_keys= 0;
+  for (size_t x= 0; x < state.number_of_requests; x++)
+  {
+    const memcached_udp_request_st& request= state.requests[x];
+    if (request.is_done and request.is_failed == false)
+    {
+      continue;
+    }
+
+    for (size_t y= request.first_key; y < request.first_key +request.number_of_keys; y++)
+    {
+      lost_keys[number_of_lost_keys]= keys[state.keys[y]];
+      lost_key_length[number_of_lost_keys++]= key_length[state.keys[y]];
+    }
+  }
+
+  memcached_return_t rc= memcached_mget_by_key(state.tcp, group_key, group_key_length,
+                                               lost_keys, lost_key_length, number_of_lost_keys);
+  libmemcached_free(&self, lost_keys);
+  libmemcached_free(&self, lost_key_length);
+
+  if (rc == MEMCACHED_SUCCESS or rc == MEMCACHED_SOME_ERRORS)
+  {
+    state.is_tcp_fetching= true;
+  }
+
+  if (rc != MEMCACHED_SUCCESS)
+  {
+    return memcached_set_error(self, rc, MEMCACHED_AT,
+                               memcached_literal_param("Keys lost over UDP could not be sent again over TCP"));
+  }
+
+  return MEMCACHED_SUCCESS;
+}
+
+memcached_return_t memcached_udp_mget(memcached_st& self,
+                                      const char *group_key,
+                                      size_t group_key_length,
+                                      const char * const *keys,
+                                      const size_t *key_length,
+                                      size_t number_of_keys)
+{
+  memcached_udp_st *state= udp_state(self);
+  if (state == NULL)
+  {
+    return memcached_set_error(self, MEMCACHED_MEMORY_ALLOCATION_FAILURE, MEMCACHED_AT);
+  }
+  state->number_of_requests= 0;
+  state->number_of_slots= 0;
+  state->number_of_datagrams= 0;
+  state->payload_length= 0;
+  state->response_length= 0;
+  state->number_of_items= 0;
+  state->cursor= 0;
+  state->is_tcp_fetching= false;
+
+  uint32_t number_of_servers= memcached_server_count(&self);
+  if (udp_reserve(self, state->keys, state->keys_size, number_of_keys) == false
+      or udp_reserve(self, state->servers, state->servers_size, number_of_keys +number_of_servers +1) == false)
+  {
+    return memcached_set_error(self, MEMCACHED_MEMORY_ALLOCATION_FAILURE, MEMCACHED_AT);
+  }
+
+  // Group the keys by server, afterwards count[x] is where the keys of server x end
+  uint32_t master_server_key= 0;
+  if (group_key and group_key_length)
+  {
+    master_server_key= memcached_generate_hash_with_redistribution(&self, group_key, group_key_length);
+  }
+
+  uint32_t *count= state->servers +number_of_keys;
+  memset(count, 0, sizeof(uint32_t) * (number_of_servers +1));
+  for (size_t x= 0; x < number_of_keys; x++)
+  {
+    uint32_t server_key= master_server_key;
+    if (group_key == NULL or group_key_length == 0)
+    {
+      server_key= memcached_generate_hash_with_redistribution(&self, keys[x], key_length[x]);
+    }
+    state->servers[x]= server_key;
+    count[server_key +1]++;
+  }
+
+  for (uint32_t x= 0; x < number_of_servers; x++)
+  {
+    count[x +1]+= count[x];
+  }
+
+  for (size_t x= 0; x < number_of_keys; x++)
+  {
+    state->keys[count[state->servers[x]]++]= uint32_t(x);
+  }
+
+  const char *command= self.flags.support_cas ? "gets" : "get";
+  size_t command_length= self.flags.support_cas ? 4 : 3;
+  size_t namespace_length= memcached_array_size(self._namespace);
+
+  size_t position= 0;
+  for (uint32_t server_key= 0; server_key < number_of_servers; server_key++)
+  {
+    if (position == count[server_key])
+    {
+      continue;
+    }
+
+    memcached_server_write_instance_st instance= memcached_server_instance_fetch(&self, server_key);
+    bool is_connected= memcached_success(memcached_connect(instance));
+
+    for (size_t requests= 0; position < count[server_key]; requests++)
+    {
+      if (udp_reserve(self, state->requests, state->requests_size, state->number_of_requests +1) == false
+          or udp_reserve(self, state->payload, state->payload_size, state->payload_length +MAX_UDP_DATAGRAM_LENGTH) == false)
+      {
+        return memcached_set_error(self, MEMCACHED_MEMORY_ALLOCATION_FAILURE, MEMCACHED_AT);
+      }
+
+      memcached_udp_request_st& request= state->requests[state->number_of_requests++];
+      memset(&request, 0, sizeof(request));
+      request.server_key= server_key;
+      request.first_key= position;
+
+      // The rest of the keys go over TCP
+      if (is_connected == false or requests == UDP_MAX_REQUESTS_PER_SERVER)
+      {
+        request.is_failed= true;
+        request.number_of_keys= count[server_key] -position;
+        position= count[server_key];
+        break;
+      }
+
+      increment_udp_message_id(instance);
+      struct udp_datagram_header_st header;
+      memcpy(&header, instance->write_buffer, sizeof(header));
+      request.request_id= get_udp_datagram_request_id(&header);
+      header.sequence_number= htons(0);
+      header.num_datagrams= htons(1);
+      header.reserved= 0;
+
+      char *datagram= state->payload +state->payload_length;
+      memcpy(datagram, &header, sizeof(header));
+      size_t length= UDP_DATAGRAM_HEADER_LENGTH;
+      memcpy(datagram +length, command, command_length);
+      length+= command_length;
+
+      while (position < count[server_key])
+      {
+        uint32_t key= state->keys[position];
+        if (length +1 +namespace_length +key_length[key] +2 > MAX_UDP_DATAGRAM_LENGTH)
+        {
+          break;
+        }
+
+        datagram[length++]= ' ';
+        memcpy(datagram +length, memcached_array_string(self._namespace), namespace_length);
+        length+= namespace_length;
+        memcpy(datagram +length, keys[key], key_length[key]);
+        length+= key_length[key];
+        position++;
+      }
+      memcpy(datagram +length, "\r\n", 2);
+      length+= 2;
+
+      request.command= state->payload_length;
+      request.command_length= length;
+      request.number_of_keys= position -request.first_key;
+      state->payload_length+= length;
+    }
+  }
+
+  for (size_t x= 0, last; x < state->number_of_requests; x= last)
+  {
+    for (last= x +1; last < state->number_of_requests and state->requests[last].server_key == state->requests[x].server_key; last++) {};
+    udp_send(self, *state, x, last);
+  }
+
+  // Everything has been sent, the answers are kept in payload from here on
+  state->payload_length= 0;
+  udp_wait(self, *state);
+
+  size_t number_of_lost_keys= 0;
+  for (size_t x= 0; x < state->number_of_requests; x++)
+  {
+    if (state->requests[x].is_done == false or state->requests[x].is_failed)
+    {
+      number_of_lost_keys+= state->requests[x].number_of_keys;
+    }
+  }
+
+  if (number_of_lost_keys)
+  {
+    return udp_fallback(self, *state, group_key, group_key_length, keys, key_length, number_of_lost_keys);
+  }
+
+  return MEMCACHED_SUCCESS;
+}
+
+static memcached_return_t udp_result(memcached_result_st& result,
+                                     const char *key, size_t key_length,
+                                     const char *value, size_t value_length,
+                                     uint32_t flags, uint64_t cas)
+{
+  memcached_result_reset(&result);
+  if (memcached_failed(memcached_string_append(&result.value, value, value_length)))
+  {
+    return MEMCACHED_MEMORY_ALLOCATION_FAILURE;
+  }
+
+  memcpy(result.item_key, key, key_length);
+  result.item_key[key_length]= 0;
+  result.key_length= key_length;
+  result.item_flags= flags;
+  result.item_cas= cas;
+
+  return MEMCACHED_SUCCESS;
+}
+
+memcached_return_t memcached_udp_fetch(memcached_st& self, memcached_result_st& result)
+{
+  memcached_udp_st *state= self.udp;
+  if (state == NULL)
+  {
+    return MEMCACHED_END;
+  }
+
+  memcached_return_t rc;
+  if (state->cursor < state->number_of_items)
+  {
+    const memcached_udp_item_st& item= state->items[state->cursor++];
+    if (memcached_failed(rc= udp_result(result, state->response +item.key, item.key_length,
+                                        state->response +item.value, item.value_length,
+                                        item.flags, item.cas)))
+    {
+      return memcached_set_error(self, rc, MEMCACHED_AT);
+    }
+
+    memcached_server_write_instance_st instance= memcached_server_instance_fetch(&self, item.server_key);
+    return memcached_response_decode(instance, result);
+  }
+
+  if (state->is_tcp_fetching)
+  {
+    // Values were decoded by the fetch from the TCP connection
+    memcached_result_st *tcp_result= memcached_fetch_result(state->tcp, &state->tcp->result, &rc);
+    if (tcp_result)
+    {
+      if (memcached_failed(rc= udp_result(result, tcp_result->item_key, tcp_result->key_length,
+                                          memcached_result_value(tcp_result), memcached_result_length(tcp_result),
+                                          tcp_result->item_flags, tcp_result->item_cas)))
+      {
+        return memcached_set_error(self, rc, MEMCACHED_AT);
+      }
+
+      return MEMCACHED_SUCCESS;
+    }
+
+    if (rc != MEMCACHED_END and rc != MEMCACHED_NOTFOUND)
+    {
+      return memcached_set_error(self, rc, MEMCACHED_AT);
+    }
+    state->is_tcp_fetching= false;
+  }
+
+  return MEMCACHED_END;
+}
@@ -37,6 +37,7 @@
 
 #define MAX_UDP_DATAGRAM_LENGTH 1400
 #define UDP_DATAGRAM_HEADER_LENGTH 8
+#define UDP_DATAGRAM_MAX_VECTOR 32
 #define UDP_REQUEST_ID_MSG_SIG_DIGITS 10
 #define UDP_REQUEST_ID_THREAD_MASK 0xFFFF << UDP_REQUEST_ID_MSG_SIG_DIGITS
 #define get_udp_datagram_request_id(A) ntohs((A)->request_id)
@@ -57,3 +58,71 @@ struct udp_datagram_header_st
 
 bool memcached_io_init_udp_header(memcached_server_write_instance_st ptr, const uint16_t thread_id);
 void increment_udp_message_id(memcached_server_write_instance_st ptr);
+
+struct memcached_udp_request_st;
+struct memcached_udp_item_st;
+
+/*
+  Gets sent over UDP. A request is one datagram, the answer to it may take
+  any number of datagrams which are put back together by their sequence
+  number. Requests that do not get all of their answer back before the
+  timeout are sent again over TCP.
+*/
+struct memcached_udp_st
+{
+  uint32_t timeout; // Milliseconds to wait on the datagrams of a get
+  struct memcached_udp_request_st *requests;
+  size_t number_of_requests;
+  size_t requests_size;
+  uint32_t *keys; // Key positions grouped by server, the requests point into it
+  size_t keys_size;
+  uint32_t *servers; // Server of each key, then the per server counts
+  size_t servers_size;
+  uint32_t *slots; // Datagram that arrived for each sequence number, plus one
+  size_t number_of_slots;
+  size_t slots_size;
+  size_t *datagrams; // Offset and length of each datagram that has arrived
+  size_t number_of_datagrams;
+  size_t datagrams_size;
+  char *payload; // Requests on the way out, answers on the way in
+  size_t payload_length;
+  size_t payload_size;
+  char *response; // Answers put back together
+  size_t response_length;
+  size_t response_size;
+  struct memcached_udp_item_st *items;
+  size_t number_of_items;
+  size_t items_size;
+  size_t cursor; // Next item memcached_fetch_result() returns
+  char *receive; // Room for a batch of datagrams
+  struct pollfd *fds;
+  uint32_t *fd_servers;
+  size_t fds_size;
+  memcached_st *tcp; // Sends again what was lost, made the first time it is needed
+  bool is_tcp_fetching;
+};
+
+memcached_return_t memcached_udp_set_timeout(memcached_st& self, uint64_t timeout);
+
+uint32_t memcached_udp_get_timeout(const memcached_st& self);
+
+memcached_return_t memcached_udp_clone(memcached_st *destination, const memcached_st *source);
+
+void memcached_udp_free(memcached_st *ptr);
+
+/*
+  Send the gets, and wait for the answers. Keys whose answer did not make
+  it back are asked for again over TCP.
+*/
+memcached_return_t memcached_udp_mget(memcached_st& self,
+                                      const char *group_key,
+                                      size_t group_key_length,
+                                      const char * const *keys,
+                                      const size_t *key_length,
+                                      size_t number_of_keys);
+
+/*
+  The next value of the last memcached_udp_mget(), MEMCACHED_END once
+  they have all been returned.
+*/
+memcached_return_t memcached_udp_fetch(memcached_st& self, memcached_result_st& result);
@@ -28,6 +28,49 @@ typedef protocol_binary_response_status
                                                   uint32_t bodylen,
                                                   uint32_t flags,
                                                   uint64_t cas);
+/**
+ * One of the keys in a batch of gets
+ */
+typedef struct {
+   const void *key;
+   uint16_t keylen;
+} memcached_binary_protocol_batch_get_st;
+
+/**
+ * One of the items in a batch of sets. The storage engine fills in the
+ * status and result_cas of each item.
+ */
+typedef struct {
+   const void *key;
+   uint16_t keylen;
+   const void *val;
+   uint32_t vallen;
+   uint32_t flags;
+   uint32_t exptime;
+   uint64_t cas;
+   protocol_binary_response_status status;
+   uint64_t result_cas;
+} memcached_binary_protocol_batch_set_st;
+
+/**
+ * Callback to send data back for one of the keys in a batch of gets.
+ * The keys must be answered in the order they appear in the batch.
+ *
+ * @param cookie Just pass along the cookie supplied in the callback
+ * @param index The position of the key in the batch
+ * @param body What to store in the body of the package
+ * @param bodylen The number of bytes of the body
+ * @param flags The flags stored with the item
+ * @param cas The CAS value to insert into the response
+ */
+typedef protocol_binary_response_status
+(*memcached_binary_protocol_batch_get_response_handler)(const void *cookie,
+                                                        uint32_t index,
+                                                        const void *body,
+                                                        uint32_t bodylen,
+                                                        uint32_t flags,
+                                                        uint64_t cas);
+
 /**
  * Callback to send data back from a STAT command
  *
@@ -338,6 +381,94 @@ typedef struct {
                                               memcached_binary_protocol_version_response_handler response_handler);
 } memcached_binary_protocol_callback_v1_st;
 
+/**
+ * The second version of the callback struct is the first one followed by
+ * callbacks that take runs of commands in one go, and callbacks for
+ * configuration entries. All of them are optional.
+ */
+typedef struct {
+   /**
+    * The callbacks of version 1. They come first, so they are the same
+    * as interface.v1 and can be set through either.
+    */
+   memcached_binary_protocol_callback_v1_st v1;
+
+   /**
+    * Get a run of keys that arrived back to back (optional). If set, this
+    * is used instead of get for consecutive gets of the binary protocol
+    * and for the keys of an ASCII get, and the responses are built in
+    * one go. The pre_execute and post_execute callbacks are called once
+    * for the whole batch, with a NULL header.
+    *
+    * @param cookie id of the client receiving the command
+    * @param keys the keys to get
+    * @param nkeys the number of keys
+    * @param response_handler to send the result for each key that was
+    *                         found back to the client, in order. Keys
+    *                         left out are reported as not found.
+    * @return PROTOCOL_BINARY_RESPONSE_SUCCESS, or the status to report
+    *         for all of the keys that weren't answered
+    */
+   protocol_binary_response_status (*get_batch)(const void *cookie,
+                                                const memcached_binary_protocol_batch_get_st *keys,
+                                                uint32_t nkeys,
+                                                memcached_binary_protocol_batch_get_response_handler response_handler);
+
+   /**
+    * Store a run of items that arrived back to back in SET and SETQ
+    * commands (optional). If set, this is used instead of set for them.
+    * The pre_execute and post_execute callbacks are called once for
+    * the whole batch, with a NULL header.
+    *
+    * @param cookie id of the client receiving the command
+    * @param items the items to store, fill in the status and result_cas
+    *              of each of them
+    * @param nitems the number of items
+    * @return PROTOCOL_BINARY_RESPONSE_SUCCESS, or the status to report
+    *         for all of the items
+    */
+   protocol_binary_response_status (*set_batch)(const void *cookie,
+                                                memcached_binary_protocol_batch_set_st *items,
+                                                uint32_t nitems);
+
+   /**
+    * Get a configuration entry with "config get <key>" or one of the
+    * CONFIG_GET commands (optional). ElastiCache publishes the nodes of a
+    * cluster this way in the "cluster" entry, which is what the auto
+    * discovery in libmemcached polls for.
+    *
+    * @param cookie id of the client receiving the command
+    * @param key the name of the entry
+    * @param keylen the length of the name
+    * @param response_handler to send the entry back to the client (the
+    *                         body may be referenced, like for get)
+    * @return PROTOCOL_BINARY_RESPONSE_SUCCESS, or
+    *         PROTOCOL_BINARY_RESPONSE_KEY_ENOENT if there is no such entry
+    */
+   protocol_binary_response_status (*config_get)(const void *cookie,
+                                                 const void *key,
+                                                 uint16_t keylen,
+                                                 memcached_binary_protocol_get_response_handler response_handler);
+
+   /**
+    * Publish a new version of a configuration entry with "config set <key>"
+    * or one of the CONFIG_SET commands (optional).
+    *
+    * @param cookie id of the client receiving the command
+    * @param key the name of the entry
+    * @param keylen the length of the name
+    * @param val the new content of the entry
+    * @param vallen the length of the content
+    * @param flags the flags to store with the entry
+    */
+   protocol_binary_response_status (*config_set)(const void *cookie,
+                                                 const void *key,
+                                                 uint16_t keylen,
+                                                 const void *val,
+                                                 uint32_t vallen,
+                                                 uint32_t flags);
+} memcached_binary_protocol_callback_v2_st;
+
 
 /**
  * The version numbers for the different callback structures.
@@ -349,7 +480,12 @@ typedef enum {
     * Version 1 abstracts more of the protocol details, and let you work at
     * a logical level
     */
-   MEMCACHED_PROTOCOL_HANDLER_V1= 1
+   MEMCACHED_PROTOCOL_HANDLER_V1= 1,
+   /**
+    * Version 2 is version 1 with callbacks for batches of commands and
+    * for configuration entries
+    */
+   MEMCACHED_PROTOCOL_HANDLER_V2= 2
 } memcached_protocol_interface_version_t;
 
 /**
@@ -412,5 +548,11 @@ typedef struct {
        * (aka. memcached 1.4.0).
        */
       memcached_binary_protocol_callback_v1_st v1;
+
+      /**
+       * Version 1 followed by the callbacks for batches of commands and
+       * for configuration entries.
+       */
+      memcached_binary_protocol_callback_v2_st v2;
    } interface;
 } memcached_binary_protocol_callback_st;
@@ -68,6 +68,17 @@ typedef ssize_t (*memcached_protocol_send_func)(const void *cookie,
                                                 const void *buf,
                                                 size_t nbuf);
 
+/**
+ * Function the protocol handler calls when it no longer needs memory
+ * it was allowed to reference instead of copying
+ * (see memcached_protocol_client_reference_body)
+ *
+ * @param cookie a cookie used to represent a given client
+ * @param context the context passed along with the reference
+ */
+typedef void (*memcached_protocol_release_func)(const void *cookie,
+                                                void *context);
+
 /**
  * Create an instance of the protocol handler
  *
@@ -213,6 +224,24 @@ int memcached_protocol_client_get_errno(memcached_protocol_client_st *client);
 LIBMEMCACHED_API
 memcached_binary_protocol_raw_response_handler memcached_binary_protocol_get_raw_response_handler(const void *cookie);
 
+/**
+ * Let the protocol handler send the body passed to the next call of the
+ * get response handler straight from your memory instead of copying it
+ * into its output buffers. Call this from the get callback right before
+ * you call the response handler. The memory must stay valid until release
+ * is called, which happens exactly once: when the data is sent, when the
+ * client is destroyed, or when the get callback returns without sending
+ * the body. Small bodies are copied and released right away.
+ *
+ * @param cookie the cookie passed along into the get callback
+ * @param release the function to call when the memory is no longer used
+ * @param context passed along to release
+ */
+LIBMEMCACHED_API
+void memcached_protocol_client_reference_body(const void *cookie,
+                                              memcached_protocol_release_func release,
+                                              void *context);
+
 #ifdef __cplusplus
 }
 #endif
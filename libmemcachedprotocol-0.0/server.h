@@ -0,0 +1,98 @@
+/* LibMemcached
+ * Copyright (C) 2012 Data Differential, http://datadifferential.com/
+ * All rights reserved.
+ *
+ * Use and distribution licensed under the BSD license.  See
+ * the COPYING file in the parent directory for full text.
+ *
+ * Summary: A multithreaded server runtime for the protocol handler
+ *
+ */
+
+#pragma once
+
+#include <libmemcachedprotocol-0.0/handler.h>
+
+/*
+ * The server runs the clients of a protocol handler instance on a pool of
+ * worker threads. Each worker owns a copy of the instance, so the input
+ * buffer and the buffer cache are never shared, and drives its clients
+ * from its own event loop. A worker reads everything a client has sent
+ * and executes all of the commands in it before it sends the responses
+ * in one go. Listening sockets are shared by all of the workers, and an
+ * idle worker picks up the next connection.
+ *
+ * The callbacks of the instance are called from all of the worker threads
+ * at the same time, so they must be thread safe.
+ */
+typedef struct memcached_protocol_server_st memcached_protocol_server_st;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Create a server for the given protocol handler instance. The callbacks,
+ * IO functions and pedantic setting of the instance are copied into each
+ * worker, so change them before you create the server.
+ *
+ * @param instance the instance to serve clients for
+ * @param threads the number of worker threads to run
+ * @return NULL if allocation fails or the platform isn't supported
+ */
+LIBMEMCACHED_API
+memcached_protocol_server_st *memcached_protocol_server_create(memcached_protocol_st *instance, uint32_t threads);
+
+/**
+ * Accept clients from a socket. The socket must be bound, listening and
+ * in non-blocking mode. It still belongs to the caller, who should close
+ * it after the server is destroyed.
+ *
+ * @param server the server to add the socket to
+ * @param sock the listening socket
+ * @return true on success, false otherwise (errno contains more information)
+ */
+LIBMEMCACHED_API
+bool memcached_protocol_server_add_listener(memcached_protocol_server_st *server, memcached_socket_t sock);
+
+/**
+ * Should the clients accepted by the server be verbose?
+ * (see memcached_protocol_client_set_verbose)
+ *
+ * @param server the server to update
+ * @param arg true to make new clients verbose
+ */
+LIBMEMCACHED_API
+void memcached_protocol_server_set_verbose(memcached_protocol_server_st *server, bool arg);
+
+/**
+ * Start the worker threads and serve clients until
+ * memcached_protocol_server_shutdown() is called.
+ *
+ * @param server the server to run
+ * @return false if the workers couldn't be started
+ */
+LIBMEMCACHED_API
+bool memcached_protocol_server_run(memcached_protocol_server_st *server);
+
+/**
+ * Ask a running server to stop. This may be called from any thread, and
+ * from a signal handler.
+ *
+ * @param server the server to stop
+ */
+LIBMEMCACHED_API
+void memcached_protocol_server_shutdown(memcached_protocol_server_st *server);
+
+/**
+ * Destroy a server that isn't running. All clients still connected
+ * are disconnected.
+ *
+ * @param server the server to destroy
+ */
+LIBMEMCACHED_API
+void memcached_protocol_server_destroy(memcached_protocol_server_st *server);
+
+#ifdef __cplusplus
+}
+#endif
@@ -113,6 +113,10 @@ static void print_ascii_command(memcached_protocol_client_st *client)
       fprintf(stderr, "%s:%d GETS_CMD\n", __FILE__, __LINE__);
       break;
 
+    case CONFIG_CMD:
+      fprintf(stderr, "%s:%d CONFIG_CMD\n", __FILE__, __LINE__);
+      break;
+
     default:
     case UNKNOWN_CMD:
       fprintf(stderr, "%s:%d UNKNOWN_CMD\n", __FILE__, __LINE__);
@@ -148,7 +152,7 @@ static uint16_t parse_ascii_key(char **start)
   }
 
 
-  if (len == 0 || len > 240 || (*c != '\0' && *c != '\r' && iscntrl(*c)))
+  if (len == 0 || len > 240 || (*c != '\0' && !isspace(*c) && iscntrl(*c)))
   {
     return 0;
   }
@@ -169,12 +173,7 @@ static protocol_binary_response_status raw_response_handler(memcached_protocol_c
     fprintf(stderr, "%s:%d %s\n", __FILE__, __LINE__, text);
   }
 
-  if (client->root->drain(client) == false)
-  {
-    return PROTOCOL_BINARY_RESPONSE_EINTERNAL;
-  }
-
-  assert(client->output != NULL);
+  /* Sent along with the other responses once the input is processed */
 #if 0
   if (client->output == NULL)
   {
@@ -234,6 +233,7 @@ static void send_command_usage(memcached_protocol_client_st *client)
     [QUIT_CMD]="CLIENT_ERROR: Syntax error: quit\r\n",
 
     [VERBOSITY_CMD]= "CLIENT_ERROR: Syntax error: verbosity <num>\r\n",
+    [CONFIG_CMD]= "CLIENT_ERROR: Syntax error: config get <key> | config set <key> <flags> <bytes> [noreply]\r\n",
     [UNKNOWN_CMD]= "CLIENT_ERROR: Unknown command\r\n",
   };
 
@@ -259,29 +259,32 @@ static protocol_binary_response_status ascii_version_response_handler(const void
 }
 
 /**
- * Callback for the GET/GETQ/GETK and GETKQ responses
- * @param cookie client identifier
+ * Spool a VALUE (or CONFIG) line and the data for a get response
+ * @param client the client to respond to
  * @param key the key for the item
  * @param keylen the length of the key
  * @param body the length of the body
  * @param bodylen the length of the body
  * @param flags the flags for the item
  * @param cas the CAS id for the item
+ * @param release how to hand the body back if it is referenced
  */
 static protocol_binary_response_status
-ascii_get_response_handler(const void *cookie,
-                           const void *key,
-                           uint16_t keylen,
-                           const void *body,
-                           uint32_t bodylen,
-                           uint32_t flags,
-                           uint64_t cas)
+spool_ascii_value(memcached_protocol_client_st *client,
+                  const void *key,
+                  uint16_t keylen,
+                  const void *body,
+                  uint32_t bodylen,
+                  uint32_t flags,
+                  uint64_t cas,
+                  memcached_protocol_release_func release)
 {
-  memcached_protocol_client_st *client= (void*)cookie;
   char buffer[300];
-  strcpy(buffer, "VALUE ");
+  /* Configuration entries are sent just like items */
+  const char *prefix= (client->ascii_command == CONFIG_CMD) ? "CONFIG " : "VALUE ";
+  strcpy(buffer, prefix);
   const char *source= key;
-  char *dest= buffer + 6;
+  char *dest= buffer + strlen(prefix);
 
   for (int x= 0; x < keylen; ++x)
   {
@@ -291,6 +294,10 @@ ascii_get_response_handler(const void *cookie,
     }
     else
     {
+      if (release != NULL)
+      {
+        release(client, client->body_release_context);
+      }
       return PROTOCOL_BINARY_RESPONSE_EINVAL; /* key constraints in ascii */
     }
 
@@ -311,12 +318,80 @@ ascii_get_response_handler(const void *cookie,
   }
 
   client->root->spool(client, buffer, strlen(buffer));
-  client->root->spool(client, body, bodylen);
+  client->root->spool_reference(client, body, bodylen,
+                                release, client->body_release_context);
   client->root->spool(client, "\r\n", 2);
 
   return PROTOCOL_BINARY_RESPONSE_SUCCESS;
 }
 
+/**
+ * Callback for the GET/GETQ/GETK and GETKQ responses
+ * @param cookie client identifier
+ * @param key the key for the item
+ * @param keylen the length of the key
+ * @param body the length of the body
+ * @param bodylen the length of the body
+ * @param flags the flags for the item
+ * @param cas the CAS id for the item
+ */
+static protocol_binary_response_status
+ascii_get_response_handler(const void *cookie,
+                           const void *key,
+                           uint16_t keylen,
+                           const void *body,
+                           uint32_t bodylen,
+                           uint32_t flags,
+                           uint64_t cas)
+{
+  memcached_protocol_client_st *client= (void*)cookie;
+  memcached_protocol_release_func release= client->body_release;
+  client->body_release= NULL;
+
+  protocol_binary_response_status rval= spool_ascii_value(client, key, keylen,
+                                                          body, bodylen,
+                                                          flags, cas,
+                                                          release);
+  return rval;
+}
+
+/**
+ * Callback for the responses to a batch of gets
+ * @param cookie client identifier
+ * @param index the key in the batch the item belongs to
+ * @param body the body of the item
+ * @param bodylen the length of the body
+ * @param flags the flags for the item
+ * @param cas the CAS id for the item
+ */
+static protocol_binary_response_status
+ascii_batch_get_response_handler(const void *cookie,
+                                 uint32_t index,
+                                 const void *body,
+                                 uint32_t bodylen,
+                                 uint32_t flags,
+                                 uint64_t cas)
+{
+  memcached_protocol_client_st *client= (void*)cookie;
+  struct batch_st *batch= client->batch;
+  memcached_protocol_release_func release= client->body_release;
+  client->body_release= NULL;
+
+  /* Misses don't show up in the ascii protocol */
+  if (batch == NULL || index < batch->next || index >= batch->nkeys)
+  {
+    if (release != NULL)
+    {
+      release(client, client->body_release_context);
+    }
+    return PROTOCOL_BINARY_RESPONSE_EINVAL;
+  }
+  batch->next= index + 1;
+
+  return spool_ascii_value(client, batch->keys[index].key, batch->keys[index].keylen,
+                           body, bodylen, flags, cas, release);
+}
+
 /**
  * Callback for the STAT responses
  * @param cookie client identifier
@@ -350,6 +425,30 @@ static protocol_binary_response_status ascii_stat_response_handler(const void *c
   return PROTOCOL_BINARY_RESPONSE_SUCCESS;
 }
 
+/**
+ * Fetch a batch of keys with a single call to the application
+ * @param client the client handle
+ * @param batch the keys to fetch
+ */
+static void ascii_get_batch(memcached_protocol_client_st *client,
+                            struct batch_st *batch)
+{
+  batch->next= 0;
+  client->batch= batch;
+  (void)client->root->callback->interface.v2.get_batch(client, batch->keys,
+                                                       batch->nkeys,
+                                                       ascii_batch_get_response_handler);
+  client->batch= NULL;
+
+  /* The body was never sent, so hand it back right away */
+  if (client->body_release != NULL)
+  {
+    client->body_release(client, client->body_release_context);
+    client->body_release= NULL;
+  }
+  batch->nkeys= 0;
+}
+
 /**
  * Process a get or a gets request.
  * @param client the client handle
@@ -364,6 +463,12 @@ static void ascii_process_gets(memcached_protocol_client_st *client,
   /* Skip command */
   key += (client->ascii_command == GETS_CMD) ? 5 : 4;
 
+  /* Look up the keys in batches if the application can do that */
+  struct batch_st batch;
+  bool batched= client->root->callback->interface_version == MEMCACHED_PROTOCOL_HANDLER_V2 &&
+    client->root->callback->interface.v2.get_batch != NULL;
+  batch.nkeys= 0;
+
   int num_keys= 0;
   while (key < end)
   {
@@ -373,12 +478,36 @@ static void ascii_process_gets(memcached_protocol_client_st *client,
       break;
     }
 
-    (void)client->root->callback->interface.v1.get(client, key, nkey,
-                                                   ascii_get_response_handler);
+    if (batched)
+    {
+      batch.keys[batch.nkeys].key= key;
+      batch.keys[batch.nkeys].keylen= nkey;
+      if (++batch.nkeys == BATCH_MAX)
+      {
+        ascii_get_batch(client, &batch);
+      }
+    }
+    else
+    {
+      (void)client->root->callback->interface.v1.get(client, key, nkey,
+                                                     ascii_get_response_handler);
+
+      /* The body was never sent, so hand it back right away */
+      if (client->body_release != NULL)
+      {
+        client->body_release(client, client->body_release_context);
+        client->body_release= NULL;
+      }
+    }
     key += nkey;
     ++num_keys;
   }
 
+  if (batch.nkeys > 0)
+  {
+    ascii_get_batch(client, &batch);
+  }
+
   if (num_keys == 0)
   {
     send_command_usage(client);
@@ -389,9 +518,19 @@ static void ascii_process_gets(memcached_protocol_client_st *client,
   }
 }
 
+/*
+ * The characters separating the tokens in a command line (the same ones
+ * isspace() accepts in the C locale)
+ */
+static const bool ascii_separator[256]= {
+  [' ']= true, ['\t']= true, ['\n']= true, ['\v']= true, ['\f']= true, ['\r']= true
+};
+
 /**
- * Try to split up the command line "asdf asdf asdf asdf\n" into an
- * argument vector for easier parsing.
+ * Split up the command line "asdf asdf asdf asdf\n" into an argument
+ * vector for easier parsing. The line is left untouched, so there is
+ * nothing to undo if we have to wait for more data: every token ends
+ * with a separator, where the numeric parsers and parse_ascii_key() stop.
  * @param start the first character in the command line
  * @param end the last character in the command line ("\n")
  * @param vec the vector to insert the pointers into
@@ -401,35 +540,23 @@ static void ascii_process_gets(memcached_protocol_client_st *client,
 static int ascii_tokenize_command(char *str, char *end, char **vec, int size)
 {
   int elem= 0;
+  bool in_token= false;
 
-  while (str < end)
+  for (; str < end; ++str)
   {
-    /* Skip leading blanks */
-    while (str < end && isspace(*str))
-    {
-      ++str;
-    }
-
-    if (str == end)
-    {
-      return elem;
-    }
-
-    vec[elem++]= str;
-    /* find the next non-blank field */
-    while (str < end && !isspace(*str))
+    if (ascii_separator[(unsigned char)*str])
     {
-      ++str;
+      in_token= false;
     }
-
-    /* zero-terminate it for easier parsing later on */
-    *str= '\0';
-    ++str;
-
-    /* Is the vector full? */
-    if (elem == size)
+    else if (in_token == false)
     {
-      break;
+      /* Is the vector full? */
+      if (elem == size)
+      {
+        break;
+      }
+      vec[elem++]= str;
+      in_token= true;
     }
   }
 
@@ -437,70 +564,105 @@ static int ascii_tokenize_command(char *str, char *end, char **vec, int size)
 }
 
 /**
- * If we for some reasons needs to push the line back to read more
- * data we have to reverse the tokenization. Just do the brain-dead replace
- * of all '\0' to ' ' and set the last character to '\n'. We could have used
- * the vector we created, but then we would have to search for all of the
- * spaces we ignored...
- * @param start pointer to the first character in the buffer to recover
- * @param end pointer to the last character in the buffer to recover
+ * Check if a token is the given word
+ * @param token the token to check
+ * @param word the word to look for
+ * @param len the length of the word
  */
-static void recover_tokenize_command(char *start, char *end)
+static inline bool ascii_token_is(const char *token, const char *word, size_t len)
 {
-  while (start < end)
+  /* The token ends with a separator, so we never compare past the line */
+  for (size_t x= 0; x < len; ++x)
   {
-    if (*start == '\0')
-      *start= ' ';
-    ++start;
+    if (token[x] != word[x])
+    {
+      return false;
+    }
   }
 
-  *end= '\n';
+  return ascii_separator[(unsigned char)token[len]];
 }
 
 /**
- * Convert the textual command into a comcode
+ * Convert the textual command into a comcode. The commands are told apart
+ * by their length and first character, so we only need a single compare
+ * to verify the match.
+ * @param start the first character in the command line
+ * @param length the number of bytes available
  */
 static enum ascii_cmd ascii_to_cmd(char *start, size_t length)
 {
-  struct {
-    const char *cmd;
-    size_t len;
-    enum ascii_cmd cc;
-  } commands[]= {
-    { .cmd= "get", .len= 3, .cc= GET_CMD },
-    { .cmd= "gets", .len= 4, .cc= GETS_CMD },
-    { .cmd= "set", .len= 3, .cc= SET_CMD },
-    { .cmd= "add", .len= 3, .cc= ADD_CMD },
-    { .cmd= "replace", .len= 7, .cc= REPLACE_CMD },
-    { .cmd= "cas", .len= 3, .cc= CAS_CMD },
-    { .cmd= "append", .len= 6, .cc= APPEND_CMD },
-    { .cmd= "prepend", .len= 7, .cc= PREPEND_CMD },
-    { .cmd= "delete_object", .len= 6, .cc= DELETE_CMD },
-    { .cmd= "incr", .len= 4, .cc= INCR_CMD },
-    { .cmd= "decr", .len= 4, .cc= DECR_CMD },
-    { .cmd= "stats", .len= 5, .cc= STATS_CMD },
-    { .cmd= "flush_all", .len= 9, .cc= FLUSH_ALL_CMD },
-    { .cmd= "version", .len= 7, .cc= VERSION_CMD },
-    { .cmd= "quit", .len= 4, .cc= QUIT_CMD },
-    { .cmd= "verbosity", .len= 9, .cc= VERBOSITY_CMD },
-    { .cmd= NULL, .len= 0, .cc= UNKNOWN_CMD }};
-
-  int x= 0;
-  while (commands[x].len > 0) {
-    if (length >= commands[x].len)
+  size_t len= 0;
+  while (len < length && !ascii_separator[(unsigned char)start[len]])
+  {
+    ++len;
+  }
+
+#define ASCII_CMD(word, cmd) \
+  (memcmp(start, (word), sizeof(word) - 1) == 0 ? (cmd) : UNKNOWN_CMD)
+
+  switch (len)
+  {
+  case 3:
+    switch (start[0])
     {
-      if (strncmp(start, commands[x].cmd, commands[x].len) == 0)
-      {
-        /* Potential hit */
-        if (length == commands[x].len || isspace(*(start + commands[x].len)))
-        {
-          return commands[x].cc;
-        }
-      }
+    case 'g': return ASCII_CMD("get", GET_CMD);
+    case 's': return ASCII_CMD("set", SET_CMD);
+    case 'a': return ASCII_CMD("add", ADD_CMD);
+    case 'c': return ASCII_CMD("cas", CAS_CMD);
+    default: break;
+    }
+    break;
+
+  case 4:
+    switch (start[0])
+    {
+    case 'g': return ASCII_CMD("gets", GETS_CMD);
+    case 'i': return ASCII_CMD("incr", INCR_CMD);
+    case 'd': return ASCII_CMD("decr", DECR_CMD);
+    case 'q': return ASCII_CMD("quit", QUIT_CMD);
+    default: break;
+    }
+    break;
+
+  case 5:
+    return ASCII_CMD("stats", STATS_CMD);
+
+  case 6:
+    switch (start[0])
+    {
+    case 'a': return ASCII_CMD("append", APPEND_CMD);
+    case 'c': return ASCII_CMD("config", CONFIG_CMD);
+    case 'd': return ASCII_CMD("delete", DELETE_CMD);
+    default: break;
+    }
+    break;
+
+  case 7:
+    switch (start[0])
+    {
+    case 'r': return ASCII_CMD("replace", REPLACE_CMD);
+    case 'p': return ASCII_CMD("prepend", PREPEND_CMD);
+    case 'v': return ASCII_CMD("version", VERSION_CMD);
+    default: break;
+    }
+    break;
+
+  case 9:
+    switch (start[0])
+    {
+    case 'f': return ASCII_CMD("flush_all", FLUSH_ALL_CMD);
+    case 'v': return ASCII_CMD("verbosity", VERBOSITY_CMD);
+    default: break;
     }
-    ++x;
+    break;
+
+  default:
+    break;
   }
 
+#undef ASCII_CMD
+
   return UNKNOWN_CMD;
 }
 
@@ -619,11 +781,17 @@ static void process_stats(memcached_protocol_client_st *client,
     return;
   }
 
-  while (isspace(*key))
+  while (key < end && isspace(*key))
   {
     key++;
   }
 
+  /* Don't include the \r of the line ending in the key */
+  while (end > key && isspace(*(end - 1)))
+  {
+    --end;
+  }
+
   uint16_t nkey= (uint16_t)(end - key);
   (void)client->root->callback->interface.v1.stat(client, key, nkey,
                                                   ascii_stat_response_handler);
@@ -715,7 +883,6 @@ static inline int process_storage_command(memcached_protocol_client_st *client,
   if ((ssize_t)need > length)
   {
     /* Keep on reading */
-    recover_tokenize_command(start, *end);
     return 1;
   }
 
@@ -782,6 +949,7 @@ static inline int process_storage_command(memcached_protocol_client_st *client,
   case VERSION_CMD:
   case QUIT_CMD:
   case VERBOSITY_CMD:
+  case CONFIG_CMD:
   case UNKNOWN_CMD:
   default:
     abort(); /* impossible */
@@ -933,6 +1101,94 @@ static int process_prepend_command(memcached_protocol_client_st *client,
   return process_storage_command(client, tokens, ntokens, start, end, length);
 }
 
+/**
+ * Process "config get <key>" and "config set <key> <flags> <bytes>"
+ * @param client the client performing the operation
+ * @param tokens the command tokens
+ * @param ntokens the number of tokens
+ * @param start pointer to the first character in the line
+ * @param end pointer to the pointer where the last character of this
+ *            command is (IN and OUT)
+ * @param length the number of bytes available
+ * @return -1 if an error occurs (and we should just terminate the connection
+ *            because we are out of sync)
+ *         0 the command completed, continue processing
+ *         1 We need more data, so just go ahead and wait for more!
+ */
+static int process_config_command(memcached_protocol_client_st *client,
+                                  char **tokens, int ntokens, char *start,
+                                  char **end, ssize_t length)
+{
+  bool get= ntokens == 3 && client->mute == false && ascii_token_is(tokens[1], "get", 3);
+  bool set= ntokens == 5 && ascii_token_is(tokens[1], "set", 3);
+  if (get == false && set == false)
+  {
+    send_command_usage(client);
+    return 0;
+  }
+
+  if (client->root->callback->interface_version != MEMCACHED_PROTOCOL_HANDLER_V2 ||
+      (get && client->root->callback->interface.v2.config_get == NULL) ||
+      (set && client->root->callback->interface.v2.config_set == NULL))
+  {
+    raw_response_handler(client, "SERVER_ERROR: callback not implemented\r\n");
+    return 0;
+  }
+
+  char *key= tokens[2];
+  uint16_t nkey= parse_ascii_key(&key);
+  if (nkey == 0)
+  {
+    raw_response_handler(client, "CLIENT_ERROR: bad key\r\n");
+    return set ? -1 : 0;
+  }
+
+  if (get)
+  {
+    (void)client->root->callback->interface.v2.config_get(client, key, nkey,
+                                                          ascii_get_response_handler);
+
+    /* The body was never sent, so hand it back right away */
+    if (client->body_release != NULL)
+    {
+      client->body_release(client, client->body_release_context);
+      client->body_release= NULL;
+    }
+    client->root->spool(client, "END\r\n", 5);
+
+    return 0;
+  }
+
+  uint32_t flags= (uint32_t)strtoul(tokens[3], NULL, 10);
+  unsigned long nbytes= strtoul(tokens[4], NULL, 10);
+
+  /* Do we have all data? */
+  unsigned long need= nbytes + (unsigned long)((*end - start) + 1) + 2; /* \n\r\n */
+  if ((ssize_t)need > length)
+  {
+    /* Keep on reading */
+    return 1;
+  }
+
+  protocol_binary_response_status rval;
+  rval= client->root->callback->interface.v2.config_set(client, key, nkey,
+                                                        (*end) + 1,
+                                                        (uint32_t)nbytes,
+                                                        flags);
+  if (rval == PROTOCOL_BINARY_RESPONSE_SUCCESS)
+  {
+    raw_response_handler(client, "STORED\r\n");
+  }
+  else
+  {
+    raw_response_handler(client, "NOT_STORED\r\n");
+  }
+
+  *end += nbytes + 2;
+
+  return 0;
+}
+
 /**
  * The ASCII protocol support is just one giant big hack. Instead of adding
  * a optimal ascii support, I just convert the ASCII commands to the binary
@@ -953,6 +1209,8 @@ memcached_protocol_event_t memcached_ascii_protocol_process_data(memcached_proto
     }
 
     client->ascii_command= ascii_to_cmd(ptr, (size_t)(*length));
+    /* Only the commands that end with noreply are muted */
+    client->mute= false;
 
     /* we got all data available, execute the callback! */
     if (client->root->callback->pre_execute != NULL)
@@ -985,9 +1243,9 @@ memcached_protocol_event_t memcached_ascii_protocol_process_data(memcached_proto
       char *tokens[10];
       int ntokens= ascii_tokenize_command(ptr, end, tokens, 10);
 
-      if (ntokens < 10)
+      if (ntokens > 0 && ntokens < 10)
       {
-        client->mute= strcmp(tokens[ntokens - 1], "noreply") == 0;
+        client->mute= ascii_token_is(tokens[ntokens - 1], "noreply", 7);
         if (client->mute)
         {
           --ntokens; /* processed noreply token*/
@@ -1039,8 +1297,7 @@ memcached_protocol_event_t memcached_ascii_protocol_process_data(memcached_proto
         }
         else
         {
-          recover_tokenize_command(ptr, end);
-          process_stats(client, ptr + 6, end);
+          process_stats(client, ptr + 5, end);
         }
         break;
 
@@ -1086,6 +1343,10 @@ memcached_protocol_event_t memcached_ascii_protocol_process_data(memcached_proto
         }
         break;
 
+      case CONFIG_CMD:
+        error= process_config_command(client, tokens, ntokens, ptr, &end, *length);
+        break;
+
       case UNKNOWN_CMD:
         send_command_usage(client);
         break;
@@ -1103,6 +1364,8 @@ memcached_protocol_event_t memcached_ascii_protocol_process_data(memcached_proto
       }
       else if (error == 1)
       {
+        /* Keep the incomplete command for the next read */
+        *endptr= ptr;
         return MEMCACHED_PROTOCOL_READ_EVENT;
       }
     }
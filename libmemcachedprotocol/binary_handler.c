@@ -71,45 +71,107 @@ static protocol_binary_response_status raw_response_handler(const void *cookie,
     return PROTOCOL_BINARY_RESPONSE_EINVAL;
   }
 
-  if (client->root->drain(client) == false)
+  /*
+   * The responses to everything that arrived together are sent together
+   * once all of the commands are executed
+   */
+  size_t len= sizeof(protocol_binary_response_header) + htonl(response->response.bodylen);
+
+  return client->root->spool(client, response, len);
+}
+
+/**
+ * Spool a response without a body
+ * @param client the client to respond to
+ * @param opcode the opcode of the request
+ * @param opaque the opaque of the request (as found on the wire)
+ * @param status the status to report
+ * @param cas the CAS id to report
+ * @return The status of the operation
+ */
+static protocol_binary_response_status spool_status_response(memcached_protocol_client_st *client,
+                                                             uint8_t opcode,
+                                                             uint32_t opaque,
+                                                             protocol_binary_response_status status,
+                                                             uint64_t cas)
+{
+  protocol_binary_response_no_extras response= {
+    .message= {
+      .header.response= {
+        .magic= PROTOCOL_BINARY_RES,
+        .opcode= opcode,
+        .status= htons(status),
+        .opaque= opaque,
+        .cas= memcached_htonll(cas),
+      },
+    }
+  };
+
+  return client->root->spool(client, response.bytes, sizeof(response.bytes));
+}
+
+/**
+ * Spool the response to a GET/GETQ/GETK or GETKQ command, and hand the
+ * body over if it was referenced
+ * @param client the client to respond to
+ * @param opcode the opcode of the request
+ * @param opaque the opaque of the request (as found on the wire)
+ * @param key the key for the item
+ * @param keylen the length of the key
+ * @param body the body of the item
+ * @param bodylen the length of the body
+ * @param flags the flags for the item
+ * @param cas the CAS id for the item
+ * @return The status of the operation
+ */
+static protocol_binary_response_status spool_get_response(memcached_protocol_client_st *client,
+                                                          uint8_t opcode,
+                                                          uint32_t opaque,
+                                                          const void *key,
+                                                          uint16_t keylen,
+                                                          const void *body,
+                                                          uint32_t bodylen,
+                                                          uint32_t flags,
+                                                          uint64_t cas)
+{
+  memcached_protocol_release_func release= client->body_release;
+  client->body_release= NULL;
+
+  if (opcode == PROTOCOL_BINARY_CMD_GET || opcode == PROTOCOL_BINARY_CMD_GETQ ||
+      opcode == PROTOCOL_BINARY_CMD_CONFIG_GET || opcode == PROTOCOL_BINARY_CMD_CONFIG_GETQ)
   {
-    return PROTOCOL_BINARY_RESPONSE_EINTERNAL;
+    keylen= 0;
   }
 
-  size_t len= sizeof(protocol_binary_response_header) + htonl(response->response.bodylen);
-  size_t offset= 0;
-  char *ptr= (void*)response;
+  protocol_binary_response_get response= {
+    .message.header.response= {
+      .magic= PROTOCOL_BINARY_RES,
+      .opcode= opcode,
+      .status= htons(PROTOCOL_BINARY_RESPONSE_SUCCESS),
+      .opaque= opaque,
+      .cas= memcached_htonll(cas),
+      .keylen= htons(keylen),
+      .extlen= 4,
+      .bodylen= htonl(bodylen + keylen + 4),
+    },
+  };
 
-  if (client->output == NULL)
+  response.message.body.flags= htonl(flags);
+
+  protocol_binary_response_status rval;
+  const protocol_binary_response_status success= PROTOCOL_BINARY_RESPONSE_SUCCESS;
+  if ((rval= client->root->spool(client, response.bytes, sizeof(response.bytes))) != success ||
+      (rval= client->root->spool(client, key, keylen)) != success)
   {
-    /* I can write directly to the socket.... */
-    do
+    if (release != NULL)
     {
-      size_t num_bytes= len - offset;
-      ssize_t nw= client->root->send(client,
-                                     client->sock,
-                                     ptr + offset,
-                                     num_bytes);
-      if (nw == -1)
-      {
-        if (get_socket_errno() == EWOULDBLOCK)
-        {
-          break;
-        }
-        else if (get_socket_errno() != EINTR)
-        {
-          client->error= errno;
-          return PROTOCOL_BINARY_RESPONSE_EINTERNAL;
-        }
-      }
-      else
-      {
-        offset += (size_t)nw;
-      }
-    } while (offset < len);
+      release(client, client->body_release_context);
+    }
+    return rval;
   }
 
-  return client->root->spool(client, ptr, len - offset);
+  return client->root->spool_reference(client, body, bodylen,
+                                       release, client->body_release_context);
 }
 
 static void print_cmd(protocol_binary_command cmd)
@@ -178,6 +240,15 @@ static void print_cmd(protocol_binary_command cmd)
   case PROTOCOL_BINARY_CMD_GATK: fprintf(stderr, "%s:%d PROTOCOL_BINARY_CMD_GATK\n", __FILE__, __LINE__); return;
   case PROTOCOL_BINARY_CMD_GATKQ: fprintf(stderr, "%s:%d PROTOCOL_BINARY_CMD_GATKQ\n", __FILE__, __LINE__); return;
   case PROTOCOL_BINARY_CMD_SCRUB: fprintf(stderr, "%s:%d PROTOCOL_BINARY_CMD_SCRUB\n", __FILE__, __LINE__); return;
+  case PROTOCOL_BINARY_CMD_CONFIG_GET: fprintf(stderr, "%s:%d PROTOCOL_BINARY_CMD_CONFIG_GET\n", __FILE__, __LINE__); return;
+  case PROTOCOL_BINARY_CMD_CONFIG_GETQ: fprintf(stderr, "%s:%d PROTOCOL_BINARY_CMD_CONFIG_GETQ\n", __FILE__, __LINE__); return;
+  case PROTOCOL_BINARY_CMD_CONFIG_GETK: fprintf(stderr, "%s:%d PROTOCOL_BINARY_CMD_CONFIG_GETK\n", __FILE__, __LINE__); return;
+  case PROTOCOL_BINARY_CMD_CONFIG_GETKQ: fprintf(stderr, "%s:%d PROTOCOL_BINARY_CMD_CONFIG_GETKQ\n", __FILE__, __LINE__); return;
+  case PROTOCOL_BINARY_CMD_CONFIG_SET: fprintf(stderr, "%s:%d PROTOCOL_BINARY_CMD_CONFIG_SET\n", __FILE__, __LINE__); return;
+  case PROTOCOL_BINARY_CMD_CONFIG_SETQ: fprintf(stderr, "%s:%d PROTOCOL_BINARY_CMD_CONFIG_SETQ\n", __FILE__, __LINE__); return;
+  case PROTOCOL_BINARY_CMD_CONFIG_DELETE: fprintf(stderr, "%s:%d PROTOCOL_BINARY_CMD_CONFIG_DELETE\n", __FILE__, __LINE__); return;
+  case PROTOCOL_BINARY_CMD_CONFIG_DELETEQ: fprintf(stderr, "%s:%d PROTOCOL_BINARY_CMD_CONFIG_DELETEQ\n", __FILE__, __LINE__); return;
+  case PROTOCOL_BINARY_CMD_CONFIG_LIST: fprintf(stderr, "%s:%d PROTOCOL_BINARY_CMD_CONFIG_LIST\n", __FILE__, __LINE__); return;
   default:
                                   abort();
   }
@@ -210,38 +281,77 @@ static protocol_binary_response_status get_response_handler(const void *cookie,
                                                             uint64_t cas)
 {
   memcached_protocol_client_st *client= (void*)cookie;
-  uint8_t opcode= client->current_command->request.opcode;
 
-  if (opcode == PROTOCOL_BINARY_CMD_GET || opcode == PROTOCOL_BINARY_CMD_GETQ)
+  return spool_get_response(client,
+                            client->current_command->request.opcode,
+                            client->current_command->request.opaque,
+                            key, keylen, body, bodylen, flags, cas);
+}
+
+/**
+ * Report a key of a batch of gets as not found, or the error the batch
+ * failed with
+ * @param client the client to respond to
+ * @param index the key to report
+ * @param status the status to report
+ * @return The status of the operation
+ */
+static protocol_binary_response_status batch_get_failed(memcached_protocol_client_st *client,
+                                                        uint32_t index,
+                                                        protocol_binary_response_status status)
+{
+  struct batch_st *batch= client->batch;
+  uint8_t opcode= batch->opcode[index];
+
+  if (status == PROTOCOL_BINARY_RESPONSE_KEY_ENOENT &&
+      (opcode == PROTOCOL_BINARY_CMD_GETQ || opcode == PROTOCOL_BINARY_CMD_GETKQ))
   {
-    keylen= 0;
+    /* Quiet commands shouldn't respond on cache misses */
+    return PROTOCOL_BINARY_RESPONSE_SUCCESS;
   }
 
-  protocol_binary_response_get response= {
-    .message.header.response= {
-      .magic= PROTOCOL_BINARY_RES,
-      .opcode= opcode,
-      .status= htons(PROTOCOL_BINARY_RESPONSE_SUCCESS),
-      .opaque= client->current_command->request.opaque,
-      .cas= memcached_htonll(cas),
-      .keylen= htons(keylen),
-      .extlen= 4,
-      .bodylen= htonl(bodylen + keylen + 4),
-    },
-  };
+  return spool_status_response(client, opcode, batch->opaque[index], status, 0);
+}
 
-  response.message.body.flags= htonl(flags);
+/**
+ * Callback for the responses to a batch of gets
+ * @param cookie client identifier
+ * @param index the key in the batch the item belongs to
+ * @param body the body of the item
+ * @param bodylen the length of the body
+ * @param flags the flags for the item
+ * @param cas the CAS id for the item
+ */
+static protocol_binary_response_status batch_get_response_handler(const void *cookie,
+                                                                  uint32_t index,
+                                                                  const void *body,
+                                                                  uint32_t bodylen,
+                                                                  uint32_t flags,
+                                                                  uint64_t cas)
+{
+  memcached_protocol_client_st *client= (void*)cookie;
+  struct batch_st *batch= client->batch;
 
+  if (batch == NULL || index < batch->next || index >= batch->nkeys)
+  {
+    return PROTOCOL_BINARY_RESPONSE_EINVAL;
+  }
+
+  /* Everything skipped is a miss */
   protocol_binary_response_status rval;
-  const protocol_binary_response_status success= PROTOCOL_BINARY_RESPONSE_SUCCESS;
-  if ((rval= client->root->spool(client, response.bytes, sizeof(response.bytes))) != success ||
-      (rval= client->root->spool(client, key, keylen)) != success ||
-      (rval= client->root->spool(client, body, bodylen)) != success)
+  while (batch->next < index)
   {
-    return rval;
+    if ((rval= batch_get_failed(client, batch->next, PROTOCOL_BINARY_RESPONSE_KEY_ENOENT)) != PROTOCOL_BINARY_RESPONSE_SUCCESS)
+    {
+      return rval;
+    }
+    ++batch->next;
   }
+  ++batch->next;
 
-  return PROTOCOL_BINARY_RESPONSE_SUCCESS;
+  return spool_get_response(client, batch->opcode[index], batch->opaque[index],
+                            batch->keys[index].key, batch->keys[index].keylen,
+                            body, bodylen, flags, cas);
 }
 
 /**
@@ -376,6 +486,116 @@ add_command_handler(const void *cookie,
   return rval;
 }
 
+/**
+ * Callback for CONFIG_GET, CONFIG_GETQ, CONFIG_GETK and CONFIG_GETKQ
+ * @param cookie the calling client
+ * @param header the command
+ * @param response_handler not used
+ * @return the result of the operation
+ */
+static protocol_binary_response_status
+config_get_command_handler(const void *cookie,
+                           protocol_binary_request_header *header,
+                           memcached_binary_protocol_raw_response_handler response_handler)
+{
+  (void)response_handler;
+  protocol_binary_response_status rval;
+
+  memcached_protocol_client_st *client= (void*)cookie;
+  if (client->root->callback->interface_version == MEMCACHED_PROTOCOL_HANDLER_V2 &&
+      client->root->callback->interface.v2.config_get != NULL)
+  {
+    uint16_t keylen= ntohs(header->request.keylen);
+    void *key= (header + 1);
+    rval= client->root->callback->interface.v2.config_get(cookie, key, keylen,
+                                                          get_response_handler);
+
+    /* The body was never sent, so hand it back right away */
+    if (client->body_release != NULL)
+    {
+      client->body_release(client, client->body_release_context);
+      client->body_release= NULL;
+    }
+
+    if (rval == PROTOCOL_BINARY_RESPONSE_KEY_ENOENT &&
+        (header->request.opcode == PROTOCOL_BINARY_CMD_CONFIG_GETQ ||
+         header->request.opcode == PROTOCOL_BINARY_CMD_CONFIG_GETKQ))
+    {
+      /* Quiet commands shouldn't respond on misses */
+      rval= PROTOCOL_BINARY_RESPONSE_SUCCESS;
+    }
+  }
+  else
+  {
+    rval= PROTOCOL_BINARY_RESPONSE_UNKNOWN_COMMAND;
+  }
+
+  return rval;
+}
+
+/**
+ * Callback for CONFIG_SET and CONFIG_SETQ. The extras are the same as for
+ * SET, but only the flags are used (and they may be left out)
+ * @param cookie the calling client
+ * @param header the command
+ * @param response_handler the response handler
+ * @return the result of the operation
+ */
+static protocol_binary_response_status
+config_set_command_handler(const void *cookie,
+                           protocol_binary_request_header *header,
+                           memcached_binary_protocol_raw_response_handler response_handler)
+{
+  protocol_binary_response_status rval;
+
+  memcached_protocol_client_st *client= (void*)cookie;
+  if (client->root->callback->interface_version == MEMCACHED_PROTOCOL_HANDLER_V2 &&
+      client->root->callback->interface.v2.config_set != NULL)
+  {
+    uint8_t extlen= header->request.extlen;
+    uint16_t keylen= ntohs(header->request.keylen);
+    uint32_t bodylen= ntohl(header->request.bodylen);
+    if ((uint32_t)extlen + keylen > bodylen)
+    {
+      return PROTOCOL_BINARY_RESPONSE_EINVAL;
+    }
+
+    uint32_t flags= 0;
+    if (extlen >= sizeof(flags))
+    {
+      memcpy(&flags, header + 1, sizeof(flags));
+      flags= ntohl(flags);
+    }
+    char *key= ((char*)(header + 1)) + extlen;
+    char *data= key + keylen;
+    uint32_t datalen= bodylen - keylen - extlen;
+
+    rval= client->root->callback->interface.v2.config_set(cookie, key, keylen,
+                                                          data, datalen, flags);
+    if (rval == PROTOCOL_BINARY_RESPONSE_SUCCESS &&
+        header->request.opcode == PROTOCOL_BINARY_CMD_CONFIG_SET)
+    {
+      protocol_binary_response_no_extras response= {
+        .message= {
+          .header.response= {
+            .magic= PROTOCOL_BINARY_RES,
+            .opcode= PROTOCOL_BINARY_CMD_CONFIG_SET,
+            .status= htons(PROTOCOL_BINARY_RESPONSE_SUCCESS),
+            .opaque= header->request.opaque,
+          },
+        }
+      };
+      rval= response_handler(cookie, header, (void*)&response);
+    }
+  }
+  else
+  {
+    rval= PROTOCOL_BINARY_RESPONSE_UNKNOWN_COMMAND;
+  }
+
+  return rval;
+}
+
 /**
  * Callback for DECREMENT and DECREMENTQ
  * @param cookie the calling client
@@ -554,6 +774,13 @@ get_command_handler(const void *cookie,
     rval= client->root->callback->interface.v1.get(cookie, key, keylen,
                                                    get_response_handler);
 
+    /* The body was never sent, so hand it back right away */
+    if (client->body_release != NULL)
+    {
+      client->body_release(client, client->body_release_context);
+      client->body_release= NULL;
+    }
+
     if (rval == PROTOCOL_BINARY_RESPONSE_KEY_ENOENT &&
         (header->request.opcode == PROTOCOL_BINARY_CMD_GETQ ||
          header->request.opcode == PROTOCOL_BINARY_CMD_GETKQ))
@@ -994,6 +1221,12 @@ static memcached_binary_protocol_command_handler comcode_v0_v1_remap[256]= {
   [PROTOCOL_BINARY_CMD_ADD]= add_command_handler,
   [PROTOCOL_BINARY_CMD_APPENDQ]= append_command_handler,
   [PROTOCOL_BINARY_CMD_APPEND]= append_command_handler,
+  [PROTOCOL_BINARY_CMD_CONFIG_GETKQ]= config_get_command_handler,
+  [PROTOCOL_BINARY_CMD_CONFIG_GETK]= config_get_command_handler,
+  [PROTOCOL_BINARY_CMD_CONFIG_GETQ]= config_get_command_handler,
+  [PROTOCOL_BINARY_CMD_CONFIG_GET]= config_get_command_handler,
+  [PROTOCOL_BINARY_CMD_CONFIG_SETQ]= config_set_command_handler,
+  [PROTOCOL_BINARY_CMD_CONFIG_SET]= config_set_command_handler,
   [PROTOCOL_BINARY_CMD_DECREMENTQ]= decrement_command_handler,
   [PROTOCOL_BINARY_CMD_DECREMENT]= decrement_command_handler,
   [PROTOCOL_BINARY_CMD_DELETEQ]= delete_command_handler,
@@ -1060,6 +1293,7 @@ static protocol_binary_response_status execute_command(memcached_protocol_client
     break;
 
   case 1:
+  case 2:
     if (comcode_v0_v1_remap[cc] != NULL)
     {
       rval= comcode_v0_v1_remap[cc](client, header, raw_response_handler);
@@ -1106,6 +1340,239 @@ static protocol_binary_response_status execute_command(memcached_protocol_client
   return rval;
 }
 
+/**
+ * Hand a run of GET/GETQ/GETK and GETKQ commands to the storage engine
+ * in one batch
+ * @param client the client that sent the commands
+ * @param packet the first command of the run
+ * @param length the number of bytes available
+ * @return the number of bytes consumed, or -1 if the client should be
+ *         disconnected
+ */
+static ssize_t execute_get_batch(memcached_protocol_client_st *client, char *packet, ssize_t length)
+{
+  struct batch_st batch;
+  batch.nkeys= 0;
+  batch.next= 0;
+
+  /* The commands are read in place, where they may not be aligned */
+  ssize_t consumed= 0;
+  protocol_binary_request_header header;
+  while (batch.nkeys < BATCH_MAX && length - consumed >= (ssize_t)sizeof(header))
+  {
+    memcpy(&header, packet + consumed, sizeof(header));
+    ssize_t total= (ssize_t)(sizeof(header) + ntohl(header.request.bodylen));
+    uint8_t opcode= header.request.opcode;
+
+    if (length - consumed < total ||
+        header.request.magic != (uint8_t)PROTOCOL_BINARY_REQ ||
+        (opcode != PROTOCOL_BINARY_CMD_GET && opcode != PROTOCOL_BINARY_CMD_GETQ &&
+         opcode != PROTOCOL_BINARY_CMD_GETK && opcode != PROTOCOL_BINARY_CMD_GETKQ))
+    {
+      break;
+    }
+
+    if (client->is_verbose)
+    {
+      print_cmd(opcode);
+    }
+
+    batch.keys[batch.nkeys].key= packet + consumed + sizeof(header);
+    batch.keys[batch.nkeys].keylen= ntohs(header.request.keylen);
+    batch.opcode[batch.nkeys]= opcode;
+    batch.opaque[batch.nkeys]= header.request.opaque;
+    ++batch.nkeys;
+    consumed+= total;
+  }
+
+  if (batch.nkeys == 0)
+  {
+    return 0;
+  }
+
+  if (client->root->callback->pre_execute != NULL)
+  {
+    client->root->callback->pre_execute(client, NULL);
+  }
+
+  client->batch= &batch;
+  protocol_binary_response_status rval;
+  rval= client->root->callback->interface.v2.get_batch(client, batch.keys, batch.nkeys,
+                                                       batch_get_response_handler);
+
+  /* The body was never sent, so hand it back right away */
+  if (client->body_release != NULL)
+  {
+    client->body_release(client, client->body_release_context);
+    client->body_release= NULL;
+  }
+
+  if (rval == PROTOCOL_BINARY_RESPONSE_SUCCESS)
+  {
+    rval= PROTOCOL_BINARY_RESPONSE_KEY_ENOENT;
+  }
+
+  while (rval != PROTOCOL_BINARY_RESPONSE_EINTERNAL && batch.next < batch.nkeys)
+  {
+    if (batch_get_failed(client, batch.next, rval) != PROTOCOL_BINARY_RESPONSE_SUCCESS)
+    {
+      rval= PROTOCOL_BINARY_RESPONSE_EINTERNAL;
+    }
+    ++batch.next;
+  }
+  client->batch= NULL;
+
+  if (client->root->callback->post_execute != NULL)
+  {
+    client->root->callback->post_execute(client, NULL);
+  }
+
+  return (rval == PROTOCOL_BINARY_RESPONSE_EINTERNAL) ? -1 : consumed;
+}
+
+/**
+ * Hand a run of SET and SETQ commands to the storage engine in one batch
+ * @param client the client that sent the commands
+ * @param packet the first command of the run
+ * @param length the number of bytes available
+ * @return the number of bytes consumed, or -1 if the client should be
+ *         disconnected
+ */
+static ssize_t execute_set_batch(memcached_protocol_client_st *client, char *packet, ssize_t length)
+{
+  memcached_binary_protocol_batch_set_st items[BATCH_MAX];
+  uint8_t opcode[BATCH_MAX];
+  uint32_t opaque[BATCH_MAX];
+  uint32_t nitems= 0;
+
+  /* The commands are read in place, where they may not be aligned */
+  ssize_t consumed= 0;
+  protocol_binary_request_header header;
+  while (nitems < BATCH_MAX && length - consumed >= (ssize_t)sizeof(header))
+  {
+    memcpy(&header, packet + consumed, sizeof(header));
+    uint32_t bodylen= ntohl(header.request.bodylen);
+    uint16_t keylen= ntohs(header.request.keylen);
+    ssize_t total= (ssize_t)(sizeof(header) + bodylen);
+
+    if (length - consumed < total ||
+        header.request.magic != (uint8_t)PROTOCOL_BINARY_REQ ||
+        (header.request.opcode != PROTOCOL_BINARY_CMD_SET &&
+         header.request.opcode != PROTOCOL_BINARY_CMD_SETQ) ||
+        header.request.extlen != 8 || bodylen < (uint32_t)keylen + 8)
+    {
+      break;
+    }
+
+    if (client->is_verbose)
+    {
+      print_cmd(header.request.opcode);
+    }
+
+    char *extras= packet + consumed + sizeof(header);
+    uint32_t value;
+    memcpy(&value, extras, sizeof(value));
+    items[nitems].flags= ntohl(value);
+    memcpy(&value, extras + 4, sizeof(value));
+    items[nitems].exptime= ntohl(value);
+    items[nitems].key= extras + 8;
+    items[nitems].keylen= keylen;
+    items[nitems].val= extras + 8 + keylen;
+    items[nitems].vallen= bodylen - keylen - 8;
+    items[nitems].cas= memcached_ntohll(header.request.cas);
+    items[nitems].status= PROTOCOL_BINARY_RESPONSE_SUCCESS;
+    items[nitems].result_cas= 0;
+    opcode[nitems]= header.request.opcode;
+    opaque[nitems]= header.request.opaque;
+    ++nitems;
+    consumed+= total;
+  }
+
+  if (nitems == 0)
+  {
+    /* Let the regular command handling deal with malformed packets */
+    return 0;
+  }
+
+  if (client->root->callback->pre_execute != NULL)
+  {
+    client->root->callback->pre_execute(client, NULL);
+  }
+
+  protocol_binary_response_status rval;
+  rval= client->root->callback->interface.v2.set_batch(client, items, nitems);
+
+  for (uint32_t x= 0; rval != PROTOCOL_BINARY_RESPONSE_EINTERNAL && x < nitems; ++x)
+  {
+    protocol_binary_response_status status= items[x].status;
+    if (rval != PROTOCOL_BINARY_RESPONSE_SUCCESS)
+    {
+      status= rval;
+    }
+
+    /* Quiet commands only report failures */
+    if (status != PROTOCOL_BINARY_RESPONSE_SUCCESS ||
+        opcode[x] == PROTOCOL_BINARY_CMD_SET)
+    {
+      if (spool_status_response(client, opcode[x], opaque[x], status,
+                                items[x].result_cas) != PROTOCOL_BINARY_RESPONSE_SUCCESS)
+      {
+        rval= PROTOCOL_BINARY_RESPONSE_EINTERNAL;
+      }
+    }
+  }
+
+  if (client->root->callback->post_execute != NULL)
+  {
+    client->root->callback->post_execute(client, NULL);
+  }
+
+  return (rval == PROTOCOL_BINARY_RESPONSE_EINTERNAL) ? -1 : consumed;
+}
+
+/**
+ * Execute the run of commands starting at packet in one batch, if the
+ * storage engine accepts batches of them
+ * @param client the client that sent the commands
+ * @param header the first command of the run
+ * @param length the number of bytes available
+ * @return the number of bytes consumed (0 if the command isn't part of
+ *         a batch), or -1 if the client should be disconnected
+ */
+static ssize_t execute_batch(memcached_protocol_client_st *client, protocol_binary_request_header *header, ssize_t length)
+{
+  if (client->root->callback->interface_version != MEMCACHED_PROTOCOL_HANDLER_V2)
+  {
+    return 0;
+  }
+
+  switch (header->request.opcode)
+  {
+  case PROTOCOL_BINARY_CMD_GET:
+  case PROTOCOL_BINARY_CMD_GETQ:
+  case PROTOCOL_BINARY_CMD_GETK:
+  case PROTOCOL_BINARY_CMD_GETKQ:
+    if (client->root->callback->interface.v2.get_batch != NULL)
+    {
+      return execute_get_batch(client, (char*)header, length);
+    }
+    break;
+
+  case PROTOCOL_BINARY_CMD_SET:
+  case PROTOCOL_BINARY_CMD_SETQ:
+    if (client->root->callback->interface.v2.set_batch != NULL)
+    {
+      return execute_set_batch(client, (char*)header, length);
+    }
+    break;
+
+  default:
+    break;
+  }
+
+  return 0;
+}
+
 /*
 ** **********************************************************************
 ** "PROTOECTED" INTERFACE
@@ -1116,6 +1583,7 @@ memcached_protocol_event_t memcached_binary_protocol_process_data(memcached_prot
   /* try to parse all of the received packets */
   protocol_binary_request_header *header;
   header= (void*)client->root->input_buffer;
+  *endptr= (void*)header;
   if (header->request.magic != (uint8_t)PROTOCOL_BINARY_REQ)
   {
     client->error= EINVAL;
@@ -1128,20 +1596,33 @@ memcached_protocol_event_t memcached_binary_protocol_process_data(memcached_prot
   {
     /* I have the complete package */
     client->current_command= header;
-    protocol_binary_response_status rv= execute_command(client, header);
+    ssize_t total= execute_batch(client, header, len);
 
-    if (rv == PROTOCOL_BINARY_RESPONSE_EINTERNAL)
+    if (total == 0)
+    {
+      protocol_binary_response_status rv= execute_command(client, header);
+
+      if (rv == PROTOCOL_BINARY_RESPONSE_EINTERNAL)
+      {
+        total= -1;
+      }
+      else if (rv == PROTOCOL_BINARY_RESPONSE_NOT_SUPPORTED)
+      {
+        return MEMCACHED_PROTOCOL_PAUSE_EVENT;
+      }
+      else
+      {
+        total= (ssize_t)(sizeof(*header) + ntohl(header->request.bodylen));
+      }
+    }
+
+    if (total == -1)
     {
       *length= len;
       *endptr= (void*)header;
       return MEMCACHED_PROTOCOL_ERROR_EVENT;
     }
-    else if (rv == PROTOCOL_BINARY_RESPONSE_NOT_SUPPORTED)
-    {
-      return MEMCACHED_PROTOCOL_PAUSE_EVENT;
-    }
 
-    ssize_t total= (ssize_t)(sizeof(*header) + ntohl(header->request.bodylen));
     len -= total;
     if (len > 0)
     {
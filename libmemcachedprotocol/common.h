@@ -55,6 +55,11 @@ typedef bool (*drain_func)(memcached_protocol_client_st *client);
 typedef protocol_binary_response_status (*spool_func)(memcached_protocol_client_st *client,
                                                       const void *data,
                                                       size_t length);
+typedef protocol_binary_response_status (*spool_reference_func)(memcached_protocol_client_st *client,
+                                                                const void *data,
+                                                                size_t length,
+                                                                memcached_protocol_release_func release,
+                                                                void *context);
 
 /**
  * Definition of the per instance structure.
@@ -70,6 +75,7 @@ struct memcached_protocol_st {
    */
   drain_func drain;
   spool_func spool;
+  spool_reference_func spool_reference;
 
   /*
    * To avoid keeping a buffer in each client all the time I have a
@@ -97,10 +103,39 @@ struct chunk_st {
   size_t size;
   /* Pointer to the next buffer in the chain */
   struct chunk_st *next;
+  /*
+   * Set if data points to memory owned by someone else, who wants it
+   * back once we're done sending it
+   */
+  memcached_protocol_release_func release;
+  void *release_context;
 };
 
 #define CHUNK_BUFFERSIZE 2048
 
+/*
+ * Data shorter than this is cheaper to copy into a chunk than to reference
+ * in a segment of its own
+ */
+#define CHUNK_REFERENCE_MIN 512
+
+/* The most commands handed to the storage engine in one batch */
+#define BATCH_MAX 64
+
+/*
+ * A batch of gets handed to the storage engine, and how far we got
+ * answering it
+ */
+struct batch_st {
+  memcached_binary_protocol_batch_get_st keys[BATCH_MAX];
+  uint32_t nkeys;
+  /* The first key that hasn't been answered */
+  uint32_t next;
+  /* Members used by the binary protocol */
+  uint8_t opcode[BATCH_MAX];
+  uint32_t opaque[BATCH_MAX];
+};
+
 typedef memcached_protocol_event_t (*process_data)(struct memcached_protocol_client_st *client, ssize_t *length, void **endptr);
 
 enum ascii_cmd {
@@ -120,6 +155,7 @@ enum ascii_cmd {
   VERSION_CMD,
   QUIT_CMD,
   VERBOSITY_CMD,
+  CONFIG_CMD,
   UNKNOWN_CMD
 };
 
@@ -151,6 +187,16 @@ struct memcached_protocol_client_st {
    */
   bool mute;
 
+  /*
+   * Set by memcached_protocol_client_reference_body() for the body of
+   * the next get response
+   */
+  memcached_protocol_release_func body_release;
+  void *body_release_context;
+
+  /* The batch of gets being executed */
+  struct batch_st *batch;
+
   /* Members used by the binary protocol */
   protocol_binary_request_header *current_command;
 
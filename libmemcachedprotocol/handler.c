@@ -45,6 +45,12 @@
 #include <strings.h>
 #include <ctype.h>
 #include <stdio.h>
+#include <limits.h>
+#include <sys/uio.h>
+
+#ifndef IOV_MAX
+# define IOV_MAX 1024
+#endif
 
 /*
 ** **********************************************************************
@@ -92,6 +98,65 @@ static ssize_t default_send(const void *cookie,
   return send(fd, buf, nbytes, MSG_NOSIGNAL);
 }
 
+/**
+ * Release the first buffer in the output list, and give referenced data
+ * back to its owner
+ *
+ * @param client the client owning the output list
+ */
+static void release_output_chunk(struct memcached_protocol_client_st *client)
+{
+  struct chunk_st *old= client->output;
+  client->output= client->output->next;
+  if (client->output == NULL)
+  {
+    client->output_tail= NULL;
+  }
+
+  if (old->release != NULL)
+  {
+    old->release(client, old->release_context);
+  }
+  cache_free(client->root->buffer_cache, old);
+}
+
+/**
+ * Send as much of the output list as the socket takes in one go. With the
+ * default send function the buffers go out in a single sendmsg(), a user
+ * supplied send function only sees one buffer at a time.
+ *
+ * @param client the client to send data for
+ * @return the number of bytes transferred of -1 upon error
+ */
+static ssize_t send_output(struct memcached_protocol_client_st *client)
+{
+  if (client->root->send != default_send)
+  {
+    return client->root->send(client,
+                              client->sock,
+                              client->output->data + client->output->offset,
+                              client->output->nbytes - client->output->offset);
+  }
+
+  struct iovec vector[IOV_MAX];
+  int count= 0;
+  for (struct chunk_st *chunk= client->output;
+       chunk != NULL && count < IOV_MAX;
+       chunk= chunk->next)
+  {
+    vector[count].iov_base= chunk->data + chunk->offset;
+    vector[count].iov_len= chunk->nbytes - chunk->offset;
+    ++count;
+  }
+
+  struct msghdr msg;
+  memset(&msg, 0, sizeof(msg));
+  msg.msg_iov= vector;
+  msg.msg_iovlen= (size_t)count;
+
+  return sendmsg(client->sock, &msg, MSG_NOSIGNAL);
+}
+
 /**
  * Try to drain the output buffers without blocking
  *
@@ -112,10 +177,7 @@ static bool drain_output(struct memcached_protocol_client_st *client)
   /* Do we have pending data to send? */
   while (client->output != NULL)
   {
-    ssize_t len= client->root->send(client,
-                            client->sock,
-                            client->output->data + client->output->offset,
-                            client->output->nbytes - client->output->offset);
+    ssize_t len= send_output(client);
 
     if (len == -1)
     {
@@ -131,17 +193,19 @@ static bool drain_output(struct memcached_protocol_client_st *client)
     }
     else
     {
-      client->output->offset += (size_t)len;
-      if (client->output->offset == client->output->nbytes)
+      size_t nbytes= (size_t)len;
+      while (nbytes > 0)
       {
-        /* This was the complete buffer */
-        struct chunk_st *old= client->output;
-        client->output= client->output->next;
-        if (client->output == NULL)
+        size_t bulk= client->output->nbytes - client->output->offset;
+        if (nbytes < bulk)
         {
-          client->output_tail= NULL;
+          client->output->offset += nbytes;
+          break;
         }
-        cache_free(client->root->buffer_cache, old);
+
+        /* This was the complete buffer */
+        nbytes -= bulk;
+        release_output_chunk(client);
       }
     }
   }
@@ -168,6 +232,8 @@ static struct chunk_st *allocate_output_chunk(struct memcached_protocol_client_s
   ret->next= NULL;
   ret->size= CHUNK_BUFFERSIZE;
   ret->data= (void*)(ret + 1);
+  ret->release= NULL;
+  ret->release_context= NULL;
   if (client->output == NULL)
   {
     client->output= client->output_tail= ret;
@@ -206,7 +272,7 @@ static protocol_binary_response_status spool_output(struct memcached_protocol_cl
 
   size_t offset= 0;
 
-  struct chunk_st *chunk= client->output;
+  struct chunk_st *chunk= client->output_tail;
   while (offset < length)
   {
     if (chunk == NULL || (chunk->size - chunk->nbytes) == 0)
@@ -223,7 +289,7 @@ static protocol_binary_response_status spool_output(struct memcached_protocol_cl
       bulk= chunk->size - chunk->nbytes;
     }
 
-    memcpy(chunk->data + chunk->nbytes, data, bulk);
+    memcpy(chunk->data + chunk->nbytes, (const char*)data + offset, bulk);
     chunk->nbytes += bulk;
     offset += bulk;
   }
@@ -231,6 +297,57 @@ static protocol_binary_response_status spool_output(struct memcached_protocol_cl
   return PROTOCOL_BINARY_RESPONSE_SUCCESS;
 }
 
+/**
+ * Spool data into the send-buffer for a client without copying it. The
+ * data is sent from where it is, and handed back through release once it
+ * is sent. Without a release function, or if the data is small, this is
+ * the same as spool_output().
+ *
+ * @param client the client to spool the data for
+ * @param data the data to spool
+ * @param length the number of bytes of data to spool
+ * @param release the function to call once the data isn't needed anymore
+ * @param context passed along to release
+ * @return PROTOCOL_BINARY_RESPONSE_SUCCESS if success,
+ *         PROTOCOL_BINARY_RESPONSE_ENOMEM if we failed to allocate memory
+ */
+static protocol_binary_response_status spool_reference(struct memcached_protocol_client_st *client,
+                                                       const void *data,
+                                                       size_t length,
+                                                       memcached_protocol_release_func release,
+                                                       void *context)
+{
+  if (release == NULL || client->mute || length < CHUNK_REFERENCE_MIN)
+  {
+    protocol_binary_response_status rval= spool_output(client, data, length);
+    if (release != NULL)
+    {
+      release(client, context);
+    }
+
+    return rval;
+  }
+
+  if (client->is_verbose)
+  {
+    fprintf(stderr, "%s:%d %s length:%d\n", __FILE__, __LINE__, __func__, (int)length);
+  }
+
+  struct chunk_st *chunk= allocate_output_chunk(client);
+  if (chunk == NULL)
+  {
+    release(client, context);
+    return PROTOCOL_BINARY_RESPONSE_ENOMEM;
+  }
+
+  chunk->data= (char*)data;
+  chunk->size= chunk->nbytes= length;
+  chunk->release= release;
+  chunk->release_context= context;
+
+  return PROTOCOL_BINARY_RESPONSE_SUCCESS;
+}
+
 /**
  * Try to determine the protocol used on this connection.
  * If the first byte contains the magic byte PROTOCOL_BINARY_REQ we should
@@ -249,7 +366,7 @@ static memcached_protocol_event_t determine_protocol(struct memcached_protocol_c
     }
     client->work= memcached_binary_protocol_process_data;
   }
-  else if (client->root->callback->interface_version == 1)
+  else if (client->root->callback->interface_version >= MEMCACHED_PROTOCOL_HANDLER_V1)
   {
     if (client->is_verbose)
     {
@@ -301,6 +418,7 @@ struct memcached_protocol_st *memcached_protocol_create_instance(void)
     ret->send= default_send;
     ret->drain= drain_output;
     ret->spool= spool_output;
+    ret->spool_reference= spool_reference;
     ret->input_buffer_size= 1 * 1024 * 1024;
     ret->input_buffer= malloc(ret->input_buffer_size);
     if (ret->input_buffer == NULL)
@@ -331,6 +449,14 @@ void memcached_protocol_destroy_instance(struct memcached_protocol_st *instance)
   free(instance);
 }
 
+void memached_protocol_set_io_functions(struct memcached_protocol_st *instance,
+                                        memcached_protocol_recv_func recv,
+                                        memcached_protocol_send_func send)
+{
+  instance->recv= recv;
+  instance->send= send;
+}
+
 struct memcached_protocol_client_st *memcached_protocol_create_client(struct memcached_protocol_st *instance, memcached_socket_t sock)
 {
   struct memcached_protocol_client_st *ret= calloc(1, sizeof(memcached_protocol_client_st));
@@ -346,9 +472,34 @@ struct memcached_protocol_client_st *memcached_protocol_create_client(struct mem
 
 void memcached_protocol_client_destroy(struct memcached_protocol_client_st *client)
 {
+  while (client->output != NULL)
+  {
+    release_output_chunk(client);
+  }
+
+  if (client->body_release != NULL)
+  {
+    client->body_release(client, client->body_release_context);
+  }
+
   free(client);
 }
 
+void memcached_protocol_client_reference_body(const void *cookie,
+                                              memcached_protocol_release_func release,
+                                              void *context)
+{
+  memcached_protocol_client_st *client= (void*)cookie;
+
+  if (client->body_release != NULL)
+  {
+    client->body_release(client, client->body_release_context);
+  }
+
+  client->body_release= release;
+  client->body_release_context= context;
+}
+
 void memcached_protocol_client_set_verbose(struct memcached_protocol_client_st *client, bool arg)
 {
   if (client)
@@ -386,6 +537,8 @@ memcached_protocol_event_t memcached_protocol_client_work(struct memcached_proto
       memcached_protocol_event_t events= client->work(client, &len, &endptr);
       if (events == MEMCACHED_PROTOCOL_ERROR_EVENT)
       {
+        /* Try to get the responses out, the last one may say why */
+        drain_output(client);
         return MEMCACHED_PROTOCOL_ERROR_EVENT;
       }
 
@@ -401,8 +554,12 @@ memcached_protocol_event_t memcached_protocol_client_work(struct memcached_proto
         }
         memcpy(client->input_buffer, endptr, (size_t)len);
         client->input_buffer_offset= (size_t)len;
-        more_data= false;
       }
+      /*
+       * Keep reading until the socket runs dry, even with a partial
+       * packet in store: with edge triggered notification nobody tells
+       * us about data that is already waiting
+       */
     }
     else if (len == 0)
     {
@@ -430,7 +587,7 @@ memcached_protocol_event_t memcached_protocol_client_work(struct memcached_proto
   memcached_protocol_event_t ret= MEMCACHED_PROTOCOL_READ_EVENT;
   if (client->output)
   {
-    ret|= MEMCACHED_PROTOCOL_READ_EVENT;
+    ret|= MEMCACHED_PROTOCOL_WRITE_EVENT;
   }
 
   return ret;
@@ -0,0 +1,466 @@
+/*  vim:expandtab:shiftwidth=2:tabstop=2:smarttab:
+ *
+ *  Libmemcached library
+ *
+ *  Copyright (C) 2012 Data Differential, http://datadifferential.com/
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are
+ *  met:
+ *
+ *      * Redistributions of source code must retain the above copyright
+ *  notice, this list of conditions and the following disclaimer.
+ *
+ *      * Redistributions in binary form must reproduce the above
+ *  copyright notice, this list of conditions and the following disclaimer
+ *  in the documentation and/or other materials provided with the
+ *  distribution.
+ *
+ *      * The names of its contributors may not be used to endorse or
+ *  promote products derived from this software without specific prior
+ *  written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *  A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *  OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *  SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *  LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *  DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *  THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *  OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/* -*- Mode: C; tab-width: 2; c-basic-offset: 2; indent-tabs-mode: nil -*- */
+#include <libmemcachedprotocol/common.h>
+#include <libmemcachedprotocol-0.0/server.h>
+
+#include <stdlib.h>
+#include <errno.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#if defined(__linux__)
+
+#include <pthread.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+/* The number of events a worker picks up from the kernel at a time */
+#define MAX_EVENTS 64
+
+/*
+ * Everything registered with a worker's epoll instance. Listening sockets
+ * and the wakeup descriptor don't have a client.
+ */
+struct descriptor_st {
+  memcached_socket_t sock;
+  memcached_protocol_client_st *client;
+  /* The clients of a worker are kept in a list so they can be destroyed */
+  struct descriptor_st *next;
+  struct descriptor_st *prev;
+};
+
+struct worker_st {
+  memcached_protocol_server_st *server;
+  /* This worker's own copy of the instance */
+  memcached_protocol_st *protocol;
+  int epfd;
+  pthread_t thread;
+  struct descriptor_st *clients;
+};
+
+struct memcached_protocol_server_st {
+  struct worker_st *workers;
+  uint32_t number_of_workers;
+  struct descriptor_st *listeners;
+  uint32_t number_of_listeners;
+  /* Readable once the server should shut down */
+  struct descriptor_st wakeup;
+  bool is_verbose;
+};
+
+/**
+ * Disconnect a client and forget about it
+ * @param worker the worker the client belongs to
+ * @param descriptor the client to disconnect
+ */
+static void close_client(struct worker_st *worker, struct descriptor_st *descriptor)
+{
+  if (descriptor->prev == NULL)
+  {
+    worker->clients= descriptor->next;
+  }
+  else
+  {
+    descriptor->prev->next= descriptor->next;
+  }
+
+  if (descriptor->next != NULL)
+  {
+    descriptor->next->prev= descriptor->prev;
+  }
+
+  /* The socket goes first, see memcached_protocol_client_destroy() */
+  closesocket(descriptor->sock);
+  memcached_protocol_client_destroy(descriptor->client);
+  free(descriptor);
+}
+
+/**
+ * Accept a client from a listening socket. Only one client is accepted
+ * at a time so that the rest are left for the workers that are idle,
+ * the listening socket stays readable until they are all gone.
+ *
+ * @param worker the worker that is going to serve the client
+ * @param sock the listening socket
+ */
+static void accept_client(struct worker_st *worker, memcached_socket_t sock)
+{
+  memcached_socket_t client_sock= accept4(sock, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+  if (client_sock == INVALID_SOCKET)
+  {
+    /* Someone else got it, or it gave up */
+    return;
+  }
+
+  struct descriptor_st *descriptor= calloc(1, sizeof(*descriptor));
+  if (descriptor == NULL)
+  {
+    closesocket(client_sock);
+    return;
+  }
+
+  descriptor->sock= client_sock;
+  descriptor->client= memcached_protocol_create_client(worker->protocol, client_sock);
+  if (descriptor->client == NULL)
+  {
+    closesocket(client_sock);
+    free(descriptor);
+    return;
+  }
+  memcached_protocol_client_set_verbose(descriptor->client, worker->server->is_verbose);
+
+  descriptor->next= worker->clients;
+  if (worker->clients != NULL)
+  {
+    worker->clients->prev= descriptor;
+  }
+  worker->clients= descriptor;
+
+  /*
+   * The client works until the socket runs dry in both directions, so
+   * we only need to hear about it when that changes. Any data that has
+   * already arrived is reported right away.
+   */
+  struct epoll_event event= {
+    .events= EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET,
+    .data.ptr= descriptor
+  };
+
+  if (epoll_ctl(worker->epfd, EPOLL_CTL_ADD, client_sock, &event) == -1)
+  {
+    close_client(worker, descriptor);
+  }
+}
+
+/**
+ * Let the client read and execute everything that has arrived, and
+ * send out the responses.
+ *
+ * @param worker the worker the client belongs to
+ * @param descriptor the client to drive
+ */
+static void drive_client(struct worker_st *worker, struct descriptor_st *descriptor)
+{
+  memcached_protocol_event_t events= memcached_protocol_client_work(descriptor->client);
+  if (events & MEMCACHED_PROTOCOL_ERROR_EVENT)
+  {
+    close_client(worker, descriptor);
+  }
+}
+
+static void *worker_main(void *arg)
+{
+  struct worker_st *worker= arg;
+  struct epoll_event events[MAX_EVENTS];
+
+  while (true)
+  {
+    int nevents= epoll_wait(worker->epfd, events, MAX_EVENTS, -1);
+    if (nevents == -1)
+    {
+      if (errno == EINTR)
+      {
+        continue;
+      }
+
+      break;
+    }
+
+    for (int x= 0; x < nevents; ++x)
+    {
+      struct descriptor_st *descriptor= events[x].data.ptr;
+
+      if (descriptor == &worker->server->wakeup)
+      {
+        return NULL;
+      }
+      else if (descriptor->client == NULL)
+      {
+        accept_client(worker, descriptor->sock);
+      }
+      else
+      {
+        drive_client(worker, descriptor);
+      }
+    }
+  }
+
+  return NULL;
+}
+
+/*
+** **********************************************************************
+** * PUBLIC INTERFACE
+** * See server.h for function description
+** **********************************************************************
+*/
+memcached_protocol_server_st *memcached_protocol_server_create(memcached_protocol_st *instance, uint32_t threads)
+{
+  if (threads == 0)
+  {
+    errno= EINVAL;
+    return NULL;
+  }
+
+  memcached_protocol_server_st *server= calloc(1, sizeof(*server));
+  if (server == NULL)
+  {
+    return NULL;
+  }
+
+  server->wakeup.sock= eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  server->workers= calloc(threads, sizeof(struct worker_st));
+  if (server->wakeup.sock == INVALID_SOCKET || server->workers == NULL)
+  {
+    if (server->wakeup.sock != INVALID_SOCKET)
+    {
+      close(server->wakeup.sock);
+    }
+    free(server->workers);
+    free(server);
+    return NULL;
+  }
+
+  for (uint32_t x= 0; x < threads; ++x)
+  {
+    struct worker_st *worker= &server->workers[x];
+    worker->server= server;
+    worker->epfd= epoll_create1(EPOLL_CLOEXEC);
+    worker->protocol= memcached_protocol_create_instance();
+    server->number_of_workers++;
+
+    if (worker->epfd == -1 || worker->protocol == NULL)
+    {
+      memcached_protocol_server_destroy(server);
+      return NULL;
+    }
+
+    worker->protocol->callback= instance->callback;
+    worker->protocol->recv= instance->recv;
+    worker->protocol->send= instance->send;
+    worker->protocol->pedantic= instance->pedantic;
+
+    /* Every worker wakes up for the shutdown */
+    struct epoll_event event= {
+      .events= EPOLLIN,
+      .data.ptr= &server->wakeup
+    };
+
+    if (epoll_ctl(worker->epfd, EPOLL_CTL_ADD, server->wakeup.sock, &event) == -1)
+    {
+      memcached_protocol_server_destroy(server);
+      return NULL;
+    }
+  }
+
+  return server;
+}
+
+bool memcached_protocol_server_add_listener(memcached_protocol_server_st *server, memcached_socket_t sock)
+{
+  /*
+   * The workers keep pointers to the listeners, so they are allocated
+   * one at a time instead of as an array that might move
+   */
+  struct descriptor_st *listener= calloc(1, sizeof(*listener));
+  if (listener == NULL)
+  {
+    return false;
+  }
+  listener->sock= sock;
+
+  /*
+   * Level triggered so that a connection left behind wakes up another
+   * worker, and exclusive so that only one of them wakes up for it.
+   */
+  struct epoll_event event= {
+    .events= EPOLLIN,
+    .data.ptr= listener
+  };
+#ifdef EPOLLEXCLUSIVE
+  event.events|= EPOLLEXCLUSIVE;
+#endif
+
+  for (uint32_t x= 0; x < server->number_of_workers; ++x)
+  {
+    if (epoll_ctl(server->workers[x].epfd, EPOLL_CTL_ADD, sock, &event) == -1)
+    {
+      int error= errno;
+      while (x-- > 0)
+      {
+        epoll_ctl(server->workers[x].epfd, EPOLL_CTL_DEL, sock, NULL);
+      }
+      free(listener);
+      errno= error;
+
+      return false;
+    }
+  }
+
+  listener->next= server->listeners;
+  server->listeners= listener;
+  server->number_of_listeners++;
+
+  return true;
+}
+
+void memcached_protocol_server_set_verbose(memcached_protocol_server_st *server, bool arg)
+{
+  if (server)
+  {
+    server->is_verbose= arg;
+  }
+}
+
+bool memcached_protocol_server_run(memcached_protocol_server_st *server)
+{
+  uint32_t started;
+  for (started= 0; started < server->number_of_workers; ++started)
+  {
+    struct worker_st *worker= &server->workers[started];
+    if (pthread_create(&worker->thread, NULL, worker_main, worker) != 0)
+    {
+      memcached_protocol_server_shutdown(server);
+      break;
+    }
+  }
+
+  for (uint32_t x= 0; x < started; ++x)
+  {
+    pthread_join(server->workers[x].thread, NULL);
+  }
+
+  return started == server->number_of_workers;
+}
+
+void memcached_protocol_server_shutdown(memcached_protocol_server_st *server)
+{
+  /* Never read, so it stays readable for all of the workers */
+  uint64_t value= 1;
+  if (write(server->wakeup.sock, &value, sizeof(value)) == -1)
+  {
+    /* The counter is already set */
+  }
+}
+
+void memcached_protocol_server_destroy(memcached_protocol_server_st *server)
+{
+  if (server == NULL)
+  {
+    return;
+  }
+
+  for (uint32_t x= 0; x < server->number_of_workers; ++x)
+  {
+    struct worker_st *worker= &server->workers[x];
+
+    while (worker->clients != NULL)
+    {
+      close_client(worker, worker->clients);
+    }
+
+    if (worker->epfd != -1)
+    {
+      close(worker->epfd);
+    }
+
+    if (worker->protocol != NULL)
+    {
+      memcached_protocol_destroy_instance(worker->protocol);
+    }
+  }
+
+  while (server->listeners != NULL)
+  {
+    struct descriptor_st *next= server->listeners->next;
+    free(server->listeners);
+    server->listeners= next;
+  }
+
+  close(server->wakeup.sock);
+  free(server->workers);
+  free(server);
+}
+
+#else
+
+/* There is no event loop for this platform (yet) */
+
+memcached_protocol_server_st *memcached_protocol_server_create(memcached_protocol_st *instance, uint32_t threads)
+{
+  (void)instance;
+  (void)threads;
+  errno= ENOTSUP;
+
+  return NULL;
+}
+
+bool memcached_protocol_server_add_listener(memcached_protocol_server_st *server, memcached_socket_t sock)
+{
+  (void)server;
+  (void)sock;
+  errno= ENOTSUP;
+
+  return false;
+}
+
+void memcached_protocol_server_set_verbose(memcached_protocol_server_st *server, bool arg)
+{
+  (void)server;
+  (void)arg;
+}
+
+bool memcached_protocol_server_run(memcached_protocol_server_st *server)
+{
+  (void)server;
+
+  return false;
+}
+
+void memcached_protocol_server_shutdown(memcached_protocol_server_st *server)
+{
+  (void)server;
+}
+
+void memcached_protocol_server_destroy(memcached_protocol_server_st *server)
+{
+  (void)server;
+}
+
+#endif
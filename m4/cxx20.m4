@@ -0,0 +1,24 @@
+dnl ---------------------------------------------------------------------------
+dnl Macro: cxx20
+dnl ---------------------------------------------------------------------------
+AC_DEFUN([CHECK_CXX20],[
+  AC_CACHE_CHECK([whether $CXX can build C++20 coroutines],
+    [ac_cv_cxx20],
+    [AC_LANG_PUSH([C++])
+     save_CXXFLAGS="$CXXFLAGS"
+     CXXFLAGS="$CXXFLAGS -std=gnu++20"
+     AC_COMPILE_IFELSE([AC_LANG_PROGRAM([[#include <coroutine>
+#include <span>]], [[std::coroutine_handle<> handle;]])],
+                       [ac_cv_cxx20="yes"],
+                       [ac_cv_cxx20="no"])
+     CXXFLAGS="$save_CXXFLAGS"
+     AC_LANG_POP([C++])])
+
+  AS_IF([test "$ac_cv_cxx20" = "yes"],
+        [CXX20_FLAGS="-std=gnu++20"],
+        [CXX20_FLAGS=""])
+  AC_SUBST([CXX20_FLAGS])
+])
+dnl ---------------------------------------------------------------------------
+dnl End Macro: cxx20
+dnl ---------------------------------------------------------------------------
@@ -0,0 +1,26 @@
+dnl ---------------------------------------------------------------------------
+dnl Macro: libz
+dnl ---------------------------------------------------------------------------
+AC_DEFUN([ENABLE_LIBZ],[
+  AC_ARG_ENABLE([libz],
+    [AS_HELP_STRING([--disable-libz],
+       [Build without the zlib value compression codec @<:@default=on@:>@])],
+    [ac_enable_libz="$enableval"],
+    [ac_enable_libz="yes"])
+
+  ac_cv_libz="no"
+  AS_IF([test "$ac_enable_libz" = "yes"],
+        [AC_CHECK_HEADER([zlib.h],
+                         [AC_CHECK_LIB([z], [deflate], [ac_cv_libz="yes"])])])
+
+  AS_IF([test "$ac_cv_libz" = "yes"],
+        [LIBZ="-lz"
+         LIBMEMCACHED_WITH_LIBZ="#define LIBMEMCACHED_WITH_LIBZ 1"],
+        [LIBZ=""
+         LIBMEMCACHED_WITH_LIBZ="#define LIBMEMCACHED_WITH_LIBZ 0"])
+  AC_SUBST([LIBZ])
+  AC_SUBST([LIBMEMCACHED_WITH_LIBZ])
+])
+dnl ---------------------------------------------------------------------------
+dnl End Macro: libz
+dnl ---------------------------------------------------------------------------
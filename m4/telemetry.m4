@@ -0,0 +1,18 @@
+dnl ---------------------------------------------------------------------------
+dnl Macro: telemetry
+dnl ---------------------------------------------------------------------------
+AC_DEFUN([ENABLE_TELEMETRY],[
+  AC_ARG_ENABLE([telemetry],
+    [AS_HELP_STRING([--disable-telemetry],
+       [Compile out per-server latency histograms and counters @<:@default=on@:>@])],
+    [ac_enable_telemetry="$enableval"],
+    [ac_enable_telemetry="yes"])
+
+  AS_IF([test "$ac_enable_telemetry" = "yes"],
+        [LIBMEMCACHED_WITH_TELEMETRY="#define LIBMEMCACHED_WITH_TELEMETRY 1"],
+        [LIBMEMCACHED_WITH_TELEMETRY="#define LIBMEMCACHED_WITH_TELEMETRY 0"])
+  AC_SUBST([LIBMEMCACHED_WITH_TELEMETRY])
+])
+dnl ---------------------------------------------------------------------------
+dnl End Macro: telemetry
+dnl ---------------------------------------------------------------------------
@@ -0,0 +1,148 @@
+/* -*- Mode: C; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ * Measures how fast a server takes new connections. Each client thread
+ * connects, waits for the answer to "version", and drops the connection,
+ * over and over, the way clients reconnect after a failover. Run it against
+ * memcached with and without "-o reuseport" to compare accepting in the
+ * main thread with accepting in every worker.
+ *
+ *   accept_benchmark [host] [port] [threads] [seconds]
+ */
+#include "config.h"
+
+#include <errno.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+struct client {
+    pthread_t tid;
+    unsigned long connections;
+    unsigned long failures;
+    double worst;              /* slowest connect-to-reply, in seconds */
+};
+
+static struct addrinfo *server;
+static volatile int running;
+
+static double now(void) {
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+/* One connection: connect, "version", wait for the reply, reset. */
+static int cycle(void) {
+    static const char cmd[] = "version\r\n";
+    struct linger ling = {1, 0};
+    char buf[64];
+    ssize_t n = 0;
+    int sfd;
+
+    if ((sfd = socket(server->ai_family, server->ai_socktype,
+                      server->ai_protocol)) == -1)
+        return -1;
+    /* Reset instead of closing so the client doesn't run out of ports to
+     * TIME_WAIT long before the server runs out of steam */
+    setsockopt(sfd, SOL_SOCKET, SO_LINGER, &ling, sizeof(ling));
+
+    if (connect(sfd, server->ai_addr, server->ai_addrlen) == -1 ||
+        write(sfd, cmd, sizeof(cmd) - 1) != sizeof(cmd) - 1) {
+        close(sfd);
+        return -1;
+    }
+    do {
+        ssize_t r = read(sfd, buf + n, sizeof(buf) - n);
+        if (r <= 0) {
+            close(sfd);
+            return -1;
+        }
+        n += r;
+    } while (buf[n - 1] != '\n' && (size_t)n < sizeof(buf));
+    close(sfd);
+    return strncmp(buf, "VERSION ", 8) == 0 ? 0 : -1;
+}
+
+static void *client_thread(void *arg) {
+    struct client *cl = arg;
+
+    while (running) {
+        double start = now();
+        if (cycle() == 0) {
+            double took = now() - start;
+            cl->connections++;
+            if (took > cl->worst)
+                cl->worst = took;
+        } else {
+            cl->failures++;
+        }
+    }
+    return NULL;
+}
+
+int main(int argc, char **argv) {
+    const char *host = argc > 1 ? argv[1] : "127.0.0.1";
+    const char *port = argc > 2 ? argv[2] : "11211";
+    int nclients = argc > 3 ? atoi(argv[3]) : 16;
+    int seconds = argc > 4 ? atoi(argv[4]) : 5;
+    struct addrinfo hints = { .ai_family = AF_UNSPEC,
+                              .ai_socktype = SOCK_STREAM };
+    struct client *clients;
+    unsigned long connections = 0, failures = 0;
+    double worst = 0, elapsed;
+    int error, ii;
+
+    if (nclients < 1 || seconds < 1) {
+        fprintf(stderr, "usage: %s [host] [port] [threads] [seconds]\n",
+                argv[0]);
+        return EXIT_FAILURE;
+    }
+    if ((error = getaddrinfo(host, port, &hints, &server)) != 0) {
+        fprintf(stderr, "getaddrinfo(): %s\n", gai_strerror(error));
+        return EXIT_FAILURE;
+    }
+    if (cycle() != 0) {
+        fprintf(stderr, "can't talk to %s:%s: %s\n", host, port,
+                strerror(errno));
+        return EXIT_FAILURE;
+    }
+
+    clients = calloc(nclients, sizeof(*clients));
+    if (clients == NULL) {
+        perror("calloc");
+        return EXIT_FAILURE;
+    }
+
+    running = 1;
+    elapsed = now();
+    for (ii = 0; ii < nclients; ii++) {
+        if (pthread_create(&clients[ii].tid, NULL, client_thread,
+                           &clients[ii]) != 0) {
+            perror("pthread_create");
+            return EXIT_FAILURE;
+        }
+    }
+    sleep(seconds);
+    running = 0;
+    for (ii = 0; ii < nclients; ii++) {
+        pthread_join(clients[ii].tid, NULL);
+        connections += clients[ii].connections;
+        failures += clients[ii].failures;
+        if (clients[ii].worst > worst)
+            worst = clients[ii].worst;
+    }
+    elapsed = now() - elapsed;
+
+    printf("%2d clients: %8.0f connections/sec, %lu failed, slowest %.2f ms\n",
+           nclients, connections / elapsed, failures, worst * 1000);
+    free(clients);
+    freeaddrinfo(server);
+    return EXIT_SUCCESS;
+}
@@ -27,6 +27,7 @@
 #include <pthread.h>
 
 static pthread_cond_t maintenance_cond = PTHREAD_COND_INITIALIZER;
+static pthread_mutex_t maintenance_lock = PTHREAD_MUTEX_INITIALIZER;
 
 #ifndef __INTEL_COMPILER
 #pragma GCC diagnostic ignored "-Wstrict-aliasing"
@@ -58,13 +59,16 @@ static item** old_hashtable = 0;
 static unsigned int hash_items = 0;
 
 /* Flag: Are we in the middle of expanding now? */
-static bool expanding = false;
+static volatile bool expanding = false;
+
+/* Flag: Has an insert asked the maintenance thread to expand? */
+static bool started_expanding = false;
 
 /*
  * During expansion we migrate values with bucket granularity; this is how
  * far we've gotten so far. Ranges from 0 .. hashsize(hashpower - 1) - 1.
  */
-static unsigned int expand_bucket = 0;
+static volatile unsigned int expand_bucket = 0;
 
 void assoc_init(const int hashtable_init) {
     if (hashtable_init) {
@@ -128,7 +132,8 @@ static item** _hashitem_before (const char *key, const size_t nkey, const uint32
     return pos;
 }
 
-/* grows the hashtable to the next power of 2. */
+/* grows the hashtable to the next power of 2. The caller holds every item
+ * lock, so no worker is looking at either table. */
 static void assoc_expand(void) {
     old_hashtable = primary_hashtable;
 
@@ -144,16 +149,27 @@ static void assoc_expand(void) {
         stats.hash_bytes += hashsize(hashpower) * sizeof(void *);
         stats.hash_is_expanding = 1;
         STATS_UNLOCK();
-        pthread_cond_signal(&maintenance_cond);
     } else {
         primary_hashtable = old_hashtable;
         /* Bad news, but we can keep running. */
     }
 }
 
+/* Inserts only hold a single item lock, so they leave the table swap to the
+ * maintenance thread. */
+static void assoc_start_expand(void) {
+    pthread_mutex_lock(&maintenance_lock);
+    if (!started_expanding) {
+        started_expanding = true;
+        pthread_cond_signal(&maintenance_cond);
+    }
+    pthread_mutex_unlock(&maintenance_lock);
+}
+
 /* Note: this isn't an assoc_update.  The key must not already exist to call this */
 int assoc_insert(item *it, const uint32_t hv) {
     unsigned int oldbucket;
+    unsigned int items;
 
 //    assert(assoc_find(ITEM_key(it), it->nkey) == 0);  /* shouldn't have duplicately named things defined */
 
@@ -167,12 +183,14 @@ int assoc_insert(item *it, const uint32_t hv) {
         primary_hashtable[hv & hashmask(hashpower)] = it;
     }
 
-    hash_items++;
-    if (! expanding && hash_items > (hashsize(hashpower) * 3) / 2) {
-        assoc_expand();
+    STATS_LOCK();
+    items = ++hash_items;
+    STATS_UNLOCK();
+    if (! expanding && items > (hashsize(hashpower) * 3) / 2) {
+        assoc_start_expand();
     }
 
-    MEMCACHED_ASSOC_INSERT(ITEM_key(it), it->nkey, hash_items);
+    MEMCACHED_ASSOC_INSERT(ITEM_key(it), it->nkey, items);
     return 1;
 }
 
@@ -181,7 +199,9 @@ void assoc_delete(const char *key, const size_t nkey, const uint32_t hv) {
 
     if (*before) {
         item *nxt;
+        STATS_LOCK();
         hash_items--;
+        STATS_UNLOCK();
         /* The DTrace probe cannot be triggered as the last instruction
          * due to possible tail-optimization by the compiler
          */
@@ -202,48 +222,71 @@ static volatile int do_run_maintenance_thread = 1;
 #define DEFAULT_HASH_BULK_MOVE 1
 int hash_bulk_move = DEFAULT_HASH_BULK_MOVE;
 
+/* Buckets are migrated one at a time under the item lock that covers them.
+ * Every key in old bucket N hashes to item lock N & item_lock_mask, since
+ * thread_init keeps the item lock table smaller than the hash table, and
+ * both of the new buckets it splits into map to that same lock. */
 static void *assoc_maintenance_thread(void *arg) {
 
     while (do_run_maintenance_thread) {
         int ii = 0;
 
-        /* Lock the cache, and bulk move multiple buckets to the new
-         * hash table. */
-        mutex_lock(&cache_lock);
-
-        for (ii = 0; ii < hash_bulk_move && expanding; ++ii) {
-            item *it, *next;
-            int bucket;
-
-            for (it = old_hashtable[expand_bucket]; NULL != it; it = next) {
-                next = it->h_next;
+        pthread_mutex_lock(&maintenance_lock);
+        while (do_run_maintenance_thread && !started_expanding) {
+            /* We are done expanding.. just wait for next invocation */
+            pthread_cond_wait(&maintenance_cond, &maintenance_lock);
+        }
+        pthread_mutex_unlock(&maintenance_lock);
 
-                bucket = hash(ITEM_key(it), it->nkey, 0) & hashmask(hashpower);
-                it->h_next = primary_hashtable[bucket];
-                primary_hashtable[bucket] = it;
-            }
+        if (!do_run_maintenance_thread)
+            break;
 
-            old_hashtable[expand_bucket] = NULL;
-
-            expand_bucket++;
-            if (expand_bucket == hashsize(hashpower - 1)) {
-                expanding = false;
-                free(old_hashtable);
-                STATS_LOCK();
-                stats.hash_bytes -= hashsize(hashpower - 1) * sizeof(void *);
-                stats.hash_is_expanding = 0;
-                STATS_UNLOCK();
-                if (settings.verbose > 1)
-                    fprintf(stderr, "Hash table expansion done\n");
+        /* Swapping the tables changes hashpower, which every item lock
+         * holder reads, so it is the one step done under all of them. */
+        item_lock_all();
+        assoc_expand();
+        item_unlock_all();
+
+        while (expanding && do_run_maintenance_thread) {
+            /* Bulk move multiple buckets to the new hash table. */
+            for (ii = 0; ii < hash_bulk_move && expanding; ++ii) {
+                item *it, *next;
+                int bucket;
+                unsigned int moving = expand_bucket;
+
+                item_lock(moving);
+
+                for (it = old_hashtable[moving]; NULL != it; it = next) {
+                    next = it->h_next;
+
+                    bucket = hash(ITEM_key(it), it->nkey, 0) & hashmask(hashpower);
+                    it->h_next = primary_hashtable[bucket];
+                    primary_hashtable[bucket] = it;
+                }
+
+                old_hashtable[moving] = NULL;
+
+                expand_bucket = moving + 1;
+                if (expand_bucket == hashsize(hashpower - 1)) {
+                    /* Readers only look at old buckets at or past
+                     * expand_bucket, and this was the last one. */
+                    expanding = false;
+                    free(old_hashtable);
+                    STATS_LOCK();
+                    stats.hash_bytes -= hashsize(hashpower - 1) * sizeof(void *);
+                    stats.hash_is_expanding = 0;
+                    STATS_UNLOCK();
+                    if (settings.verbose > 1)
+                        fprintf(stderr, "Hash table expansion done\n");
+                }
+
+                item_unlock(moving);
             }
         }
 
-        if (!expanding) {
-            /* We are done expanding.. just wait for next invocation */
-            pthread_cond_wait(&maintenance_cond, &cache_lock);
-        }
-
-        pthread_mutex_unlock(&cache_lock);
+        pthread_mutex_lock(&maintenance_lock);
+        started_expanding = false;
+        pthread_mutex_unlock(&maintenance_lock);
     }
     return NULL;
 }
@@ -268,10 +311,10 @@ int start_assoc_maintenance_thread() {
 }
 
 void stop_assoc_maintenance_thread() {
-    mutex_lock(&cache_lock);
+    pthread_mutex_lock(&maintenance_lock);
     do_run_maintenance_thread = 0;
     pthread_cond_signal(&maintenance_cond);
-    pthread_mutex_unlock(&cache_lock);
+    pthread_mutex_unlock(&maintenance_lock);
 
     /* Wait for the maintenance thread to stop */
     pthread_join(maintenance_tid, NULL);
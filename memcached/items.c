@@ -12,6 +12,7 @@
 #include <string.h>
 #include <time.h>
 #include <assert.h>
+#include <pthread.h>
 
 /* Forward Declarations */
 static void item_link_q(item *it);
@@ -25,6 +26,25 @@ static void item_unlink_q(item *it);
 #define ITEM_UPDATE_INTERVAL 60
 
 #define LARGEST_ID POWER_LARGEST
+
+/*
+ * Each slab class keeps three LRUs. New items start in HOT. The LRU
+ * maintainer thread moves tail items out of HOT and WARM once those grow past
+ * their share of the class: items hit since they were linked (it->active)
+ * go to WARM, the rest to COLD. The allocator evicts from COLD, sending items
+ * that were hit while cold back to WARM instead. Without the maintainer
+ * every item lives in COLD and is bumped as a plain LRU.
+ */
+#define HOT_LRU 0
+#define WARM_LRU 1
+#define COLD_LRU 2
+#define NUM_LRUS 3
+#define LRU_ID(id, lru) ((lru) * LARGEST_ID + (id))
+
+/* The crawler walks the LRUs as a placeholder item. Real items always carry
+ * at least the "\r\n" terminator, so nbytes == 0 identifies it. */
+#define ITEM_is_crawler(it) ((it)->nbytes == 0)
+
 typedef struct {
     uint64_t evicted;
     uint64_t evicted_nonzero;
@@ -34,24 +54,36 @@ typedef struct {
     uint64_t tailrepairs;
     uint64_t expired_unfetched;
     uint64_t evicted_unfetched;
+    uint64_t crawler_reclaimed;
+    uint64_t moves_to_cold;
+    uint64_t moves_to_warm;
+    uint64_t moves_within_lru;
 } itemstats_t;
 
-static item *heads[LARGEST_ID];
-static item *tails[LARGEST_ID];
+static item *heads[LARGEST_ID * NUM_LRUS];
+static item *tails[LARGEST_ID * NUM_LRUS];
 static itemstats_t itemstats[LARGEST_ID];
-static unsigned int sizes[LARGEST_ID];
+static unsigned int sizes[LARGEST_ID * NUM_LRUS];
 
 void item_stats_reset(void) {
-    mutex_lock(&cache_lock);
-    memset(itemstats, 0, sizeof(itemstats));
-    pthread_mutex_unlock(&cache_lock);
+    int i;
+    for (i = 0; i < LARGEST_ID; i++) {
+        mutex_lock(&lru_locks[i]);
+        memset(&itemstats[i], 0, sizeof(itemstats_t));
+        pthread_mutex_unlock(&lru_locks[i]);
+    }
 }
 
+static pthread_mutex_t cas_id_lock = PTHREAD_MUTEX_INITIALIZER;
 
 /* Get the next CAS id for a new item. */
 uint64_t get_cas_id(void) {
     static uint64_t cas_id = 0;
-    return ++cas_id;
+    uint64_t next_id;
+    pthread_mutex_lock(&cas_id_lock);
+    next_id = ++cas_id;
+    pthread_mutex_unlock(&cas_id_lock);
+    return next_id;
 }
 
 /* Enable this for reference-count debugging. */
@@ -65,6 +97,23 @@ uint64_t get_cas_id(void) {
 # define DEBUG_REFCNT(it,op) while(0)
 #endif
 
+/* True if the item has expired or was invalidated by flush_all. */
+static bool item_is_dead(const item *it) {
+    rel_time_t oldest_live = settings.oldest_live;
+    return (it->exptime != 0 && it->exptime < current_time)
+        || (it->time <= oldest_live && oldest_live <= current_time);
+}
+
+/* Segment the allocator evicts from: COLD, or the next one up while it is
+ * empty. */
+static int lru_evict_from(const unsigned int id) {
+    if (sizes[LRU_ID(id, COLD_LRU)] != 0)
+        return COLD_LRU;
+    if (sizes[LRU_ID(id, WARM_LRU)] != 0)
+        return WARM_LRU;
+    return HOT_LRU;
+}
+
 /**
  * Generates the variable-sized part of the header for an object.
  *
@@ -98,15 +147,41 @@ item *do_item_alloc(char *key, const size_t nkey, const int flags, const rel_tim
     if (id == 0)
         return 0;
 
-    mutex_lock(&cache_lock);
+    mutex_lock(&lru_locks[id]);
     /* do a quick check if we have any expired items in the tail.. */
-    item *search;
-    rel_time_t oldest_live = settings.oldest_live;
+    item *search, *prev;
+    void *hold_lock = NULL;
+    uint32_t hv = 0;
+    int tries = 5;
+    int lru = lru_evict_from(id);
+
+    /* The tail item has to be item-locked before its refcount can be trusted.
+     * The caller may already hold an item lock and the lock order is
+     * item_lock, lru_locks, slabs_lock, so only try the lock and walk up a
+     * few items past the ones that are busy. */
+    for (search = tails[LRU_ID(id, lru)]; search != NULL && tries > 0;
+         search = prev, tries--) {
+        prev = search->prev;
+        if (ITEM_is_crawler(search))
+            continue;
+        if (lru == COLD_LRU && search->active) {
+            /* Hit since it went cold: another pass through WARM instead */
+            item_unlink_q(search);
+            search->lru = WARM_LRU;
+            search->active = 0;
+            item_link_q(search);
+            itemstats[id].moves_to_warm++;
+            continue;
+        }
+        hv = hash(ITEM_key(search), search->nkey, 0);
+        if ((hold_lock = item_trylock(hv)) != NULL)
+            break;
+    }
+    if (hold_lock == NULL)
+        search = NULL;
 
-    search = tails[id];
     if (search != NULL && (refcount_incr(&search->refcount) == 2)) {
-        if ((search->exptime != 0 && search->exptime < current_time)
-            || (search->time <= oldest_live && oldest_live <= current_time)) {  // dead by flush
+        if (item_is_dead(search)) {
             STATS_LOCK();
             stats.reclaimed++;
             STATS_UNLOCK();
@@ -119,13 +194,15 @@ item *do_item_alloc(char *key, const size_t nkey, const int flags, const rel_tim
             }
             it = search;
             slabs_adjust_mem_requested(it->slabs_clsid, ITEM_ntotal(it), ntotal);
-            do_item_unlink_nolock(it, hash(ITEM_key(it), it->nkey, 0));
+            do_item_unlink_nolock(it, hv);
             /* Initialize the item block: */
             it->slabs_clsid = 0;
         } else if ((it = slabs_alloc(ntotal, id)) == NULL) {
             if (settings.evict_to_free == 0) {
                 itemstats[id].outofmemory++;
-                pthread_mutex_unlock(&cache_lock);
+                refcount_decr(&search->refcount);
+                item_trylock_unlock(hold_lock);
+                pthread_mutex_unlock(&lru_locks[id]);
                 return NULL;
             }
             itemstats[id].evicted++;
@@ -143,7 +220,7 @@ item *do_item_alloc(char *key, const size_t nkey, const int flags, const rel_tim
             STATS_UNLOCK();
             it = search;
             slabs_adjust_mem_requested(it->slabs_clsid, ITEM_ntotal(it), ntotal);
-            do_item_unlink_nolock(it, hash(ITEM_key(it), it->nkey, 0));
+            do_item_unlink_nolock(it, hv);
             /* Initialize the item block: */
             it->slabs_clsid = 0;
         } else {
@@ -169,22 +246,27 @@ item *do_item_alloc(char *key, const size_t nkey, const int flags, const rel_tim
             search->time + TAIL_REPAIR_TIME < current_time) {
             itemstats[id].tailrepairs++;
             search->refcount = 1;
-            do_item_unlink_nolock(search, hash(ITEM_key(search), search->nkey, 0));
+            do_item_unlink_nolock(search, hv);
         }
-        pthread_mutex_unlock(&cache_lock);
+        if (hold_lock != NULL)
+            item_trylock_unlock(hold_lock);
+        pthread_mutex_unlock(&lru_locks[id]);
         return NULL;
     }
+    if (hold_lock != NULL)
+        item_trylock_unlock(hold_lock);
 
     assert(it->slabs_clsid == 0);
-    assert(it != heads[id]);
 
     /* Item initialization can happen outside of the lock; the item's already
      * been removed from the slab LRU.
      */
     it->refcount = 1;     /* the caller will have a reference */
-    pthread_mutex_unlock(&cache_lock);
+    pthread_mutex_unlock(&lru_locks[id]);
     it->next = it->prev = it->h_next = 0;
     it->slabs_clsid = id;
+    it->lru = settings.lru_maintainer_thread ? HOT_LRU : COLD_LRU;
+    it->active = 0;
 
     DEBUG_REFCNT(it, '*');
     it->it_flags = settings.use_cas ? ITEM_CAS : 0;
@@ -201,8 +283,8 @@ void item_free(item *it) {
     size_t ntotal = ITEM_ntotal(it);
     unsigned int clsid;
     assert((it->it_flags & ITEM_LINKED) == 0);
-    assert(it != heads[it->slabs_clsid]);
-    assert(it != tails[it->slabs_clsid]);
+    assert(it != heads[LRU_ID(it->slabs_clsid, it->lru)]);
+    assert(it != tails[LRU_ID(it->slabs_clsid, it->lru)]);
     assert(it->refcount == 0);
 
     /* so slab size changer can tell later if item is already free or not */
@@ -232,10 +314,11 @@ bool item_size_ok(const size_t nkey, const int flags, const int nbytes) {
 static void item_link_q(item *it) { /* item is the new head */
     item **head, **tail;
     assert(it->slabs_clsid < LARGEST_ID);
+    assert(it->lru < NUM_LRUS);
     assert((it->it_flags & ITEM_SLABBED) == 0);
 
-    head = &heads[it->slabs_clsid];
-    tail = &tails[it->slabs_clsid];
+    head = &heads[LRU_ID(it->slabs_clsid, it->lru)];
+    tail = &tails[LRU_ID(it->slabs_clsid, it->lru)];
     assert(it != *head);
     assert((*head && *tail) || (*head == 0 && *tail == 0));
     it->prev = 0;
@@ -243,15 +326,16 @@ static void item_link_q(item *it) { /* item is the new head */
     if (it->next) it->next->prev = it;
     *head = it;
     if (*tail == 0) *tail = it;
-    sizes[it->slabs_clsid]++;
+    sizes[LRU_ID(it->slabs_clsid, it->lru)]++;
     return;
 }
 
 static void item_unlink_q(item *it) {
     item **head, **tail;
     assert(it->slabs_clsid < LARGEST_ID);
-    head = &heads[it->slabs_clsid];
-    tail = &tails[it->slabs_clsid];
+    assert(it->lru < NUM_LRUS);
+    head = &heads[LRU_ID(it->slabs_clsid, it->lru)];
+    tail = &tails[LRU_ID(it->slabs_clsid, it->lru)];
 
     if (*head == it) {
         assert(it->prev == 0);
@@ -266,15 +350,13 @@ static void item_unlink_q(item *it) {
 
     if (it->next) it->next->prev = it->prev;
     if (it->prev) it->prev->next = it->next;
-    sizes[it->slabs_clsid]--;
+    sizes[LRU_ID(it->slabs_clsid, it->lru)]--;
     return;
 }
 
 int do_item_link(item *it, const uint32_t hv) {
     MEMCACHED_ITEM_LINK(ITEM_key(it), it->nkey, it->nbytes);
     assert((it->it_flags & (ITEM_LINKED|ITEM_SLABBED)) == 0);
-    mutex_lock(&cache_lock);
-    it->it_flags |= ITEM_LINKED;
     it->time = current_time;
 
     STATS_LOCK();
@@ -285,31 +367,34 @@ int do_item_link(item *it, const uint32_t hv) {
 
     /* Allocate a new CAS ID on link. */
     ITEM_set_cas(it, (settings.use_cas) ? get_cas_id() : 0);
+    refcount_incr(&it->refcount);
     assoc_insert(it, hv);
+    mutex_lock(&lru_locks[it->slabs_clsid]);
+    it->it_flags |= ITEM_LINKED;
     item_link_q(it);
-    refcount_incr(&it->refcount);
-    pthread_mutex_unlock(&cache_lock);
+    pthread_mutex_unlock(&lru_locks[it->slabs_clsid]);
 
     return 1;
 }
 
 void do_item_unlink(item *it, const uint32_t hv) {
     MEMCACHED_ITEM_UNLINK(ITEM_key(it), it->nkey, it->nbytes);
-    mutex_lock(&cache_lock);
     if ((it->it_flags & ITEM_LINKED) != 0) {
-        it->it_flags &= ~ITEM_LINKED;
         STATS_LOCK();
         stats.curr_bytes -= ITEM_ntotal(it);
         stats.curr_items -= 1;
         STATS_UNLOCK();
         assoc_delete(ITEM_key(it), it->nkey, hv);
+        mutex_lock(&lru_locks[it->slabs_clsid]);
+        it->it_flags &= ~ITEM_LINKED;
         item_unlink_q(it);
+        pthread_mutex_unlock(&lru_locks[it->slabs_clsid]);
         do_item_remove(it);
     }
-    pthread_mutex_unlock(&cache_lock);
 }
 
-/* FIXME: Is it necessary to keep this copy/pasted code? */
+/* Same as do_item_unlink(), for callers that already hold the LRU lock of
+ * the item's slab class. */
 void do_item_unlink_nolock(item *it, const uint32_t hv) {
     MEMCACHED_ITEM_UNLINK(ITEM_key(it), it->nkey, it->nbytes);
     if ((it->it_flags & ITEM_LINKED) != 0) {
@@ -335,16 +420,29 @@ void do_item_remove(item *it) {
 
 void do_item_update(item *it) {
     MEMCACHED_ITEM_UPDATE(ITEM_key(it), it->nkey, it->nbytes);
+    /* Only marks the item; the maintainer and the allocator act on the mark
+     * when the item reaches the tail of its LRU. */
+    if (settings.lru_maintainer_thread && !it->active) {
+        it->active = 1;
+    }
     if (it->time < current_time - ITEM_UPDATE_INTERVAL) {
         assert((it->it_flags & ITEM_SLABBED) == 0);
 
-        mutex_lock(&cache_lock);
-        if ((it->it_flags & ITEM_LINKED) != 0) {
+        /* Readers never wait for the LRU. If another thread is working on
+         * this slab class the bump is skipped, and the next hit on the item
+         * will try again. */
+        if (pthread_mutex_trylock(&lru_locks[it->slabs_clsid]) != 0)
+            return;
+        if ((it->it_flags & ITEM_LINKED) == 0) {
+            /* Unlinked while we were waiting */
+        } else if (settings.lru_maintainer_thread) {
+            it->time = current_time;
+        } else {
             item_unlink_q(it);
             it->time = current_time;
             item_link_q(it);
         }
-        pthread_mutex_unlock(&cache_lock);
+        pthread_mutex_unlock(&lru_locks[it->slabs_clsid]);
     }
 }
 
@@ -369,16 +467,28 @@ char *do_item_cachedump(const unsigned int slabs_clsid, const unsigned int limit
     item *it;
     unsigned int len;
     unsigned int shown = 0;
+    int lru = HOT_LRU;
     char key_temp[KEY_MAX_LENGTH + 1];
     char temp[512];
 
-    it = heads[slabs_clsid];
+    it = heads[LRU_ID(slabs_clsid, lru)];
 
     buffer = malloc((size_t)memlimit);
     if (buffer == 0) return NULL;
     bufcurr = 0;
 
-    while (it != NULL && (limit == 0 || shown < limit)) {
+    while (limit == 0 || shown < limit) {
+        if (it == NULL) {
+            /* Dump the segments in order, HOT to COLD */
+            if (++lru == NUM_LRUS)
+                break;
+            it = heads[LRU_ID(slabs_clsid, lru)];
+            continue;
+        }
+        if (ITEM_is_crawler(it)) {
+            it = it->next;
+            continue;
+        }
         assert(it->nkey <= KEY_MAX_LENGTH);
         /* Copy the key since it may not be null-terminated in the struct */
         strncpy(key_temp, ITEM_key(it), it->nkey);
@@ -403,27 +513,37 @@ char *do_item_cachedump(const unsigned int slabs_clsid, const unsigned int limit
 
 void item_stats_evictions(uint64_t *evicted) {
     int i;
-    mutex_lock(&cache_lock);
     for (i = 0; i < LARGEST_ID; i++) {
+        mutex_lock(&lru_locks[i]);
         evicted[i] = itemstats[i].evicted;
+        pthread_mutex_unlock(&lru_locks[i]);
     }
-    pthread_mutex_unlock(&cache_lock);
 }
 
 void do_item_stats(ADD_STAT add_stats, void *c) {
     int i;
     for (i = 0; i < LARGEST_ID; i++) {
-        if (tails[i] != NULL) {
+        unsigned int hot, warm, cold;
+        mutex_lock(&lru_locks[i]);
+        hot = sizes[LRU_ID(i, HOT_LRU)];
+        warm = sizes[LRU_ID(i, WARM_LRU)];
+        cold = sizes[LRU_ID(i, COLD_LRU)];
+        if (hot + warm + cold != 0) {
             const char *fmt = "items:%d:%s";
             char key_str[STAT_KEY_LEN];
             char val_str[STAT_VAL_LEN];
             int klen = 0, vlen = 0;
-            if (tails[i] == NULL) {
-                /* We removed all of the items in this slab class */
-                continue;
+            item *oldest = tails[LRU_ID(i, lru_evict_from(i))];
+            while (oldest != NULL && ITEM_is_crawler(oldest))
+                oldest = oldest->prev;
+            APPEND_NUM_FMT_STAT(fmt, i, "number", "%u", hot + warm + cold);
+            if (settings.lru_maintainer_thread) {
+                APPEND_NUM_FMT_STAT(fmt, i, "number_hot", "%u", hot);
+                APPEND_NUM_FMT_STAT(fmt, i, "number_warm", "%u", warm);
+                APPEND_NUM_FMT_STAT(fmt, i, "number_cold", "%u", cold);
             }
-            APPEND_NUM_FMT_STAT(fmt, i, "number", "%u", sizes[i]);
-            APPEND_NUM_FMT_STAT(fmt, i, "age", "%u", current_time - tails[i]->time);
+            APPEND_NUM_FMT_STAT(fmt, i, "age", "%u",
+                                oldest ? current_time - oldest->time : 0);
             APPEND_NUM_FMT_STAT(fmt, i, "evicted",
                                 "%llu", (unsigned long long)itemstats[i].evicted);
             APPEND_NUM_FMT_STAT(fmt, i, "evicted_nonzero",
@@ -440,7 +560,20 @@ void do_item_stats(ADD_STAT add_stats, void *c) {
                                 "%llu", (unsigned long long)itemstats[i].expired_unfetched);
             APPEND_NUM_FMT_STAT(fmt, i, "evicted_unfetched",
                                 "%llu", (unsigned long long)itemstats[i].evicted_unfetched);
+            if (settings.lru_crawler) {
+                APPEND_NUM_FMT_STAT(fmt, i, "crawler_reclaimed",
+                                    "%llu", (unsigned long long)itemstats[i].crawler_reclaimed);
+            }
+            if (settings.lru_maintainer_thread) {
+                APPEND_NUM_FMT_STAT(fmt, i, "moves_to_cold",
+                                    "%llu", (unsigned long long)itemstats[i].moves_to_cold);
+                APPEND_NUM_FMT_STAT(fmt, i, "moves_to_warm",
+                                    "%llu", (unsigned long long)itemstats[i].moves_to_warm);
+                APPEND_NUM_FMT_STAT(fmt, i, "moves_within_lru",
+                                    "%llu", (unsigned long long)itemstats[i].moves_within_lru);
+            }
         }
+        pthread_mutex_unlock(&lru_locks[i]);
     }
 
     /* getting here means both ascii and binary terminators fit */
@@ -459,15 +592,19 @@ void do_item_stats_sizes(ADD_STAT add_stats, void *c) {
         int i;
 
         /* build the histogram */
-        for (i = 0; i < LARGEST_ID; i++) {
+        for (i = 0; i < LARGEST_ID * NUM_LRUS; i++) {
+            mutex_lock(&lru_locks[i % LARGEST_ID]);
             item *iter = heads[i];
             while (iter) {
-                int ntotal = ITEM_ntotal(iter);
-                int bucket = ntotal / 32;
-                if ((ntotal % 32) != 0) bucket++;
-                if (bucket < num_buckets) histogram[bucket]++;
+                if (!ITEM_is_crawler(iter)) {
+                    int ntotal = ITEM_ntotal(iter);
+                    int bucket = ntotal / 32;
+                    if ((ntotal % 32) != 0) bucket++;
+                    if (bucket < num_buckets) histogram[bucket]++;
+                }
                 iter = iter->next;
             }
+            pthread_mutex_unlock(&lru_locks[i % LARGEST_ID]);
         }
 
         /* write the buffer */
@@ -485,21 +622,19 @@ void do_item_stats_sizes(ADD_STAT add_stats, void *c) {
 
 /** wrapper around assoc_find which does the lazy expiration logic */
 item *do_item_get(const char *key, const size_t nkey, const uint32_t hv) {
-    mutex_lock(&cache_lock);
     item *it = assoc_find(key, nkey, hv);
     if (it != NULL) {
         refcount_incr(&it->refcount);
         /* Optimization for slab reassignment. prevents popular items from
          * jamming in busy wait. Can only do this here to satisfy lock order
-         * of item_lock, cache_lock, slabs_lock. */
+         * of item_lock, lru_locks, slabs_lock. */
         if (slab_rebalance_signal &&
             ((void *)it >= slab_rebal.slab_start && (void *)it < slab_rebal.slab_end)) {
-            do_item_unlink_nolock(it, hv);
+            do_item_unlink(it, hv);
             do_item_remove(it);
             it = NULL;
         }
     }
-    pthread_mutex_unlock(&cache_lock);
     int was_found = 0;
 
     if (settings.verbose > 2) {
@@ -554,22 +689,434 @@ void do_item_flush_expired(void) {
     item *iter, *next;
     if (settings.oldest_live == 0)
         return;
-    for (i = 0; i < LARGEST_ID; i++) {
+    for (i = 0; i < LARGEST_ID * NUM_LRUS; i++) {
         /* The LRU is sorted in decreasing time order, and an item's timestamp
          * is never newer than its last access time, so we only need to walk
          * back until we hit an item older than the oldest_live time.
          * The oldest_live checking will auto-expire the remaining items.
+         * Items whose item lock is busy are left for that lazy check too.
+         * The maintainer moves items between the segments by position, not
+         * time, so with it running every segment is walked in full.
          */
+        mutex_lock(&lru_locks[i % LARGEST_ID]);
         for (iter = heads[i]; iter != NULL; iter = next) {
-            if (iter->time >= settings.oldest_live) {
+            if (ITEM_is_crawler(iter)) {
+                next = iter->next;
+            } else if (iter->time >= settings.oldest_live) {
                 next = iter->next;
                 if ((iter->it_flags & ITEM_SLABBED) == 0) {
-                    do_item_unlink_nolock(iter, hash(ITEM_key(iter), iter->nkey, 0));
+                    uint32_t hv = hash(ITEM_key(iter), iter->nkey, 0);
+                    void *hold_lock = item_trylock(hv);
+                    if (hold_lock != NULL) {
+                        do_item_unlink_nolock(iter, hv);
+                        item_trylock_unlock(hold_lock);
+                    }
                 }
+            } else if (settings.lru_maintainer_thread) {
+                next = iter->next;
             } else {
                 /* We've hit the first old item. Continue to the next queue. */
                 break;
             }
         }
+        pthread_mutex_unlock(&lru_locks[i % LARGEST_ID]);
+    }
+}
+
+/*** LRU MAINTAINER AND CRAWLER ***/
+
+/* Frees a dead item found on an LRU. Called with the item's LRU lock held,
+ * so the item lock can only be tried. Returns true if the item was freed. */
+static bool lru_reclaim_dead(item *it) {
+    uint32_t hv = hash(ITEM_key(it), it->nkey, 0);
+    void *hold_lock = item_trylock(hv);
+    bool freed = false;
+
+    if (hold_lock == NULL)
+        return false;
+    /* Only free items nobody else is holding a reference to */
+    if (refcount_incr(&it->refcount) == 2 && item_is_dead(it)) {
+        if ((it->it_flags & ITEM_FETCHED) == 0) {
+            STATS_LOCK();
+            stats.expired_unfetched++;
+            STATS_UNLOCK();
+            itemstats[it->slabs_clsid].expired_unfetched++;
+        }
+        do_item_unlink_nolock(it, hv);
+        do_item_remove(it);
+        freed = true;
+    } else {
+        refcount_decr(&it->refcount);
+    }
+    item_trylock_unlock(hold_lock);
+    return freed;
+}
+
+/* Moves one item off the tail of a segment: dead items are freed, items that
+ * were hit go to WARM and the rest of HOT and WARM goes to COLD. Items in
+ * COLD only move if they were hit; the allocator evicts the others.
+ * Called with lru_locks[id] held. Returns the number of items moved. */
+static int lru_pull_tail(const int id, const int lru) {
+    item *search, *prev;
+    int tries = 5;
+    int move_to = -1;
+
+    for (search = tails[LRU_ID(id, lru)]; search != NULL && tries > 0;
+         search = prev, tries--) {
+        prev = search->prev;
+        if (ITEM_is_crawler(search))
+            continue;
+        if (item_is_dead(search) && lru_reclaim_dead(search)) {
+            STATS_LOCK();
+            stats.reclaimed++;
+            STATS_UNLOCK();
+            itemstats[id].reclaimed++;
+            return 1;
+        }
+        if (search->active) {
+            move_to = WARM_LRU;
+            if (lru == WARM_LRU) {
+                itemstats[id].moves_within_lru++;
+            } else {
+                itemstats[id].moves_to_warm++;
+            }
+        } else if (lru != COLD_LRU) {
+            move_to = COLD_LRU;
+            itemstats[id].moves_to_cold++;
+        } else {
+            return 0;
+        }
+        item_unlink_q(search);
+        search->lru = move_to;
+        search->active = 0;
+        item_link_q(search);
+        return 1;
+    }
+    return 0;
+}
+
+#define LRU_MAINTAINER_BATCH 100
+
+/* Brings HOT and WARM of a slab class back under their share of the class.
+ * The LRU lock is dropped between moves so allocations are not held off. */
+static int lru_maintainer_juggle(const int id) {
+    int i;
+    int did_moves = 0;
+
+    for (i = 0; i < LRU_MAINTAINER_BATCH; i++) {
+        int moved = 0;
+        unsigned int total, hot_limit, warm_limit;
+        mutex_lock(&lru_locks[id]);
+        total = sizes[LRU_ID(id, HOT_LRU)] + sizes[LRU_ID(id, WARM_LRU)]
+            + sizes[LRU_ID(id, COLD_LRU)];
+        hot_limit = total * settings.hot_lru_pct / 100;
+        warm_limit = total * settings.warm_lru_pct / 100;
+        if (sizes[LRU_ID(id, HOT_LRU)] > hot_limit)
+            moved += lru_pull_tail(id, HOT_LRU);
+        if (sizes[LRU_ID(id, WARM_LRU)] > warm_limit)
+            moved += lru_pull_tail(id, WARM_LRU);
+        moved += lru_pull_tail(id, COLD_LRU);
+        pthread_mutex_unlock(&lru_locks[id]);
+        if (moved == 0)
+            break;
+        did_moves += moved;
+    }
+    return did_moves;
+}
+
+static pthread_t lru_maintainer_tid;
+static volatile int do_run_lru_maintainer_thread = 0;
+
+#define MAX_LRU_MAINTAINER_SLEEP 1000000
+#define MIN_LRU_MAINTAINER_SLEEP 1000
+
+#ifndef __INTEL_COMPILER
+#pragma GCC diagnostic ignored "-Wunused-parameter"
+#endif
+/* Sleeps longer while there is nothing to move, and shorter while it keeps
+ * finding work. */
+static void *lru_maintainer_thread(void *arg) {
+    int i;
+    useconds_t to_sleep = MIN_LRU_MAINTAINER_SLEEP;
+
+    if (settings.verbose > 2)
+        fprintf(stderr, "Starting LRU maintainer background thread\n");
+    while (do_run_lru_maintainer_thread) {
+        int did_moves = 0;
+        usleep(to_sleep);
+        STATS_LOCK();
+        stats.lru_maintainer_juggles++;
+        STATS_UNLOCK();
+        for (i = POWER_SMALLEST; i < LARGEST_ID; i++) {
+            did_moves += lru_maintainer_juggle(i);
+        }
+        if (did_moves == 0) {
+            if (to_sleep < MAX_LRU_MAINTAINER_SLEEP)
+                to_sleep += 1000;
+        } else {
+            to_sleep /= 2;
+            if (to_sleep < MIN_LRU_MAINTAINER_SLEEP)
+                to_sleep = MIN_LRU_MAINTAINER_SLEEP;
+        }
+    }
+    if (settings.verbose > 2)
+        fprintf(stderr, "LRU maintainer thread stopping\n");
+    return NULL;
+}
+
+int start_lru_maintainer_thread(void) {
+    int ret;
+
+    do_run_lru_maintainer_thread = 1;
+    if ((ret = pthread_create(&lru_maintainer_tid, NULL,
+                              lru_maintainer_thread, NULL)) != 0) {
+        fprintf(stderr, "Can't create LRU maintainer thread: %s\n",
+                strerror(ret));
+        do_run_lru_maintainer_thread = 0;
+        return -1;
+    }
+    return 0;
+}
+
+void stop_lru_maintainer_thread(void) {
+    if (!do_run_lru_maintainer_thread)
+        return;
+    do_run_lru_maintainer_thread = 0;
+    pthread_join(lru_maintainer_tid, NULL);
+}
+
+/* The crawler is a fake item linked into an LRU. Each step swaps it with the
+ * item above it, so the LRU lock is held for one item at a time and the
+ * crawl survives the other threads changing the list in between. Crawlers
+ * are not counted in sizes[]. */
+static item *crawlers[LARGEST_ID * NUM_LRUS];
+static uint32_t crawler_remaining[LARGEST_ID * NUM_LRUS];
+static int crawler_count = 0;
+
+static pthread_t item_crawler_tid;
+static volatile int do_run_lru_crawler_thread = 0;
+static pthread_mutex_t lru_crawler_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t lru_crawler_cond = PTHREAD_COND_INITIALIZER;
+
+static void crawler_link_q(item *it) { /* crawler starts at the tail */
+    item **head, **tail;
+    head = &heads[LRU_ID(it->slabs_clsid, it->lru)];
+    tail = &tails[LRU_ID(it->slabs_clsid, it->lru)];
+    it->next = 0;
+    it->prev = *tail;
+    if (*tail != 0) (*tail)->next = it;
+    *tail = it;
+    if (*head == 0) *head = it;
+}
+
+static void crawler_unlink_q(item *it) {
+    item **head, **tail;
+    head = &heads[LRU_ID(it->slabs_clsid, it->lru)];
+    tail = &tails[LRU_ID(it->slabs_clsid, it->lru)];
+    if (*head == it) *head = it->next;
+    if (*tail == it) *tail = it->prev;
+    if (it->next) it->next->prev = it->prev;
+    if (it->prev) it->prev->next = it->next;
+    it->next = it->prev = 0;
+}
+
+/* Moves the crawler up past the next item and returns that item, or unlinks
+ * the crawler and returns NULL once it reaches the head. */
+static item *crawler_crawl_q(item *it) {
+    item *above = it->prev;
+
+    crawler_unlink_q(it);
+    if (above == NULL)
+        return NULL;
+    it->next = above;
+    it->prev = above->prev;
+    if (above->prev) {
+        above->prev->next = it;
+    } else {
+        heads[LRU_ID(it->slabs_clsid, it->lru)] = it;
+    }
+    above->prev = it;
+    return above;
+}
+
+/* One step for every active crawler. Called with lru_crawler_lock held. */
+static void lru_crawler_pass(void) {
+    int i;
+    for (i = 0; i < LARGEST_ID * NUM_LRUS; i++) {
+        item *crawler = crawlers[i];
+        item *search;
+        if ((crawler->it_flags & ITEM_LINKED) == 0)
+            continue;
+        mutex_lock(&lru_locks[i % LARGEST_ID]);
+        if (settings.lru_crawler_tocrawl != 0
+            && crawler_remaining[i]-- == 0) {
+            crawler_unlink_q(crawler);
+            search = NULL;
+        } else {
+            search = crawler_crawl_q(crawler);
+        }
+        if (search == NULL) {
+            crawler->it_flags = 0;
+            crawler_count--;
+            if (settings.verbose > 2)
+                fprintf(stderr, "LRU crawler done with %d\n", i);
+        } else if (!ITEM_is_crawler(search) && item_is_dead(search)
+                   && lru_reclaim_dead(search)) {
+            STATS_LOCK();
+            stats.crawler_reclaimed++;
+            STATS_UNLOCK();
+            itemstats[i % LARGEST_ID].crawler_reclaimed++;
+        }
+        pthread_mutex_unlock(&lru_locks[i % LARGEST_ID]);
+    }
+}
+
+/* Links a crawler at the tail of every segment of the class. Called with
+ * lru_crawler_lock held. Returns the number of crawlers started. */
+static int do_lru_crawler_start(const int id) {
+    int lru;
+    int starts = 0;
+    mutex_lock(&lru_locks[id]);
+    for (lru = HOT_LRU; lru < NUM_LRUS; lru++) {
+        int i = LRU_ID(id, lru);
+        item *crawler = crawlers[i];
+        if ((crawler->it_flags & ITEM_LINKED) != 0 || tails[i] == NULL)
+            continue;
+        crawler->slabs_clsid = id;
+        crawler->lru = lru;
+        crawler->nbytes = 0;
+        crawler->it_flags = ITEM_LINKED;
+        crawler_remaining[i] = settings.lru_crawler_tocrawl;
+        crawler_link_q(crawler);
+        crawler_count++;
+        starts++;
+    }
+    pthread_mutex_unlock(&lru_locks[id]);
+    return starts;
+}
+
+static void *item_crawler_thread(void *arg) {
+    mutex_lock(&lru_crawler_lock);
+    if (settings.verbose > 2)
+        fprintf(stderr, "Starting LRU crawler background thread\n");
+    while (do_run_lru_crawler_thread) {
+        if (crawler_count == 0) {
+            struct timeval now;
+            struct timespec wake;
+            int i;
+            gettimeofday(&now, NULL);
+            wake.tv_sec = now.tv_sec + LRU_CRAWLER_INTERVAL;
+            wake.tv_nsec = now.tv_usec * 1000;
+            if (pthread_cond_timedwait(&lru_crawler_cond, &lru_crawler_lock,
+                                       &wake) == ETIMEDOUT
+                && crawler_count == 0) {
+                for (i = POWER_SMALLEST; i < LARGEST_ID; i++)
+                    do_lru_crawler_start(i);
+            }
+            continue;
+        }
+
+        STATS_LOCK();
+        stats.lru_crawler_running = true;
+        stats.lru_crawler_starts++;
+        STATS_UNLOCK();
+        while (crawler_count > 0 && do_run_lru_crawler_thread) {
+            lru_crawler_pass();
+            pthread_mutex_unlock(&lru_crawler_lock);
+            if (settings.lru_crawler_sleep)
+                usleep(settings.lru_crawler_sleep);
+            mutex_lock(&lru_crawler_lock);
+        }
+        STATS_LOCK();
+        stats.lru_crawler_running = false;
+        STATS_UNLOCK();
+    }
+    pthread_mutex_unlock(&lru_crawler_lock);
+    if (settings.verbose > 2)
+        fprintf(stderr, "LRU crawler thread stopping\n");
+    return NULL;
+}
+
+int start_item_crawler_thread(void) {
+    int i, ret;
+
+    for (i = 0; i < LARGEST_ID * NUM_LRUS; i++) {
+        if (crawlers[i] == NULL &&
+            (crawlers[i] = calloc(1, sizeof(item))) == NULL) {
+            fprintf(stderr, "Can't allocate LRU crawlers\n");
+            return -1;
+        }
+    }
+    do_run_lru_crawler_thread = 1;
+    if ((ret = pthread_create(&item_crawler_tid, NULL,
+                              item_crawler_thread, NULL)) != 0) {
+        fprintf(stderr, "Can't create LRU crawler thread: %s\n",
+                strerror(ret));
+        do_run_lru_crawler_thread = 0;
+        return -1;
+    }
+    return 0;
+}
+
+void stop_item_crawler_thread(void) {
+    int i;
+
+    if (!do_run_lru_crawler_thread)
+        return;
+    mutex_lock(&lru_crawler_lock);
+    do_run_lru_crawler_thread = 0;
+    pthread_cond_signal(&lru_crawler_cond);
+    pthread_mutex_unlock(&lru_crawler_lock);
+    pthread_join(item_crawler_tid, NULL);
+
+    /* Take any crawler still walking an LRU back out */
+    for (i = 0; i < LARGEST_ID * NUM_LRUS; i++) {
+        if ((crawlers[i]->it_flags & ITEM_LINKED) == 0)
+            continue;
+        mutex_lock(&lru_locks[i % LARGEST_ID]);
+        crawler_unlink_q(crawlers[i]);
+        crawlers[i]->it_flags = 0;
+        pthread_mutex_unlock(&lru_locks[i % LARGEST_ID]);
+    }
+    crawler_count = 0;
+}
+
+/* Starts a crawl of "all" classes or of a comma separated list of class ids.
+ * A crawl already in progress has to finish before a new one is accepted. */
+enum crawler_result_type lru_crawler_crawl(char *slabs) {
+    char *b = NULL;
+    char *p;
+    uint32_t sid;
+    int starts = 0;
+    bool tocrawl[LARGEST_ID];
+
+    if (!do_run_lru_crawler_thread)
+        return CRAWLER_NOTSTARTED;
+    memset(tocrawl, 0, sizeof(tocrawl));
+    if (strcmp(slabs, "all") == 0) {
+        for (sid = POWER_SMALLEST; sid < LARGEST_ID; sid++)
+            tocrawl[sid] = true;
+    } else {
+        for (p = strtok_r(slabs, ",", &b); p != NULL;
+             p = strtok_r(NULL, ",", &b)) {
+            if (!safe_strtoul(p, &sid) || sid < POWER_SMALLEST
+                || sid >= LARGEST_ID)
+                return CRAWLER_BADCLASS;
+            tocrawl[sid] = true;
+        }
+    }
+
+    mutex_lock(&lru_crawler_lock);
+    if (crawler_count != 0) {
+        pthread_mutex_unlock(&lru_crawler_lock);
+        return CRAWLER_RUNNING;
+    }
+    for (sid = POWER_SMALLEST; sid < LARGEST_ID; sid++) {
+        if (tocrawl[sid])
+            starts += do_lru_crawler_start(sid);
     }
+    if (starts != 0)
+        pthread_cond_signal(&lru_crawler_cond);
+    pthread_mutex_unlock(&lru_crawler_lock);
+    return starts != 0 ? CRAWLER_OK : CRAWLER_NOTSTARTED;
 }
@@ -23,5 +23,19 @@ void do_item_flush_expired(void);
 item *do_item_get(const char *key, const size_t nkey, const uint32_t hv);
 item *do_item_touch(const char *key, const size_t nkey, uint32_t exptime, const uint32_t hv);
 void item_stats_reset(void);
-extern pthread_mutex_t cache_lock;
+extern pthread_mutex_t lru_locks[POWER_LARGEST];
 void item_stats_evictions(uint64_t *evicted);
+
+int start_lru_maintainer_thread(void);
+void stop_lru_maintainer_thread(void);
+
+/* Seconds between crawls of every class when nobody asks for one. */
+#define LRU_CRAWLER_INTERVAL 60
+
+enum crawler_result_type {
+    CRAWLER_OK=0, CRAWLER_RUNNING, CRAWLER_BADCLASS, CRAWLER_NOTSTARTED
+};
+
+int start_item_crawler_thread(void);
+void stop_item_crawler_thread(void);
+enum crawler_result_type lru_crawler_crawl(char *slabs);
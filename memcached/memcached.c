@@ -124,6 +124,10 @@ static enum transmit_result transmit(conn *c);
  * can block the listener via a condition.
  */
 static volatile bool allow_new_conns = true;
+/* Bumped whenever a connection closes. A worker whose reuseport listeners
+ * ran out of fds waits for it to move, without touching allow_new_conns,
+ * which belongs to the main thread's listeners. */
+static volatile unsigned int conns_closed = 0;
 static struct event maxconnsevent;
 #ifndef __INTEL_COMPILER
 #pragma GCC diagnostic ignored "-Wunused-parameter"
@@ -179,6 +183,9 @@ static void stats_init(void) {
     stats.slabs_moved = 0;
     stats.accepting_conns = true; /* assuming we start in this state. */
     stats.slab_reassign_running = false;
+    stats.lru_crawler_running = false;
+    stats.lru_crawler_starts = stats.crawler_reclaimed = 0;
+    stats.lru_maintainer_juggles = 0;
 
     /* make the time we started always be 2 seconds before we really
        did, so time(0) - time.started is never zero.  if so, things
@@ -228,6 +235,14 @@ static void settings_init(void) {
     settings.hashpower_init = 0;
     settings.slab_reassign = false;
     settings.slab_automove = false;
+    settings.lru_maintainer_thread = false;
+    settings.hot_lru_pct = 32;
+    settings.warm_lru_pct = 32;
+    settings.lru_crawler = false;
+    settings.lru_crawler_sleep = 100;
+    settings.lru_crawler_tocrawl = 0;
+    settings.reuseport = false;
+    settings.incoming_cpu = false;
 }
 
 /*
@@ -453,6 +468,7 @@ conn *conn_new(const int sfd, enum conn_states init_state,
     c->item = 0;
 
     c->noreply = false;
+    c->thread = NULL;
 
     event_set(&c->event, sfd, event_flags, event_handler, (void *)c);
     event_base_set(base, &c->event);
@@ -549,6 +565,7 @@ static void conn_close(conn *c) {
     close(c->sfd);
     pthread_mutex_lock(&conn_lock);
     allow_new_conns = true;
+    conns_closed++;
     pthread_mutex_unlock(&conn_lock);
     conn_cleanup(c);
 
@@ -844,9 +861,7 @@ static void complete_nread_ascii(conn *c) {
     int comm = c->cmd;
     enum store_item_type ret;
 
-    pthread_mutex_lock(&c->thread->stats.mutex);
-    c->thread->stats.slab_stats[it->slabs_clsid].set_cmds++;
-    pthread_mutex_unlock(&c->thread->stats.mutex);
+    THR_STATS_INCR(c->thread->stats.slab_stats[it->slabs_clsid].set_cmds);
 
     if (strncmp(ITEM_data(it) + it->nbytes - 2, "\r\n", 2) != 0) {
         out_string(c, "CLIENT_ERROR bad data chunk");
@@ -1119,13 +1134,11 @@ static void complete_incr_bin(conn *c) {
                 write_bin_error(c, PROTOCOL_BINARY_RESPONSE_ENOMEM, 0);
             }
         } else {
-            pthread_mutex_lock(&c->thread->stats.mutex);
             if (c->cmd == PROTOCOL_BINARY_CMD_INCREMENT) {
-                c->thread->stats.incr_misses++;
+                THR_STATS_INCR(c->thread->stats.incr_misses);
             } else {
-                c->thread->stats.decr_misses++;
+                THR_STATS_INCR(c->thread->stats.decr_misses);
             }
-            pthread_mutex_unlock(&c->thread->stats.mutex);
 
             write_bin_error(c, PROTOCOL_BINARY_RESPONSE_KEY_ENOENT, 0);
         }
@@ -1147,9 +1160,7 @@ static void complete_update_bin(conn *c) {
 
     item *it = c->item;
 
-    pthread_mutex_lock(&c->thread->stats.mutex);
-    c->thread->stats.slab_stats[it->slabs_clsid].set_cmds++;
-    pthread_mutex_unlock(&c->thread->stats.mutex);
+    THR_STATS_INCR(c->thread->stats.slab_stats[it->slabs_clsid].set_cmds);
 
     /* We don't actually receive the trailing two characters in the bin
      * protocol, so we're going to just set them here */
@@ -1240,10 +1251,8 @@ static void process_bin_touch(conn *c) {
         uint32_t bodylen = sizeof(rsp->message.body) + (it->nbytes - 2);
 
         item_update(it);
-        pthread_mutex_lock(&c->thread->stats.mutex);
-        c->thread->stats.touch_cmds++;
-        c->thread->stats.slab_stats[it->slabs_clsid].touch_hits++;
-        pthread_mutex_unlock(&c->thread->stats.mutex);
+        THR_STATS_INCR(c->thread->stats.touch_cmds);
+        THR_STATS_INCR(c->thread->stats.slab_stats[it->slabs_clsid].touch_hits);
 
         MEMCACHED_COMMAND_TOUCH(c->sfd, ITEM_key(it), it->nkey,
                                 it->nbytes, ITEM_get_cas(it));
@@ -1276,10 +1285,8 @@ static void process_bin_touch(conn *c) {
         /* Remember this command so we can garbage collect it later */
         c->item = it;
     } else {
-        pthread_mutex_lock(&c->thread->stats.mutex);
-        c->thread->stats.touch_cmds++;
-        c->thread->stats.touch_misses++;
-        pthread_mutex_unlock(&c->thread->stats.mutex);
+        THR_STATS_INCR(c->thread->stats.touch_cmds);
+        THR_STATS_INCR(c->thread->stats.touch_misses);
 
         MEMCACHED_COMMAND_TOUCH(c->sfd, key, nkey, -1, 0);
 
@@ -1328,10 +1335,8 @@ static void process_bin_get(conn *c) {
         uint32_t bodylen = sizeof(rsp->message.body) + (it->nbytes - 2);
 
         item_update(it);
-        pthread_mutex_lock(&c->thread->stats.mutex);
-        c->thread->stats.get_cmds++;
-        c->thread->stats.slab_stats[it->slabs_clsid].get_hits++;
-        pthread_mutex_unlock(&c->thread->stats.mutex);
+        THR_STATS_INCR(c->thread->stats.get_cmds);
+        THR_STATS_INCR(c->thread->stats.slab_stats[it->slabs_clsid].get_hits);
 
         MEMCACHED_COMMAND_GET(c->sfd, ITEM_key(it), it->nkey,
                               it->nbytes, ITEM_get_cas(it));
@@ -1358,10 +1363,8 @@ static void process_bin_get(conn *c) {
         /* Remember this command so we can garbage collect it later */
         c->item = it;
     } else {
-        pthread_mutex_lock(&c->thread->stats.mutex);
-        c->thread->stats.get_cmds++;
-        c->thread->stats.get_misses++;
-        pthread_mutex_unlock(&c->thread->stats.mutex);
+        THR_STATS_INCR(c->thread->stats.get_cmds);
+        THR_STATS_INCR(c->thread->stats.get_misses);
 
         MEMCACHED_COMMAND_GET(c->sfd, key, nkey, -1, 0);
 
@@ -1765,9 +1768,7 @@ static void process_bin_complete_sasl_auth(conn *c) {
     switch(result) {
     case SASL_OK:
         write_bin_response(c, "Authenticated", 0, 0, strlen("Authenticated"));
-        pthread_mutex_lock(&c->thread->stats.mutex);
-        c->thread->stats.auth_cmds++;
-        pthread_mutex_unlock(&c->thread->stats.mutex);
+        THR_STATS_INCR(c->thread->stats.auth_cmds);
         break;
     case SASL_CONTINUE:
         add_bin_header(c, PROTOCOL_BINARY_RESPONSE_AUTH_CONTINUE, 0, 0, outlen);
@@ -1781,10 +1782,8 @@ static void process_bin_complete_sasl_auth(conn *c) {
         if (settings.verbose)
             fprintf(stderr, "Unknown sasl response:  %d\n", result);
         write_bin_error(c, PROTOCOL_BINARY_RESPONSE_AUTH_ERROR, 0);
-        pthread_mutex_lock(&c->thread->stats.mutex);
-        c->thread->stats.auth_cmds++;
-        c->thread->stats.auth_errors++;
-        pthread_mutex_unlock(&c->thread->stats.mutex);
+        THR_STATS_INCR(c->thread->stats.auth_cmds);
+        THR_STATS_INCR(c->thread->stats.auth_errors);
     }
 }
 
@@ -2159,9 +2158,7 @@ static void process_bin_flush(conn *c) {
     }
     item_flush_expired();
 
-    pthread_mutex_lock(&c->thread->stats.mutex);
-    c->thread->stats.flush_cmds++;
-    pthread_mutex_unlock(&c->thread->stats.mutex);
+    THR_STATS_INCR(c->thread->stats.flush_cmds);
 
     write_bin_response(c, NULL, 0, 0, 0);
 }
@@ -2189,9 +2186,7 @@ static void process_bin_delete(conn *c) {
         uint64_t cas = ntohll(req->message.header.request.cas);
         if (cas == 0 || cas == ITEM_get_cas(it)) {
             MEMCACHED_COMMAND_DELETE(c->sfd, ITEM_key(it), it->nkey);
-            pthread_mutex_lock(&c->thread->stats.mutex);
-            c->thread->stats.slab_stats[it->slabs_clsid].delete_hits++;
-            pthread_mutex_unlock(&c->thread->stats.mutex);
+            THR_STATS_INCR(c->thread->stats.slab_stats[it->slabs_clsid].delete_hits);
             item_unlink(it);
             write_bin_response(c, NULL, 0, 0, 0);
         } else {
@@ -2200,9 +2195,7 @@ static void process_bin_delete(conn *c) {
         item_remove(it);      /* release our reference */
     } else {
         write_bin_error(c, PROTOCOL_BINARY_RESPONSE_KEY_ENOENT, 0);
-        pthread_mutex_lock(&c->thread->stats.mutex);
-        c->thread->stats.delete_misses++;
-        pthread_mutex_unlock(&c->thread->stats.mutex);
+        THR_STATS_INCR(c->thread->stats.delete_misses);
     }
 }
 
@@ -2309,24 +2302,18 @@ enum store_item_type do_store_item(item *it, int comm, conn *c, const uint32_t h
         if(old_it == NULL) {
             // LRU expired
             stored = NOT_FOUND;
-            pthread_mutex_lock(&c->thread->stats.mutex);
-            c->thread->stats.cas_misses++;
-            pthread_mutex_unlock(&c->thread->stats.mutex);
+            THR_STATS_INCR(c->thread->stats.cas_misses);
         }
         else if (ITEM_get_cas(it) == ITEM_get_cas(old_it)) {
             // cas validates
             // it and old_it may belong to different classes.
             // I'm updating the stats for the one that's getting pushed out
-            pthread_mutex_lock(&c->thread->stats.mutex);
-            c->thread->stats.slab_stats[old_it->slabs_clsid].cas_hits++;
-            pthread_mutex_unlock(&c->thread->stats.mutex);
+            THR_STATS_INCR(c->thread->stats.slab_stats[old_it->slabs_clsid].cas_hits);
 
             item_replace(old_it, it, hv);
             stored = STORED;
         } else {
-            pthread_mutex_lock(&c->thread->stats.mutex);
-            c->thread->stats.slab_stats[old_it->slabs_clsid].cas_badval++;
-            pthread_mutex_unlock(&c->thread->stats.mutex);
+            THR_STATS_INCR(c->thread->stats.slab_stats[old_it->slabs_clsid].cas_badval);
 
             if(settings.verbose > 1) {
                 fprintf(stderr, "CAS:  failure: expected %llu, got %llu\n",
@@ -2610,7 +2597,7 @@ static void server_stats(ADD_STAT add_stats, conn *c) {
     APPEND_STAT("bytes_read", "%llu", (unsigned long long)thread_stats.bytes_read);
     APPEND_STAT("bytes_written", "%llu", (unsigned long long)thread_stats.bytes_written);
     APPEND_STAT("limit_maxbytes", "%llu", (unsigned long long)settings.maxbytes);
-    APPEND_STAT("accepting_conns", "%u", stats.accepting_conns);
+    APPEND_STAT("accepting_conns", "%u", stats.accepting_conns && threads_accepting_conns());
     APPEND_STAT("listen_disabled_num", "%llu", (unsigned long long)stats.listen_disabled_num);
     APPEND_STAT("threads", "%d", settings.num_threads);
     APPEND_STAT("conn_yields", "%llu", (unsigned long long)thread_stats.conn_yields);
@@ -2623,6 +2610,14 @@ static void server_stats(ADD_STAT add_stats, conn *c) {
         APPEND_STAT("slab_reassign_running", "%u", stats.slab_reassign_running);
         APPEND_STAT("slabs_moved", "%llu", stats.slabs_moved);
     }
+    if (settings.lru_crawler) {
+        APPEND_STAT("lru_crawler_running", "%u", stats.lru_crawler_running);
+        APPEND_STAT("lru_crawler_starts", "%llu", (unsigned long long)stats.lru_crawler_starts);
+        APPEND_STAT("crawler_reclaimed", "%llu", (unsigned long long)stats.crawler_reclaimed);
+    }
+    if (settings.lru_maintainer_thread) {
+        APPEND_STAT("lru_maintainer_juggles", "%llu", (unsigned long long)stats.lru_maintainer_juggles);
+    }
     STATS_UNLOCK();
 }
 
@@ -2657,6 +2652,14 @@ static void process_stat_settings(ADD_STAT add_stats, void *c) {
     APPEND_STAT("hashpower_init", "%d", settings.hashpower_init);
     APPEND_STAT("slab_reassign", "%s", settings.slab_reassign ? "yes" : "no");
     APPEND_STAT("slab_automove", "%s", settings.slab_automove ? "yes" : "no");
+    APPEND_STAT("lru_maintainer_thread", "%s", settings.lru_maintainer_thread ? "yes" : "no");
+    APPEND_STAT("hot_lru_pct", "%d", settings.hot_lru_pct);
+    APPEND_STAT("warm_lru_pct", "%d", settings.warm_lru_pct);
+    APPEND_STAT("lru_crawler", "%s", settings.lru_crawler ? "yes" : "no");
+    APPEND_STAT("lru_crawler_sleep", "%d", settings.lru_crawler_sleep);
+    APPEND_STAT("lru_crawler_tocrawl", "%lu", (unsigned long)settings.lru_crawler_tocrawl);
+    APPEND_STAT("reuseport", "%s", settings.reuseport ? "yes" : "no");
+    APPEND_STAT("incoming_cpu", "%s", settings.incoming_cpu ? "yes" : "no");
 }
 
 static void process_stat(conn *c, token_t *tokens, const size_t ntokens) {
@@ -2838,19 +2841,15 @@ static inline void process_get_command(conn *c, token_t *tokens, size_t ntokens,
                     fprintf(stderr, ">%d sending key %s\n", c->sfd, ITEM_key(it));
 
                 /* item_get() has incremented it->refcount for us */
-                pthread_mutex_lock(&c->thread->stats.mutex);
-                c->thread->stats.slab_stats[it->slabs_clsid].get_hits++;
-                c->thread->stats.get_cmds++;
-                pthread_mutex_unlock(&c->thread->stats.mutex);
+                THR_STATS_INCR(c->thread->stats.slab_stats[it->slabs_clsid].get_hits);
+                THR_STATS_INCR(c->thread->stats.get_cmds);
                 item_update(it);
                 *(c->ilist + i) = it;
                 i++;
 
             } else {
-                pthread_mutex_lock(&c->thread->stats.mutex);
-                c->thread->stats.get_misses++;
-                c->thread->stats.get_cmds++;
-                pthread_mutex_unlock(&c->thread->stats.mutex);
+                THR_STATS_INCR(c->thread->stats.get_misses);
+                THR_STATS_INCR(c->thread->stats.get_cmds);
                 MEMCACHED_COMMAND_GET(c->sfd, key, nkey, -1, 0);
             }
 
@@ -3009,18 +3008,14 @@ static void process_touch_command(conn *c, token_t *tokens, const size_t ntokens
     it = item_touch(key, nkey, realtime(exptime_int));
     if (it) {
         item_update(it);
-        pthread_mutex_lock(&c->thread->stats.mutex);
-        c->thread->stats.touch_cmds++;
-        c->thread->stats.slab_stats[it->slabs_clsid].touch_hits++;
-        pthread_mutex_unlock(&c->thread->stats.mutex);
+        THR_STATS_INCR(c->thread->stats.touch_cmds);
+        THR_STATS_INCR(c->thread->stats.slab_stats[it->slabs_clsid].touch_hits);
 
         out_string(c, "TOUCHED");
         item_remove(it);
     } else {
-        pthread_mutex_lock(&c->thread->stats.mutex);
-        c->thread->stats.touch_cmds++;
-        c->thread->stats.touch_misses++;
-        pthread_mutex_unlock(&c->thread->stats.mutex);
+        THR_STATS_INCR(c->thread->stats.touch_cmds);
+        THR_STATS_INCR(c->thread->stats.touch_misses);
 
         out_string(c, "NOT_FOUND");
     }
@@ -3060,13 +3055,11 @@ static void process_arithmetic_command(conn *c, token_t *tokens, const size_t nt
         out_string(c, "SERVER_ERROR out of memory");
         break;
     case DELTA_ITEM_NOT_FOUND:
-        pthread_mutex_lock(&c->thread->stats.mutex);
         if (incr) {
-            c->thread->stats.incr_misses++;
+            THR_STATS_INCR(c->thread->stats.incr_misses);
         } else {
-            c->thread->stats.decr_misses++;
+            THR_STATS_INCR(c->thread->stats.decr_misses);
         }
-        pthread_mutex_unlock(&c->thread->stats.mutex);
 
         out_string(c, "NOT_FOUND");
         break;
@@ -3127,13 +3120,11 @@ enum delta_result_type do_add_delta(conn *c, const char *key, const size_t nkey,
         MEMCACHED_COMMAND_DECR(c->sfd, ITEM_key(it), it->nkey, value);
     }
 
-    pthread_mutex_lock(&c->thread->stats.mutex);
     if (incr) {
-        c->thread->stats.slab_stats[it->slabs_clsid].incr_hits++;
+        THR_STATS_INCR(c->thread->stats.slab_stats[it->slabs_clsid].incr_hits);
     } else {
-        c->thread->stats.slab_stats[it->slabs_clsid].decr_hits++;
+        THR_STATS_INCR(c->thread->stats.slab_stats[it->slabs_clsid].decr_hits);
     }
-    pthread_mutex_unlock(&c->thread->stats.mutex);
 
     snprintf(buf, INCR_MAX_STORAGE_LEN, "%llu", (unsigned long long)value);
     res = strlen(buf);
@@ -3154,9 +3145,7 @@ enum delta_result_type do_add_delta(conn *c, const char *key, const size_t nkey,
     } else { /* replace in-place */
         /* When changing the value without replacing the item, we
            need to update the CAS on the existing item. */
-        mutex_lock(&cache_lock); /* FIXME */
         ITEM_set_cas(it, (settings.use_cas) ? get_cas_id() : 0);
-        pthread_mutex_unlock(&cache_lock);
 
         memcpy(ITEM_data(it), buf, res);
         memset(ITEM_data(it) + res, ' ', it->nbytes - res - 2);
@@ -3206,17 +3195,13 @@ static void process_delete_command(conn *c, token_t *tokens, const size_t ntoken
     if (it) {
         MEMCACHED_COMMAND_DELETE(c->sfd, ITEM_key(it), it->nkey);
 
-        pthread_mutex_lock(&c->thread->stats.mutex);
-        c->thread->stats.slab_stats[it->slabs_clsid].delete_hits++;
-        pthread_mutex_unlock(&c->thread->stats.mutex);
+        THR_STATS_INCR(c->thread->stats.slab_stats[it->slabs_clsid].delete_hits);
 
         item_unlink(it);
         item_remove(it);      /* release our reference */
         out_string(c, "DELETED");
     } else {
-        pthread_mutex_lock(&c->thread->stats.mutex);
-        c->thread->stats.delete_misses++;
-        pthread_mutex_unlock(&c->thread->stats.mutex);
+        THR_STATS_INCR(c->thread->stats.delete_misses);
 
         out_string(c, "NOT_FOUND");
     }
@@ -3255,6 +3240,53 @@ static void process_slabs_automove_command(conn *c, token_t *tokens, const size_
     return;
 }
 
+static void process_lru_crawler_command(conn *c, token_t *tokens, const size_t ntokens) {
+    uint32_t value;
+
+    assert(c != NULL);
+
+    if (settings.lru_crawler == false) {
+        out_string(c, "CLIENT_ERROR lru crawler disabled");
+        return;
+    }
+
+    if (ntokens == 4 && strcmp(tokens[COMMAND_TOKEN + 1].value, "crawl") == 0) {
+        switch (lru_crawler_crawl(tokens[2].value)) {
+        case CRAWLER_OK:
+            out_string(c, "OK");
+            break;
+        case CRAWLER_RUNNING:
+            out_string(c, "BUSY currently processing crawler request");
+            break;
+        case CRAWLER_BADCLASS:
+            out_string(c, "BADCLASS invalid class id");
+            break;
+        case CRAWLER_NOTSTARTED:
+            out_string(c, "NOTSTARTED no items to crawl");
+            break;
+        default:
+            assert(false);
+            abort();
+        }
+    } else if (ntokens == 4 && strcmp(tokens[COMMAND_TOKEN + 1].value, "sleep") == 0) {
+        if (!safe_strtoul(tokens[2].value, &value) || value > 1000000) {
+            out_string(c, "CLIENT_ERROR bad command line format");
+            return;
+        }
+        settings.lru_crawler_sleep = value;
+        out_string(c, "OK");
+    } else if (ntokens == 4 && strcmp(tokens[COMMAND_TOKEN + 1].value, "tocrawl") == 0) {
+        if (!safe_strtoul(tokens[2].value, &value)) {
+            out_string(c, "CLIENT_ERROR bad command line format");
+            return;
+        }
+        settings.lru_crawler_tocrawl = value;
+        out_string(c, "OK");
+    } else {
+        out_string(c, "ERROR");
+    }
+}
+
 static void process_command(conn *c, char *command) {
 
     token_t tokens[MAX_TOKENS];
@@ -3330,9 +3362,7 @@ static void process_command(conn *c, char *command) {
 
         set_noreply_maybe(c, tokens, ntokens);
 
-        pthread_mutex_lock(&c->thread->stats.mutex);
-        c->thread->stats.flush_cmds++;
-        pthread_mutex_unlock(&c->thread->stats.mutex);
+        THR_STATS_INCR(c->thread->stats.flush_cmds);
 
         if(ntokens == (c->noreply ? 3 : 2)) {
             settings.oldest_live = current_time - 1;
@@ -3420,6 +3450,8 @@ static void process_command(conn *c, char *command) {
         } else {
             out_string(c, "ERROR");
         }
+    } else if (ntokens > 1 && strcmp(tokens[COMMAND_TOKEN].value, "lru_crawler") == 0) {
+        process_lru_crawler_command(c, tokens, ntokens);
     } else if ((ntokens == 3 || ntokens == 4) && (strcmp(tokens[COMMAND_TOKEN].value, "verbosity") == 0)) {
         process_verbosity_command(c, tokens, ntokens);
     } else {
@@ -3574,9 +3606,7 @@ static enum try_read_result try_read_udp(conn *c) {
                    0, &c->request_addr, &c->request_addr_size);
     if (res > 8) {
         unsigned char *buf = (unsigned char *)c->rbuf;
-        pthread_mutex_lock(&c->thread->stats.mutex);
-        c->thread->stats.bytes_read += res;
-        pthread_mutex_unlock(&c->thread->stats.mutex);
+        THR_STATS_ADD(c->thread->stats.bytes_read, res);
 
         /* Beginning of UDP packet is the request ID; save it. */
         c->request_id = buf[0] * 256 + buf[1];
@@ -3644,9 +3674,7 @@ static enum try_read_result try_read_network(conn *c) {
         int avail = c->rsize - c->rbytes;
         res = read(c->sfd, c->rbuf + c->rbytes, avail);
         if (res > 0) {
-            pthread_mutex_lock(&c->thread->stats.mutex);
-            c->thread->stats.bytes_read += res;
-            pthread_mutex_unlock(&c->thread->stats.mutex);
+            THR_STATS_ADD(c->thread->stats.bytes_read, res);
             gotdata = READ_DATA_RECEIVED;
             c->rbytes += res;
             if (res == avail) {
@@ -3717,6 +3745,60 @@ void do_accept_new_conns(const bool do_accept) {
     }
 }
 
+static void listen_retry_handler(const int fd, const short which, void *arg);
+
+/*
+ * Same as do_accept_new_conns(), for the reuseport listeners of one worker.
+ * They live on that worker's event base, so only the worker itself may
+ * call this.
+ *
+ * listen(fd, 0) would leave a listener in its reuseport group, and the
+ * kernel would keep hashing connections to a worker that can't take them.
+ * On Linux shutdown() takes the socket out of the group (resetting what
+ * is in its backlog) while it stays bound, and listen() puts it back
+ * without needing a new fd. Elsewhere we fall back to listen(fd, 0).
+ */
+static void thread_accept_new_conns(LIBEVENT_THREAD *me, const bool do_accept) {
+    conn *next;
+
+    for (next = me->listen_conn; next; next = next->next) {
+        update_event(next, do_accept ? EV_READ | EV_PERSIST : 0);
+        if (do_accept) {
+            if (listen(next->sfd, settings.backlog) != 0) {
+                perror("listen");
+            }
+        } else if (shutdown(next->sfd, SHUT_RD) != 0 &&
+                   listen(next->sfd, 0) != 0) {
+            perror("listen");
+        }
+    }
+
+    me->accepting_conns = do_accept;
+    if (!do_accept) {
+        STATS_LOCK();
+        stats.listen_disabled_num++;
+        STATS_UNLOCK();
+        me->listen_paused_at = conns_closed;
+        listen_retry_handler(-42, 0, me);
+    }
+}
+
+/* Like maxconns_handler(), but run by the worker that stopped accepting. */
+static void listen_retry_handler(const int fd, const short which, void *arg) {
+    LIBEVENT_THREAD *me = arg;
+    struct timeval t = {.tv_sec = 0, .tv_usec = 10000};
+
+    if (fd == -42 || me->listen_paused_at == conns_closed) {
+        /* reschedule in 10ms if we need to keep polling */
+        evtimer_set(&me->listen_retry_event, listen_retry_handler, me);
+        event_base_set(me->base, &me->listen_retry_event);
+        evtimer_add(&me->listen_retry_event, &t);
+    } else {
+        evtimer_del(&me->listen_retry_event);
+        thread_accept_new_conns(me, true);
+    }
+}
+
 /*
  * Transmit the next chunk of data from our list of msgbuf structures.
  *
@@ -3740,9 +3822,7 @@ static enum transmit_result transmit(conn *c) {
 
         res = sendmsg(c->sfd, m, 0);
         if (res > 0) {
-            pthread_mutex_lock(&c->thread->stats.mutex);
-            c->thread->stats.bytes_written += res;
-            pthread_mutex_unlock(&c->thread->stats.mutex);
+            THR_STATS_ADD(c->thread->stats.bytes_written, res);
 
             /* We've written some of the data. Remove the completed
                iovec entries from the list of pending writes. */
@@ -3807,7 +3887,11 @@ static void drive_machine(conn *c) {
                 } else if (errno == EMFILE) {
                     if (settings.verbose > 0)
                         fprintf(stderr, "Too many open connections\n");
-                    accept_new_conns(false);
+                    if (c->thread != NULL) {
+                        thread_accept_new_conns(c->thread, false);
+                    } else {
+                        accept_new_conns(false);
+                    }
                     stop = true;
                 } else {
                     perror("accept()");
@@ -3830,6 +3914,11 @@ static void drive_machine(conn *c) {
                 STATS_LOCK();
                 stats.rejected_conns++;
                 STATS_UNLOCK();
+            } else if (c->thread != NULL) {
+                /* A worker's own reuseport listener; keep the connection */
+                dispatch_conn_local(c->thread, sfd, conn_new_cmd,
+                                    EV_READ | EV_PERSIST, DATA_BUFFER_SIZE,
+                                    tcp_transport);
             } else {
                 dispatch_conn_new(sfd, conn_new_cmd, EV_READ | EV_PERSIST,
                                      DATA_BUFFER_SIZE, tcp_transport);
@@ -3888,9 +3977,7 @@ static void drive_machine(conn *c) {
             if (nreqs >= 0) {
                 reset_cmd_handler(c);
             } else {
-                pthread_mutex_lock(&c->thread->stats.mutex);
-                c->thread->stats.conn_yields++;
-                pthread_mutex_unlock(&c->thread->stats.mutex);
+                THR_STATS_INCR(c->thread->stats.conn_yields);
                 if (c->rbytes > 0) {
                     /* We have already read in data into the input buffer,
                        so libevent will most likely not signal read events
@@ -3931,9 +4018,7 @@ static void drive_machine(conn *c) {
             /*  now try reading from the socket */
             res = read(c->sfd, c->ritem, c->rlbytes);
             if (res > 0) {
-                pthread_mutex_lock(&c->thread->stats.mutex);
-                c->thread->stats.bytes_read += res;
-                pthread_mutex_unlock(&c->thread->stats.mutex);
+                THR_STATS_ADD(c->thread->stats.bytes_read, res);
                 if (c->rcurr == c->ritem) {
                     c->rcurr += res;
                 }
@@ -3986,9 +4071,7 @@ static void drive_machine(conn *c) {
             /*  now try reading from the socket */
             res = read(c->sfd, c->rbuf, c->rsize > c->sbytes ? c->sbytes : c->rsize);
             if (res > 0) {
-                pthread_mutex_lock(&c->thread->stats.mutex);
-                c->thread->stats.bytes_read += res;
-                pthread_mutex_unlock(&c->thread->stats.mutex);
+                THR_STATS_ADD(c->thread->stats.bytes_read, res);
                 c->sbytes -= res;
                 break;
             }
@@ -4187,12 +4270,104 @@ static void maximize_sndbuf(const int sfd) {
  *        when they are successfully added to the list of ports we
  *        listen on.
  */
+/*
+ * Sets the options a listening socket needs before it's bound. Returns
+ * nonzero if the socket is unusable.
+ */
+static int socket_options(int sfd, struct addrinfo *ai,
+                          enum network_transport transport) {
+    struct linger ling = {0, 0};
+    int flags = 1;
+    int error;
+
+#ifdef IPV6_V6ONLY
+    if (ai->ai_family == AF_INET6) {
+        error = setsockopt(sfd, IPPROTO_IPV6, IPV6_V6ONLY, (char *) &flags, sizeof(flags));
+        if (error != 0) {
+            perror("setsockopt");
+            return 1;
+        }
+    }
+#endif
+
+    error = setsockopt(sfd, SOL_SOCKET, SO_REUSEADDR, &flags, sizeof(flags));
+    if (error != 0)
+    {
+      perror("setsockopt(SO_REUSEADDR)");
+    }
+
+    if (IS_UDP(transport)) {
+        maximize_sndbuf(sfd);
+    } else {
+#ifdef SO_REUSEPORT
+        if (settings.reuseport) {
+            error = setsockopt(sfd, SOL_SOCKET, SO_REUSEPORT, &flags, sizeof(flags));
+            if (error != 0) {
+                perror("setsockopt(SO_REUSEPORT)");
+                return 1;
+            }
+        }
+#endif
+
+        error = setsockopt(sfd, SOL_SOCKET, SO_KEEPALIVE, (void *)&flags, sizeof(flags));
+        if (error != 0)
+            perror("setsockopt");
+
+        error = setsockopt(sfd, SOL_SOCKET, SO_LINGER, (void *)&ling, sizeof(ling));
+        if (error != 0)
+            perror("setsockopt");
+
+        error = setsockopt(sfd, IPPROTO_TCP, TCP_NODELAY, (void *)&flags, sizeof(flags));
+        if (error != 0)
+            perror("setsockopt");
+    }
+    return 0;
+}
+
+/*
+ * With reuseport, opens a listening socket for every other worker thread on
+ * the address sfd is bound to, and hands each worker its own listener. The
+ * kernel spreads new connections over them, and a worker keeps the ones it
+ * accepts, so nothing funnels through the main thread.
+ */
+static int server_socket_reuseport(int sfd, struct addrinfo *ai,
+                                   enum network_transport transport) {
+    struct sockaddr_storage addr;
+    socklen_t addrlen = sizeof(addr);
+    int tid;
+
+    /* The others bind to the port sfd actually got, in case it was ephemeral */
+    if (getsockname(sfd, (struct sockaddr *)&addr, &addrlen) != 0) {
+        perror("getsockname()");
+        return 1;
+    }
+
+    dispatch_conn_to_thread(0, sfd, conn_listening, EV_READ | EV_PERSIST, 1,
+                            transport);
+    for (tid = 1; tid < settings.num_threads; tid++) {
+        int lfd = new_socket(ai);
+        if (lfd == -1) {
+            perror("server_socket_reuseport");
+            return 1;
+        }
+        if (socket_options(lfd, ai, transport) != 0 ||
+            bind(lfd, (struct sockaddr *)&addr, addrlen) == -1 ||
+            listen(lfd, settings.backlog) == -1) {
+            perror("server_socket_reuseport");
+            close(lfd);
+            return 1;
+        }
+        dispatch_conn_to_thread(tid, lfd, conn_listening, EV_READ | EV_PERSIST,
+                                1, transport);
+    }
+    return 0;
+}
+
 static int server_socket(const char *interface,
                          int port,
                          enum network_transport transport,
                          FILE *portnumber_file) {
     int sfd;
-    struct linger ling = {0, 0};
     struct addrinfo *ai;
     struct addrinfo *next;
     struct addrinfo hints = { .ai_flags = AI_PASSIVE,
@@ -4200,7 +4375,6 @@ static int server_socket(const char *interface,
     char port_buf[NI_MAXSERV];
     int error;
     int success = 0;
-    int flags =1;
 
     hints.ai_socktype = IS_UDP(transport) ? SOCK_DGRAM : SOCK_STREAM;
 
@@ -4231,37 +4405,9 @@ static int server_socket(const char *interface,
             continue;
         }
 
-#ifdef IPV6_V6ONLY
-        if (next->ai_family == AF_INET6) {
-            error = setsockopt(sfd, IPPROTO_IPV6, IPV6_V6ONLY, (char *) &flags, sizeof(flags));
-            if (error != 0) {
-                perror("setsockopt");
-                close(sfd);
-                continue;
-            }
-        }
-#endif
-
-        error = setsockopt(sfd, SOL_SOCKET, SO_REUSEADDR, &flags, sizeof(flags));
-        if (error != 0)
-        {
-          perror("setsockopt(SO_REUSEADDR)");
-        }
-
-        if (IS_UDP(transport)) {
-            maximize_sndbuf(sfd);
-        } else {
-            error = setsockopt(sfd, SOL_SOCKET, SO_KEEPALIVE, (void *)&flags, sizeof(flags));
-            if (error != 0)
-                perror("setsockopt");
-
-            error = setsockopt(sfd, SOL_SOCKET, SO_LINGER, (void *)&ling, sizeof(ling));
-            if (error != 0)
-                perror("setsockopt");
-
-            error = setsockopt(sfd, IPPROTO_TCP, TCP_NODELAY, (void *)&flags, sizeof(flags));
-            if (error != 0)
-                perror("setsockopt");
+        if (socket_options(sfd, next, transport) != 0) {
+            close(sfd);
+            continue;
         }
 
         if (bind(sfd, next->ai_addr, next->ai_addrlen) == -1) {
@@ -4311,6 +4457,11 @@ static int server_socket(const char *interface,
                 dispatch_conn_new(sfd, conn_read, EV_READ | EV_PERSIST,
                                   UDP_READ_BUFFER_SIZE, transport);
             }
+        } else if (settings.reuseport) {
+            if (server_socket_reuseport(sfd, next, transport) != 0) {
+                freeaddrinfo(ai);
+                return 1;
+            }
         } else {
             if (!(listen_conn_add = conn_new(sfd, conn_listening,
                                              EV_READ | EV_PERSIST, 1,
@@ -4564,7 +4715,27 @@ static void usage(void) {
            "                table should be. Can be grown at runtime if not big enough.\n"
            "                Set this based on \"STAT hash_power_level\" before a \n"
            "                restart.\n"
-           );
+           "              - lru_maintainer: Split each slab class LRU into hot,\n"
+           "                warm and cold segments kept in balance by a background\n"
+           "                thread, so one-off scans do not push out hot items.\n"
+           "              - hot_lru_pct: Percent of a slab class kept in the hot\n"
+           "                LRU (default: 32)\n"
+           "              - warm_lru_pct: Percent of a slab class kept in the warm\n"
+           "                LRU (default: 32)\n"
+           "              - lru_crawler: Start a background thread that frees\n"
+           "                expired items. Crawls run every %d seconds or on\n"
+           "                \"lru_crawler crawl <classid,classid|all>\"\n"
+           "              - lru_crawler_sleep: Microseconds to sleep between each\n"
+           "                crawler step (default: 100)\n"
+           "              - lru_crawler_tocrawl: Maximum items to check per LRU\n"
+           "                per crawl (default: 0, unlimited)\n"
+           "              - reuseport: Give every worker thread its own\n"
+           "                SO_REUSEPORT listening socket and accept on it\n"
+           "                directly, instead of accepting in one thread.\n"
+           "              - incoming_cpu: Implies reuseport. Pin each worker to a\n"
+           "                CPU and have the kernel hand it the connections that\n"
+           "                arrive on that CPU (SO_INCOMING_CPU).\n"
+           , LRU_CRAWLER_INTERVAL);
     return;
 }
 
@@ -4785,13 +4956,29 @@ int main (int argc, char **argv) {
         MAXCONNS_FAST = 0,
         HASHPOWER_INIT,
         SLAB_REASSIGN,
-        SLAB_AUTOMOVE
+        SLAB_AUTOMOVE,
+        LRU_MAINTAINER,
+        HOT_LRU_PCT,
+        WARM_LRU_PCT,
+        LRU_CRAWLER,
+        LRU_CRAWLER_SLEEP,
+        LRU_CRAWLER_TOCRAWL,
+        REUSEPORT,
+        INCOMING_CPU
     };
     char *const subopts_tokens[] = {
         [MAXCONNS_FAST] = (char*)"maxconns_fast",
         [HASHPOWER_INIT] = (char*)"hashpower",
         [SLAB_REASSIGN] = (char*)"slab_reassign",
         [SLAB_AUTOMOVE] = (char*)"slab_automove",
+        [LRU_MAINTAINER] = (char*)"lru_maintainer",
+        [HOT_LRU_PCT] = (char*)"hot_lru_pct",
+        [WARM_LRU_PCT] = (char*)"warm_lru_pct",
+        [LRU_CRAWLER] = (char*)"lru_crawler",
+        [LRU_CRAWLER_SLEEP] = (char*)"lru_crawler_sleep",
+        [LRU_CRAWLER_TOCRAWL] = (char*)"lru_crawler_tocrawl",
+        [REUSEPORT] = (char*)"reuseport",
+        [INCOMING_CPU] = (char*)"incoming_cpu",
         NULL
     };
 
@@ -5043,6 +5230,70 @@ int main (int argc, char **argv) {
             case SLAB_AUTOMOVE:
                 settings.slab_automove = true;
                 break;
+            case LRU_MAINTAINER:
+                settings.lru_maintainer_thread = true;
+                break;
+            case HOT_LRU_PCT:
+                if (subopts_value == NULL) {
+                    fprintf(stderr, "Missing hot_lru_pct argument\n");
+                    return 1;
+                }
+                settings.hot_lru_pct = atoi(subopts_value);
+                if (settings.hot_lru_pct < 1 || settings.hot_lru_pct >= 80) {
+                    fprintf(stderr, "hot_lru_pct must be between 1 and 79\n");
+                    return 1;
+                }
+                break;
+            case WARM_LRU_PCT:
+                if (subopts_value == NULL) {
+                    fprintf(stderr, "Missing warm_lru_pct argument\n");
+                    return 1;
+                }
+                settings.warm_lru_pct = atoi(subopts_value);
+                if (settings.warm_lru_pct < 1 || settings.warm_lru_pct >= 80) {
+                    fprintf(stderr, "warm_lru_pct must be between 1 and 79\n");
+                    return 1;
+                }
+                break;
+            case LRU_CRAWLER:
+                settings.lru_crawler = true;
+                break;
+            case LRU_CRAWLER_SLEEP:
+                if (subopts_value == NULL) {
+                    fprintf(stderr, "Missing lru_crawler_sleep argument\n");
+                    return 1;
+                }
+                settings.lru_crawler_sleep = atoi(subopts_value);
+                if (settings.lru_crawler_sleep < 0 || settings.lru_crawler_sleep > 1000000) {
+                    fprintf(stderr, "LRU crawler sleep must be between 0 and 1 second\n");
+                    return 1;
+                }
+                break;
+            case LRU_CRAWLER_TOCRAWL:
+                if (subopts_value == NULL) {
+                    fprintf(stderr, "Missing lru_crawler_tocrawl argument\n");
+                    return 1;
+                }
+                if (!safe_strtoul(subopts_value, &settings.lru_crawler_tocrawl)) {
+                    fprintf(stderr, "lru_crawler_tocrawl takes a numeric argument\n");
+                    return 1;
+                }
+                break;
+            case REUSEPORT:
+#ifndef SO_REUSEPORT
+                fprintf(stderr, "reuseport is not supported on this platform\n");
+                return 1;
+#endif
+                settings.reuseport = true;
+                break;
+            case INCOMING_CPU:
+#ifndef SO_INCOMING_CPU
+                fprintf(stderr, "incoming_cpu is not supported on this platform\n");
+                return 1;
+#endif
+                settings.reuseport = true;
+                settings.incoming_cpu = true;
+                break;
             default:
                 printf("Illegal suboption \"%s\"\n", subopts_value);
                 return 1;
@@ -5056,6 +5307,11 @@ int main (int argc, char **argv) {
         }
     }
 
+    if (settings.hot_lru_pct + settings.warm_lru_pct > 80) {
+        fprintf(stderr, "hot_lru_pct + warm_lru_pct cannot be more than 80%% combined\n");
+        return 1;
+    }
+
     /*
      * Use one workerthread to serve each UDP port if the user specified
      * multiple ports
@@ -5201,6 +5457,16 @@ int main (int argc, char **argv) {
         exit(EXIT_FAILURE);
     }
 
+    if (settings.lru_maintainer_thread &&
+        start_lru_maintainer_thread() == -1) {
+        exit(EXIT_FAILURE);
+    }
+
+    if (settings.lru_crawler &&
+        start_item_crawler_thread() == -1) {
+        exit(EXIT_FAILURE);
+    }
+
     /* initialise clock event */
     clock_handler(0, 0, 0);
 
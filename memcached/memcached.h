@@ -203,37 +203,63 @@ enum delta_result_type {
 /** Time relative to server start. Smaller than time_t on 64-bit systems. */
 typedef unsigned int rel_time_t;
 
+/*
+ * Thread stats have a single writer: the worker thread that owns them. The
+ * owner bumps a counter with a relaxed load and store, and threads reading
+ * the stats take relaxed loads. Neither side takes a lock or issues a locked
+ * instruction; readers only need each counter to be read whole.
+ */
+#ifdef __ATOMIC_RELAXED
+#define THR_STATS_GET(v) __atomic_load_n(&(v), __ATOMIC_RELAXED)
+#define THR_STATS_SET(v, n) __atomic_store_n(&(v), (n), __ATOMIC_RELAXED)
+#else
+#define THR_STATS_GET(v) (*(volatile uint64_t *)&(v))
+#define THR_STATS_SET(v, n) (*(volatile uint64_t *)&(v) = (n))
+#endif
+#define THR_STATS_ADD(v, n) THR_STATS_SET(v, THR_STATS_GET(v) + (n))
+#define THR_STATS_INCR(v) THR_STATS_ADD(v, 1)
+
+/* Every field is a uint64_t counter, so they can be walked as a list */
+#define SLAB_STATS_FIELDS \
+    X(set_cmds) \
+    X(get_hits) \
+    X(touch_hits) \
+    X(delete_hits) \
+    X(cas_hits) \
+    X(cas_badval) \
+    X(incr_hits) \
+    X(decr_hits)
+
 /** Stats stored per slab (and per thread). */
 struct slab_stats {
-    uint64_t  set_cmds;
-    uint64_t  get_hits;
-    uint64_t  touch_hits;
-    uint64_t  delete_hits;
-    uint64_t  cas_hits;
-    uint64_t  cas_badval;
-    uint64_t  incr_hits;
-    uint64_t  decr_hits;
+#define X(name) uint64_t name;
+    SLAB_STATS_FIELDS
+#undef X
 };
 
+#define THREAD_STATS_FIELDS \
+    X(get_cmds) \
+    X(get_misses) \
+    X(touch_cmds) \
+    X(touch_misses) \
+    X(delete_misses) \
+    X(incr_misses) \
+    X(decr_misses) \
+    X(cas_misses) \
+    X(bytes_read) \
+    X(bytes_written) \
+    X(flush_cmds) \
+    X(conn_yields) /* # of yields for connections (-R option)*/ \
+    X(auth_cmds) \
+    X(auth_errors)
+
 /**
  * Stats stored per-thread.
  */
 struct thread_stats {
-    pthread_mutex_t   mutex;
-    uint64_t          get_cmds;
-    uint64_t          get_misses;
-    uint64_t          touch_cmds;
-    uint64_t          touch_misses;
-    uint64_t          delete_misses;
-    uint64_t          incr_misses;
-    uint64_t          decr_misses;
-    uint64_t          cas_misses;
-    uint64_t          bytes_read;
-    uint64_t          bytes_written;
-    uint64_t          flush_cmds;
-    uint64_t          conn_yields; /* # of yields for connections (-R option)*/
-    uint64_t          auth_cmds;
-    uint64_t          auth_errors;
+#define X(name) uint64_t name;
+    THREAD_STATS_FIELDS
+#undef X
     struct slab_stats slab_stats[MAX_NUMBER_OF_SLAB_CLASSES];
 };
 
@@ -269,6 +295,10 @@ struct stats {
     uint64_t      evicted_unfetched; /* items evicted but never touched */
     bool          slab_reassign_running; /* slab reassign in progress */
     uint64_t      slabs_moved;       /* times slabs were moved around */
+    bool          lru_crawler_running; /* crawl in progress */
+    uint64_t      lru_crawler_starts; /* times an LRU crawl was started */
+    uint64_t      crawler_reclaimed; /* dead items freed by the LRU crawler */
+    uint64_t      lru_maintainer_juggles; /* number of LRU bg pokes */
 };
 
 #define MAX_VERBOSITY_LEVEL 2
@@ -305,6 +335,14 @@ struct settings {
     bool slab_reassign;     /* Whether or not slab reassignment is allowed */
     bool slab_automove;     /* Whether or not to automatically move slabs */
     int hashpower_init;     /* Starting hash power level */
+    bool lru_maintainer_thread; /* LRU maintainer background thread */
+    int hot_lru_pct;        /* percentage of a class kept in the HOT LRU */
+    int warm_lru_pct;       /* percentage of a class kept in the WARM LRU */
+    bool lru_crawler;       /* Whether or not to enable the LRU crawler thread */
+    int lru_crawler_sleep;  /* Microsecond sleep between items */
+    uint32_t lru_crawler_tocrawl; /* Number of items to crawl per run */
+    bool reuseport;         /* each worker accepts on its own SO_REUSEPORT socket */
+    bool incoming_cpu;      /* pin workers and steer connections by SO_INCOMING_CPU */
 };
 
 #ifndef __INTEL_COMPILER
@@ -340,6 +378,8 @@ typedef struct _stritem {
     uint8_t         it_flags;   /* ITEM_* above */
     uint8_t         slabs_clsid;/* which slab class we're in */
     uint8_t         nkey;       /* key length, w/terminating null and padding */
+    uint8_t         lru;        /* which LRU segment (HOT/WARM/COLD) */
+    uint8_t         active;     /* hit since it was linked into its segment */
     /* this odd type prevents type-punning issues when we do
      * the little shuffle to save space when not using CAS. */
     union {
@@ -361,6 +401,11 @@ typedef struct {
     struct thread_stats stats;  /* Stats generated by this thread */
     struct conn_queue *new_conn_queue; /* queue of new connections to handle */
     cache_t *suffix_cache;      /* suffix cache */
+    struct conn *listen_conn;   /* reuseport listeners this thread accepts on */
+    struct event listen_retry_event; /* re-enables them after running out of fds */
+    bool accepting_conns;       /* whether its listeners are accepting */
+    unsigned int listen_paused_at; /* connections closed when they stopped */
+    int cpu;                    /* CPU this thread is pinned to, or -1 */
 } LIBEVENT_THREAD;
 
 typedef struct {
@@ -517,6 +562,8 @@ static inline int mutex_lock(pthread_mutex_t *mutex)
 void thread_init(int nthreads, struct event_base *main_base);
 int  dispatch_event_add(int thread, conn *c);
 void dispatch_conn_new(int sfd, enum conn_states init_state, int event_flags, int read_buffer_size, enum network_transport transport);
+void dispatch_conn_to_thread(int tid, int sfd, enum conn_states init_state, int event_flags, int read_buffer_size, enum network_transport transport);
+void dispatch_conn_local(LIBEVENT_THREAD *me, int sfd, enum conn_states init_state, int event_flags, int read_buffer_size, enum network_transport transport);
 
 /* Lock wrappers for cache functions that are called from main loop. */
 enum delta_result_type add_delta(conn *c, const char *key,
@@ -524,6 +571,7 @@ enum delta_result_type add_delta(conn *c, const char *key,
                                  const int64_t delta, char *buf,
                                  uint64_t *cas);
 void accept_new_conns(const bool do_accept);
+bool threads_accepting_conns(void);
 conn *conn_from_freelist(void);
 bool  conn_add_to_freelist(conn *c);
 int   is_listen_thread(void);
@@ -541,7 +589,11 @@ void  item_unlink(item *it);
 void  item_update(item *it);
 
 void item_lock(uint32_t hv);
+void *item_trylock(uint32_t hv);
+void item_trylock_unlock(void *arg);
 void item_unlock(uint32_t hv);
+void item_lock_all(void);
+void item_unlock_all(void);
 unsigned short refcount_incr(unsigned short *refcount);
 unsigned short refcount_decr(unsigned short *refcount);
 void STATS_LOCK(void);
@@ -474,7 +474,6 @@ static int slab_rebalance_start(void) {
     slabclass_t *d_cls;
     int no_go = 0;
 
-    pthread_mutex_lock(&cache_lock);
     pthread_mutex_lock(&slabs_lock);
 
     if (slab_rebal.s_clsid < POWER_SMALLEST ||
@@ -497,7 +496,6 @@ static int slab_rebalance_start(void) {
 
     if (no_go != 0) {
         pthread_mutex_unlock(&slabs_lock);
-        pthread_mutex_unlock(&cache_lock);
         return no_go; /* Should use a wrapper function... */
     }
 
@@ -517,7 +515,6 @@ static int slab_rebalance_start(void) {
     }
 
     pthread_mutex_unlock(&slabs_lock);
-    pthread_mutex_unlock(&cache_lock);
 
     STATS_LOCK();
     stats.slab_reassign_running = true;
@@ -530,10 +527,12 @@ enum move_status {
     MOVE_PASS=0, MOVE_DONE, MOVE_BUSY
 };
 
-/* refcount == 0 is safe since nobody can incr while cache_lock is held.
+/* refcount == 0 is safe since nobody can incr while slabs_lock is held.
  * refcount != 0 is impossible since flags/etc can be modified in other
  * threads. instead, note we found a busy one and bail. logic in do_item_get
- * will prevent busy items from continuing to be busy
+ * will prevent busy items from continuing to be busy.
+ * Unlinking a linked item needs its item lock and its LRU lock, both of
+ * which come before slabs_lock in the lock order, so they are only tried.
  */
 static int slab_rebalance_move(void) {
     slabclass_t *s_cls;
@@ -542,7 +541,6 @@ static int slab_rebalance_move(void) {
     int refcount = 0;
     enum move_status status = MOVE_PASS;
 
-    pthread_mutex_lock(&cache_lock);
     pthread_mutex_lock(&slabs_lock);
 
     s_cls = &slabclass[slab_rebal.s_clsid];
@@ -567,8 +565,20 @@ static int slab_rebalance_move(void) {
                 }
             } else if (refcount == 2) { /* item is linked but not busy */
                 if ((it->it_flags & ITEM_LINKED) != 0) {
-                    do_item_unlink_nolock(it, hash(ITEM_key(it), it->nkey, 0));
-                    status = MOVE_DONE;
+                    uint32_t hv = hash(ITEM_key(it), it->nkey, 0);
+                    void *hold_lock = item_trylock(hv);
+                    status = MOVE_BUSY;
+                    if (hold_lock != NULL) {
+                        /* Under the item lock nobody else can take a
+                         * reference, so recheck that we hold the only one. */
+                        if (it->refcount == 2 &&
+                            pthread_mutex_trylock(&lru_locks[slab_rebal.s_clsid]) == 0) {
+                            do_item_unlink_nolock(it, hv);
+                            pthread_mutex_unlock(&lru_locks[slab_rebal.s_clsid]);
+                            status = MOVE_DONE;
+                        }
+                        item_trylock_unlock(hold_lock);
+                    }
                 } else {
                     /* refcount == 1 + !ITEM_LINKED means the item is being
                      * uploaded to, or was just unlinked but hasn't been freed
@@ -618,7 +628,6 @@ static int slab_rebalance_move(void) {
     }
 
     pthread_mutex_unlock(&slabs_lock);
-    pthread_mutex_unlock(&cache_lock);
 
     return was_busy;
 }
@@ -627,7 +636,6 @@ static void slab_rebalance_finish(void) {
     slabclass_t *s_cls;
     slabclass_t *d_cls;
 
-    pthread_mutex_lock(&cache_lock);
     pthread_mutex_lock(&slabs_lock);
 
     s_cls = &slabclass[slab_rebal.s_clsid];
@@ -655,7 +663,6 @@ static void slab_rebalance_finish(void) {
     slab_rebalance_signal = 0;
 
     pthread_mutex_unlock(&slabs_lock);
-    pthread_mutex_unlock(&cache_lock);
 
     STATS_LOCK();
     stats.slab_reassign_running = false;
@@ -694,11 +701,11 @@ static int slab_automove_decision(int *src, int *dst) {
     }
 
     item_stats_evictions(evicted_new);
-    pthread_mutex_lock(&cache_lock);
+    pthread_mutex_lock(&slabs_lock);
     for (i = POWER_SMALLEST; i < power_largest; i++) {
         total_pages[i] = slabclass[i].slabs;
     }
-    pthread_mutex_unlock(&cache_lock);
+    pthread_mutex_unlock(&slabs_lock);
 
     /* Find a candidate source; something with zero evicts 3+ times */
     for (i = POWER_SMALLEST; i < power_largest; i++) {
@@ -830,10 +837,10 @@ int start_slab_maintenance_thread(void) {
 }
 
 void stop_slab_maintenance_thread(void) {
-    mutex_lock(&cache_lock);
+    mutex_lock(&slabs_lock);
     do_run_slab_thread = 0;
     pthread_cond_signal(&maintenance_cond);
-    pthread_mutex_unlock(&cache_lock);
+    pthread_mutex_unlock(&slabs_lock);
 
     /* Wait for the maintenance thread to stop */
     pthread_join(maintenance_tid, NULL);
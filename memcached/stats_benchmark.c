@@ -0,0 +1,142 @@
+/* -*- Mode: C; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ * Measures what the per-thread stats cost the worker threads, and what it
+ * costs to read them. Each writer thread counts a get hit the way the
+ * server does (get_cmds plus the slab class get_hits) into its own
+ * struct thread_stats, while one reader keeps summing all of them like
+ * "stats" does. This runs once with the counters behind a mutex per thread,
+ * the way they used to be, and once as single-writer counters.
+ *
+ *   stats_benchmark [threads] [million ops per thread]
+ */
+#include "memcached.h"
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+
+struct writer {
+    pthread_t tid;
+    pthread_mutex_t mutex;     /* only used by the locked run */
+    struct thread_stats stats;
+};
+
+static struct writer *writers;
+static int nwriters;
+static uint64_t nops;
+static bool use_lock;
+static volatile int writers_running;
+
+static double now(void) {
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+static void *writer_thread(void *arg) {
+    struct writer *w = arg;
+    uint64_t i;
+
+    for (i = 0; i < nops; i++) {
+        unsigned int clsid = 1 + (i & 31);
+        if (use_lock) {
+            pthread_mutex_lock(&w->mutex);
+            w->stats.get_cmds++;
+            w->stats.slab_stats[clsid].get_hits++;
+            pthread_mutex_unlock(&w->mutex);
+        } else {
+            THR_STATS_INCR(w->stats.get_cmds);
+            THR_STATS_INCR(w->stats.slab_stats[clsid].get_hits);
+        }
+    }
+    return NULL;
+}
+
+/* Same walk as threadlocal_stats_aggregate() in thread.c */
+static void aggregate(struct thread_stats *out) {
+    int ii, sid;
+
+    memset(out, 0, sizeof(*out));
+    for (ii = 0; ii < nwriters; ii++) {
+        struct thread_stats *ts = &writers[ii].stats;
+        if (use_lock)
+            pthread_mutex_lock(&writers[ii].mutex);
+#define X(name) out->name += THR_STATS_GET(ts->name);
+        THREAD_STATS_FIELDS
+#undef X
+        for (sid = 0; sid < MAX_NUMBER_OF_SLAB_CLASSES; sid++) {
+#define X(name) out->slab_stats[sid].name += THR_STATS_GET(ts->slab_stats[sid].name);
+            SLAB_STATS_FIELDS
+#undef X
+        }
+        if (use_lock)
+            pthread_mutex_unlock(&writers[ii].mutex);
+    }
+}
+
+static void run(bool locked) {
+    struct thread_stats total;
+    uint64_t aggregations = 0;
+    double start, elapsed;
+    int ii;
+
+    use_lock = locked;
+    memset(writers, 0, sizeof(*writers) * nwriters);
+    for (ii = 0; ii < nwriters; ii++)
+        pthread_mutex_init(&writers[ii].mutex, NULL);
+
+    writers_running = 1;
+    start = now();
+    for (ii = 0; ii < nwriters; ii++) {
+        if (pthread_create(&writers[ii].tid, NULL, writer_thread,
+                           &writers[ii]) != 0) {
+            perror("pthread_create");
+            exit(EXIT_FAILURE);
+        }
+    }
+    /* This thread is the reader until the last writer is done */
+    for (ii = 0; ii < nwriters; ) {
+        aggregate(&total);
+        aggregations++;
+        if (THR_STATS_GET(writers[ii].stats.get_cmds) == nops)
+            ii++;
+    }
+    for (ii = 0; ii < nwriters; ii++)
+        pthread_join(writers[ii].tid, NULL);
+    elapsed = now() - start;
+
+    aggregate(&total);
+    if (total.get_cmds != nops * nwriters) {
+        fprintf(stderr, "lost updates: %llu of %llu\n",
+                (unsigned long long)total.get_cmds,
+                (unsigned long long)(nops * nwriters));
+        exit(EXIT_FAILURE);
+    }
+    printf("%-8s %2d threads: %6.2f ns per counted get, %8.0f aggregations/sec\n",
+           locked ? "mutex" : "relaxed", nwriters,
+           elapsed * 1e9 / nops, aggregations / elapsed);
+    for (ii = 0; ii < nwriters; ii++)
+        pthread_mutex_destroy(&writers[ii].mutex);
+}
+
+int main(int argc, char **argv) {
+    nwriters = argc > 1 ? atoi(argv[1]) : 4;
+    nops = (argc > 2 ? strtoull(argv[2], NULL, 10) : 20) * 1000000;
+    if (nwriters < 1 || nops == 0) {
+        fprintf(stderr, "usage: %s [threads] [million ops per thread]\n",
+                argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    writers = calloc(nwriters, sizeof(*writers));
+    if (writers == NULL) {
+        perror("calloc");
+        return EXIT_FAILURE;
+    }
+    run(true);
+    run(false);
+    free(writers);
+    return EXIT_SUCCESS;
+}
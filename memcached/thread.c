@@ -10,6 +10,7 @@
 #include <errno.h>
 #include <string.h>
 #include <pthread.h>
+#include <sched.h>
 
 #ifdef __sun
 #include <atomic.h>
@@ -37,8 +38,9 @@ struct conn_queue {
     pthread_cond_t  cond;
 };
 
-/* Lock for cache operations (item_*, assoc_*) */
-pthread_mutex_t cache_lock;
+/* Locks for the per slab class LRUs and their item stats. Lock order is
+ * item_lock, lru_locks, slabs_lock. */
+pthread_mutex_t lru_locks[POWER_LARGEST];
 
 /* Connection lock around accepting new connections */
 pthread_mutex_t conn_lock = PTHREAD_MUTEX_INITIALIZER;
@@ -112,10 +114,42 @@ void item_lock(uint32_t hv) {
     mutex_lock(&item_locks[hv & item_lock_mask]);
 }
 
+/* For callers that may already own an item lock and need a second one.
+ * Returns the lock to hand back to item_trylock_unlock(), or NULL if it was
+ * busy. */
+void *item_trylock(uint32_t hv) {
+    pthread_mutex_t *lock = &item_locks[hv & item_lock_mask];
+    if (pthread_mutex_trylock(lock) == 0) {
+        return lock;
+    }
+    return NULL;
+}
+
+void item_trylock_unlock(void *lock) {
+    mutex_unlock((pthread_mutex_t *) lock);
+}
+
 void item_unlock(uint32_t hv) {
     pthread_mutex_unlock(&item_locks[hv & item_lock_mask]);
 }
 
+/* Takes every item lock, in order. Workers only ever block on a single item
+ * lock, so this cannot deadlock against them. Used by the hash table to
+ * swap tables when it starts an expansion. */
+void item_lock_all(void) {
+    uint32_t i;
+    for (i = 0; i < item_lock_count; i++) {
+        mutex_lock(&item_locks[i]);
+    }
+}
+
+void item_unlock_all(void) {
+    uint32_t i;
+    for (i = 0; i < item_lock_count; i++) {
+        pthread_mutex_unlock(&item_locks[i]);
+    }
+}
+
 /*
  * Initializes a connection queue.
  */
@@ -236,6 +270,20 @@ void accept_new_conns(const bool do_accept) {
     do_accept_new_conns(do_accept);
     pthread_mutex_unlock(&conn_lock);
 }
+
+/*
+ * Whether every worker's reuseport listeners are accepting. Only a stats
+ * snapshot: each worker changes its own flag without a lock.
+ */
+bool threads_accepting_conns(void) {
+    int i;
+
+    for (i = 0; i < settings.num_threads; i++) {
+        if (!threads[i].accepting_conns)
+            return false;
+    }
+    return true;
+}
 /****************************** LIBEVENT THREADS *****************************/
 
 /*
@@ -265,11 +313,6 @@ static void setup_thread(LIBEVENT_THREAD *me) {
     }
     cq_init(me->new_conn_queue);
 
-    if (pthread_mutex_init(&me->stats.mutex, NULL) != 0) {
-        perror("Failed to initialize mutex");
-        exit(EXIT_FAILURE);
-    }
-
     me->suffix_cache = cache_create("suffix", SUFFIX_SIZE, sizeof(char*),
                                     NULL, NULL);
     if (me->suffix_cache == NULL) {
@@ -288,6 +331,19 @@ static void *worker_libevent(void *arg) {
     /* Any per-thread setup can happen here; thread_init() will block until
      * all threads have finished initializing.
      */
+#ifdef SO_INCOMING_CPU
+    if (me->cpu != -1) {
+        cpu_set_t set;
+        int ret;
+
+        CPU_ZERO(&set);
+        CPU_SET(me->cpu, &set);
+        if ((ret = pthread_setaffinity_np(pthread_self(), sizeof(set), &set)) != 0) {
+            fprintf(stderr, "Can't pin worker thread to CPU %d: %s\n",
+                    me->cpu, strerror(ret));
+        }
+    }
+#endif
 
     pthread_mutex_lock(&init_lock);
     init_count++;
@@ -318,23 +374,47 @@ static void thread_libevent_process(int fd, short which, void *arg) {
     item = cq_pop(me->new_conn_queue);
 
     if (NULL != item) {
-        conn *c = conn_new(item->sfd, item->init_state, item->event_flags,
-                           item->read_buffer_size, item->transport, me->base);
-        if (c == NULL) {
-            if (IS_UDP(item->transport)) {
-                fprintf(stderr, "Can't listen for events on UDP socket\n");
-                exit(1);
-            } else {
-                if (settings.verbose > 0) {
-                    fprintf(stderr, "Can't listen for events on fd %d\n",
-                        item->sfd);
-                }
-                close(item->sfd);
-            }
+        dispatch_conn_local(me, item->sfd, item->init_state, item->event_flags,
+                            item->read_buffer_size, item->transport);
+        cqi_free(item);
+    }
+}
+
+/*
+ * Sets up a connection on this worker's own event base. Called for the items
+ * other threads queue up, and directly for the connections a worker accepts
+ * on its reuseport listeners, which never leave the worker.
+ */
+void dispatch_conn_local(LIBEVENT_THREAD *me, int sfd,
+                         enum conn_states init_state, int event_flags,
+                         int read_buffer_size,
+                         enum network_transport transport) {
+    conn *c = conn_new(sfd, init_state, event_flags, read_buffer_size,
+                       transport, me->base);
+    if (c == NULL) {
+        if (IS_UDP(transport) || init_state == conn_listening) {
+            fprintf(stderr, "Can't listen for events on %s socket\n",
+                    IS_UDP(transport) ? "UDP" : "TCP");
+            exit(1);
         } else {
-            c->thread = me;
+            if (settings.verbose > 0) {
+                fprintf(stderr, "Can't listen for events on fd %d\n", sfd);
+            }
+            close(sfd);
         }
-        cqi_free(item);
+        return;
+    }
+
+    c->thread = me;
+    if (init_state == conn_listening) {
+#ifdef SO_INCOMING_CPU
+        if (me->cpu != -1 && setsockopt(sfd, SOL_SOCKET, SO_INCOMING_CPU,
+                                        &me->cpu, sizeof(me->cpu)) != 0) {
+            perror("setsockopt(SO_INCOMING_CPU)");
+        }
+#endif
+        c->next = me->listen_conn;
+        me->listen_conn = c;
     }
 }
 
@@ -348,12 +428,22 @@ static int last_thread = -1;
  */
 void dispatch_conn_new(int sfd, enum conn_states init_state, int event_flags,
                        int read_buffer_size, enum network_transport transport) {
-    CQ_ITEM *item = cqi_new();
     int tid = (last_thread + 1) % settings.num_threads;
 
-    LIBEVENT_THREAD *thread = threads + tid;
-
     last_thread = tid;
+    dispatch_conn_to_thread(tid, sfd, init_state, event_flags,
+                            read_buffer_size, transport);
+}
+
+/*
+ * Dispatches a connection to a given worker thread. Used directly to hand
+ * each worker its own reuseport listener.
+ */
+void dispatch_conn_to_thread(int tid, int sfd, enum conn_states init_state,
+                             int event_flags, int read_buffer_size,
+                             enum network_transport transport) {
+    CQ_ITEM *item = cqi_new();
+    LIBEVENT_THREAD *thread = threads + tid;
 
     item->sfd = sfd;
     item->init_state = init_state;
@@ -463,12 +553,9 @@ void item_unlink(item *item) {
  * Moves an item to the back of the LRU queue.
  */
 void item_update(item *item) {
-    uint32_t hv;
-    hv = hash(ITEM_key(item), item->nkey, 0);
-
-    item_lock(hv);
+    /* The caller holds a reference and do_item_update only touches the
+     * LRU, so the bump needs no item lock. */
     do_item_update(item);
-    item_unlock(hv);
 }
 
 /*
@@ -506,9 +593,8 @@ enum store_item_type store_item(item *item, int comm, conn* c) {
  * Flushes expired items after a flush_all call
  */
 void item_flush_expired() {
-    mutex_lock(&cache_lock);
+    /* do_item_flush_expired handles its own locks */
     do_item_flush_expired();
-    pthread_mutex_unlock(&cache_lock);
 }
 
 /*
@@ -517,9 +603,9 @@ void item_flush_expired() {
 char *item_cachedump(unsigned int slabs_clsid, unsigned int limit, unsigned int *bytes) {
     char *ret;
 
-    mutex_lock(&cache_lock);
+    mutex_lock(&lru_locks[slabs_clsid]);
     ret = do_item_cachedump(slabs_clsid, limit, bytes);
-    pthread_mutex_unlock(&cache_lock);
+    pthread_mutex_unlock(&lru_locks[slabs_clsid]);
     return ret;
 }
 
@@ -527,18 +613,16 @@ char *item_cachedump(unsigned int slabs_clsid, unsigned int limit, unsigned int
  * Dumps statistics about slab classes
  */
 void  item_stats(ADD_STAT add_stats, void *c) {
-    mutex_lock(&cache_lock);
+    /* do_item_stats takes each slab class' LRU lock in turn */
     do_item_stats(add_stats, c);
-    pthread_mutex_unlock(&cache_lock);
 }
 
 /*
  * Dumps a list of objects of each size in 32-byte increments
  */
 void  item_stats_sizes(ADD_STAT add_stats, void *c) {
-    mutex_lock(&cache_lock);
+    /* do_item_stats_sizes takes each slab class' LRU lock in turn */
     do_item_stats_sizes(add_stats, c);
-    pthread_mutex_unlock(&cache_lock);
 }
 
 /******************************* GLOBAL STATS ******************************/
@@ -551,111 +635,89 @@ void STATS_UNLOCK() {
     pthread_mutex_unlock(&stats_lock);
 }
 
-void threadlocal_stats_reset(void) {
-    int ii, sid;
-    for (ii = 0; ii < settings.num_threads; ++ii) {
-        pthread_mutex_lock(&threads[ii].stats.mutex);
-
-        threads[ii].stats.get_cmds = 0;
-        threads[ii].stats.get_misses = 0;
-        threads[ii].stats.touch_cmds = 0;
-        threads[ii].stats.touch_misses = 0;
-        threads[ii].stats.delete_misses = 0;
-        threads[ii].stats.incr_misses = 0;
-        threads[ii].stats.decr_misses = 0;
-        threads[ii].stats.cas_misses = 0;
-        threads[ii].stats.bytes_read = 0;
-        threads[ii].stats.bytes_written = 0;
-        threads[ii].stats.flush_cmds = 0;
-        threads[ii].stats.conn_yields = 0;
-        threads[ii].stats.auth_cmds = 0;
-        threads[ii].stats.auth_errors = 0;
-
-        for(sid = 0; sid < MAX_NUMBER_OF_SLAB_CLASSES; sid++) {
-            threads[ii].stats.slab_stats[sid].set_cmds = 0;
-            threads[ii].stats.slab_stats[sid].get_hits = 0;
-            threads[ii].stats.slab_stats[sid].touch_hits = 0;
-            threads[ii].stats.slab_stats[sid].delete_hits = 0;
-            threads[ii].stats.slab_stats[sid].incr_hits = 0;
-            threads[ii].stats.slab_stats[sid].decr_hits = 0;
-            threads[ii].stats.slab_stats[sid].cas_hits = 0;
-            threads[ii].stats.slab_stats[sid].cas_badval = 0;
-        }
-
-        pthread_mutex_unlock(&threads[ii].stats.mutex);
-    }
-}
+/*
+ * Worker threads are the only writers of their stats, so "stats reset" does
+ * not clear them. It records the current totals instead, and aggregation
+ * reports the difference. The lock only orders resets against readers.
+ */
+static struct thread_stats stats_reset_base;
+static pthread_mutex_t stats_reset_lock = PTHREAD_MUTEX_INITIALIZER;
 
-void threadlocal_stats_aggregate(struct thread_stats *stats) {
+/* Sums the counters of all worker threads without locking them. */
+static void threadlocal_stats_collect(struct thread_stats *stats) {
     int ii, sid;
 
-    /* The struct has a mutex, but we can safely set the whole thing
-     * to zero since it is unused when aggregating. */
     memset(stats, 0, sizeof(*stats));
 
     for (ii = 0; ii < settings.num_threads; ++ii) {
-        pthread_mutex_lock(&threads[ii].stats.mutex);
-
-        stats->get_cmds += threads[ii].stats.get_cmds;
-        stats->get_misses += threads[ii].stats.get_misses;
-        stats->touch_cmds += threads[ii].stats.touch_cmds;
-        stats->touch_misses += threads[ii].stats.touch_misses;
-        stats->delete_misses += threads[ii].stats.delete_misses;
-        stats->decr_misses += threads[ii].stats.decr_misses;
-        stats->incr_misses += threads[ii].stats.incr_misses;
-        stats->cas_misses += threads[ii].stats.cas_misses;
-        stats->bytes_read += threads[ii].stats.bytes_read;
-        stats->bytes_written += threads[ii].stats.bytes_written;
-        stats->flush_cmds += threads[ii].stats.flush_cmds;
-        stats->conn_yields += threads[ii].stats.conn_yields;
-        stats->auth_cmds += threads[ii].stats.auth_cmds;
-        stats->auth_errors += threads[ii].stats.auth_errors;
-
+        struct thread_stats *ts = &threads[ii].stats;
+#define X(name) stats->name += THR_STATS_GET(ts->name);
+        THREAD_STATS_FIELDS
+#undef X
         for (sid = 0; sid < MAX_NUMBER_OF_SLAB_CLASSES; sid++) {
-            stats->slab_stats[sid].set_cmds +=
-                threads[ii].stats.slab_stats[sid].set_cmds;
-            stats->slab_stats[sid].get_hits +=
-                threads[ii].stats.slab_stats[sid].get_hits;
-            stats->slab_stats[sid].touch_hits +=
-                threads[ii].stats.slab_stats[sid].touch_hits;
-            stats->slab_stats[sid].delete_hits +=
-                threads[ii].stats.slab_stats[sid].delete_hits;
-            stats->slab_stats[sid].decr_hits +=
-                threads[ii].stats.slab_stats[sid].decr_hits;
-            stats->slab_stats[sid].incr_hits +=
-                threads[ii].stats.slab_stats[sid].incr_hits;
-            stats->slab_stats[sid].cas_hits +=
-                threads[ii].stats.slab_stats[sid].cas_hits;
-            stats->slab_stats[sid].cas_badval +=
-                threads[ii].stats.slab_stats[sid].cas_badval;
+#define X(name) stats->slab_stats[sid].name += \
+            THR_STATS_GET(ts->slab_stats[sid].name);
+            SLAB_STATS_FIELDS
+#undef X
         }
+    }
+}
+
+void threadlocal_stats_reset(void) {
+    pthread_mutex_lock(&stats_reset_lock);
+    threadlocal_stats_collect(&stats_reset_base);
+    pthread_mutex_unlock(&stats_reset_lock);
+}
+
+void threadlocal_stats_aggregate(struct thread_stats *stats) {
+    int sid;
 
-        pthread_mutex_unlock(&threads[ii].stats.mutex);
+    pthread_mutex_lock(&stats_reset_lock);
+    threadlocal_stats_collect(stats);
+#define X(name) stats->name -= stats_reset_base.name;
+    THREAD_STATS_FIELDS
+#undef X
+    for (sid = 0; sid < MAX_NUMBER_OF_SLAB_CLASSES; sid++) {
+#define X(name) stats->slab_stats[sid].name -= stats_reset_base.slab_stats[sid].name;
+        SLAB_STATS_FIELDS
+#undef X
     }
+    pthread_mutex_unlock(&stats_reset_lock);
 }
 
 void slab_stats_aggregate(struct thread_stats *stats, struct slab_stats *out) {
     int sid;
 
-    out->set_cmds = 0;
-    out->get_hits = 0;
-    out->touch_hits = 0;
-    out->delete_hits = 0;
-    out->incr_hits = 0;
-    out->decr_hits = 0;
-    out->cas_hits = 0;
-    out->cas_badval = 0;
+    memset(out, 0, sizeof(*out));
 
     for (sid = 0; sid < MAX_NUMBER_OF_SLAB_CLASSES; sid++) {
-        out->set_cmds += stats->slab_stats[sid].set_cmds;
-        out->get_hits += stats->slab_stats[sid].get_hits;
-        out->touch_hits += stats->slab_stats[sid].touch_hits;
-        out->delete_hits += stats->slab_stats[sid].delete_hits;
-        out->decr_hits += stats->slab_stats[sid].decr_hits;
-        out->incr_hits += stats->slab_stats[sid].incr_hits;
-        out->cas_hits += stats->slab_stats[sid].cas_hits;
-        out->cas_badval += stats->slab_stats[sid].cas_badval;
+#define X(name) out->name += stats->slab_stats[sid].name;
+        SLAB_STATS_FIELDS
+#undef X
+    }
+}
+
+/*
+ * Picks the CPU worker "tid" is pinned to when connections are steered by
+ * SO_INCOMING_CPU: the workers are spread in order over the CPUs we're
+ * allowed to run on. Returns -1 when workers aren't pinned.
+ */
+static int incoming_cpu(int tid) {
+#ifdef SO_INCOMING_CPU
+    cpu_set_t set;
+    int cpu, n;
+
+    if (!settings.incoming_cpu ||
+        sched_getaffinity(0, sizeof(set), &set) != 0 || CPU_COUNT(&set) == 0)
+        return -1;
+
+    n = tid % CPU_COUNT(&set);
+    for (cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+        if (CPU_ISSET(cpu, &set) && n-- == 0)
+            return cpu;
     }
+#endif
+    return -1;
 }
 
 #ifndef __INTEL_COMPILER
@@ -671,7 +733,9 @@ void thread_init(int nthreads, struct event_base *main_base) {
     int         i;
     int         power;
 
-    pthread_mutex_init(&cache_lock, NULL);
+    for (i = 0; i < POWER_LARGEST; i++) {
+        pthread_mutex_init(&lru_locks[i], NULL);
+    }
     pthread_mutex_init(&stats_lock, NULL);
 
     pthread_mutex_init(&init_lock, NULL);
@@ -692,6 +756,12 @@ void thread_init(int nthreads, struct event_base *main_base) {
         power = 13;
     }
 
+    /* The hash table migrates each old bucket under the item lock that
+     * covers it, which only works while every bucket maps to one lock. */
+    if (settings.hashpower_init != 0 && power >= settings.hashpower_init) {
+        power = settings.hashpower_init - 1;
+    }
+
     item_lock_count = ((unsigned long int)1 << (power));
     item_lock_mask  = item_lock_count - 1;
 
@@ -722,6 +792,8 @@ void thread_init(int nthreads, struct event_base *main_base) {
 
         threads[i].notify_receive_fd = fds[0];
         threads[i].notify_send_fd = fds[1];
+        threads[i].cpu = incoming_cpu(i);
+        threads[i].accepting_conns = true;
 
         setup_thread(&threads[i]);
         /* Reserve three fds for the libevent base, and two for the pipe */
@@ -476,6 +476,324 @@ static test_return_t hashkit_compare_test(hashkit_st *hashk)
   return TEST_SUCCESS;
 }
 
+/*
+  FIPS-197 C.3, AES-256. ECB encrypts every block the same way, so a run of
+  identical plain text blocks has to come back as a run of this block no
+  matter how many of them are encrypted at once.
+*/
+static const char aes256_key[]= "\x00\x01\x02\x03\x04\x05\x06\x07\x08\x09\x0a\x0b\x0c\x0d\x0e\x0f"
+                                "\x10\x11\x12\x13\x14\x15\x16\x17\x18\x19\x1a\x1b\x1c\x1d\x1e\x1f";
+static const char aes256_plain[]= "\x00\x11\x22\x33\x44\x55\x66\x77\x88\x99\xaa\xbb\xcc\xdd\xee\xff";
+static const char aes256_cipher[]= "\x8e\xa2\xb7\xca\x51\x67\x45\xbf\xea\xfc\x49\x90\x4b\x49\x60\x89";
+
+static test_return_t hashkit_encrypt_known_answer_test(hashkit_st *)
+{
+  hashkit_st kit;
+  test_true(hashkit_create(&kit));
+  test_true(hashkit_key(&kit, aes256_key, sizeof(aes256_key) -1));
+
+  char plain[16 * 37];
+  for (size_t x= 0; x < 37; x++)
+  {
+    memcpy(plain +16*x, aes256_plain, 16);
+  }
+
+  char cipher[sizeof(plain) +16];
+  test_compare(sizeof(cipher), hashkit_encrypt_length(&kit, sizeof(plain)));
+  test_compare(sizeof(plain), hashkit_encrypt_update(&kit, plain, sizeof(plain), cipher));
+  test_compare(size_t(16), hashkit_encrypt_final(&kit, plain +sizeof(plain), 0, cipher +sizeof(plain)));
+
+  for (size_t x= 0; x < 37; x++)
+  {
+    test_memcmp(aes256_cipher, cipher +16*x, 16);
+  }
+
+  size_t length;
+  test_true(hashkit_decrypt_buffer(&kit, cipher, sizeof(cipher), cipher, &length));
+  test_compare(sizeof(plain), length);
+  test_memcmp(plain, cipher, sizeof(plain));
+
+  hashkit_free(&kit);
+
+  return TEST_SUCCESS;
+}
+
+/*
+  Every engine the CPU has has to pass the known answer test, and produce
+  the same cipher text as the table engine for values long enough to take
+  the wide paths.
+*/
+static test_return_t hashkit_encrypt_engines_test(hashkit_st *)
+{
+  static const char *engines[]= { "table", "aesni", "vaes" };
+
+  char plain[16 * 37];
+  for (size_t x= 0; x < 37; x++)
+  {
+    memcpy(plain +16*x, aes256_plain, 16);
+  }
+
+  char value[1000];
+  for (size_t x= 0; x < sizeof(value); x++)
+  {
+    value[x]= char(x * 13);
+  }
+
+  char reference[sizeof(value) +16];
+  hashkit_st table;
+  for (size_t x= 0; x < sizeof(engines) / sizeof(engines[0]); x++)
+  {
+    hashkit_st kit;
+    test_true(hashkit_create(&kit));
+    test_true(hashkit_key(&kit, aes256_key, sizeof(aes256_key) -1));
+
+    if (hashkit_failed(hashkit_encrypt_set_engine(&kit, engines[x])))
+    {
+      // Not on this CPU
+      hashkit_free(&kit);
+      continue;
+    }
+    test_compare(0, strcmp(engines[x], hashkit_encrypt_engine(&kit)));
+
+    char cipher[sizeof(value) +16];
+    test_compare(sizeof(plain), hashkit_encrypt_update(&kit, plain, sizeof(plain), cipher));
+    for (size_t y= 0; y < 37; y++)
+    {
+      test_memcmp(aes256_cipher, cipher +16*y, 16);
+    }
+
+    size_t length= hashkit_encrypt_update(&kit, value, sizeof(value), cipher);
+    length+= hashkit_encrypt_final(&kit, value +length, sizeof(value) -length, cipher +length);
+    test_compare(hashkit_encrypt_length(&kit, sizeof(value)), length);
+
+    char *envelope= (char *)malloc(hashkit_gcm_length(&kit, sizeof(value)));
+    test_true(envelope);
+    test_compare(HASHKIT_SUCCESS,
+                 hashkit_gcm_encrypt(&kit, NULL, 0, value, sizeof(value), envelope, 1));
+
+    if (x == 0)
+    {
+      memcpy(reference, cipher, length);
+      table= kit;
+    }
+    else
+    {
+      test_memcmp(reference, cipher, length);
+    }
+
+    // Each engine decrypts what the table engine encrypted, and the other way round
+    size_t decrypted_length;
+    test_true(hashkit_decrypt_buffer(&kit, reference, length, cipher, &decrypted_length));
+    test_compare(sizeof(value), decrypted_length);
+    test_memcmp(value, cipher, sizeof(value));
+
+    test_compare(HASHKIT_SUCCESS,
+                 hashkit_gcm_decrypt(&table, NULL, 0, envelope, hashkit_gcm_length(&kit, sizeof(value)),
+                                     envelope, &decrypted_length, 1));
+    test_compare(sizeof(value), decrypted_length);
+    test_memcmp(value, envelope, sizeof(value));
+    free(envelope);
+
+    if (x)
+    {
+      hashkit_free(&kit);
+    }
+  }
+  hashkit_free(&table);
+
+  return TEST_SUCCESS;
+}
+
+static test_return_t hashkit_encrypt_buffer_test(hashkit_st *)
+{
+  hashkit_st kit;
+  test_true(hashkit_create(&kit));
+
+  char plain[1024];
+  char cipher[1024 +16];
+  char decrypted[1024 +16];
+  test_zero(hashkit_encrypt_update(&kit, plain, sizeof(plain), cipher));
+  test_zero(hashkit_encrypt_final(&kit, plain, 0, cipher));
+
+  test_true(hashkit_key(&kit, test_literal_param("hashkit_encrypt_buffer")));
+  for (size_t x= 0; x < sizeof(plain); x++)
+  {
+    plain[x]= char(x * 7);
+  }
+
+  // Cover every tail length and enough blocks for the wide code paths
+  for (size_t length= 0; length <= sizeof(plain); length+= (length < 64) ? 1 : 61)
+  {
+    size_t cipher_length= hashkit_encrypt_update(&kit, plain, length, cipher);
+    test_zero(cipher_length % 16);
+    cipher_length+= hashkit_encrypt_final(&kit, plain +cipher_length, length -cipher_length, cipher +cipher_length);
+    test_compare(hashkit_encrypt_length(&kit, length), cipher_length);
+
+    hashkit_string_st *allocated= hashkit_encrypt(&kit, plain, length);
+    test_true(allocated);
+    test_compare(cipher_length, hashkit_string_length(allocated));
+    test_memcmp(cipher, hashkit_string_c_str(allocated), cipher_length);
+    hashkit_string_free(allocated);
+
+    size_t decrypted_length;
+    test_true(hashkit_decrypt_buffer(&kit, cipher, cipher_length, decrypted, &decrypted_length));
+    test_compare(length, decrypted_length);
+    test_memcmp(plain, decrypted, length);
+  }
+
+  // Ciphertext has to be whole blocks
+  size_t decrypted_length;
+  test_false(hashkit_decrypt_buffer(&kit, cipher, 15, decrypted, &decrypted_length));
+  test_false(hashkit_decrypt_buffer(&kit, cipher, 0, decrypted, &decrypted_length));
+  test_false(hashkit_encrypt_final(&kit, plain, 16, cipher));
+
+  hashkit_free(&kit);
+
+  return TEST_SUCCESS;
+}
+
+static size_t hex_decode(const char *hex, char *destination)
+{
+  size_t length= 0;
+  for (; hex[0] and hex[1]; hex+= 2)
+  {
+    unsigned int byte;
+    sscanf(hex, "%2x", &byte);
+    destination[length++]= char(byte);
+  }
+
+  return length;
+}
+
+/*
+  Test cases 14 and 16 from the GCM specification (AES-256), fed in as
+  envelopes: cipher text, version, nonce, tag.
+*/
+static test_return_t hashkit_gcm_known_answer_test(hashkit_st *)
+{
+  struct {
+    const char *key;
+    const char *nonce;
+    const char *aad;
+    const char *plain;
+    const char *cipher;
+    const char *tag;
+  } vectors[]= {
+    { "0000000000000000000000000000000000000000000000000000000000000000",
+      "000000000000000000000000",
+      "",
+      "00000000000000000000000000000000",
+      "cea7403d4d606b6e074ec5d3baf39d18",
+      "d0d1c8a799996bf0265b98b5d48ab919" },
+    { "feffe9928665731c6d6a8f9467308308feffe9928665731c6d6a8f9467308308",
+      "cafebabefacedbaddecaf888",
+      "feedfacedeadbeeffeedfacedeadbeefabaddad2",
+      "d9313225f88406e5a55909c5aff5269a86a7a9531534f7da2e4c303d8a318a72"
+      "1c3c0c95956809532fcf0e2449a6b525b16aedf5aa0de657ba637b39",
+      "522dc1f099567d07f47f37a32a84427d643a8cdcbfe5c0c97598a2bd2555d1aa"
+      "8cb08e48590dbb3da7b08b1056828838c5f61e6393ba7a0abcc9f662",
+      "76fc6ece0f4e1768cddf8853bb2d551b" }
+  };
+
+  for (size_t x= 0; x < sizeof(vectors)/sizeof(vectors[0]); x++)
+  {
+    hashkit_st kit;
+    test_true(hashkit_create(&kit));
+
+    char key[32], aad[64], plain[64], envelope[128];
+    test_compare(sizeof(key), hex_decode(vectors[x].key, key));
+    test_true(hashkit_key(&kit, key, sizeof(key)));
+
+    size_t aad_length= hex_decode(vectors[x].aad, aad);
+    size_t plain_length= hex_decode(vectors[x].plain, plain);
+    size_t length= hex_decode(vectors[x].cipher, envelope);
+    test_compare(plain_length, length);
+    envelope[length++]= 1;
+    length+= hex_decode(vectors[x].nonce, envelope +length);
+    length+= hex_decode(vectors[x].tag, envelope +length);
+    test_compare(hashkit_gcm_length(&kit, plain_length), length);
+
+    size_t decrypted_length;
+    test_compare(HASHKIT_SUCCESS,
+                 hashkit_gcm_decrypt(&kit, aad, aad_length, envelope, length, envelope, &decrypted_length, 1));
+    test_compare(plain_length, decrypted_length);
+    test_memcmp(plain, envelope, plain_length);
+
+    hashkit_free(&kit);
+  }
+
+  return TEST_SUCCESS;
+}
+
+static test_return_t hashkit_gcm_test(hashkit_st *)
+{
+  hashkit_st kit;
+  test_true(hashkit_create(&kit));
+
+  const size_t size= 1024 * 1024;
+  char *plain= (char*)malloc(size);
+  char *envelope= (char*)malloc(hashkit_gcm_length(&kit, size));
+  char *second= (char*)malloc(hashkit_gcm_length(&kit, size));
+  test_true(plain and envelope and second);
+
+  test_compare(HASHKIT_INVALID_ARGUMENT,
+               hashkit_gcm_encrypt(&kit, NULL, 0, plain, 16, envelope, 1));
+
+  test_true(hashkit_key(&kit, test_literal_param("hashkit_gcm")));
+  for (size_t x= 0; x < size; x++)
+  {
+    plain[x]= char(x * 13);
+  }
+
+  // Sizes either side of the block and thread boundaries
+  size_t lengths[]= { 0, 1, 15, 16, 17, 255, 4096, 16 * 1024 +3, 100 * 1000, size };
+  for (size_t x= 0; x < sizeof(lengths)/sizeof(lengths[0]); x++)
+  {
+    size_t length= lengths[x];
+    size_t envelope_length= hashkit_gcm_length(&kit, length);
+
+    test_compare(HASHKIT_SUCCESS,
+                 hashkit_gcm_encrypt(&kit, test_literal_param("key"), plain, length, envelope, 1));
+
+    // A fresh nonce every time
+    test_compare(HASHKIT_SUCCESS,
+                 hashkit_gcm_encrypt(&kit, test_literal_param("key"), plain, length, second, 4));
+    test_true(memcmp(envelope +length, second +length, envelope_length -length));
+
+    for (uint32_t threads= 1; threads <= 8; threads*= 2)
+    {
+      size_t decrypted_length;
+      memcpy(second, envelope, envelope_length);
+      test_compare(HASHKIT_SUCCESS,
+                   hashkit_gcm_decrypt(&kit, test_literal_param("key"), second, envelope_length,
+                                       second, &decrypted_length, threads));
+      test_compare(length, decrypted_length);
+      test_memcmp(plain, second, length);
+    }
+
+    // Anything that was tampered with, or bound to another key, is refused
+    size_t decrypted_length;
+    test_compare(HASHKIT_FAILURE,
+                 hashkit_gcm_decrypt(&kit, test_literal_param("other"), envelope, envelope_length,
+                                     second, &decrypted_length, 1));
+    envelope[length / 2]^= 1;
+    test_compare(HASHKIT_FAILURE,
+                 hashkit_gcm_decrypt(&kit, test_literal_param("key"), envelope, envelope_length,
+                                     second, &decrypted_length, 2));
+  }
+
+  size_t decrypted_length;
+  test_compare(HASHKIT_FAILURE,
+               hashkit_gcm_decrypt(&kit, NULL, 0, envelope, 28, second, &decrypted_length, 1));
+
+  free(plain);
+  free(envelope);
+  free(second);
+  hashkit_free(&kit);
+
+  return TEST_SUCCESS;
+}
+
 test_st hashkit_st_functions[] ={
   {"hashkit_digest", 0, (test_callback_fn*)hashkit_digest_test},
   {"hashkit_set_function", 0, (test_callback_fn*)hashkit_set_function_test},
@@ -484,6 +802,11 @@ test_st hashkit_st_functions[] ={
   {"hashkit_set_distribution_function", 0, (test_callback_fn*)hashkit_set_distribution_function_test},
   {"hashkit_set_custom_distribution_function", 0, (test_callback_fn*)hashkit_set_custom_distribution_function_test},
   {"hashkit_compare", 0, (test_callback_fn*)hashkit_compare_test},
+  {"hashkit_encrypt known answer", 0, (test_callback_fn*)hashkit_encrypt_known_answer_test},
+  {"hashkit_encrypt engines", 0, (test_callback_fn*)hashkit_encrypt_engines_test},
+  {"hashkit_encrypt_update", 0, (test_callback_fn*)hashkit_encrypt_buffer_test},
+  {"hashkit_gcm known answer", 0, (test_callback_fn*)hashkit_gcm_known_answer_test},
+  {"hashkit_gcm_encrypt", 0, (test_callback_fn*)hashkit_gcm_test},
   {0, 0, 0}
 };
 
@@ -121,6 +121,8 @@ test_st tests[] ={
 test_st touch_tests[] ={
   {"memcached_touch", 0, (test_callback_fn*)test_memcached_touch},
   {"memcached_touch_with_prefix", 0, (test_callback_fn*)test_memcached_touch_by_key},
+  {"memcached_gat", 0, (test_callback_fn*)test_memcached_gat},
+  {"memcached_mgat", 0, (test_callback_fn*)test_memcached_mgat},
   {0, 0, 0}
 };
 
@@ -246,6 +248,11 @@ test_st replication_tests[]= {
   {"rand_mget", false, (test_callback_fn*)replication_randomize_mget_test },
   {"miss", false, (test_callback_fn*)replication_miss_test },
   {"fail", false, (test_callback_fn*)replication_randomize_mget_fail_test },
+  {"acks", true, (test_callback_fn*)replication_acks_TEST },
+  {"acks buffered", true, (test_callback_fn*)replication_acks_buffered_TEST },
+  {"hedged read behavior", false, (test_callback_fn*)replication_hedged_read_behavior_TEST },
+  {"hedged read", true, (test_callback_fn*)replication_hedged_read_TEST },
+  {"hedged read miss", true, (test_callback_fn*)replication_hedged_read_miss_TEST },
   {0, 0, (test_callback_fn*)0}
 };
 
@@ -420,6 +427,98 @@ test_st memcached_set_encoding_key_TESTS[] ={
   {"memcached_set_encoding_key() +decrement_with_initial()", true, (test_callback_fn*)memcached_set_encoding_key_decrement_with_initial_TEST },
   {"memcached_set_encoding_key() +set() +get() +cloen()", true, (test_callback_fn*)memcached_set_encoding_key_set_get_clone_TEST },
   {"memcached_set_encoding_key() +set() +get() increase value size", true, (test_callback_fn*)memcached_set_encoding_key_set_grow_key_TEST },
+  {"MEMCACHED_BEHAVIOR_ENCRYPTION", true, (test_callback_fn*)memcached_set_encoding_key_gcm_behavior_TEST },
+  {"MEMCACHED_ENCRYPTION_AES_GCM +set() +get()", true, (test_callback_fn*)memcached_set_encoding_key_gcm_set_get_TEST },
+  {"MEMCACHED_ENCRYPTION_AES_GCM +binary +set() +get()", true, (test_callback_fn*)memcached_set_encoding_key_gcm_binary_set_get_TEST },
+  {"MEMCACHED_ENCRYPTION_AES_GCM migration", true, (test_callback_fn*)memcached_set_encoding_key_gcm_migration_TEST },
+  {"MEMCACHED_ENCRYPTION_AES_GCM tamper", true, (test_callback_fn*)memcached_set_encoding_key_gcm_tamper_TEST },
+  {"MEMCACHED_ENCRYPTION_AES_GCM threaded", true, (test_callback_fn*)memcached_set_encoding_key_gcm_threaded_TEST },
+  {"memcached_mget_execute()", true, (test_callback_fn*)memcached_set_encoding_key_mget_execute_TEST },
+  {0, 0, (test_callback_fn*)0}
+};
+
+test_st memcached_near_cache_TESTS[] ={
+  {"hit", true, (test_callback_fn*)near_cache_hit_TEST },
+  {"invalidate", true, (test_callback_fn*)near_cache_invalidate_TEST },
+  {"gat", true, (test_callback_fn*)near_cache_gat_TEST },
+  {"ttl", true, (test_callback_fn*)near_cache_ttl_TEST },
+  {"stale while revalidate", true, (test_callback_fn*)near_cache_stale_TEST },
+  {"clone", true, (test_callback_fn*)near_cache_clone_TEST },
+  {"scan resistance", true, (test_callback_fn*)near_cache_scan_resistance_TEST },
+  {0, 0, (test_callback_fn*)0}
+};
+
+test_st memcached_coalesce_gets_TESTS[] ={
+  {"behavior", true, (test_callback_fn*)coalesce_gets_behavior_TEST },
+  {"concurrent gets", true, (test_callback_fn*)coalesce_gets_TEST },
+  {"shared read-through", true, (test_callback_fn*)coalesce_gets_shared_read_through_TEST },
+  {"encoding key", true, (test_callback_fn*)coalesce_gets_encoding_key_TEST },
+  {"bounded wait", true, (test_callback_fn*)coalesce_gets_timeout_TEST },
+  {0, 0, (test_callback_fn*)0}
+};
+
+test_st memcached_mget_dedupe_TESTS[] ={
+  {"behavior", true, (test_callback_fn*)mget_dedupe_behavior_TEST },
+  {"memcached_fetch_result()", true, (test_callback_fn*)mget_dedupe_fetch_result_TEST },
+  {"memcached_fetch()", true, (test_callback_fn*)mget_dedupe_fetch_TEST },
+  {"memcached_fetch_execute()", true, (test_callback_fn*)mget_dedupe_fetch_execute_TEST },
+  {"memcached_mget_execute()", true, (test_callback_fn*)mget_dedupe_mget_execute_TEST },
+  {"benchmark", true, (test_callback_fn*)mget_dedupe_benchmark_TEST },
+  {0, 0, (test_callback_fn*)0}
+};
+
+test_st memcached_server_telemetry_TESTS[] ={
+  {"behavior", true, (test_callback_fn*)telemetry_behavior_TEST },
+  {"operations", true, (test_callback_fn*)telemetry_operations_TEST },
+  {"memcached_telemetry_merge()", true, (test_callback_fn*)telemetry_merge_TEST },
+  {"memcached_histogram_percentile()", false, (test_callback_fn*)telemetry_percentile_TEST },
+  {0, 0, (test_callback_fn*)0}
+};
+
+test_st memcached_set_trace_fn_TESTS[] ={
+  {"memcached_set_trace_fn()", true, (test_callback_fn*)trace_fn_TEST },
+  {"events", true, (test_callback_fn*)trace_events_TEST },
+  {"sample rate", true, (test_callback_fn*)trace_sample_rate_TEST },
+  {"memcached_clone()", true, (test_callback_fn*)trace_clone_TEST },
+  {0, 0, (test_callback_fn*)0}
+};
+
+test_st memcached_slowlog_TESTS[] ={
+  {"memcached_slowlog_create()", true, (test_callback_fn*)slowlog_create_TEST },
+  {"entries", true, (test_callback_fn*)slowlog_entries_TEST },
+  {"capacity", true, (test_callback_fn*)slowlog_capacity_TEST },
+  {"threshold", true, (test_callback_fn*)slowlog_threshold_TEST },
+  {"memcached_clone()", true, (test_callback_fn*)slowlog_clone_TEST },
+  {0, 0, (test_callback_fn*)0}
+};
+
+test_st memcached_compression_TESTS[] ={
+  {"MEMCACHED_BEHAVIOR_COMPRESSION", true, (test_callback_fn*)compression_behavior_TEST },
+  {"MEMCACHED_COMPRESSION_FAST +set() +get()", true, (test_callback_fn*)compression_set_get_TEST },
+  {"MEMCACHED_COMPRESSION_ZLIB +set() +get()", true, (test_callback_fn*)compression_zlib_set_get_TEST },
+  {"MEMCACHED_BEHAVIOR_COMPRESSION_THRESHOLD", true, (test_callback_fn*)compression_threshold_TEST },
+  {"incompressible", true, (test_callback_fn*)compression_incompressible_TEST },
+  {"MEMCACHED_FLAG_COMPRESSED", true, (test_callback_fn*)compression_reserved_flag_TEST },
+  {"memcached_set_compression_dictionary()", true, (test_callback_fn*)compression_dictionary_TEST },
+  {"corrupt", true, (test_callback_fn*)compression_corrupt_TEST },
+  {"memcached_set_encoding_key()", true, (test_callback_fn*)compression_encrypted_TEST },
+  {"binary +mget() +fetch_result()", true, (test_callback_fn*)compression_binary_TEST },
+  {"memcached_mget_execute()", true, (test_callback_fn*)compression_mget_execute_TEST },
+  {"append() prepend()", true, (test_callback_fn*)compression_append_TEST },
+  {"memcached_clone()", true, (test_callback_fn*)compression_clone_TEST },
+  {0, 0, (test_callback_fn*)0}
+};
+
+test_st memcached_meta_TESTS[] ={
+  {"MEMCACHED_BEHAVIOR_META_PROTOCOL", true, (test_callback_fn*)meta_behavior_TEST },
+  {"MEMCACHED_BEHAVIOR_USE_UDP", true, (test_callback_fn*)meta_udp_TEST },
+  {"base64 key length", true, (test_callback_fn*)meta_key_length_TEST },
+  {"set() +get()", true, (test_callback_fn*)meta_set_get_TEST },
+  {"binary key +namespace", true, (test_callback_fn*)meta_binary_key_TEST },
+  {"mget() +fetch_result()", true, (test_callback_fn*)meta_mget_TEST },
+  {"cas()", true, (test_callback_fn*)meta_cas_TEST },
+  {"increment() +decrement()", true, (test_callback_fn*)meta_increment_TEST },
+  {"MEMCACHED_BEHAVIOR_NOREPLY", true, (test_callback_fn*)meta_noreply_TEST },
   {0, 0, (test_callback_fn*)0}
 };
 
@@ -500,9 +599,18 @@ collection_st collection[] ={
   {"memcached_server_get_last_disconnect", 0, 0, memcached_server_get_last_disconnect_tests},
   {"touch", 0, 0, touch_tests},
   {"touch", (test_callback_fn*)pre_binary, 0, touch_tests},
+  {"touch(META)", (test_callback_fn*)pre_meta, 0, touch_tests},
   {"memcached_stat()", 0, 0, memcached_stat_tests},
   {"memcached_pool_create()", 0, 0, pool_TESTS},
   {"memcached_set_encoding_key()", 0, 0, memcached_set_encoding_key_TESTS},
+  {"memcached_near_cache_create()", 0, 0, memcached_near_cache_TESTS},
+  {"memcached coalesced gets", 0, 0, memcached_coalesce_gets_TESTS},
+  {"MEMCACHED_BEHAVIOR_MGET_DEDUPE", 0, 0, memcached_mget_dedupe_TESTS},
+  {"MEMCACHED_BEHAVIOR_SERVER_TELEMETRY", 0, 0, memcached_server_telemetry_TESTS},
+  {"memcached_set_trace_fn", 0, 0, memcached_set_trace_fn_TESTS},
+  {"memcached_slowlog", 0, 0, memcached_slowlog_TESTS},
+  {"MEMCACHED_BEHAVIOR_COMPRESSION", 0, 0, memcached_compression_TESTS},
+  {"MEMCACHED_BEHAVIOR_META_PROTOCOL", 0, 0, memcached_meta_TESTS},
   {"kill()", 0, 0, kill_TESTS},
   {0, 0, 0, 0}
 };
@@ -63,6 +63,14 @@
 
 #include "tests/libmemcached-1.0/mem_functions.h"
 #include "tests/libmemcached-1.0/encoding_key.h"
+#include "tests/libmemcached-1.0/near_cache.h"
+#include "tests/libmemcached-1.0/coalesce.h"
+#include "tests/libmemcached-1.0/mget_dedupe.h"
+#include "tests/libmemcached-1.0/telemetry.h"
+#include "tests/libmemcached-1.0/trace.h"
+#include "tests/libmemcached-1.0/slowlog.h"
+#include "tests/libmemcached-1.0/compression.h"
+#include "tests/libmemcached-1.0/meta.h"
 
 /* Collections we are running */
 #include "tests/libmemcached-1.0/all_tests.h"
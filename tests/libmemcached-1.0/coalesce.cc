@@ -0,0 +1,287 @@
+/*  vim:expandtab:shiftwidth=2:tabstop=2:smarttab:
+ * 
+ *  Libmemcached library
+ *
+ *  Copyright (C) 2011-2012 Data Differential, http://datadifferential.com/
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are
+ *  met:
+ *
+ *      * Redistributions of source code must retain the above copyright
+ *  notice, this list of conditions and the following disclaimer.
+ *
+ *      * Redistributions in binary form must reproduce the above
+ *  copyright notice, this list of conditions and the following disclaimer
+ *  in the documentation and/or other materials provided with the
+ *  distribution.
+ *
+ *      * The names of its contributors may not be used to endorse or
+ *  promote products derived from this software without specific prior
+ *  written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *  A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *  OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *  SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *  LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *  DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *  THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *  OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+#include <config.h>
+#include <libtest/test.hpp>
+
+using namespace libtest;
+
+#include <libmemcached-1.0/memcached.h>
+
+#include <pthread.h>
+
+#include "tests/libmemcached-1.0/coalesce.h"
+
+#define COALESCE_THREADS 8
+
+static pthread_mutex_t read_through_lock= PTHREAD_MUTEX_INITIALIZER;
+static uint32_t read_through_calls;
+
+/*
+  A slow backing store, every caller that gets here would have gone to
+  the database on a miss.
+*/
+static memcached_return_t slow_read_through(const memcached_st *, const char *, size_t, memcached_result_st *result)
+{
+  pthread_mutex_lock(&read_through_lock);
+  read_through_calls++;
+  pthread_mutex_unlock(&read_through_lock);
+
+  libtest::dream(0, 500 * 1000 * 1000);
+
+  return memcached_result_set_value(result, test_literal_param("backing store"));
+}
+
+struct coalesce_context_st {
+  memcached_st *memc;
+  pthread_barrier_t *barrier;
+  const char *key;
+  bool matched;
+};
+
+static void *coalesce_get(void *arg)
+{
+  coalesce_context_st *context= static_cast<coalesce_context_st *>(arg);
+  pthread_barrier_wait(context->barrier);
+
+  size_t value_length;
+  uint32_t flags;
+  memcached_return_t rc;
+  char *value= memcached_get(context->memc, context->key, strlen(context->key), &value_length, &flags, &rc);
+  context->matched= value and memcached_success(rc) and
+    value_length == strlen("backing store") and memcmp(value, "backing store", value_length) == 0;
+  free(value);
+
+  return NULL;
+}
+
+/*
+  Start COALESCE_THREADS gets of a missing key at the same time, each on its
+  own memcached_st, and return how many times the read-through ran. Every
+  other thread uses encoding_key when there is one.
+*/
+static test_return_t run_coalesced_gets(memcached_st *original, uint64_t mode, const char *key, uint32_t& calls,
+                                        const char *encoding_key= NULL)
+{
+  memcached_st *memc= memcached_clone(NULL, original);
+  test_true(memc);
+  test_compare(MEMCACHED_SUCCESS, memcached_behavior_set(memc, MEMCACHED_BEHAVIOR_COALESCE_GETS, mode));
+  test_compare(MEMCACHED_SUCCESS,
+               memcached_callback_set(memc, MEMCACHED_CALLBACK_GET_FAILURE, reinterpret_cast<void *>(slow_read_through)));
+
+  memcached_return_t rc= memcached_delete(memc, key, strlen(key), 0);
+  test_true(rc == MEMCACHED_SUCCESS or rc == MEMCACHED_NOTFOUND);
+
+  pthread_mutex_lock(&read_through_lock);
+  read_through_calls= 0;
+  pthread_mutex_unlock(&read_through_lock);
+
+  pthread_barrier_t barrier;
+  test_zero(pthread_barrier_init(&barrier, NULL, COALESCE_THREADS));
+
+  pthread_t threads[COALESCE_THREADS];
+  coalesce_context_st contexts[COALESCE_THREADS];
+  for (uint32_t x= 0; x < COALESCE_THREADS; x++)
+  {
+    contexts[x].memc= memcached_clone(NULL, memc);
+    test_true(contexts[x].memc);
+    if (encoding_key and x % 2)
+    {
+      test_compare(MEMCACHED_SUCCESS, memcached_set_encoding_key(contexts[x].memc, encoding_key, strlen(encoding_key)));
+    }
+    contexts[x].barrier= &barrier;
+    contexts[x].key= key;
+    contexts[x].matched= false;
+  }
+
+  for (uint32_t x= 0; x < COALESCE_THREADS; x++)
+  {
+    test_zero(pthread_create(&threads[x], NULL, coalesce_get, &contexts[x]));
+  }
+
+  for (uint32_t x= 0; x < COALESCE_THREADS; x++)
+  {
+    test_zero(pthread_join(threads[x], NULL));
+  }
+  pthread_barrier_destroy(&barrier);
+
+  for (uint32_t x= 0; x < COALESCE_THREADS; x++)
+  {
+    test_true(contexts[x].matched);
+    memcached_free(contexts[x].memc);
+  }
+  memcached_free(memc);
+
+  pthread_mutex_lock(&read_through_lock);
+  calls= read_through_calls;
+  pthread_mutex_unlock(&read_through_lock);
+
+  return TEST_SUCCESS;
+}
+
+test_return_t coalesce_gets_behavior_TEST(memcached_st *original)
+{
+  memcached_st *memc= memcached_clone(NULL, original);
+  test_true(memc);
+
+  test_zero(memcached_behavior_get(memc, MEMCACHED_BEHAVIOR_COALESCE_GETS));
+  for (uint64_t mode= 0; mode <= 2; mode++)
+  {
+    test_compare(MEMCACHED_SUCCESS, memcached_behavior_set(memc, MEMCACHED_BEHAVIOR_COALESCE_GETS, mode));
+    test_compare(mode, memcached_behavior_get(memc, MEMCACHED_BEHAVIOR_COALESCE_GETS));
+  }
+
+  test_compare(MEMCACHED_INVALID_ARGUMENTS, memcached_behavior_set(memc, MEMCACHED_BEHAVIOR_COALESCE_GETS, 3));
+  test_compare(uint64_t(2), memcached_behavior_get(memc, MEMCACHED_BEHAVIOR_COALESCE_GETS));
+
+  memcached_st *clone= memcached_clone(NULL, memc);
+  test_true(clone);
+  test_compare(uint64_t(2), memcached_behavior_get(clone, MEMCACHED_BEHAVIOR_COALESCE_GETS));
+  memcached_free(clone);
+
+  // A coalesced get of a key that is there returns it like any other get
+  test_compare(MEMCACHED_SUCCESS,
+               memcached_set(memc, test_literal_param(__func__), test_literal_param("value"), 0, 3));
+  size_t value_length;
+  uint32_t flags;
+  memcached_return_t rc;
+  char *value= memcached_get(memc, test_literal_param(__func__), &value_length, &flags, &rc);
+  test_compare(MEMCACHED_SUCCESS, rc);
+  test_true(value);
+  test_compare(test_literal_param_size("value"), value_length);
+  test_memcmp("value", value, value_length);
+  test_compare(uint32_t(3), flags);
+  free(value);
+
+  test_null(memcached_get(memc, test_literal_param("coalesce_gets_missing"), &value_length, &flags, &rc));
+  test_compare(MEMCACHED_NOTFOUND, rc);
+
+  memcached_free(memc);
+
+  return TEST_SUCCESS;
+}
+
+test_return_t coalesce_gets_TEST(memcached_st *original)
+{
+  uint32_t calls;
+  test_compare(TEST_SUCCESS, run_coalesced_gets(original, 1, __func__, calls));
+
+  // Only the get is shared, every caller still runs its own read-through
+  test_true(calls > 1);
+
+  return TEST_SUCCESS;
+}
+
+test_return_t coalesce_gets_shared_read_through_TEST(memcached_st *original)
+{
+  uint32_t calls;
+  test_compare(TEST_SUCCESS, run_coalesced_gets(original, 2, __func__, calls));
+  test_compare(uint32_t(1), calls);
+
+  return TEST_SUCCESS;
+}
+
+test_return_t coalesce_gets_encoding_key_TEST(memcached_st *original)
+{
+  // A handle with an encoding key can't hand its value to one without
+  uint32_t calls;
+  test_compare(TEST_SUCCESS, run_coalesced_gets(original, 2, __func__, calls, "coalesce"));
+  test_compare(uint32_t(2), calls);
+
+  return TEST_SUCCESS;
+}
+
+static void *coalesce_leader(void *arg)
+{
+  coalesce_context_st *context= static_cast<coalesce_context_st *>(arg);
+
+  size_t value_length;
+  uint32_t flags;
+  memcached_return_t rc;
+  free(memcached_get(context->memc, context->key, strlen(context->key), &value_length, &flags, &rc));
+  context->matched= memcached_success(rc);
+
+  return NULL;
+}
+
+test_return_t coalesce_gets_timeout_TEST(memcached_st *original)
+{
+  memcached_st *memc= memcached_clone(NULL, original);
+  test_true(memc);
+  test_compare(MEMCACHED_SUCCESS, memcached_behavior_set(memc, MEMCACHED_BEHAVIOR_COALESCE_GETS, 2));
+  memcached_return_t rc= memcached_delete(memc, test_literal_param(__func__), 0);
+  test_true(rc == MEMCACHED_SUCCESS or rc == MEMCACHED_NOTFOUND);
+
+  // Both spend half a second in their read-through
+  test_compare(MEMCACHED_SUCCESS,
+               memcached_callback_set(memc, MEMCACHED_CALLBACK_GET_FAILURE, reinterpret_cast<void *>(slow_read_through)));
+  memcached_st *waiter= memcached_clone(NULL, memc);
+  test_true(waiter);
+  test_compare(MEMCACHED_SUCCESS, memcached_behavior_set(waiter, MEMCACHED_BEHAVIOR_POLL_TIMEOUT, 100));
+
+  pthread_mutex_lock(&read_through_lock);
+  read_through_calls= 0;
+  pthread_mutex_unlock(&read_through_lock);
+
+  coalesce_context_st context= { memc, NULL, __func__, false };
+  pthread_t leader;
+  test_zero(pthread_create(&leader, NULL, coalesce_leader, &context));
+  libtest::dream(0, 200 * 1000 * 1000);
+
+  // The waiter gives up on the leader and makes the get itself, rather than fail one that would succeed
+  size_t value_length;
+  uint32_t flags;
+  char *value= memcached_get(waiter, test_literal_param(__func__), &value_length, &flags, &rc);
+  test_compare(MEMCACHED_SUCCESS, rc);
+  test_true(value);
+  test_compare(test_literal_param_size("backing store"), value_length);
+  test_memcmp("backing store", value, value_length);
+  free(value);
+
+  test_zero(pthread_join(leader, NULL));
+  test_true(context.matched);
+
+  pthread_mutex_lock(&read_through_lock);
+  uint32_t calls= read_through_calls;
+  pthread_mutex_unlock(&read_through_lock);
+  test_compare(uint32_t(2), calls);
+
+  memcached_free(waiter);
+  memcached_free(memc);
+
+  return TEST_SUCCESS;
+}
@@ -0,0 +1,617 @@
+/*  vim:expandtab:shiftwidth=2:tabstop=2:smarttab:
+ * 
+ *  Libmemcached library
+ *
+ *  Copyright (C) 2011-2012 Data Differential, http://datadifferential.com/
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are
+ *  met:
+ *
+ *      * Redistributions of source code must retain the above copyright
+ *  notice, this list of conditions and the following disclaimer.
+ *
+ *      * Redistributions in binary form must reproduce the above
+ *  copyright notice, this list of conditions and the following disclaimer
+ *  in the documentation and/or other materials provided with the
+ *  distribution.
+ *
+ *      * The names of its contributors may not be used to endorse or
+ *  promote products derived from this software without specific prior
+ *  written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *  A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *  OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *  SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *  LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *  DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *  THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *  OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+#include <config.h>
+#include <libtest/test.hpp>
+
+using namespace libtest;
+
+#include <libmemcached-1.0/memcached.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "tests/libmemcached-1.0/compression.h"
+
+static std::string compressible_value(size_t length)
+{
+  std::string value;
+  for (uint32_t x= 0; value.size() < length; x++)
+  {
+    char buffer[64];
+    int buffer_length= snprintf(buffer, sizeof(buffer), "{\"id\":%u,\"name\":\"user%u\",\"active\":true},", x, x % 97);
+    value.append(buffer, size_t(buffer_length));
+  }
+  value.resize(length);
+
+  return value;
+}
+
+static test_return_t compression_round_trip(memcached_st *memc, const char *key, const std::string& expected, uint32_t expected_flags)
+{
+  memcached_return_t rc;
+  size_t value_length;
+  uint32_t flags;
+  char *value= memcached_get(memc, key, strlen(key), &value_length, &flags, &rc);
+  test_compare_hint(MEMCACHED_SUCCESS, rc, memcached_last_error_message(memc));
+  test_compare(expected.size(), value_length);
+  test_memcmp(expected.c_str(), value, value_length);
+  test_compare(expected_flags, flags);
+  free(value);
+
+  return TEST_SUCCESS;
+}
+
+// What a client without compression sees
+static test_return_t compression_raw(memcached_st *memc, const char *key, size_t& raw_length, uint32_t& raw_flags)
+{
+  memcached_st *plain= memcached_clone(NULL, memc);
+  test_true(plain);
+  test_compare(MEMCACHED_SUCCESS, memcached_behavior_set(plain, MEMCACHED_BEHAVIOR_COMPRESSION, MEMCACHED_COMPRESSION_NONE));
+
+  memcached_return_t rc;
+  char *raw= memcached_get(plain, key, strlen(key), &raw_length, &raw_flags, &rc);
+  test_compare(MEMCACHED_SUCCESS, rc);
+  free(raw);
+  memcached_free(plain);
+
+  return TEST_SUCCESS;
+}
+
+test_return_t compression_behavior_TEST(memcached_st *original)
+{
+  memcached_st *memc= memcached_clone(NULL, original);
+  test_true(memc);
+
+  test_compare(uint64_t(MEMCACHED_COMPRESSION_NONE), memcached_behavior_get(memc, MEMCACHED_BEHAVIOR_COMPRESSION));
+  test_compare(uint64_t(MEMCACHED_DEFAULT_COMPRESSION_THRESHOLD),
+               memcached_behavior_get(memc, MEMCACHED_BEHAVIOR_COMPRESSION_THRESHOLD));
+
+  test_compare(MEMCACHED_INVALID_ARGUMENTS, memcached_behavior_set(memc, MEMCACHED_BEHAVIOR_COMPRESSION, MEMCACHED_COMPRESSION_MAX));
+  test_compare(MEMCACHED_SUCCESS, memcached_behavior_set(memc, MEMCACHED_BEHAVIOR_COMPRESSION, MEMCACHED_COMPRESSION_FAST));
+  test_compare(uint64_t(MEMCACHED_COMPRESSION_FAST), memcached_behavior_get(memc, MEMCACHED_BEHAVIOR_COMPRESSION));
+
+  if (LIBMEMCACHED_WITH_LIBZ)
+  {
+    test_compare(MEMCACHED_SUCCESS, memcached_behavior_set(memc, MEMCACHED_BEHAVIOR_COMPRESSION, MEMCACHED_COMPRESSION_ZLIB));
+    test_compare(uint64_t(MEMCACHED_COMPRESSION_ZLIB), memcached_behavior_get(memc, MEMCACHED_BEHAVIOR_COMPRESSION));
+  }
+  else
+  {
+    test_compare(MEMCACHED_NOT_SUPPORTED, memcached_behavior_set(memc, MEMCACHED_BEHAVIOR_COMPRESSION, MEMCACHED_COMPRESSION_ZLIB));
+  }
+
+  test_compare(MEMCACHED_SUCCESS, memcached_behavior_set(memc, MEMCACHED_BEHAVIOR_COMPRESSION_THRESHOLD, 1024));
+  test_compare(uint64_t(1024), memcached_behavior_get(memc, MEMCACHED_BEHAVIOR_COMPRESSION_THRESHOLD));
+  test_compare(MEMCACHED_INVALID_ARGUMENTS,
+               memcached_behavior_set(memc, MEMCACHED_BEHAVIOR_COMPRESSION_THRESHOLD, uint64_t(UINT32_MAX) +1));
+
+  memcached_compression_stat_st stat;
+  test_compare(MEMCACHED_INVALID_ARGUMENTS, memcached_compression_stat(memc, NULL));
+  test_compare(MEMCACHED_SUCCESS, memcached_compression_stat(memc, &stat));
+  test_zero(stat.compressed);
+
+  memcached_free(memc);
+
+  return TEST_SUCCESS;
+}
+
+static test_return_t compression_set_get(memcached_st *original, memcached_compression_t codec)
+{
+  memcached_st *memc= memcached_clone(NULL, original);
+  test_true(memc);
+  test_compare(MEMCACHED_SUCCESS, memcached_behavior_set(memc, MEMCACHED_BEHAVIOR_COMPRESSION, codec));
+
+  std::string value= compressible_value(64 * 1024);
+  test_compare_hint(MEMCACHED_SUCCESS,
+                    memcached_set(memc, test_literal_param("compression_set_get"), value.c_str(), value.size(), 0, 7),
+                    memcached_last_error_message(memc));
+  test_compare(TEST_SUCCESS, compression_round_trip(memc, "compression_set_get", value, 7));
+
+  memcached_compression_stat_st stat;
+  test_compare(MEMCACHED_SUCCESS, memcached_compression_stat(memc, &stat));
+  test_compare(uint64_t(1), stat.compressed);
+  test_compare(uint64_t(value.size()), stat.bytes_in);
+  test_true(stat.bytes_out < stat.bytes_in / 4);
+  test_compare(uint64_t(1), stat.decompressed);
+  test_compare(stat.bytes_out, stat.decompressed_bytes_in);
+  test_compare(uint64_t(value.size()), stat.decompressed_bytes_out);
+  test_zero(stat.failures);
+
+  size_t raw_length;
+  uint32_t raw_flags;
+  test_compare(TEST_SUCCESS, compression_raw(memc, "compression_set_get", raw_length, raw_flags));
+  test_compare(uint64_t(raw_length), stat.bytes_out);
+  test_compare(uint32_t(7 | MEMCACHED_FLAG_COMPRESSED), raw_flags);
+
+  memcached_compression_stat_reset(memc);
+  test_compare(MEMCACHED_SUCCESS, memcached_compression_stat(memc, &stat));
+  test_zero(stat.compressed);
+  test_zero(stat.decompressed);
+
+  // A value decoded into a result that is reused for a smaller one
+  test_compare(MEMCACHED_SUCCESS,
+               memcached_set(memc, test_literal_param("compression_set_get_small"), value.c_str(), 1000, 0, 0));
+  test_compare(TEST_SUCCESS, compression_round_trip(memc, "compression_set_get_small", value.substr(0, 1000), 0));
+  test_compare(TEST_SUCCESS, compression_round_trip(memc, "compression_set_get", value, 7));
+
+  memcached_free(memc);
+
+  return TEST_SUCCESS;
+}
+
+test_return_t compression_set_get_TEST(memcached_st *memc)
+{
+  return compression_set_get(memc, MEMCACHED_COMPRESSION_FAST);
+}
+
+test_return_t compression_zlib_set_get_TEST(memcached_st *memc)
+{
+  if (LIBMEMCACHED_WITH_LIBZ == 0)
+  {
+    return TEST_SKIPPED;
+  }
+
+  return compression_set_get(memc, MEMCACHED_COMPRESSION_ZLIB);
+}
+
+test_return_t compression_threshold_TEST(memcached_st *original)
+{
+  memcached_st *memc= memcached_clone(NULL, original);
+  test_true(memc);
+  test_compare(MEMCACHED_SUCCESS, memcached_behavior_set(memc, MEMCACHED_BEHAVIOR_COMPRESSION, MEMCACHED_COMPRESSION_FAST));
+  test_compare(MEMCACHED_SUCCESS, memcached_behavior_set(memc, MEMCACHED_BEHAVIOR_COMPRESSION_THRESHOLD, 4096));
+
+  std::string value= compressible_value(4095);
+  test_compare(MEMCACHED_SUCCESS,
+               memcached_set(memc, test_literal_param("compression_threshold"), value.c_str(), value.size(), 0, 0));
+
+  memcached_compression_stat_st stat;
+  test_compare(MEMCACHED_SUCCESS, memcached_compression_stat(memc, &stat));
+  test_zero(stat.compressed);
+  test_zero(stat.skipped);
+
+  size_t raw_length;
+  uint32_t raw_flags;
+  test_compare(TEST_SUCCESS, compression_raw(memc, "compression_threshold", raw_length, raw_flags));
+  test_compare(value.size(), raw_length);
+  test_zero(raw_flags);
+
+  value.push_back('x');
+  test_compare(MEMCACHED_SUCCESS,
+               memcached_set(memc, test_literal_param("compression_threshold"), value.c_str(), value.size(), 0, 0));
+  test_compare(MEMCACHED_SUCCESS, memcached_compression_stat(memc, &stat));
+  test_compare(uint64_t(1), stat.compressed);
+  test_compare(TEST_SUCCESS, compression_round_trip(memc, "compression_threshold", value, 0));
+
+  memcached_free(memc);
+
+  return TEST_SUCCESS;
+}
+
+test_return_t compression_incompressible_TEST(memcached_st *original)
+{
+  memcached_st *memc= memcached_clone(NULL, original);
+  test_true(memc);
+  test_compare(MEMCACHED_SUCCESS, memcached_behavior_set(memc, MEMCACHED_BEHAVIOR_COMPRESSION, MEMCACHED_COMPRESSION_FAST));
+
+  std::string value;
+  for (size_t x= 0; x < 8192; x++)
+  {
+    value.push_back(char(random()));
+  }
+
+  test_compare(MEMCACHED_SUCCESS,
+               memcached_set(memc, test_literal_param("compression_incompressible"), value.c_str(), value.size(), 0, 0));
+
+  memcached_compression_stat_st stat;
+  test_compare(MEMCACHED_SUCCESS, memcached_compression_stat(memc, &stat));
+  test_zero(stat.compressed);
+  test_compare(uint64_t(1), stat.skipped);
+
+  size_t raw_length;
+  uint32_t raw_flags;
+  test_compare(TEST_SUCCESS, compression_raw(memc, "compression_incompressible", raw_length, raw_flags));
+  test_compare(value.size(), raw_length);
+  test_zero(raw_flags);
+  test_compare(TEST_SUCCESS, compression_round_trip(memc, "compression_incompressible", value, 0));
+
+  memcached_free(memc);
+
+  return TEST_SUCCESS;
+}
+
+test_return_t compression_reserved_flag_TEST(memcached_st *original)
+{
+  memcached_st *memc= memcached_clone(NULL, original);
+  test_true(memc);
+
+  // The bit is the application's while compression is off
+  test_compare(MEMCACHED_SUCCESS,
+               memcached_set(memc, test_literal_param("compression_reserved_flag"), test_literal_param("value"), 0, MEMCACHED_FLAG_COMPRESSED));
+
+  test_compare(MEMCACHED_SUCCESS, memcached_behavior_set(memc, MEMCACHED_BEHAVIOR_COMPRESSION, MEMCACHED_COMPRESSION_FAST));
+  test_compare(MEMCACHED_INVALID_ARGUMENTS,
+               memcached_set(memc, test_literal_param("compression_reserved_flag"), test_literal_param("value"), 0, MEMCACHED_FLAG_COMPRESSED));
+
+  memcached_free(memc);
+
+  return TEST_SUCCESS;
+}
+
+test_return_t compression_dictionary_TEST(memcached_st *original)
+{
+  memcached_st *memc= memcached_clone(NULL, original);
+  test_true(memc);
+  test_compare(MEMCACHED_SUCCESS, memcached_behavior_set(memc, MEMCACHED_BEHAVIOR_COMPRESSION, MEMCACHED_COMPRESSION_FAST));
+  test_compare(MEMCACHED_SUCCESS, memcached_behavior_set(memc, MEMCACHED_BEHAVIOR_COMPRESSION_THRESHOLD, 64));
+
+  // A small document shares little with itself, but a lot with the dictionary
+  std::string value= "{\"id\":12345,\"name\":\"user17\",\"email\":\"user17@example.com\",\"active\":true,\"roles\":[\"reader\"]}";
+  std::string dictionary= "{\"id\":1,\"name\":\"user1\",\"email\":\"user1@example.com\",\"active\":true,\"roles\":[\"reader\",\"writer\"]}";
+
+  test_compare(MEMCACHED_SUCCESS,
+               memcached_set(memc, test_literal_param("compression_dictionary"), value.c_str(), value.size(), 0, 0));
+  memcached_compression_stat_st stat;
+  test_compare(MEMCACHED_SUCCESS, memcached_compression_stat(memc, &stat));
+  test_zero(stat.compressed);
+
+  test_compare(MEMCACHED_SUCCESS, memcached_set_compression_dictionary(memc, dictionary.c_str(), dictionary.size()));
+  test_compare(MEMCACHED_SUCCESS,
+               memcached_set(memc, test_literal_param("compression_dictionary"), value.c_str(), value.size(), 0, 0));
+  test_compare(MEMCACHED_SUCCESS, memcached_compression_stat(memc, &stat));
+  test_compare(uint64_t(1), stat.compressed);
+  test_true(stat.bytes_out < stat.bytes_in / 2);
+  test_compare(TEST_SUCCESS, compression_round_trip(memc, "compression_dictionary", value, 0));
+
+  // Another dictionary cannot read it, and the connection survives
+  memcached_st *other= memcached_clone(NULL, memc);
+  test_true(other);
+  test_compare(MEMCACHED_SUCCESS, memcached_set_compression_dictionary(other, test_literal_param("something else entirely")));
+  memcached_return_t rc;
+  size_t value_length;
+  test_null(memcached_get(other, test_literal_param("compression_dictionary"), &value_length, NULL, &rc));
+  test_compare(MEMCACHED_FAILURE, rc);
+  test_compare(MEMCACHED_SUCCESS, memcached_compression_stat(other, &stat));
+  test_compare(uint64_t(1), stat.failures);
+
+  test_compare(MEMCACHED_SUCCESS, memcached_set_compression_dictionary(other, NULL, 0));
+  test_null(memcached_get(other, test_literal_param("compression_dictionary"), &value_length, NULL, &rc));
+  test_compare(MEMCACHED_FAILURE, rc);
+
+  test_compare(MEMCACHED_SUCCESS, memcached_set_compression_dictionary(other, dictionary.c_str(), dictionary.size()));
+  test_compare(TEST_SUCCESS, compression_round_trip(other, "compression_dictionary", value, 0));
+  memcached_free(other);
+
+  if (LIBMEMCACHED_WITH_LIBZ)
+  {
+    test_compare(MEMCACHED_SUCCESS, memcached_behavior_set(memc, MEMCACHED_BEHAVIOR_COMPRESSION, MEMCACHED_COMPRESSION_ZLIB));
+    memcached_compression_stat_reset(memc);
+    test_compare(MEMCACHED_SUCCESS,
+                 memcached_set(memc, test_literal_param("compression_dictionary"), value.c_str(), value.size(), 0, 0));
+    test_compare(MEMCACHED_SUCCESS, memcached_compression_stat(memc, &stat));
+    test_compare(uint64_t(1), stat.compressed);
+    test_compare(TEST_SUCCESS, compression_round_trip(memc, "compression_dictionary", value, 0));
+  }
+
+  memcached_free(memc);
+
+  return TEST_SUCCESS;
+}
+
+// Nothing in these tests needs a buffer anywhere near this large
+#define COMPRESSION_ALLOCATION_LIMIT (64 * 1024 * 1024)
+
+static void *bounded_malloc(const memcached_st *, const size_t size, void *)
+{
+  return size > COMPRESSION_ALLOCATION_LIMIT ? NULL : malloc(size);
+}
+
+static void *bounded_realloc(const memcached_st *, void *mem, const size_t size, void *)
+{
+  return size > COMPRESSION_ALLOCATION_LIMIT ? NULL : realloc(mem, size);
+}
+
+static void *bounded_calloc(const memcached_st *, size_t nelem, const size_t size, void *)
+{
+  return nelem * size > COMPRESSION_ALLOCATION_LIMIT ? NULL : calloc(nelem, size);
+}
+
+static void bounded_free(const memcached_st *, void *mem, void *)
+{
+  free(mem);
+}
+
+test_return_t compression_corrupt_TEST(memcached_st *original)
+{
+  memcached_st *memc= memcached_clone(NULL, original);
+  test_true(memc);
+  // A header claiming more than the payload could decode to must fail before anything is allocated for it
+  test_compare(MEMCACHED_SUCCESS,
+               memcached_set_memory_allocators(memc, bounded_malloc, bounded_free,
+                                               bounded_realloc, bounded_calloc, NULL));
+  test_compare(MEMCACHED_SUCCESS, memcached_behavior_set(memc, MEMCACHED_BEHAVIOR_COMPRESSION, MEMCACHED_COMPRESSION_FAST));
+
+  std::string value= compressible_value(16 * 1024);
+  test_compare(MEMCACHED_SUCCESS,
+               memcached_set(memc, test_literal_param("compression_corrupt"), value.c_str(), value.size(), 0, 0));
+
+  memcached_st *plain= memcached_clone(NULL, original);
+  test_true(plain);
+  memcached_return_t rc;
+  size_t raw_length;
+  uint32_t raw_flags;
+  char *raw= memcached_get(plain, test_literal_param("compression_corrupt"), &raw_length, &raw_flags, &rc);
+  test_compare(MEMCACHED_SUCCESS, rc);
+
+  // Cut short, claiming to be longer than it is, and claiming more than any payload could hold
+  const char *bad[]= { raw, "\x01\xff\xff\x00\x00\x10""abcd", "\x7f", "\x02\xff\xff\xff\xff""abcd" };
+  const size_t bad_length[]= { raw_length / 2, 10, 1, 9 };
+  for (size_t x= 0; x < 4; x++)
+  {
+    test_compare(MEMCACHED_SUCCESS,
+                 memcached_set(plain, test_literal_param("compression_corrupt"), bad[x], bad_length[x], 0, raw_flags));
+
+    size_t value_length;
+    test_null(memcached_get(memc, test_literal_param("compression_corrupt"), &value_length, NULL, &rc));
+    test_compare(MEMCACHED_FAILURE, rc);
+  }
+
+  memcached_compression_stat_st stat;
+  test_compare(MEMCACHED_SUCCESS, memcached_compression_stat(memc, &stat));
+  test_compare(uint64_t(4), stat.failures);
+
+  test_compare(MEMCACHED_SUCCESS,
+               memcached_set(memc, test_literal_param("compression_corrupt"), value.c_str(), value.size(), 0, 0));
+  test_compare(TEST_SUCCESS, compression_round_trip(memc, "compression_corrupt", value, 0));
+
+  free(raw);
+  memcached_free(plain);
+  memcached_free(memc);
+
+  return TEST_SUCCESS;
+}
+
+test_return_t compression_encrypted_TEST(memcached_st *original)
+{
+  std::string value= compressible_value(32 * 1024);
+  for (memcached_encryption_t mode= MEMCACHED_ENCRYPTION_AES_ECB;
+       mode < MEMCACHED_ENCRYPTION_MAX;
+       mode= memcached_encryption_t(mode +1))
+  {
+    memcached_st *memc= memcached_clone(NULL, original);
+    test_true(memc);
+    test_compare(MEMCACHED_SUCCESS, memcached_set_encoding_key(memc, test_literal_param(__func__)));
+    test_compare(MEMCACHED_SUCCESS, memcached_behavior_set(memc, MEMCACHED_BEHAVIOR_ENCRYPTION, mode));
+    test_compare(MEMCACHED_SUCCESS, memcached_behavior_set(memc, MEMCACHED_BEHAVIOR_COMPRESSION, MEMCACHED_COMPRESSION_FAST));
+
+    test_compare_hint(MEMCACHED_SUCCESS,
+                      memcached_set(memc, test_literal_param("compression_encrypted"), value.c_str(), value.size(), 0, 3),
+                      memcached_last_error_message(memc));
+    test_compare(TEST_SUCCESS, compression_round_trip(memc, "compression_encrypted", value, 3));
+
+    // Encrypted data does not compress, so it has to be compressed first
+    size_t raw_length;
+    uint32_t raw_flags;
+    test_compare(TEST_SUCCESS, compression_raw(memc, "compression_encrypted", raw_length, raw_flags));
+    test_true(raw_length < value.size() / 4);
+
+    memcached_free(memc);
+  }
+
+  return TEST_SUCCESS;
+}
+
+test_return_t compression_binary_TEST(memcached_st *original)
+{
+  memcached_st *memc= memcached_clone(NULL, original);
+  test_true(memc);
+  test_compare(MEMCACHED_SUCCESS, memcached_behavior_set(memc, MEMCACHED_BEHAVIOR_BINARY_PROTOCOL, true));
+  test_compare(MEMCACHED_SUCCESS, memcached_behavior_set(memc, MEMCACHED_BEHAVIOR_COMPRESSION, MEMCACHED_COMPRESSION_FAST));
+
+  const char *keys[]= { "compression_binary_0", "compression_binary_1", "compression_binary_2" };
+  size_t key_length[]= { strlen(keys[0]), strlen(keys[1]), strlen(keys[2]) };
+  std::string values[3];
+  for (size_t x= 0; x < 3; x++)
+  {
+    // The middle value stays below the threshold
+    values[x]= compressible_value(x == 1 ? 100 : 10000 * (x +1));
+    test_compare(MEMCACHED_SUCCESS,
+                 memcached_set(memc, keys[x], key_length[x], values[x].c_str(), values[x].size(), 0, uint32_t(x)));
+  }
+
+  test_compare(MEMCACHED_SUCCESS, memcached_mget(memc, keys, key_length, 3));
+
+  memcached_result_st results;
+  test_true(memcached_result_create(memc, &results));
+  memcached_result_st *result;
+  memcached_return_t rc;
+  size_t found= 0;
+  while ((result= memcached_fetch_result(memc, &results, &rc)))
+  {
+    size_t x= size_t(memcached_result_key_value(result)[memcached_result_key_length(result) -1] - '0');
+    test_true(x < 3);
+    test_compare(values[x].size(), memcached_result_length(result));
+    test_memcmp(values[x].c_str(), memcached_result_value(result), values[x].size());
+    test_compare(uint32_t(x), memcached_result_flags(result));
+    found++;
+  }
+  test_compare(MEMCACHED_END, rc);
+  test_compare(size_t(3), found);
+  memcached_result_free(&results);
+
+  memcached_compression_stat_st stat;
+  test_compare(MEMCACHED_SUCCESS, memcached_compression_stat(memc, &stat));
+  test_compare(uint64_t(2), stat.compressed);
+  test_compare(uint64_t(2), stat.decompressed);
+
+  memcached_free(memc);
+
+  return TEST_SUCCESS;
+}
+
+struct compression_mget_execute_st
+{
+  const std::string *values;
+  uint32_t number_of_values;
+  size_t fetched;
+  size_t mismatched;
+};
+
+static memcached_return_t compression_mget_execute_callback(const memcached_st *, memcached_result_st *result, void *context)
+{
+  compression_mget_execute_st *counts= static_cast<compression_mget_execute_st *>(context);
+
+  // A value that wasn't decompressed still carries MEMCACHED_FLAG_COMPRESSED
+  uint32_t x= memcached_result_flags(result);
+  if (x >= counts->number_of_values or
+      memcached_result_length(result) != counts->values[x].size() or
+      memcmp(memcached_result_value(result), counts->values[x].c_str(), counts->values[x].size()))
+  {
+    counts->mismatched++;
+  }
+  counts->fetched++;
+
+  return MEMCACHED_SUCCESS;
+}
+
+/*
+  The keys are asked for over and over with small socket buffers, so
+  mget_execute has to run the callbacks while it is still sending.
+*/
+test_return_t compression_mget_execute_TEST(memcached_st *original)
+{
+  memcached_st *memc= memcached_clone(NULL, original);
+  test_true(memc);
+  test_compare(MEMCACHED_SUCCESS, memcached_behavior_set(memc, MEMCACHED_BEHAVIOR_BINARY_PROTOCOL, true));
+  test_compare(MEMCACHED_SUCCESS, memcached_behavior_set(memc, MEMCACHED_BEHAVIOR_SOCKET_SEND_SIZE, 4096));
+  test_compare(MEMCACHED_SUCCESS, memcached_behavior_set(memc, MEMCACHED_BEHAVIOR_SOCKET_RECV_SIZE, 4096));
+  test_compare(MEMCACHED_SUCCESS, memcached_behavior_set(memc, MEMCACHED_BEHAVIOR_COMPRESSION, MEMCACHED_COMPRESSION_FAST));
+
+  std::string keys[10];
+  std::string values[10];
+  for (uint32_t x= 0; x < 10; x++)
+  {
+    keys[x]= std::string(200, 'k') +char('0' +x);
+    values[x]= compressible_value(2048 +x);
+    test_compare(MEMCACHED_SUCCESS,
+                 memcached_set(memc, keys[x].c_str(), keys[x].size(), values[x].c_str(), values[x].size(), 0, x));
+  }
+
+  std::vector<const char *> key_ptrs;
+  std::vector<size_t> key_lengths;
+  for (size_t x= 0; x < 20000; x++)
+  {
+    key_ptrs.push_back(keys[x % 10].c_str());
+    key_lengths.push_back(keys[x % 10].size());
+  }
+
+  compression_mget_execute_st counts= { values, 10, 0, 0 };
+  memcached_execute_fn callbacks[]= { compression_mget_execute_callback };
+  test_compare(MEMCACHED_SUCCESS,
+               memcached_mget_execute(memc, &key_ptrs[0], &key_lengths[0], key_ptrs.size(), callbacks, &counts, 1));
+  // Otherwise only memcached_fetch_execute() would be covered
+  test_true(counts.fetched);
+  test_compare(MEMCACHED_SUCCESS, memcached_fetch_execute(memc, callbacks, &counts, 1));
+
+  test_zero(counts.mismatched);
+  test_compare(key_ptrs.size(), counts.fetched);
+
+  memcached_free(memc);
+
+  return TEST_SUCCESS;
+}
+
+test_return_t compression_append_TEST(memcached_st *original)
+{
+  memcached_st *memc= memcached_clone(NULL, original);
+  test_true(memc);
+  test_compare(MEMCACHED_SUCCESS, memcached_behavior_set(memc, MEMCACHED_BEHAVIOR_COMPRESSION, MEMCACHED_COMPRESSION_FAST));
+
+  std::string head(1024, 'a');
+  test_compare(MEMCACHED_SUCCESS,
+               memcached_set(memc, test_literal_param("compression_append"), head.c_str(), head.size(), 0, 0));
+
+  // The stored value is compressed, raw data added to either end would corrupt it
+  test_compare(MEMCACHED_NOT_SUPPORTED,
+               memcached_append(memc, test_literal_param("compression_append"), test_literal_param("tail"), 0, 0));
+  test_compare(MEMCACHED_NOT_SUPPORTED,
+               memcached_prepend(memc, test_literal_param("compression_append"), test_literal_param("tail"), 0, 0));
+  test_compare(TEST_SUCCESS, compression_round_trip(memc, "compression_append", head, 0));
+
+  memcached_compression_stat_st stat;
+  test_compare(MEMCACHED_SUCCESS, memcached_compression_stat(memc, &stat));
+  test_compare(uint64_t(1), stat.compressed);
+
+  memcached_free(memc);
+
+  return TEST_SUCCESS;
+}
+
+test_return_t compression_clone_TEST(memcached_st *original)
+{
+  memcached_st *memc= memcached_clone(NULL, original);
+  test_true(memc);
+  test_compare(MEMCACHED_SUCCESS, memcached_behavior_set(memc, MEMCACHED_BEHAVIOR_COMPRESSION, MEMCACHED_COMPRESSION_FAST));
+  test_compare(MEMCACHED_SUCCESS, memcached_behavior_set(memc, MEMCACHED_BEHAVIOR_COMPRESSION_THRESHOLD, 100));
+  std::string dictionary= compressible_value(1000);
+  test_compare(MEMCACHED_SUCCESS, memcached_set_compression_dictionary(memc, dictionary.c_str(), dictionary.size()));
+
+  std::string value= compressible_value(200);
+  test_compare(MEMCACHED_SUCCESS,
+               memcached_set(memc, test_literal_param("compression_clone"), value.c_str(), value.size(), 0, 0));
+
+  memcached_st *clone= memcached_clone(NULL, memc);
+  test_true(clone);
+  test_compare(uint64_t(MEMCACHED_COMPRESSION_FAST), memcached_behavior_get(clone, MEMCACHED_BEHAVIOR_COMPRESSION));
+  test_compare(uint64_t(100), memcached_behavior_get(clone, MEMCACHED_BEHAVIOR_COMPRESSION_THRESHOLD));
+  test_compare(TEST_SUCCESS, compression_round_trip(clone, "compression_clone", value, 0));
+
+  // The statistics are not
+  memcached_compression_stat_st stat;
+  test_compare(MEMCACHED_SUCCESS, memcached_compression_stat(clone, &stat));
+  test_zero(stat.compressed);
+  test_compare(uint64_t(1), stat.decompressed);
+
+  memcached_free(clone);
+  memcached_free(memc);
+
+  return TEST_SUCCESS;
+}
@@ -43,6 +43,9 @@
 
 #include "tests/libmemcached-1.0/encoding_key.h"
 
+#include <string>
+#include <vector>
+
 using namespace libtest;
 
 test_return_t memcached_set_encoding_key_TEST(memcached_st* memc)
@@ -378,3 +381,291 @@ test_return_t memcached_set_encoding_key_set_grow_key_TEST(memcached_st* memc)
 
   return TEST_SUCCESS;
 }
+
+test_return_t memcached_set_encoding_key_gcm_behavior_TEST(memcached_st* memc)
+{
+  test_compare(uint64_t(MEMCACHED_ENCRYPTION_AES_ECB), memcached_behavior_get(memc, MEMCACHED_BEHAVIOR_ENCRYPTION));
+  test_compare(uint64_t(MEMCACHED_DEFAULT_ENCRYPTION_THREAD_THRESHOLD),
+               memcached_behavior_get(memc, MEMCACHED_BEHAVIOR_ENCRYPTION_THREAD_THRESHOLD));
+
+  test_compare(MEMCACHED_INVALID_ARGUMENTS,
+               memcached_behavior_set(memc, MEMCACHED_BEHAVIOR_ENCRYPTION, MEMCACHED_ENCRYPTION_MAX));
+  test_compare(MEMCACHED_SUCCESS,
+               memcached_behavior_set(memc, MEMCACHED_BEHAVIOR_ENCRYPTION, MEMCACHED_ENCRYPTION_AES_GCM_ONLY));
+  test_compare(MEMCACHED_SUCCESS,
+               memcached_behavior_set(memc, MEMCACHED_BEHAVIOR_ENCRYPTION_THREAD_THRESHOLD, 4096));
+
+  memcached_st *clone= memcached_clone(NULL, memc);
+  test_true(clone);
+  test_compare(uint64_t(MEMCACHED_ENCRYPTION_AES_GCM_ONLY), memcached_behavior_get(clone, MEMCACHED_BEHAVIOR_ENCRYPTION));
+  test_compare(uint64_t(4096), memcached_behavior_get(clone, MEMCACHED_BEHAVIOR_ENCRYPTION_THREAD_THRESHOLD));
+  memcached_free(clone);
+
+  test_compare(MEMCACHED_SUCCESS,
+               memcached_behavior_set(memc, MEMCACHED_BEHAVIOR_ENCRYPTION, MEMCACHED_ENCRYPTION_AES_ECB));
+  test_compare(MEMCACHED_SUCCESS,
+               memcached_behavior_set(memc, MEMCACHED_BEHAVIOR_ENCRYPTION_THREAD_THRESHOLD, MEMCACHED_DEFAULT_ENCRYPTION_THREAD_THRESHOLD));
+
+  return TEST_SUCCESS;
+}
+
+static test_return_t gcm_set_get(memcached_st* memc, const char *key, size_t key_length)
+{
+  memcached_st *memc_no_crypt= memcached_clone(NULL, memc);
+  test_true(memc_no_crypt);
+  test_compare(MEMCACHED_SUCCESS, memcached_set_encoding_key(memc, key, key_length));
+  test_compare(MEMCACHED_SUCCESS,
+               memcached_behavior_set(memc, MEMCACHED_BEHAVIOR_ENCRYPTION, MEMCACHED_ENCRYPTION_AES_GCM));
+
+  test_compare(MEMCACHED_INVALID_ARGUMENTS,
+               memcached_set(memc, key, key_length, key, key_length, time_t(0), MEMCACHED_FLAG_AES_GCM));
+
+  test_compare_hint(MEMCACHED_SUCCESS,
+                    memcached_set(memc, key, key_length, key, key_length, time_t(0), uint32_t(1234)),
+                    memcached_last_error_message(memc));
+
+  memcached_return_t rc;
+  size_t value_length;
+  uint32_t flags;
+  char *value;
+  test_true((value= memcached_get(memc, key, key_length, &value_length, &flags, &rc)));
+  test_compare(MEMCACHED_SUCCESS, rc);
+  test_compare(uint32_t(1234), flags);
+  test_compare(key_length, value_length);
+  test_memcmp(key, value, value_length);
+  free(value);
+
+  // The envelope carries a nonce and a tag, the flag bit says what it is
+  test_true((value= memcached_get(memc_no_crypt, key, key_length, &value_length, &flags, &rc)));
+  test_compare(MEMCACHED_SUCCESS, rc);
+  test_compare(uint32_t(1234) | MEMCACHED_FLAG_AES_GCM, flags);
+  test_compare(key_length +1 +12 +16, value_length);
+  test_ne_compare(0, memcmp(key, value, key_length));
+  free(value);
+
+  memcached_free(memc_no_crypt);
+
+  return TEST_SUCCESS;
+}
+
+test_return_t memcached_set_encoding_key_gcm_set_get_TEST(memcached_st* memc)
+{
+  return gcm_set_get(memc, test_literal_param(__func__));
+}
+
+test_return_t memcached_set_encoding_key_gcm_binary_set_get_TEST(memcached_st* memc)
+{
+  test_compare(MEMCACHED_SUCCESS, memcached_behavior_set(memc, MEMCACHED_BEHAVIOR_BINARY_PROTOCOL, true));
+
+  return gcm_set_get(memc, test_literal_param(__func__));
+}
+
+test_return_t memcached_set_encoding_key_gcm_migration_TEST(memcached_st* memc)
+{
+  test_compare(MEMCACHED_SUCCESS, memcached_set_encoding_key(memc, test_literal_param(__func__)));
+  test_compare(MEMCACHED_SUCCESS,
+               memcached_set(memc, test_literal_param("ecb"), test_literal_param(__func__), time_t(0), uint32_t(0)));
+
+  memcached_st *memc_gcm= memcached_clone(NULL, memc);
+  test_true(memc_gcm);
+  test_compare(MEMCACHED_SUCCESS,
+               memcached_behavior_set(memc_gcm, MEMCACHED_BEHAVIOR_ENCRYPTION, MEMCACHED_ENCRYPTION_AES_GCM));
+  test_compare(MEMCACHED_SUCCESS,
+               memcached_set(memc_gcm, test_literal_param("gcm"), test_literal_param(__func__), time_t(0), uint32_t(0)));
+
+  // Either client reads either format while values are being migrated
+  memcached_st *clients[]= { memc, memc_gcm };
+  const char *keys[]= { "ecb", "gcm" };
+  for (size_t x= 0; x < 2; x++)
+  {
+    for (size_t y= 0; y < 2; y++)
+    {
+      memcached_return_t rc;
+      size_t value_length;
+      char *value= memcached_get(clients[x], keys[y], strlen(keys[y]), &value_length, NULL, &rc);
+      test_compare(MEMCACHED_SUCCESS, rc);
+      test_compare(test_literal_param_size(__func__), value_length);
+      test_memcmp(__func__, value, value_length);
+      free(value);
+    }
+  }
+
+  // Once migrated, anything left in the old format is refused
+  test_compare(MEMCACHED_SUCCESS,
+               memcached_behavior_set(memc_gcm, MEMCACHED_BEHAVIOR_ENCRYPTION, MEMCACHED_ENCRYPTION_AES_GCM_ONLY));
+  {
+    memcached_return_t rc;
+    size_t value_length;
+    test_null(memcached_get(memc_gcm, test_literal_param("ecb"), &value_length, NULL, &rc));
+    test_compare(MEMCACHED_FAILURE, rc);
+
+    char *value= memcached_get(memc_gcm, test_literal_param("gcm"), &value_length, NULL, &rc);
+    test_compare(MEMCACHED_SUCCESS, rc);
+    test_memcmp(__func__, value, value_length);
+    free(value);
+  }
+
+  memcached_free(memc_gcm);
+
+  return TEST_SUCCESS;
+}
+
+test_return_t memcached_set_encoding_key_gcm_tamper_TEST(memcached_st* memc)
+{
+  memcached_st *memc_no_crypt= memcached_clone(NULL, memc);
+  test_true(memc_no_crypt);
+  test_compare(MEMCACHED_SUCCESS, memcached_set_encoding_key(memc, test_literal_param(__func__)));
+  test_compare(MEMCACHED_SUCCESS,
+               memcached_behavior_set(memc, MEMCACHED_BEHAVIOR_ENCRYPTION, MEMCACHED_ENCRYPTION_AES_GCM));
+  test_compare(MEMCACHED_SUCCESS,
+               memcached_set(memc, test_literal_param("original"), test_literal_param(__func__), time_t(0), uint32_t(0)));
+
+  memcached_return_t rc;
+  size_t raw_length;
+  uint32_t raw_flags;
+  char *raw= memcached_get(memc_no_crypt, test_literal_param("original"), &raw_length, &raw_flags, &rc);
+  test_compare(MEMCACHED_SUCCESS, rc);
+
+  // An envelope copied to another key does not decrypt
+  test_compare(MEMCACHED_SUCCESS,
+               memcached_set(memc_no_crypt, test_literal_param("copied"), raw, raw_length, time_t(0), raw_flags));
+  size_t value_length;
+  test_null(memcached_get(memc, test_literal_param("copied"), &value_length, NULL, &rc));
+  test_compare(MEMCACHED_FAILURE, rc);
+
+  // Nor does one with a single bit changed
+  raw[0]^= 1;
+  test_compare(MEMCACHED_SUCCESS,
+               memcached_set(memc_no_crypt, test_literal_param("original"), raw, raw_length, time_t(0), raw_flags));
+  test_null(memcached_get(memc, test_literal_param("original"), &value_length, NULL, &rc));
+  test_compare(MEMCACHED_FAILURE, rc);
+
+  // Neither failure costs the connection
+  test_compare(MEMCACHED_SUCCESS,
+               memcached_set(memc, test_literal_param("original"), test_literal_param(__func__), time_t(0), uint32_t(0)));
+  char *value= memcached_get(memc, test_literal_param("original"), &value_length, NULL, &rc);
+  test_compare(MEMCACHED_SUCCESS, rc);
+  test_memcmp(__func__, value, value_length);
+  free(value);
+
+  free(raw);
+  memcached_free(memc_no_crypt);
+
+  return TEST_SUCCESS;
+}
+
+test_return_t memcached_set_encoding_key_gcm_threaded_TEST(memcached_st* memc)
+{
+  test_compare(MEMCACHED_SUCCESS, memcached_set_encoding_key(memc, test_literal_param(__func__)));
+  test_compare(MEMCACHED_SUCCESS,
+               memcached_behavior_set(memc, MEMCACHED_BEHAVIOR_ENCRYPTION, MEMCACHED_ENCRYPTION_AES_GCM));
+  test_compare(MEMCACHED_SUCCESS,
+               memcached_behavior_set(memc, MEMCACHED_BEHAVIOR_ENCRYPTION_THREAD_THRESHOLD, 16 * 1024));
+
+  libtest::vchar_t payload;
+  for (size_t x= 0; x < 500000; x++)
+  {
+    payload.push_back(rand());
+  }
+
+  memcached_return_t rc= memcached_set(memc, test_literal_param(__func__), &payload[0], payload.size(), time_t(0), uint32_t(0));
+  if (rc == MEMCACHED_SERVER_MEMORY_ALLOCATION_FAILURE)
+  {
+    return TEST_SKIPPED;
+  }
+  test_compare_hint(MEMCACHED_SUCCESS, rc, memcached_last_error_message(memc));
+
+  size_t value_length;
+  char *value= memcached_get(memc, test_literal_param(__func__), &value_length, NULL, &rc);
+  test_compare(MEMCACHED_SUCCESS, rc);
+  test_compare(payload.size(), value_length);
+  test_memcmp(&payload[0], value, value_length);
+  free(value);
+
+  return TEST_SUCCESS;
+}
+
+#define MGET_EXECUTE_KEYS 100
+#define MGET_EXECUTE_POSITIONS 20000
+#define MGET_EXECUTE_VALUE_LENGTH 1024
+
+struct mget_execute_context_st {
+  size_t fetched;
+  size_t mismatched;
+};
+
+static memcached_return_t mget_execute_callback(const memcached_st *, memcached_result_st *result, void *context)
+{
+  mget_execute_context_st *counts= static_cast<mget_execute_context_st *>(context);
+  uint32_t x= memcached_result_flags(result);
+  std::string expected(MGET_EXECUTE_VALUE_LENGTH, char('a' +x % 26));
+  if (memcached_result_length(result) != expected.size() or
+      memcmp(memcached_result_value(result), expected.c_str(), expected.size()))
+  {
+    counts->mismatched++;
+  }
+  counts->fetched++;
+
+  return MEMCACHED_SUCCESS;
+}
+
+/*
+  The keys are long and asked for over and over, and the caller shrinks the
+  socket buffers, so that the request doesn't fit in them. mget_execute then
+  has to take responses off the socket while it is still sending, which runs
+  the callbacks from inside the write path.
+*/
+static test_return_t mget_execute_decrypts(memcached_st *memc, size_t& during_mget)
+{
+  std::vector<std::string> keys;
+  for (uint32_t x= 0; x < MGET_EXECUTE_KEYS; x++)
+  {
+    char key[MEMCACHED_MAX_KEY];
+    keys.push_back(std::string(200, 'k') +std::string(key, size_t(snprintf(key, sizeof(key), "_%u", x))));
+    std::string value(MGET_EXECUTE_VALUE_LENGTH, char('a' +x % 26));
+    test_compare_hint(MEMCACHED_SUCCESS,
+                      memcached_set(memc, keys[x].c_str(), keys[x].size(), value.c_str(), value.size(), time_t(0), x),
+                      memcached_last_error_message(memc));
+  }
+
+  std::vector<const char *> key_ptrs;
+  std::vector<size_t> key_lengths;
+  for (size_t x= 0; x < MGET_EXECUTE_POSITIONS; x++)
+  {
+    key_ptrs.push_back(keys[x % keys.size()].c_str());
+    key_lengths.push_back(keys[x % keys.size()].size());
+  }
+
+  mget_execute_context_st counts= { 0, 0 };
+  memcached_execute_fn callbacks[]= { mget_execute_callback };
+  test_compare(MEMCACHED_SUCCESS,
+               memcached_mget_execute(memc, &key_ptrs[0], &key_lengths[0], key_ptrs.size(), callbacks, &counts, 1));
+  during_mget= counts.fetched;
+  test_compare(MEMCACHED_SUCCESS, memcached_fetch_execute(memc, callbacks, &counts, 1));
+
+  test_zero(counts.mismatched);
+  test_compare(size_t(MGET_EXECUTE_POSITIONS), counts.fetched);
+
+  return TEST_SUCCESS;
+}
+
+test_return_t memcached_set_encoding_key_mget_execute_TEST(memcached_st* memc)
+{
+  test_compare(MEMCACHED_SUCCESS, memcached_behavior_set(memc, MEMCACHED_BEHAVIOR_BINARY_PROTOCOL, true));
+  test_compare(MEMCACHED_SUCCESS, memcached_behavior_set(memc, MEMCACHED_BEHAVIOR_SOCKET_SEND_SIZE, 4096));
+  test_compare(MEMCACHED_SUCCESS, memcached_behavior_set(memc, MEMCACHED_BEHAVIOR_SOCKET_RECV_SIZE, 4096));
+  test_compare(MEMCACHED_SUCCESS, memcached_set_encoding_key(memc, test_literal_param(__func__)));
+
+  size_t ecb_during_mget, gcm_during_mget;
+  test_compare(TEST_SUCCESS, mget_execute_decrypts(memc, ecb_during_mget));
+
+  test_compare(MEMCACHED_SUCCESS,
+               memcached_behavior_set(memc, MEMCACHED_BEHAVIOR_ENCRYPTION, MEMCACHED_ENCRYPTION_AES_GCM));
+  test_compare(TEST_SUCCESS, mget_execute_decrypts(memc, gcm_during_mget));
+
+  // Otherwise only memcached_fetch_execute() was covered
+  test_true(ecb_during_mget);
+  test_true(gcm_during_mget);
+
+  return TEST_SUCCESS;
+}
@@ -49,3 +49,10 @@ test_return_t memcached_set_encoding_key_prepend_TEST(memcached_st*);
 test_return_t memcached_set_encoding_key_append_TEST(memcached_st*);
 test_return_t memcached_set_encoding_key_set_get_clone_TEST(memcached_st*);
 test_return_t memcached_set_encoding_key_set_grow_key_TEST(memcached_st*);
+test_return_t memcached_set_encoding_key_gcm_behavior_TEST(memcached_st*);
+test_return_t memcached_set_encoding_key_gcm_set_get_TEST(memcached_st*);
+test_return_t memcached_set_encoding_key_gcm_binary_set_get_TEST(memcached_st*);
+test_return_t memcached_set_encoding_key_gcm_migration_TEST(memcached_st*);
+test_return_t memcached_set_encoding_key_gcm_tamper_TEST(memcached_st*);
+test_return_t memcached_set_encoding_key_gcm_threaded_TEST(memcached_st*);
+test_return_t memcached_set_encoding_key_mget_execute_TEST(memcached_st*);
@@ -40,6 +40,8 @@
 using namespace libtest;
 
 #include "tests/string.h"
+#include "tests/near_cache_internals.h"
+#include "tests/meta_internals.h"
 
 /*
   Test cases
@@ -55,9 +57,29 @@ test_st string_tests[] ={
   {0, 0, 0}
 };
 
+test_st near_cache_tests[] ={
+  {"fill after invalidate", false, near_cache_fill_after_invalidate_test },
+  {"fill after flush", false, near_cache_fill_after_flush_test },
+  {"expiration caps the fill", false, near_cache_expiration_cap_test },
+  {"master key", false, near_cache_group_key_test },
+  {"main space budget", false, near_cache_main_budget_test },
+  {0, 0, 0}
+};
+
+test_st meta_tests[] ={
+  {"base64 keys", false, meta_key_base64_test },
+  {"ms +mg", false, meta_set_get_test },
+  {"base64 key +namespace", false, meta_base64_key_test },
+  {"cas", false, meta_cas_test },
+  {"md +ma +touch +exist", false, meta_delete_arithmetic_test },
+  {"noreply", false, meta_noreply_test },
+  {0, 0, 0}
+};
 
 collection_st collection[] ={
   {"string", 0, 0, string_tests},
+  {"near_cache", 0, 0, near_cache_tests},
+  {"meta", 0, 0, meta_tests},
   {0, 0, 0, 0}
 };
 
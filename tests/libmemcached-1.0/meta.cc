@@ -0,0 +1,312 @@
+/*  vim:expandtab:shiftwidth=2:tabstop=2:smarttab:
+ * 
+ *  Libmemcached library
+ *
+ *  Copyright (C) 2011-2012 Data Differential, http://datadifferential.com/
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are
+ *  met:
+ *
+ *      * Redistributions of source code must retain the above copyright
+ *  notice, this list of conditions and the following disclaimer.
+ *
+ *      * Redistributions in binary form must reproduce the above
+ *  copyright notice, this list of conditions and the following disclaimer
+ *  in the documentation and/or other materials provided with the
+ *  distribution.
+ *
+ *      * The names of its contributors may not be used to endorse or
+ *  promote products derived from this software without specific prior
+ *  written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *  A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *  OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *  SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *  LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *  DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *  THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *  OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include <config.h>
+#include <libtest/test.hpp>
+
+using namespace libtest;
+
+#include <libmemcached-1.0/memcached.h>
+#include <libmemcached/util.h>
+
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+#include "tests/libmemcached-1.0/meta.h"
+#include "tests/libmemcached-1.0/setup_and_teardowns.h"
+
+test_return_t meta_behavior_TEST(memcached_st *original)
+{
+  memcached_st *memc= memcached_clone(NULL, original);
+  test_true(memc);
+
+  test_false(memcached_behavior_get(memc, MEMCACHED_BEHAVIOR_META_PROTOCOL));
+  test_compare(MEMCACHED_SUCCESS, memcached_behavior_set(memc, MEMCACHED_BEHAVIOR_BINARY_PROTOCOL, true));
+  test_compare(MEMCACHED_SUCCESS, memcached_behavior_set(memc, MEMCACHED_BEHAVIOR_META_PROTOCOL, true));
+  test_true(memcached_behavior_get(memc, MEMCACHED_BEHAVIOR_META_PROTOCOL));
+  test_false(memcached_behavior_get(memc, MEMCACHED_BEHAVIOR_BINARY_PROTOCOL));
+
+  // Keys are base64 encoded when they need to be, so there is nothing left to verify
+  test_false(memcached_behavior_get(memc, MEMCACHED_BEHAVIOR_VERIFY_KEY));
+  test_compare(MEMCACHED_INVALID_ARGUMENTS, memcached_behavior_set(memc, MEMCACHED_BEHAVIOR_VERIFY_KEY, true));
+
+  memcached_st *clone= memcached_clone(NULL, memc);
+  test_true(clone);
+  test_true(memcached_behavior_get(clone, MEMCACHED_BEHAVIOR_META_PROTOCOL));
+  memcached_free(clone);
+
+  test_compare(MEMCACHED_SUCCESS, memcached_behavior_set(memc, MEMCACHED_BEHAVIOR_BINARY_PROTOCOL, true));
+  test_false(memcached_behavior_get(memc, MEMCACHED_BEHAVIOR_META_PROTOCOL));
+
+  memcached_free(memc);
+
+  return TEST_SUCCESS;
+}
+
+test_return_t meta_udp_TEST(memcached_st *original)
+{
+  memcached_st *memc= memcached_clone(NULL, original);
+  test_true(memc);
+
+  test_compare(MEMCACHED_SUCCESS, memcached_behavior_set(memc, MEMCACHED_BEHAVIOR_META_PROTOCOL, true));
+  test_compare(MEMCACHED_INVALID_ARGUMENTS, memcached_behavior_set(memc, MEMCACHED_BEHAVIOR_USE_UDP, true));
+  test_false(memcached_behavior_get(memc, MEMCACHED_BEHAVIOR_USE_UDP));
+
+  test_compare(MEMCACHED_SUCCESS, memcached_behavior_set(memc, MEMCACHED_BEHAVIOR_META_PROTOCOL, false));
+  test_compare(MEMCACHED_SUCCESS, memcached_behavior_set(memc, MEMCACHED_BEHAVIOR_USE_UDP, true));
+  test_compare(MEMCACHED_INVALID_ARGUMENTS, memcached_behavior_set(memc, MEMCACHED_BEHAVIOR_META_PROTOCOL, true));
+  test_false(memcached_behavior_get(memc, MEMCACHED_BEHAVIOR_META_PROTOCOL));
+
+  memcached_free(memc);
+
+  return TEST_SUCCESS;
+}
+
+// Rejected before anything is sent, so no server is needed
+test_return_t meta_key_length_TEST(memcached_st *original)
+{
+  memcached_st *memc= memcached_clone(NULL, original);
+  test_true(memc);
+  test_compare(MEMCACHED_SUCCESS, memcached_behavior_set(memc, MEMCACHED_BEHAVIOR_META_PROTOCOL, true));
+
+  // Three bytes become four once encoded, so this no longer fits in a key
+  std::string key(200, ' ');
+  test_compare(MEMCACHED_BAD_KEY_PROVIDED,
+               memcached_set(memc, key.c_str(), key.size(), test_literal_param("value"), 0, 0));
+
+  memcached_free(memc);
+
+  return TEST_SUCCESS;
+}
+
+test_return_t meta_set_get_TEST(memcached_st *original)
+{
+  memcached_st *memc= memcached_clone(NULL, original);
+  test_true(memc);
+  test_skip(TEST_SUCCESS, pre_meta(memc));
+
+  test_compare(MEMCACHED_SUCCESS,
+               memcached_set(memc, test_literal_param(__func__), test_literal_param("meta"), time_t(0), uint32_t(17)));
+  test_compare(MEMCACHED_SUCCESS, memcached_append(memc, test_literal_param(__func__), test_literal_param("-end"), 0, 0));
+  test_compare(MEMCACHED_SUCCESS, memcached_prepend(memc, test_literal_param(__func__), test_literal_param("start-"), 0, 0));
+
+  memcached_return_t rc;
+  size_t value_length;
+  uint32_t flags;
+  char *value= memcached_get(memc, test_literal_param(__func__), &value_length, &flags, &rc);
+  test_compare(MEMCACHED_SUCCESS, rc);
+  test_compare(test_literal_param_size("start-meta-end"), value_length);
+  test_memcmp("start-meta-end", value, value_length);
+  test_compare(uint32_t(17), flags);
+  free(value);
+
+  test_compare(MEMCACHED_NOTSTORED, memcached_add(memc, test_literal_param(__func__), test_literal_param("add"), 0, 0));
+  test_compare(MEMCACHED_SUCCESS, memcached_exist(memc, test_literal_param(__func__)));
+  test_compare(MEMCACHED_SUCCESS, memcached_touch(memc, test_literal_param(__func__), 60));
+  test_compare(MEMCACHED_SUCCESS, memcached_delete(memc, test_literal_param(__func__), 0));
+  test_compare(MEMCACHED_NOTFOUND, memcached_exist(memc, test_literal_param(__func__)));
+  test_compare(MEMCACHED_NOTFOUND, memcached_delete(memc, test_literal_param(__func__), 0));
+  test_compare(MEMCACHED_NOTSTORED, memcached_replace(memc, test_literal_param(__func__), test_literal_param("replace"), 0, 0));
+
+  value= memcached_get(memc, test_literal_param(__func__), &value_length, &flags, &rc);
+  test_compare(MEMCACHED_NOTFOUND, rc);
+  test_null(value);
+
+  memcached_free(memc);
+
+  return TEST_SUCCESS;
+}
+
+test_return_t meta_binary_key_TEST(memcached_st *original)
+{
+  memcached_st *memc= memcached_clone(NULL, original);
+  test_true(memc);
+  test_skip(TEST_SUCCESS, pre_meta(memc));
+  test_compare(MEMCACHED_SUCCESS, memcached_callback_set(memc, MEMCACHED_CALLBACK_NAMESPACE, (void *)"meta:"));
+
+  const char key[]= "key with\r\nspaces";
+  test_compare(MEMCACHED_SUCCESS,
+               memcached_set(memc, test_literal_param(key), test_literal_param("binary"), 0, 0));
+
+  const char *keys[]= { key };
+  size_t key_length[]= { strlen(key) };
+  test_compare(MEMCACHED_SUCCESS, memcached_mget(memc, keys, key_length, 1));
+
+  memcached_result_st results;
+  test_true(memcached_result_create(memc, &results));
+  memcached_return_t rc;
+  memcached_result_st *result= memcached_fetch_result(memc, &results, &rc);
+  test_true(result);
+  test_compare(MEMCACHED_SUCCESS, rc);
+  // The key comes back decoded and without the namespace
+  test_compare(strlen(key), memcached_result_key_length(result));
+  test_memcmp(key, memcached_result_key_value(result), strlen(key));
+  test_memcmp("binary", memcached_result_value(result), memcached_result_length(result));
+
+  test_null(memcached_fetch_result(memc, &results, &rc));
+  test_compare(MEMCACHED_END, rc);
+  memcached_result_free(&results);
+
+  memcached_free(memc);
+
+  return TEST_SUCCESS;
+}
+
+test_return_t meta_mget_TEST(memcached_st *original)
+{
+  memcached_st *memc= memcached_clone(NULL, original);
+  test_true(memc);
+  test_skip(TEST_SUCCESS, pre_meta(memc));
+
+  const char *keys[]= { "meta_mget_1", "meta_mget_2", "meta_mget_missing", "meta_mget_3" };
+  size_t key_length[]= { 11, 11, 17, 11 };
+  for (size_t x= 0; x < 4; x++)
+  {
+    if (x == 2)
+    {
+      memcached_delete(memc, keys[x], key_length[x], 0);
+      continue;
+    }
+    test_compare(MEMCACHED_SUCCESS, memcached_set(memc, keys[x], key_length[x], keys[x], key_length[x], 0, 0));
+  }
+
+  test_compare(MEMCACHED_SUCCESS, memcached_mget(memc, keys, key_length, 4));
+
+  memcached_result_st results;
+  test_true(memcached_result_create(memc, &results));
+  size_t found= 0;
+  memcached_return_t rc;
+  memcached_result_st *result;
+  while ((result= memcached_fetch_result(memc, &results, &rc)))
+  {
+    test_compare(MEMCACHED_SUCCESS, rc);
+    test_compare(memcached_result_key_length(result), memcached_result_length(result));
+    test_memcmp(memcached_result_key_value(result), memcached_result_value(result), memcached_result_length(result));
+    found++;
+  }
+  test_compare(MEMCACHED_END, rc);
+  test_compare(size_t(3), found);
+  memcached_result_free(&results);
+
+  memcached_free(memc);
+
+  return TEST_SUCCESS;
+}
+
+test_return_t meta_cas_TEST(memcached_st *original)
+{
+  memcached_st *memc= memcached_clone(NULL, original);
+  test_true(memc);
+  test_skip(TEST_SUCCESS, pre_meta(memc));
+  test_compare(MEMCACHED_SUCCESS, memcached_behavior_set(memc, MEMCACHED_BEHAVIOR_SUPPORT_CAS, true));
+
+  test_compare(MEMCACHED_SUCCESS, memcached_set(memc, test_literal_param(__func__), test_literal_param("first"), 0, 0));
+
+  const char *keys[]= { __func__ };
+  size_t key_length[]= { strlen(__func__) };
+  test_compare(MEMCACHED_SUCCESS, memcached_mget(memc, keys, key_length, 1));
+
+  memcached_result_st results;
+  test_true(memcached_result_create(memc, &results));
+  memcached_return_t rc;
+  memcached_result_st *result= memcached_fetch_result(memc, &results, &rc);
+  test_true(result);
+  uint64_t cas= memcached_result_cas(result);
+  test_true(cas);
+  test_null(memcached_fetch_result(memc, &results, &rc));
+  test_compare(MEMCACHED_END, rc);
+  memcached_result_free(&results);
+
+  test_compare(MEMCACHED_SUCCESS, memcached_cas(memc, test_literal_param(__func__), test_literal_param("second"), 0, 0, cas));
+  test_compare(MEMCACHED_DATA_EXISTS, memcached_cas(memc, test_literal_param(__func__), test_literal_param("third"), 0, 0, cas));
+
+  memcached_free(memc);
+
+  return TEST_SUCCESS;
+}
+
+test_return_t meta_increment_TEST(memcached_st *original)
+{
+  memcached_st *memc= memcached_clone(NULL, original);
+  test_true(memc);
+  test_skip(TEST_SUCCESS, pre_meta(memc));
+
+  memcached_delete(memc, test_literal_param(__func__), 0);
+
+  uint64_t new_number;
+  test_compare(MEMCACHED_NOTFOUND, memcached_increment(memc, test_literal_param(__func__), 1, &new_number));
+  test_compare(MEMCACHED_SUCCESS,
+               memcached_increment_with_initial(memc, test_literal_param(__func__), 1, 40, 0, &new_number));
+  test_compare(uint64_t(40), new_number);
+  test_compare(MEMCACHED_SUCCESS, memcached_increment(memc, test_literal_param(__func__), 5, &new_number));
+  test_compare(uint64_t(45), new_number);
+  test_compare(MEMCACHED_SUCCESS, memcached_decrement(memc, test_literal_param(__func__), 3, &new_number));
+  test_compare(uint64_t(42), new_number);
+
+  memcached_free(memc);
+
+  return TEST_SUCCESS;
+}
+
+test_return_t meta_noreply_TEST(memcached_st *original)
+{
+  memcached_st *memc= memcached_clone(NULL, original);
+  test_true(memc);
+  test_skip(TEST_SUCCESS, pre_meta(memc));
+  test_compare(MEMCACHED_SUCCESS, memcached_behavior_set(memc, MEMCACHED_BEHAVIOR_NOREPLY, true));
+
+  // A quiet failure is answered, and the answer must not be mistaken for the next reply
+  memcached_delete(memc, test_literal_param(__func__), 0);
+  memcached_replace(memc, test_literal_param(__func__), test_literal_param("missing"), 0, 0);
+  for (uint32_t x= 0; x < 10; x++)
+  {
+    memcached_set(memc, test_literal_param(__func__), test_literal_param("quiet"), 0, 0);
+  }
+  test_compare(MEMCACHED_SUCCESS, memcached_behavior_set(memc, MEMCACHED_BEHAVIOR_NOREPLY, false));
+
+  memcached_return_t rc;
+  size_t value_length;
+  uint32_t flags;
+  char *value= memcached_get(memc, test_literal_param(__func__), &value_length, &flags, &rc);
+  test_compare(MEMCACHED_SUCCESS, rc);
+  test_memcmp("quiet", value, value_length);
+  free(value);
+
+  memcached_free(memc);
+
+  return TEST_SUCCESS;
+}
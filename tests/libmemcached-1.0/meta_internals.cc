@@ -0,0 +1,471 @@
+/*  vim:expandtab:shiftwidth=2:tabstop=2:smarttab:
+ * 
+ *  Libmemcached client and server library.
+ *
+ *  Copyright (C) 2011 Data Differential, http://datadifferential.com/
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are
+ *  met:
+ *
+ *      * Redistributions of source code must retain the above copyright
+ *  notice, this list of conditions and the following disclaimer.
+ *
+ *      * Redistributions in binary form must reproduce the above
+ *  copyright notice, this list of conditions and the following disclaimer
+ *  in the documentation and/or other materials provided with the
+ *  distribution.
+ *
+ *      * The names of its contributors may not be used to endorse or
+ *  promote products derived from this software without specific prior
+ *  written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *  A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *  OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *  SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *  LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *  DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *  THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *  OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+// We let libmemcached/common.h define config since we are looking at
+// library internals.
+
+#include <config.h>
+
+#include <libmemcached/common.h>
+#include <libmemcached/meta.hpp>
+
+#include <libtest/test.hpp>
+
+#include <tests/meta_internals.h>
+
+#include <netinet/in.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sys/socket.h>
+
+#include <string>
+
+/*
+  The meta commands are checked against a server that plays back a script:
+  it reads exactly the request the client is expected to send, compares it
+  byte for byte, and answers with the reply a memcached 1.6 server would
+  give. None of it needs a real server.
+*/
+
+struct meta_exchange_st
+{
+  const char *request;
+  const char *reply;
+};
+
+struct meta_server_st
+{
+  int listen_fd;
+  in_port_t port;
+  pthread_t thread;
+  const meta_exchange_st *script;
+  std::string error;
+};
+
+static bool meta_server_read(int fd, std::string& request, size_t length)
+{
+  while (request.size() < length)
+  {
+    struct pollfd pfd= { fd, POLLIN, 0 };
+    if (poll(&pfd, 1, 5000) != 1)
+    {
+      return false;
+    }
+
+    char buffer[1024];
+    ssize_t read_length= recv(fd, buffer, std::min(sizeof(buffer), length -request.size()), 0);
+    if (read_length <= 0)
+    {
+      return false;
+    }
+    request.append(buffer, size_t(read_length));
+  }
+
+  return true;
+}
+
+static void *meta_server_run(void *context)
+{
+  meta_server_st *server= static_cast<meta_server_st *>(context);
+
+  struct pollfd pfd= { server->listen_fd, POLLIN, 0 };
+  int fd;
+  if (poll(&pfd, 1, 5000) != 1 or (fd= accept(server->listen_fd, NULL, NULL)) == -1)
+  {
+    server->error= "client never connected";
+    return NULL;
+  }
+
+  for (const meta_exchange_st *exchange= server->script; exchange->request; exchange++)
+  {
+    std::string request;
+    if (meta_server_read(fd, request, strlen(exchange->request)) == false or request.compare(exchange->request))
+    {
+      server->error= "expected \"" +std::string(exchange->request) +"\" got \"" +request +"\"";
+      break;
+    }
+
+    if (exchange->reply and send(fd, exchange->reply, strlen(exchange->reply), MSG_NOSIGNAL) == -1)
+    {
+      server->error= "could not reply to \"" +request +"\"";
+      break;
+    }
+  }
+
+  // Whatever comes after the script, such as quit, is not checked
+  std::string rest;
+  meta_server_read(fd, rest, SIZE_MAX);
+  close(fd);
+
+  return NULL;
+}
+
+static bool meta_server_start(meta_server_st& server, const meta_exchange_st *script)
+{
+  server.script= script;
+
+  struct sockaddr_in address;
+  memset(&address, 0, sizeof(address));
+  address.sin_family= AF_INET;
+  address.sin_addr.s_addr= htonl(INADDR_LOOPBACK);
+  socklen_t address_length= sizeof(address);
+
+  if ((server.listen_fd= socket(AF_INET, SOCK_STREAM, 0)) == -1)
+  {
+    return false;
+  }
+
+  if (bind(server.listen_fd, (struct sockaddr *)&address, sizeof(address)) == -1 or
+      listen(server.listen_fd, 1) == -1 or
+      getsockname(server.listen_fd, (struct sockaddr *)&address, &address_length) == -1 or
+      pthread_create(&server.thread, NULL, meta_server_run, &server) != 0)
+  {
+    close(server.listen_fd);
+    return false;
+  }
+  server.port= ntohs(address.sin_port);
+
+  return true;
+}
+
+static std::string meta_server_stop(meta_server_st& server)
+{
+  pthread_join(server.thread, NULL);
+  close(server.listen_fd);
+
+  return server.error;
+}
+
+static memcached_st *create_meta(in_port_t port)
+{
+  memcached_st *memc= memcached_create(NULL);
+  if (memc == NULL)
+  {
+    return NULL;
+  }
+
+  // Adding the server connects, and switching protocols would drop that connection
+  if (memcached_failed(memcached_behavior_set(memc, MEMCACHED_BEHAVIOR_META_PROTOCOL, true)) or
+      memcached_failed(memcached_server_add(memc, "127.0.0.1", port)))
+  {
+    memcached_free(memc);
+    return NULL;
+  }
+
+  return memc;
+}
+
+// The server is stopped even when the client fails, it lives on this stack
+static test_return_t meta_server_run_test(const meta_exchange_st *script, test_return_t (*client)(in_port_t))
+{
+  meta_server_st server;
+  test_true(meta_server_start(server, script));
+
+  test_return_t rc= client(server.port);
+  test_compare(std::string(), meta_server_stop(server));
+
+  return rc;
+}
+
+test_return_t meta_key_base64_test(void*)
+{
+  memcached_st *memc= memcached_create(NULL);
+  test_true(memc);
+  test_compare(MEMCACHED_SUCCESS, memcached_callback_set(memc, MEMCACHED_CALLBACK_NAMESPACE, "ns:"));
+
+  // A key the text protocol can carry goes out as it is, behind the namespace
+  memcached_meta_key_st meta_key;
+  memcached_meta_key(*memc, test_literal_param("plain"), meta_key);
+  test_false(meta_key.base64);
+  test_compare(size_t(3), meta_key.vector[0].length);
+  test_memcmp("ns:", meta_key.vector[0].buffer, 3);
+  test_compare(size_t(5), meta_key.vector[1].length);
+  test_memcmp("plain", meta_key.vector[1].buffer, 5);
+
+  // Otherwise the namespace is encoded along with it
+  memcached_meta_key(*memc, test_literal_param("a b"), meta_key);
+  test_true(meta_key.base64);
+  test_compare(size_t(8), meta_key.vector[0].length);
+  test_memcmp("bnM6YSBi", meta_key.vector[0].buffer, 8);
+  test_zero(meta_key.vector[1].length);
+
+  char key[MEMCACHED_MAX_KEY];
+  size_t key_length= meta_key.vector[0].length;
+  memcpy(key, meta_key.vector[0].buffer, key_length);
+  test_true(memcached_meta_key_decode(key, key_length));
+  test_compare(size_t(6), key_length);
+  test_memcmp("ns:a b", key, key_length);
+
+  // Padding
+  strcpy(key, "YQ==");
+  key_length= 4;
+  test_true(memcached_meta_key_decode(key, key_length));
+  test_compare(size_t(1), key_length);
+  test_compare('a', key[0]);
+
+  strcpy(key, "YWI=");
+  key_length= 4;
+  test_true(memcached_meta_key_decode(key, key_length));
+  test_compare(size_t(2), key_length);
+  test_memcmp("ab", key, 2);
+
+  const char *malformed[]= { "", "YQ=", "Y===", "YQ==YQ==", "a*bc" };
+  for (size_t x= 0; x < sizeof(malformed) / sizeof(malformed[0]); x++)
+  {
+    strcpy(key, malformed[x]);
+    key_length= strlen(key);
+    test_false(memcached_meta_key_decode(key, key_length));
+  }
+
+  // Encoding grows a key by a third, which the key limit has to leave room for
+  std::string binary_key(180, '\n');
+  test_compare(MEMCACHED_SUCCESS, memcached_meta_key_test(*memc, binary_key.c_str(), binary_key.size()));
+  binary_key.resize(MEMCACHED_MAX_KEY -1);
+  test_compare(MEMCACHED_BAD_KEY_PROVIDED, memcached_meta_key_test(*memc, binary_key.c_str(), binary_key.size()));
+  test_compare(MEMCACHED_SUCCESS, memcached_meta_key_test(*memc, test_literal_param("plain")));
+
+  memcached_free(memc);
+
+  return TEST_SUCCESS;
+}
+
+static const meta_exchange_st meta_set_get_script[]=
+{
+  { "ms meta_key 5 F7 T0\r\nvalue\r\n", "HD\r\n" },
+  { "mg meta_key k v f q\r\nmn\r\n", "VA 5 kmeta_key f7\r\nvalue\r\nMN\r\n" },
+  { "mg missing k v f q\r\nmn\r\n", "MN\r\n" },
+  { "ms meta_key 1 F0 T0 ME\r\nx\r\n", "NS\r\n" },
+  { "ms meta_key 1 MA\r\n!\r\n", "HD\r\n" },
+  { NULL, NULL }
+};
+
+static test_return_t meta_set_get(in_port_t port)
+{
+  memcached_st *memc= create_meta(port);
+  test_true(memc);
+
+  test_compare(MEMCACHED_SUCCESS, memcached_set(memc, test_literal_param("meta_key"), test_literal_param("value"), 0, 7));
+
+  size_t value_length;
+  uint32_t flags;
+  memcached_return_t rc;
+  char *value= memcached_get(memc, test_literal_param("meta_key"), &value_length, &flags, &rc);
+  test_compare(MEMCACHED_SUCCESS, rc);
+  test_compare(size_t(5), value_length);
+  test_memcmp("value", value, value_length);
+  test_compare(uint32_t(7), flags);
+  free(value);
+
+  test_null(memcached_get(memc, test_literal_param("missing"), &value_length, &flags, &rc));
+  test_compare(MEMCACHED_NOTFOUND, rc);
+
+  test_compare(MEMCACHED_NOTSTORED, memcached_add(memc, test_literal_param("meta_key"), test_literal_param("x"), 0, 0));
+  test_compare(MEMCACHED_SUCCESS, memcached_append(memc, test_literal_param("meta_key"), test_literal_param("!"), 0, 0));
+
+  memcached_free(memc);
+
+  return TEST_SUCCESS;
+}
+
+test_return_t meta_set_get_test(void*)
+{
+  return meta_server_run_test(meta_set_get_script, meta_set_get);
+}
+
+static const meta_exchange_st meta_base64_key_script[]=
+{
+  { "ms bnM6YSBi 1 F0 T0 b\r\nx\r\n", "HD\r\n" },
+  { "mg bnM6YSBi b k v f q\r\nmn\r\n", "VA 1 kbnM6YSBi b f0\r\nx\r\nMN\r\n" },
+  { "mg bnM6YSBi b k v f q\r\nmn\r\n", "VA 1 k!!!! b f0\r\nx\r\nMN\r\n" },
+  { NULL, NULL }
+};
+
+static test_return_t meta_base64_key(in_port_t port)
+{
+  memcached_st *memc= create_meta(port);
+  test_true(memc);
+  test_compare(MEMCACHED_SUCCESS, memcached_callback_set(memc, MEMCACHED_CALLBACK_NAMESPACE, "ns:"));
+
+  test_compare(MEMCACHED_SUCCESS, memcached_set(memc, test_literal_param("a b"), test_literal_param("x"), 0, 0));
+
+  // The key comes back decoded and without the namespace
+  const char *keys[]= { "a b" };
+  size_t key_length[]= { 3 };
+  test_compare(MEMCACHED_SUCCESS, memcached_mget(memc, keys, key_length, 1));
+  memcached_result_st results;
+  test_true(memcached_result_create(memc, &results));
+  memcached_return_t rc;
+  memcached_result_st *result= memcached_fetch_result(memc, &results, &rc);
+  test_true(result);
+  test_compare(size_t(3), memcached_result_key_length(result));
+  test_memcmp("a b", memcached_result_key_value(result), 3);
+  test_compare(size_t(1), memcached_result_length(result));
+  test_null(memcached_fetch_result(memc, &results, &rc));
+  test_compare(MEMCACHED_END, rc);
+
+  // A returned key that isn't base64 is an error, not a key
+  test_compare(MEMCACHED_SUCCESS, memcached_mget(memc, keys, key_length, 1));
+  test_null(memcached_fetch_result(memc, &results, &rc));
+  test_compare(MEMCACHED_UNKNOWN_READ_FAILURE, memcached_last_error(memc));
+  memcached_result_free(&results);
+
+  memcached_free(memc);
+
+  return TEST_SUCCESS;
+}
+
+test_return_t meta_base64_key_test(void*)
+{
+  return meta_server_run_test(meta_base64_key_script, meta_base64_key);
+}
+
+static const meta_exchange_st meta_cas_script[]=
+{
+  { "mg meta_key k v f c q\r\nmn\r\n", "VA 1 kmeta_key f0 c42\r\nx\r\nMN\r\n" },
+  { "ms meta_key 1 F0 T0 C42\r\ny\r\n", "EX\r\n" },
+  { NULL, NULL }
+};
+
+static test_return_t meta_cas(in_port_t port)
+{
+  memcached_st *memc= create_meta(port);
+  test_true(memc);
+  test_compare(MEMCACHED_SUCCESS, memcached_behavior_set(memc, MEMCACHED_BEHAVIOR_SUPPORT_CAS, true));
+
+  const char *keys[]= { "meta_key" };
+  size_t key_length[]= { strlen(keys[0]) };
+  test_compare(MEMCACHED_SUCCESS, memcached_mget(memc, keys, key_length, 1));
+  memcached_result_st results;
+  test_true(memcached_result_create(memc, &results));
+  memcached_return_t rc;
+  memcached_result_st *result= memcached_fetch_result(memc, &results, &rc);
+  test_true(result);
+  test_compare(uint64_t(42), memcached_result_cas(result));
+  test_null(memcached_fetch_result(memc, &results, &rc));
+  test_compare(MEMCACHED_END, rc);
+  memcached_result_free(&results);
+
+  test_compare(MEMCACHED_DATA_EXISTS, memcached_cas(memc, test_literal_param("meta_key"), test_literal_param("y"), 0, 0, 42));
+
+  memcached_free(memc);
+
+  return TEST_SUCCESS;
+}
+
+test_return_t meta_cas_test(void*)
+{
+  return meta_server_run_test(meta_cas_script, meta_cas);
+}
+
+static const meta_exchange_st meta_delete_arithmetic_script[]=
+{
+  { "md meta_key\r\n", "HD\r\n" },
+  { "md meta_key\r\n", "NF\r\n" },
+  { "ma counter D2 v\r\n", "VA 1\r\n3\r\n" },
+  { "ma counter D1 MD v\r\n", "VA 1\r\n2\r\n" },
+  { "ma counter D1 N60 J5 v\r\n", "VA 1\r\n5\r\n" },
+  { "ma missing D1 v\r\n", "NF\r\n" },
+  { "mg meta_key T60\r\n", "HD\r\n" },
+  { "mg meta_key\r\n", "EN\r\n" },
+  { NULL, NULL }
+};
+
+static test_return_t meta_delete_arithmetic(in_port_t port)
+{
+  memcached_st *memc= create_meta(port);
+  test_true(memc);
+
+  test_compare(MEMCACHED_SUCCESS, memcached_delete(memc, test_literal_param("meta_key"), 0));
+  test_compare(MEMCACHED_NOTFOUND, memcached_delete(memc, test_literal_param("meta_key"), 0));
+
+  uint64_t value;
+  test_compare(MEMCACHED_SUCCESS, memcached_increment(memc, test_literal_param("counter"), 2, &value));
+  test_compare(uint64_t(3), value);
+  test_compare(MEMCACHED_SUCCESS, memcached_decrement(memc, test_literal_param("counter"), 1, &value));
+  test_compare(uint64_t(2), value);
+  test_compare(MEMCACHED_SUCCESS, memcached_increment_with_initial(memc, test_literal_param("counter"), 1, 5, 60, &value));
+  test_compare(uint64_t(5), value);
+  test_compare(MEMCACHED_NOTFOUND, memcached_increment(memc, test_literal_param("missing"), 1, &value));
+
+  test_compare(MEMCACHED_SUCCESS, memcached_touch(memc, test_literal_param("meta_key"), 60));
+  test_compare(MEMCACHED_NOTFOUND, memcached_exist(memc, test_literal_param("meta_key")));
+
+  memcached_free(memc);
+
+  return TEST_SUCCESS;
+}
+
+test_return_t meta_delete_arithmetic_test(void*)
+{
+  return meta_server_run_test(meta_delete_arithmetic_script, meta_delete_arithmetic);
+}
+
+/*
+  A quiet request that fails still answers. The O flag marks the answer,
+  so it isn't taken for the reply to the delete that comes after it.
+*/
+static const meta_exchange_st meta_noreply_script[]=
+{
+  { "ms meta_key 1 F0 T0 q Oq\r\nx\r\n", NULL },
+  { "ms meta_key 1 F0 T0 ME q Oq\r\nx\r\n", "NS Oq\r\n" },
+  { "md meta_key q Oq\r\n", NULL },
+  { "md meta_key\r\n", "HD\r\n" },
+  { NULL, NULL }
+};
+
+static test_return_t meta_noreply(in_port_t port)
+{
+  memcached_st *memc= create_meta(port);
+  test_true(memc);
+  test_compare(MEMCACHED_SUCCESS, memcached_behavior_set(memc, MEMCACHED_BEHAVIOR_NOREPLY, true));
+
+  test_compare(MEMCACHED_SUCCESS, memcached_set(memc, test_literal_param("meta_key"), test_literal_param("x"), 0, 0));
+  test_compare(MEMCACHED_SUCCESS, memcached_add(memc, test_literal_param("meta_key"), test_literal_param("x"), 0, 0));
+  test_compare(MEMCACHED_SUCCESS, memcached_delete(memc, test_literal_param("meta_key"), 0));
+
+  test_compare(MEMCACHED_SUCCESS, memcached_behavior_set(memc, MEMCACHED_BEHAVIOR_NOREPLY, false));
+  test_compare(MEMCACHED_SUCCESS, memcached_delete(memc, test_literal_param("meta_key"), 0));
+
+  memcached_free(memc);
+
+  return TEST_SUCCESS;
+}
+
+test_return_t meta_noreply_test(void*)
+{
+  return meta_server_run_test(meta_noreply_script, meta_noreply);
+}
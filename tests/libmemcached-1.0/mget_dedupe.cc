@@ -0,0 +1,376 @@
+/*  vim:expandtab:shiftwidth=2:tabstop=2:smarttab:
+ * 
+ *  Libmemcached library
+ *
+ *  Copyright (C) 2011-2012 Data Differential, http://datadifferential.com/
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are
+ *  met:
+ *
+ *      * Redistributions of source code must retain the above copyright
+ *  notice, this list of conditions and the following disclaimer.
+ *
+ *      * Redistributions in binary form must reproduce the above
+ *  copyright notice, this list of conditions and the following disclaimer
+ *  in the documentation and/or other materials provided with the
+ *  distribution.
+ *
+ *      * The names of its contributors may not be used to endorse or
+ *  promote products derived from this software without specific prior
+ *  written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *  A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *  OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *  SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *  LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *  DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *  THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *  OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+#include <config.h>
+#include <libtest/test.hpp>
+
+using namespace libtest;
+
+#include <libmemcached-1.0/memcached.h>
+
+#include <cstdio>
+#include <vector>
+
+#include "tests/libmemcached-1.0/mget_dedupe.h"
+
+/*
+  "a" and "b" are stored, "c" is not, and "a" is asked for three times.
+*/
+static const char *dedupe_keys[]= { "dedupe_a", "dedupe_b", "dedupe_a", "dedupe_c", "dedupe_a", "dedupe_b" };
+static const size_t dedupe_key_length[]= { 8, 8, 8, 8, 8, 8 };
+#define DEDUPE_KEYS (sizeof(dedupe_keys) / sizeof(dedupe_keys[0]))
+
+static memcached_st *create_dedupe(memcached_st *original)
+{
+  memcached_st *memc= memcached_clone(NULL, original);
+  if (memc == NULL)
+  {
+    return NULL;
+  }
+
+  if (memcached_failed(memcached_behavior_set(memc, MEMCACHED_BEHAVIOR_MGET_DEDUPE, true)) or
+      memcached_failed(memcached_set(memc, test_literal_param("dedupe_a"), test_literal_param("value a"), 0, 1)) or
+      memcached_failed(memcached_set(memc, test_literal_param("dedupe_b"), test_literal_param("value b"), 0, 2)))
+  {
+    memcached_free(memc);
+    return NULL;
+  }
+
+  memcached_return_t rc= memcached_delete(memc, test_literal_param("dedupe_c"), 0);
+  if (rc != MEMCACHED_SUCCESS and rc != MEMCACHED_NOTFOUND)
+  {
+    memcached_free(memc);
+    return NULL;
+  }
+
+  return memc;
+}
+
+/*
+  Check that a result matches the key it says it answers, and that no
+  position is answered twice.
+*/
+static bool dedupe_result_matches(const memcached_result_st *result, std::vector<bool>& answered)
+{
+  size_t position= memcached_result_key_index(result);
+  if (position >= DEDUPE_KEYS or answered[position])
+  {
+    return false;
+  }
+  answered[position]= true;
+
+  if (memcached_result_key_length(result) != dedupe_key_length[position] or
+      memcmp(memcached_result_key_value(result), dedupe_keys[position], dedupe_key_length[position]))
+  {
+    return false;
+  }
+
+  const char *expected= dedupe_keys[position][7] == 'a' ? "value a" : "value b";
+  return memcached_result_length(result) == strlen(expected) and
+    memcmp(memcached_result_value(result), expected, strlen(expected)) == 0 and
+    memcached_result_flags(result) == uint32_t(dedupe_keys[position][7] == 'a' ? 1 : 2);
+}
+
+static bool dedupe_all_answered(const std::vector<bool>& answered)
+{
+  for (size_t x= 0; x < DEDUPE_KEYS; x++)
+  {
+    if (answered[x] != (x != 3))
+    {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+test_return_t mget_dedupe_behavior_TEST(memcached_st *original)
+{
+  memcached_st *memc= memcached_clone(NULL, original);
+  test_true(memc);
+
+  test_zero(memcached_behavior_get(memc, MEMCACHED_BEHAVIOR_MGET_DEDUPE));
+  test_compare(MEMCACHED_SUCCESS, memcached_behavior_set(memc, MEMCACHED_BEHAVIOR_MGET_DEDUPE, true));
+  test_compare(uint64_t(1), memcached_behavior_get(memc, MEMCACHED_BEHAVIOR_MGET_DEDUPE));
+
+  memcached_st *clone= memcached_clone(NULL, memc);
+  test_true(clone);
+  test_compare(uint64_t(1), memcached_behavior_get(clone, MEMCACHED_BEHAVIOR_MGET_DEDUPE));
+  memcached_free(clone);
+
+  test_compare(MEMCACHED_SUCCESS, memcached_behavior_set(memc, MEMCACHED_BEHAVIOR_MGET_DEDUPE, false));
+  test_zero(memcached_behavior_get(memc, MEMCACHED_BEHAVIOR_MGET_DEDUPE));
+
+  // Without dedupe there is no index to report
+  test_compare(MEMCACHED_SUCCESS,
+               memcached_set(memc, test_literal_param(__func__), test_literal_param("value"), 0, 0));
+  const char *keys[]= { __func__ };
+  size_t key_length[]= { strlen(__func__) };
+  test_compare(MEMCACHED_SUCCESS, memcached_mget(memc, keys, key_length, 1));
+
+  memcached_return_t rc;
+  memcached_result_st *result= memcached_fetch_result(memc, NULL, &rc);
+  test_true(result);
+  test_compare(SIZE_MAX, memcached_result_key_index(result));
+  memcached_result_free(result);
+  test_null(memcached_fetch_result(memc, NULL, &rc));
+
+  memcached_free(memc);
+
+  return TEST_SUCCESS;
+}
+
+test_return_t mget_dedupe_fetch_result_TEST(memcached_st *original)
+{
+  memcached_st *memc= create_dedupe(original);
+  test_true(memc);
+
+  // Run twice so the index is reused
+  for (uint32_t round= 0; round < 2; round++)
+  {
+    test_compare(MEMCACHED_SUCCESS, memcached_mget(memc, dedupe_keys, dedupe_key_length, DEDUPE_KEYS));
+
+    std::vector<bool> answered(DEDUPE_KEYS);
+    memcached_result_st result_obj;
+    memcached_result_st *result= memcached_result_create(memc, &result_obj);
+    test_true(result);
+    memcached_result_st *other= memcached_result_create(memc, NULL);
+    test_true(other);
+
+    memcached_return_t rc;
+    size_t count= 0;
+    while (memcached_fetch_result(memc, result, &rc))
+    {
+      test_compare(MEMCACHED_SUCCESS, rc);
+      test_true(dedupe_result_matches(result, answered));
+      // Only the result the last fetch filled in has a position
+      test_compare(SIZE_MAX, memcached_result_key_index(other));
+      count++;
+    }
+    test_compare(MEMCACHED_END, rc);
+    memcached_result_free(other);
+    memcached_result_free(result);
+
+    test_compare(size_t(DEDUPE_KEYS -1), count);
+    test_true(dedupe_all_answered(answered));
+  }
+
+  memcached_free(memc);
+
+  return TEST_SUCCESS;
+}
+
+test_return_t mget_dedupe_fetch_TEST(memcached_st *original)
+{
+  memcached_st *memc= create_dedupe(original);
+  test_true(memc);
+
+  test_compare(MEMCACHED_SUCCESS, memcached_mget(memc, dedupe_keys, dedupe_key_length, DEDUPE_KEYS));
+
+  // memcached_fetch() takes the value out of the result, replays still have theirs
+  size_t a= 0, b= 0;
+  char key[MEMCACHED_MAX_KEY];
+  size_t key_length;
+  size_t value_length;
+  uint32_t flags;
+  memcached_return_t rc;
+  char *value;
+  while ((value= memcached_fetch(memc, key, &key_length, &value_length, &flags, &rc)))
+  {
+    test_compare(size_t(7), value_length);
+    if (memcmp(value, "value a", 7) == 0)
+    {
+      test_memcmp("dedupe_a", key, 8);
+      a++;
+    }
+    else
+    {
+      test_memcmp("value b", value, 7);
+      test_memcmp("dedupe_b", key, 8);
+      b++;
+    }
+    free(value);
+  }
+
+  test_compare(size_t(3), a);
+  test_compare(size_t(2), b);
+
+  memcached_free(memc);
+
+  return TEST_SUCCESS;
+}
+
+static memcached_return_t dedupe_callback(const memcached_st *, memcached_result_st *result, void *context)
+{
+  std::vector<bool>& answered= *static_cast<std::vector<bool> *>(context);
+  if (dedupe_result_matches(result, answered) == false)
+  {
+    return MEMCACHED_FAILURE;
+  }
+
+  return MEMCACHED_SUCCESS;
+}
+
+test_return_t mget_dedupe_fetch_execute_TEST(memcached_st *original)
+{
+  memcached_st *memc= create_dedupe(original);
+  test_true(memc);
+
+  test_compare(MEMCACHED_SUCCESS, memcached_mget(memc, dedupe_keys, dedupe_key_length, DEDUPE_KEYS));
+
+  std::vector<bool> answered(DEDUPE_KEYS);
+  memcached_execute_fn callbacks[]= { dedupe_callback };
+  test_compare(MEMCACHED_SUCCESS, memcached_fetch_execute(memc, callbacks, &answered, 1));
+  test_true(dedupe_all_answered(answered));
+
+  memcached_free(memc);
+
+  return TEST_SUCCESS;
+}
+
+test_return_t mget_dedupe_mget_execute_TEST(memcached_st *original)
+{
+  memcached_st *memc= create_dedupe(original);
+  test_true(memc);
+  test_compare(MEMCACHED_SUCCESS, memcached_behavior_set(memc, MEMCACHED_BEHAVIOR_BINARY_PROTOCOL, true));
+
+  std::vector<bool> answered(DEDUPE_KEYS);
+  memcached_execute_fn callbacks[]= { dedupe_callback };
+  test_compare(MEMCACHED_SUCCESS,
+               memcached_mget_execute(memc, dedupe_keys, dedupe_key_length, DEDUPE_KEYS, callbacks, &answered, 1));
+  test_compare(MEMCACHED_SUCCESS, memcached_fetch_execute(memc, callbacks, &answered, 1));
+  test_true(dedupe_all_answered(answered));
+
+  memcached_free(memc);
+
+  return TEST_SUCCESS;
+}
+
+static uint64_t dedupe_get_hits(memcached_st *memc)
+{
+  memcached_return_t rc;
+  memcached_stat_st *stats= memcached_stat(memc, NULL, &rc);
+  if (stats == NULL)
+  {
+    return 0;
+  }
+
+  uint64_t get_hits= 0;
+  for (uint32_t x= 0; x < memcached_server_count(memc); x++)
+  {
+    get_hits+= stats[x].get_hits;
+  }
+  memcached_stat_free(NULL, stats);
+
+  return get_hits;
+}
+
+#define DEDUPE_BENCHMARK_POSITIONS 1000
+#define DEDUPE_BENCHMARK_DISTINCT 150
+#define DEDUPE_BENCHMARK_ROUNDS 50
+
+/*
+  A page renderer asking for 1000 fragments of which only 150 differ, each
+  value 1K. Server side get_hits shows how many values went over the wire.
+*/
+test_return_t mget_dedupe_benchmark_TEST(memcached_st *original)
+{
+  memcached_st *memc= memcached_clone(NULL, original);
+  test_true(memc);
+
+  std::vector<char> value(1024, 'x');
+  char distinct[DEDUPE_BENCHMARK_DISTINCT][32];
+  for (uint32_t x= 0; x < DEDUPE_BENCHMARK_DISTINCT; x++)
+  {
+    snprintf(distinct[x], sizeof(distinct[x]), "dedupe_fragment_%u", x);
+    test_compare(MEMCACHED_SUCCESS,
+                 memcached_set(memc, distinct[x], strlen(distinct[x]), &value[0], value.size(), 0, 0));
+  }
+
+  // Popular fragments show up far more often than the rest
+  const char *keys[DEDUPE_BENCHMARK_POSITIONS];
+  size_t key_length[DEDUPE_BENCHMARK_POSITIONS];
+  uint32_t seed= 7;
+  for (uint32_t x= 0; x < DEDUPE_BENCHMARK_POSITIONS; x++)
+  {
+    seed= seed * 1103515245 + 12345;
+    uint32_t pick= x < DEDUPE_BENCHMARK_DISTINCT ? x : (seed >> 16) % ((seed & 1) ? 10 : DEDUPE_BENCHMARK_DISTINCT);
+    keys[x]= distinct[pick];
+    key_length[x]= strlen(distinct[pick]);
+  }
+
+  memcached_result_st result_obj;
+  memcached_result_st *result= memcached_result_create(memc, &result_obj);
+  test_true(result);
+
+  for (uint64_t dedupe= 0; dedupe <= 1; dedupe++)
+  {
+    test_compare(MEMCACHED_SUCCESS, memcached_behavior_set(memc, MEMCACHED_BEHAVIOR_MGET_DEDUPE, dedupe));
+
+    uint64_t get_hits= dedupe_get_hits(memc);
+    libtest::Timer timer;
+    timer.reset();
+    for (uint32_t round= 0; round < DEDUPE_BENCHMARK_ROUNDS; round++)
+    {
+      test_compare(MEMCACHED_SUCCESS, memcached_mget(memc, keys, key_length, DEDUPE_BENCHMARK_POSITIONS));
+
+      size_t count= 0;
+      memcached_return_t rc;
+      while (memcached_fetch_result(memc, result, &rc))
+      {
+        count++;
+      }
+      test_compare(size_t(DEDUPE_BENCHMARK_POSITIONS), count);
+    }
+    timer.sample();
+    get_hits= dedupe_get_hits(memc) -get_hits;
+
+    Out << (dedupe ? "with" : "without") << " dedupe, values sent per mget "
+      << get_hits / DEDUPE_BENCHMARK_ROUNDS << ", " << DEDUPE_BENCHMARK_ROUNDS << " mgets of "
+      << DEDUPE_BENCHMARK_POSITIONS << " keys in " << timer;
+
+    if (dedupe)
+    {
+      test_true(get_hits < uint64_t(DEDUPE_BENCHMARK_POSITIONS) * DEDUPE_BENCHMARK_ROUNDS);
+    }
+  }
+  memcached_result_free(result);
+
+  memcached_free(memc);
+
+  return TEST_SUCCESS;
+}
@@ -0,0 +1,392 @@
+/*  vim:expandtab:shiftwidth=2:tabstop=2:smarttab:
+ * 
+ *  Libmemcached library
+ *
+ *  Copyright (C) 2011-2012 Data Differential, http://datadifferential.com/
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are
+ *  met:
+ *
+ *      * Redistributions of source code must retain the above copyright
+ *  notice, this list of conditions and the following disclaimer.
+ *
+ *      * Redistributions in binary form must reproduce the above
+ *  copyright notice, this list of conditions and the following disclaimer
+ *  in the documentation and/or other materials provided with the
+ *  distribution.
+ *
+ *      * The names of its contributors may not be used to endorse or
+ *  promote products derived from this software without specific prior
+ *  written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *  A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *  OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *  SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *  LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *  DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *  THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *  OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+#include <config.h>
+#include <libtest/test.hpp>
+
+using namespace libtest;
+
+#include <libmemcached-1.0/memcached.h>
+#include <libmemcachedutil-1.0/util.h>
+
+#include "tests/libmemcached-1.0/near_cache.h"
+
+#define NEAR_CACHE_BUDGET (64 * 1024)
+
+static memcached_st *create_near_cached(memcached_st *original, time_t ttl, time_t stale_ttl)
+{
+  memcached_st *memc= memcached_clone(NULL, original);
+  if (memc and memcached_failed(memcached_near_cache_create(memc, NEAR_CACHE_BUDGET, ttl, stale_ttl)))
+  {
+    memcached_free(memc);
+    return NULL;
+  }
+
+  return memc;
+}
+
+/*
+  A memcached_st that talks to the same servers but does not see the
+  near cache, to change values behind its back.
+*/
+static memcached_st *create_uncached(memcached_st *original)
+{
+  memcached_st *memc= memcached_clone(NULL, original);
+  memcached_near_cache_free(memc);
+
+  return memc;
+}
+
+static bool get_matches(memcached_st *memc, const char *key, const char *expected)
+{
+  size_t value_length;
+  uint32_t flags;
+  memcached_return_t rc;
+  char *value= memcached_get(memc, key, strlen(key), &value_length, &flags, &rc);
+  if (value == NULL)
+  {
+    return expected == NULL;
+  }
+
+  bool matches= expected and value_length == strlen(expected) and memcmp(value, expected, value_length) == 0;
+  free(value);
+
+  return matches;
+}
+
+test_return_t near_cache_hit_TEST(memcached_st *original)
+{
+  memcached_st *memc= create_near_cached(original, 60, 0);
+  test_true(memc);
+
+  memcached_near_cache_stat_st stat;
+  test_compare(MEMCACHED_NOT_SUPPORTED, memcached_near_cache_stat(original, &stat));
+
+  test_compare(MEMCACHED_SUCCESS,
+               memcached_set(memc, test_literal_param(__func__), test_literal_param("fudge"), 0, 7));
+
+  for (uint32_t x= 0; x < 3; x++)
+  {
+    size_t value_length;
+    uint32_t flags;
+    memcached_return_t rc;
+    char *value= memcached_get(memc, test_literal_param(__func__), &value_length, &flags, &rc);
+    test_compare(MEMCACHED_SUCCESS, rc);
+    test_true(value);
+    test_compare(size_t(5), value_length);
+    test_memcmp("fudge", value, 5);
+    test_zero(value[5]);
+    test_compare(uint32_t(7), flags);
+    free(value);
+  }
+
+  test_compare(MEMCACHED_SUCCESS, memcached_near_cache_stat(memc, &stat));
+  test_compare(uint64_t(1), stat.misses);
+  test_compare(uint64_t(2), stat.hits);
+  test_compare(uint64_t(1), stat.items);
+  test_true(stat.bytes > 5);
+  test_compare(uint64_t(NEAR_CACHE_BUDGET), stat.byte_budget);
+
+  memcached_free(memc);
+
+  return TEST_SUCCESS;
+}
+
+test_return_t near_cache_invalidate_TEST(memcached_st *original)
+{
+  memcached_st *memc= create_near_cached(original, 60, 0);
+  test_true(memc);
+
+  test_compare(MEMCACHED_SUCCESS,
+               memcached_set(memc, test_literal_param(__func__), test_literal_param("1"), 0, 0));
+  test_true(get_matches(memc, __func__, "1"));
+
+  test_compare(MEMCACHED_SUCCESS,
+               memcached_set(memc, test_literal_param(__func__), test_literal_param("2"), 0, 0));
+  test_true(get_matches(memc, __func__, "2"));
+
+  test_compare(MEMCACHED_SUCCESS,
+               memcached_increment(memc, test_literal_param(__func__), 1, NULL));
+  test_true(get_matches(memc, __func__, "3"));
+
+  test_compare(MEMCACHED_SUCCESS,
+               memcached_delete(memc, test_literal_param(__func__), 0));
+  test_true(get_matches(memc, __func__, NULL));
+
+  test_compare(MEMCACHED_SUCCESS,
+               memcached_set(memc, test_literal_param(__func__), test_literal_param("4"), 0, 0));
+  test_true(get_matches(memc, __func__, "4"));
+  test_compare(MEMCACHED_SUCCESS, memcached_flush(memc, 0));
+  test_true(get_matches(memc, __func__, NULL));
+
+  memcached_near_cache_stat_st stat;
+  test_compare(MEMCACHED_SUCCESS, memcached_near_cache_stat(memc, &stat));
+  test_compare(uint64_t(4), stat.invalidations);
+  test_zero(stat.hits);
+
+  memcached_free(memc);
+
+  return TEST_SUCCESS;
+}
+
+/*
+  Binary GAT is what every server with touch has, the ASCII form came much
+  later. A gat may shorten the life of an item, so the near cache must drop
+  its copy and the next get has to go to the server.
+*/
+test_return_t near_cache_gat_TEST(memcached_st *original)
+{
+  test_compare(MEMCACHED_SUCCESS, memcached_version(original));
+  test_skip(true, libmemcached_util_version_check(original, 1, 4, 8));
+
+  memcached_st *memc= create_near_cached(original, 60, 0);
+  test_true(memc);
+  test_compare(MEMCACHED_SUCCESS, memcached_behavior_set(memc, MEMCACHED_BEHAVIOR_BINARY_PROTOCOL, true));
+
+  const char *keys[]= { "near_cache_gat", "near_cache_mgat" };
+  size_t key_length[]= { strlen(keys[0]), strlen(keys[1]) };
+  for (size_t x= 0; x < 2; x++)
+  {
+    test_compare(MEMCACHED_SUCCESS,
+                 memcached_set(memc, keys[x], key_length[x], test_literal_param("cached"), 0, 0));
+    test_true(get_matches(memc, keys[x], "cached"));
+  }
+
+  memcached_near_cache_stat_st before;
+  test_compare(MEMCACHED_SUCCESS, memcached_near_cache_stat(memc, &before));
+
+  size_t value_length;
+  uint32_t flags;
+  memcached_return_t rc;
+  free(memcached_gat(memc, keys[0], key_length[0], 60 * 60, &value_length, &flags, &rc));
+  test_compare(MEMCACHED_SUCCESS, rc);
+
+  test_compare(MEMCACHED_SUCCESS, memcached_mgat(memc, &keys[1], &key_length[1], 1, 60 * 60));
+  memcached_result_st *result;
+  while ((result= memcached_fetch_result(memc, NULL, &rc)))
+  {
+    memcached_result_free(result);
+  }
+
+  memcached_near_cache_stat_st after;
+  test_compare(MEMCACHED_SUCCESS, memcached_near_cache_stat(memc, &after));
+  test_compare(uint64_t(2), after.invalidations -before.invalidations);
+
+  test_true(get_matches(memc, keys[0], "cached"));
+  test_true(get_matches(memc, keys[1], "cached"));
+  test_compare(MEMCACHED_SUCCESS, memcached_near_cache_stat(memc, &after));
+  test_compare(before.hits, after.hits);
+
+  memcached_free(memc);
+
+  return TEST_SUCCESS;
+}
+
+test_return_t near_cache_ttl_TEST(memcached_st *original)
+{
+  memcached_st *memc= create_near_cached(original, 1, 0);
+  test_true(memc);
+  memcached_st *uncached= create_uncached(original);
+  test_true(uncached);
+
+  test_compare(MEMCACHED_SUCCESS,
+               memcached_set(memc, test_literal_param(__func__), test_literal_param("old"), 0, 0));
+  test_true(get_matches(memc, __func__, "old"));
+
+  test_compare(MEMCACHED_SUCCESS,
+               memcached_set(uncached, test_literal_param(__func__), test_literal_param("new"), 0, 0));
+  test_true(get_matches(memc, __func__, "old"));
+
+  libtest::dream(2, 0);
+  test_true(get_matches(memc, __func__, "new"));
+
+  memcached_near_cache_stat_st stat;
+  test_compare(MEMCACHED_SUCCESS, memcached_near_cache_stat(memc, &stat));
+  test_compare(uint64_t(1), stat.expirations);
+
+  memcached_free(uncached);
+  memcached_free(memc);
+
+  return TEST_SUCCESS;
+}
+
+/*
+  Called while the first caller to see the stale value is revalidating
+  it, another caller sharing the cache gets the stale value.
+*/
+static memcached_return_t stale_get_failure(const memcached_st *ptr, const char *key, size_t key_length, memcached_result_st *)
+{
+  memcached_st *other= static_cast<memcached_st *>(memcached_get_user_data(ptr));
+  size_t value_length;
+  uint32_t flags;
+  memcached_return_t rc;
+  char *value= memcached_get(other, key, key_length, &value_length, &flags, &rc);
+  if (value and value_length == 5 and memcmp(value, "stale", 5) == 0)
+  {
+    memcached_set_user_data(other, value);
+  }
+  else
+  {
+    free(value);
+  }
+
+  return MEMCACHED_NOTFOUND;
+}
+
+test_return_t near_cache_stale_TEST(memcached_st *original)
+{
+  memcached_st *memc= create_near_cached(original, 1, 60);
+  test_true(memc);
+  memcached_st *other= memcached_clone(NULL, memc);
+  test_true(other);
+  memcached_st *uncached= create_uncached(original);
+  test_true(uncached);
+
+  test_compare(MEMCACHED_SUCCESS,
+               memcached_set(memc, test_literal_param(__func__), test_literal_param("stale"), 0, 0));
+  test_true(get_matches(memc, __func__, "stale"));
+
+  test_compare(MEMCACHED_SUCCESS, memcached_delete(uncached, test_literal_param(__func__), 0));
+  libtest::dream(2, 0);
+
+  memcached_set_user_data(memc, other);
+  memcached_set_user_data(other, NULL);
+  test_compare(MEMCACHED_SUCCESS,
+               memcached_callback_set(memc, MEMCACHED_CALLBACK_GET_FAILURE, reinterpret_cast<void *>(stale_get_failure)));
+  test_true(get_matches(memc, __func__, NULL));
+
+  char *stale= static_cast<char *>(memcached_get_user_data(other));
+  test_true(stale);
+  free(stale);
+
+  memcached_near_cache_stat_st stat;
+  test_compare(MEMCACHED_SUCCESS, memcached_near_cache_stat(memc, &stat));
+  test_compare(uint64_t(1), stat.stale_hits);
+  test_zero(stat.items);
+
+  memcached_free(uncached);
+  memcached_free(other);
+  memcached_free(memc);
+
+  return TEST_SUCCESS;
+}
+
+test_return_t near_cache_clone_TEST(memcached_st *original)
+{
+  memcached_st *memc= create_near_cached(original, 60, 0);
+  test_true(memc);
+
+  test_compare(MEMCACHED_SUCCESS,
+               memcached_set(memc, test_literal_param(__func__), test_literal_param("shared"), 0, 0));
+  test_true(get_matches(memc, __func__, "shared"));
+
+  memcached_st *clone= memcached_clone(NULL, memc);
+  test_true(clone);
+  memcached_free(memc);
+
+  test_true(get_matches(clone, __func__, "shared"));
+
+  memcached_near_cache_stat_st stat;
+  test_compare(MEMCACHED_SUCCESS, memcached_near_cache_stat(clone, &stat));
+  test_compare(uint64_t(1), stat.hits);
+
+  memcached_free(clone);
+
+  return TEST_SUCCESS;
+}
+
+#define NEAR_CACHE_HOT_KEYS 20
+#define NEAR_CACHE_SCAN_KEYS 2000
+
+test_return_t near_cache_scan_resistance_TEST(memcached_st *original)
+{
+  memcached_st *memc= create_near_cached(original, 60, 0);
+  test_true(memc);
+
+  char value[100];
+  memset(value, 'x', sizeof(value));
+
+  for (uint32_t x= 0; x < NEAR_CACHE_HOT_KEYS +NEAR_CACHE_SCAN_KEYS; x++)
+  {
+    char key[MEMCACHED_MAX_KEY];
+    int key_length= snprintf(key, sizeof(key), "near_cache_%u", x);
+    test_compare(MEMCACHED_SUCCESS,
+                 memcached_set(memc, key, key_length, value, sizeof(value), 0, 0));
+  }
+
+  // The hot keys are read often, then a scan reads everything else once
+  for (uint32_t round= 0; round < 10; round++)
+  {
+    for (uint32_t x= 0; x < NEAR_CACHE_HOT_KEYS; x++)
+    {
+      char key[MEMCACHED_MAX_KEY];
+      snprintf(key, sizeof(key), "near_cache_%u", x);
+      test_false(get_matches(memc, key, NULL));
+    }
+  }
+
+  for (uint32_t x= NEAR_CACHE_HOT_KEYS; x < NEAR_CACHE_HOT_KEYS +NEAR_CACHE_SCAN_KEYS; x++)
+  {
+    char key[MEMCACHED_MAX_KEY];
+    snprintf(key, sizeof(key), "near_cache_%u", x);
+    test_false(get_matches(memc, key, NULL));
+  }
+
+  memcached_near_cache_stat_st before;
+  test_compare(MEMCACHED_SUCCESS, memcached_near_cache_stat(memc, &before));
+  test_true(before.rejections);
+  test_true(before.bytes <= before.byte_budget);
+
+  for (uint32_t x= 0; x < NEAR_CACHE_HOT_KEYS; x++)
+  {
+    char key[MEMCACHED_MAX_KEY];
+    snprintf(key, sizeof(key), "near_cache_%u", x);
+    test_false(get_matches(memc, key, NULL));
+  }
+
+  memcached_near_cache_stat_st after;
+  test_compare(MEMCACHED_SUCCESS, memcached_near_cache_stat(memc, &after));
+  test_compare(uint64_t(NEAR_CACHE_HOT_KEYS), after.hits -before.hits);
+
+  Out << "near cache hit rate " << double(after.hits) / double(after.hits +after.misses)
+    << ", " << double(after.hit_time_usec) / double(after.hits) << "us per hit, "
+    << double(after.miss_time_usec) / double(after.misses) << "us per miss";
+
+  memcached_free(memc);
+
+  return TEST_SUCCESS;
+}
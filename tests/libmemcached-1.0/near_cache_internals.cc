@@ -0,0 +1,232 @@
+/*  vim:expandtab:shiftwidth=2:tabstop=2:smarttab:
+ * 
+ *  Libmemcached client and server library.
+ *
+ *  Copyright (C) 2011 Data Differential, http://datadifferential.com/
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are
+ *  met:
+ *
+ *      * Redistributions of source code must retain the above copyright
+ *  notice, this list of conditions and the following disclaimer.
+ *
+ *      * Redistributions in binary form must reproduce the above
+ *  copyright notice, this list of conditions and the following disclaimer
+ *  in the documentation and/or other materials provided with the
+ *  distribution.
+ *
+ *      * The names of its contributors may not be used to endorse or
+ *  promote products derived from this software without specific prior
+ *  written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *  A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *  OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *  SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *  LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *  DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *  THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *  OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+// We let libmemcached/common.h define config since we are looking at
+// library internals.
+
+#include <config.h>
+
+#include <libmemcached/memcached.h>
+#include <libmemcached/near_cache.hpp>
+
+#include <libtest/test.hpp>
+
+#include <tests/near_cache_internals.h>
+
+#include <string>
+
+/*
+  These drive the near cache the way get.cc and the write paths do, without
+  a server, so the order of a get, a write and the fill of that get can be
+  picked by the test.
+*/
+
+static memcached_st *create_near_cached(void)
+{
+  memcached_st *memc= memcached_create(NULL);
+  if (memc and memcached_failed(memcached_near_cache_create(memc, 64 * 1024, 60, 0)))
+  {
+    memcached_free(memc);
+    return NULL;
+  }
+
+  return memc;
+}
+
+static bool near_cache_has(memcached_st *memc,
+                           const char *group_key,
+                           const char *key,
+                           const char *expected)
+{
+  size_t value_length;
+  uint32_t flags;
+  uint64_t started, generation;
+  char *value= memcached_near_cache_get(memc,
+                                        group_key, group_key ? strlen(group_key) : 0,
+                                        key, strlen(key),
+                                        &value_length, &flags, started, generation);
+  bool found= value and value_length == strlen(expected) and memcmp(value, expected, value_length) == 0;
+  free(value);
+
+  return found;
+}
+
+static void near_cache_read(memcached_st *memc,
+                            const char *group_key,
+                            const char *key, const char *value)
+{
+  size_t value_length;
+  uint32_t flags;
+  uint64_t started, generation;
+  free(memcached_near_cache_get(memc,
+                                group_key, group_key ? strlen(group_key) : 0,
+                                key, strlen(key),
+                                &value_length, &flags, started, generation));
+  memcached_near_cache_fill(memc,
+                            group_key, group_key ? strlen(group_key) : 0,
+                            key, strlen(key),
+                            value, strlen(value), 0,
+                            MEMCACHED_SUCCESS, started, generation);
+}
+
+test_return_t near_cache_fill_after_invalidate_test(void*)
+{
+  memcached_st *memc= create_near_cached();
+  test_true(memc);
+
+  // A get misses, a set of the key lands, then the get's older reply arrives
+  size_t value_length;
+  uint32_t flags;
+  uint64_t started, generation;
+  test_null(memcached_near_cache_get(memc, NULL, 0, test_literal_param("foo"),
+                                     &value_length, &flags, started, generation));
+  memcached_near_cache_invalidate(memc, NULL, 0, test_literal_param("foo"), 0);
+  memcached_near_cache_fill(memc, NULL, 0, test_literal_param("foo"),
+                            test_literal_param("old"), 0,
+                            MEMCACHED_SUCCESS, started, generation);
+  test_false(near_cache_has(memc, NULL, "foo", "old"));
+
+  // The next get caches what the server has now
+  near_cache_read(memc, NULL, "foo", "new");
+  test_true(near_cache_has(memc, NULL, "foo", "new"));
+
+  memcached_free(memc);
+
+  return TEST_SUCCESS;
+}
+
+test_return_t near_cache_fill_after_flush_test(void*)
+{
+  memcached_st *memc= create_near_cached();
+  test_true(memc);
+
+  size_t value_length;
+  uint32_t flags;
+  uint64_t started, generation;
+  test_null(memcached_near_cache_get(memc, NULL, 0, test_literal_param("foo"),
+                                     &value_length, &flags, started, generation));
+  memcached_near_cache_flush(memc);
+  memcached_near_cache_fill(memc, NULL, 0, test_literal_param("foo"),
+                            test_literal_param("old"), 0,
+                            MEMCACHED_SUCCESS, started, generation);
+  test_false(near_cache_has(memc, NULL, "foo", "old"));
+
+  memcached_free(memc);
+
+  return TEST_SUCCESS;
+}
+
+test_return_t near_cache_expiration_cap_test(void*)
+{
+  memcached_st *memc= create_near_cached();
+  test_true(memc);
+
+  // Writes with an expiration must not take up any of the budget
+  for (uint32_t x= 0; x < 1024; x++)
+  {
+    char key[MEMCACHED_MAX_KEY];
+    int key_length= snprintf(key, sizeof(key), "key%u", x);
+    memcached_near_cache_invalidate(memc, NULL, 0, key, size_t(key_length), 30);
+  }
+  memcached_near_cache_stat_st stat;
+  test_compare(MEMCACHED_SUCCESS, memcached_near_cache_stat(memc, &stat));
+  test_zero(stat.items);
+  test_zero(stat.bytes);
+
+  // An item that has already expired on the server is never cached
+  memcached_near_cache_invalidate(memc, NULL, 0, test_literal_param("foo"), -1);
+  near_cache_read(memc, NULL, "foo", "bar");
+  test_false(near_cache_has(memc, NULL, "foo", "bar"));
+
+  memcached_free(memc);
+
+  return TEST_SUCCESS;
+}
+
+test_return_t near_cache_main_budget_test(void*)
+{
+  memcached_st *memc= create_near_cached();
+  test_true(memc);
+
+  // Most of these are pushed out of the window into the main space
+  for (uint32_t x= 0; x < 50; x++)
+  {
+    char key[MEMCACHED_MAX_KEY];
+    snprintf(key, sizeof(key), "key%u", x);
+    near_cache_read(memc, NULL, key, "small value");
+  }
+
+  memcached_near_cache_stat_st stat;
+  test_compare(MEMCACHED_SUCCESS, memcached_near_cache_stat(memc, &stat));
+  test_zero(stat.evictions);
+
+  // Growing an entry of the main space past the budget evicts from it
+  std::string value(60 * 1024, 'x');
+  near_cache_read(memc, NULL, "key0", value.c_str());
+  test_compare(MEMCACHED_SUCCESS, memcached_near_cache_stat(memc, &stat));
+  test_true(stat.evictions);
+  test_true(stat.bytes <= stat.byte_budget);
+
+  memcached_free(memc);
+
+  return TEST_SUCCESS;
+}
+
+test_return_t near_cache_group_key_test(void*)
+{
+  memcached_st *memc= create_near_cached();
+  test_true(memc);
+
+  near_cache_read(memc, "one", "foo", "bar");
+  test_true(near_cache_has(memc, "one", "foo", "bar"));
+  test_false(near_cache_has(memc, "two", "foo", "bar"));
+  test_false(near_cache_has(memc, NULL, "foo", "bar"));
+
+  // A master key equal to the key is the same item as no master key
+  near_cache_read(memc, "foo", "foo", "baz");
+  test_true(near_cache_has(memc, NULL, "foo", "baz"));
+
+  // Invalidating through one master key leaves the other alone
+  near_cache_read(memc, "two", "foo", "qux");
+  memcached_near_cache_invalidate(memc, test_literal_param("one"), test_literal_param("foo"), 0);
+  test_false(near_cache_has(memc, "one", "foo", "bar"));
+  test_true(near_cache_has(memc, "two", "foo", "qux"));
+
+  memcached_free(memc);
+
+  return TEST_SUCCESS;
+}
@@ -41,6 +41,7 @@
   C++ interface test
 */
 #include <libmemcached-1.0/memcached.hpp>
+#include <libmemcached-1.0/awaitable.hpp>
 #include <libtest/test.hpp>
 
 #include <cstdio>
@@ -54,6 +55,8 @@
 
 #include <string>
 #include <iostream>
+#include <new>
+#include <stdexcept>
 
 using namespace std;
 using namespace memcache;
@@ -252,6 +255,434 @@ static test_return_t error_memcached_return_t_test(memcached_st *)
   return TEST_SUCCESS;
 }
 
+#define AWAITABLE_BENCH_KEYS 1024
+
+static void make_bench_keys(vector<string>& keys)
+{
+  keys.clear();
+  for (uint32_t x= 0; x < AWAITABLE_BENCH_KEYS; x++)
+  {
+    char buffer[32];
+    int length= snprintf(buffer, sizeof(buffer), "awaitable_%u", x);
+    keys.push_back(string(buffer, length));
+  }
+}
+
+#if defined(LIBMEMCACHED_HAVE_AWAITABLE)
+static memcache::Detached awaitable_get_task(BatchMemcache& memc, string key, size_t& found)
+{
+  Value value= co_await memc.get(key);
+  if (value and value.view() == key)
+  {
+    found++;
+  }
+}
+
+static memcache::Detached awaitable_mget_task(BatchMemcache& memc, vector<string_view> keys, vector<Value>& values)
+{
+  values= co_await memc.mget(keys);
+}
+#endif
+
+static test_return_t awaitable_get_test(memcached_st *original)
+{
+#if defined(LIBMEMCACHED_HAVE_AWAITABLE)
+  Memcache memc(original);
+  BatchMemcache batch(original);
+
+  vector<char> value;
+  populate_vector(value, "fudge");
+  test_true(memc.set("fudge", value, 0, 0));
+  populate_vector(value, "food");
+  test_true(memc.set("food", value, 0, 0));
+  memc.remove("son");
+
+  size_t found= 0;
+  awaitable_get_task(batch, "fudge", found);
+  awaitable_get_task(batch, "food", found);
+  awaitable_get_task(batch, "fudge", found);
+  awaitable_get_task(batch, "son", found);
+  test_compare(size_t(4), batch.pending());
+  test_zero(found);
+
+  test_compare(MEMCACHED_SUCCESS, batch.run());
+  test_zero(batch.pending());
+  test_compare(size_t(3), found);
+
+  return TEST_SUCCESS;
+#else
+  (void)original;
+  return TEST_SKIPPED;
+#endif
+}
+
+static test_return_t awaitable_configuration_test(memcached_st *)
+{
+#if defined(LIBMEMCACHED_HAVE_AWAITABLE)
+  try
+  {
+    BatchMemcache batch("--SERVER=localhost --NOT-AN-OPTION");
+  }
+  catch (const std::invalid_argument&)
+  {
+    return TEST_SUCCESS;
+  }
+
+  return TEST_FAILURE;
+#else
+  return TEST_SKIPPED;
+#endif
+}
+
+static test_return_t awaitable_mget_test(memcached_st *original)
+{
+#if defined(LIBMEMCACHED_HAVE_AWAITABLE)
+  Memcache memc(original);
+  BatchMemcache batch(original);
+
+  test_true(memc.flush());
+  vector<char> value;
+  populate_vector(value, "fudge");
+  test_true(memc.set("fudge", value, 0, 7));
+
+  vector<string_view> keys;
+  keys.push_back("son");
+  keys.push_back("fudge");
+
+  vector<Value> values;
+  awaitable_mget_task(batch, keys, values);
+  test_compare(MEMCACHED_SUCCESS, batch.run());
+
+  test_compare(size_t(2), values.size());
+  test_false(values[0]);
+  test_compare(MEMCACHED_NOTFOUND, values[0].error());
+  test_true(values[1]);
+  test_compare(uint32_t(7), values[1].flags());
+  test_compare(size_t(5), values[1].size());
+  test_memcmp("fudge", values[1].data(), 5);
+
+  return TEST_SUCCESS;
+#else
+  (void)original;
+  return TEST_SKIPPED;
+#endif
+}
+
+static test_return_t populate_bench(memcached_st *original)
+{
+  Memcache memc(original);
+  vector<string> keys;
+  make_bench_keys(keys);
+
+  for (vector<string>::iterator it= keys.begin(); it != keys.end(); ++it)
+  {
+    vector<char> value;
+    populate_vector(value, *it);
+    test_true(memc.set(*it, value, 0, 0));
+  }
+
+  return TEST_SUCCESS;
+}
+
+static test_return_t blocking_get_bench(memcached_st *original)
+{
+  Memcache memc(original);
+  vector<string> keys;
+  make_bench_keys(keys);
+
+  size_t found= 0;
+  for (vector<string>::iterator it= keys.begin(); it != keys.end(); ++it)
+  {
+    vector<char> value;
+    if (memc.get(*it, value))
+    {
+      found++;
+    }
+  }
+  test_compare(keys.size(), found);
+
+  return TEST_SUCCESS;
+}
+
+static test_return_t awaitable_get_bench(memcached_st *original)
+{
+#if defined(LIBMEMCACHED_HAVE_AWAITABLE)
+  vector<string> keys;
+  make_bench_keys(keys);
+
+  BatchMemcache batch(original);
+  size_t found= 0;
+  for (vector<string>::iterator it= keys.begin(); it != keys.end(); ++it)
+  {
+    awaitable_get_task(batch, *it, found);
+  }
+  test_compare(keys.size(), batch.pending());
+  test_compare(MEMCACHED_SUCCESS, batch.run());
+  test_compare(keys.size(), found);
+
+  return TEST_SUCCESS;
+#else
+  (void)original;
+  return TEST_SKIPPED;
+#endif
+}
+
+/*
+  Allocations made while counting is enabled, through either operator new
+  or the memcached_st allocators.
+*/
+static bool count_allocations= false;
+static size_t allocation_count= 0;
+
+/*
+  The replacements below pair operator new with free(). GCC 11+ flags that
+  as -Wmismatched-new-delete once the operators are inlined, but it is the
+  documented way to replace them, and both sides are ours.
+*/
+#if defined(__GNUC__) && !defined(__clang__) && __GNUC__ >= 11
+# pragma GCC diagnostic push
+# pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+
+void *operator new(size_t size)
+{
+  if (count_allocations)
+  {
+    allocation_count++;
+  }
+
+  void *ptr= malloc(size ? size : 1);
+  if (ptr == NULL)
+  {
+    throw std::bad_alloc();
+  }
+
+  return ptr;
+}
+
+void operator delete(void *ptr) noexcept
+{
+  free(ptr);
+}
+
+void operator delete(void *ptr, size_t) noexcept
+{
+  free(ptr);
+}
+
+#if defined(__GNUC__) && !defined(__clang__) && __GNUC__ >= 11
+# pragma GCC diagnostic pop
+#endif
+
+static void *counting_malloc(const memcached_st *, const size_t size, void *)
+{
+  if (count_allocations)
+  {
+    allocation_count++;
+  }
+  return malloc(size);
+}
+
+static void *counting_realloc(const memcached_st *, void *mem, const size_t size, void *)
+{
+  if (count_allocations)
+  {
+    allocation_count++;
+  }
+  return realloc(mem, size);
+}
+
+static void *counting_calloc(const memcached_st *, size_t nelem, const size_t size, void *)
+{
+  if (count_allocations)
+  {
+    allocation_count++;
+  }
+  return calloc(nelem, size);
+}
+
+static void counting_free(const memcached_st *, void *mem, void *)
+{
+  free(mem);
+}
+
+#define ZERO_COPY_KEYS 64
+#define ZERO_COPY_ROUNDS 16
+
+static test_return_t zero_copy_get_test(memcached_st *original)
+{
+#if defined(LIBMEMCACHED_HAVE_STRING_VIEW)
+  Memcache memc(original);
+
+  string_view key("zero_copy");
+  test_true(memc.set(key, string_view("fudge"), 0, 7));
+
+  Value value= memc.get(key);
+  test_true(value);
+  test_compare(MEMCACHED_SUCCESS, value.error());
+  test_true(value.key() == key);
+  test_true(value.view() == "fudge");
+  test_compare(size_t(5), value.size());
+  test_zero(value.data()[5]);
+  test_compare(uint32_t(7), value.flags());
+
+  memc.remove("son");
+  Value miss= memc.getByKey("son", "son");
+  test_false(miss);
+  test_compare(MEMCACHED_NOTFOUND, miss.error());
+  test_true(miss.key() == "son");
+  test_true(miss.data());
+  test_zero(miss.data()[0]);
+
+  test_true(memc.set(key, string_view(), 0, 0));
+  value= memc.get(key);
+  test_true(value);
+  test_zero(value.size());
+  test_true(value.data());
+  test_zero(value.data()[0]);
+
+#if defined(LIBMEMCACHED_HAVE_SPAN)
+  const std::byte binary[]= { std::byte(0), std::byte(1), std::byte(2) };
+  test_true(memc.set(key, std::span<const std::byte>(binary), 0, 0));
+  value= memc.get(key);
+  test_compare(sizeof(binary), value.bytes().size());
+  test_true(value.bytes()[2] == std::byte(2));
+#endif
+
+  return TEST_SUCCESS;
+#else
+  (void)original;
+  return TEST_SKIPPED;
+#endif
+}
+
+static test_return_t zero_copy_mget_test(memcached_st *original)
+{
+#if defined(LIBMEMCACHED_HAVE_STRING_VIEW)
+  Memcache memc(original);
+
+  test_true(memc.set(string_view("fudge"), string_view("fudge"), 0, 0));
+  test_true(memc.set(string_view("food"), string_view("food"), 0, 0));
+
+  KeyBatch keys;
+  keys.push_back("fudge");
+  keys.push_back("son");
+  keys.push_back("food");
+  test_compare(size_t(3), keys.size());
+
+  // The same batch is sent twice
+  for (uint32_t x= 0; x < 2; x++)
+  {
+    test_true(memc.mget(keys));
+
+    size_t found= 0;
+    Value value;
+    while (memc.fetch(value) == MEMCACHED_SUCCESS)
+    {
+      test_true(value.key() == value.view());
+      found++;
+    }
+    test_compare(size_t(2), found);
+    test_false(value);
+  }
+
+  keys.clear();
+  test_false(memc.mget(keys));
+
+  return TEST_SUCCESS;
+#else
+  (void)original;
+  return TEST_SKIPPED;
+#endif
+}
+
+static test_return_t zero_copy_allocation_test(memcached_st *original)
+{
+#if defined(LIBMEMCACHED_HAVE_STRING_VIEW)
+  memcached_st *counted= memcached_clone(NULL, original);
+  test_true(counted);
+  test_compare(MEMCACHED_SUCCESS,
+               memcached_set_memory_allocators(counted, counting_malloc, counting_free,
+                                               counting_realloc, counting_calloc, NULL));
+  Memcache memc(counted);
+  memcached_free(counted);
+
+  vector<string> strings;
+  for (uint32_t x= 0; x < ZERO_COPY_KEYS; x++)
+  {
+    char buffer[32];
+    int length= snprintf(buffer, sizeof(buffer), "zero_copy_%u", x);
+    strings.push_back(string(buffer, length));
+    test_true(memc.set(strings.back(), strings.back(), 0, 0));
+  }
+
+  size_t found= 0;
+  count_allocations= true;
+  allocation_count= 0;
+  for (uint32_t round= 0; round < ZERO_COPY_ROUNDS; round++)
+  {
+    test_true(memc.mget(strings));
+
+    string key;
+    vector<char> value;
+    while (memc.fetch(key, value) == MEMCACHED_SUCCESS)
+    {
+      found++;
+      value.clear();
+    }
+  }
+  size_t copied= allocation_count;
+
+  KeyBatch keys;
+  keys.reserve(strings.size());
+  for (vector<string>::iterator it= strings.begin(); it != strings.end(); ++it)
+  {
+    keys.push_back(*it);
+  }
+
+  allocation_count= 0;
+  for (uint32_t round= 0; round < ZERO_COPY_ROUNDS; round++)
+  {
+    test_true(memc.mget(keys));
+
+    Value value;
+    while (memc.fetch(value) == MEMCACHED_SUCCESS)
+    {
+      found++;
+    }
+  }
+  size_t adopted= allocation_count;
+  count_allocations= false;
+
+  test_compare(size_t(ZERO_COPY_KEYS * ZERO_COPY_ROUNDS * 2), found);
+  Out << "allocations per value, copied: " << double(copied) / (ZERO_COPY_KEYS * ZERO_COPY_ROUNDS)
+    << " adopted: " << double(adopted) / (ZERO_COPY_KEYS * ZERO_COPY_ROUNDS);
+  test_true(adopted < copied);
+
+  return TEST_SUCCESS;
+#else
+  (void)original;
+  return TEST_SKIPPED;
+#endif
+}
+
+test_st zero_copy_tests[] ={
+  { "get", true, reinterpret_cast<test_callback_fn*>(zero_copy_get_test) },
+  { "mget", true, reinterpret_cast<test_callback_fn*>(zero_copy_mget_test) },
+  { "allocations", true, reinterpret_cast<test_callback_fn*>(zero_copy_allocation_test) },
+  {0, 0, 0}
+};
+
+test_st awaitable_tests[] ={
+  { "get", true, reinterpret_cast<test_callback_fn*>(awaitable_get_test) },
+  { "mget", true, reinterpret_cast<test_callback_fn*>(awaitable_mget_test) },
+  { "bad configuration", false, reinterpret_cast<test_callback_fn*>(awaitable_configuration_test) },
+  { "populate x1024", true, reinterpret_cast<test_callback_fn*>(populate_bench) },
+  { "blocking get x1024", false, reinterpret_cast<test_callback_fn*>(blocking_get_bench) },
+  { "awaitable get x1024", false, reinterpret_cast<test_callback_fn*>(awaitable_get_bench) },
+  {0, 0, 0}
+};
+
 test_st error_tests[] ={
   { "error()", false, reinterpret_cast<test_callback_fn*>(error_test) },
   { "error(std::string&)", false, reinterpret_cast<test_callback_fn*>(error_std_string_test) },
@@ -276,6 +707,8 @@ test_st tests[] ={
 collection_st collection[] ={
   {"block", 0, 0, tests},
   {"error()", 0, 0, error_tests},
+  {"awaitable", 0, 0, awaitable_tests},
+  {"zero copy", 0, 0, zero_copy_tests},
   {0, 0, 0, 0}
 };
 
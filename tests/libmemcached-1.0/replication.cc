@@ -45,6 +45,8 @@ using namespace libtest;
 #include <tests/replication.h>
 #include <tests/debug.h>
 
+#include <vector>
+
 #include "tests/libmemcached-1.0/setup_and_teardowns.h"
 
 test_return_t check_replication_sanity_TEST(memcached_st *memc)
@@ -437,3 +439,204 @@ test_return_t replication_miss_test(memcached_st *memc)
 
   return TEST_SUCCESS;
 }
+
+test_return_t replication_acks_TEST(memcached_st *memc)
+{
+  const uint32_t replicas= uint32_t(memcached_behavior_get(memc, MEMCACHED_BEHAVIOR_NUMBER_OF_REPLICAS));
+  test_true(replicas > 0);
+  memcached_replication_stat_reset(memc);
+
+  test_compare(MEMCACHED_SUCCESS,
+               memcached_set(memc, test_literal_param(__func__), test_literal_param("acknowledged"), 0, 0));
+
+  std::vector<memcached_return_t> results(replicas);
+  test_compare(replicas, memcached_replica_acks(memc, &results[0], replicas));
+  for (uint32_t x= 0; x < replicas; x++)
+  {
+    test_compare(MEMCACHED_SUCCESS, results[x]);
+  }
+
+  memcached_replication_stat_st stat;
+  test_compare(MEMCACHED_SUCCESS, memcached_replication_stat(memc, &stat));
+  test_compare(uint64_t(1), stat.writes);
+  test_compare(uint64_t(replicas), stat.replica_acks);
+  test_zero(stat.replica_failures);
+
+  // Every copy has been answered, so every server has it without a memcached_quit()
+  memcached_st *memc_single= memcached_clone(NULL, memc);
+  test_true(memc_single);
+  test_compare(MEMCACHED_SUCCESS, memcached_behavior_set(memc_single, MEMCACHED_BEHAVIOR_NUMBER_OF_REPLICAS, 0));
+
+  for (uint32_t host= 0; host < memcached_server_count(memc); host++)
+  {
+    memcached_server_instance_st instance= memcached_server_instance_by_position(memc_single, host);
+    memcached_return_t rc;
+    size_t value_length;
+    uint32_t flags;
+    char *value= NULL;
+    for (uint32_t x= 0; x < 1000 and value == NULL; ++x)
+    {
+      char key[16];
+      int key_length= snprintf(key, sizeof(key), "master_%u", x);
+      if (memcached_server_by_key(memc_single, key, size_t(key_length), &rc) == instance)
+      {
+        value= memcached_get_by_key(memc_single, key, size_t(key_length), test_literal_param(__func__),
+                                    &value_length, &flags, &rc);
+        test_compare(MEMCACHED_SUCCESS, rc);
+      }
+    }
+    test_true(value);
+    test_compare(value_length, strlen("acknowledged"));
+    test_memcmp(value, "acknowledged", value_length);
+    free(value);
+  }
+  memcached_free(memc_single);
+
+  return TEST_SUCCESS;
+}
+
+test_return_t replication_acks_buffered_TEST(memcached_st *memc)
+{
+  const uint32_t replicas= uint32_t(memcached_behavior_get(memc, MEMCACHED_BEHAVIOR_NUMBER_OF_REPLICAS));
+  memcached_st *memc_clone= memcached_clone(NULL, memc);
+  test_true(memc_clone);
+  test_compare(MEMCACHED_SUCCESS, memcached_behavior_set(memc_clone, MEMCACHED_BEHAVIOR_BUFFER_REQUESTS, true));
+
+  test_compare(MEMCACHED_BUFFERED,
+               memcached_set(memc_clone, test_literal_param(__func__), test_literal_param("quiet"), 0, 0));
+
+  // The copies were sent quietly, nothing is known about them
+  std::vector<memcached_return_t> results(replicas);
+  test_zero(memcached_replica_acks(memc_clone, &results[0], replicas));
+  for (uint32_t x= 0; x < replicas; x++)
+  {
+    test_compare(MEMCACHED_BUFFERED, results[x]);
+  }
+
+  memcached_replication_stat_st stat;
+  test_compare(MEMCACHED_SUCCESS, memcached_replication_stat(memc_clone, &stat));
+  test_zero(stat.writes);
+
+  memcached_free(memc_clone);
+
+  return TEST_SUCCESS;
+}
+
+test_return_t replication_hedged_read_behavior_TEST(memcached_st *memc)
+{
+  memcached_st *memc_clone= memcached_clone(NULL, memc);
+  test_true(memc_clone);
+
+  test_zero(memcached_behavior_get(memc_clone, MEMCACHED_BEHAVIOR_HEDGED_READ_PERCENTILE));
+  test_compare(uint64_t(MEMCACHED_DEFAULT_HEDGED_READ_DELAY),
+               memcached_behavior_get(memc_clone, MEMCACHED_BEHAVIOR_HEDGED_READ_DELAY));
+
+  test_compare(MEMCACHED_INVALID_ARGUMENTS,
+               memcached_behavior_set(memc_clone, MEMCACHED_BEHAVIOR_HEDGED_READ_PERCENTILE, 101));
+  test_compare(MEMCACHED_SUCCESS,
+               memcached_behavior_set(memc_clone, MEMCACHED_BEHAVIOR_HEDGED_READ_PERCENTILE, 95));
+  test_compare(MEMCACHED_SUCCESS,
+               memcached_behavior_set(memc_clone, MEMCACHED_BEHAVIOR_HEDGED_READ_DELAY, 500));
+
+  memcached_st *memc_copy= memcached_clone(NULL, memc_clone);
+  test_true(memc_copy);
+  test_compare(uint64_t(95), memcached_behavior_get(memc_copy, MEMCACHED_BEHAVIOR_HEDGED_READ_PERCENTILE));
+  test_compare(uint64_t(500), memcached_behavior_get(memc_copy, MEMCACHED_BEHAVIOR_HEDGED_READ_DELAY));
+
+  memcached_free(memc_copy);
+  memcached_free(memc_clone);
+
+  return TEST_SUCCESS;
+}
+
+test_return_t replication_hedged_read_TEST(memcached_st *memc)
+{
+  memcached_st *memc_clone= memcached_clone(NULL, memc);
+  test_true(memc_clone);
+  test_compare(MEMCACHED_SUCCESS, memcached_behavior_set(memc_clone, MEMCACHED_BEHAVIOR_RANDOMIZE_REPLICA_READ, false));
+
+  // No delay at all, every get is raced against the next replica
+  test_compare(MEMCACHED_SUCCESS, memcached_behavior_set(memc_clone, MEMCACHED_BEHAVIOR_HEDGED_READ_PERCENTILE, 50));
+  test_compare(MEMCACHED_SUCCESS, memcached_behavior_set(memc_clone, MEMCACHED_BEHAVIOR_HEDGED_READ_DELAY, 0));
+
+  for (uint32_t x= 0; x < 100; x++)
+  {
+    char key[32];
+    int key_length= snprintf(key, sizeof(key), "hedged_%u", x);
+    test_compare(MEMCACHED_SUCCESS,
+                 memcached_set(memc_clone, key, size_t(key_length), key, size_t(key_length), 0, 0));
+
+    size_t value_length;
+    uint32_t flags;
+    memcached_return_t rc;
+    char *value= memcached_get(memc_clone, key, size_t(key_length), &value_length, &flags, &rc);
+    test_compare(MEMCACHED_SUCCESS, rc);
+    test_compare(size_t(key_length), value_length);
+    test_memcmp(key, value, value_length);
+    free(value);
+
+    // The reply that lost the race must not be taken for the answer to this
+    test_compare(MEMCACHED_SUCCESS,
+                 memcached_set(memc_clone, key, size_t(key_length), test_literal_param("changed"), 0, 0));
+    value= memcached_get(memc_clone, key, size_t(key_length), &value_length, &flags, &rc);
+    test_compare(MEMCACHED_SUCCESS, rc);
+    test_compare(strlen("changed"), value_length);
+    test_memcmp("changed", value, value_length);
+    free(value);
+  }
+
+  memcached_replication_stat_st stat;
+  test_compare(MEMCACHED_SUCCESS, memcached_replication_stat(memc_clone, &stat));
+  test_true(stat.hedged > 0);
+  test_true(stat.hedge_wins <= stat.hedged);
+
+  memcached_free(memc_clone);
+
+  return TEST_SUCCESS;
+}
+
+/* A replica still answers a hedged get for a key that its first server lost */
+test_return_t replication_hedged_read_miss_TEST(memcached_st *memc)
+{
+  memcached_st *memc_clone= memcached_clone(NULL, memc);
+  test_true(memc_clone);
+  test_compare(MEMCACHED_SUCCESS, memcached_behavior_set(memc_clone, MEMCACHED_BEHAVIOR_RANDOMIZE_REPLICA_READ, false));
+  test_compare(MEMCACHED_SUCCESS, memcached_behavior_set(memc_clone, MEMCACHED_BEHAVIOR_HEDGED_READ_PERCENTILE, 99));
+  test_compare(MEMCACHED_SUCCESS, memcached_behavior_set(memc_clone, MEMCACHED_BEHAVIOR_HEDGED_READ_DELAY, 0));
+
+  memcached_st *memc_single= memcached_clone(NULL, memc);
+  test_true(memc_single);
+  test_compare(MEMCACHED_SUCCESS, memcached_behavior_set(memc_single, MEMCACHED_BEHAVIOR_NUMBER_OF_REPLICAS, 0));
+
+  test_compare(MEMCACHED_SUCCESS,
+               memcached_set(memc_clone, test_literal_param(__func__), test_literal_param("replica"), 0, 0));
+  test_compare(MEMCACHED_SUCCESS, memcached_delete(memc_single, test_literal_param(__func__), 0));
+
+  // The first server can answer before the replica is asked, so try a few times
+  bool hedged= false;
+  for (uint32_t attempt= 0; attempt < 100 and hedged == false; attempt++)
+  {
+    memcached_replication_stat_reset(memc_clone);
+
+    size_t value_length;
+    uint32_t flags;
+    memcached_return_t rc;
+    char *value= memcached_get(memc_clone, test_literal_param(__func__), &value_length, &flags, &rc);
+
+    memcached_replication_stat_st stat;
+    test_compare(MEMCACHED_SUCCESS, memcached_replication_stat(memc_clone, &stat));
+    if ((hedged= stat.hedged))
+    {
+      test_compare(MEMCACHED_SUCCESS, rc);
+      test_compare(strlen("replica"), value_length);
+      test_memcmp("replica", value, value_length);
+    }
+    free(value);
+  }
+  test_true(hedged);
+
+  memcached_free(memc_single);
+  memcached_free(memc_clone);
+
+  return TEST_SUCCESS;
+}
@@ -69,6 +69,18 @@ test_return_t pre_binary(memcached_st *memc)
   return TEST_SUCCESS;
 }
 
+/**
+  @note The meta commands arrived in 1.6, older servers answer them with ERROR.
+*/
+test_return_t pre_meta(memcached_st *memc)
+{
+  test_true(memcached_server_count(memc) > 0);
+  test_skip(true, libmemcached_util_version_check(memc, 1, 6, 0));
+  test_skip(MEMCACHED_SUCCESS, memcached_behavior_set(memc, MEMCACHED_BEHAVIOR_META_PROTOCOL, true));
+
+  return TEST_SUCCESS;
+}
+
 test_return_t pre_buffer(memcached_st *memc)
 {
   test_skip(MEMCACHED_SUCCESS, memcached_behavior_set(memc, MEMCACHED_BEHAVIOR_BUFFER_REQUESTS, true));
@@ -42,6 +42,7 @@ memcached_return_t return_value_based_on_buffering(memcached_st*);
 test_return_t pre_behavior_ketama(memcached_st*);
 test_return_t pre_behavior_ketama_weighted(memcached_st*);
 test_return_t pre_binary(memcached_st*);
+test_return_t pre_meta(memcached_st*);
 test_return_t pre_cork(memcached_st*);
 test_return_t pre_cork_and_nonblock(memcached_st*);
 test_return_t pre_crc(memcached_st*);
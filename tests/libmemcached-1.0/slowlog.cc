@@ -0,0 +1,221 @@
+/*  vim:expandtab:shiftwidth=2:tabstop=2:smarttab:
+ * 
+ *  Libmemcached library
+ *
+ *  Copyright (C) 2011-2012 Data Differential, http://datadifferential.com/
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are
+ *  met:
+ *
+ *      * Redistributions of source code must retain the above copyright
+ *  notice, this list of conditions and the following disclaimer.
+ *
+ *      * Redistributions in binary form must reproduce the above
+ *  copyright notice, this list of conditions and the following disclaimer
+ *  in the documentation and/or other materials provided with the
+ *  distribution.
+ *
+ *      * The names of its contributors may not be used to endorse or
+ *  promote products derived from this software without specific prior
+ *  written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *  A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *  OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *  SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *  LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *  DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *  THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *  OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+#include <config.h>
+#include <libtest/test.hpp>
+
+using namespace libtest;
+
+#include <libmemcached-1.0/memcached.h>
+
+#include <cstdio>
+#include <cstring>
+
+#include "tests/libmemcached-1.0/slowlog.h"
+
+test_return_t slowlog_create_TEST(memcached_st *original)
+{
+  memcached_st *memc= memcached_clone(NULL, original);
+  test_true(memc);
+
+  memcached_slowlog_entry_st entry;
+  test_zero(memcached_slowlog_read(memc, &entry, 1));
+
+  test_compare(MEMCACHED_INVALID_ARGUMENTS, memcached_slowlog_create(memc, 0, 0));
+  test_compare(MEMCACHED_INVALID_ARGUMENTS, memcached_slowlog_create(memc, 0, (1U << 20) +1));
+  test_compare(MEMCACHED_SUCCESS, memcached_slowlog_create(memc, 0, 3));
+  test_zero(memcached_slowlog_read(memc, &entry, 1));
+
+  // Creating it again starts an empty log
+  test_compare(MEMCACHED_SUCCESS,
+               memcached_set(memc, test_literal_param("slowlog_create"), test_literal_param("value"), 0, 0));
+  test_compare(size_t(1), memcached_slowlog_read(memc, &entry, 1));
+  test_compare(MEMCACHED_SUCCESS, memcached_slowlog_create(memc, 0, 3));
+  test_zero(memcached_slowlog_read(memc, &entry, 1));
+
+  memcached_slowlog_free(memc);
+  test_zero(memcached_slowlog_read(memc, &entry, 1));
+
+  test_compare(0, strcmp("wait", memcached_slowlog_phase_string(MEMCACHED_SLOWLOG_PHASE_WAIT)));
+  test_compare(0, strcmp("config poll", memcached_slowlog_phase_string(MEMCACHED_SLOWLOG_PHASE_CONFIG_POLL)));
+  test_compare(0, strcmp("unknown", memcached_slowlog_phase_string(MEMCACHED_SLOWLOG_PHASE_MAX)));
+
+  memcached_free(memc);
+
+  return TEST_SUCCESS;
+}
+
+test_return_t slowlog_entries_TEST(memcached_st *original)
+{
+  memcached_st *memc= memcached_clone(NULL, original);
+  test_true(memc);
+
+  test_compare(MEMCACHED_SUCCESS, memcached_slowlog_create(memc, 0, 16));
+
+  // Make the first request pay for the connect
+  memcached_quit(memc);
+
+  test_compare(MEMCACHED_SUCCESS,
+               memcached_set(memc, test_literal_param("slowlog_entries"), test_literal_param("value"), 0, 0));
+
+  size_t value_length;
+  uint32_t flags;
+  memcached_return_t rc;
+  char *value= memcached_get(memc, test_literal_param("slowlog_entries"), &value_length, &flags, &rc);
+  test_compare(MEMCACHED_SUCCESS, rc);
+  test_true(value);
+  free(value);
+
+  test_compare(MEMCACHED_SUCCESS,
+               memcached_delete(memc, test_literal_param("slowlog_entries"), 0));
+
+  memcached_slowlog_entry_st entries[4];
+  test_compare(size_t(3), memcached_slowlog_read(memc, entries, 4));
+
+  test_compare(MEMCACHED_TELEMETRY_OP_SET, entries[0].op);
+  test_compare(MEMCACHED_TELEMETRY_OP_GET, entries[1].op);
+  test_compare(MEMCACHED_TELEMETRY_OP_DELETE, entries[2].op);
+  test_compare(size_t(5), entries[0].value_length);
+  test_compare(size_t(5), entries[1].value_length);
+
+  test_true(entries[0].phase_usec[MEMCACHED_SLOWLOG_PHASE_CONNECT]);
+
+  for (uint32_t x= 0; x < 3; x++)
+  {
+    test_compare(uint64_t(x), entries[x].sequence);
+    test_compare(MEMCACHED_SUCCESS, entries[x].rc);
+    test_compare(size_t(15), entries[x].key_length);
+    test_compare(size_t(1), entries[x].number_of_keys);
+    test_true(entries[x].logged_at);
+
+    uint32_t server_key= memcached_generate_hash(memc, test_literal_param("slowlog_entries"));
+    memcached_server_instance_st server= memcached_server_instance_by_position(memc, server_key);
+    test_compare(0, strcmp(memcached_server_name(server), entries[x].hostname));
+    test_compare(memcached_server_port(server), entries[x].port);
+
+    uint64_t total= 0;
+    for (uint32_t phase= 0; phase < MEMCACHED_SLOWLOG_PHASE_MAX; phase++)
+    {
+      total+= entries[x].phase_usec[phase];
+    }
+    test_compare(entries[x].total_usec, total);
+  }
+
+  memcached_free(memc);
+
+  return TEST_SUCCESS;
+}
+
+test_return_t slowlog_capacity_TEST(memcached_st *original)
+{
+  memcached_st *memc= memcached_clone(NULL, original);
+  test_true(memc);
+
+  test_compare(MEMCACHED_SUCCESS, memcached_slowlog_create(memc, 0, 3));
+
+  char key[32];
+  for (uint32_t x= 0; x < 10; x++)
+  {
+    int key_length= snprintf(key, sizeof(key), "slowlog_%u", x);
+    test_compare(MEMCACHED_SUCCESS,
+                 memcached_set(memc, key, key_length, test_literal_param("value"), 0, 0));
+  }
+
+  // The capacity is rounded up to 4
+  memcached_slowlog_entry_st entries[8];
+  test_compare(size_t(4), memcached_slowlog_read(memc, entries, 8));
+  for (uint32_t x= 0; x < 4; x++)
+  {
+    test_compare(uint64_t(x +6), entries[x].sequence);
+  }
+
+  test_compare(size_t(2), memcached_slowlog_read(memc, entries, 2));
+  test_compare(uint64_t(8), entries[0].sequence);
+  test_compare(uint64_t(9), entries[1].sequence);
+
+  memcached_free(memc);
+
+  return TEST_SUCCESS;
+}
+
+test_return_t slowlog_threshold_TEST(memcached_st *original)
+{
+  memcached_st *memc= memcached_clone(NULL, original);
+  test_true(memc);
+
+  test_compare(MEMCACHED_SUCCESS, memcached_slowlog_create(memc, 60 * 1000 * 1000, 16));
+
+  test_compare(MEMCACHED_SUCCESS,
+               memcached_set(memc, test_literal_param("slowlog_threshold"), test_literal_param("value"), 0, 0));
+  test_compare(MEMCACHED_SUCCESS,
+               memcached_delete(memc, test_literal_param("slowlog_threshold"), 0));
+
+  memcached_slowlog_entry_st entry;
+  test_zero(memcached_slowlog_read(memc, &entry, 1));
+
+  memcached_free(memc);
+
+  return TEST_SUCCESS;
+}
+
+test_return_t slowlog_clone_TEST(memcached_st *original)
+{
+  memcached_st *memc= memcached_clone(NULL, original);
+  test_true(memc);
+
+  test_compare(MEMCACHED_SUCCESS, memcached_slowlog_create(memc, 0, 16));
+
+  memcached_st *clone= memcached_clone(NULL, memc);
+  test_true(clone);
+
+  test_compare(MEMCACHED_SUCCESS,
+               memcached_set(clone, test_literal_param("slowlog_clone"), test_literal_param("value"), 0, 0));
+  test_compare(MEMCACHED_SUCCESS,
+               memcached_set(memc, test_literal_param("slowlog_clone"), test_literal_param("value"), 0, 0));
+
+  memcached_slowlog_entry_st entries[4];
+  test_compare(size_t(2), memcached_slowlog_read(memc, entries, 4));
+  test_compare(size_t(2), memcached_slowlog_read(clone, entries, 4));
+
+  // The log outlives the memcached_st that created it
+  memcached_free(memc);
+  test_compare(size_t(2), memcached_slowlog_read(clone, entries, 4));
+
+  memcached_free(clone);
+
+  return TEST_SUCCESS;
+}
@@ -0,0 +1,310 @@
+/*  vim:expandtab:shiftwidth=2:tabstop=2:smarttab:
+ * 
+ *  Libmemcached library
+ *
+ *  Copyright (C) 2011-2012 Data Differential, http://datadifferential.com/
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are
+ *  met:
+ *
+ *      * Redistributions of source code must retain the above copyright
+ *  notice, this list of conditions and the following disclaimer.
+ *
+ *      * Redistributions in binary form must reproduce the above
+ *  copyright notice, this list of conditions and the following disclaimer
+ *  in the documentation and/or other materials provided with the
+ *  distribution.
+ *
+ *      * The names of its contributors may not be used to endorse or
+ *  promote products derived from this software without specific prior
+ *  written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *  A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *  OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *  SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *  LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *  DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *  THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *  OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+
+#include <config.h>
+#include <libtest/test.hpp>
+
+using namespace libtest;
+
+#include <libmemcached-1.0/memcached.h>
+
+#include <cstdio>
+
+#include "tests/libmemcached-1.0/telemetry.h"
+
+#define TELEMETRY_OPERATIONS 20
+
+static memcached_st *create_telemetry(memcached_st *original)
+{
+  memcached_st *memc= memcached_clone(NULL, original);
+  if (memc == NULL)
+  {
+    return NULL;
+  }
+
+  if (memcached_failed(memcached_behavior_set(memc, MEMCACHED_BEHAVIOR_SERVER_TELEMETRY, true)))
+  {
+    memcached_free(memc);
+    return NULL;
+  }
+
+  return memc;
+}
+
+static uint64_t telemetry_count(const memcached_telemetry_st *telemetry, memcached_telemetry_op_t op)
+{
+  uint64_t count= 0;
+  for (uint32_t x= 0; x < telemetry->number_of_servers; x++)
+  {
+    count+= telemetry->servers[x].latency[op].count;
+  }
+
+  return count;
+}
+
+static bool run_operations(memcached_st *memc)
+{
+  char key[32];
+  for (uint32_t x= 0; x < TELEMETRY_OPERATIONS; x++)
+  {
+    int key_length= snprintf(key, sizeof(key), "telemetry_%u", x);
+    if (memcached_failed(memcached_set(memc, key, key_length, test_literal_param("value"), 0, 0)))
+    {
+      return false;
+    }
+  }
+
+  for (uint32_t x= 0; x < TELEMETRY_OPERATIONS; x++)
+  {
+    int key_length= snprintf(key, sizeof(key), "telemetry_%u", x);
+    size_t value_length;
+    uint32_t flags;
+    memcached_return_t rc;
+    char *value= memcached_get(memc, key, key_length, &value_length, &flags, &rc);
+    if (value == NULL)
+    {
+      return false;
+    }
+    free(value);
+  }
+
+  const char *keys[]= { "telemetry_0", "telemetry_1", "telemetry_2" };
+  size_t key_length[]= { 11, 11, 11 };
+  if (memcached_failed(memcached_mget(memc, keys, key_length, 3)))
+  {
+    return false;
+  }
+
+  memcached_return_t rc;
+  memcached_result_st *result;
+  while ((result= memcached_fetch_result(memc, NULL, &rc)))
+  {
+    memcached_result_free(result);
+  }
+
+  uint64_t counter;
+  if (memcached_failed(memcached_set(memc, test_literal_param("telemetry_counter"), test_literal_param("1"), 0, 0)) or
+      memcached_failed(memcached_increment(memc, test_literal_param("telemetry_counter"), 1, &counter)) or
+      memcached_failed(memcached_delete(memc, test_literal_param("telemetry_counter"), 0)))
+  {
+    return false;
+  }
+
+  return true;
+}
+
+test_return_t telemetry_behavior_TEST(memcached_st *original)
+{
+  memcached_st *memc= memcached_clone(NULL, original);
+  test_true(memc);
+
+  test_zero(memcached_behavior_get(memc, MEMCACHED_BEHAVIOR_SERVER_TELEMETRY));
+
+  memcached_return_t rc= memcached_behavior_set(memc, MEMCACHED_BEHAVIOR_SERVER_TELEMETRY, true);
+  if (LIBMEMCACHED_WITH_TELEMETRY == 0)
+  {
+    test_compare(MEMCACHED_NOT_SUPPORTED, rc);
+    memcached_free(memc);
+    return TEST_SKIPPED;
+  }
+  test_compare(MEMCACHED_SUCCESS, rc);
+  test_compare(uint64_t(1), memcached_behavior_get(memc, MEMCACHED_BEHAVIOR_SERVER_TELEMETRY));
+
+  memcached_st *clone= memcached_clone(NULL, memc);
+  test_true(clone);
+  test_compare(uint64_t(1), memcached_behavior_get(clone, MEMCACHED_BEHAVIOR_SERVER_TELEMETRY));
+  memcached_free(clone);
+
+  test_compare(MEMCACHED_SUCCESS, memcached_behavior_set(memc, MEMCACHED_BEHAVIOR_SERVER_TELEMETRY, false));
+  test_zero(memcached_behavior_get(memc, MEMCACHED_BEHAVIOR_SERVER_TELEMETRY));
+
+  // Nothing is gathered while it is off
+  test_true(run_operations(memc));
+  memcached_telemetry_st *telemetry= memcached_telemetry_snapshot(memc, &rc);
+  test_compare(MEMCACHED_SUCCESS, rc);
+  test_true(telemetry);
+  test_compare(memcached_server_count(memc), telemetry->number_of_servers);
+  for (uint32_t op= 0; op < MEMCACHED_TELEMETRY_OP_MAX; op++)
+  {
+    test_zero(telemetry_count(telemetry, memcached_telemetry_op_t(op)));
+  }
+  memcached_telemetry_free(telemetry);
+
+  memcached_free(memc);
+
+  return TEST_SUCCESS;
+}
+
+test_return_t telemetry_operations_TEST(memcached_st *original)
+{
+  test_skip(1, LIBMEMCACHED_WITH_TELEMETRY);
+
+  memcached_st *memc= create_telemetry(original);
+  test_true(memc);
+
+  // The clone connected before telemetry was on, count the connects again
+  memcached_quit(memc);
+  test_true(run_operations(memc));
+
+  memcached_return_t rc;
+  memcached_telemetry_st *telemetry= memcached_telemetry_snapshot(memc, &rc);
+  test_compare(MEMCACHED_SUCCESS, rc);
+  test_true(telemetry);
+
+  test_compare(uint64_t(TELEMETRY_OPERATIONS +1), telemetry_count(telemetry, MEMCACHED_TELEMETRY_OP_SET));
+  test_compare(uint64_t(TELEMETRY_OPERATIONS), telemetry_count(telemetry, MEMCACHED_TELEMETRY_OP_GET));
+  test_true(telemetry_count(telemetry, MEMCACHED_TELEMETRY_OP_MGET) >= 1);
+  test_compare(uint64_t(1), telemetry_count(telemetry, MEMCACHED_TELEMETRY_OP_INCR));
+  test_compare(uint64_t(1), telemetry_count(telemetry, MEMCACHED_TELEMETRY_OP_DELETE));
+
+  uint64_t bytes_read= 0, bytes_written= 0, connects= 0;
+  for (uint32_t x= 0; x < telemetry->number_of_servers; x++)
+  {
+    const memcached_server_telemetry_st& server= telemetry->servers[x];
+    test_compare(memcached_server_instance_by_position(memc, x)->port, server.port);
+    bytes_read+= server.bytes_read;
+    bytes_written+= server.bytes_written;
+    connects+= server.connects;
+
+    for (uint32_t op= 0; op < MEMCACHED_TELEMETRY_OP_MAX; op++)
+    {
+      const memcached_histogram_st& histogram= server.latency[op];
+      uint64_t buckets= 0;
+      for (uint32_t bucket= 0; bucket < MEMCACHED_HISTOGRAM_BUCKETS; bucket++)
+      {
+        buckets+= histogram.buckets[bucket];
+      }
+      test_compare(histogram.count, buckets);
+      test_true(histogram.total_usec >= histogram.max_usec);
+      test_compare(histogram.max_usec, memcached_histogram_percentile(&histogram, 100));
+      test_true(memcached_histogram_percentile(&histogram, 50) <= histogram.max_usec);
+    }
+  }
+  test_true(bytes_read > 0);
+  test_true(bytes_written > 0);
+  test_true(connects >= 1);
+
+  memcached_telemetry_free(telemetry);
+
+  memcached_telemetry_reset(memc);
+  telemetry= memcached_telemetry_snapshot(memc, &rc);
+  test_true(telemetry);
+  for (uint32_t op= 0; op < MEMCACHED_TELEMETRY_OP_MAX; op++)
+  {
+    test_zero(telemetry_count(telemetry, memcached_telemetry_op_t(op)));
+  }
+  memcached_telemetry_free(telemetry);
+
+  memcached_free(memc);
+
+  return TEST_SUCCESS;
+}
+
+test_return_t telemetry_merge_TEST(memcached_st *original)
+{
+  test_skip(1, LIBMEMCACHED_WITH_TELEMETRY);
+
+  // Two handles of a pool
+  memcached_st *first= create_telemetry(original);
+  test_true(first);
+  memcached_st *second= create_telemetry(original);
+  test_true(second);
+
+  test_true(run_operations(first));
+  test_true(run_operations(second));
+  test_true(run_operations(second));
+
+  memcached_return_t rc;
+  memcached_telemetry_st *total= memcached_telemetry_snapshot(first, &rc);
+  test_true(total);
+  memcached_telemetry_st *other= memcached_telemetry_snapshot(second, &rc);
+  test_true(other);
+
+  test_compare(MEMCACHED_SUCCESS, memcached_telemetry_merge(total, other));
+  test_compare(memcached_server_count(first), total->number_of_servers);
+  test_compare(uint64_t(TELEMETRY_OPERATIONS * 3), telemetry_count(total, MEMCACHED_TELEMETRY_OP_GET));
+  test_compare(uint64_t(3), telemetry_count(total, MEMCACHED_TELEMETRY_OP_DELETE));
+
+  // Servers the destination has not seen are appended
+  memcached_telemetry_st empty= { 0, NULL };
+  test_compare(MEMCACHED_SUCCESS, memcached_telemetry_merge(&empty, other));
+  test_compare(other->number_of_servers, empty.number_of_servers);
+  test_compare(uint64_t(TELEMETRY_OPERATIONS * 2), telemetry_count(&empty, MEMCACHED_TELEMETRY_OP_GET));
+  free(empty.servers);
+
+  test_compare(MEMCACHED_INVALID_ARGUMENTS, memcached_telemetry_merge(NULL, other));
+
+  memcached_telemetry_free(other);
+  memcached_telemetry_free(total);
+  memcached_free(second);
+  memcached_free(first);
+
+  return TEST_SUCCESS;
+}
+
+test_return_t telemetry_percentile_TEST(memcached_st *)
+{
+  memcached_histogram_st histogram;
+  memset(&histogram, 0, sizeof(histogram));
+
+  test_zero(memcached_histogram_percentile(&histogram, 50));
+  test_zero(memcached_histogram_percentile(NULL, 50));
+
+  // 1, 3, 3, 7 and 1000 usec
+  histogram.count= 5;
+  histogram.max_usec= 1000;
+  histogram.buckets[1]= 1;
+  histogram.buckets[3]= 2;
+  histogram.buckets[7]= 1;
+  histogram.buckets[8 + (9 - 3) * 4 + 3]= 1; // 896 to 1023
+
+  test_compare(uint64_t(1), memcached_histogram_percentile(&histogram, 0));
+  test_compare(uint64_t(1), memcached_histogram_percentile(&histogram, 20));
+  test_compare(uint64_t(3), memcached_histogram_percentile(&histogram, 50));
+  test_compare(uint64_t(7), memcached_histogram_percentile(&histogram, 80));
+  test_compare(uint64_t(1000), memcached_histogram_percentile(&histogram, 99));
+  test_compare(uint64_t(1000), memcached_histogram_percentile(&histogram, 100));
+
+  histogram.max_usec= 2000;
+  test_compare(uint64_t(1023), memcached_histogram_percentile(&histogram, 100));
+
+  test_compare(0, strcmp("mget", memcached_telemetry_op_string(MEMCACHED_TELEMETRY_OP_MGET)));
+  test_compare(0, strcmp("config get", memcached_telemetry_op_string(MEMCACHED_TELEMETRY_OP_CONFIG_GET)));
+
+  return TEST_SUCCESS;
+}
@@ -152,5 +152,105 @@ test_return_t test_memcached_touch_by_key(memcached_st *memc)
   return TEST_SUCCESS;
 }
 
+// Binary GAT arrived with touch, the ASCII and meta forms much later
+static test_return_t pre_gat(memcached_st *memc)
+{
+  test_skip(TEST_SUCCESS, pre_touch(memc));
+
+  if (memcached_behavior_get(memc, MEMCACHED_BEHAVIOR_META_PROTOCOL))
+  {
+    test_skip(true, libmemcached_util_version_check(memc, 1, 6, 0));
+  }
+  else if (memcached_behavior_get(memc, MEMCACHED_BEHAVIOR_BINARY_PROTOCOL) == false)
+  {
+    test_skip(true, libmemcached_util_version_check(memc, 1, 5, 3));
+  }
+
+  return TEST_SUCCESS;
+}
+
+test_return_t test_memcached_gat(memcached_st *memc)
+{
+  test_skip(TEST_SUCCESS, pre_gat(memc));
+
+  size_t len;
+  uint32_t flags;
+  memcached_return rc;
 
+  test_null(memcached_gat(memc, test_literal_param(__func__), 60 *60, &len, &flags, &rc));
+  test_zero(len);
+  test_compare(MEMCACHED_NOTFOUND, rc);
+
+  test_compare(MEMCACHED_SUCCESS, 
+               memcached_set(memc,
+                             test_literal_param(__func__),
+                             test_literal_param("touchval"),
+                             2, 7));
 
+  {
+    char *value= memcached_gat(memc, test_literal_param(__func__), 60 *60, &len, &flags, &rc);
+    test_compare(MEMCACHED_SUCCESS, rc);
+    test_true(value);
+    test_compare(test_literal_param_size("touchval"), len);
+    test_memcmp("touchval", value, len);
+    test_compare(7U, flags);
+    free(value);
+  }
+
+  // An expiration more than 30 days out is a point in time, here one long gone
+  test_skip(false ,memcached_behavior_get(memc, MEMCACHED_BEHAVIOR_BINARY_PROTOCOL));
+  {
+    char *value= memcached_gat(memc, test_literal_param(__func__), 60 *60 *24 *60, &len, &flags, &rc);
+    test_compare_hint(MEMCACHED_SUCCESS, rc, memcached_last_error_message(memc));
+    test_true(value);
+    free(value);
+  }
+
+  test_compare(MEMCACHED_NOTFOUND,
+               memcached_exist(memc, test_literal_param(__func__)));
+
+  return TEST_SUCCESS;
+}
+
+test_return_t test_memcached_mgat(memcached_st *memc)
+{
+  test_skip(TEST_SUCCESS, pre_gat(memc));
+  // Servers before 1.5 answer GATKQ without the key
+  test_skip(true, libmemcached_util_version_check(memc, 1, 5, 3));
+
+  const char *keys[]= { "mgat_1", "mgat_2", "mgat_missing", "mgat_3" };
+  size_t key_length[]= { 6, 6, 12, 6 };
+  for (size_t x= 0; x < 4; x++)
+  {
+    if (x == 2)
+    {
+      memcached_delete(memc, keys[x], key_length[x], 0);
+      continue;
+    }
+    test_compare(MEMCACHED_SUCCESS, memcached_set(memc, keys[x], key_length[x], keys[x], key_length[x], 2, 0));
+  }
+
+  test_compare(MEMCACHED_SUCCESS, memcached_mgat(memc, keys, key_length, 4, 60 *60 *24 *60));
+
+  memcached_result_st results;
+  test_true(memcached_result_create(memc, &results));
+  memcached_result_st *result;
+  memcached_return_t rc;
+  size_t found= 0;
+  while ((result= memcached_fetch_result(memc, &results, &rc)))
+  {
+    test_compare(memcached_result_key_length(result), memcached_result_length(result));
+    test_memcmp(memcached_result_key_value(result), memcached_result_value(result), memcached_result_length(result));
+    found++;
+  }
+  test_compare(MEMCACHED_END, rc);
+  test_compare(size_t(3), found);
+  memcached_result_free(&results);
+
+  for (size_t x= 0; x < 4; x++)
+  {
+    test_compare(MEMCACHED_NOTFOUND, memcached_exist(memc, keys[x], key_length[x]));
+  }
+
+  return TEST_SUCCESS;
+}
@@ -0,0 +1,249 @@
+/*  vim:expandtab:shiftwidth=2:tabstop=2:smarttab:
+ * 
+ *  Libmemcached library
+ *
+ *  Copyright (C) 2011-2012 Data Differential, http://datadifferential.com/
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are
+ *  met:
+ *
+ *      * Redistributions of source code must retain the above copyright
+ *  notice, this list of conditions and the following disclaimer.
+ *
+ *      * Redistributions in binary form must reproduce the above
+ *  copyright notice, this list of conditions and the following disclaimer
+ *  in the documentation and/or other materials provided with the
+ *  distribution.
+ *
+ *      * The names of its contributors may not be used to endorse or
+ *  promote products derived from this software without specific prior
+ *  written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *  A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *  OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *  SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *  LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *  DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *  THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *  OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+#include <config.h>
+#include <libtest/test.hpp>
+
+using namespace libtest;
+
+#include <libmemcached-1.0/memcached.h>
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "tests/libmemcached-1.0/trace.h"
+
+struct trace_record_st
+{
+  memcached_telemetry_op_t op;
+  memcached_return_t rc;
+  std::string key;
+  size_t number_of_keys;
+  size_t value_length;
+  uint32_t server_key;
+  bool has_hostname;
+  uint64_t start_usec;
+  uint64_t end_usec;
+};
+
+static void trace_collect(const memcached_st *, const memcached_trace_event_st *event, void *context)
+{
+  std::vector<trace_record_st> *records= static_cast<std::vector<trace_record_st> *>(context);
+
+  trace_record_st record;
+  record.op= event->op;
+  record.rc= event->rc;
+  if (event->key)
+  {
+    record.key.assign(event->key, event->key_length);
+  }
+  record.number_of_keys= event->number_of_keys;
+  record.value_length= event->value_length;
+  record.server_key= event->server_key;
+  record.has_hostname= event->hostname != NULL;
+  record.start_usec= event->start_usec;
+  record.end_usec= event->end_usec;
+
+  records->push_back(record);
+}
+
+test_return_t trace_fn_TEST(memcached_st *original)
+{
+  memcached_st *memc= memcached_clone(NULL, original);
+  test_true(memc);
+
+  void *context= &context;
+  test_null(memcached_get_trace_fn(memc, &context));
+  test_null(context);
+
+  std::vector<trace_record_st> records;
+  test_compare(MEMCACHED_INVALID_ARGUMENTS,
+               memcached_set_trace_fn(memc, trace_collect, &records, 0));
+  test_null(memcached_get_trace_fn(memc, NULL));
+
+  test_compare(MEMCACHED_SUCCESS,
+               memcached_set_trace_fn(memc, trace_collect, &records, 1));
+  test_true(memcached_get_trace_fn(memc, &context) == trace_collect);
+  test_true(context == &records);
+
+  test_compare(MEMCACHED_SUCCESS,
+               memcached_set_trace_fn(memc, NULL, &records, 1));
+  test_null(memcached_get_trace_fn(memc, &context));
+  test_null(context);
+
+  test_compare(MEMCACHED_SUCCESS,
+               memcached_set(memc, test_literal_param("trace_fn"), test_literal_param("value"), 0, 0));
+  test_zero(records.size());
+
+  memcached_free(memc);
+
+  return TEST_SUCCESS;
+}
+
+test_return_t trace_events_TEST(memcached_st *original)
+{
+  memcached_st *memc= memcached_clone(NULL, original);
+  test_true(memc);
+
+  std::vector<trace_record_st> records;
+  test_compare(MEMCACHED_SUCCESS,
+               memcached_set_trace_fn(memc, trace_collect, &records, 1));
+
+  test_compare(MEMCACHED_SUCCESS,
+               memcached_set(memc, test_literal_param("trace_events"), test_literal_param("value"), 0, 0));
+
+  size_t value_length;
+  uint32_t flags;
+  memcached_return_t rc;
+  char *value= memcached_get(memc, test_literal_param("trace_events"), &value_length, &flags, &rc);
+  test_compare(MEMCACHED_SUCCESS, rc);
+  test_true(value);
+  free(value);
+
+  test_null(memcached_get(memc, test_literal_param("trace_events_missing"), &value_length, &flags, &rc));
+  test_compare(MEMCACHED_NOTFOUND, rc);
+
+  const char *keys[]= { "trace_events", "trace_events_missing" };
+  size_t key_length[]= { 12, 20 };
+  test_compare(MEMCACHED_SUCCESS,
+               memcached_mget(memc, keys, key_length, 2));
+  memcached_result_st *result;
+  while ((result= memcached_fetch_result(memc, NULL, &rc)))
+  {
+    memcached_result_free(result);
+  }
+
+  test_compare(MEMCACHED_SUCCESS,
+               memcached_delete(memc, test_literal_param("trace_events"), 0));
+
+  test_compare(size_t(5), records.size());
+
+  test_compare(MEMCACHED_TELEMETRY_OP_SET, records[0].op);
+  test_compare(MEMCACHED_SUCCESS, records[0].rc);
+  test_compare(size_t(5), records[0].value_length);
+
+  test_compare(MEMCACHED_TELEMETRY_OP_GET, records[1].op);
+  test_compare(MEMCACHED_SUCCESS, records[1].rc);
+  test_compare(size_t(5), records[1].value_length);
+
+  test_compare(MEMCACHED_TELEMETRY_OP_GET, records[2].op);
+  test_compare(MEMCACHED_NOTFOUND, records[2].rc);
+  test_zero(records[2].value_length);
+
+  test_compare(MEMCACHED_TELEMETRY_OP_MGET, records[3].op);
+  test_compare(size_t(2), records[3].number_of_keys);
+  test_compare(UINT32_MAX, records[3].server_key);
+  test_false(records[3].has_hostname);
+
+  test_compare(MEMCACHED_TELEMETRY_OP_DELETE, records[4].op);
+
+  for (std::vector<trace_record_st>::iterator iter= records.begin(); iter != records.end(); ++iter)
+  {
+    test_true(iter->start_usec);
+    test_true(iter->start_usec <= iter->end_usec);
+
+    if (iter->op != MEMCACHED_TELEMETRY_OP_MGET)
+    {
+      test_compare(size_t(1), iter->number_of_keys);
+      test_true(iter->server_key < memcached_server_count(memc));
+      test_true(iter->has_hostname);
+      test_compare(iter->server_key, memcached_generate_hash(memc, iter->key.c_str(), iter->key.size()));
+    }
+  }
+  test_compare(std::string("trace_events"), records[0].key);
+  test_compare(std::string("trace_events_missing"), records[2].key);
+  test_compare(std::string("trace_events"), records[3].key);
+
+  memcached_free(memc);
+
+  return TEST_SUCCESS;
+}
+
+test_return_t trace_sample_rate_TEST(memcached_st *original)
+{
+  memcached_st *memc= memcached_clone(NULL, original);
+  test_true(memc);
+
+  std::vector<trace_record_st> records;
+  test_compare(MEMCACHED_SUCCESS,
+               memcached_set_trace_fn(memc, trace_collect, &records, 4));
+
+  char key[32];
+  for (uint32_t x= 0; x < 12; x++)
+  {
+    int key_length= snprintf(key, sizeof(key), "trace_sample_%u", x);
+    test_compare(MEMCACHED_SUCCESS,
+                 memcached_set(memc, key, key_length, test_literal_param("value"), 0, 0));
+  }
+
+  test_compare(size_t(3), records.size());
+  test_compare(std::string("trace_sample_3"), records[0].key);
+  test_compare(std::string("trace_sample_7"), records[1].key);
+  test_compare(std::string("trace_sample_11"), records[2].key);
+
+  memcached_free(memc);
+
+  return TEST_SUCCESS;
+}
+
+test_return_t trace_clone_TEST(memcached_st *original)
+{
+  memcached_st *memc= memcached_clone(NULL, original);
+  test_true(memc);
+
+  std::vector<trace_record_st> records;
+  test_compare(MEMCACHED_SUCCESS,
+               memcached_set_trace_fn(memc, trace_collect, &records, 1));
+
+  memcached_st *clone= memcached_clone(NULL, memc);
+  test_true(clone);
+
+  void *context;
+  test_true(memcached_get_trace_fn(clone, &context) == trace_collect);
+  test_true(context == &records);
+
+  test_compare(MEMCACHED_SUCCESS,
+               memcached_set(clone, test_literal_param("trace_clone"), test_literal_param("value"), 0, 0));
+  test_compare(size_t(1), records.size());
+  test_compare(std::string("trace_clone"), records[0].key);
+
+  memcached_free(clone);
+  memcached_free(memc);
+
+  return TEST_SUCCESS;
+}
@@ -54,6 +54,12 @@ using namespace libtest;
 #include <cstdio>
 #include <cstdlib>
 #include <cstring>
+#include <string>
+#include <vector>
+#include <netinet/in.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sys/socket.h>
 #include <sys/time.h>
 #include <sys/types.h>
 #include <sys/stat.h>
@@ -217,7 +223,7 @@ static test_return_t memcached_get_TEST(memcached_st *memc)
   test_null(memcached_get(memc,
                           test_literal_param(__func__),
                           0, 0, &rc));
-  test_compare(MEMCACHED_NOT_SUPPORTED, rc);
+  test_compare(MEMCACHED_NOTFOUND, rc);
 
   return TEST_SUCCESS;
 }
@@ -481,12 +487,433 @@ static test_return_t udp_get_test(memcached_st *memc)
   size_t vlen;
   Expected expected_ids;
   get_udp_request_ids(memc, expected_ids);
-  test_null(memcached_get(memc, test_literal_param("foo"), &vlen, (uint32_t)0, &rc));
-  test_compare(MEMCACHED_NOT_SUPPORTED, rc);
+  test_null(memcached_get(memc, test_literal_param("udp_get_test"), &vlen, (uint32_t)0, &rc));
+  if (memcached_behavior_get(memc, MEMCACHED_BEHAVIOR_BINARY_PROTOCOL))
+  {
+    test_compare(MEMCACHED_NOT_SUPPORTED, rc);
+  }
+  else
+  {
+    test_compare(MEMCACHED_NOTFOUND, rc);
+  }
 
   return post_udp_op_check(memc, expected_ids);
 }
 
+/* Values are stored over TCP, so that only the gets go over UDP */
+static memcached_st *tcp_clone(memcached_st *memc)
+{
+  memcached_st *tcp= memcached_clone(NULL, memc);
+  if (tcp and memcached_failed(memcached_behavior_set(tcp, MEMCACHED_BEHAVIOR_USE_UDP, false)))
+  {
+    memcached_free(tcp);
+    return NULL;
+  }
+
+  return tcp;
+}
+
+static test_return_t udp_get_set_TEST(memcached_st *memc)
+{
+  memcached_st *tcp= tcp_clone(memc);
+  test_true(tcp);
+  test_compare(MEMCACHED_SUCCESS,
+               memcached_set(tcp, test_literal_param(__func__), test_literal_param("over udp"), time_t(0), uint32_t(7)));
+
+  size_t value_length;
+  uint32_t flags;
+  memcached_return_t rc;
+  char *value= memcached_get(memc, test_literal_param(__func__), &value_length, &flags, &rc);
+  test_compare_hint(MEMCACHED_SUCCESS, rc, memcached_last_error_message(memc));
+  test_true(value);
+  test_compare(test_literal_param_size("over udp"), value_length);
+  test_memcmp("over udp", value, value_length);
+  test_compare(uint32_t(7), flags);
+  free(value);
+
+  memcached_free(tcp);
+
+  return TEST_SUCCESS;
+}
+
+/*
+  The same request goes to every replica. Each copy has to be encrypted
+  from the plain value, not from what was sent to the replica before it.
+*/
+static test_return_t udp_encrypted_replicas_TEST(memcached_st *original)
+{
+  test_skip_valgrind();
+  test_true(memcached_server_count(original) > 1);
+
+  memcached_st *memc= memcached_clone(NULL, original);
+  test_true(memc);
+  test_compare(MEMCACHED_SUCCESS, memcached_behavior_set(memc, MEMCACHED_BEHAVIOR_BINARY_PROTOCOL, true));
+  test_compare(MEMCACHED_SUCCESS,
+               memcached_behavior_set(memc, MEMCACHED_BEHAVIOR_NUMBER_OF_REPLICAS, memcached_server_count(memc) -1));
+  test_compare(MEMCACHED_SUCCESS, memcached_set_encoding_key(memc, test_literal_param(__func__)));
+
+  test_compare_hint(MEMCACHED_SUCCESS,
+                    memcached_set(memc, test_literal_param(__func__), test_literal_param("on every replica"), time_t(0), uint32_t(0)),
+                    memcached_last_error_message(memc));
+
+  // Nothing is acknowledged over UDP, so give the servers a moment
+  libtest::dream(0, 100 * 1000 * 1000);
+
+  for (uint32_t x= 0; x < memcached_server_count(memc); x++)
+  {
+    memcached_server_instance_st instance= memcached_server_instance_by_position(memc, x);
+    memcached_st *tcp= memcached_create(NULL);
+    test_true(tcp);
+    test_compare(MEMCACHED_SUCCESS,
+                 memcached_server_add(tcp, memcached_server_name(instance), memcached_server_port(instance)));
+    test_compare(MEMCACHED_SUCCESS, memcached_set_encoding_key(tcp, test_literal_param(__func__)));
+
+    size_t value_length;
+    uint32_t flags;
+    memcached_return_t rc;
+    char *value= memcached_get(tcp, test_literal_param(__func__), &value_length, &flags, &rc);
+    test_compare_hint(MEMCACHED_SUCCESS, rc, memcached_last_error_message(tcp));
+    test_compare(test_literal_param_size("on every replica"), value_length);
+    test_memcmp("on every replica", value, value_length);
+    free(value);
+
+    memcached_free(tcp);
+  }
+
+  memcached_free(memc);
+
+  return TEST_SUCCESS;
+}
+
+static test_return_t udp_mget(memcached_st *memc, size_t value_length)
+{
+  memcached_st *tcp= tcp_clone(memc);
+  test_true(tcp);
+
+  std::vector<std::string> keys;
+  std::vector<const char *> key_ptrs;
+  std::vector<size_t> key_lengths;
+  for (size_t x= 0; x < 200; x++)
+  {
+    char key[MEMCACHED_MAX_KEY];
+    keys.push_back(std::string(key, size_t(snprintf(key, sizeof(key), "udp_mget_%u", uint32_t(x)))));
+  }
+
+  for (size_t x= 0; x < keys.size(); x++)
+  {
+    key_ptrs.push_back(keys[x].c_str());
+    key_lengths.push_back(keys[x].size());
+
+    // Every other key is missing
+    if (x % 2)
+    {
+      memcached_return_t rc= memcached_delete(tcp, keys[x].c_str(), keys[x].size(), 0);
+      test_true(rc == MEMCACHED_SUCCESS or rc == MEMCACHED_NOTFOUND);
+      continue;
+    }
+
+    std::string value(value_length, char('a' +x % 26));
+    test_compare(MEMCACHED_SUCCESS,
+                 memcached_set(tcp, keys[x].c_str(), keys[x].size(), value.c_str(), value.size(), time_t(0), uint32_t(x)));
+  }
+
+  test_compare_hint(MEMCACHED_SUCCESS,
+                    memcached_mget(memc, &key_ptrs[0], &key_lengths[0], key_ptrs.size()),
+                    memcached_last_error_message(memc));
+
+  std::vector<bool> fetched(keys.size());
+  size_t count= 0;
+  memcached_return_t rc;
+  memcached_result_st *result;
+  while ((result= memcached_fetch_result(memc, NULL, &rc)))
+  {
+    test_compare(MEMCACHED_SUCCESS, rc);
+    uint32_t x= memcached_result_flags(result);
+    test_true(x < keys.size());
+    test_false(fetched[x]);
+    fetched[x]= true;
+    test_compare(keys[x], std::string(memcached_result_key_value(result), memcached_result_key_length(result)));
+    test_compare(value_length, memcached_result_length(result));
+    test_compare(std::string(value_length, char('a' +x % 26)), std::string(memcached_result_value(result), value_length));
+    memcached_result_free(result);
+    count++;
+  }
+  test_compare(keys.size() / 2, count);
+
+  memcached_free(tcp);
+
+  return TEST_SUCCESS;
+}
+
+static test_return_t udp_mget_TEST(memcached_st *memc)
+{
+  return udp_mget(memc, 100);
+}
+
+/* Values that take several datagrams each */
+static test_return_t udp_mget_reassembly_TEST(memcached_st *memc)
+{
+  return udp_mget(memc, 5000);
+}
+
+/* Nothing is waited on, so everything is sent again over TCP */
+static test_return_t udp_mget_fallback_TEST(memcached_st *memc)
+{
+  test_compare(MEMCACHED_SUCCESS, memcached_behavior_set(memc, MEMCACHED_BEHAVIOR_UDP_READ_TIMEOUT, 0));
+  test_compare(TEST_SUCCESS, udp_mget(memc, 100));
+  test_compare(TEST_SUCCESS, udp_mget(memc, 5000));
+  test_compare(MEMCACHED_SUCCESS, memcached_behavior_set(memc, MEMCACHED_BEHAVIOR_UDP_READ_TIMEOUT, MEMCACHED_DEFAULT_UDP_READ_TIMEOUT));
+
+  return TEST_SUCCESS;
+}
+
+static test_return_t udp_get_large_TEST(memcached_st *memc)
+{
+  memcached_st *tcp= tcp_clone(memc);
+  test_true(tcp);
+
+  std::vector<char> value(200 * 1024);
+  for (size_t x= 0; x < value.size(); x++)
+  {
+    value[x]= char(x % 251);
+  }
+  test_compare(MEMCACHED_SUCCESS,
+               memcached_set(tcp, test_literal_param(__func__), &value[0], value.size(), time_t(0), uint32_t(0)));
+
+  size_t value_length;
+  uint32_t flags;
+  memcached_return_t rc;
+  char *fetched= memcached_get(memc, test_literal_param(__func__), &value_length, &flags, &rc);
+  test_compare_hint(MEMCACHED_SUCCESS, rc, memcached_last_error_message(memc));
+  test_true(fetched);
+  test_compare(value.size(), value_length);
+  test_memcmp(&value[0], fetched, value_length);
+  free(fetched);
+
+  memcached_free(tcp);
+
+  return TEST_SUCCESS;
+}
+
+static test_return_t udp_gets_TEST(memcached_st *memc)
+{
+  memcached_st *tcp= tcp_clone(memc);
+  test_true(tcp);
+  test_compare(MEMCACHED_SUCCESS, memcached_behavior_set(tcp, MEMCACHED_BEHAVIOR_SUPPORT_CAS, true));
+  test_compare(MEMCACHED_SUCCESS, memcached_behavior_set(memc, MEMCACHED_BEHAVIOR_SUPPORT_CAS, true));
+  test_compare(MEMCACHED_SUCCESS,
+               memcached_set(tcp, test_literal_param(__func__), test_literal_param("cas"), time_t(0), uint32_t(0)));
+
+  const char *keys[]= { __func__ };
+  size_t key_length[]= { strlen(__func__) };
+
+  memcached_return_t rc;
+  test_compare(MEMCACHED_SUCCESS, memcached_mget(tcp, keys, key_length, 1));
+  memcached_result_st *expected= memcached_fetch_result(tcp, NULL, &rc);
+  test_true(expected);
+
+  test_compare(MEMCACHED_SUCCESS, memcached_mget(memc, keys, key_length, 1));
+  memcached_result_st *result= memcached_fetch_result(memc, NULL, &rc);
+  test_true(result);
+  test_true(memcached_result_cas(result));
+  test_compare(memcached_result_cas(expected), memcached_result_cas(result));
+  memcached_result_free(result);
+  memcached_result_free(expected);
+
+  test_compare(MEMCACHED_SUCCESS, memcached_behavior_set(memc, MEMCACHED_BEHAVIOR_SUPPORT_CAS, false));
+  memcached_free(tcp);
+
+  return TEST_SUCCESS;
+}
+
+static test_return_t udp_read_timeout_TEST(memcached_st *memc)
+{
+  test_compare(uint64_t(MEMCACHED_DEFAULT_UDP_READ_TIMEOUT),
+               memcached_behavior_get(memc, MEMCACHED_BEHAVIOR_UDP_READ_TIMEOUT));
+  test_compare(MEMCACHED_SUCCESS, memcached_behavior_set(memc, MEMCACHED_BEHAVIOR_UDP_READ_TIMEOUT, 20));
+  test_compare(uint64_t(20), memcached_behavior_get(memc, MEMCACHED_BEHAVIOR_UDP_READ_TIMEOUT));
+
+  memcached_st *memc_clone= memcached_clone(NULL, memc);
+  test_true(memc_clone);
+  test_compare(uint64_t(20), memcached_behavior_get(memc_clone, MEMCACHED_BEHAVIOR_UDP_READ_TIMEOUT));
+  memcached_free(memc_clone);
+
+  test_compare(MEMCACHED_INVALID_ARGUMENTS,
+               memcached_behavior_set(memc, MEMCACHED_BEHAVIOR_UDP_READ_TIMEOUT, uint64_t(INT32_MAX) +1));
+  test_compare(MEMCACHED_SUCCESS, memcached_behavior_set(memc, MEMCACHED_BEHAVIOR_UDP_READ_TIMEOUT, MEMCACHED_DEFAULT_UDP_READ_TIMEOUT));
+
+  return TEST_SUCCESS;
+}
+
+/*
+  A server that answers a get over UDP with one malformed datagram, then
+  answers the same get again over TCP on the same port with a miss. If the
+  datagram is taken for a value, the get does not come back NOTFOUND.
+*/
+struct udp_malformed_server_st
+{
+  int udp_fd;
+  int tcp_fd;
+  in_port_t port;
+  pthread_t thread;
+  const char *payload;
+  std::string error;
+};
+
+static void *udp_malformed_server_run(void *context)
+{
+  udp_malformed_server_st *server= static_cast<udp_malformed_server_st *>(context);
+
+  struct pollfd pfd= { server->udp_fd, POLLIN, 0 };
+  char request[MAX_UDP_DATAGRAM_LENGTH];
+  struct sockaddr_storage client;
+  socklen_t client_length= sizeof(client);
+  ssize_t length;
+  if (poll(&pfd, 1, 5000) != 1 or
+      (length= recvfrom(server->udp_fd, request, sizeof(request), 0, (struct sockaddr *)&client, &client_length)) < UDP_DATAGRAM_HEADER_LENGTH)
+  {
+    server->error= "no get over UDP";
+    return NULL;
+  }
+
+  struct udp_datagram_header_st header;
+  memcpy(&header, request, sizeof(header));
+  header.sequence_number= htons(0);
+  header.num_datagrams= htons(1);
+  header.reserved= 0;
+
+  std::string datagram(reinterpret_cast<const char *>(&header), sizeof(header));
+  datagram.append(server->payload);
+  if (sendto(server->udp_fd, datagram.c_str(), datagram.size(), 0, (struct sockaddr *)&client, client_length) == -1)
+  {
+    server->error= "could not answer over UDP";
+    return NULL;
+  }
+
+  pfd.fd= server->tcp_fd;
+  int fd;
+  if (poll(&pfd, 1, 5000) != 1 or (fd= accept(server->tcp_fd, NULL, NULL)) == -1)
+  {
+    server->error= "the get was not sent again over TCP";
+    return NULL;
+  }
+
+  std::string line;
+  pfd.fd= fd;
+  while (line.find("\r\n") == std::string::npos and poll(&pfd, 1, 5000) == 1)
+  {
+    char buffer[1024];
+    ssize_t read_length= recv(fd, buffer, sizeof(buffer), 0);
+    if (read_length <= 0)
+    {
+      break;
+    }
+    line.append(buffer, size_t(read_length));
+  }
+
+  if (line.compare(0, 4, "get ") or send(fd, test_literal_param("END\r\n"), MSG_NOSIGNAL) == -1)
+  {
+    server->error= "expected a get over TCP, got \"" +line +"\"";
+  }
+
+  // Wait for the client to hang up
+  char buffer[1024];
+  while (poll(&pfd, 1, 5000) == 1 and recv(fd, buffer, sizeof(buffer), 0) > 0) { }
+  close(fd);
+
+  return NULL;
+}
+
+// UDP and TCP have to share a port number, so keep trying ephemeral ones
+static bool udp_malformed_server_start(udp_malformed_server_st& server, const char *payload)
+{
+  server.payload= payload;
+
+  for (size_t attempt= 0; attempt < 20; attempt++)
+  {
+    struct sockaddr_in address;
+    memset(&address, 0, sizeof(address));
+    address.sin_family= AF_INET;
+    address.sin_addr.s_addr= htonl(INADDR_LOOPBACK);
+    socklen_t address_length= sizeof(address);
+
+    if ((server.udp_fd= socket(AF_INET, SOCK_DGRAM, 0)) == -1)
+    {
+      return false;
+    }
+
+    if (bind(server.udp_fd, (struct sockaddr *)&address, sizeof(address)) == -1 or
+        getsockname(server.udp_fd, (struct sockaddr *)&address, &address_length) == -1 or
+        (server.tcp_fd= socket(AF_INET, SOCK_STREAM, 0)) == -1)
+    {
+      close(server.udp_fd);
+      return false;
+    }
+
+    if (bind(server.tcp_fd, (struct sockaddr *)&address, sizeof(address)) == 0 and listen(server.tcp_fd, 1) == 0)
+    {
+      server.port= ntohs(address.sin_port);
+      if (pthread_create(&server.thread, NULL, udp_malformed_server_run, &server) == 0)
+      {
+        return true;
+      }
+      attempt= 20;
+    }
+
+    close(server.tcp_fd);
+    close(server.udp_fd);
+  }
+
+  return false;
+}
+
+static std::string udp_malformed_server_stop(udp_malformed_server_st& server)
+{
+  pthread_join(server.thread, NULL);
+  close(server.tcp_fd);
+  close(server.udp_fd);
+
+  return server.error;
+}
+
+static test_return_t udp_malformed(const char *payload)
+{
+  udp_malformed_server_st server;
+  test_true(udp_malformed_server_start(server, payload));
+
+  memcached_st *memc= memcached_create(NULL);
+  test_true(memc);
+  test_compare(MEMCACHED_SUCCESS, memcached_behavior_set(memc, MEMCACHED_BEHAVIOR_USE_UDP, true));
+  test_compare(MEMCACHED_SUCCESS, memcached_server_add(memc, "127.0.0.1", server.port));
+
+  size_t value_length;
+  uint32_t flags;
+  memcached_return_t rc;
+  char *value= memcached_get(memc, test_literal_param("udp_malformed"), &value_length, &flags, &rc);
+  memcached_free(memc);
+
+  test_compare(std::string(), udp_malformed_server_stop(server));
+  test_null(value);
+  test_compare(MEMCACHED_NOTFOUND, rc);
+
+  return TEST_SUCCESS;
+}
+
+static test_return_t udp_malformed_TEST(memcached_st *)
+{
+  // A length that wraps to zero once the \r\n after the value is added
+  test_compare(TEST_SUCCESS, udp_malformed("VALUE udp_malformed 0 18446744073709551614\r\nEND\r\n"));
+
+  // Lengths and flags that do not fit in 64 bits
+  test_compare(TEST_SUCCESS, udp_malformed("VALUE udp_malformed 0 184467440737095516160\r\nEND\r\n"));
+  test_compare(TEST_SUCCESS, udp_malformed("VALUE udp_malformed 99999999999999999999999 1\r\na\r\nEND\r\n"));
+
+  // A value that runs past the end of the datagram
+  test_compare(TEST_SUCCESS, udp_malformed("VALUE udp_malformed 0 1\r\n"));
+
+  return TEST_SUCCESS;
+}
+
 static test_return_t udp_mixed_io_test(memcached_st *memc)
 {
   test_st mixed_io_ops [] ={
@@ -554,11 +981,30 @@ test_st upd_io_tests[] ={
   {0, 0, 0}
 };
 
+test_st udp_get_TESTS[] ={
+  {"memcached_get()", 0, (test_callback_fn*)udp_get_set_TEST },
+  {"memcached_mget()", 0, (test_callback_fn*)udp_mget_TEST },
+  {"memcached_mget() reassembly", 0, (test_callback_fn*)udp_mget_reassembly_TEST },
+  {"memcached_mget() fallback to TCP", 0, (test_callback_fn*)udp_mget_fallback_TEST },
+  {"memcached_get() large value", 0, (test_callback_fn*)udp_get_large_TEST },
+  {"MEMCACHED_BEHAVIOR_SUPPORT_CAS", 0, (test_callback_fn*)udp_gets_TEST },
+  {"MEMCACHED_BEHAVIOR_UDP_READ_TIMEOUT", 0, (test_callback_fn*)udp_read_timeout_TEST },
+  {"encrypted set to every replica", 0, (test_callback_fn*)udp_encrypted_replicas_TEST },
+  {0, 0, 0}
+};
+
+test_st udp_malformed_TESTS[] ={
+  {"malformed VALUE lines", 0, (test_callback_fn*)udp_malformed_TEST },
+  {0, 0, 0}
+};
+
 collection_st collection[] ={
   {"udp_setup", (test_callback_fn*)init_udp, 0, udp_setup_server_tests},
   {"compatibility", (test_callback_fn*)init_udp, 0, compatibility_TESTS},
   {"udp_io", (test_callback_fn*)init_udp_valgrind, 0, upd_io_tests},
   {"udp_binary_io", (test_callback_fn*)binary_init_udp, 0, upd_io_tests},
+  {"udp_get", (test_callback_fn*)init_udp, 0, udp_get_TESTS},
+  {"udp_malformed", 0, 0, udp_malformed_TESTS},
   {0, 0, 0, 0}
 };
 
@@ -52,3 +52,13 @@ test_return_t replication_randomize_mget_fail_test(memcached_st *memc);
 test_return_t replication_miss_test(memcached_st *memc);
 
 test_return_t check_replication_sanity_TEST(memcached_st*);
+
+test_return_t replication_acks_TEST(memcached_st*);
+
+test_return_t replication_acks_buffered_TEST(memcached_st*);
+
+test_return_t replication_hedged_read_behavior_TEST(memcached_st*);
+
+test_return_t replication_hedged_read_TEST(memcached_st*);
+
+test_return_t replication_hedged_read_miss_TEST(memcached_st*);